@@ -19,9 +19,10 @@
 #include <sys/epoll.h>
 
 #include <memory>
+#include <mutex>
 #include <optional>
-#include <set>
 #include <shared_mutex>
+#include <vector>
 
 #include "common/libs/fs/shared_fd.h"
 #include "common/libs/utils/result.h"
@@ -50,6 +51,8 @@ Epoll::Epoll(Epoll&& other) {
 
   epoll_fd_ = std::move(other.epoll_fd_);
   watched_ = std::move(other.watched_);
+  watched_by_id_ = std::move(other.watched_by_id_);
+  next_id_ = other.next_id_;
 }
 
 Epoll& Epoll::operator=(Epoll&& other) {
@@ -61,6 +64,8 @@ Epoll& Epoll::operator=(Epoll&& other) {
 
   epoll_fd_ = std::move(other.epoll_fd_);
   watched_ = std::move(other.watched_);
+  watched_by_id_ = std::move(other.watched_by_id_);
+  next_id_ = other.next_id_;
   return *this;
 }
 
@@ -75,7 +80,7 @@ Result<void> Epoll::Add(SharedFD fd, uint32_t events) {
   }
   epoll_event event;
   event.events = events;
-  event.data.fd = fd->fd_;
+  event.data.u64 = next_id_;
   int success = epoll_ctl(epoll_fd_->fd_, EPOLL_CTL_ADD, fd->fd_, &event);
   if (success != 0 && errno == EEXIST) {
     // We're already tracking this fd, don't drop it from the set.
@@ -83,7 +88,9 @@ Result<void> Epoll::Add(SharedFD fd, uint32_t events) {
   } else if (success != 0) {
     return CF_ERRNO("epoll_ctl: Add failed");
   }
-  watched_.insert(fd);
+  watched_[fd] = next_id_;
+  watched_by_id_[next_id_] = fd;
+  next_id_++;
   return {};
 }
 
@@ -93,16 +100,22 @@ Result<void> Epoll::AddOrModify(SharedFD fd, uint32_t events) {
   std::lock(watched_lock, epoll_lock);
   CF_EXPECT(epoll_fd_->IsOpen(), "Empty Epoll instance");
 
+  auto it = watched_.find(fd);
+  int operation = it == watched_.end() ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+  uint64_t id = it == watched_.end() ? next_id_ : it->second;
   epoll_event event;
   event.events = events;
-  event.data.fd = fd->fd_;
-  int operation = watched_.count(fd) == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+  event.data.u64 = id;
   int success = epoll_ctl(epoll_fd_->fd_, operation, fd->fd_, &event);
   if (success != 0) {
     std::string operation_str = operation == EPOLL_CTL_ADD ? "add" : "modify";
     return CF_ERRNO("epoll_ctl: Operation " << operation_str << " failed");
   }
-  watched_.insert(fd);
+  if (operation == EPOLL_CTL_ADD) {
+    watched_[fd] = id;
+    watched_by_id_[id] = fd;
+    next_id_++;
+  }
   return {};
 }
 
@@ -112,12 +125,13 @@ Result<void> Epoll::Modify(SharedFD fd, uint32_t events) {
   std::lock(watched_lock, epoll_lock);
   CF_EXPECT(epoll_fd_->IsOpen(), "Empty Epoll instance");
 
-  if (watched_.count(fd) == 0) {
+  auto it = watched_.find(fd);
+  if (it == watched_.end()) {
     return CF_ERR("Watched set did not contain fd");
   }
   epoll_event event;
   event.events = events;
-  event.data.fd = fd->fd_;
+  event.data.u64 = it->second;
   int success = epoll_ctl(epoll_fd_->fd_, EPOLL_CTL_MOD, fd->fd_, &event);
   if (success != 0) {
     return CF_ERRNO("epoll_ctl: Modify failed");
@@ -131,46 +145,58 @@ Result<void> Epoll::Delete(SharedFD fd) {
   std::lock(watched_lock, epoll_lock);
   CF_EXPECT(epoll_fd_->IsOpen(), "Empty Epoll instance");
 
-  if (watched_.count(fd) == 0) {
+  auto it = watched_.find(fd);
+  if (it == watched_.end()) {
     return CF_ERR("Watched set did not contain fd");
   }
   int success = epoll_ctl(epoll_fd_->fd_, EPOLL_CTL_DEL, fd->fd_, nullptr);
   if (success != 0) {
     return CF_ERRNO("epoll_ctl: Delete failed");
   }
-  watched_.erase(fd);
+  watched_by_id_.erase(it->second);
+  watched_.erase(it);
   return {};
 }
 
 Result<std::optional<EpollEvent>> Epoll::Wait() {
-  epoll_event event;
-  int success;
+  auto events = CF_EXPECT(WaitMany(1));
+  if (events.empty()) {
+    // We probably lost the race to lock watched_mutex_ against a delete call.
+    // Treat this as a spurious wakeup.
+    return {};
+  }
+  return events[0];
+}
+
+Result<std::vector<EpollEvent>> Epoll::WaitMany(size_t max_events,
+                                                int timeout) {
+  CF_EXPECT(max_events > 0, "Must wait for at least one event");
+  std::vector<epoll_event> events(max_events);
+  int num_events;
   {
     std::shared_lock lock(epoll_mutex_);
     CF_EXPECT(epoll_fd_->IsOpen(), "Empty Epoll instance");
-    success = epoll_wait(epoll_fd_->fd_, &event, 1, -1);
+    num_events = TEMP_FAILURE_RETRY(
+        epoll_wait(epoll_fd_->fd_, events.data(), events.size(), timeout));
   }
-  if (success == -1) {
+  if (num_events == -1) {
     return CF_ERRNO("epoll_wait failed");
-  } else if (success == 0) {
-    return {};
-  } else if (success != 1) {
+  } else if (num_events > static_cast<int>(max_events)) {
     return CF_ERR("epoll_wait returned an unexpected value");
   }
-  EpollEvent ret;
-  ret.events = event.events;
+  std::vector<EpollEvent> ret;
+  ret.reserve(num_events);
   std::shared_lock lock(watched_mutex_);
-  for (const auto& watched : watched_) {
-    if (watched->fd_ == event.data.fd) {
-      ret.fd = watched;
-      break;
+  for (int i = 0; i < num_events; i++) {
+    auto it = watched_by_id_.find(events[i].data.u64);
+    if (it == watched_by_id_.end()) {
+      // The file descriptor was deleted after the event was reported.
+      continue;
     }
-  }
-  if (!ret.fd->IsOpen()) {
-    // Couldn't find the matching SharedFD to the file descriptor. We probably
-    // lost the race to lock watched_mutex_ against a delete call. Treat this
-    // as a spurious wakeup.
-    return {};
+    ret.emplace_back(EpollEvent{
+        .fd = it->second,
+        .events = events[i].events,
+    });
   }
   return ret;
 }
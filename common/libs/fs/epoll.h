@@ -18,10 +18,13 @@
 
 #include <sys/epoll.h>
 
+#include <cstdint>
+#include <map>
 #include <memory>
 #include <optional>
-#include <set>
 #include <shared_mutex>
+#include <unordered_map>
+#include <vector>
 
 #include "common/libs/fs/shared_fd.h"
 #include "common/libs/utils/result.h"
@@ -45,6 +48,13 @@ class Epoll {
   Result<void> AddOrModify(SharedFD fd, uint32_t events);
   Result<void> Delete(SharedFD fd);
   Result<std::optional<EpollEvent>> Wait();
+  /**
+   * Waits for events on up to `max_events` watched file descriptors at once,
+   * for at most `timeout` milliseconds or forever if it's negative. Returns an
+   * empty list on timeout, or if all the events were for file descriptors
+   * deleted while waiting.
+   */
+  Result<std::vector<EpollEvent>> WaitMany(size_t max_events, int timeout = -1);
 
  private:
   Epoll(SharedFD);
@@ -61,11 +71,19 @@ class Epoll {
   std::shared_mutex epoll_mutex_;
   SharedFD epoll_fd_;
   /**
-   * This read-write mutex is read-locked when interacting with it as a const
-   * std::set, and write-locked when interacting with it as a std::set.
+   * This read-write mutex is read-locked when reading watched_ and
+   * watched_by_id_, and write-locked when modifying them.
    */
   std::shared_mutex watched_mutex_;
-  std::set<SharedFD> watched_;
+  /**
+   * Every watched file descriptor gets an id that is never reused, which is
+   * stored in the kernel's epoll_event.data so that events map back to their
+   * SharedFD in constant time, and events for file descriptors deleted while
+   * waiting, even if the number was reused since, are recognized as stale.
+   */
+  std::map<SharedFD, uint64_t> watched_;
+  std::unordered_map<uint64_t, SharedFD> watched_by_id_;
+  uint64_t next_id_ = 0;
 };
 
 }  // namespace cuttlefish
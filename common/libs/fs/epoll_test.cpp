@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "common/libs/fs/epoll.h"
+
+#include <sys/epoll.h>
+
+#include <set>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "common/libs/fs/shared_fd.h"
+
+namespace cuttlefish {
+
+TEST(Epoll, WaitManyReturnsAllReadyFds) {
+  auto epoll = Epoll::Create();
+  ASSERT_TRUE(epoll.ok()) << epoll.error().Trace();
+
+  std::vector<SharedFD> events;
+  for (int i = 0; i < 4; i++) {
+    events.push_back(SharedFD::Event());
+    ASSERT_TRUE(events.back()->IsOpen());
+    ASSERT_TRUE(epoll->Add(events.back(), EPOLLIN).ok());
+    ASSERT_EQ(events.back()->EventfdWrite(1), 0);
+  }
+
+  auto ready = epoll->WaitMany(16, 0);
+  ASSERT_TRUE(ready.ok()) << ready.error().Trace();
+  ASSERT_EQ(ready->size(), events.size());
+  std::set<SharedFD> ready_fds;
+  for (const auto& event : *ready) {
+    EXPECT_EQ(event.events, EPOLLIN);
+    ready_fds.insert(event.fd);
+  }
+  EXPECT_EQ(ready_fds, std::set<SharedFD>(events.begin(), events.end()));
+}
+
+TEST(Epoll, WaitManyHonorsMaxEvents) {
+  auto epoll = Epoll::Create();
+  ASSERT_TRUE(epoll.ok()) << epoll.error().Trace();
+
+  std::vector<SharedFD> events;
+  for (int i = 0; i < 3; i++) {
+    events.push_back(SharedFD::Event(1));
+    ASSERT_TRUE(epoll->Add(events.back(), EPOLLIN).ok());
+  }
+
+  auto ready = epoll->WaitMany(2, 0);
+  ASSERT_TRUE(ready.ok()) << ready.error().Trace();
+  EXPECT_EQ(ready->size(), 2);
+}
+
+TEST(Epoll, WaitManyTimesOut) {
+  auto epoll = Epoll::Create();
+  ASSERT_TRUE(epoll.ok()) << epoll.error().Trace();
+
+  auto idle = SharedFD::Event();
+  ASSERT_TRUE(epoll->Add(idle, EPOLLIN).ok());
+
+  auto ready = epoll->WaitMany(4, 10);
+  ASSERT_TRUE(ready.ok()) << ready.error().Trace();
+  EXPECT_TRUE(ready->empty());
+}
+
+TEST(Epoll, DeletedFdsAreNotReported) {
+  auto epoll = Epoll::Create();
+  ASSERT_TRUE(epoll.ok()) << epoll.error().Trace();
+
+  auto deleted = SharedFD::Event(1);
+  auto kept = SharedFD::Event(1);
+  ASSERT_TRUE(epoll->Add(deleted, EPOLLIN).ok());
+  ASSERT_TRUE(epoll->Add(kept, EPOLLIN).ok());
+  ASSERT_TRUE(epoll->Delete(deleted).ok());
+
+  auto ready = epoll->WaitMany(4, 0);
+  ASSERT_TRUE(ready.ok()) << ready.error().Trace();
+  ASSERT_EQ(ready->size(), 1);
+  EXPECT_EQ((*ready)[0].fd, kept);
+}
+
+TEST(Epoll, ModifyKeepsMapping) {
+  auto epoll = Epoll::Create();
+  ASSERT_TRUE(epoll.ok()) << epoll.error().Trace();
+
+  auto fd = SharedFD::Event(1);
+  ASSERT_TRUE(epoll->Add(fd, EPOLLOUT).ok());
+  ASSERT_TRUE(epoll->AddOrModify(fd, EPOLLIN).ok());
+
+  auto event = epoll->Wait();
+  ASSERT_TRUE(event.ok()) << event.error().Trace();
+  ASSERT_TRUE(event->has_value());
+  EXPECT_EQ((*event)->fd, fd);
+  EXPECT_EQ((*event)->events, EPOLLIN);
+}
+
+}  // namespace cuttlefish
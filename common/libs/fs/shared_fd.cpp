@@ -161,6 +161,15 @@ bool FileInstance::CopyAllFrom(FileInstance& in) {
   return !GetErrno() && !in.GetErrno();
 }
 
+ssize_t FileInstance::SpliceFrom(FileInstance& in, size_t length,
+                                 unsigned int flags) {
+  errno = 0;
+  ssize_t rval = TEMP_FAILURE_RETRY(
+      splice(in.fd_, nullptr, fd_, nullptr, length, flags));
+  errno_ = errno;
+  return rval;
+}
+
 void FileInstance::Close() {
   std::stringstream message;
   if (fd_ == -1) {
@@ -813,6 +822,20 @@ ssize_t FileInstance::Read(void* buf, size_t count) {
   return rval;
 }
 
+ssize_t FileInstance::PRead(void* buf, size_t count, off_t offset) {
+  errno = 0;
+  ssize_t rval = TEMP_FAILURE_RETRY(pread(fd_, buf, count, offset));
+  errno_ = errno;
+  return rval;
+}
+
+int FileInstance::Fdatasync() {
+  errno = 0;
+  int rval = TEMP_FAILURE_RETRY(fdatasync(fd_));
+  errno_ = errno;
+  return rval;
+}
+
 int FileInstance::EventfdRead(eventfd_t* value) {
   errno = 0;
   auto rval = eventfd_read(fd_, value);
@@ -901,6 +924,13 @@ ssize_t FileInstance::Write(const void* buf, size_t count) {
   return rval;
 }
 
+ssize_t FileInstance::PWrite(const void* buf, size_t count, off_t offset) {
+  errno = 0;
+  ssize_t rval = TEMP_FAILURE_RETRY(pwrite(fd_, buf, count, offset));
+  errno_ = errno;
+  return rval;
+}
+
 int FileInstance::EventfdWrite(eventfd_t value) {
   errno = 0;
   int rval = eventfd_write(fd_, value);
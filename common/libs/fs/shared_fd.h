@@ -270,6 +270,10 @@ class FileInstance {
   bool CopyFrom(FileInstance& in, size_t length);
   // Same as CopyFrom, but reads from input until EOF is reached.
   bool CopyAllFrom(FileInstance& in);
+  // Moves up to length bytes from in to this file inside the kernel, see
+  // splice(2). One of the two files must be a pipe. Errors are set on this
+  // file.
+  ssize_t SpliceFrom(FileInstance& in, size_t length, unsigned int flags);
 
   int UNMANAGED_Dup();
   int UNMANAGED_Dup2(int newfd);
@@ -308,7 +312,10 @@ class FileInstance {
   ssize_t Recv(void* buf, size_t len, int flags);
   ssize_t RecvMsg(struct msghdr* msg, int flags);
   ssize_t Read(void* buf, size_t count);
+  // Reads at the given offset without moving the file position.
+  ssize_t PRead(void* buf, size_t count, off_t offset);
   int EventfdRead(eventfd_t* value);
+  int Fdatasync();
   ssize_t Send(const void* buf, size_t len, int flags);
   ssize_t SendMsg(const struct msghdr* msg, int flags);
 
@@ -339,6 +346,8 @@ class FileInstance {
    *
    */
   ssize_t Write(const void* buf, size_t count);
+  // Writes at the given offset without moving the file position.
+  ssize_t PWrite(const void* buf, size_t count, off_t offset);
   int EventfdWrite(eventfd_t value);
   bool IsATTY();
 
@@ -205,63 +205,100 @@ bool SendFile(int out_fd, int in_fd, off64_t* offset, size_t count) {
   return true;
 }
 
+// Copies `length` bytes at `offset` from `fd_from` to the same offset in
+// `fd_to`. Switches to sendfile for good if copy_file_range isn't supported
+// between the two files.
+Result<void> CopyRange(int fd_from, int fd_to, off64_t offset, off64_t length,
+                       bool* use_copy_file_range) {
+  while (length > 0 && *use_copy_file_range) {
+    off64_t out_offset = offset;
+    auto copied = copy_file_range(fd_from, &offset, fd_to, &out_offset, length,
+                                  0);
+    if (copied < 0 && (errno == EXDEV || errno == EINVAL || errno == ENOSYS ||
+                       errno == EOPNOTSUPP)) {
+      *use_copy_file_range = false;
+      break;
+    }
+    CF_EXPECT(copied > 0, "copy_file_range() failed: " << strerror(errno));
+    length -= copied;
+  }
+  if (length > 0) {
+    CF_EXPECT(lseek(fd_to, offset, SEEK_SET) == offset,
+              "lseek() failed: " << strerror(errno));
+    CF_EXPECT(SendFile(fd_to, fd_from, &offset, length),
+              "sendfile() failed: " << strerror(errno));
+  }
+  return {};
+}
+
 }  // namespace
 
-bool Copy(const std::string& from, const std::string& to) {
+std::ostream& operator<<(std::ostream& out, CopyMethod method) {
+  switch (method) {
+    case CopyMethod::kReflink:
+      return out << "reflink";
+    case CopyMethod::kCopyFileRange:
+      return out << "copy_file_range";
+    case CopyMethod::kSendFile:
+      return out << "sendfile";
+  }
+  return out << "unknown";
+}
+
+Result<CopyMethod> CopyFile(const std::string& from, const std::string& to) {
   android::base::unique_fd fd_from(
       open(from.c_str(), O_RDONLY | O_CLOEXEC));
+  CF_EXPECT(fd_from.get() >= 0,
+            "Could not open \"" << from << "\": " << strerror(errno));
   android::base::unique_fd fd_to(
       open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644));
+  CF_EXPECT(fd_to.get() >= 0,
+            "Could not open \"" << to << "\": " << strerror(errno));
 
-  if (fd_from.get() < 0 || fd_to.get() < 0) {
-    return false;
+  // Only works within a btrfs or xfs file system, but it makes the copy
+  // nearly free regardless of the file size.
+  if (ioctl(fd_to.get(), FICLONE, fd_from.get()) == 0) {
+    return CopyMethod::kReflink;
   }
 
   off_t farthest_seek = lseek(fd_from.get(), 0, SEEK_END);
-  if (farthest_seek == -1) {
-    PLOG(ERROR) << "Could not lseek in \"" << from << "\"";
-    return false;
-  }
-  if (ftruncate64(fd_to.get(), farthest_seek) < 0) {
-    PLOG(ERROR) << "Failed to ftruncate " << to;
-  }
+  CF_EXPECT(farthest_seek != -1,
+            "Could not lseek in \"" << from << "\": " << strerror(errno));
+  CF_EXPECT(ftruncate64(fd_to.get(), farthest_seek) == 0,
+            "Failed to ftruncate \"" << to << "\": " << strerror(errno));
+
+  bool use_copy_file_range = true;
   off_t offset = 0;
   while (offset < farthest_seek) {
-    off_t new_offset = lseek(fd_from.get(), offset, SEEK_HOLE);
-    if (new_offset == -1) {
+    off_t data = lseek(fd_from.get(), offset, SEEK_DATA);
+    if (data == -1) {
       // ENXIO is returned when there are no more blocks of this type
       // coming.
-      if (errno == ENXIO) {
-        return true;
-      }
-      PLOG(ERROR) << "Could not lseek in \"" << from << "\"";
-      return false;
-    }
-    auto data_bytes = new_offset - offset;
-    if (lseek(fd_to.get(), offset, SEEK_SET) < 0) {
-      PLOG(ERROR) << "lseek() on " << to << " failed";
-      return false;
-    }
-    if (!SendFile(fd_to.get(), fd_from.get(), &offset, data_bytes)) {
-      PLOG(ERROR) << "sendfile() failed";
-      return false;
-    }
-    CHECK_EQ(offset, new_offset);
-    if (offset >= farthest_seek) {
-      return true;
-    }
-    new_offset = lseek(fd_from.get(), offset, SEEK_DATA);
-    if (new_offset == -1) {
-      // ENXIO is returned when there are no more blocks of this type
-      // coming.
-      if (errno == ENXIO) {
-        return true;
-      }
-      PLOG(ERROR) << "Could not lseek in \"" << from << "\"";
-      return false;
+      CF_EXPECT(errno == ENXIO,
+                "Could not lseek in \"" << from << "\": " << strerror(errno));
+      break;
     }
-    offset = new_offset;
+    off_t hole = lseek(fd_from.get(), data, SEEK_HOLE);
+    CF_EXPECT(hole != -1,
+              "Could not lseek in \"" << from << "\": " << strerror(errno));
+    CF_EXPECT(CopyRange(fd_from.get(), fd_to.get(), data, hole - data,
+                        &use_copy_file_range),
+              "Failed to copy \"" << from << "\" to \"" << to << "\"");
+    offset = hole;
+  }
+  return use_copy_file_range ? CopyMethod::kCopyFileRange
+                             : CopyMethod::kSendFile;
+}
+
+bool Copy(const std::string& from, const std::string& to) {
+  auto method = CopyFile(from, to);
+  if (!method.ok()) {
+    LOG(ERROR) << method.error().Message();
+    LOG(DEBUG) << method.error().Trace();
+    return false;
   }
+  LOG(DEBUG) << "Copied \"" << from << "\" to \"" << to << "\" using "
+             << *method;
   return true;
 }
 
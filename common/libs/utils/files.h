@@ -19,6 +19,7 @@
 #include <sys/types.h>
 
 #include <chrono>
+#include <ostream>
 #include <string>
 #include <vector>
 
@@ -39,6 +40,21 @@ bool CanAccess(const std::string& path, const int mode);
 bool IsDirectoryEmpty(const std::string& path);
 bool RecursivelyRemoveDirectory(const std::string& path);
 bool Copy(const std::string& from, const std::string& to);
+
+// How CopyFile duplicated the contents of a file, from fastest to slowest.
+enum class CopyMethod {
+  // The destination shares the extents of the source until either is written.
+  kReflink,
+  // The data was copied in the kernel with copy_file_range.
+  kCopyFileRange,
+  // The data was copied with sendfile.
+  kSendFile,
+};
+std::ostream& operator<<(std::ostream& out, CopyMethod method);
+
+// Copies `from` into `to`, preserving holes. A reflink is tried first, then
+// copy_file_range and finally sendfile on each data extent of `from`.
+Result<CopyMethod> CopyFile(const std::string& from, const std::string& to);
 off_t FileSize(const std::string& path);
 bool RemoveFile(const std::string& file);
 Result<std::string> RenameFile(const std::string& current_filepath,
@@ -0,0 +1,87 @@
+//
+// Copyright (C) 2023 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+
+#include "common/libs/utils/files.h"
+
+namespace cuttlefish {
+namespace {
+
+class CopyFileTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    char dir_template[] = "/tmp/files_test.XXXXXX";
+    ASSERT_NE(mkdtemp(dir_template), nullptr);
+    dir_ = dir_template;
+  }
+
+  void TearDown() override { RecursivelyRemoveDirectory(dir_); }
+
+  std::string dir_;
+};
+
+TEST_F(CopyFileTest, CopiesContentsAndSize) {
+  auto from = dir_ + "/from";
+  auto to = dir_ + "/to";
+  ASSERT_TRUE(android::base::WriteStringToFile("hello world", from));
+
+  auto method = CopyFile(from, to);
+
+  ASSERT_TRUE(method.ok()) << method.error().Trace();
+  EXPECT_EQ(ReadFile(to), "hello world");
+}
+
+TEST_F(CopyFileTest, PreservesHoles) {
+  constexpr off_t kSize = 16 << 20;
+  auto from = dir_ + "/from";
+  auto to = dir_ + "/to";
+  {
+    android::base::unique_fd fd(
+        open(from.c_str(), O_CREAT | O_WRONLY | O_CLOEXEC, 0644));
+    ASSERT_GE(fd.get(), 0);
+    ASSERT_EQ(ftruncate(fd.get(), kSize), 0);
+    ASSERT_TRUE(android::base::WriteFullyAtOffset(fd, "start", 5, 0));
+    ASSERT_TRUE(android::base::WriteFullyAtOffset(fd, "end", 3, kSize - 3));
+  }
+
+  auto method = CopyFile(from, to);
+
+  ASSERT_TRUE(method.ok()) << method.error().Trace();
+  EXPECT_EQ(ReadFile(to), ReadFile(from));
+  auto sizes = SparseFileSizes(to);
+  EXPECT_EQ(sizes.sparse_size, kSize);
+  // Only the two data blocks should be allocated, unless the file system
+  // doesn't support holes at all.
+  if (SparseFileSizes(from).disk_size < kSize) {
+    EXPECT_LT(sizes.disk_size, kSize);
+  }
+}
+
+TEST_F(CopyFileTest, FailsOnMissingSource) {
+  EXPECT_FALSE(CopyFile(dir_ + "/missing", dir_ + "/to").ok());
+  EXPECT_FALSE(Copy(dir_ + "/missing", dir_ + "/to"));
+}
+
+}  // namespace
+}  // namespace cuttlefish
@@ -238,6 +238,42 @@ Result<std::unordered_map<std::string, std::string>> GetEnvs(const pid_t pid) {
   return envs;
 }
 
+Result<ProcStat> GetProcStat(const pid_t pid) {
+  std::string stat_file_path = PidDirPath(pid) + "/stat";
+  std::string contents = CF_EXPECT(ReadAll(stat_file_path));
+  // ReadAll pads the contents with null characters
+  contents = contents.substr(0, contents.find('\0'));
+  // The command name is enclosed in parentheses and may contain spaces or
+  // parentheses itself, so look for the last closing one.
+  auto command_begin = contents.find('(');
+  auto command_end = contents.rfind(')');
+  CF_EXPECT(command_begin != std::string::npos &&
+                command_end != std::string::npos &&
+                command_begin < command_end,
+            "Malformed " << stat_file_path << ": " << contents);
+  std::vector<std::string> fields =
+      android::base::Tokenize(contents.substr(command_end + 1), " \n");
+  // fields[0] is the state, the 3rd field in proc(5)
+  auto field = [&fields, &stat_file_path](size_t number) -> Result<std::string> {
+    CF_EXPECT(number - 3 < fields.size(),
+              stat_file_path << " has only " << fields.size() + 2
+                             << " fields");
+    return fields[number - 3];
+  };
+  ProcStat stat;
+  CF_EXPECT(android::base::ParseInt(
+      android::base::Trim(contents.substr(0, command_begin)), &stat.pid_));
+  stat.command_ =
+      contents.substr(command_begin + 1, command_end - command_begin - 1);
+  stat.state_ = CF_EXPECT(field(3)).front();
+  CF_EXPECT(android::base::ParseInt(CF_EXPECT(field(4)), &stat.ppid_));
+  CF_EXPECT(android::base::ParseInt(CF_EXPECT(field(5)), &stat.pgrp_));
+  CF_EXPECT(android::base::ParseUint(CF_EXPECT(field(14)), &stat.utime_));
+  CF_EXPECT(android::base::ParseUint(CF_EXPECT(field(15)), &stat.stime_));
+  CF_EXPECT(android::base::ParseInt(CF_EXPECT(field(24)), &stat.rss_));
+  return stat;
+}
+
 Result<ProcInfo> ExtractProcInfo(const pid_t pid) {
   return ProcInfo{.pid_ = pid,
                   .actual_exec_path_ = CF_EXPECT(GetExecutablePath(pid)),
@@ -19,6 +19,7 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <cstdint>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -42,6 +43,21 @@ struct ProcInfo {
 };
 Result<ProcInfo> ExtractProcInfo(const pid_t pid);
 
+// Selected fields of /proc/<pid>/stat, see proc(5)
+struct ProcStat {
+  pid_t pid_;
+  std::string command_;
+  char state_;
+  pid_t ppid_;
+  pid_t pgrp_;
+  // Time spent in user and kernel mode, in clock ticks
+  uint64_t utime_;
+  uint64_t stime_;
+  // Resident set size, in pages
+  int64_t rss_;
+};
+Result<ProcStat> GetProcStat(const pid_t pid);
+
 // collects all pids whose owner is uid
 Result<std::vector<pid_t>> CollectPids(const uid_t uid = getuid());
 
@@ -43,4 +43,15 @@ TEST(ProcFilePid, CurrentPidCollected) {
   ASSERT_TRUE(Contains(*pids_result, this_pid));
 }
 
+TEST(ProcFileStat, SelfStat) {
+  auto stat = GetProcStat(getpid());
+
+  ASSERT_TRUE(stat.ok()) << stat.error().Trace();
+  ASSERT_EQ(stat->pid_, getpid());
+  ASSERT_EQ(stat->ppid_, getppid());
+  ASSERT_EQ(stat->pgrp_, getpgrp());
+  ASSERT_EQ(stat->state_, 'R');
+  ASSERT_GT(stat->rss_, 0);
+}
+
 }  // namespace cuttlefish
@@ -16,43 +16,313 @@
 
 #include "common/libs/utils/socket2socket_proxy.h"
 
+#include <fcntl.h>
 #include <poll.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
 
+#include <atomic>
 #include <cstring>
 #include <functional>
+#include <map>
 #include <memory>
 #include <ostream>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include <android-base/logging.h>
 
+#include "common/libs/fs/epoll.h"
+
 namespace cuttlefish {
+
+struct ProxyConnectionCounters {
+  std::atomic<std::uint64_t> client_to_target_bytes{0};
+  std::atomic<std::uint64_t> target_to_client_bytes{0};
+  std::atomic<bool> closed{false};
+};
+
 namespace {
 
-void Forward(const std::string& label, SharedFD from, SharedFD to) {
-  LOG(DEBUG) << label << ": Proxy thread started. Starting copying data";
-  auto success = to->CopyAllFrom(*from);
-  if (!success) {
-    if (from->GetErrno()) {
-      LOG(ERROR) << label << ": Error reading: " << from->StrError();
+// The default capacity of a pipe, and so the most a single splice() into an
+// empty pipe can move.
+constexpr size_t kPipeCapacity = 64 * 1024;
+
+// The most events handled per wakeup of the forwarding thread.
+constexpr size_t kMaxEventsPerWait = 32;
+
+bool SetNonBlocking(SharedFD fd) {
+  int flags = fd->Fcntl(F_GETFL, 0);
+  if (flags == -1) {
+    return false;
+  }
+  return fd->Fcntl(F_SETFL, flags | O_NONBLOCK) != -1;
+}
+
+bool WouldBlock(int error) { return error == EAGAIN || error == EWOULDBLOCK; }
+
+// Forwards the data flowing in one direction of a proxied connection. Data
+// is moved from one socket to the other through a pipe with splice(), falling
+// back to copying through a buffer when the sockets don't support splicing.
+// Never blocks, both sockets must be in non-blocking mode.
+class ProxyDirection {
+ public:
+  ProxyDirection(std::string label, SharedFD from, SharedFD to,
+                 std::atomic<std::uint64_t>& bytes)
+      : label_(std::move(label)), from_(from), to_(to), bytes_(bytes) {
+    if (!SharedFD::Pipe(&pipe_read_, &pipe_write_) ||
+        !SetNonBlocking(pipe_read_) || !SetNonBlocking(pipe_write_)) {
+      LOG(WARNING) << label_ << ": Failed to create pipe, copying instead";
+      FallBackToCopying();
     }
-    if (to->GetErrno()) {
-      LOG(ERROR) << label << ": Error writing: " << to->StrError();
+  }
+
+  // Moves as much data as possible without blocking.
+  void Pump() {
+    while (!closed_) {
+      if (pending_ > 0) {
+        if (!Drain()) {
+          return;
+        }
+        continue;
+      }
+      if (read_done_) {
+        to_->Shutdown(SHUT_WR);
+        closed_ = true;
+        LOG(DEBUG) << label_ << ": Proxy completed after " << bytes_
+                   << " bytes";
+        return;
+      }
+      if (!Fill()) {
+        return;
+      }
     }
   }
-  to->Shutdown(SHUT_WR);
-  LOG(DEBUG) << label << ": Proxy thread completed";
-}
 
-void SetupProxying(SharedFD client, SharedFD target) {
-  LOG(DEBUG) << "Launching proxy threads";
-  std::thread client2target(Forward, "c2t", client, target);
-  std::thread target2client(Forward, "t2c", target, client);
-  client2target.detach();
-  target2client.detach();
-}
+  bool WantsRead() const { return !closed_ && !read_done_ && pending_ == 0; }
+  bool WantsWrite() const { return !closed_ && pending_ > 0; }
+  bool Closed() const { return closed_; }
+
+ private:
+  // Returns false if reading would block.
+  bool Fill() {
+    ssize_t num_read;
+    int error;
+    if (use_splice_) {
+      num_read = pipe_write_->SpliceFrom(*from_, kPipeCapacity,
+                                         SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+      error = pipe_write_->GetErrno();
+    } else {
+      num_read = from_->Read(buffer_.data(), buffer_.size());
+      error = from_->GetErrno();
+    }
+    if (num_read < 0) {
+      if (WouldBlock(error)) {
+        return false;
+      }
+      if (use_splice_ && error == EINVAL) {
+        FallBackToCopying();
+        return true;
+      }
+      LOG(ERROR) << label_ << ": Error reading: " << strerror(error);
+      read_done_ = true;
+      return true;
+    }
+    if (num_read == 0) {
+      read_done_ = true;
+      return true;
+    }
+    pending_ = num_read;
+    buffer_begin_ = 0;
+    return true;
+  }
+
+  // Returns false if writing would block or failed.
+  bool Drain() {
+    ssize_t written;
+    if (use_splice_) {
+      written = to_->SpliceFrom(*pipe_read_, pending_,
+                                SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    } else {
+      written = to_->Write(buffer_.data() + buffer_begin_, pending_);
+    }
+    if (written < 0) {
+      if (WouldBlock(to_->GetErrno())) {
+        return false;
+      }
+      if (use_splice_ && to_->GetErrno() == EINVAL) {
+        FallBackToCopying();
+        return true;
+      }
+      // The data can't go anywhere, so stop forwarding in this direction.
+      LOG(ERROR) << label_ << ": Error writing: " << to_->StrError();
+      to_->Shutdown(SHUT_WR);
+      closed_ = true;
+      return false;
+    }
+    pending_ -= written;
+    buffer_begin_ += written;
+    bytes_ += written;
+    return true;
+  }
+
+  void FallBackToCopying() {
+    buffer_.resize(kPipeCapacity);
+    buffer_begin_ = 0;
+    if (pending_ > 0) {
+      // Pending data is in the pipe, move it to the buffer. The pipe holds
+      // exactly pending_ bytes, so a single read gets them all.
+      ssize_t num_read = pipe_read_->Read(buffer_.data(), pending_);
+      if (num_read != static_cast<ssize_t>(pending_)) {
+        LOG(ERROR) << label_ << ": Lost data moving it out of the pipe: "
+                   << pipe_read_->StrError();
+        pending_ = num_read > 0 ? num_read : 0;
+      }
+    }
+    use_splice_ = false;
+    pipe_read_ = SharedFD();
+    pipe_write_ = SharedFD();
+  }
+
+  std::string label_;
+  SharedFD from_;
+  SharedFD to_;
+  std::atomic<std::uint64_t>& bytes_;
+  bool use_splice_ = true;
+  SharedFD pipe_read_;
+  SharedFD pipe_write_;
+  std::vector<char> buffer_;
+  size_t buffer_begin_ = 0;
+  // Bytes read but not yet written, in the pipe or the buffer.
+  size_t pending_ = 0;
+  bool read_done_ = false;
+  bool closed_ = false;
+};
+
+struct ProxyConnection {
+  ProxyConnection(SharedFD client, SharedFD target,
+                  std::shared_ptr<ProxyConnectionCounters> counters)
+      : client(client),
+        target(target),
+        counters(std::move(counters)),
+        client_to_target("c2t", client, target,
+                         this->counters->client_to_target_bytes),
+        target_to_client("t2c", target, client,
+                         this->counters->target_to_client_bytes) {}
+
+  SharedFD client;
+  SharedFD target;
+  std::shared_ptr<ProxyConnectionCounters> counters;
+  ProxyDirection client_to_target;
+  ProxyDirection target_to_client;
+  bool client_watched = false;
+  bool target_watched = false;
+};
+
+// Forwards the data of every proxied connection of the process on a single
+// thread, driven by an epoll loop.
+class ProxyEngine {
+ public:
+  static ProxyEngine& Get() {
+    // Never destroyed, connections may outlive any of the proxy servers.
+    static ProxyEngine* engine = new ProxyEngine();
+    return *engine;
+  }
+
+  void AddConnection(SharedFD client, SharedFD target,
+                     std::shared_ptr<ProxyConnectionCounters> counters) {
+    if (!SetNonBlocking(client) || !SetNonBlocking(target)) {
+      LOG(ERROR) << "Failed to make proxied sockets non-blocking";
+      counters->closed = true;
+      return;
+    }
+    auto connection =
+        std::make_shared<ProxyConnection>(client, target, std::move(counters));
+    std::lock_guard<std::mutex> lock(mutex_);
+    connections_[client] = connection;
+    connections_[target] = connection;
+    UpdateWatches(*connection);
+  }
+
+ private:
+  ProxyEngine() {
+    auto epoll = Epoll::Create();
+    CHECK(epoll.ok()) << epoll.error().Trace();
+    epoll_ = std::move(*epoll);
+    std::thread([this]() { Loop(); }).detach();
+  }
+
+  [[noreturn]] void Loop() {
+    for (;;) {
+      auto events = epoll_.WaitMany(kMaxEventsPerWait);
+      if (!events.ok()) {
+        LOG(ERROR) << events.error().Trace();
+        continue;
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (const auto& event : *events) {
+        auto it = connections_.find(event.fd);
+        if (it == connections_.end()) {
+          // Closed while handling an earlier event of the batch.
+          continue;
+        }
+        // Hold a reference, UpdateWatches may drop the last one in the map.
+        auto connection = it->second;
+        connection->client_to_target.Pump();
+        connection->target_to_client.Pump();
+        UpdateWatches(*connection);
+      }
+    }
+  }
+
+  // Must be called with mutex_ held.
+  void UpdateWatches(ProxyConnection& connection) {
+    if (connection.client_to_target.Closed() &&
+        connection.target_to_client.Closed()) {
+      Watch(connection.client, 0, connection.client_watched);
+      Watch(connection.target, 0, connection.target_watched);
+      connection.counters->closed = true;
+      connections_.erase(connection.client);
+      connections_.erase(connection.target);
+      return;
+    }
+    const uint32_t client_events =
+        (connection.client_to_target.WantsRead() ? EPOLLIN : 0) |
+        (connection.target_to_client.WantsWrite() ? EPOLLOUT : 0);
+    const uint32_t target_events =
+        (connection.target_to_client.WantsRead() ? EPOLLIN : 0) |
+        (connection.client_to_target.WantsWrite() ? EPOLLOUT : 0);
+    Watch(connection.client, client_events, connection.client_watched);
+    Watch(connection.target, target_events, connection.target_watched);
+  }
+
+  // Sockets nobody is waiting on are removed from the epoll set, otherwise a
+  // hang up would be reported over and over.
+  void Watch(SharedFD fd, uint32_t events, bool& watched) {
+    if (events == 0) {
+      if (watched) {
+        auto result = epoll_.Delete(fd);
+        if (!result.ok()) {
+          LOG(ERROR) << result.error().Trace();
+        }
+        watched = false;
+      }
+      return;
+    }
+    auto result = epoll_.AddOrModify(fd, events);
+    if (!result.ok()) {
+      LOG(ERROR) << result.error().Trace();
+      return;
+    }
+    watched = true;
+  }
+
+  Epoll epoll_;
+  std::mutex mutex_;
+  // Every connection is present twice, keyed by the client and the target.
+  std::map<SharedFD, std::shared_ptr<ProxyConnection>> connections_;
+};
 
 }  // namespace
 
@@ -100,7 +370,26 @@ ProxyServer::ProxyServer(SharedFD server, std::function<SharedFD()> clients_fact
       }
       auto target = clients_factory();
       if (target->IsOpen()) {
-        SetupProxying(client, target);
+        LOG(DEBUG) << "Starting to proxy a new connection";
+        auto counters = std::make_shared<ProxyConnectionCounters>();
+        {
+          std::lock_guard<std::mutex> lock(connections_mutex_);
+          // Fold the counters of closed connections into the totals so the
+          // list doesn't grow forever.
+          for (auto it = connections_.begin(); it != connections_.end();) {
+            if ((*it)->closed) {
+              closed_connections_stats_.client_to_target_bytes +=
+                  (*it)->client_to_target_bytes;
+              closed_connections_stats_.target_to_client_bytes +=
+                  (*it)->target_to_client_bytes;
+              it = connections_.erase(it);
+            } else {
+              ++it;
+            }
+          }
+          connections_.push_back(counters);
+        }
+        ProxyEngine::Get().AddConnection(client, target, std::move(counters));
       } else {
         LOG(ERROR) << "Cannot connect to the target to setup proxying: " << target->StrError();
       }
@@ -123,6 +412,30 @@ ProxyServer::~ProxyServer() {
   Join();
 }
 
+std::vector<ProxyConnectionStats> ProxyServer::ActiveConnectionStats() {
+  std::lock_guard<std::mutex> lock(connections_mutex_);
+  std::vector<ProxyConnectionStats> stats;
+  for (const auto& connection : connections_) {
+    if (!connection->closed) {
+      stats.push_back(ProxyConnectionStats{
+          .client_to_target_bytes = connection->client_to_target_bytes,
+          .target_to_client_bytes = connection->target_to_client_bytes,
+      });
+    }
+  }
+  return stats;
+}
+
+ProxyConnectionStats ProxyServer::TotalStats() {
+  std::lock_guard<std::mutex> lock(connections_mutex_);
+  ProxyConnectionStats stats = closed_connections_stats_;
+  for (const auto& connection : connections_) {
+    stats.client_to_target_bytes += connection->client_to_target_bytes;
+    stats.target_to_client_bytes += connection->target_to_client_bytes;
+  }
+  return stats;
+}
+
 void Proxy(SharedFD server, std::function<SharedFD()> conn_factory) {
   ProxyServer proxy(std::move(server), std::move(conn_factory));
   proxy.Join();
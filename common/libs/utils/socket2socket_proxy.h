@@ -16,29 +16,52 @@
 
 #pragma once
 
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <thread>
+#include <vector>
 
 #include "common/libs/fs/shared_fd.h"
 
 namespace cuttlefish {
 
+// Bytes forwarded through proxied connections.
+struct ProxyConnectionStats {
+  std::uint64_t client_to_target_bytes = 0;
+  std::uint64_t target_to_client_bytes = 0;
+};
+
+struct ProxyConnectionCounters;
+
 class ProxyServer {
  public:
   ProxyServer(SharedFD server, std::function<SharedFD()> clients_factory);
   void Join();
   ~ProxyServer();
 
+  // Counters of the connections accepted by this server that are still open.
+  std::vector<ProxyConnectionStats> ActiveConnectionStats();
+  // Counters summed over every connection accepted by this server.
+  ProxyConnectionStats TotalStats();
+
  private:
   SharedFD stop_fd_;
   std::thread server_;
+  std::mutex connections_mutex_;
+  std::vector<std::shared_ptr<ProxyConnectionCounters>> connections_;
+  // Sum of the counters of the closed connections dropped from connections_.
+  ProxyConnectionStats closed_connections_stats_;
 };
 
 // Executes a TCP proxy
 // Accept() is called on the server in a loop, for every client connection a
 // target connection is created through the conn_factory callback and data is
 // forwarded between the two connections.
+// Forwarding happens on a single thread per process, shared by all proxies,
+// which moves the data with splice() and keeps forwarding open connections
+// after their server stops.
 // This function is meant to execute forever, but will return if the server is
 // closed in another thread. It's recommended the caller disables the default
 // behavior for SIGPIPE before calling this function, otherwise it runs the risk
@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "common/libs/utils/socket2socket_proxy.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "common/libs/fs/shared_buf.h"
+#include "common/libs/fs/shared_fd.h"
+
+namespace cuttlefish {
+namespace {
+
+class ProxyTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    server_name_ = "socket2socket_proxy_test_" + std::to_string(getpid());
+    auto server = SharedFD::SocketLocalServer(server_name_, true, SOCK_STREAM,
+                                              0666);
+    ASSERT_TRUE(server->IsOpen()) << server->StrError();
+    proxy_ = ProxyAsync(server, [this]() {
+      SharedFD proxy_end, target_end;
+      CHECK(SharedFD::SocketPair(AF_UNIX, SOCK_STREAM, 0, &proxy_end,
+                                 &target_end));
+      std::lock_guard<std::mutex> lock(targets_mutex_);
+      targets_.push_back(target_end);
+      return proxy_end;
+    });
+  }
+
+  SharedFD Connect() {
+    return SharedFD::SocketLocalClient(server_name_, true, SOCK_STREAM);
+  }
+
+  SharedFD Target(size_t index) {
+    // The target is created after the proxy accepts the connection.
+    for (;;) {
+      {
+        std::lock_guard<std::mutex> lock(targets_mutex_);
+        if (targets_.size() > index) {
+          return targets_[index];
+        }
+      }
+      std::this_thread::yield();
+    }
+  }
+
+  std::string server_name_;
+  std::unique_ptr<ProxyServer> proxy_;
+  std::mutex targets_mutex_;
+  std::vector<SharedFD> targets_;
+};
+
+TEST_F(ProxyTest, ForwardsBothWays) {
+  auto client = Connect();
+  ASSERT_TRUE(client->IsOpen()) << client->StrError();
+  auto target = Target(0);
+
+  ASSERT_EQ(WriteAll(client, "ping"), 4);
+  std::string received(4, '\0');
+  ASSERT_EQ(ReadExact(target, &received), 4);
+  EXPECT_EQ(received, "ping");
+
+  ASSERT_EQ(WriteAll(target, "pong!"), 5);
+  received.resize(5);
+  ASSERT_EQ(ReadExact(client, &received), 5);
+  EXPECT_EQ(received, "pong!");
+
+  // Counters are updated right after the data is forwarded, so only those of
+  // an earlier exchange are guaranteed to be up to date.
+  ASSERT_EQ(WriteAll(client, "?"), 1);
+  received.resize(1);
+  ASSERT_EQ(ReadExact(target, &received), 1);
+
+  auto stats = proxy_->ActiveConnectionStats();
+  ASSERT_EQ(stats.size(), 1);
+  EXPECT_GE(stats[0].client_to_target_bytes, 4);
+  EXPECT_EQ(stats[0].target_to_client_bytes, 5);
+}
+
+TEST_F(ProxyTest, ForwardsLargeTransferAndEof) {
+  auto client = Connect();
+  ASSERT_TRUE(client->IsOpen()) << client->StrError();
+  auto target = Target(0);
+
+  // Much larger than the socket and pipe buffers, so the proxy has to wait
+  // for the receiver to make room.
+  std::string sent(8 * 1024 * 1024, '\0');
+  for (size_t i = 0; i < sent.size(); i++) {
+    sent[i] = static_cast<char>(i * 7);
+  }
+  std::thread writer([&client, &sent]() {
+    ASSERT_EQ(WriteAll(client, sent), sent.size());
+    client->Shutdown(SHUT_WR);
+  });
+  std::string received;
+  ASSERT_EQ(ReadAll(target, &received), sent.size());
+  writer.join();
+  EXPECT_EQ(received, sent);
+
+  // The other direction remains usable after the first one is closed.
+  ASSERT_EQ(WriteAll(target, "done"), 4);
+  target->Shutdown(SHUT_WR);
+  std::string reply;
+  ASSERT_EQ(ReadAll(client, &reply), 4);
+  EXPECT_EQ(reply, "done");
+
+  EXPECT_EQ(proxy_->TotalStats().client_to_target_bytes, sent.size());
+}
+
+TEST_F(ProxyTest, ServesConcurrentConnections) {
+  constexpr size_t kConnections = 16;
+  std::vector<SharedFD> clients;
+  for (size_t i = 0; i < kConnections; i++) {
+    clients.push_back(Connect());
+    ASSERT_TRUE(clients.back()->IsOpen()) << clients.back()->StrError();
+    // Wait for the accept so targets_ indices match client indices.
+    Target(i);
+  }
+  for (size_t i = 0; i < kConnections; i++) {
+    ASSERT_EQ(WriteAll(clients[i], std::to_string(i)),
+              std::to_string(i).size());
+    clients[i]->Shutdown(SHUT_WR);
+  }
+  for (size_t i = 0; i < kConnections; i++) {
+    std::string received;
+    ASSERT_EQ(ReadAll(Target(i), &received), std::to_string(i).size());
+    EXPECT_EQ(received, std::to_string(i));
+  }
+}
+
+}  // namespace
+}  // namespace cuttlefish
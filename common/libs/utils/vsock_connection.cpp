@@ -16,9 +16,12 @@
 
 #include "common/libs/utils/vsock_connection.h"
 
+#include <limits.h>
 #include <sys/socket.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 
+#include <algorithm>
 #include <functional>
 #include <future>
 #include <memory>
@@ -37,8 +40,29 @@
 #include "common/libs/fs/shared_select.h"
 
 namespace cuttlefish {
+namespace {
+
+// Adds the rows of the plane to `iov`, as a single buffer when they are
+// contiguous.
+void AppendPlane(std::vector<struct iovec>& iov,
+                 const VsockConnection::FramePlane& plane) {
+  if (plane.stride == static_cast<int>(plane.row_size)) {
+    iov.push_back({const_cast<char*>(plane.data),
+                   static_cast<size_t>(plane.row_size) * plane.rows});
+    return;
+  }
+  const char* row = plane.data;
+  for (unsigned int i = 0; i < plane.rows; ++i, row += plane.stride) {
+    iov.push_back({const_cast<char*>(row), plane.row_size});
+  }
+}
 
-VsockConnection::~VsockConnection() { Disconnect(); }
+}  // namespace
+
+VsockConnection::~VsockConnection() {
+  Disconnect();
+  StopAsyncReads();
+}
 
 std::future<bool> VsockConnection::ConnectAsync(unsigned int port,
                                                 unsigned int cid) {
@@ -96,8 +120,51 @@ std::vector<char> VsockConnection::Read(size_t size) {
   return result;
 }
 
+template <typename T>
+std::future<T> VsockConnection::RunAsync(std::function<T()> read) {
+  // std::function needs a copyable target, which packaged_task is not.
+  auto task = std::make_shared<std::packaged_task<T()>>(std::move(read));
+  auto result = task->get_future();
+  std::lock_guard<std::mutex> lock(async_mutex_);
+  if (!async_thread_.joinable()) {
+    async_thread_ = std::thread([this]() { AsyncReadLoop(); });
+  }
+  async_reads_.emplace_back([task]() { (*task)(); });
+  async_cv_.notify_one();
+  return result;
+}
+
+void VsockConnection::AsyncReadLoop() {
+  std::unique_lock<std::mutex> lock(async_mutex_);
+  while (true) {
+    async_cv_.wait(lock,
+                   [this]() { return async_stopped_ || !async_reads_.empty(); });
+    // Reads still queued when stopping fail right away on the closed fd, and
+    // running them fulfills their futures.
+    if (async_reads_.empty()) {
+      return;
+    }
+    auto read = std::move(async_reads_.front());
+    async_reads_.pop_front();
+    lock.unlock();
+    read();
+    lock.lock();
+  }
+}
+
+void VsockConnection::StopAsyncReads() {
+  {
+    std::lock_guard<std::mutex> lock(async_mutex_);
+    async_stopped_ = true;
+  }
+  async_cv_.notify_one();
+  if (async_thread_.joinable()) {
+    async_thread_.join();
+  }
+}
+
 std::future<std::vector<char>> VsockConnection::ReadAsync(size_t size) {
-  return std::async(std::launch::async, [this, size]() { return Read(size); });
+  return RunAsync<std::vector<char>>([this, size]() { return Read(size); });
 }
 
 // Message format is buffer size followed by buffer data
@@ -123,7 +190,7 @@ bool VsockConnection::ReadMessage(std::vector<char>& data) {
 }
 
 std::future<std::vector<char>> VsockConnection::ReadMessageAsync() {
-  return std::async(std::launch::async, [this]() { return ReadMessage(); });
+  return RunAsync<std::vector<char>>([this]() { return ReadMessage(); });
 }
 
 Json::Value VsockConnection::ReadJsonMessage() {
@@ -139,7 +206,7 @@ Json::Value VsockConnection::ReadJsonMessage() {
 }
 
 std::future<Json::Value> VsockConnection::ReadJsonMessageAsync() {
-  return std::async(std::launch::async, [this]() { return ReadJsonMessage(); });
+  return RunAsync<Json::Value>([this]() { return ReadJsonMessage(); });
 }
 
 bool VsockConnection::Write(int32_t data) {
@@ -182,15 +249,51 @@ bool VsockConnection::WriteMessage(const Json::Value& data) {
 
 bool VsockConnection::WriteStrides(const char* data, unsigned int size,
                                    unsigned int num_strides, int stride_size) {
-  const char* src = data;
-  for (unsigned int i = 0; i < num_strides; ++i, src += stride_size) {
-    if (!Write(src, size)) {
+  std::vector<struct iovec> iov;
+  AppendPlane(iov, {data, size, num_strides, stride_size});
+  return WriteV(iov.data(), iov.size());
+}
+
+bool VsockConnection::WriteV(const struct iovec* iov, size_t iovcnt) {
+  std::lock_guard<std::recursive_mutex> lock(write_mutex_);
+  // sendmsg may send only part of the buffers, so work on a copy that can be
+  // advanced past what was sent.
+  std::vector<struct iovec> pending(iov, iov + iovcnt);
+  size_t next = 0;
+  while (next < pending.size()) {
+    struct msghdr msg = {};
+    msg.msg_iov = &pending[next];
+    msg.msg_iovlen = std::min<size_t>(pending.size() - next, IOV_MAX);
+    auto sent = fd_->SendMsg(&msg, MSG_NOSIGNAL);
+    if (sent < 0) {
+      Disconnect();
       return false;
     }
+    while (next < pending.size() &&
+           static_cast<size_t>(sent) >= pending[next].iov_len) {
+      sent -= pending[next++].iov_len;
+    }
+    if (sent > 0) {
+      pending[next].iov_base = static_cast<char*>(pending[next].iov_base) + sent;
+      pending[next].iov_len -= sent;
+    }
   }
   return true;
 }
 
+// Message format is buffer size followed by buffer data
+bool VsockConnection::WriteFrame(const std::vector<FramePlane>& planes) {
+  int32_t size = 0;
+  for (const auto& plane : planes) {
+    size += plane.row_size * plane.rows;
+  }
+  std::vector<struct iovec> iov = {{&size, sizeof(size)}};
+  for (const auto& plane : planes) {
+    AppendPlane(iov, plane);
+  }
+  return WriteV(iov.data(), iov.size());
+}
+
 bool VsockClientConnection::Connect(unsigned int port, unsigned int cid) {
   fd_ = SharedFD::VsockClient(cid, port, SOCK_STREAM);
   if (!fd_->IsOpen()) {
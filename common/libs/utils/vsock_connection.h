@@ -15,12 +15,18 @@
  */
 #pragma once
 
+#include <sys/uio.h>
+
+#include <condition_variable>
 #include <cstddef>
 #include <cstdint>
+#include <deque>
 #include <functional>
 #include <future>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <json/json.h>
@@ -31,6 +37,15 @@ namespace cuttlefish {
 
 class VsockConnection {
  public:
+  // A plane of an image, made of `rows` rows of `row_size` bytes each
+  // starting `stride` bytes apart.
+  struct FramePlane {
+    const char* data;
+    unsigned int row_size;
+    unsigned int rows;
+    int stride;
+  };
+
   virtual ~VsockConnection();
   virtual bool Connect(unsigned int port, unsigned int cid) = 0;
   virtual void Disconnect();
@@ -59,12 +74,31 @@ class VsockConnection {
   bool WriteMessage(const Json::Value& data);
   bool WriteStrides(const char* data, unsigned int size,
                     unsigned int num_strides, int stride_size);
+  // Writes all the buffers with as few syscalls as possible.
+  bool WriteV(const struct iovec* iov, size_t iovcnt);
+  // Writes the planes as a single message, in the format of WriteMessage.
+  bool WriteFrame(const std::vector<FramePlane>& planes);
 
  protected:
   std::recursive_mutex read_mutex_;
   std::recursive_mutex write_mutex_;
   std::function<void()> disconnect_callback_;
   SharedFD fd_;
+
+ private:
+  // Runs the reads behind the *Async methods one after the other on a
+  // single thread, started by the first of them and kept for the lifetime
+  // of the connection.
+  template <typename T>
+  std::future<T> RunAsync(std::function<T()> read);
+  void AsyncReadLoop();
+  void StopAsyncReads();
+
+  std::mutex async_mutex_;
+  std::condition_variable async_cv_;
+  std::deque<std::function<void()>> async_reads_;
+  bool async_stopped_ = false;
+  std::thread async_thread_;
 };
 
 class VsockClientConnection : public VsockConnection {
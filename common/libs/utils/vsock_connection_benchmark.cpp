@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sys/socket.h>
+
+#include <thread>
+#include <vector>
+
+#include <android-base/logging.h>
+#include <benchmark/benchmark.h>
+
+#include "common/libs/utils/vsock_connection.h"
+
+namespace cuttlefish {
+namespace {
+
+// A connection over one end of a socket pair instead of vsock.
+class SocketPairConnection : public VsockConnection {
+ public:
+  explicit SocketPairConnection(SharedFD fd) { fd_ = fd; }
+  bool Connect(unsigned int, unsigned int) override { return false; }
+};
+
+// Rows padded like the buffers libwebrtc hands to the camera streamer.
+constexpr unsigned int kStridePadding = 32;
+
+// Sends I420 frames of the given height, with a 16:9 width, to a thread
+// reading them as messages like the camera HAL does. The first argument
+// selects the write path: 0 for a write per row, as WriteStrides used to do,
+// and 1 for WriteFrame.
+void BM_SendCameraFrame(benchmark::State& state) {
+  const bool write_frame = state.range(0);
+  const unsigned int height = state.range(1);
+  const unsigned int width = height * 16 / 9;
+  const unsigned int chroma_width = width / 2, chroma_height = height / 2;
+  android::base::SetMinimumLogSeverity(android::base::WARNING);
+
+  SharedFD sender_fd, receiver_fd;
+  CHECK(SharedFD::SocketPair(AF_UNIX, SOCK_STREAM, 0, &sender_fd,
+                             &receiver_fd));
+  SocketPairConnection sender(sender_fd);
+  std::thread receiver([receiver_fd]() {
+    SocketPairConnection connection(receiver_fd);
+    std::vector<char> frame;
+    while (connection.ReadMessage(frame) && !frame.empty()) {
+    }
+  });
+
+  std::vector<char> y((width + kStridePadding) * height);
+  std::vector<char> u((chroma_width + kStridePadding) * chroma_height);
+  std::vector<char> v(u.size());
+  std::vector<VsockConnection::FramePlane> planes = {
+      {y.data(), width, height, static_cast<int>(width + kStridePadding)},
+      {u.data(), chroma_width, chroma_height,
+       static_cast<int>(chroma_width + kStridePadding)},
+      {v.data(), chroma_width, chroma_height,
+       static_cast<int>(chroma_width + kStridePadding)},
+  };
+  int32_t frame_size = width * height + 2 * chroma_width * chroma_height;
+
+  for (auto _ : state) {
+    if (write_frame) {
+      CHECK(sender.WriteFrame(planes));
+      continue;
+    }
+    CHECK(sender.Write(frame_size));
+    for (const auto& plane : planes) {
+      const char* row = plane.data;
+      for (unsigned int i = 0; i < plane.rows; ++i, row += plane.stride) {
+        CHECK(sender.Write(row, plane.row_size));
+      }
+    }
+  }
+  // An empty message tells the reader to stop.
+  CHECK(sender.Write(0));
+  receiver.join();
+
+  state.SetBytesProcessed(state.iterations() * frame_size);
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_SendCameraFrame)
+    ->ArgNames({"write_frame", "height"})
+    ->ArgsProduct({{0, 1}, {480, 720, 1080}})
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace cuttlefish
+
+BENCHMARK_MAIN();
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "common/libs/utils/vsock_connection.h"
+
+#include <sys/socket.h>
+
+#include <future>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace cuttlefish {
+namespace {
+
+// A connection over one end of a socket pair instead of vsock.
+class SocketPairConnection : public VsockConnection {
+ public:
+  explicit SocketPairConnection(SharedFD fd) { fd_ = fd; }
+  bool Connect(unsigned int, unsigned int) override { return false; }
+};
+
+class VsockConnectionTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    SharedFD a, b;
+    ASSERT_TRUE(SharedFD::SocketPair(AF_UNIX, SOCK_STREAM, 0, &a, &b));
+    sender_ = std::make_unique<SocketPairConnection>(a);
+    receiver_ = std::make_unique<SocketPairConnection>(b);
+  }
+
+  std::unique_ptr<SocketPairConnection> sender_;
+  std::unique_ptr<SocketPairConnection> receiver_;
+};
+
+TEST_F(VsockConnectionTest, WriteFrameSendsPlanesAsOneMessage) {
+  // Larger than the socket buffer and with more rows than fit in one
+  // sendmsg, with padding at the end of each row that must be skipped.
+  constexpr unsigned int kWidth = 1280, kHeight = 720, kStride = 1344;
+  std::vector<char> luma(kStride * kHeight);
+  std::vector<char> chroma(kWidth / 2 * kHeight / 2);
+  std::string expected;
+  for (unsigned int row = 0; row < kHeight; row++) {
+    for (unsigned int col = 0; col < kStride; col++) {
+      luma[row * kStride + col] = col < kWidth ? row + col : 'x';
+    }
+    expected.append(&luma[row * kStride], kWidth);
+  }
+  for (size_t i = 0; i < chroma.size(); i++) {
+    chroma[i] = i % 251;
+  }
+  expected.append(chroma.begin(), chroma.end());
+
+  auto received = receiver_->ReadMessageAsync();
+  ASSERT_TRUE(sender_->WriteFrame({
+      {luma.data(), kWidth, kHeight, kStride},
+      {chroma.data(), kWidth / 2, kHeight / 2, kWidth / 2},
+  }));
+  auto message = received.get();
+  EXPECT_EQ(std::string(message.begin(), message.end()), expected);
+}
+
+TEST_F(VsockConnectionTest, WriteStridesSkipsPadding) {
+  const char data[] = "ab--cd--ef--";
+  ASSERT_TRUE(sender_->WriteStrides(data, 2, 3, 4));
+  auto read = receiver_->Read(6);
+  EXPECT_EQ(std::string(read.begin(), read.end()), "abcdef");
+}
+
+TEST_F(VsockConnectionTest, AsyncReadsCompleteInOrder) {
+  auto first = receiver_->ReadMessageAsync();
+  auto second = receiver_->ReadAsync(3);
+  auto third = receiver_->ReadJsonMessageAsync();
+
+  Json::Value json;
+  json["event"] = "VIRTUAL_DEVICE_START_CAMERA_SESSION";
+  ASSERT_TRUE(sender_->WriteMessage(std::string("hello")));
+  ASSERT_TRUE(sender_->Write("abc", 3));
+  ASSERT_TRUE(sender_->WriteMessage(json));
+
+  auto first_message = first.get();
+  EXPECT_EQ(std::string(first_message.begin(), first_message.end()), "hello");
+  auto second_message = second.get();
+  EXPECT_EQ(std::string(second_message.begin(), second_message.end()), "abc");
+  EXPECT_EQ(third.get(), json);
+}
+
+TEST_F(VsockConnectionTest, PendingAsyncReadFailsOnDisconnect) {
+  auto pending = receiver_->ReadMessageAsync();
+  sender_->Disconnect();
+  EXPECT_TRUE(pending.get().empty());
+}
+
+TEST_F(VsockConnectionTest, DestroyingConnectionFinishesPendingReads) {
+  auto pending = receiver_->ReadMessageAsync();
+  receiver_.reset();
+  EXPECT_TRUE(pending.get().empty());
+}
+
+}  // namespace
+}  // namespace cuttlefish
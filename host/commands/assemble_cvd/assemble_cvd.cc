@@ -99,9 +99,11 @@ Result<void> SaveConfig(const CuttlefishConfig& tmp_config_obj) {
   // Save the config object before starting any host process
   CF_EXPECT(tmp_config_obj.SaveToFile(config_file),
             "Failed to save to \"" << config_file << "\"");
+  CF_EXPECT(tmp_config_obj.SaveSnapshot(config_file));
   auto legacy_config_file = GetLegacyConfigFilePath(tmp_config_obj);
   CF_EXPECT(tmp_config_obj.SaveToFile(legacy_config_file),
             "Failed to save to \"" << legacy_config_file << "\"");
+  CF_EXPECT(tmp_config_obj.SaveSnapshot(legacy_config_file));
 
   setenv(kCuttlefishConfigEnvVarName, config_file.c_str(), true);
   if (symlink(config_file.c_str(), config_link.c_str()) != 0) {
@@ -516,11 +516,14 @@ class KernelRamdiskRepacker : public SetupFeature {
       return false;
     }
     const auto new_super_img = instance_.new_super_image();
-    if (!Copy(instance_.super_image(), new_super_img)) {
-      PLOG(ERROR) << "Failed to copy super image " << instance_.super_image()
-                  << " to " << new_super_img;
+    auto copy_method = CopyFile(instance_.super_image(), new_super_img);
+    if (!copy_method.ok()) {
+      LOG(ERROR) << "Failed to copy super image " << instance_.super_image()
+                 << " to " << new_super_img << ": "
+                 << copy_method.error().Message();
       return false;
     }
+    LOG(DEBUG) << "Copied super image using " << *copy_method;
     if (!RepackSuperWithVendorDLKM(new_super_img, new_vendor_dlkm_img)) {
       LOG(ERROR) << "Failed to repack super image with new vendor dlkm image.";
       return false;
@@ -897,6 +900,7 @@ class InitializeMetadataImage : public SetupFeature {
   // SetupFeature
   std::string Name() const override { return "InitializeMetadataImage"; }
   bool Enabled() const override { return true; }
+  bool ParallelSetup() const override { return true; }
 
  private:
   std::unordered_set<SetupFeature*> Dependencies() const override { return {}; }
@@ -925,6 +929,7 @@ class InitializeAccessKregistryImage : public SetupFeature {
   // SetupFeature
   std::string Name() const override { return "InitializeAccessKregistryImage"; }
   bool Enabled() const override { return !instance_.protected_vm(); }
+  bool ParallelSetup() const override { return true; }
 
  private:
   std::unordered_set<SetupFeature*> Dependencies() const override { return {}; }
@@ -953,6 +958,7 @@ class InitializeHwcomposerPmemImage : public SetupFeature {
     return instance_.hwcomposer() != kHwComposerNone &&
            !instance_.protected_vm();
   }
+  bool ParallelSetup() const override { return true; }
 
  private:
   std::unordered_set<SetupFeature*> Dependencies() const override { return {}; }
@@ -977,6 +983,7 @@ class InitializePstore : public SetupFeature {
   // SetupFeature
   std::string Name() const override { return "InitializePstore"; }
   bool Enabled() const override { return !instance_.protected_vm(); }
+  bool ParallelSetup() const override { return true; }
 
  private:
   std::unordered_set<SetupFeature*> Dependencies() const override { return {}; }
@@ -1026,8 +1033,11 @@ class InitializeFactoryResetProtected : public SetupFeature {
       : instance_(instance) {}
 
   // SetupFeature
-  std::string Name() const override { return "InitializeSdCard"; }
+  std::string Name() const override {
+    return "InitializeFactoryResetProtected";
+  }
   bool Enabled() const override { return !instance_.protected_vm(); }
+  bool ParallelSetup() const override { return true; }
 
  private:
   std::unordered_set<SetupFeature*> Dependencies() const override { return {}; }
@@ -1060,6 +1070,7 @@ class InitializeInstanceCompositeDisk : public SetupFeature {
     return "InitializeInstanceCompositeDisk";
   }
   bool Enabled() const override { return true; }
+  bool ParallelSetup() const override { return true; }
 
  private:
   std::unordered_set<SetupFeature*> Dependencies() const override {
@@ -1475,8 +1486,9 @@ Result<void> CreateDynamicDiskFiles(const FetcherConfig& fetcher_config,
       CF_EXPECT(late_injected->LateInject(injector));
     }
 
+    SetupTrace setup_trace;
     const auto& features = injector.getMultibindings<SetupFeature>();
-    CF_EXPECT(SetupFeature::RunSetup(features));
+    CF_EXPECT(SetupFeature::RunSetup(features, &setup_trace));
     fruit::Injector<> instance_injector(DiskChangesPerInstanceComponent,
                                         &fetcher_config, &config, &instance);
     for (auto& late_injected :
@@ -1486,8 +1498,14 @@ Result<void> CreateDynamicDiskFiles(const FetcherConfig& fetcher_config,
 
     const auto& instance_features =
         instance_injector.getMultibindings<SetupFeature>();
-    CF_EXPECT(SetupFeature::RunSetup(instance_features),
+    CF_EXPECT(SetupFeature::RunSetup(instance_features, &setup_trace),
               "instance = \"" << instance.instance_name() << "\"");
+    auto trace_path =
+        instance.PerInstanceInternalPath("assemble_cvd_setup_trace.json");
+    auto trace_written = setup_trace.WriteChromeTrace(trace_path);
+    if (!trace_written.ok()) {
+      LOG(WARNING) << trace_written.error().Message();
+    }
 
     // Check if filling in the sparse image would run out of disk space.
     auto existing_sizes = SparseFileSizes(instance.data_image());
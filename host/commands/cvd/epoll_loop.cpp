@@ -24,6 +24,12 @@
 #include "common/libs/utils/result.h"
 
 namespace cuttlefish {
+namespace {
+
+// The most events collected by a single wakeup.
+constexpr size_t kMaxEventsPerWait = 16;
+
+}  // namespace
 
 EpollPool::EpollPool() {
   auto epoll = Epoll::Create();
@@ -44,20 +50,44 @@ Result<void> EpollPool::Register(SharedFD fd, uint32_t events,
   return {};
 }
 
-Result<void> EpollPool::HandleEvent() {
-  auto event = CF_EXPECT(epoll_.Wait());
-  if (!event) {
-    return {};
+Result<EpollEvent> EpollPool::NextEvent() {
+  std::unique_lock ready_lock(ready_mutex_);
+  while (ready_.empty()) {
+    if (polling_) {
+      ready_cv_.wait(ready_lock);
+      continue;
+    }
+    polling_ = true;
+    ready_lock.unlock();
+    auto events = epoll_.WaitMany(kMaxEventsPerWait);
+    ready_lock.lock();
+    polling_ = false;
+    if (events.ok()) {
+      ready_.insert(ready_.end(), events->begin(), events->end());
+    }
+    // Either hand out the new events or let another thread take over polling.
+    ready_cv_.notify_all();
+    CF_EXPECT(std::move(events));
   }
+  auto event = std::move(ready_.front());
+  ready_.pop_front();
+  return event;
+}
+
+Result<void> EpollPool::HandleEvent() {
+  auto event = CF_EXPECT(NextEvent());
   EpollCallback callback;
   {
     std::lock_guard callbacks_lock(callbacks_mutex_);
-    auto it = callbacks_.find(event->fd);
-    CF_EXPECT(it != callbacks_.end(), "Could not find event callback");
+    auto it = callbacks_.find(event.fd);
+    if (it == callbacks_.end()) {
+      // Removed after the event was collected, but before it was handled.
+      return {};
+    }
     callback = std::move(it->second);
     callbacks_.erase(it);
   }
-  CF_EXPECT(callback(*event));
+  CF_EXPECT(callback(event));
   return {};
 }
 
@@ -65,6 +95,12 @@ Result<void> EpollPool::Remove(SharedFD fd) {
   std::lock_guard callbacks_lock(callbacks_mutex_);
   CF_EXPECT(epoll_.Delete(fd), "No callback registered with epoll");
   callbacks_.erase(fd);
+  // Drop events collected before the removal, they would otherwise be taken
+  // for events of a callback registered later for the same fd.
+  std::lock_guard ready_lock(ready_mutex_);
+  for (auto it = ready_.begin(); it != ready_.end();) {
+    it = it->fd == fd ? ready_.erase(it) : it + 1;
+  }
   return {};
 }
 
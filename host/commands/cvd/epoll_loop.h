@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include <condition_variable>
+#include <deque>
 #include <functional>
 #include <map>
 #include <mutex>
@@ -45,13 +47,27 @@ class EpollPool {
    * re-registered.
    */
   Result<void> Register(SharedFD fd, uint32_t events, EpollCallback callback);
+  /**
+   * Handles one event. Only one of the threads calling this waits on epoll at
+   * a time, collecting a batch of events; the others pick the rest of the
+   * batch up without another system call.
+   */
   Result<void> HandleEvent();
   Result<void> Remove(SharedFD fd);
 
  private:
+  Result<EpollEvent> NextEvent();
+
   Epoll epoll_;
   std::mutex callbacks_mutex_;
   std::map<SharedFD, EpollCallback> callbacks_;
+
+  std::mutex ready_mutex_;
+  std::condition_variable ready_cv_;
+  // Events received but not handled yet.
+  std::deque<EpollEvent> ready_;
+  // Whether a thread is currently waiting on epoll_.
+  bool polling_ = false;
 };
 
 fruit::Component<EpollPool> EpollLoopComponent();
@@ -16,6 +16,7 @@
 #include "host/commands/cvd/fetch/fetch_cvd.h"
 
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include <chrono>
 #include <fstream>
@@ -44,6 +45,8 @@
 #include "host/libs/config/fetcher_config.h"
 #include "host/libs/web/build_api.h"
 #include "host/libs/web/credential_source.h"
+#include "host/libs/web/ranged_download.h"
+#include "host/libs/web/streaming_zip_extractor.h"
 
 namespace cuttlefish {
 namespace {
@@ -233,6 +236,36 @@ Result<std::vector<std::string>> DownloadImages(
   return files;
 }
 
+// Extracts the img zip while it is being downloaded, falling back to
+// extracting the complete archive if it uses features that need the central
+// directory.
+Result<std::vector<std::string>> DownloadAndExtractImageZip(
+    BuildApi& build_api, const Build& build,
+    const std::string& target_directory, const bool keep_archives) {
+  std::string img_zip_name = GetBuildZipName(build, "img");
+  std::string local_path = target_directory + "/" + img_zip_name;
+  DownloadProgress progress;
+  auto extracted_future = std::async(
+      std::launch::async, ExtractZipWhileDownloading, std::cref(local_path),
+      std::ref(progress), std::cref(target_directory),
+      std::vector<std::string>());
+  Result<std::string> downloaded =
+      build_api.DownloadFile(build, target_directory, img_zip_name, &progress);
+  auto extracted = extracted_future.get();
+  CF_EXPECT(std::move(downloaded));
+  if (!extracted.ok()) {
+    LOG(INFO) << "Could not extract \"" << local_path
+              << "\" while downloading, extracting the complete archive: "
+              << extracted.error().Message();
+    return ExtractArchiveContents(local_path, target_directory, keep_archives);
+  }
+  if (!keep_archives && unlink(local_path.c_str()) != 0) {
+    LOG(ERROR) << "Could not delete " << local_path;
+    extracted->push_back(local_path);
+  }
+  return extracted;
+}
+
 Result<std::string> DownloadTargetFiles(BuildApi& build_api, const Build& build,
                                         const std::string& target_directory) {
   std::string target_files_name = GetBuildZipName(build, "target_files");
@@ -257,6 +290,102 @@ Result<std::vector<std::string>> DownloadOtaTools(
   return ExtractArchiveContents(local_path, otatools_dir, keep_archives);
 }
 
+Result<std::vector<std::string>> DownloadKernel(BuildApi& build_api,
+                                                const Build& build,
+                                                const std::string& target_dir) {
+  std::string local_path = target_dir + "/kernel";
+  // If the kernel is from an arm/aarch64 build, the artifact will be called
+  // Image.
+  std::string kernel_filepath = CF_EXPECT(
+      build_api.DownloadFileWithBackup(build, target_dir, "bzImage", "Image"));
+  RenameFile(kernel_filepath, local_path);
+  std::vector<std::string> files{local_path};
+
+  // Certain kernel builds do not have corresponding ramdisks.
+  Result<std::string> initramfs_img_result =
+      build_api.DownloadFile(build, target_dir, "initramfs.img");
+  if (initramfs_img_result.ok()) {
+    files.push_back(initramfs_img_result.value());
+  }
+  return files;
+}
+
+Result<std::string> DownloadBootloader(BuildApi& build_api, const Build& build,
+                                       const std::string& target_dir) {
+  std::string local_path = target_dir + "/bootloader";
+  // If the bootloader is from an arm/aarch64 build, the artifact will be of
+  // filetype bin.
+  std::string bootloader_filepath = CF_EXPECT(build_api.DownloadFileWithBackup(
+      build, target_dir, "u-boot.rom", "u-boot.bin"));
+  RenameFile(bootloader_filepath, local_path);
+  return local_path;
+}
+
+struct SystemBuildFiles {
+  // Empty if the system image is not in the img zip.
+  std::vector<std::string> image_files;
+  std::string target_files;
+};
+
+Result<SystemBuildFiles> DownloadSystemBuild(BuildApi& build_api,
+                                             const Build& build,
+                                             const std::string& target_dir,
+                                             const bool download_img_zip,
+                                             const bool keep_archives) {
+  SystemBuildFiles files;
+  bool system_in_img_zip = true;
+  if (download_img_zip) {
+    auto image_files =
+        DownloadImages(build_api, build, target_dir,
+                       {"system.img", "product.img"}, keep_archives);
+    if (!image_files.ok() || image_files->empty()) {
+      LOG(INFO) << "Could not find system image for " << build
+                << "in the img zip. Assuming a super image build, which will "
+                << "get the system image from the target zip.";
+      system_in_img_zip = false;
+    } else {
+      files.image_files = std::move(*image_files);
+    }
+  }
+  std::string system_target_dir = target_dir + "/system";
+  CF_EXPECT(EnsureDirectoryExists(system_target_dir, RWX_ALL_MODE));
+  files.target_files =
+      CF_EXPECT(DownloadTargetFiles(build_api, build, system_target_dir));
+  if (!system_in_img_zip) {
+    std::string extracted_system =
+        CF_EXPECT(ExtractImage(files.target_files, target_dir,
+                               "IMAGES/system.img", keep_archives));
+    CF_EXPECT(RenameFile(extracted_system, target_dir + "/system.img"));
+
+    Result<std::string> extracted_product_result = ExtractImage(
+        files.target_files, target_dir, "IMAGES/product.img", keep_archives);
+    if (extracted_product_result.ok()) {
+      CF_EXPECT(RenameFile(extracted_product_result.value(),
+                           target_dir + "/product.img"));
+    }
+
+    Result<std::string> extracted_system_ext_result = ExtractImage(
+        files.target_files, target_dir, "IMAGES/system_ext.img", keep_archives);
+    if (extracted_system_ext_result.ok()) {
+      CF_EXPECT(RenameFile(extracted_system_ext_result.value(),
+                           target_dir + "/system_ext.img"));
+    }
+
+    Result<std::string> extracted_vbmeta_system =
+        ExtractImage(files.target_files, target_dir,
+                     "IMAGES/vbmeta_system.img", keep_archives);
+    if (extracted_vbmeta_system.ok()) {
+      CF_EXPECT(RenameFile(extracted_vbmeta_system.value(),
+                           target_dir + "/vbmeta_system.img"));
+    }
+    // This should technically call AddFilesToConfig with the produced
+    // files, but it will conflict with the ones produced from the default
+    // system image and pie doesn't care about the produced file list
+    // anyway.
+  }
+  return files;
+}
+
 Result<std::string> DownloadMiscInfo(BuildApi& build_api, const Build& build,
                                      const std::string& target_dir) {
   return build_api.DownloadFile(build, target_dir, "misc_info.txt");
@@ -349,20 +478,6 @@ std::unique_ptr<CredentialSource> TryOpenServiceAccountFile(
       new ServiceAccountOauthCredentialSource(std::move(*result)));
 }
 
-Result<void> ProcessHostPackage(BuildApi& build_api, const Build& build,
-                                const std::string& target_dir,
-                                FetcherConfig* config,
-                                const std::string& host_package_build,
-                                const bool keep_archives) {
-  std::vector<std::string> host_package_files = CF_EXPECT(
-      DownloadHostPackage(build_api, build, target_dir, keep_archives));
-  CF_EXPECT(AddFilesToConfig(host_package_build != ""
-                                 ? FileSource::HOST_PACKAGE_BUILD
-                                 : FileSource::DEFAULT_BUILD,
-                             build, host_package_files, config, target_dir));
-  return {};
-}
-
 BuildApi GetBuildApi(const BuildApiFlags& flags) {
   auto resolver =
       flags.external_dns_resolver ? GetEntDnsResolve : NameResolver();
@@ -467,25 +582,49 @@ Result<void> FetchCvdMain(int argc, char** argv) {
     const Builds builds =
         CF_EXPECT(GetBuildsFromSources(build_api, flags.build_source_flags));
 
-    auto process_pkg_ret = std::async(
-        std::launch::async, ProcessHostPackage, std::ref(build_api),
-        std::cref(builds.host_package.value()), std::cref(target_dir), &config,
-        std::cref(flags.build_source_flags.host_package_build),
-        std::cref(flags.keep_downloaded_archives));
-
+    // Artifacts are downloaded concurrently, but added to the config in a
+    // fixed order afterwards so later builds override earlier ones
+    // deterministically. Everything that may overwrite files from the default
+    // img zip waits for it to be extracted.
+    const bool keep_archives = flags.keep_downloaded_archives;
+    auto host_package_future =
+        std::async(std::launch::async, DownloadHostPackage,
+                   std::ref(build_api), std::cref(builds.host_package.value()),
+                   std::cref(target_dir), keep_archives);
+    std::future<Result<std::vector<std::string>>> ota_tools_future;
     if (builds.otatools.has_value()) {
-      std::vector<std::string> ota_tools_files = CF_EXPECT(
-          DownloadOtaTools(build_api, builds.otatools.value(), target_dir,
-                           flags.keep_downloaded_archives));
+      ota_tools_future = std::async(
+          std::launch::async, DownloadOtaTools, std::ref(build_api),
+          std::cref(builds.otatools.value()), std::cref(target_dir),
+          keep_archives);
+    }
+    std::future<Result<std::vector<std::string>>> image_files_future;
+    if (flags.download_flags.download_img_zip) {
+      image_files_future = std::async(
+          std::launch::async, DownloadAndExtractImageZip, std::ref(build_api),
+          std::cref(builds.default_build), std::cref(target_dir),
+          keep_archives);
+    }
+    std::future<Result<std::string>> target_files_future;
+    if (builds.system.has_value() ||
+        flags.download_flags.download_target_files_zip) {
+      std::string default_target_dir = target_dir + "/default";
+      CF_EXPECT(EnsureDirectoryExists(default_target_dir), RWX_ALL_MODE);
+      target_files_future = std::async(
+          std::launch::async, DownloadTargetFiles, std::ref(build_api),
+          std::cref(builds.default_build), default_target_dir);
+    }
+
+    if (ota_tools_future.valid()) {
+      std::vector<std::string> ota_tools_files =
+          CF_EXPECT(ota_tools_future.get());
       CF_EXPECT(AddFilesToConfig(FileSource::DEFAULT_BUILD,
                                  builds.default_build, ota_tools_files, &config,
                                  target_dir));
     }
-    if (flags.download_flags.download_img_zip) {
-      std::string local_path = CF_EXPECT(
-          DownloadImageZip(build_api, builds.default_build, target_dir));
-      std::vector<std::string> image_files = CF_EXPECT(ExtractArchiveContents(
-          local_path, target_dir, flags.keep_downloaded_archives));
+    if (image_files_future.valid()) {
+      std::vector<std::string> image_files =
+          CF_EXPECT(image_files_future.get());
       LOG(INFO) << "Adding img-zip files for default build";
       for (auto& file : image_files) {
         LOG(INFO) << file;
@@ -494,136 +633,103 @@ Result<void> FetchCvdMain(int argc, char** argv) {
                                  builds.default_build, image_files, &config,
                                  target_dir));
     }
-    if (builds.system.has_value() ||
-        flags.download_flags.download_target_files_zip) {
-      std::string default_target_dir = target_dir + "/default";
-      CF_EXPECT(EnsureDirectoryExists(default_target_dir), RWX_ALL_MODE);
-      std::string target_files = CF_EXPECT(DownloadTargetFiles(
-          build_api, builds.default_build, default_target_dir));
+    if (target_files_future.valid()) {
+      std::string target_files = CF_EXPECT(target_files_future.get());
       LOG(INFO) << "Adding target files for default build";
       CF_EXPECT(AddFilesToConfig(FileSource::DEFAULT_BUILD,
                                  builds.default_build, {target_files}, &config,
                                  target_dir));
     }
 
+    // The system and boot builds can share an img zip, so boot waits for
+    // system.
+    std::shared_future<Result<SystemBuildFiles>> system_future;
     if (builds.system.has_value()) {
-      bool system_in_img_zip = true;
-      if (flags.download_flags.download_img_zip) {
-        auto image_files = DownloadImages(
-            build_api, builds.system.value(), target_dir,
-            {"system.img", "product.img"}, flags.keep_downloaded_archives);
-        if (!image_files.ok() || image_files->empty()) {
-          LOG(INFO)
-              << "Could not find system image for " << builds.system.value()
-              << "in the img zip. Assuming a super image build, which will "
-              << "get the system image from the target zip.";
-          system_in_img_zip = false;
-        } else {
-          LOG(INFO) << "Adding img-zip files for system build";
-          CF_EXPECT(AddFilesToConfig(FileSource::SYSTEM_BUILD,
-                                     builds.system.value(), *image_files,
-                                     &config, target_dir, true));
+      system_future =
+          std::async(std::launch::async, DownloadSystemBuild,
+                     std::ref(build_api), std::cref(builds.system.value()),
+                     std::cref(target_dir),
+                     flags.download_flags.download_img_zip, keep_archives)
+              .share();
+    }
+    std::future<Result<std::vector<std::string>>> kernel_future;
+    if (builds.kernel.has_value()) {
+      kernel_future = std::async(std::launch::async, DownloadKernel,
+                                 std::ref(build_api),
+                                 std::cref(builds.kernel.value()),
+                                 std::cref(target_dir));
+    }
+    std::future<Result<std::vector<std::string>>> boot_future;
+    if (builds.boot.has_value()) {
+      boot_future = std::async(std::launch::async, [&, system_future]() {
+        if (system_future.valid()) {
+          system_future.wait();
         }
+        return DownloadBoot(build_api, builds.boot.value(),
+                            flags.download_flags.boot_artifact, target_dir,
+                            keep_archives);
+      });
+    }
+    // Some older builds might not have misc_info.txt, so permit errors on
+    // fetching misc_info.txt
+    auto misc_info_future =
+        std::async(std::launch::async, DownloadMiscInfo, std::ref(build_api),
+                   std::cref(builds.default_build), std::cref(target_dir));
+    std::future<Result<std::string>> bootloader_future;
+    if (builds.bootloader.has_value()) {
+      bootloader_future = std::async(
+          std::launch::async, DownloadBootloader, std::ref(build_api),
+          std::cref(builds.bootloader.value()), std::cref(target_dir));
+    }
+
+    if (system_future.valid()) {
+      Result<SystemBuildFiles> system_result = system_future.get();
+      SystemBuildFiles system_files = CF_EXPECT(std::move(system_result));
+      if (!system_files.image_files.empty()) {
+        LOG(INFO) << "Adding img-zip files for system build";
+        CF_EXPECT(AddFilesToConfig(FileSource::SYSTEM_BUILD,
+                                   builds.system.value(),
+                                   system_files.image_files, &config,
+                                   target_dir, true));
       }
-      std::string system_target_dir = target_dir + "/system";
-      CF_EXPECT(EnsureDirectoryExists(system_target_dir, RWX_ALL_MODE));
-      std::string target_files = CF_EXPECT(DownloadTargetFiles(
-          build_api, builds.system.value(), system_target_dir));
       CF_EXPECT(AddFilesToConfig(FileSource::SYSTEM_BUILD,
-                                 builds.system.value(), {target_files}, &config,
+                                 builds.system.value(),
+                                 {system_files.target_files}, &config,
                                  target_dir));
-      if (!system_in_img_zip) {
-        std::string extracted_system = CF_EXPECT(
-            ExtractImage(target_files, target_dir, "IMAGES/system.img",
-                         flags.keep_downloaded_archives));
-        CF_EXPECT(RenameFile(extracted_system, target_dir + "/system.img"));
-
-        Result<std::string> extracted_product_result =
-            ExtractImage(target_files, target_dir, "IMAGES/product.img",
-                         flags.keep_downloaded_archives);
-        if (extracted_product_result.ok()) {
-          CF_EXPECT(RenameFile(extracted_product_result.value(),
-                               target_dir + "/product.img"));
-        }
-
-        Result<std::string> extracted_system_ext_result =
-            ExtractImage(target_files, target_dir, "IMAGES/system_ext.img",
-                         flags.keep_downloaded_archives);
-        if (extracted_system_ext_result.ok()) {
-          CF_EXPECT(RenameFile(extracted_system_ext_result.value(),
-                               target_dir + "/system_ext.img"));
-        }
-
-        Result<std::string> extracted_vbmeta_system =
-            ExtractImage(target_files, target_dir, "IMAGES/vbmeta_system.img",
-                         flags.keep_downloaded_archives);
-        if (extracted_vbmeta_system.ok()) {
-          CF_EXPECT(RenameFile(extracted_vbmeta_system.value(),
-                               target_dir + "/vbmeta_system.img"));
-        }
-        // This should technically call AddFilesToConfig with the produced
-        // files, but it will conflict with the ones produced from the default
-        // system image and pie doesn't care about the produced file list
-        // anyway.
-      }
     }
-
-    if (builds.kernel.has_value()) {
-      std::string local_path = target_dir + "/kernel";
-      // If the kernel is from an arm/aarch64 build, the artifact will be called
-      // Image.
-      std::string kernel_filepath = CF_EXPECT(build_api.DownloadFileWithBackup(
-          builds.kernel.value(), target_dir, "bzImage", "Image"));
-      RenameFile(kernel_filepath, local_path);
+    if (kernel_future.valid()) {
+      std::vector<std::string> kernel_files = CF_EXPECT(kernel_future.get());
       CF_EXPECT(AddFilesToConfig(FileSource::KERNEL_BUILD,
-                                 builds.kernel.value(), {local_path}, &config,
+                                 builds.kernel.value(), kernel_files, &config,
                                  target_dir));
-
-      // Certain kernel builds do not have corresponding ramdisks.
-      Result<std::string> initramfs_img_result = build_api.DownloadFile(
-          builds.kernel.value(), target_dir, "initramfs.img");
-      if (initramfs_img_result.ok()) {
-        CF_EXPECT(AddFilesToConfig(
-            FileSource::KERNEL_BUILD, builds.kernel.value(),
-            {initramfs_img_result.value()}, &config, target_dir));
-      }
     }
-
-    if (builds.boot.has_value()) {
-      std::vector<std::string> boot_files = CF_EXPECT(DownloadBoot(
-          build_api, builds.boot.value(), flags.download_flags.boot_artifact,
-          target_dir, flags.keep_downloaded_archives));
+    if (boot_future.valid()) {
+      std::vector<std::string> boot_files = CF_EXPECT(boot_future.get());
       CF_EXPECT(AddFilesToConfig(FileSource::BOOT_BUILD, builds.boot.value(),
                                  boot_files, &config, target_dir, true));
     }
-
-    // Some older builds might not have misc_info.txt, so permit errors on
-    // fetching misc_info.txt
-    auto misc_info =
-        DownloadMiscInfo(build_api, builds.default_build, target_dir);
+    auto misc_info = misc_info_future.get();
     if (misc_info.ok()) {
       CF_EXPECT(AddFilesToConfig(FileSource::DEFAULT_BUILD,
                                  builds.default_build, {misc_info.value()},
                                  &config, target_dir, true));
     }
-
-    if (builds.bootloader.has_value()) {
-      std::string local_path = target_dir + "/bootloader";
-      // If the bootloader is from an arm/aarch64 build, the artifact will be of
-      // filetype bin.
-      std::string bootloader_filepath =
-          CF_EXPECT(build_api.DownloadFileWithBackup(builds.bootloader.value(),
-                                                     target_dir, "u-boot.rom",
-                                                     "u-boot.bin"));
-      RenameFile(bootloader_filepath, local_path);
+    if (bootloader_future.valid()) {
+      std::string bootloader_path = CF_EXPECT(bootloader_future.get());
       CF_EXPECT(AddFilesToConfig(FileSource::BOOTLOADER_BUILD,
-                                 builds.bootloader.value(), {local_path},
+                                 builds.bootloader.value(), {bootloader_path},
                                  &config, target_dir, true));
     }
 
-    // Wait for ProcessHostPackage to return.
-    CF_EXPECT(process_pkg_ret.get(),
-              "Could not download host package for " << builds.default_build);
+    std::vector<std::string> host_package_files =
+        CF_EXPECT(host_package_future.get(),
+                  "Could not download host package for "
+                      << builds.default_build);
+    CF_EXPECT(AddFilesToConfig(flags.build_source_flags.host_package_build != ""
+                                   ? FileSource::HOST_PACKAGE_BUILD
+                                   : FileSource::DEFAULT_BUILD,
+                               builds.host_package.value(), host_package_files,
+                               &config, target_dir));
   }
   curl_global_cleanup();
 
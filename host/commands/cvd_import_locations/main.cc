@@ -65,6 +65,8 @@ examples:
 namespace cuttlefish {
 namespace {
 
+constexpr size_t kLocationsPerRequest = 256;
+
 int ImportLocationsCvdMain(int argc, char** argv) {
   ::android::base::InitLogging(argv, android::base::StderrLogger);
   google::ParseCommandLineFlags(&argc, &argv, true);
@@ -88,29 +90,38 @@ int ImportLocationsCvdMain(int argc, char** argv) {
   GnssClient gpsclient(
       grpc::CreateChannel(socket_name, grpc::InsecureChannelCredentials()));
 
-  GpsFixArray coordinates;
+  int delay = (int)(1000 * FLAGS_delay);
+  auto stream = gpsclient.OpenGpsLocationsStream(delay);
+  // Locations are sent as they are parsed, so playback starts right away and
+  // memory use does not depend on the length of the track.
+  size_t parsed_points = 0;
+  auto send_chunk = [&stream, &parsed_points](GpsFixArray chunk) {
+    parsed_points += chunk.size();
+    return stream->Write(chunk);
+  };
   std::string error;
   bool isOk = false;
 
   LOG(INFO) << "Server port: " << server_port << " socket: " << socket_name
             << std::endl;
   if (FLAGS_format == "gpx" || FLAGS_format == "GPX") {
-    isOk =
-        GpxParser::parseFile(FLAGS_file_path.c_str(), &coordinates, &error);
+    isOk = GpxParser::parseFileStreaming(
+        FLAGS_file_path.c_str(), kLocationsPerRequest, send_chunk, &error);
   } else if (FLAGS_format == "kml" || FLAGS_format == "KML") {
-    isOk =
-        KmlParser::parseFile(FLAGS_file_path.c_str(), &coordinates, &error);
+    isOk = KmlParser::parseFileStreaming(
+        FLAGS_file_path.c_str(), kLocationsPerRequest, send_chunk, &error);
   }
 
-  LOG(INFO) << "Number of parsed points: " << coordinates.size() << std::endl;
+  LOG(INFO) << "Number of parsed points: " << parsed_points << std::endl;
 
   if (!isOk) {
     LOG(ERROR) << " Parsing Error: " << error << std::endl;
+    stream->Cancel();
+    stream->Finish();
     return 1;
   }
 
-  int delay = (int)(1000 * FLAGS_delay);
-  auto status = gpsclient.SendGpsLocations(delay,coordinates);
+  auto status = stream->Finish();
   CHECK(status.ok()) << "Failed to send gps location data \n";
   if (!status.ok()) {
     return 1;
@@ -17,6 +17,7 @@
 #include <android-base/file.h>
 #include <gtest/gtest.h>
 #include <fstream>
+#include <vector>
 #include "host/libs/location/GpsFix.h"
 #include "host/libs/location/GpxParser.h"
 #include "host/libs/location/StringParse.h"
@@ -43,6 +44,27 @@ bool ParseGpxString(GpsFixArray* locations, char* text, std::string* error) {
   return result;
 }
 
+// Streams |text| from a file, |chunkSize| fixes at a time, until
+// |maxChunks| have been received.
+bool StreamGpxFile(std::vector<GpsFixArray>* chunks, char* text,
+                   size_t chunkSize, std::string* error,
+                   size_t maxChunks = SIZE_MAX) {
+  TemporaryDir myDir;
+  std::string path = std::string(myDir.path) + "/" + "test.gpx";
+
+  std::ofstream myfile;
+  myfile.open(path.c_str());
+  myfile << text;
+  myfile.close();
+  return GpxParser::parseFileStreaming(
+      path.c_str(), chunkSize,
+      [chunks, maxChunks](GpsFixArray chunk) {
+        chunks->push_back(std::move(chunk));
+        return chunks->size() < maxChunks;
+      },
+      error);
+}
+
 }  // namespace
 
 TEST(GpxParser, ParseFileNotFound) {
@@ -378,4 +400,79 @@ TEST(GpxParser, ParseValidDocumentString) {
   EXPECT_EQ("Trkpt 2-2", locations[7].name);
 }
 
-}  // namespace cuttlefish
\ No newline at end of file
+TEST(GpxParser, StreamFileNotFound) {
+  std::vector<GpsFixArray> chunks;
+  std::string error;
+  EXPECT_FALSE(GpxParser::parseFileStreaming(
+      "i_dont_exist.gpx", 1,
+      [&chunks](GpsFixArray chunk) {
+        chunks.push_back(std::move(chunk));
+        return true;
+      },
+      &error));
+  EXPECT_EQ(0U, chunks.size());
+}
+
+TEST(GpxParser, StreamEmptyRteTrkFile) {
+  std::vector<GpsFixArray> chunks;
+  std::string error;
+  EXPECT_TRUE(StreamGpxFile(&chunks, kEmptyRteTrkText, 1, &error));
+  EXPECT_EQ(0U, chunks.size());
+}
+
+TEST(GpxParser, StreamValidDocumentFile) {
+  std::vector<GpsFixArray> chunks;
+  std::string error;
+  ASSERT_TRUE(StreamGpxFile(&chunks, kValidDocumentText, 3, &error));
+  ASSERT_EQ(3U, chunks.size());
+  EXPECT_EQ(3U, chunks[0].size());
+  EXPECT_EQ(3U, chunks[1].size());
+  EXPECT_EQ(2U, chunks[2].size());
+
+  GpsFixArray locations;
+  ASSERT_TRUE(ParseGpxFile(&locations, kValidDocumentText, &error));
+  GpsFixArray streamed;
+  for (const auto& chunk : chunks) {
+    streamed.insert(streamed.end(), chunk.begin(), chunk.end());
+  }
+  ASSERT_EQ(locations.size(), streamed.size());
+  for (size_t i = 0; i < locations.size(); i++) {
+    EXPECT_EQ(locations[i].name, streamed[i].name);
+    EXPECT_FLOAT_EQ(locations[i].latitude, streamed[i].latitude);
+    EXPECT_FLOAT_EQ(locations[i].longitude, streamed[i].longitude);
+  }
+}
+
+TEST(GpxParser, StreamValidLocationFile) {
+  std::vector<GpsFixArray> chunks;
+  std::string error;
+  ASSERT_TRUE(StreamGpxFile(&chunks, kValidLocationText, 10, &error));
+  ASSERT_EQ(1U, chunks.size());
+  ASSERT_EQ(1U, chunks[0].size());
+
+  GpsFixArray locations;
+  ASSERT_TRUE(ParseGpxFile(&locations, kValidLocationText, &error));
+  EXPECT_EQ(locations[0].name, chunks[0][0].name);
+  EXPECT_EQ(locations[0].description, chunks[0][0].description);
+  EXPECT_EQ(locations[0].time, chunks[0][0].time);
+  EXPECT_FLOAT_EQ(locations[0].elevation, chunks[0][0].elevation);
+}
+
+TEST(GpxParser, StreamStopsWhenAsked) {
+  std::vector<GpsFixArray> chunks;
+  std::string error;
+  ASSERT_TRUE(StreamGpxFile(&chunks, kValidDocumentText, 3, &error, 1));
+  ASSERT_EQ(1U, chunks.size());
+  ASSERT_EQ(3U, chunks[0].size());
+  EXPECT_EQ("Rtept 1", chunks[0][2].name);
+}
+
+TEST(GpxParser, StreamLocationMissingLatitudeFile) {
+  std::vector<GpsFixArray> chunks;
+  std::string error;
+  EXPECT_FALSE(
+      StreamGpxFile(&chunks, kLocationMissingLongitudeLatitudeText, 1, &error));
+  EXPECT_EQ(0U, chunks.size());
+}
+
+}  // namespace cuttlefish
@@ -17,6 +17,7 @@
 #include <android-base/file.h>
 #include <gtest/gtest.h>
 #include <fstream>
+#include <vector>
 #include "host/libs/location/GpsFix.h"
 #include "host/libs/location/KmlParser.h"
 #include "host/libs/location/StringParse.h"
@@ -41,6 +42,24 @@ bool ParseKmlString(GpsFixArray* locations, char* text, std::string* error) {
   result = KmlParser::parseString(text, strlen(text), locations, error);
   return result;
 }
+
+// Streams |text| from a file, |chunkSize| fixes at a time.
+bool StreamKmlFile(std::vector<GpsFixArray>* chunks, char* text,
+                   size_t chunkSize, std::string* error) {
+  TemporaryDir myDir;
+  std::string path = std::string(myDir.path) + "/" + "test.kml";
+
+  std::ofstream myfile;
+  myfile.open(path.c_str());
+  myfile << text;
+  myfile.close();
+  return KmlParser::parseFileStreaming(path.c_str(), chunkSize,
+                                       [chunks](GpsFixArray chunk) {
+                                         chunks->push_back(std::move(chunk));
+                                         return true;
+                                       },
+                                       error);
+}
 }  // namespace
 
 TEST(KmlParser, ParseNonexistentFile) {
@@ -658,4 +677,63 @@ TEST(KmlParser, ParsePlacemarkNullNameNoCrashString) {
   EXPECT_STREQ("", locations.front().description.c_str());
 }
 
-}  // namespace cuttlefish
\ No newline at end of file
+TEST(KmlParser, StreamNonexistentFile) {
+  std::string error;
+  ASSERT_FALSE(KmlParser::parseFileStreaming(
+      "", 1, [](GpsFixArray) { return true; }, &error));
+  EXPECT_EQ(std::string("KML document not parsed successfully."), error);
+}
+
+TEST(KmlParser, StreamEmptyKmlFile) {
+  std::vector<GpsFixArray> chunks;
+  std::string error;
+  ASSERT_TRUE(StreamKmlFile(&chunks, kEmptyKmlText, 1, &error));
+  EXPECT_EQ(0U, chunks.size());
+  EXPECT_EQ("", error);
+}
+
+TEST(KmlParser, StreamValidComplexFile) {
+  std::vector<GpsFixArray> chunks;
+  std::string error;
+  ASSERT_TRUE(StreamKmlFile(&chunks, kValidComplexText, 2, &error));
+  ASSERT_EQ(2U, chunks.size());
+  EXPECT_EQ(2U, chunks[0].size());
+  EXPECT_EQ(1U, chunks[1].size());
+
+  GpsFixArray locations;
+  ASSERT_TRUE(ParseKmlFile(&locations, kValidComplexText, &error));
+  GpsFixArray streamed;
+  for (const auto& chunk : chunks) {
+    streamed.insert(streamed.end(), chunk.begin(), chunk.end());
+  }
+  ASSERT_EQ(locations.size(), streamed.size());
+  for (size_t i = 0; i < locations.size(); i++) {
+    EXPECT_EQ(locations[i].name, streamed[i].name);
+    EXPECT_EQ(locations[i].description, streamed[i].description);
+    EXPECT_FLOAT_EQ(locations[i].latitude, streamed[i].latitude);
+    EXPECT_FLOAT_EQ(locations[i].longitude, streamed[i].longitude);
+    EXPECT_FLOAT_EQ(locations[i].elevation, streamed[i].elevation);
+  }
+}
+
+TEST(KmlParser, StreamSplitsLongPlacemark) {
+  std::vector<GpsFixArray> chunks;
+  std::string error;
+  ASSERT_TRUE(StreamKmlFile(&chunks, kMultipleCoordinatesText, 2, &error));
+  ASSERT_EQ(2U, chunks.size());
+  ASSERT_EQ(2U, chunks[0].size());
+  ASSERT_EQ(1U, chunks[1].size());
+  EXPECT_FLOAT_EQ(-122.0822035425683, chunks[0][0].longitude);
+  EXPECT_FLOAT_EQ(10.4, chunks[0][1].longitude);
+  EXPECT_FLOAT_EQ(21.4, chunks[1][0].latitude);
+}
+
+TEST(KmlParser, StreamBadCoordinatesFile) {
+  std::vector<GpsFixArray> chunks;
+  std::string error;
+  ASSERT_FALSE(StreamKmlFile(&chunks, kBadCoordinatesText, 1, &error));
+  EXPECT_EQ("Location found with missing or malformed coordinates", error);
+  EXPECT_EQ(0U, chunks.size());
+}
+
+}  // namespace cuttlefish
@@ -34,8 +34,10 @@
 #include <signal.h>
 
 #include <chrono>
+#include <condition_variable>
 #include <deque>
 #include <mutex>
+#include <optional>
 #include <sstream>
 #include <thread>
 #include <vector>
@@ -59,6 +61,7 @@ using gnss_grpc_proxy::SendGpsCoordinatesRequest;
 using grpc::Server;
 using grpc::ServerBuilder;
 using grpc::ServerContext;
+using grpc::ServerReader;
 using grpc::Status;
 
 DEFINE_int32(gnss_in_fd,
@@ -89,6 +92,10 @@ constexpr char END_OF_MSG_MARK[] = "\n\n\n\n";
 
 constexpr uint32_t GNSS_SERIAL_BUFFER_SIZE = 4096;
 
+// How many streamed locations may wait for playback before the proxy stops
+// reading from the stream.
+constexpr size_t MAX_QUEUED_FIXED_LOCATIONS = 1024;
+
 std::string GenerateGpsLine(const std::string& dataPoint) {
   std::string unix_time_millis =
       std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(
@@ -152,6 +159,45 @@ class GnssGrpcProxyServiceImpl final : public GnssGrpcProxy::Service {
      return Status::OK;
    }
 
+   Status SendGpsCoordinatesStream(
+       ServerContext* context, ServerReader<SendGpsCoordinatesRequest>* reader,
+       SendGpsCoordinatesReply* reply) override {
+     SendGpsCoordinatesRequest request;
+     bool first_request = true;
+     while (reader->Read(&request)) {
+       std::unique_lock<std::mutex> lock(fixed_locations_queue_mutex_);
+       if (first_request) {
+         fixed_locations_queue_ = {};
+         fixed_locations_delay_ = request.delay();
+         first_request = false;
+       }
+       for (const auto& loc : request.coordinates()) {
+         // Not reading further lets gRPC flow control hold the client back
+         // until playback catches up, so the queue stays bounded however
+         // long the track is.
+         while (fixed_locations_queue_.size() >= MAX_QUEUED_FIXED_LOCATIONS) {
+           if (context->IsCancelled()) {
+             fixed_locations_queue_ = {};
+             reply->set_status(SendGpsCoordinatesReply::CANCELLED);
+             return Status::CANCELLED;
+           }
+           fixed_locations_queue_popped_.wait_for(
+               lock, std::chrono::milliseconds(100));
+         }
+         fixed_locations_queue_.push(ConvertCoordinate(loc));
+       }
+     }
+     if (context->IsCancelled()) {
+       // The client gave up part way, e.g. on a malformed file.
+       std::lock_guard<std::mutex> lock(fixed_locations_queue_mutex_);
+       fixed_locations_queue_ = {};
+       reply->set_status(SendGpsCoordinatesReply::CANCELLED);
+       return Status::CANCELLED;
+     }
+     reply->set_status(SendGpsCoordinatesReply::OK);
+     return Status::OK;
+   }
+
     void sendToSerial() {
       std::lock_guard<std::mutex> lock(cached_fixed_location_mutex);
       ssize_t bytes_written = cuttlefish::WriteAll(
@@ -355,18 +401,24 @@ class GnssGrpcProxyServiceImpl final : public GnssGrpcProxy::Service {
 
    [[noreturn]] void WriteFixedLocationFromQueue() {
       while (true) {
-         if (!fixed_locations_queue_.empty()) {
-         std::string dataPoint = fixed_locations_queue_.front();
-         std::string line = GenerateGpsLine(dataPoint);
-         std::lock_guard<std::mutex> lock(cached_fixed_location_mutex);
-         cached_fixed_location = line;
-         {
-           std::lock_guard<std::mutex> lock(fixed_locations_queue_mutex_);
-           fixed_locations_queue_.pop();
-         }
-       }
-       std::this_thread::sleep_for(std::chrono::milliseconds(fixed_locations_delay_));
-     }
+        std::optional<std::string> dataPoint;
+        int delay;
+        {
+          std::lock_guard<std::mutex> lock(fixed_locations_queue_mutex_);
+          if (!fixed_locations_queue_.empty()) {
+            dataPoint = std::move(fixed_locations_queue_.front());
+            fixed_locations_queue_.pop();
+          }
+          delay = fixed_locations_delay_;
+        }
+        if (dataPoint) {
+          fixed_locations_queue_popped_.notify_all();
+          std::string line = GenerateGpsLine(*dataPoint);
+          std::lock_guard<std::mutex> lock(cached_fixed_location_mutex);
+          cached_fixed_location = line;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+      }
    }
 
     std::string getTimeNanosFromLine(const std::string& line) {
@@ -400,6 +452,7 @@ class GnssGrpcProxyServiceImpl final : public GnssGrpcProxy::Service {
 
     std::queue<std::string> fixed_locations_queue_;
     std::mutex fixed_locations_queue_mutex_;
+    std::condition_variable fixed_locations_queue_popped_;
     int fixed_locations_delay_;
 };
 
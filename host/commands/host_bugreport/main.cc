@@ -77,6 +77,19 @@ Result<void> CvdHostBugreportMain(int argc, char** argv) {
     save("launcher.log");
     save("logcat");
     save("metrics.log");
+    if (FileExists(instance.webrtc_input_latency_path())) {
+      SaveFile(writer, instance.instance_name() + "/webrtc_input_latency.json",
+               instance.webrtc_input_latency_path());
+    }
+    // Segments rotated out by logcat_receiver, e.g. logcat.1.gz
+    auto logs = CF_EXPECT(DirectoryContents(instance.PerInstanceLogPath("")),
+                          "Cannot read from logs directory.");
+    for (const auto& log : logs) {
+      if (android::base::StartsWith(log, "logcat.")) {
+        SaveFile(writer, instance.instance_name() + "/" + log,
+                 instance.PerInstanceLogPath(log));
+      }
+    }
     auto tombstones =
         CF_EXPECT(DirectoryContents(instance.PerInstancePath("tombstones")),
                   "Cannot read from tombstones directory.");
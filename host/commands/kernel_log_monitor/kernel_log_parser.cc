@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "host/commands/kernel_log_monitor/kernel_log_parser.h"
+
+#include <ctype.h>
+
+#include <string_view>
+#include <utility>
+
+#include <android-base/logging.h>
+
+#include "host/commands/kernel_log_monitor/kernel_log_server.h"
+#include "host/commands/kernel_log_monitor/multi_pattern_matcher.h"
+#include "host/libs/config/cuttlefish_config.h"
+
+namespace monitor {
+namespace {
+
+constexpr struct {
+  std::string_view match;   // Substring to match in the kernel logs
+  std::string_view prefix;  // Prefix value to output, describing the entry
+} kInformationalPatterns[] = {
+    {"U-Boot ", "GUEST_UBOOT_VERSION: "},
+    {"] Linux version ", "GUEST_KERNEL_VERSION: "},
+    {"GUEST_BUILD_FINGERPRINT: ", "GUEST_BUILD_FINGERPRINT: "},
+};
+
+enum EventFormat {
+  kBare,          // Just an event, no extra data
+  kKeyValuePair,  // <stage> <key>=<value>
+};
+
+constexpr struct {
+  std::string_view stage;  // substring in the log identifying the stage
+  Event event;             // emitted when the stage is encountered
+  EventFormat format;      // how the log message is formatted
+} kStageTable[] = {
+    {cuttlefish::kBootStartedMessage, Event::BootStarted, kBare},
+    {cuttlefish::kBootCompletedMessage, Event::BootCompleted, kBare},
+    {cuttlefish::kBootFailedMessage, Event::BootFailed, kKeyValuePair},
+    {cuttlefish::kMobileNetworkConnectedMessage, Event::MobileNetworkConnected, kBare},
+    {cuttlefish::kWifiConnectedMessage, Event::WifiNetworkConnected, kBare},
+    {cuttlefish::kEthernetConnectedMessage, Event::EthernetNetworkConnected, kBare},
+    {cuttlefish::kAdbdStartedMessage, Event::AdbdStarted, kBare},
+    {cuttlefish::kFastbootdStartedMessage, Event::FastbootdStarted, kBare},
+    {cuttlefish::kScreenChangedMessage, Event::ScreenChanged, kKeyValuePair},
+    {cuttlefish::kBootloaderLoadedMessage, Event::BootloaderLoaded, kBare},
+    {cuttlefish::kKernelLoadedMessage, Event::KernelLoaded, kBare},
+    {cuttlefish::kDisplayPowerModeChangedMessage,
+     monitor::Event::DisplayPowerModeChanged, kKeyValuePair},
+};
+
+constexpr size_t kNumInformationalPatterns = std::size(kInformationalPatterns);
+constexpr size_t kNumPatterns =
+    kNumInformationalPatterns + std::size(kStageTable);
+
+// Informational patterns first, followed by the stages, so the pattern index
+// tells which table an occurrence belongs to.
+constexpr auto kPatterns = [] {
+  std::array<std::string_view, kNumPatterns> patterns{};
+  size_t i = 0;
+  for (const auto& pattern : kInformationalPatterns) {
+    patterns[i++] = pattern.match;
+  }
+  for (const auto& stage : kStageTable) {
+    patterns[i++] = stage.stage;
+  }
+  return patterns;
+}();
+
+constexpr MultiPatternMatcher<MaxMatcherStates(kPatterns),
+                              MatcherCharClasses(kPatterns)>
+    kMatcher(kPatterns);
+
+std::string_view Trim(std::string_view str) {
+  while (!str.empty() && isspace(static_cast<unsigned char>(str.front()))) {
+    str.remove_prefix(1);
+  }
+  while (!str.empty() && isspace(static_cast<unsigned char>(str.back()))) {
+    str.remove_suffix(1);
+  }
+  return str;
+}
+
+// Expects space-separated key=value pairs.
+Json::Value ParseKeyValuePairs(std::string_view fields) {
+  Json::Value metadata;
+  while (!fields.empty()) {
+    auto end = fields.find(' ');
+    auto field = Trim(fields.substr(0, end));
+    fields = end == std::string_view::npos ? std::string_view()
+                                           : fields.substr(end + 1);
+    if (field.empty()) {
+      continue;
+    }
+    auto equals = field.find('=');
+    if (equals == std::string_view::npos ||
+        field.find('=', equals + 1) != std::string_view::npos) {
+      LOG(WARNING) << "Field is not in key=value format: " << field;
+      continue;
+    }
+    metadata[std::string(field.substr(0, equals))] =
+        std::string(field.substr(equals + 1));
+  }
+  return metadata;
+}
+
+}  // namespace
+
+KernelLogParser::KernelLogParser(EventHandler on_event)
+    : on_event_(std::move(on_event)),
+      state_(decltype(kMatcher)::kInitialState),
+      line_matches_(0),
+      match_ends_() {}
+
+void KernelLogParser::Process(const char* data, size_t size) {
+  size_t line_start = 0;
+  for (size_t i = 0; i < size; i++) {
+    if (data[i] == '\n') {
+      line_.append(data + line_start, i - line_start);
+      line_start = i + 1;
+      if (line_matches_ != 0) {
+        HandleLine();
+      }
+      line_.clear();
+      line_matches_ = 0;
+      // Patterns only match within a line, so restart the automaton rather
+      // than carry a partial match over into the next one.
+      state_ = decltype(kMatcher)::kInitialState;
+      continue;
+    }
+    state_ = kMatcher.Next(state_, data[i]);
+    auto new_matches = kMatcher.Matches(state_) & ~line_matches_;
+    if (new_matches != 0) {
+      auto end = line_.size() + (i - line_start) + 1;
+      line_matches_ |= new_matches;
+      while (new_matches != 0) {
+        match_ends_[__builtin_ctzll(new_matches)] = end;
+        new_matches &= new_matches - 1;
+      }
+    }
+  }
+  line_.append(data + line_start, size - line_start);
+}
+
+void KernelLogParser::HandleLine() {
+  std::string_view line = line_;
+  for (size_t i = 0; i < kNumInformationalPatterns; i++) {
+    if (line_matches_ & (uint64_t{1} << i)) {
+      LOG(INFO) << kInformationalPatterns[i].prefix
+                << line.substr(match_ends_[i]);
+    }
+  }
+  for (size_t i = 0; i < std::size(kStageTable); i++) {
+    auto pattern = kNumInformationalPatterns + i;
+    if (!(line_matches_ & (uint64_t{1} << pattern))) {
+      continue;
+    }
+    const auto& [stage, event, format] = kStageTable[i];
+    // Log the stage
+    LOG(INFO) << stage;
+
+    Json::Value message;
+    message["event"] = event;
+    if (format == kKeyValuePair) {
+      message["metadata"] = ParseKeyValuePairs(line.substr(match_ends_[pattern]));
+    } else {
+      message["metadata"] = Json::Value();
+    }
+    on_event_(std::move(message));
+  }
+}
+
+}  // namespace monitor
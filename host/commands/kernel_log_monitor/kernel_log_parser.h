@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <functional>
+#include <string>
+
+#include <json/json.h>
+
+namespace monitor {
+
+// Finds the boot stage and informational messages in the kernel console
+// output. The input may be fed in chunks of any size; lines are only
+// processed once complete.
+class KernelLogParser {
+ public:
+  using EventHandler = std::function<void(Json::Value)>;
+
+  // on_event is called with the event message for every stage found.
+  explicit KernelLogParser(EventHandler on_event);
+
+  void Process(const char* data, size_t size);
+
+ private:
+  void HandleLine();
+
+  EventHandler on_event_;
+  // The current, incomplete, line. Cleared but never shrunk, so after the
+  // first few lines it doesn't allocate anymore.
+  std::string line_;
+  uint16_t state_;
+  // Patterns matched in the current line and the offset in line_ right after
+  // their first occurrence.
+  uint64_t line_matches_;
+  std::array<size_t, 64> match_ends_;
+};
+
+}  // namespace monitor
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <android-base/logging.h>
+#include <benchmark/benchmark.h>
+#include <json/json.h>
+
+#include "host/commands/kernel_log_monitor/kernel_log_parser.h"
+
+namespace monitor {
+namespace {
+
+// Excerpt of a cuttlefish boot, repeated to reach a realistic console size.
+constexpr char kBootLogExcerpt[] = R"(U-Boot 2023.01-00001-gcafe (Jan 01 2023 - 00:00:00 +0000)
+[    0.000000] Booting Linux on physical CPU 0x0000000000 [0x410fd083]
+[    0.000000] Linux version 5.15.94-android14-0-00001-gdeadbeef (build-user@build-host) (Android (9352603, based on r450784d1) clang version 14.0.7) #1 SMP PREEMPT Mon Jan 1 00:00:00 UTC 2023
+[    0.000000] random: crng init done
+[    0.000000] Machine model: linux,dummy-virt
+[    0.000000] efi: UEFI not found.
+[    0.000000] Zone ranges:
+[    0.000000]   DMA32    [mem 0x0000000080000000-0x00000000ffffffff]
+[    0.000000]   Normal   [mem 0x0000000100000000-0x000000017fffffff]
+[    0.000000] Kernel command line: console=hvc0 earlycon=uart8250,mmio,0x3f8 androidboot.hardware=cutf_cvm
+[    0.012345] Console: colour dummy device 80x25
+[    0.123456] virtio_blk virtio3: [vda] 18874368 512-byte logical blocks (9.66 GB/9.00 GiB)
+[    0.234567] Serial: 8250/16550 driver, 4 ports, IRQ sharing enabled
+[    1.345678] init: init first stage started!
+[    1.456789] init: Loading module /lib/modules/virtio_net.ko with args ''
+[    2.567890] init: starting service 'logd'...
+[    2.678901] init: starting service 'servicemanager'...
+[    3.789012] init: starting service 'adbd'...
+[    4.890123] binder: 412:412 ioctl 40046210 7ffc0f0e0d0c returned -22
+[    5.901234] audit: type=1400 audit(1672531200.000:42): avc: denied { read } for comm="system_server" name="u:object_r:default_prop:s0" dev="tmpfs" ino=123 scontext=u:r:system_server:s0 tcontext=u:object_r:default_prop:s0 tclass=file permissive=1
+[    6.012345] VIRTUAL_DEVICE_BOOT_STARTED
+[    7.123456] healthd: battery l=100 v=5000 t=25.0 h=2 st=4 c=900000 fc=300000 cc=10 chg=a
+[    8.234567] VIRTUAL_DEVICE_SCREEN_CHANGED width=720 height=1280 dpi=320 display=0
+[    9.345678] VIRTUAL_DEVICE_NETWORK_WIFI_CONNECTED
+[   10.456789] VIRTUAL_DEVICE_DISPLAY_POWER_MODE_CHANGED display=0 mode=2
+[   11.567890] VIRTUAL_DEVICE_BOOT_COMPLETED
+)";
+
+constexpr size_t kExcerptRepetitions = 200;
+
+// A recorded kernel.log can be replayed instead by pointing this environment
+// variable at it.
+constexpr char kBootLogEnvVar[] = "KERNEL_LOG_BENCHMARK_INPUT";
+
+std::string BootLog() {
+  const char* path = getenv(kBootLogEnvVar);
+  if (path != nullptr) {
+    std::ifstream file(path);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    CHECK(file) << "Failed to read " << path;
+    return contents.str();
+  }
+  std::string log;
+  for (size_t i = 0; i < kExcerptRepetitions; i++) {
+    log += kBootLogExcerpt;
+  }
+  return log;
+}
+
+// Replays the boot log through the parser in reads of the given size.
+void BM_ReplayBootLog(benchmark::State& state) {
+  const size_t read_size = state.range(0);
+  const std::string log = BootLog();
+  android::base::SetMinimumLogSeverity(android::base::WARNING);
+
+  size_t events = 0;
+  for (auto _ : state) {
+    KernelLogParser parser([&events](Json::Value message) {
+      benchmark::DoNotOptimize(message);
+      events++;
+    });
+    for (size_t offset = 0; offset < log.size(); offset += read_size) {
+      parser.Process(log.data() + offset,
+                     std::min(read_size, log.size() - offset));
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * log.size());
+  state.counters["events"] = benchmark::Counter(
+      events, benchmark::Counter::kAvgIterations);
+}
+
+BENCHMARK(BM_ReplayBootLog)->ArgName("read_size")->Arg(256)->Arg(4096)->Arg(64 * 1024);
+
+}  // namespace
+}  // namespace monitor
+
+BENCHMARK_MAIN();
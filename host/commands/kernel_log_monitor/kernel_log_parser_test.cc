@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "host/commands/kernel_log_monitor/kernel_log_parser.h"
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <json/json.h>
+
+#include "host/commands/kernel_log_monitor/kernel_log_server.h"
+#include "host/commands/kernel_log_monitor/multi_pattern_matcher.h"
+
+namespace monitor {
+namespace {
+
+class KernelLogParserTest : public ::testing::Test {
+ protected:
+  KernelLogParserTest()
+      : parser_([this](Json::Value message) {
+          events_.push_back(std::move(message));
+        }) {}
+
+  void Feed(const std::string& data) { parser_.Process(data.data(), data.size()); }
+
+  std::vector<Json::Value> events_;
+  KernelLogParser parser_;
+};
+
+TEST_F(KernelLogParserTest, DetectsBareStage) {
+  Feed("[    1.234] init: VIRTUAL_DEVICE_BOOT_STARTED\n");
+
+  ASSERT_EQ(events_.size(), 1);
+  EXPECT_EQ(events_[0]["event"].asInt(), Event::BootStarted);
+  EXPECT_TRUE(events_[0]["metadata"].isNull());
+}
+
+TEST_F(KernelLogParserTest, WaitsForCompleteLine) {
+  Feed("VIRTUAL_DEVICE_BOOT_");
+  Feed("COMPLETED");
+  EXPECT_TRUE(events_.empty());
+
+  Feed("\n");
+
+  ASSERT_EQ(events_.size(), 1);
+  EXPECT_EQ(events_[0]["event"].asInt(), Event::BootCompleted);
+}
+
+TEST_F(KernelLogParserTest, IgnoresPatternSplitAcrossLines) {
+  Feed("xxVIRTUAL_DEVICE_BOOT_\nCOMPLETED\n");
+  Feed("VIRTUAL_DEVICE_BOOT_");
+  Feed("\nSTARTED\n");
+
+  EXPECT_TRUE(events_.empty());
+}
+
+TEST_F(KernelLogParserTest, ParsesKeyValuePairs) {
+  Feed("VIRTUAL_DEVICE_SCREEN_CHANGED width=720  height=1280 bogus\r\n");
+
+  ASSERT_EQ(events_.size(), 1);
+  EXPECT_EQ(events_[0]["event"].asInt(), Event::ScreenChanged);
+  EXPECT_EQ(events_[0]["metadata"]["width"].asString(), "720");
+  EXPECT_EQ(events_[0]["metadata"]["height"].asString(), "1280");
+  EXPECT_FALSE(events_[0]["metadata"].isMember("bogus"));
+}
+
+TEST_F(KernelLogParserTest, ReportsEachStageOncePerLine) {
+  Feed("VIRTUAL_DEVICE_BOOT_STARTED VIRTUAL_DEVICE_BOOT_STARTED\n"
+       "unrelated line\n"
+       "U-Boot 2023.01 VIRTUAL_DEVICE_BOOT_FAILED reason=timeout\n");
+
+  ASSERT_EQ(events_.size(), 3);
+  EXPECT_EQ(events_[0]["event"].asInt(), Event::BootStarted);
+  EXPECT_EQ(events_[1]["event"].asInt(), Event::BootFailed);
+  EXPECT_EQ(events_[1]["metadata"]["reason"].asString(), "timeout");
+  EXPECT_EQ(events_[2]["event"].asInt(), Event::BootloaderLoaded);
+}
+
+TEST(MultiPatternMatcherTest, FindsOverlappingPatterns) {
+  constexpr std::array<std::string_view, 4> kPatterns = {"he", "she", "his",
+                                                         "hers"};
+  constexpr MultiPatternMatcher<MaxMatcherStates(kPatterns),
+                                MatcherCharClasses(kPatterns)>
+      kMatcher(kPatterns);
+
+  std::string_view input = "ushers";
+  std::vector<uint64_t> matches;
+  auto state = kMatcher.kInitialState;
+  for (char c : input) {
+    state = kMatcher.Next(state, c);
+    matches.push_back(kMatcher.Matches(state));
+  }
+
+  // "she" and "he" end at the 4th byte, "hers" at the last one.
+  EXPECT_EQ(matches, (std::vector<uint64_t>{0, 0, 0, 0b11, 0, 0b1000}));
+}
+
+}  // namespace
+}  // namespace monitor
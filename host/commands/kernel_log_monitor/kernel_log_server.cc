@@ -17,56 +17,19 @@
 #include "host/commands/kernel_log_monitor/kernel_log_server.h"
 
 #include <string>
-#include <tuple>
 #include <utility>
 
 #include <android-base/logging.h>
-#include <android-base/strings.h>
 #include <netinet/in.h>
 #include "common/libs/fs/shared_select.h"
-#include "host/libs/config/cuttlefish_config.h"
 
 namespace {
 
-using cuttlefish::SharedFD;
-using monitor::Event;
-
-constexpr struct {
-  std::string_view match;   // Substring to match in the kernel logs
-  std::string_view prefix;  // Prefix value to output, describing the entry
-} kInformationalPatterns[] = {
-    {"U-Boot ", "GUEST_UBOOT_VERSION: "},
-    {"] Linux version ", "GUEST_KERNEL_VERSION: "},
-    {"GUEST_BUILD_FINGERPRINT: ", "GUEST_BUILD_FINGERPRINT: "},
-};
-
-enum EventFormat {
-  kBare,          // Just an event, no extra data
-  kKeyValuePair,  // <stage> <key>=<value>
-};
-
-constexpr struct {
-  std::string_view stage;  // substring in the log identifying the stage
-  Event event;             // emitted when the stage is encountered
-  EventFormat format;      // how the log message is formatted
-} kStageTable[] = {
-    {cuttlefish::kBootStartedMessage, Event::BootStarted, kBare},
-    {cuttlefish::kBootCompletedMessage, Event::BootCompleted, kBare},
-    {cuttlefish::kBootFailedMessage, Event::BootFailed, kKeyValuePair},
-    {cuttlefish::kMobileNetworkConnectedMessage, Event::MobileNetworkConnected, kBare},
-    {cuttlefish::kWifiConnectedMessage, Event::WifiNetworkConnected, kBare},
-    {cuttlefish::kEthernetConnectedMessage, Event::EthernetNetworkConnected, kBare},
-    {cuttlefish::kAdbdStartedMessage, Event::AdbdStarted, kBare},
-    {cuttlefish::kFastbootdStartedMessage, Event::FastbootdStarted, kBare},
-    {cuttlefish::kScreenChangedMessage, Event::ScreenChanged, kKeyValuePair},
-    {cuttlefish::kBootloaderLoadedMessage, Event::BootloaderLoaded, kBare},
-    {cuttlefish::kKernelLoadedMessage, Event::KernelLoaded, kBare},
-    {cuttlefish::kDisplayPowerModeChangedMessage,
-     monitor::Event::DisplayPowerModeChanged, kKeyValuePair},
-};
+// Lets a busy console be drained with few reads and log file writes.
+constexpr size_t kReadBufferSize = 64 * 1024;
 
 void ProcessSubscriptions(
-    Json::Value message,
+    const Json::Value& message,
     std::vector<monitor::EventCallback>* subscribers) {
   auto active_subscription_count = subscribers->size();
   std::size_t idx = 0;
@@ -92,7 +55,11 @@ KernelLogServer::KernelLogServer(cuttlefish::SharedFD pipe_fd,
                                  const std::string& log_name)
     : pipe_fd_(pipe_fd),
       log_fd_(cuttlefish::SharedFD::Open(log_name.c_str(),
-                                         O_CREAT | O_RDWR | O_APPEND, 0666)) {}
+                                         O_CREAT | O_RDWR | O_APPEND, 0666)),
+      parser_([this](Json::Value message) {
+        ProcessSubscriptions(message, &subscribers_);
+      }),
+      read_buffer_(kReadBufferSize) {}
 
 void KernelLogServer::BeforeSelect(cuttlefish::SharedFDSet* fd_read) const {
   fd_read->Set(pipe_fd_);
@@ -109,67 +76,20 @@ void KernelLogServer::SubscribeToEvents(monitor::EventCallback callback) {
 }
 
 bool KernelLogServer::HandleIncomingMessage() {
-  const size_t buf_len = 256;
-  char buf[buf_len];
-  ssize_t ret = pipe_fd_->Read(buf, buf_len);
+  ssize_t ret = pipe_fd_->Read(read_buffer_.data(), read_buffer_.size());
   if (ret < 0) {
     LOG(ERROR) << "Could not read kernel logs: " << pipe_fd_->StrError();
     return false;
   }
   if (ret == 0) return false;
   // Write the log to a file
-  if (log_fd_->Write(buf, ret) < 0) {
+  if (log_fd_->Write(read_buffer_.data(), ret) < 0) {
     LOG(ERROR) << "Could not write kernel log to file: " << log_fd_->StrError();
     return false;
   }
 
   // Detect VIRTUAL_DEVICE_BOOT_*
-  for (ssize_t i=0; i<ret; i++) {
-    if ('\n' == buf[i]) {
-      for (auto& [match, prefix] : kInformationalPatterns) {
-        auto pos = line_.find(match);
-        if (std::string::npos != pos) {
-          LOG(INFO) << prefix << line_.substr(pos + match.size());
-        }
-      }
-      for (const auto& [stage, event, format] : kStageTable) {
-        auto pos = line_.find(stage);
-        if (std::string::npos != pos) {
-          // Log the stage
-          LOG(INFO) << stage;
-
-          Json::Value message;
-          message["event"] = event;
-          Json::Value metadata;
-
-          if (format == kKeyValuePair) {
-            // Expect space-separated key=value pairs in the log message.
-            const auto& fields =
-                android::base::Split(line_.substr(pos + stage.size()), " ");
-            for (std::string field : fields) {
-              field = android::base::Trim(field);
-              if (field.empty()) {
-                // Expected; android::base::Split() always returns at least
-                // one (possibly empty) string.
-                LOG(DEBUG) << "Empty field for line: " << line_;
-                continue;
-              }
-              const auto& keyvalue = android::base::Split(field, "=");
-              if (keyvalue.size() != 2) {
-                LOG(WARNING) << "Field is not in key=value format: " << field;
-                continue;
-              }
-              metadata[keyvalue[0]] = keyvalue[1];
-            }
-          }
-          message["metadata"] = metadata;
-          ProcessSubscriptions(message, &subscribers_);
-        }
-      }
-      line_.clear();
-    }
-    line_.append(1, buf[i]);
-  }
+  parser_.Process(read_buffer_.data(), ret);
 
   return true;
 }
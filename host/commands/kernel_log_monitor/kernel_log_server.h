@@ -25,6 +25,7 @@
 
 #include "common/libs/fs/shared_fd.h"
 #include "common/libs/fs/shared_select.h"
+#include "host/commands/kernel_log_monitor/kernel_log_parser.h"
 
 namespace monitor {
 
@@ -77,8 +78,9 @@ class KernelLogServer {
 
   cuttlefish::SharedFD pipe_fd_;
   cuttlefish::SharedFD log_fd_;
-  std::string line_;
   std::vector<EventCallback> subscribers_;
+  KernelLogParser parser_;
+  std::vector<char> read_buffer_;
 
   KernelLogServer(const KernelLogServer&) = delete;
   KernelLogServer& operator=(const KernelLogServer&) = delete;
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <string_view>
+
+namespace monitor {
+
+// Upper bound of the number of automaton states needed for the patterns.
+template <size_t N>
+constexpr size_t MaxMatcherStates(
+    const std::array<std::string_view, N>& patterns) {
+  size_t states = 1;
+  for (const auto& pattern : patterns) {
+    states += pattern.size();
+  }
+  return states;
+}
+
+// Number of distinct bytes in the patterns, plus one for all other bytes.
+template <size_t N>
+constexpr size_t MatcherCharClasses(
+    const std::array<std::string_view, N>& patterns) {
+  std::array<bool, 256> seen{};
+  size_t classes = 1;
+  for (const auto& pattern : patterns) {
+    for (char c : pattern) {
+      auto& s = seen[static_cast<uint8_t>(c)];
+      if (!s) {
+        s = true;
+        classes++;
+      }
+    }
+  }
+  return classes;
+}
+
+/**
+ * Aho-Corasick automaton finding any number of fixed patterns in a single
+ * pass over the input. It's meant to be built at compile time:
+ *
+ *   constexpr std::array<std::string_view, 2> kPatterns = {"foo", "bar"};
+ *   constexpr MultiPatternMatcher<MaxMatcherStates(kPatterns),
+ *                                 MatcherCharClasses(kPatterns)>
+ *       kMatcher(kPatterns);
+ *
+ * The goto and failure functions are folded into a single transition table
+ * indexed by byte class, so matching costs two table lookups per input byte.
+ * Bytes not present in any pattern share one class, which keeps the table
+ * small. Up to 64 patterns are supported, matches are reported as a bit mask
+ * of pattern indices.
+ */
+template <size_t kMaxStates, size_t kClasses>
+class MultiPatternMatcher {
+ public:
+  using State = uint16_t;
+  static constexpr State kInitialState = 0;
+
+  static_assert(kMaxStates <= UINT16_MAX, "Too many automaton states");
+  static_assert(kClasses <= 256, "Too many byte classes");
+
+  template <size_t N>
+  constexpr explicit MultiPatternMatcher(
+      const std::array<std::string_view, N>& patterns)
+      : char_class_(), transitions_(), matches_() {
+    static_assert(N <= 64, "Too many patterns");
+    constexpr State kNone = UINT16_MAX;
+
+    uint8_t next_class = 1;
+    for (const auto& pattern : patterns) {
+      for (char c : pattern) {
+        auto& byte_class = char_class_[static_cast<uint8_t>(c)];
+        if (byte_class == 0) {
+          byte_class = next_class++;
+        }
+      }
+    }
+
+    // Build the trie.
+    for (auto& row : transitions_) {
+      for (auto& next : row) {
+        next = kNone;
+      }
+    }
+    size_t num_states = 1;
+    for (size_t i = 0; i < N; i++) {
+      State state = kInitialState;
+      for (char c : patterns[i]) {
+        auto& next = transitions_[state][char_class_[static_cast<uint8_t>(c)]];
+        if (next == kNone) {
+          next = static_cast<State>(num_states++);
+        }
+        state = next;
+      }
+      matches_[state] |= uint64_t{1} << i;
+    }
+
+    // Visit the states in breadth first order, replacing missing transitions
+    // with the transitions of the longest proper suffix that is also a state.
+    std::array<State, kMaxStates> failure{};
+    std::array<State, kMaxStates> queue{};
+    size_t head = 0;
+    size_t tail = 0;
+    for (auto& next : transitions_[kInitialState]) {
+      if (next == kNone) {
+        next = kInitialState;
+      } else {
+        failure[next] = kInitialState;
+        queue[tail++] = next;
+      }
+    }
+    while (head < tail) {
+      State state = queue[head++];
+      matches_[state] |= matches_[failure[state]];
+      for (size_t c = 0; c < kClasses; c++) {
+        auto& next = transitions_[state][c];
+        if (next == kNone) {
+          next = transitions_[failure[state]][c];
+        } else {
+          failure[next] = transitions_[failure[state]][c];
+          queue[tail++] = next;
+        }
+      }
+    }
+  }
+
+  constexpr State Next(State state, char c) const {
+    return transitions_[state][char_class_[static_cast<uint8_t>(c)]];
+  }
+
+  // Bit mask of the patterns ending at the last byte consumed to reach state.
+  constexpr uint64_t Matches(State state) const { return matches_[state]; }
+
+ private:
+  std::array<uint8_t, 256> char_class_;
+  std::array<std::array<State, kClasses>, kMaxStates> transitions_;
+  std::array<uint64_t, kMaxStates> matches_;
+};
+
+}  // namespace monitor
@@ -0,0 +1,400 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "host/commands/log_collector/binary_log.h"
+
+#include <fcntl.h>
+#include <string.h>
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+
+#include "common/libs/fs/shared_buf.h"
+#include "common/libs/utils/files.h"
+
+namespace cuttlefish {
+namespace {
+
+constexpr char kLogMagic[] = "CFBLOG01";
+constexpr char kIndexMagic[] = "CFBLIDX1";
+constexpr size_t kMagicSize = 8;
+
+enum RecordType : uint8_t {
+  kMessage = 0,
+  kSource = 1,
+  // Only in the index.
+  kBlock = 2,
+};
+
+struct __attribute__((packed)) RecordHeader {
+  uint64_t timestamp;
+  uint32_t size;
+  uint16_t source;
+  uint8_t type;
+  uint8_t severity;
+};
+static_assert(sizeof(RecordHeader) == 16);
+
+// The payload of a kBlock index entry, whose timestamp is the block's first.
+struct __attribute__((packed)) BlockEntry {
+  uint64_t offset;
+  uint64_t size;
+  uint64_t last_timestamp;
+  uint64_t source_mask;
+};
+
+void AppendRecord(std::string& out, uint64_t timestamp, uint16_t source,
+                  RecordType type, uint8_t severity, const char* payload,
+                  size_t size) {
+  RecordHeader header = {
+      .timestamp = timestamp,
+      .size = static_cast<uint32_t>(size),
+      .source = source,
+      .type = type,
+      .severity = severity,
+  };
+  out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.append(payload, size);
+}
+
+// Calls |on_record| for every complete record in |data|, and returns how many
+// bytes they take up. A record cut short at the end is left out.
+template <typename F>
+size_t ForEachRecord(const std::string& data, size_t start, F on_record) {
+  size_t pos = start;
+  while (pos + sizeof(RecordHeader) <= data.size()) {
+    RecordHeader header;
+    memcpy(&header, data.data() + pos, sizeof(header));
+    if (data.size() - pos - sizeof(header) < header.size) {
+      break;
+    }
+    on_record(header, data.data() + pos + sizeof(header));
+    pos += sizeof(header) + header.size;
+  }
+  return pos;
+}
+
+struct ParsedIndex {
+  std::map<uint16_t, std::string> sources;
+  std::vector<BlockEntry> blocks;
+  std::vector<uint64_t> first_timestamps;
+  // The end of the last block entry. Source entries after it belong to a
+  // block that was never indexed, so they are ignored.
+  size_t valid_size = kMagicSize;
+};
+
+std::optional<ParsedIndex> ParseIndex(const std::string& contents) {
+  if (contents.compare(0, kMagicSize, kIndexMagic, kMagicSize) != 0) {
+    return {};
+  }
+  ParsedIndex index;
+  std::map<uint16_t, std::string> pending_sources;
+  ForEachRecord(contents, kMagicSize,
+                [&](const RecordHeader& header, const char* payload) {
+                  if (header.type == kSource) {
+                    pending_sources[header.source] =
+                        std::string(payload, header.size);
+                  } else if (header.type == kBlock &&
+                             header.size == sizeof(BlockEntry)) {
+                    BlockEntry block;
+                    memcpy(&block, payload, sizeof(block));
+                    index.blocks.push_back(block);
+                    index.first_timestamps.push_back(header.timestamp);
+                    index.sources.merge(pending_sources);
+                    pending_sources.clear();
+                    index.valid_size = payload + header.size - contents.data();
+                  }
+                });
+  return index;
+}
+
+}  // namespace
+
+std::string BinaryLogIndexPath(const std::string& log_path) {
+  return log_path + ".idx";
+}
+
+Result<BinaryLogWriter> BinaryLogWriter::Open(const std::string& path) {
+  BinaryLogWriter writer;
+  std::string index_path = BinaryLogIndexPath(path);
+
+  std::optional<ParsedIndex> index;
+  std::string magic(kMagicSize, '\0');
+  auto existing = SharedFD::Open(path, O_RDONLY);
+  std::string index_contents;
+  if (existing->IsOpen() &&
+      existing->Read(magic.data(), magic.size()) == kMagicSize &&
+      magic == kLogMagic &&
+      android::base::ReadFileToString(index_path, &index_contents)) {
+    index = ParseIndex(index_contents);
+  }
+  existing->Close();
+
+  int flags = O_CREAT | O_WRONLY | O_APPEND;
+  writer.log_ = SharedFD::Open(path, flags | (index ? 0 : O_TRUNC), 0644);
+  CF_EXPECT(writer.log_->IsOpen(),
+            "Failed to open \"" << path << "\": " << writer.log_->StrError());
+  writer.index_ =
+      SharedFD::Open(index_path, flags | (index ? 0 : O_TRUNC), 0644);
+  CF_EXPECT(writer.index_->IsOpen(), "Failed to open \""
+                                         << index_path << "\": "
+                                         << writer.index_->StrError());
+
+  if (!index) {
+    CF_EXPECT(WriteAll(writer.log_, kLogMagic, kMagicSize) == kMagicSize,
+              writer.log_->StrError());
+    CF_EXPECT(WriteAll(writer.index_, kIndexMagic, kMagicSize) == kMagicSize,
+              writer.index_->StrError());
+    writer.log_size_ = kMagicSize;
+    return writer;
+  }
+
+  // Anything past the last indexed block was cut short, or never made it
+  // into the index.
+  writer.log_size_ = kMagicSize;
+  if (!index->blocks.empty()) {
+    const auto& last = index->blocks.back();
+    writer.log_size_ = last.offset + last.size;
+    writer.last_timestamp_ = last.last_timestamp;
+  }
+  CF_EXPECT(writer.log_->Truncate(writer.log_size_) == 0,
+            writer.log_->StrError());
+  CF_EXPECT(writer.index_->Truncate(index->valid_size) == 0,
+            writer.index_->StrError());
+  for (const auto& [id, name] : index->sources) {
+    writer.source_ids_[name] = id;
+  }
+  return writer;
+}
+
+uint16_t BinaryLogWriter::SourceId(const std::string& source,
+                                   std::string& block, std::string& index,
+                                   uint64_t timestamp) {
+  auto it = source_ids_.find(source);
+  if (it != source_ids_.end()) {
+    return it->second;
+  }
+  uint16_t id = source_ids_.size();
+  source_ids_[source] = id;
+  AppendRecord(block, timestamp, id, kSource, 0, source.data(), source.size());
+  AppendRecord(index, timestamp, id, kSource, 0, source.data(), source.size());
+  return id;
+}
+
+Result<void> BinaryLogWriter::WriteBlock(std::vector<LogRecord> records) {
+  if (records.empty()) {
+    return {};
+  }
+  std::stable_sort(records.begin(), records.end(),
+                   [](const LogRecord& a, const LogRecord& b) {
+                     return a.timestamp < b.timestamp;
+                   });
+  std::string block;
+  std::string index;
+  uint64_t first_timestamp = std::max(records.front().timestamp,
+                                      last_timestamp_);
+  uint64_t source_mask = 0;
+  for (const auto& record : records) {
+    CF_EXPECT(source_ids_.count(record.source) ||
+                  source_ids_.size() <= std::numeric_limits<uint16_t>::max(),
+              "Too many log sources");
+    last_timestamp_ = std::max(record.timestamp, last_timestamp_);
+    uint16_t id = SourceId(record.source, block, index, last_timestamp_);
+    source_mask |= uint64_t(1) << (id % 64);
+    AppendRecord(block, last_timestamp_, id, kMessage, record.severity,
+                 record.message.data(), record.message.size());
+  }
+  BlockEntry entry = {
+      .offset = log_size_,
+      .size = block.size(),
+      .last_timestamp = last_timestamp_,
+      .source_mask = source_mask,
+  };
+  AppendRecord(index, first_timestamp, 0, kBlock, 0,
+               reinterpret_cast<const char*>(&entry), sizeof(entry));
+
+  // The index is written last so that it never points past the log.
+  CF_EXPECT(WriteAll(log_, block) == (ssize_t)block.size(),
+            "Failed to write the log: " << log_->StrError());
+  log_size_ += block.size();
+  CF_EXPECT(WriteAll(index_, index) == (ssize_t)index.size(),
+            "Failed to write the index: " << index_->StrError());
+  return {};
+}
+
+Result<BinaryLogReader> BinaryLogReader::Open(const std::string& path) {
+  BinaryLogReader reader;
+  reader.path_ = path;
+  reader.log_ = SharedFD::Open(path, O_RDONLY);
+  CF_EXPECT(reader.log_->IsOpen(),
+            "Failed to open \"" << path << "\": " << reader.log_->StrError());
+  std::string magic(kMagicSize, '\0');
+  CF_EXPECT(reader.log_->Read(magic.data(), magic.size()) == kMagicSize &&
+                magic == kLogMagic,
+            "\"" << path << "\" is not a binary log");
+  CF_EXPECT(reader.LoadIndex());
+  return reader;
+}
+
+Result<void> BinaryLogReader::LoadIndex() {
+  std::string contents;
+  std::optional<ParsedIndex> index;
+  if (android::base::ReadFileToString(BinaryLogIndexPath(path_), &contents)) {
+    index = ParseIndex(contents);
+  }
+  uint64_t indexed_end = kMagicSize;
+  if (index) {
+    source_names_ = std::move(index->sources);
+    for (size_t i = 0; i < index->blocks.size(); i++) {
+      const auto& entry = index->blocks[i];
+      blocks_.push_back(Block{
+          .offset = entry.offset,
+          .size = entry.size,
+          .first_timestamp = index->first_timestamps[i],
+          .last_timestamp = entry.last_timestamp,
+          .source_mask = entry.source_mask,
+      });
+      indexed_end = entry.offset + entry.size;
+    }
+  } else {
+    LOG(WARNING) << "No index for \"" << path_ << "\", reading all of it";
+  }
+  // The last block may not be in the index yet, so whatever follows the
+  // indexed blocks is read as one block that matches everything.
+  uint64_t log_size = FileSize(path_);
+  if (log_size > indexed_end) {
+    blocks_.push_back(Block{
+        .offset = indexed_end,
+        .size = log_size - indexed_end,
+        .first_timestamp = 0,
+        .last_timestamp = std::numeric_limits<uint64_t>::max(),
+        .source_mask = std::numeric_limits<uint64_t>::max(),
+    });
+  }
+  return {};
+}
+
+bool BinaryLogReader::MayMatch(const Block& block,
+                               const LogFilter& filter) const {
+  if (block.last_timestamp < filter.since ||
+      block.first_timestamp >= filter.until) {
+    return false;
+  }
+  if (filter.sources.empty()) {
+    return true;
+  }
+  uint64_t mask = 0;
+  for (const auto& [id, name] : source_names_) {
+    if (filter.sources.count(name)) {
+      mask |= uint64_t(1) << (id % 64);
+    }
+  }
+  return (block.source_mask & mask) != 0;
+}
+
+Result<std::vector<LogRecord>> BinaryLogReader::ReadBlock(
+    const Block& block, const LogFilter& filter) {
+  blocks_read_++;
+  std::string data(block.size, '\0');
+  size_t done = 0;
+  while (done < data.size()) {
+    ssize_t count =
+        log_->PRead(data.data() + done, data.size() - done, block.offset + done);
+    CF_EXPECT(count >= 0, "Failed to read \"" << path_
+                                              << "\": " << log_->StrError());
+    if (count == 0) {
+      // Truncated by a writer that found it cut short.
+      data.resize(done);
+      break;
+    }
+    done += count;
+  }
+  std::vector<LogRecord> records;
+  ForEachRecord(data, 0, [&](const RecordHeader& header, const char* payload) {
+    if (header.type == kSource) {
+      source_names_[header.source] = std::string(payload, header.size);
+      return;
+    }
+    if (header.type != kMessage || header.timestamp < filter.since ||
+        header.timestamp >= filter.until) {
+      return;
+    }
+    const std::string& source = source_names_[header.source];
+    if (!filter.sources.empty() && !filter.sources.count(source)) {
+      return;
+    }
+    records.push_back(LogRecord{
+        .timestamp = header.timestamp,
+        .source = source,
+        .severity = static_cast<android::base::LogSeverity>(header.severity),
+        .message = std::string(payload, header.size),
+    });
+  });
+  return records;
+}
+
+Result<std::vector<LogRecord>> BinaryLogReader::Read(const LogFilter& filter) {
+  blocks_read_ = 0;
+  std::vector<LogRecord> records;
+  for (const auto& block : blocks_) {
+    if (!MayMatch(block, filter)) {
+      continue;
+    }
+    auto block_records = CF_EXPECT(ReadBlock(block, filter));
+    std::move(block_records.begin(), block_records.end(),
+              std::back_inserter(records));
+  }
+  return records;
+}
+
+Result<std::vector<LogRecord>> BinaryLogReader::Tail(size_t count,
+                                                     const LogFilter& filter) {
+  blocks_read_ = 0;
+  std::vector<std::vector<LogRecord>> tail_blocks;
+  size_t found = 0;
+  for (auto block = blocks_.rbegin(); block != blocks_.rend() && found < count;
+       block++) {
+    if (!MayMatch(*block, filter)) {
+      continue;
+    }
+    tail_blocks.push_back(CF_EXPECT(ReadBlock(*block, filter)));
+    found += tail_blocks.back().size();
+  }
+  std::vector<LogRecord> records;
+  for (auto it = tail_blocks.rbegin(); it != tail_blocks.rend(); it++) {
+    std::move(it->begin(), it->end(), std::back_inserter(records));
+  }
+  if (records.size() > count) {
+    records.erase(records.begin(), records.end() - count);
+  }
+  return records;
+}
+
+std::vector<std::string> BinaryLogReader::Sources() const {
+  std::vector<std::string> sources;
+  for (const auto& [id, name] : source_names_) {
+    sources.push_back(name);
+  }
+  return sources;
+}
+
+}  // namespace cuttlefish
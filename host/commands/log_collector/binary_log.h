@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <android-base/logging.h>
+
+#include "common/libs/fs/shared_fd.h"
+#include "common/libs/utils/result.h"
+
+namespace cuttlefish {
+
+/*
+ * The binary log is a sequence of blocks, each holding the records of one
+ * flush in timestamp order. Every record is a fixed header followed by its
+ * payload:
+ *
+ *   uint64_t timestamp;  // nanoseconds since the epoch
+ *   uint32_t size;       // of the payload
+ *   uint16_t source;     // id of the process the record came from
+ *   uint8_t type;        // kMessage or kSource
+ *   uint8_t severity;    // android::base::LogSeverity
+ *
+ * Source records assign a name to an id before its first message, so the log
+ * can be read without its index. The index, kept in a file next to the log,
+ * has the same source records plus one entry per block with the block's
+ * position, time range and sources, so readers can skip blocks that can't
+ * match without reading them. Everything is in host byte order since the log
+ * never leaves the host that wrote it.
+ *
+ * log_reader prints the log, filtered by source and time or only its tail.
+ */
+
+struct LogRecord {
+  uint64_t timestamp;
+  std::string source;
+  android::base::LogSeverity severity;
+  std::string message;
+};
+
+// Returns the path of the index kept next to the log at |log_path|.
+std::string BinaryLogIndexPath(const std::string& log_path);
+
+class BinaryLogWriter {
+ public:
+  // Appends to the log at |path|, creating it if necessary. The end of a log
+  // cut short by a crash is dropped, and a log without a usable index is
+  // started over.
+  static Result<BinaryLogWriter> Open(const std::string& path);
+
+  // Writes |records| as one block, in timestamp order. Timestamps are raised
+  // where needed to stay after those already written, so the log as a whole
+  // stays ordered even if the clock goes backwards.
+  Result<void> WriteBlock(std::vector<LogRecord> records);
+
+  uint64_t last_timestamp() const { return last_timestamp_; }
+
+ private:
+  BinaryLogWriter() = default;
+
+  uint16_t SourceId(const std::string& source, std::string& block,
+                    std::string& index, uint64_t timestamp);
+
+  SharedFD log_;
+  SharedFD index_;
+  uint64_t log_size_ = 0;
+  uint64_t last_timestamp_ = 0;
+  std::map<std::string, uint16_t> source_ids_;
+};
+
+struct LogFilter {
+  // Only records from these sources, or from all of them if empty.
+  std::set<std::string> sources;
+  // Only records with since <= timestamp < until.
+  uint64_t since = 0;
+  uint64_t until = std::numeric_limits<uint64_t>::max();
+};
+
+class BinaryLogReader {
+ public:
+  static Result<BinaryLogReader> Open(const std::string& path);
+
+  // Returns the matching records in timestamp order.
+  Result<std::vector<LogRecord>> Read(const LogFilter& filter = {});
+  // Returns the last |count| matching records in timestamp order, reading
+  // the log backwards a block at a time.
+  Result<std::vector<LogRecord>> Tail(size_t count,
+                                      const LogFilter& filter = {});
+
+  // The names of all the sources that wrote to the log.
+  std::vector<std::string> Sources() const;
+
+  // How many blocks were read by the last call, for telling how much the
+  // index saved.
+  size_t blocks_read() const { return blocks_read_; }
+
+ private:
+  struct Block {
+    uint64_t offset;
+    uint64_t size;
+    uint64_t first_timestamp;
+    uint64_t last_timestamp;
+    // Bit (id % 64) is set for every source with records in the block.
+    uint64_t source_mask;
+  };
+
+  BinaryLogReader() = default;
+
+  Result<void> LoadIndex();
+  bool MayMatch(const Block& block, const LogFilter& filter) const;
+  Result<std::vector<LogRecord>> ReadBlock(const Block& block,
+                                           const LogFilter& filter);
+
+  std::string path_;
+  SharedFD log_;
+  std::vector<Block> blocks_;
+  std::map<uint16_t, std::string> source_names_;
+  size_t blocks_read_ = 0;
+};
+
+}  // namespace cuttlefish
@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "host/commands/log_collector/binary_log.h"
+
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+
+#include "common/libs/utils/files.h"
+
+namespace cuttlefish {
+namespace {
+
+LogRecord Record(uint64_t timestamp, const std::string& source,
+                 const std::string& message) {
+  return LogRecord{
+      .timestamp = timestamp,
+      .source = source,
+      .severity = android::base::DEBUG,
+      .message = message,
+  };
+}
+
+std::vector<std::string> Messages(const std::vector<LogRecord>& records) {
+  std::vector<std::string> messages;
+  for (const auto& record : records) {
+    messages.push_back(record.message);
+  }
+  return messages;
+}
+
+class BinaryLogTest : public ::testing::Test {
+ protected:
+  BinaryLogTest() : path_(std::string(dir_.path) + "/launcher.binlog") {}
+
+  // Writes ten blocks of ten records, alternating between two sources, with
+  // timestamps 0 to 99 in order.
+  void WriteBlocks() {
+    auto writer = BinaryLogWriter::Open(path_);
+    ASSERT_TRUE(writer.ok()) << writer.error().Trace();
+    for (int block = 0; block < 10; block++) {
+      std::vector<LogRecord> records;
+      for (int i = 0; i < 10; i++) {
+        int timestamp = block * 10 + i;
+        std::string source = block % 2 ? "crosvm" : "wmediumd";
+        records.push_back(Record(timestamp, source, std::to_string(timestamp)));
+      }
+      auto result = writer->WriteBlock(records);
+      ASSERT_TRUE(result.ok()) << result.error().Trace();
+    }
+  }
+
+  TemporaryDir dir_;
+  std::string path_;
+};
+
+TEST_F(BinaryLogTest, ReadsRecordsInTimestampOrder) {
+  auto writer = BinaryLogWriter::Open(path_);
+  ASSERT_TRUE(writer.ok()) << writer.error().Trace();
+  ASSERT_TRUE(writer
+                  ->WriteBlock({Record(3, "crosvm", "c"),
+                                Record(1, "wmediumd", "a"),
+                                Record(2, "crosvm", "b")})
+                  .ok());
+
+  auto reader = BinaryLogReader::Open(path_);
+  ASSERT_TRUE(reader.ok()) << reader.error().Trace();
+  auto records = reader->Read();
+
+  ASSERT_TRUE(records.ok()) << records.error().Trace();
+  ASSERT_EQ(records->size(), 3);
+  EXPECT_EQ(Messages(*records), (std::vector<std::string>{"a", "b", "c"}));
+  EXPECT_EQ((*records)[0].source, "wmediumd");
+  EXPECT_EQ((*records)[1].source, "crosvm");
+  EXPECT_EQ((*records)[1].timestamp, 2);
+}
+
+TEST_F(BinaryLogTest, KeepsOrderWhenClockGoesBackwards) {
+  auto writer = BinaryLogWriter::Open(path_);
+  ASSERT_TRUE(writer.ok()) << writer.error().Trace();
+  ASSERT_TRUE(writer->WriteBlock({Record(100, "crosvm", "first")}).ok());
+  ASSERT_TRUE(writer->WriteBlock({Record(50, "crosvm", "second")}).ok());
+
+  auto reader = BinaryLogReader::Open(path_);
+  ASSERT_TRUE(reader.ok()) << reader.error().Trace();
+  auto records = reader->Read();
+
+  ASSERT_TRUE(records.ok()) << records.error().Trace();
+  ASSERT_EQ(records->size(), 2);
+  EXPECT_EQ((*records)[1].message, "second");
+  EXPECT_GE((*records)[1].timestamp, (*records)[0].timestamp);
+}
+
+TEST_F(BinaryLogTest, FiltersBySourceUsingIndex) {
+  WriteBlocks();
+  auto reader = BinaryLogReader::Open(path_);
+  ASSERT_TRUE(reader.ok()) << reader.error().Trace();
+
+  auto records = reader->Read(LogFilter{.sources = {"crosvm"}});
+
+  ASSERT_TRUE(records.ok()) << records.error().Trace();
+  EXPECT_EQ(records->size(), 50);
+  for (const auto& record : *records) {
+    EXPECT_EQ(record.source, "crosvm");
+  }
+  EXPECT_EQ(reader->blocks_read(), 5);
+}
+
+TEST_F(BinaryLogTest, FiltersByTimeUsingIndex) {
+  WriteBlocks();
+  auto reader = BinaryLogReader::Open(path_);
+  ASSERT_TRUE(reader.ok()) << reader.error().Trace();
+
+  auto records = reader->Read(LogFilter{.since = 25, .until = 35});
+
+  ASSERT_TRUE(records.ok()) << records.error().Trace();
+  std::vector<std::string> expected;
+  for (int i = 25; i < 35; i++) {
+    expected.push_back(std::to_string(i));
+  }
+  EXPECT_EQ(Messages(*records), expected);
+  EXPECT_EQ(reader->blocks_read(), 2);
+}
+
+TEST_F(BinaryLogTest, TailsFromTheEnd) {
+  WriteBlocks();
+  auto reader = BinaryLogReader::Open(path_);
+  ASSERT_TRUE(reader.ok()) << reader.error().Trace();
+
+  auto records = reader->Tail(3, LogFilter{.sources = {"wmediumd"}});
+
+  ASSERT_TRUE(records.ok()) << records.error().Trace();
+  EXPECT_EQ(Messages(*records), (std::vector<std::string>{"87", "88", "89"}));
+  EXPECT_EQ(reader->blocks_read(), 1);
+}
+
+TEST_F(BinaryLogTest, ListsSources) {
+  WriteBlocks();
+  auto reader = BinaryLogReader::Open(path_);
+  ASSERT_TRUE(reader.ok()) << reader.error().Trace();
+
+  EXPECT_EQ(reader->Sources(),
+            (std::vector<std::string>{"wmediumd", "crosvm"}));
+}
+
+TEST_F(BinaryLogTest, AppendsAfterReopening) {
+  WriteBlocks();
+  {
+    auto writer = BinaryLogWriter::Open(path_);
+    ASSERT_TRUE(writer.ok()) << writer.error().Trace();
+    EXPECT_EQ(writer->last_timestamp(), 99);
+    ASSERT_TRUE(writer
+                    ->WriteBlock({Record(100, "crosvm", "100"),
+                                  Record(101, "openwrt", "101")})
+                    .ok());
+  }
+
+  auto reader = BinaryLogReader::Open(path_);
+  ASSERT_TRUE(reader.ok()) << reader.error().Trace();
+  auto records = reader->Read(LogFilter{.sources = {"crosvm", "openwrt"}});
+
+  ASSERT_TRUE(records.ok()) << records.error().Trace();
+  ASSERT_EQ(records->size(), 52);
+  EXPECT_EQ(records->back().source, "openwrt");
+  EXPECT_EQ((*records)[50].source, "crosvm");
+}
+
+TEST_F(BinaryLogTest, DropsUnindexedTailOnReopen) {
+  WriteBlocks();
+  {
+    auto writer = BinaryLogWriter::Open(path_);
+    ASSERT_TRUE(writer.ok()) << writer.error().Trace();
+    ASSERT_TRUE(writer->WriteBlock({Record(100, "crosvm", "lost")}).ok());
+  }
+  // As if the collector died while writing the block's index entry.
+  auto index_path = BinaryLogIndexPath(path_);
+  ASSERT_EQ(truncate(index_path.c_str(), FileSize(index_path) - 3), 0);
+
+  // Readers still see the unindexed block.
+  auto reader = BinaryLogReader::Open(path_);
+  ASSERT_TRUE(reader.ok()) << reader.error().Trace();
+  auto records = reader->Read();
+  ASSERT_TRUE(records.ok()) << records.error().Trace();
+  EXPECT_EQ(records->size(), 101);
+
+  {
+    auto writer = BinaryLogWriter::Open(path_);
+    ASSERT_TRUE(writer.ok()) << writer.error().Trace();
+    ASSERT_TRUE(writer->WriteBlock({Record(101, "crosvm", "kept")}).ok());
+  }
+  reader = BinaryLogReader::Open(path_);
+  ASSERT_TRUE(reader.ok()) << reader.error().Trace();
+  records = reader->Tail(2);
+  ASSERT_TRUE(records.ok()) << records.error().Trace();
+  EXPECT_EQ(Messages(*records), (std::vector<std::string>{"99", "kept"}));
+}
+
+TEST_F(BinaryLogTest, ReadsTornLastBlock) {
+  WriteBlocks();
+  auto size = FileSize(path_);
+  {
+    auto writer = BinaryLogWriter::Open(path_);
+    ASSERT_TRUE(writer.ok()) << writer.error().Trace();
+    ASSERT_TRUE(writer
+                    ->WriteBlock({Record(100, "crosvm", "whole"),
+                                  Record(101, "crosvm", "torn")})
+                    .ok());
+  }
+  ASSERT_EQ(truncate(path_.c_str(), FileSize(path_) - 2), 0);
+  ASSERT_GT(FileSize(path_), size);
+
+  auto reader = BinaryLogReader::Open(path_);
+  ASSERT_TRUE(reader.ok()) << reader.error().Trace();
+  auto records = reader->Tail(1);
+
+  ASSERT_TRUE(records.ok()) << records.error().Trace();
+  EXPECT_EQ(Messages(*records), (std::vector<std::string>{"whole"}));
+}
+
+TEST_F(BinaryLogTest, RejectsOtherFiles) {
+  ASSERT_TRUE(android::base::WriteStringToFile("not a log", path_));
+
+  EXPECT_FALSE(BinaryLogReader::Open(path_).ok());
+}
+
+}  // namespace
+}  // namespace cuttlefish
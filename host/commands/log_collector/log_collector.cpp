@@ -0,0 +1,264 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "host/commands/log_collector/log_collector.h"
+
+#include <sys/epoll.h>
+
+#include <algorithm>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <android-base/strings.h>
+
+#include "common/libs/utils/unix_sockets.h"
+
+namespace cuttlefish {
+namespace {
+
+constexpr size_t kMaxEvents = 64;
+constexpr size_t kReadSize = 1 << 16;
+
+uint64_t Now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace
+
+android::base::LogSeverity GuessSeverity(std::string_view line) {
+  if (!android::base::ConsumePrefix(&line, "[")) {
+    return android::base::DEBUG;
+  }
+  line = line.substr(0, line.find(']'));
+  for (const auto& word : android::base::Split(std::string(line), " ")) {
+    if (word == "ERROR" || word == "FATAL") {
+      return android::base::ERROR;
+    } else if (word == "WARN" || word == "WARNING") {
+      return android::base::WARNING;
+    } else if (word == "VERBOSE" || word == "TRACE") {
+      return android::base::VERBOSE;
+    } else if (word == "INFO" || word == "DEBUG") {
+      return android::base::DEBUG;
+    }
+  }
+  return android::base::DEBUG;
+}
+
+Result<LogCollector> LogCollector::Create(SharedFD server, BinaryLogWriter log,
+                                          TextLog text_log, Options options) {
+  CF_EXPECT(server->IsOpen(), "Invalid server socket: " << server->StrError());
+  auto epoll = CF_EXPECT(Epoll::Create());
+  CF_EXPECT(epoll.Add(server, EPOLLIN));
+  return LogCollector(std::move(server), std::move(log), std::move(text_log),
+                      options, std::move(epoll));
+}
+
+LogCollector::LogCollector(SharedFD server, BinaryLogWriter log,
+                           TextLog text_log, Options options, Epoll epoll)
+    : server_(std::move(server)),
+      log_(std::move(log)),
+      text_log_(std::move(text_log)),
+      options_(options),
+      epoll_(std::move(epoll)) {}
+
+Result<void> LogCollector::Run(SharedFD stop) {
+  stop_ = stop;
+  CF_EXPECT(epoll_.Add(stop_, EPOLLIN));
+  while (!stopping_) {
+    CF_EXPECT(HandleEvents(MillisecondsUntilFlush()));
+    if (batch_.size() >= options_.max_batch_lines ||
+        MillisecondsUntilFlush() == 0) {
+      CF_EXPECT(Flush());
+    }
+  }
+  // The writers are gone by now but may have left output behind, and
+  // processes that registered just before stopping may not be known yet.
+  CF_EXPECT(epoll_.Delete(stop_));
+  while (CF_EXPECT(HandleEvents(0)) > 0) {
+    if (batch_.size() >= options_.max_batch_lines) {
+      CF_EXPECT(Flush());
+    }
+  }
+  for (auto& [fd, source] : sources_) {
+    AddLine(source, source.partial_timestamp, std::move(source.partial_line));
+  }
+  CF_EXPECT(Flush());
+  return {};
+}
+
+Result<size_t> LogCollector::HandleEvents(int timeout) {
+  auto events = CF_EXPECT(epoll_.WaitMany(kMaxEvents, timeout));
+  for (const auto& event : events) {
+    if (event.fd == stop_) {
+      stopping_ = true;
+    } else if (event.fd == server_) {
+      CF_EXPECT(AcceptClient());
+    } else if (clients_.count(event.fd)) {
+      CF_EXPECT(RegisterSource(event.fd));
+    } else {
+      CF_EXPECT(ReadSource(event.fd));
+    }
+  }
+  return events.size();
+}
+
+Result<void> LogCollector::AcceptClient() {
+  auto client = SharedFD::Accept(*server_);
+  CF_EXPECT(client->IsOpen(), "Failed to accept: " << client->StrError());
+  CF_EXPECT(epoll_.Add(client, EPOLLIN));
+  clients_.insert(client);
+  return {};
+}
+
+Result<void> LogCollector::RegisterSource(SharedFD client) {
+  CF_EXPECT(epoll_.Delete(client));
+  clients_.erase(client);
+  // A misbehaving client only loses its own logs.
+  auto message = UnixMessageSocket(client).ReadMessage();
+  if (!message.ok()) {
+    LOG(ERROR) << "Failed to read a registration: "
+               << message.error().Message();
+    return {};
+  }
+  auto fds = message->FileDescriptors();
+  if (!fds.ok() || fds->size() != 1 || message->data.empty()) {
+    LOG(ERROR) << "Expected a name and one file descriptor, ignoring";
+    return {};
+  }
+  std::string name(message->data.begin(), message->data.end());
+  SharedFD fd = (*fds)[0];
+  CF_EXPECT(epoll_.Add(fd, EPOLLIN));
+  sources_[fd] = Source{.name = name};
+  LOG(DEBUG) << "Collecting logs from " << name;
+  return {};
+}
+
+Result<void> LogCollector::ReadSource(SharedFD fd) {
+  auto it = sources_.find(fd);
+  CF_EXPECT(it != sources_.end(), "Event for an unknown file descriptor");
+  Source& source = it->second;
+
+  std::string buffer(kReadSize, '\0');
+  ssize_t size = fd->Read(buffer.data(), buffer.size());
+  uint64_t timestamp = Now();
+  if (size <= 0) {
+    if (size < 0) {
+      LOG(ERROR) << "Failed to read logs from " << source.name << ": "
+                 << fd->StrError();
+    }
+    AddLine(source, source.partial_timestamp, std::move(source.partial_line));
+    LOG(DEBUG) << "Finished collecting logs from " << source.name;
+    CF_EXPECT(epoll_.Delete(fd));
+    sources_.erase(it);
+    return {};
+  }
+  buffer.resize(size);
+
+  std::string_view rest = buffer;
+  for (auto newline = rest.find('\n'); newline != std::string_view::npos;
+       newline = rest.find('\n')) {
+    uint64_t line_timestamp = timestamp;
+    std::string line;
+    if (!source.partial_line.empty()) {
+      line_timestamp = source.partial_timestamp;
+      line = std::move(source.partial_line);
+      source.partial_line.clear();
+    }
+    line.append(rest.substr(0, newline));
+    rest.remove_prefix(newline + 1);
+    AddLine(source, line_timestamp, std::move(line));
+  }
+  if (!rest.empty()) {
+    if (source.partial_line.empty()) {
+      source.partial_timestamp = timestamp;
+    }
+    source.partial_line.append(rest);
+    // Output that never ends a line is still logged, in pieces.
+    if (source.partial_line.size() >= kReadSize) {
+      AddLine(source, source.partial_timestamp,
+              std::move(source.partial_line));
+      source.partial_line.clear();
+    }
+  }
+  return {};
+}
+
+void LogCollector::AddLine(const Source& source, uint64_t timestamp,
+                           std::string line) {
+  if (!line.empty() && line.back() == '\r') {
+    line.pop_back();
+  }
+  if (line.empty()) {
+    return;
+  }
+  if (batch_.empty()) {
+    batch_started_ = std::chrono::steady_clock::now();
+  }
+  auto severity = GuessSeverity(line);
+  batch_.push_back(LogRecord{
+      .timestamp = timestamp,
+      .source = source.name,
+      .severity = severity,
+      .message = std::move(line),
+  });
+}
+
+Result<void> LogCollector::Flush() {
+  if (batch_.empty()) {
+    return {};
+  }
+  std::vector<LogRecord> batch;
+  std::swap(batch, batch_);
+  std::stable_sort(batch.begin(), batch.end(),
+                   [](const LogRecord& a, const LogRecord& b) {
+                     return a.timestamp < b.timestamp;
+                   });
+  std::vector<std::tuple<android::base::LogSeverity, std::string, std::string>>
+      text;
+  for (size_t begin = 0; begin < batch.size();) {
+    size_t end = begin + 1;
+    std::string message = batch[begin].message;
+    while (end < batch.size() && batch[end].source == batch[begin].source &&
+           batch[end].severity == batch[begin].severity) {
+      message += "\n" + batch[end++].message;
+    }
+    text.emplace_back(batch[begin].severity, batch[begin].source,
+                      std::move(message));
+    begin = end;
+  }
+  // Anything in the launcher log can be found in the binary log too.
+  CF_EXPECT(log_.WriteBlock(std::move(batch)));
+  for (const auto& [severity, source, message] : text) {
+    text_log_(severity, source, message);
+  }
+  return {};
+}
+
+int LogCollector::MillisecondsUntilFlush() const {
+  if (batch_.empty()) {
+    return -1;
+  }
+  auto waited = std::chrono::steady_clock::now() - batch_started_;
+  auto left = options_.flush_interval -
+              std::chrono::duration_cast<std::chrono::milliseconds>(waited);
+  return std::max<int>(0, left.count());
+}
+
+}  // namespace cuttlefish
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <android-base/logging.h>
+
+#include "common/libs/fs/epoll.h"
+#include "common/libs/fs/shared_fd.h"
+#include "common/libs/utils/result.h"
+#include "host/commands/log_collector/binary_log.h"
+
+namespace cuttlefish {
+
+// Guesses the severity of a line from a subprocess, from the level in a
+// bracketed prefix such as "[2023-01-01T00:00:00Z ERROR crosvm]". Lines
+// without one are logged at DEBUG, as are INFO lines so that they stay off
+// the console by default.
+android::base::LogSeverity GuessSeverity(std::string_view line);
+
+/*
+ * Reads the stdout and stderr of every subprocess of an instance from a
+ * single thread. Processes register by connecting to the collector's
+ * SOCK_SEQPACKET socket and sending one message with their name as the data
+ * and the read end of their output as an SCM_RIGHTS file descriptor.
+ *
+ * Output is split into lines, timestamped as the lines arrive and written
+ * out in batches: to the binary log as one block, and through |text_log| to
+ * the launcher log, tagged with the name of the process.
+ *
+ * Registrations only live as long as the collector process. run_cvd keeps
+ * every registered fd and registers all of them again with each collector it
+ * starts, so when one crashes and the process monitor restarts it the new one
+ * carries on reading from the same pipes and fifos. Lines that the crashed
+ * collector had read but not flushed yet are lost.
+ */
+class LogCollector {
+ public:
+  // Consecutive lines of one source with the same severity, joined with
+  // newlines.
+  using TextLog = std::function<void(android::base::LogSeverity severity,
+                                     const std::string& source,
+                                     const std::string& message)>;
+
+  struct Options {
+    // A batch is written once it has this many lines...
+    size_t max_batch_lines = 1024;
+    // ...or once its first line has waited this long.
+    std::chrono::milliseconds flush_interval{100};
+  };
+
+  static Result<LogCollector> Create(SharedFD server, BinaryLogWriter log,
+                                     TextLog text_log, Options options);
+
+  // Collects until |stop| is readable, then reads whatever is left and
+  // returns once all of it is written out. The caller is expected to stop
+  // the processes writing the logs first.
+  Result<void> Run(SharedFD stop);
+
+ private:
+  struct Source {
+    std::string name;
+    std::string partial_line;
+    // When the first byte of |partial_line| arrived.
+    uint64_t partial_timestamp = 0;
+  };
+
+  LogCollector(SharedFD server, BinaryLogWriter log, TextLog text_log,
+               Options options, Epoll epoll);
+
+  // Handles the events that are ready, waiting at most |timeout| ms for them.
+  // Returns how many there were.
+  Result<size_t> HandleEvents(int timeout);
+  Result<void> AcceptClient();
+  Result<void> RegisterSource(SharedFD client);
+  Result<void> ReadSource(SharedFD fd);
+  void AddLine(const Source& source, uint64_t timestamp, std::string line);
+  Result<void> Flush();
+  int MillisecondsUntilFlush() const;
+
+  SharedFD server_;
+  BinaryLogWriter log_;
+  TextLog text_log_;
+  Options options_;
+  Epoll epoll_;
+  SharedFD stop_;
+  bool stopping_ = false;
+  // Connections that haven't registered their source yet.
+  std::set<SharedFD> clients_;
+  std::map<SharedFD, Source> sources_;
+  std::vector<LogRecord> batch_;
+  std::chrono::steady_clock::time_point batch_started_;
+};
+
+}  // namespace cuttlefish
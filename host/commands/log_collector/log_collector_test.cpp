@@ -0,0 +1,326 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "host/commands/log_collector/log_collector.h"
+
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+
+#include "common/libs/fs/shared_buf.h"
+#include "common/libs/utils/unix_sockets.h"
+#include "host/libs/config/logging.h"
+
+namespace cuttlefish {
+namespace {
+
+struct TextLine {
+  android::base::LogSeverity severity;
+  std::string source;
+  std::string message;
+
+  bool operator==(const TextLine&) const = default;
+};
+
+std::ostream& operator<<(std::ostream& out, const TextLine& line) {
+  return out << line.severity << " " << line.source << ": " << line.message;
+}
+
+class LogCollectorTest : public ::testing::Test {
+ protected:
+  LogCollectorTest()
+      : socket_path_(std::string(dir_.path) + "/log_collector.sock"),
+        log_path_(std::string(dir_.path) + "/launcher.binlog"),
+        stop_(SharedFD::Event()) {
+    server_ = SharedFD::SocketLocalServer(socket_path_, false, SOCK_SEQPACKET,
+                                          0666);
+    // Every process of an instance may register before the collector runs.
+    server_->Listen(16);
+  }
+
+  ~LogCollectorTest() {
+    if (thread_.joinable()) {
+      Stop();
+    }
+  }
+
+  void Start(LogCollector::Options options = {}) {
+    auto log = BinaryLogWriter::Open(log_path_);
+    ASSERT_TRUE(log.ok()) << log.error().Trace();
+    auto text_log = [this](android::base::LogSeverity severity,
+                           const std::string& source,
+                           const std::string& message) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      text_.push_back(TextLine{severity, source, message});
+    };
+    auto collector =
+        LogCollector::Create(server_, std::move(*log), text_log, options);
+    ASSERT_TRUE(collector.ok()) << collector.error().Trace();
+    thread_ = std::thread(
+        [this, collector = std::move(*collector)]() mutable {
+          result_ = collector.Run(stop_);
+        });
+  }
+
+  void Stop() {
+    stop_->EventfdWrite(1);
+    thread_.join();
+  }
+
+  // Registers a pipe as |name|'s output and returns its write end.
+  SharedFD Register(const std::string& name) {
+    SharedFD read_end, write_end;
+    SharedFD::Pipe(&read_end, &write_end);
+    auto client =
+        SharedFD::SocketLocalClient(socket_path_, false, SOCK_SEQPACKET);
+    auto control = ControlMessage::FromFileDescriptors({read_end});
+    UnixSocketMessage message{.data = {name.begin(), name.end()}};
+    message.control.emplace_back(std::move(*control));
+    auto result = UnixMessageSocket(client).WriteMessage(message);
+    EXPECT_TRUE(result.ok()) << result.error().Trace();
+    return write_end;
+  }
+
+  // Runs a collector in a child process, which writes the text of every batch
+  // it flushes to |flushed|. Returns its pid.
+  pid_t StartProcess(SharedFD flushed) {
+    pid_t pid = fork();
+    if (pid != 0) {
+      return pid;
+    }
+    auto log = BinaryLogWriter::Open(log_path_);
+    if (!log.ok()) {
+      _exit(1);
+    }
+    auto text_log = [flushed](android::base::LogSeverity, const std::string&,
+                              const std::string& message) {
+      WriteAll(flushed, message + "\n");
+    };
+    auto collector = LogCollector::Create(
+        server_, std::move(*log), text_log,
+        {.flush_interval = std::chrono::milliseconds(10)});
+    // Only stopped by being killed.
+    _exit(collector.ok() && collector->Run(SharedFD::Event()).ok() ? 0 : 1);
+  }
+
+  std::vector<LogRecord> ReadLog(const LogFilter& filter = {}) {
+    auto reader = BinaryLogReader::Open(log_path_);
+    EXPECT_TRUE(reader.ok()) << reader.error().Trace();
+    auto records = reader->Read(filter);
+    EXPECT_TRUE(records.ok()) << records.error().Trace();
+    return records.ok() ? *records : std::vector<LogRecord>{};
+  }
+
+  std::vector<TextLine> Text() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return text_;
+  }
+
+  TemporaryDir dir_;
+  std::string socket_path_;
+  std::string log_path_;
+  SharedFD server_;
+  SharedFD stop_;
+  std::thread thread_;
+  Result<void> result_;
+  std::mutex mutex_;
+  std::vector<TextLine> text_;
+};
+
+TEST(GuessSeverityTest, ReadsBracketedLevel) {
+  EXPECT_EQ(GuessSeverity("[2023-01-01T00:00:00Z ERROR crosvm] failed"),
+            android::base::ERROR);
+  EXPECT_EQ(GuessSeverity("[2023-01-01T00:00:00Z WARN devices] slow"),
+            android::base::WARNING);
+  EXPECT_EQ(GuessSeverity("[WARNING] slow"), android::base::WARNING);
+  EXPECT_EQ(GuessSeverity("[INFO] started"), android::base::DEBUG);
+  EXPECT_EQ(GuessSeverity("[VERBOSE] details"), android::base::VERBOSE);
+  EXPECT_EQ(GuessSeverity("ERROR outside brackets"), android::base::DEBUG);
+  EXPECT_EQ(GuessSeverity("[no level] ERROR"), android::base::DEBUG);
+}
+
+TEST_F(LogCollectorTest, CollectsLinesFromAllSources) {
+  Start();
+  auto crosvm = Register("crosvm");
+  auto wmediumd = Register("wmediumd");
+
+  WriteAll(crosvm, "booting\n");
+  WriteAll(wmediumd, "[ERROR] no radio\n");
+  WriteAll(crosvm, "booted\n");
+  Stop();
+
+  ASSERT_TRUE(result_.ok()) << result_.error().Trace();
+  auto crosvm_records = ReadLog(LogFilter{.sources = {"crosvm"}});
+  ASSERT_EQ(crosvm_records.size(), 2);
+  EXPECT_EQ(crosvm_records[0].message, "booting");
+  EXPECT_EQ(crosvm_records[1].message, "booted");
+  auto wmediumd_records = ReadLog(LogFilter{.sources = {"wmediumd"}});
+  ASSERT_EQ(wmediumd_records.size(), 1);
+  EXPECT_EQ(wmediumd_records[0].message, "[ERROR] no radio");
+  EXPECT_EQ(wmediumd_records[0].severity, android::base::ERROR);
+  // Lines may be grouped, but each is in the launcher log once.
+  std::string text;
+  for (const auto& line : Text()) {
+    text += line.message + "\n";
+  }
+  EXPECT_EQ(std::count(text.begin(), text.end(), '\n'), 3);
+}
+
+TEST_F(LogCollectorTest, JoinsLinesSplitAcrossReads) {
+  Start();
+  auto crosvm = Register("crosvm");
+
+  WriteAll(crosvm, "hel");
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  WriteAll(crosvm, "lo\nwor");
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  WriteAll(crosvm, "ld\r\nunfinished");
+  Stop();
+
+  ASSERT_TRUE(result_.ok()) << result_.error().Trace();
+  auto records = ReadLog();
+  ASSERT_EQ(records.size(), 3);
+  EXPECT_EQ(records[0].message, "hello");
+  EXPECT_EQ(records[1].message, "world");
+  EXPECT_EQ(records[2].message, "unfinished");
+}
+
+TEST_F(LogCollectorTest, DrainsEverythingOnStop) {
+  // Registered and written before the collector even runs, as happens when
+  // a process exits immediately.
+  auto crosvm = Register("crosvm");
+  auto openwrt = Register("openwrt");
+  WriteAll(crosvm, "one\ntwo\n");
+  WriteAll(openwrt, "three\n");
+  stop_->EventfdWrite(1);
+
+  Start();
+  thread_.join();
+
+  ASSERT_TRUE(result_.ok()) << result_.error().Trace();
+  EXPECT_EQ(ReadLog().size(), 3);
+}
+
+TEST_F(LogCollectorTest, ReadsSourcesUntilTheyClose) {
+  Start();
+  auto crosvm = Register("crosvm");
+  WriteAll(crosvm, "last words");
+  crosvm->Close();
+
+  for (int i = 0; i < 500 && Text().empty(); i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  Stop();
+
+  ASSERT_TRUE(result_.ok()) << result_.error().Trace();
+  EXPECT_EQ(Text(), (std::vector<TextLine>{
+                        {android::base::DEBUG, "crosvm", "last words"}}));
+}
+
+TEST_F(LogCollectorTest, FlushesPeriodically) {
+  Start(LogCollector::Options{.flush_interval = std::chrono::milliseconds(10)});
+  auto crosvm = Register("crosvm");
+
+  WriteAll(crosvm, "early\n");
+  for (int i = 0; i < 500 && Text().empty(); i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  EXPECT_EQ(Text().size(), 1);
+  EXPECT_EQ(ReadLog().size(), 1);
+}
+
+TEST_F(LogCollectorTest, GroupsTextLinesBySourceAndSeverity) {
+  auto crosvm = Register("crosvm");
+  WriteAll(crosvm, "[ERROR] a\n[ERROR] b\nc\n");
+  stop_->EventfdWrite(1);
+  Start();
+  thread_.join();
+
+  ASSERT_TRUE(result_.ok()) << result_.error().Trace();
+  std::vector<TextLine> expected{
+      {android::base::ERROR, "crosvm", "[ERROR] a\n[ERROR] b"},
+      {android::base::DEBUG, "crosvm", "c"},
+  };
+  EXPECT_EQ(Text(), expected);
+}
+
+TEST_F(LogCollectorTest, IgnoresBadRegistrations) {
+  Start();
+  auto client =
+      SharedFD::SocketLocalClient(socket_path_, false, SOCK_SEQPACKET);
+  WriteAll(client, "no file descriptor");
+  auto crosvm = Register("crosvm");
+  WriteAll(crosvm, "still works\n");
+  Stop();
+
+  ASSERT_TRUE(result_.ok()) << result_.error().Trace();
+  auto records = ReadLog();
+  ASSERT_EQ(records.size(), 1);
+  EXPECT_EQ(records[0].source, "crosvm");
+}
+
+TEST_F(LogCollectorTest, KeepsSourcesAcrossRestarts) {
+  SharedFD read_end, crosvm;
+  ASSERT_TRUE(SharedFD::Pipe(&read_end, &crosvm));
+  // As run_cvd does, the registry keeps the read end for the next collectors.
+  RegisterLogSource("crosvm", read_end);
+  SharedFD flushed_read, flushed_write;
+  ASSERT_TRUE(SharedFD::Pipe(&flushed_read, &flushed_write));
+
+  pid_t crashing = StartProcess(flushed_write);
+  ASSERT_GT(crashing, 0);
+  auto sent = SendLogSourcesToCollector(socket_path_);
+  ASSERT_TRUE(sent.ok()) << sent.error().Trace();
+  WriteAll(crosvm, "before the crash\n");
+  std::string flushed(sizeof("before the crash\n") - 1, '\0');
+  ASSERT_EQ(ReadExact(flushed_read, &flushed), flushed.size());
+  ASSERT_EQ(kill(crashing, SIGKILL), 0);
+  ASSERT_EQ(waitpid(crashing, nullptr, 0), crashing);
+
+  WriteAll(crosvm, "while restarting\n");
+  Start();
+  sent = SendLogSourcesToCollector(socket_path_);
+  ASSERT_TRUE(sent.ok()) << sent.error().Trace();
+  WriteAll(crosvm, "after the restart\n");
+  crosvm->Close();
+  Stop();
+
+  ASSERT_TRUE(result_.ok()) << result_.error().Trace();
+  auto records = ReadLog();
+  std::vector<std::string> messages;
+  for (const auto& record : records) {
+    EXPECT_EQ(record.source, "crosvm");
+    messages.push_back(record.message);
+  }
+  EXPECT_EQ(messages,
+            (std::vector<std::string>{"before the crash", "while restarting",
+                                      "after the restart"}));
+}
+
+}  // namespace
+}  // namespace cuttlefish
@@ -0,0 +1,99 @@
+//
+// Copyright (C) 2023 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <signal.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <string>
+
+#include <android-base/logging.h>
+#include <gflags/gflags.h>
+
+#include "common/libs/fs/shared_fd.h"
+#include "common/libs/utils/tee_logging.h"
+#include "host/commands/log_collector/binary_log.h"
+#include "host/commands/log_collector/log_collector.h"
+#include "host/libs/config/cuttlefish_config.h"
+
+DEFINE_int32(server_fd, -1,
+             "A listening SOCK_SEQPACKET socket processes register their "
+             "output with.");
+DEFINE_uint32(batch_lines, 1024,
+              "Maximum number of lines written to the logs at once.");
+DEFINE_uint32(flush_interval_ms, 100,
+              "Maximum time received lines are buffered before being "
+              "written.");
+
+int main(int argc, char** argv) {
+  ::android::base::InitLogging(argv, android::base::StderrLogger);
+  google::ParseCommandLineFlags(&argc, &argv, /* remove_flags */ true);
+
+  CHECK(FLAGS_server_fd >= 0) << "-server_fd is required";
+
+  auto config = cuttlefish::CuttlefishConfig::Get();
+
+  CHECK(config) << "Could not open cuttlefish config";
+
+  auto instance = config->ForDefaultInstance();
+
+  auto logger =
+      instance.run_as_daemon()
+          ? cuttlefish::LogToFiles({instance.launcher_log_path()})
+          : cuttlefish::LogToStderrAndFiles({instance.launcher_log_path()});
+  android::base::SetLogger(logger);
+
+  auto server = cuttlefish::SharedFD::Dup(FLAGS_server_fd);
+  CHECK(server->IsOpen()) << "Failed to dup server_fd: " << server->StrError();
+  close(FLAGS_server_fd);
+
+  // mask SIGINT and handle it using signalfd
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGINT);
+  CHECK(sigprocmask(SIG_BLOCK, &mask, NULL) == 0)
+      << "sigprocmask failed: " << strerror(errno);
+  int sfd = signalfd(-1, &mask, 0);
+  CHECK(sfd >= 0) << "signalfd failed: " << strerror(errno);
+  auto int_fd = cuttlefish::SharedFD::Dup(sfd);
+  close(sfd);
+
+  auto log =
+      cuttlefish::BinaryLogWriter::Open(instance.launcher_binary_log_path());
+  CHECK(log.ok()) << log.error().Trace();
+
+  // Every line goes to the launcher log as if the process had logged it
+  // itself, tagged with its name.
+  auto text_log = [&logger](android::base::LogSeverity severity,
+                            const std::string& source,
+                            const std::string& message) {
+    logger(android::base::DEFAULT, severity, source.c_str(), nullptr, 0,
+           message.c_str());
+  };
+
+  cuttlefish::LogCollector::Options options;
+  options.max_batch_lines = FLAGS_batch_lines;
+  options.flush_interval = std::chrono::milliseconds(FLAGS_flush_interval_ms);
+  auto collector = cuttlefish::LogCollector::Create(server, std::move(*log),
+                                                    text_log, options);
+  CHECK(collector.ok()) << collector.error().Trace();
+
+  auto result = collector->Run(int_fd);
+  CHECK(result.ok()) << result.error().Trace();
+
+  LOG(DEBUG) << "Finished collecting logs";
+}
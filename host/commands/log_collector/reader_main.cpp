@@ -0,0 +1,122 @@
+//
+// Copyright (C) 2023 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <time.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <android-base/logging.h>
+#include <android-base/strings.h>
+#include <gflags/gflags.h>
+
+#include "common/libs/utils/result.h"
+#include "host/commands/log_collector/binary_log.h"
+#include "host/libs/config/cuttlefish_config.h"
+
+DEFINE_string(log_path, "",
+              "The binary log to read, the default instance's launcher "
+              "binary log if empty.");
+DEFINE_string(sources, "",
+              "Comma separated names of the processes to print the output "
+              "of, all of them if empty.");
+DEFINE_uint64(since_seconds, 0,
+              "Only print the output of the last this many seconds, all of it "
+              "if 0.");
+DEFINE_uint64(tail, 0,
+              "Only print this many of the last matching lines, all of them "
+              "if 0.");
+DEFINE_bool(list_sources, false,
+            "Print the names of the processes in the log instead.");
+
+namespace cuttlefish {
+namespace {
+
+constexpr char kSeverities[] = "VDIWEFF";
+
+std::string FormatTimestamp(uint64_t timestamp) {
+  time_t seconds = timestamp / 1000000000;
+  struct tm local;
+  localtime_r(&seconds, &local);
+  char date[32];
+  strftime(date, sizeof(date), "%m-%d %H:%M:%S", &local);
+  char micros[8];
+  snprintf(micros, sizeof(micros), ".%06llu",
+           static_cast<unsigned long long>(timestamp % 1000000000 / 1000));
+  return std::string(date) + micros;
+}
+
+Result<void> LogReaderMain(int argc, char** argv) {
+  ::android::base::InitLogging(argv, android::base::StderrLogger);
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  std::string log_path = FLAGS_log_path;
+  if (log_path.empty()) {
+    auto config = CuttlefishConfig::Get();
+    CF_EXPECT(config != nullptr, "Unable to find the config");
+    log_path = config->ForDefaultInstance().launcher_binary_log_path();
+  }
+  auto reader = CF_EXPECT(BinaryLogReader::Open(log_path));
+
+  if (FLAGS_list_sources) {
+    for (const auto& source : reader.Sources()) {
+      printf("%s\n", source.c_str());
+    }
+    return {};
+  }
+
+  LogFilter filter;
+  for (const auto& source : android::base::Split(FLAGS_sources, ",")) {
+    if (!source.empty()) {
+      filter.sources.insert(source);
+    }
+  }
+  if (FLAGS_since_seconds > 0) {
+    uint64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::system_clock::now().time_since_epoch())
+                       .count();
+    uint64_t since = FLAGS_since_seconds * 1000000000;
+    filter.since = now > since ? now - since : 0;
+  }
+  std::vector<LogRecord> records;
+  if (FLAGS_tail > 0) {
+    records = CF_EXPECT(reader.Tail(FLAGS_tail, filter));
+  } else {
+    records = CF_EXPECT(reader.Read(filter));
+  }
+
+  for (const auto& record : records) {
+    // Laid out like the launcher log, with the source as the tag.
+    char severity = record.severity <= android::base::FATAL
+                        ? kSeverities[record.severity]
+                        : '?';
+    printf("%s %c %s %s\n", record.source.c_str(), severity,
+           FormatTimestamp(record.timestamp).c_str(), record.message.c_str());
+  }
+  LOG(DEBUG) << "Read " << reader.blocks_read() << " blocks for "
+             << records.size() << " lines";
+  return {};
+}
+
+}  // namespace
+}  // namespace cuttlefish
+
+int main(int argc, char** argv) {
+  auto result = cuttlefish::LogReaderMain(argc, argv);
+  CHECK(result.ok()) << result.error().Message();
+  return 0;
+}
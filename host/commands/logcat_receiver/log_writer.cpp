@@ -0,0 +1,287 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "host/commands/logcat_receiver/log_writer.h"
+
+#include <fcntl.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <utility>
+
+#include <android-base/logging.h>
+
+#include "common/libs/fs/shared_buf.h"
+#include "common/libs/utils/files.h"
+
+namespace cuttlefish {
+namespace {
+
+constexpr size_t kCompressionChunkSize = 128 * 1024;
+
+Result<void> GzipFile(SharedFD in, const std::string& to) {
+  gzFile out = gzopen(to.c_str(), "wb");
+  CF_EXPECT(out != nullptr, "Failed to open \"" << to << "\"");
+  std::vector<char> chunk(kCompressionChunkSize);
+  while (true) {
+    auto read = in->Read(chunk.data(), chunk.size());
+    if (read < 0) {
+      gzclose(out);
+      return CF_ERR("Failed to read segment: " << in->StrError());
+    }
+    if (read == 0) {
+      break;
+    }
+    if (gzwrite(out, chunk.data(), read) != read) {
+      gzclose(out);
+      return CF_ERR("Failed to write \"" << to << "\"");
+    }
+  }
+  CF_EXPECT(gzclose(out) == Z_OK, "Failed to finish \"" << to << "\"");
+  return {};
+}
+
+}  // namespace
+
+Result<LogCompression> ParseLogCompression(const std::string& name) {
+  if (name == "none") {
+    return LogCompression::kNone;
+  } else if (name == "gzip") {
+    return LogCompression::kGzip;
+  }
+  return CF_ERR("Unknown log compression \"" << name
+                                             << "\", expected none or gzip");
+}
+
+Result<std::unique_ptr<RotatingLogWriter>> RotatingLogWriter::Create(
+    LogWriterOptions options) {
+  CF_EXPECT(!options.path.empty(), "Missing log file path");
+  CF_EXPECT(options.buffer_size > 0, "Log buffer size must be positive");
+  std::unique_ptr<RotatingLogWriter> writer(
+      new RotatingLogWriter(std::move(options)));
+  CF_EXPECT(writer->OpenActiveFile());
+  if (writer->options_.compression != LogCompression::kNone) {
+    writer->compression_thread_ =
+        std::thread(&RotatingLogWriter::CompressionLoop, writer.get());
+  }
+  return writer;
+}
+
+RotatingLogWriter::RotatingLogWriter(LogWriterOptions options)
+    : options_(std::move(options)) {
+  buffer_.reserve(options_.buffer_size);
+}
+
+RotatingLogWriter::~RotatingLogWriter() {
+  Flush();
+  {
+    std::lock_guard<std::mutex> lock(segments_mutex_);
+    stopping_ = true;
+  }
+  compression_queued_.notify_one();
+  // Segments still queued are compressed before returning.
+  if (compression_thread_.joinable()) {
+    compression_thread_.join();
+  }
+}
+
+Result<void> RotatingLogWriter::OpenActiveFile() {
+  file_ = SharedFD::Open(options_.path, O_CREAT | O_APPEND | O_WRONLY, 0666);
+  CF_EXPECT(file_->IsOpen(), "Failed to open \"" << options_.path
+                                                 << "\": " << file_->StrError());
+  auto size = FileSize(options_.path);
+  file_size_ = size > 0 ? size : 0;
+  file_opened_at_ = std::chrono::steady_clock::now();
+  return {};
+}
+
+void RotatingLogWriter::Append(const char* data, size_t size) {
+  stats_.bytes_received += size;
+  while (size > 0) {
+    auto chunk = std::min(size, options_.buffer_size - buffer_.size());
+    buffer_.insert(buffer_.end(), data, data + chunk);
+    data += chunk;
+    size -= chunk;
+    if (buffer_.size() == options_.buffer_size) {
+      WriteBuffer();
+      MaybeRotate();
+    }
+  }
+}
+
+void RotatingLogWriter::Flush() {
+  WriteBuffer();
+  MaybeRotate();
+}
+
+void RotatingLogWriter::WriteBuffer() {
+  if (buffer_.empty()) {
+    return;
+  }
+  if (!file_->IsOpen()) {
+    // A previous rotation failed to reopen the file, try again.
+    auto res = OpenActiveFile();
+    if (!res.ok()) {
+      LOG(DEBUG) << res.error().Trace();
+    }
+  }
+  stats_.write_calls++;
+  auto written = WriteAll(file_, buffer_);
+  if (written == static_cast<ssize_t>(buffer_.size())) {
+    stats_.bytes_written += written;
+    file_size_ += written;
+    if (stats_.dropping) {
+      LOG(INFO) << "Writes to " << options_.path << " resumed, "
+                << stats_.bytes_dropped << " bytes dropped so far";
+      stats_.dropping = false;
+    }
+  } else {
+    // Some of the data may have made it to disk, but there is no way of
+    // knowing how much, so count it all as dropped.
+    stats_.bytes_dropped += buffer_.size();
+    if (!stats_.dropping) {
+      LOG(ERROR) << "Error writing to " << options_.path << ": "
+                 << file_->StrError() << ". Dropping logs until writes succeed.";
+      stats_.dropping = true;
+    }
+  }
+  buffer_.clear();
+}
+
+void RotatingLogWriter::MaybeRotate() {
+  if (options_.max_rotated_files == 0) {
+    return;
+  }
+  bool size_exceeded =
+      options_.rotate_size > 0 && file_size_ >= options_.rotate_size;
+  bool age_exceeded =
+      options_.rotate_interval.count() > 0 &&
+      std::chrono::steady_clock::now() - file_opened_at_ >=
+          options_.rotate_interval;
+  if (!size_exceeded && !age_exceeded) {
+    return;
+  }
+  if (file_size_ == 0) {
+    // Nothing to rotate, just restart the clock.
+    file_opened_at_ = std::chrono::steady_clock::now();
+    return;
+  }
+  auto res = Rotate();
+  if (!res.ok()) {
+    LOG(ERROR) << "Failed to rotate " << options_.path << ": "
+               << res.error().Message();
+    LOG(DEBUG) << res.error().Trace();
+    // Avoid retrying on every write, wait for another full period.
+    file_opened_at_ = std::chrono::steady_clock::now();
+    file_size_ = 0;
+  }
+}
+
+std::string RotatingLogWriter::SegmentPath(size_t index,
+                                           bool compressed) const {
+  auto path = options_.path + "." + std::to_string(index);
+  return compressed ? path + ".gz" : path;
+}
+
+Result<void> RotatingLogWriter::Rotate() {
+  {
+    // Only renames happen under the lock, compression runs outside of it.
+    std::lock_guard<std::mutex> lock(segments_mutex_);
+    for (size_t index = options_.max_rotated_files; index > 0; index--) {
+      for (bool compressed : {false, true}) {
+        auto segment = SegmentPath(index, compressed);
+        if (!FileExists(segment)) {
+          continue;
+        }
+        if (index == options_.max_rotated_files) {
+          CF_EXPECT(RemoveFile(segment),
+                    "Failed to remove \"" << segment << "\"");
+        } else {
+          CF_EXPECT(RenameFile(segment, SegmentPath(index + 1, compressed)));
+        }
+      }
+    }
+    CF_EXPECT(RenameFile(options_.path, SegmentPath(1, false)));
+    stats_.rotations++;
+    if (options_.compression != LogCompression::kNone) {
+      compression_queue_.push_back(stats_.rotations);
+    }
+  }
+  compression_queued_.notify_one();
+  file_->Close();
+  CF_EXPECT(OpenActiveFile());
+  return {};
+}
+
+void RotatingLogWriter::CompressionLoop() {
+  std::unique_lock<std::mutex> lock(segments_mutex_);
+  while (true) {
+    compression_queued_.wait(lock, [this]() {
+      return stopping_ || !compression_queue_.empty();
+    });
+    if (compression_queue_.empty()) {
+      return;
+    }
+    auto rotation = compression_queue_.front();
+    compression_queue_.pop_front();
+    lock.unlock();
+    CompressSegment(rotation);
+    lock.lock();
+  }
+}
+
+// Replaces the uncompressed segment with a compressed copy. On failure the
+// uncompressed segment is kept so no data is lost.
+void RotatingLogWriter::CompressSegment(uint64_t rotation) {
+  auto tmp_path = options_.path + ".gz.tmp";
+  SharedFD in;
+  {
+    std::lock_guard<std::mutex> lock(segments_mutex_);
+    auto index = stats_.rotations - rotation + 1;
+    if (index > options_.max_rotated_files) {
+      return;
+    }
+    // Once open, the segment can be renamed or removed by later rotations
+    // while it's being read.
+    in = SharedFD::Open(SegmentPath(index, false), O_RDONLY);
+  }
+  if (!in->IsOpen()) {
+    LOG(ERROR) << "Failed to open rotated segment: " << in->StrError();
+    return;
+  }
+  auto res = GzipFile(in, tmp_path);
+  std::lock_guard<std::mutex> lock(segments_mutex_);
+  auto index = stats_.rotations - rotation + 1;
+  if (!res.ok() || index > options_.max_rotated_files) {
+    if (!res.ok()) {
+      LOG(ERROR) << "Failed to compress rotated segment: "
+                 << res.error().Message();
+      LOG(DEBUG) << res.error().Trace();
+    }
+    RemoveFile(tmp_path);
+    return;
+  }
+  auto renamed = RenameFile(tmp_path, SegmentPath(index, true));
+  if (!renamed.ok()) {
+    LOG(ERROR) << "Failed to rename " << tmp_path << ": "
+               << renamed.error().Message();
+    RemoveFile(tmp_path);
+    return;
+  }
+  RemoveFile(SegmentPath(index, false));
+}
+
+}  // namespace cuttlefish
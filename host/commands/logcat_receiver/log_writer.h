@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/libs/fs/shared_fd.h"
+#include "common/libs/utils/result.h"
+
+namespace cuttlefish {
+
+enum class LogCompression {
+  kNone,
+  kGzip,
+};
+
+Result<LogCompression> ParseLogCompression(const std::string& name);
+
+struct LogWriterOptions {
+  std::string path;
+  // Rotate once the active file reaches this size. 0 disables size based
+  // rotation.
+  size_t rotate_size = 0;
+  // Rotate once the active file has been open for this long. 0 disables time
+  // based rotation.
+  std::chrono::seconds rotate_interval{0};
+  // Number of rotated segments kept next to the active file. Rotation is
+  // disabled when this is 0.
+  size_t max_rotated_files = 0;
+  LogCompression compression = LogCompression::kNone;
+  // Data is buffered until this many bytes are pending or until Flush() is
+  // called.
+  size_t buffer_size = 256 * 1024;
+};
+
+struct LogWriterStats {
+  uint64_t bytes_received = 0;
+  uint64_t bytes_written = 0;
+  uint64_t bytes_dropped = 0;
+  uint64_t write_calls = 0;
+  uint64_t rotations = 0;
+  // True while the output can't be written to. Incoming data is discarded
+  // until a write succeeds again.
+  bool dropping = false;
+};
+
+/**
+ * Appends data to a log file through a coalescing buffer, rotating the file by
+ * size or age. Rotated segments are named <path>.1 (newest) to <path>.N
+ * (oldest) and, when requested, compressed on a background thread so the
+ * caller never blocks on compression. Segments rotated while an earlier one
+ * is still being compressed are queued behind it.
+ *
+ * Write failures never abort the process: the pending data is dropped and
+ * counted instead, so a full disk doesn't take the log source down with it.
+ */
+class RotatingLogWriter {
+ public:
+  static Result<std::unique_ptr<RotatingLogWriter>> Create(
+      LogWriterOptions options);
+  ~RotatingLogWriter();
+
+  // Buffers the data, writing it out once the buffer fills up.
+  void Append(const char* data, size_t size);
+  // Writes out all buffered data and rotates the file if it's due.
+  void Flush();
+
+  bool HasBufferedData() const { return !buffer_.empty(); }
+  const LogWriterStats& stats() const { return stats_; }
+
+ private:
+  RotatingLogWriter(LogWriterOptions options);
+
+  Result<void> OpenActiveFile();
+  void WriteBuffer();
+  void MaybeRotate();
+  Result<void> Rotate();
+  std::string SegmentPath(size_t index, bool compressed) const;
+  void CompressionLoop();
+  void CompressSegment(uint64_t rotation);
+
+  LogWriterOptions options_;
+  SharedFD file_;
+  size_t file_size_ = 0;
+  std::chrono::steady_clock::time_point file_opened_at_;
+  std::vector<char> buffer_;
+  LogWriterStats stats_;
+
+  // Guards the rotated segments, whose names change with each rotation, and
+  // the compression queue.
+  std::mutex segments_mutex_;
+  std::condition_variable compression_queued_;
+  // Segments waiting for compression, identified by the value of
+  // stats_.rotations right after they were rotated. The segment of rotation
+  // R is at index stats_.rotations - R + 1.
+  std::deque<uint64_t> compression_queue_;
+  bool stopping_ = false;
+  std::thread compression_thread_;
+};
+
+}  // namespace cuttlefish
@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "host/commands/logcat_receiver/log_writer.h"
+
+#include <stdlib.h>
+#include <zlib.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "common/libs/utils/files.h"
+
+namespace cuttlefish {
+namespace {
+
+class RotatingLogWriterTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    char dir_template[] = "/tmp/log_writer_test.XXXXXX";
+    ASSERT_NE(mkdtemp(dir_template), nullptr);
+    dir_ = dir_template;
+    path_ = dir_ + "/logcat";
+  }
+
+  void TearDown() override { RecursivelyRemoveDirectory(dir_); }
+
+  std::string dir_;
+  std::string path_;
+};
+
+std::string ReadGzipFile(const std::string& path) {
+  gzFile file = gzopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    return "";
+  }
+  std::string contents;
+  char chunk[4096];
+  int read;
+  while ((read = gzread(file, chunk, sizeof(chunk))) > 0) {
+    contents.append(chunk, read);
+  }
+  gzclose(file);
+  return contents;
+}
+
+TEST_F(RotatingLogWriterTest, CoalescesWrites) {
+  LogWriterOptions options;
+  options.path = path_;
+  options.buffer_size = 16;
+  auto writer = RotatingLogWriter::Create(options);
+  ASSERT_TRUE(writer.ok()) << writer.error().Trace();
+
+  for (int i = 0; i < 10; i++) {
+    (*writer)->Append("abcd", 4);
+  }
+  EXPECT_EQ((*writer)->stats().write_calls, 2);
+  EXPECT_TRUE((*writer)->HasBufferedData());
+  (*writer)->Flush();
+  EXPECT_EQ((*writer)->stats().write_calls, 3);
+  EXPECT_EQ((*writer)->stats().bytes_written, 40);
+  EXPECT_EQ(ReadFile(path_).size(), 40);
+}
+
+TEST_F(RotatingLogWriterTest, RotatesBySize) {
+  LogWriterOptions options;
+  options.path = path_;
+  options.buffer_size = 4;
+  options.rotate_size = 8;
+  options.max_rotated_files = 2;
+  auto writer = RotatingLogWriter::Create(options);
+  ASSERT_TRUE(writer.ok()) << writer.error().Trace();
+
+  for (const char* line : {"aaaa", "bbbb", "cccc", "dddd", "eeee", "ffff",
+                           "gggg"}) {
+    (*writer)->Append(line, 4);
+  }
+  (*writer)->Flush();
+
+  EXPECT_EQ((*writer)->stats().rotations, 3);
+  EXPECT_EQ(ReadFile(path_), "gggg");
+  EXPECT_EQ(ReadFile(path_ + ".1"), "eeeeffff");
+  EXPECT_EQ(ReadFile(path_ + ".2"), "ccccdddd");
+  EXPECT_FALSE(FileExists(path_ + ".3"));
+}
+
+TEST_F(RotatingLogWriterTest, CompressesRotatedSegments) {
+  LogWriterOptions options;
+  options.path = path_;
+  options.buffer_size = 4;
+  options.rotate_size = 8;
+  options.max_rotated_files = 2;
+  options.compression = LogCompression::kGzip;
+  {
+    auto writer = RotatingLogWriter::Create(options);
+    ASSERT_TRUE(writer.ok()) << writer.error().Trace();
+    for (const char* line : {"aaaa", "bbbb", "cccc", "dddd", "eeee"}) {
+      (*writer)->Append(line, 4);
+    }
+  }
+
+  EXPECT_EQ(ReadFile(path_), "eeee");
+  EXPECT_EQ(ReadGzipFile(path_ + ".1.gz"), "ccccdddd");
+  EXPECT_EQ(ReadGzipFile(path_ + ".2.gz"), "aaaabbbb");
+  EXPECT_FALSE(FileExists(path_ + ".1"));
+  EXPECT_FALSE(FileExists(path_ + ".2"));
+}
+
+TEST_F(RotatingLogWriterTest, QueuesCompressionOfQuickRotations) {
+  LogWriterOptions options;
+  options.path = path_;
+  options.buffer_size = 64 * 1024;
+  options.rotate_size = 1024 * 1024;
+  options.max_rotated_files = 2;
+  options.compression = LogCompression::kGzip;
+  // Poorly compressible segments, so rotations happen while earlier ones are
+  // still being compressed.
+  std::vector<std::string> segments;
+  uint32_t state = 1;
+  for (int i = 0; i < 4; i++) {
+    std::string segment(options.rotate_size, '\0');
+    for (auto& c : segment) {
+      state = state * 1103515245 + 12345;
+      c = static_cast<char>(state >> 24);
+    }
+    segments.push_back(std::move(segment));
+  }
+  {
+    auto writer = RotatingLogWriter::Create(options);
+    ASSERT_TRUE(writer.ok()) << writer.error().Trace();
+    for (const auto& segment : segments) {
+      (*writer)->Append(segment.data(), segment.size());
+    }
+    (*writer)->Append("tail", 4);
+    EXPECT_EQ((*writer)->stats().rotations, segments.size());
+  }
+
+  EXPECT_EQ(ReadFile(path_), "tail");
+  EXPECT_EQ(ReadGzipFile(path_ + ".1.gz"), segments[3]);
+  EXPECT_EQ(ReadGzipFile(path_ + ".2.gz"), segments[2]);
+  EXPECT_FALSE(FileExists(path_ + ".1"));
+  EXPECT_FALSE(FileExists(path_ + ".2"));
+  EXPECT_FALSE(FileExists(path_ + ".3.gz"));
+  EXPECT_FALSE(FileExists(path_ + ".gz.tmp"));
+}
+
+TEST_F(RotatingLogWriterTest, DropsDataOnWriteErrors) {
+  LogWriterOptions options;
+  options.path = "/dev/full";
+  options.buffer_size = 4;
+  auto writer = RotatingLogWriter::Create(options);
+  ASSERT_TRUE(writer.ok()) << writer.error().Trace();
+
+  (*writer)->Append("aaaabbbb", 8);
+
+  EXPECT_EQ((*writer)->stats().bytes_dropped, 8);
+  EXPECT_EQ((*writer)->stats().bytes_written, 0);
+  EXPECT_TRUE((*writer)->stats().dropping);
+}
+
+TEST(ParseLogCompressionTest, ParsesNames) {
+  EXPECT_EQ(*ParseLogCompression("none"), LogCompression::kNone);
+  EXPECT_EQ(*ParseLogCompression("gzip"), LogCompression::kGzip);
+  EXPECT_FALSE(ParseLogCompression("zstd").ok());
+}
+
+}  // namespace
+}  // namespace cuttlefish
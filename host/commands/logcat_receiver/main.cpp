@@ -14,13 +14,20 @@
  * limitations under the License.
  */
 
+#include <errno.h>
+#include <poll.h>
 #include <signal.h>
 
+#include <algorithm>
+#include <cstring>
+#include <chrono>
+#include <vector>
+
 #include <gflags/gflags.h>
 #include <android-base/logging.h>
 
-#include "common/libs/fs/shared_buf.h"
 #include "common/libs/fs/shared_fd.h"
+#include "host/commands/logcat_receiver/log_writer.h"
 #include "host/libs/config/cuttlefish_config.h"
 #include "host/libs/config/logging.h"
 
@@ -28,6 +35,37 @@ DEFINE_int32(log_pipe_fd, -1,
              "A file descriptor representing a (UNIX) socket from which to "
              "read the logs. If -1 is given the socket is created according to "
              "the instance configuration");
+DEFINE_uint32(rotate_size_mb, 256,
+              "Rotate the logcat file once it reaches this size. 0 disables "
+              "size based rotation.");
+DEFINE_uint32(rotate_interval_s, 0,
+              "Rotate the logcat file after this many seconds. 0 disables "
+              "time based rotation.");
+DEFINE_uint32(rotated_files, 4,
+              "How many rotated logcat files to keep. 0 disables rotation.");
+DEFINE_string(compression, "gzip",
+              "How to compress rotated logcat files: none or gzip.");
+DEFINE_uint32(flush_interval_ms, 500,
+              "Maximum time received logs are buffered before being written.");
+DEFINE_uint32(stats_interval_s, 60,
+              "How often to log throughput statistics. 0 disables them.");
+
+namespace {
+
+// Large reads let the receiver drain a backed up pipe with few syscalls.
+constexpr size_t kReadSize = 64 * 1024;
+
+using Clock = std::chrono::steady_clock;
+
+int MillisUntil(Clock::time_point deadline) {
+  auto now = Clock::now();
+  if (deadline <= now) {
+    return 0;
+  }
+  return std::chrono::ceil<std::chrono::milliseconds>(deadline - now).count();
+}
+
+}  // namespace
 
 int main(int argc, char** argv) {
   cuttlefish::DefaultSubprocessLogging(argv);
@@ -59,25 +97,86 @@ int main(int argc, char** argv) {
     return 2;
   }
 
-  auto path = instance.logcat_path();
-  auto logcat_file =
-      cuttlefish::SharedFD::Open(path.c_str(), O_CREAT | O_APPEND | O_WRONLY, 0666);
+  auto compression = cuttlefish::ParseLogCompression(FLAGS_compression);
+  CHECK(compression.ok()) << compression.error().Message();
+
+  cuttlefish::LogWriterOptions options;
+  options.path = instance.logcat_path();
+  options.rotate_size = static_cast<size_t>(FLAGS_rotate_size_mb) << 20;
+  options.rotate_interval = std::chrono::seconds(FLAGS_rotate_interval_s);
+  options.max_rotated_files = FLAGS_rotated_files;
+  options.compression = *compression;
+  auto writer = cuttlefish::RotatingLogWriter::Create(std::move(options));
+  CHECK(writer.ok()) << writer.error().Message();
+
+  const auto flush_interval =
+      std::chrono::milliseconds(FLAGS_flush_interval_ms);
+  const auto stats_interval = std::chrono::seconds(FLAGS_stats_interval_s);
+
+  // Reads that fill the whole buffer mean the pipe had more data queued than
+  // we could take at once, i.e. the receiver is falling behind the guest.
+  uint64_t full_reads = 0;
+  uint64_t last_full_reads = 0;
+  uint64_t last_received = 0;
+  auto last_stats = Clock::now();
+  auto flush_deadline = Clock::time_point::max();
 
   // Server loop
+  std::vector<char> buff(kReadSize);
   while (true) {
-    char buff[1024];
-    auto read = pipe->Read(buff, sizeof(buff));
-    if (read < 0) {
-      LOG(ERROR) << "Could not read logcat: " << pipe->StrError();
+    auto deadline = flush_deadline;
+    if (stats_interval.count() > 0) {
+      deadline = std::min(deadline, last_stats + stats_interval);
+    }
+    int timeout = deadline == Clock::time_point::max() ? -1
+                                                       : MillisUntil(deadline);
+    cuttlefish::PollSharedFd poll_fd{.fd = pipe, .events = POLLIN};
+    auto ready = cuttlefish::SharedFD::Poll(&poll_fd, 1, timeout);
+    if (ready < 0 && errno != EINTR) {
+      LOG(ERROR) << "Could not poll logcat pipe: " << strerror(errno);
       break;
     }
-    auto written = cuttlefish::WriteAll(logcat_file, buff, read);
-    CHECK(written == read)
-        << "Error writing to log file: " << logcat_file->StrError()
-        << ". This is unrecoverable.";
+    if (ready > 0) {
+      auto read = pipe->Read(buff.data(), buff.size());
+      if (read < 0) {
+        LOG(ERROR) << "Could not read logcat: " << pipe->StrError();
+        break;
+      }
+      if (read == static_cast<ssize_t>(buff.size())) {
+        full_reads++;
+      }
+      if (read > 0) {
+        (*writer)->Append(buff.data(), read);
+        if (flush_deadline == Clock::time_point::max()) {
+          flush_deadline = Clock::now() + flush_interval;
+        }
+      }
+    }
+
+    auto now = Clock::now();
+    if (now >= flush_deadline || !(*writer)->HasBufferedData()) {
+      (*writer)->Flush();
+      flush_deadline = Clock::time_point::max();
+    }
+    if (stats_interval.count() > 0 && now >= last_stats + stats_interval) {
+      const auto& stats = (*writer)->stats();
+      auto seconds =
+          std::chrono::duration<double>(now - last_stats).count();
+      LOG(DEBUG) << "logcat: "
+                 << (stats.bytes_received - last_received) / seconds / 1024
+                 << " KiB/s, " << (full_reads - last_full_reads)
+                 << " backlogged reads, " << stats.bytes_written
+                 << " bytes written in " << stats.write_calls << " writes, "
+                 << stats.bytes_dropped << " bytes dropped"
+                 << (stats.dropping ? " (dropping)" : "") << ", "
+                 << stats.rotations << " rotations";
+      last_received = stats.bytes_received;
+      last_full_reads = full_reads;
+      last_stats = now;
+    }
   }
 
-  logcat_file->Close();
+  writer->reset();
   pipe->Close();
   return 0;
 }
@@ -0,0 +1,79 @@
+//
+// Copyright (C) 2023 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "host/commands/modem_simulator/command_index.h"
+
+namespace cuttlefish {
+
+void CommandIndex::Add(const CommandHandler& handler) {
+  uint32_t node = 0;
+  for (char label : handler.Prefix()) {
+    auto pos = nodes_[node].labels.find(label);
+    if (pos != std::string::npos) {
+      node = nodes_[node].children[pos];
+      continue;
+    }
+    uint32_t child = nodes_.size();
+    nodes_.emplace_back();
+    nodes_[node].labels.push_back(label);
+    nodes_[node].children.push_back(child);
+    node = child;
+  }
+
+  auto& slot = handler.IsPartialMatch() ? nodes_[node].partial_match
+                                        : nodes_[node].full_match;
+  if (slot == kNoHandler) {
+    // A handler added earlier for the same command would always be chosen.
+    slot = handlers_.size();
+  }
+  handlers_.push_back(&handler);
+}
+
+const CommandIndex::Node* CommandIndex::Child(const Node& node,
+                                              char label) const {
+  auto pos = node.labels.find(label);
+  return pos == std::string::npos ? nullptr : &nodes_[node.children[pos]];
+}
+
+const CommandHandler* CommandIndex::Find(std::string_view command) const {
+  if (command.size() < 2) {
+    return nullptr;
+  }
+  command.remove_prefix(2);  // skip "AT"
+
+  // Handlers matching a prefix of the command, as well as one matching all
+  // of it, compete on the order they were added in.
+  int32_t best = kNoHandler;
+  auto consider = [&best](int32_t candidate) {
+    if (candidate != kNoHandler && (best == kNoHandler || candidate < best)) {
+      best = candidate;
+    }
+  };
+  const Node* node = &nodes_[0];
+  consider(node->partial_match);
+  for (char label : command) {
+    node = Child(*node, label);
+    if (node == nullptr) {
+      break;
+    }
+    consider(node->partial_match);
+  }
+  if (node != nullptr) {
+    consider(node->full_match);
+  }
+  return best == kNoHandler ? nullptr : handlers_[best];
+}
+
+}  // namespace cuttlefish
@@ -0,0 +1,66 @@
+//
+// Copyright (C) 2023 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "host/commands/modem_simulator/modem_service.h"
+
+namespace cuttlefish {
+
+/**
+ * Prefix trie over the commands of every registered CommandHandler, so a
+ * command is matched in a single walk over its characters instead of by
+ * comparing it with each handler in turn.
+ *
+ * When several handlers match, e.g. "D" and "D*99***1#", the one added first
+ * wins, which is the handler the walk over services and their handler lists
+ * used to pick.
+ */
+class CommandIndex {
+ public:
+  void Add(const CommandHandler& handler);
+
+  // The handler for `command`, which includes the leading "AT", or nullptr.
+  const CommandHandler* Find(std::string_view command) const;
+
+  // Every added handler, in the order they were added.
+  const std::vector<const CommandHandler*>& handlers() const {
+    return handlers_;
+  }
+
+ private:
+  static constexpr int32_t kNoHandler = -1;
+
+  struct Node {
+    // children[i] is reached by the character labels[i].
+    std::string labels;
+    std::vector<uint32_t> children;
+    // Indices into handlers_.
+    int32_t partial_match = kNoHandler;
+    int32_t full_match = kNoHandler;
+  };
+
+  const Node* Child(const Node& node, char label) const;
+
+  std::vector<Node> nodes_{1};
+  std::vector<const CommandHandler*> handlers_;
+};
+
+}  // namespace cuttlefish
@@ -50,6 +50,12 @@ class CommandHandler {
   int Compare(const std::string& command) const;
   void HandleCommand(const Client& client, std::string& command) const;
 
+  // The command without the leading "AT".
+  const std::string& Prefix() const { return command_prefix; }
+  // Whether any command starting with Prefix() matches, instead of only the
+  // exact command.
+  bool IsPartialMatch() const { return match_mode == PARTIAL_MATCH; }
+
  private:
   enum MatchMode {FULL_MATCH = 0, PARTIAL_MATCH = 1};
 
@@ -70,6 +76,10 @@ class ModemService {
 
   bool HandleModemCommand(const Client& client, std::string command);
 
+  const std::vector<CommandHandler>& command_handlers() const {
+    return command_handlers_;
+  }
+
   static const std::string kCmeErrorOperationNotAllowed;
   static const std::string kCmeErrorOperationNotSupported;
   static const std::string kCmeErrorSimNotInserted;
@@ -92,6 +92,12 @@ void ModemSimulator::RegisterModemService() {
   modem_services_[kSupService] = std::move(supservice);
   modem_services_[kStkService] = std::move(stkservice);
   modem_services_[kMiscService] = std::move(miscservice);
+
+  for (const auto& service : modem_services_) {
+    for (const auto& handler : service.second->command_handlers()) {
+      command_index_.Add(handler);
+    }
+  }
 }
 
 void ModemSimulator::DispatchCommand(const Client& client, std::string& command) {
@@ -105,15 +111,10 @@ void ModemSimulator::DispatchCommand(const Client& client, std::string& command)
     }
   }
 
-  bool success = false;
-  for (auto& service : modem_services_) {
-    success = service.second->HandleModemCommand(client, command);
-    if (success) {
-      break;
-    }
-  }
-
-  if (!success && client.type != Client::REMOTE) {
+  auto handler = command_index_.Find(command);
+  if (handler) {
+    handler->HandleCommand(client, command);
+  } else if (client.type != Client::REMOTE) {
     LOG(DEBUG) << "Not supported AT command: " << command;
     client.SendCommandResponse(ModemService::kCmeErrorOperationNotSupported);
   }
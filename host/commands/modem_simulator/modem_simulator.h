@@ -16,6 +16,7 @@
 #pragma once
 
 #include "host/commands/modem_simulator/channel_monitor.h"
+#include "host/commands/modem_simulator/command_index.h"
 #include "host/commands/modem_simulator/modem_service.h"
 #include "host/commands/modem_simulator/nvram_config.h"
 #include "host/commands/modem_simulator/thread_looper.h"
@@ -48,6 +49,9 @@ class ModemSimulator {
 
   void SetTimeZone(std::string timezone);
   bool SetPhoneNumber(std::string_view number);
+
+  const CommandIndex& command_index() const { return command_index_; }
+
  private:
   int32_t modem_id_;
   std::unique_ptr<ChannelMonitor> channel_monitor_;
@@ -59,6 +63,7 @@ class ModemSimulator {
   NetworkService* network_service_{nullptr};
 
   std::map<ModemServiceType, std::unique_ptr<ModemService>> modem_services_;
+  CommandIndex command_index_;
 
   static void LoadNvramConfig();
 
@@ -0,0 +1,223 @@
+//
+// Copyright (C) 2023 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <android-base/logging.h>
+#include <android-base/strings.h>
+#include <benchmark/benchmark.h>
+
+#include "host/commands/assemble_cvd/flags_defaults.h"
+#include "host/commands/modem_simulator/channel_monitor.h"
+#include "host/commands/modem_simulator/command_index.h"
+#include "host/commands/modem_simulator/device_config.h"
+#include "host/commands/modem_simulator/modem_simulator.h"
+#include "host/libs/config/cuttlefish_config.h"
+
+namespace fs = std::filesystem;
+
+static const char* kIccProfile =
+#include "iccfile.txt"
+    ;
+
+namespace cuttlefish {
+namespace {
+
+// What the RIL sends from boot until the device is registered and has data,
+// followed by the polling it does while idle, in the form of the "AT> " lines
+// of a modem_simulator log.
+constexpr char kRilSession[] = R"(ATE0Q0V1
+ATS0=0
+AT+CMEE=1
+AT+CFUN?
+AT+CFUN=1
+AT+CPIN?
+AT+CIMI
+AT+CICCID
+AT+CRSM=192,28589,0,0,15
+AT+CRSM=176,28589,0,0,4
+AT+CRSM=192,28472,0,0,15
+AT+CRSM=176,28472,0,0,15
+AT+CRSM=178,28480,1,4,28
+AT+CLCK="SC",2
+AT+CLCK="FD",2
+AT+CPINR="SIM PIN"
+AT+CSCA?
+AT+CMOD=0
+AT+CSSN=0,1
+AT+COLP=0
+AT+CSCS="HEX"
+AT+CMGF=0
+AT+CGEREP=1,0
+AT+CTEC=?
+AT+CTEC?
+AT+CREG=2
+AT+CGREG=2
+AT+CEREG=2
+AT+COPS=3,0;+COPS?;+COPS=3,1;+COPS?;+COPS=3,2;+COPS?
+AT+CREG?
+AT+CGREG?
+AT+CEREG?
+AT+CSQ
+AT+CGDCONT=1,"IPV6","ims",,0,0
+AT+CGQREQ=1
+AT+CGQMIN=1
+AT+CGACT=1,1
+AT+CGCONTRDP=1
+AT+CGACT?
+AT+CGDCONT?
+AT+CLCC
+AT+CCWA=1
+AT+CLIP?
+AT+CLIR?
+AT+CCSS=1
+AT+CUSATD?
+AT+CGSN
+AT+CSQ
+AT+CREG?
+AT+CEREG?
+AT+CLCC
+AT+CSQ
+AT+COPS?
+AT+CTEC?
+AT+CGACT?
+)";
+
+constexpr size_t kSessionRepetitions = 20;
+
+// A log of a different session can be replayed instead by pointing this
+// environment variable at it.
+constexpr char kSessionEnvVar[] = "MODEM_SIMULATOR_BENCHMARK_INPUT";
+
+std::vector<std::string> RilSession() {
+  std::string session = kRilSession;
+  std::string marker;
+  const char* path = getenv(kSessionEnvVar);
+  if (path != nullptr) {
+    std::ifstream file(path);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    CHECK(file) << "Failed to read " << path;
+    session = contents.str();
+    marker = "AT> ";
+  }
+  std::vector<std::string> commands;
+  for (const auto& line : android::base::Split(session, "\n")) {
+    auto pos = line.find(marker);
+    if (pos != std::string::npos && line.size() > pos + marker.size()) {
+      commands.push_back(line.substr(pos + marker.size()));
+    }
+  }
+  std::vector<std::string> repeated;
+  for (size_t i = 0; i < kSessionRepetitions; i++) {
+    repeated.insert(repeated.end(), commands.begin(), commands.end());
+  }
+  return repeated;
+}
+
+// Sets up the same config as the service tests so all the modem services
+// can be created.
+ModemSimulator& Simulator() {
+  static ModemSimulator* simulator = []() {
+    auto dir = fs::temp_directory_path() / "cuttlefish_modem_benchmark";
+    CuttlefishConfig tmp_config_obj;
+    auto config_file = dir.string() + "/.cuttlefish_config.json";
+    tmp_config_obj.set_root_dir(dir.string() + "/cuttlefish");
+    tmp_config_obj.ForInstance(GetInstance()).set_ril_dns(CF_DEFAULTS_RIL_DNS);
+    auto instance = tmp_config_obj.Instances()[0];
+    fs::create_directories(instance.instance_dir());
+    CHECK(tmp_config_obj.SaveToFile(config_file));
+    std::ofstream icc_profile = modem::DeviceConfig::open_ofstream_crossplat(
+        instance.PerInstancePath("/iccprofile_for_sim0.xml").c_str(),
+        std::ofstream::out);
+    icc_profile << kIccProfile;
+    icc_profile.close();
+    ::setenv("CUTTLEFISH_CONFIG_FILE", config_file.c_str(), 1);
+
+    NvramConfig::InitNvramConfigService(1, 1);
+    auto simulator = new ModemSimulator(0);
+    SharedFD server;
+    simulator->Initialize(std::make_unique<ChannelMonitor>(simulator, server));
+    return simulator;
+  }();
+  return *simulator;
+}
+
+// How the simulator found handlers before, by comparing the command with
+// each handler in registration order.
+const CommandHandler* FindLinear(const CommandIndex& index,
+                                 const std::string& command) {
+  for (auto handler : index.handlers()) {
+    if (handler->Compare(command) == 0) {
+      return handler;
+    }
+  }
+  return nullptr;
+}
+
+const CommandHandler* Find(const CommandIndex& index, bool indexed,
+                           const std::string& command) {
+  return indexed ? index.Find(command) : FindLinear(index, command);
+}
+
+// Looks up the handler for every command of the session. The argument
+// selects the lookup: 0 for the linear scan, 1 for the trie.
+void BM_ReplayRilSession(benchmark::State& state) {
+  const bool indexed = state.range(0);
+  android::base::SetMinimumLogSeverity(android::base::WARNING);
+  const auto& index = Simulator().command_index();
+  const auto session = RilSession();
+
+  for (auto _ : state) {
+    for (const auto& command : session) {
+      benchmark::DoNotOptimize(Find(index, indexed, command));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * session.size());
+
+  // Timed separately so the clock reads don't count against commands/s.
+  std::vector<double> latencies;
+  latencies.reserve(session.size());
+  for (const auto& command : session) {
+    auto start = std::chrono::steady_clock::now();
+    benchmark::DoNotOptimize(Find(index, indexed, command));
+    std::chrono::duration<double, std::nano> elapsed =
+        std::chrono::steady_clock::now() - start;
+    latencies.push_back(elapsed.count());
+  }
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&latencies](double p) {
+    return latencies[static_cast<size_t>(p * (latencies.size() - 1))];
+  };
+  state.counters["p50_ns"] = percentile(0.5);
+  state.counters["p99_ns"] = percentile(0.99);
+  state.counters["max_ns"] = latencies.back();
+}
+
+BENCHMARK(BM_ReplayRilSession)->ArgName("indexed")->Arg(0)->Arg(1);
+
+}  // namespace
+}  // namespace cuttlefish
+
+BENCHMARK_MAIN();
@@ -0,0 +1,90 @@
+//
+// Copyright (C) 2023 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "host/commands/modem_simulator/command_index.h"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+using cuttlefish::Client;
+using cuttlefish::CommandHandler;
+using cuttlefish::CommandIndex;
+
+CommandHandler Full(const std::string& command) {
+  return CommandHandler(command, cuttlefish::f_func([](const Client&) {}));
+}
+
+CommandHandler Partial(const std::string& command) {
+  return CommandHandler(
+      command, cuttlefish::p_func([](const Client&, std::string&) {}));
+}
+
+// The handler the walk over every handler in order picks.
+const CommandHandler* FindLinear(const CommandIndex& index,
+                                 const std::string& command) {
+  for (auto handler : index.handlers()) {
+    if (handler->Compare(command) == 0) {
+      return handler;
+    }
+  }
+  return nullptr;
+}
+
+}  // namespace
+
+TEST(CommandIndexUnitTest, MatchesFullAndPartialCommands) {
+  std::vector<CommandHandler> handlers = {
+      Full("+CFUN?"), Partial("+CFUN="), Partial("+CREG"), Full("+COPS?"),
+      Partial("+COPS=")};
+  CommandIndex index;
+  for (const auto& handler : handlers) {
+    index.Add(handler);
+  }
+
+  EXPECT_EQ(index.Find("AT+CFUN?"), &handlers[0]);
+  EXPECT_EQ(index.Find("AT+CFUN=1"), &handlers[1]);
+  EXPECT_EQ(index.Find("AT+CREG?"), &handlers[2]);
+  EXPECT_EQ(index.Find("AT+CREG"), &handlers[2]);
+  EXPECT_EQ(index.Find("AT+COPS=0"), &handlers[4]);
+  EXPECT_EQ(index.Find("AT+COPS?;"), nullptr);
+  EXPECT_EQ(index.Find("AT+CFUN"), nullptr);
+  EXPECT_EQ(index.Find("AT+CGREG?"), nullptr);
+  EXPECT_EQ(index.Find("AT"), nullptr);
+  EXPECT_EQ(index.Find("A"), nullptr);
+  EXPECT_EQ(index.Find(""), nullptr);
+}
+
+TEST(CommandIndexUnitTest, EarlierHandlerWins) {
+  // Like the data service's dial-up command registered before the call
+  // service's dial command.
+  std::vector<CommandHandler> handlers = {
+      Full("D*99***1#"), Partial("D"), Partial("+CUSD="), Partial("+CUSD"),
+      Full("+CUSD=1"), Partial("+CMGS"), Partial("+CMGS")};
+  CommandIndex index;
+  for (const auto& handler : handlers) {
+    index.Add(handler);
+  }
+
+  for (const std::string& command :
+       {"ATD*99***1#", "ATD*99***1#;", "ATD5551234;", "AT+CUSD=1",
+        "AT+CUSD?", "AT+CUSD", "AT+CMGS=22", "AT+CMG"}) {
+    EXPECT_EQ(index.Find(command), FindLinear(index, command)) << command;
+  }
+  EXPECT_EQ(index.Find("ATD*99***1#"), &handlers[0]);
+  EXPECT_EQ(index.Find("ATD*99#"), &handlers[1]);
+  EXPECT_EQ(index.Find("AT+CUSD=1"), &handlers[2]);
+  EXPECT_EQ(index.Find("AT+CMGS=22"), &handlers[5]);
+}
@@ -23,7 +23,7 @@
 #include "common/libs/fs/shared_fd.h"
 #include "common/libs/utils/subprocess.h"
 #include "host/commands/run_cvd/launch/grpc_socket_creator.h"
-#include "host/commands/run_cvd/launch/log_tee_creator.h"
+#include "host/commands/run_cvd/launch/log_collector_forwarder.h"
 #include "host/libs/config/command_source.h"
 #include "host/libs/config/custom_actions.h"
 #include "host/libs/config/cuttlefish_config.h"
@@ -45,6 +45,9 @@ fruit::Component<fruit::Required<const CuttlefishConfig::InstanceSpecific>,
                  KernelLogPipeProvider>
 KernelLogMonitorComponent();
 
+fruit::Component<fruit::Required<const CuttlefishConfig::InstanceSpecific>>
+LogCollectorComponent();
+
 fruit::Component<fruit::Required<const CuttlefishConfig::InstanceSpecific>>
 LogcatReceiverComponent();
 
@@ -63,7 +66,8 @@ MetricsServiceComponent();
 
 fruit::Component<
     fruit::Required<const CuttlefishConfig,
-                    const CuttlefishConfig::InstanceSpecific, LogTeeCreator>>
+                    const CuttlefishConfig::InstanceSpecific,
+                    LogCollectorForwarder>>
 OpenWrtComponent();
 
 fruit::Component<fruit::Required<const CuttlefishConfig::InstanceSpecific,
@@ -72,12 +76,14 @@ OpenwrtControlServerComponent();
 
 fruit::Component<
     fruit::Required<const CuttlefishConfig,
-                    const CuttlefishConfig::InstanceSpecific, LogTeeCreator>>
+                    const CuttlefishConfig::InstanceSpecific,
+                    LogCollectorForwarder>>
 RootCanalComponent();
 
 fruit::Component<
     fruit::Required<const CuttlefishConfig,
-                    const CuttlefishConfig::InstanceSpecific, LogTeeCreator>>
+                    const CuttlefishConfig::InstanceSpecific,
+                    LogCollectorForwarder>>
 PicaComponent();
 
 fruit::Component<fruit::Required<GrpcSocketCreator>> EchoServerComponent();
@@ -96,7 +102,7 @@ TombstoneReceiverComponent();
 
 fruit::Component<fruit::Required<const CuttlefishConfig,
                                  const CuttlefishConfig::InstanceSpecific,
-                                 LogTeeCreator, GrpcSocketCreator>>
+                                 LogCollectorForwarder, GrpcSocketCreator>>
 WmediumdServerComponent();
 
 fruit::Component<fruit::Required<const CuttlefishConfig,
@@ -0,0 +1,114 @@
+//
+// Copyright (C) 2023 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "host/commands/run_cvd/launch/launch.h"
+
+#include <signal.h>
+#include <sys/socket.h>
+
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <fruit/fruit.h>
+
+#include "common/libs/utils/result.h"
+#include "host/commands/run_cvd/reporting.h"
+#include "host/libs/config/command_source.h"
+#include "host/libs/config/known_paths.h"
+#include "host/libs/config/logging.h"
+
+namespace cuttlefish {
+namespace {
+
+// Room for every process of the instance to register before the collector
+// gets to accepting them.
+constexpr int kRegistrationBacklog = 64;
+
+class LogCollector : public CommandSource, public DiagnosticInformation {
+ public:
+  INJECT(LogCollector(const CuttlefishConfig::InstanceSpecific& instance))
+      : instance_(instance) {}
+
+  // DiagnosticInformation
+  std::vector<std::string> Diagnostics() const override {
+    return {"Indexed launcher log, printed by log_reader: " +
+            instance_.launcher_binary_log_path()};
+  }
+
+  // CommandSource
+  Result<std::vector<MonitorCommand>> Commands() override {
+    Command command(LogCollectorBinary());
+    command.AddParameter("--server_fd=", server_);
+    command.SetStopper([](Subprocess* proc) {
+      // Ask nicely so that it gets a chance to process all the logs.
+      int rval = kill(proc->pid(), SIGINT);
+      if (rval != 0) {
+        LOG(ERROR) << "Failed to stop log_collector nicely, attempting to KILL";
+        return KillSubprocess(proc) == StopperResult::kStopSuccess
+                   ? StopperResult::kStopCrash
+                   : StopperResult::kStopFailure;
+      }
+      return StopperResult::kStopSuccess;
+    });
+    std::vector<MonitorCommand> commands;
+    // Stopped after everything else to capture their output during shutdown.
+    commands.emplace_back(std::move(command))
+        .StopLast()
+        // Registrations die with the collector, every collector started gets
+        // all of them. The output written in between waits in the pipes.
+        .OnStart([socket_path = instance_.log_collector_socket_path()]() {
+          return SendLogSourcesToCollector(socket_path);
+        });
+    return commands;
+  }
+
+  // SetupFeature
+  std::string Name() const override { return "LogCollector"; }
+  bool Enabled() const override { return true; }
+
+ private:
+  std::unordered_set<SetupFeature*> Dependencies() const override { return {}; }
+  Result<void> ResultSetup() override {
+    // Created here rather than by the collector so that it outlives restarts
+    // of the collector, registrations queue up in it until the new one
+    // accepts them.
+    auto socket_path = instance_.log_collector_socket_path();
+    server_ = SharedFD::SocketLocalServer(socket_path, false, SOCK_SEQPACKET,
+                                          0600);
+    CF_EXPECT(server_->IsOpen(), "Failed to create \"" << socket_path << "\": "
+                                                       << server_->StrError());
+    CF_EXPECT(server_->Listen(kRegistrationBacklog) == 0,
+              "Failed to listen on \"" << socket_path
+                                       << "\": " << server_->StrError());
+    return {};
+  }
+
+  const CuttlefishConfig::InstanceSpecific& instance_;
+  SharedFD server_;
+};
+
+}  // namespace
+
+fruit::Component<fruit::Required<const CuttlefishConfig::InstanceSpecific>>
+LogCollectorComponent() {
+  return fruit::createComponent()
+      .addMultibinding<CommandSource, LogCollector>()
+      .addMultibinding<SetupFeature, LogCollector>()
+      .addMultibinding<DiagnosticInformation, LogCollector>();
+}
+
+}  // namespace cuttlefish
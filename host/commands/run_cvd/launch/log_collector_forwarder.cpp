@@ -0,0 +1,35 @@
+//
+// Copyright (C) 2019 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "host/commands/run_cvd/launch/log_collector_forwarder.h"
+
+#include "host/libs/config/logging.h"
+
+namespace cuttlefish {
+
+Result<void> LogCollectorForwarder::ForwardOutput(
+    Command& cmd, const std::string& process_name) {
+  SharedFD read_end, write_end;
+  CF_EXPECT(SharedFD::Pipe(&read_end, &write_end),
+            "Failed to create a pipe for " << process_name << " output: "
+                                           << read_end->StrError());
+  RegisterLogSource(process_name, read_end);
+
+  cmd.RedirectStdIO(Subprocess::StdIOChannel::kStdOut, write_end);
+  cmd.RedirectStdIO(Subprocess::StdIOChannel::kStdErr, write_end);
+  return {};
+}
+
+}  // namespace cuttlefish
@@ -15,21 +15,24 @@
 
 #pragma once
 
+#include <string>
+
 #include <fruit/fruit.h>
 
+#include "common/libs/utils/result.h"
 #include "common/libs/utils/subprocess.h"
-#include "host/libs/config/cuttlefish_config.h"
 
 namespace cuttlefish {
 
-class LogTeeCreator {
+class LogCollectorForwarder {
  public:
-  INJECT(LogTeeCreator(const CuttlefishConfig::InstanceSpecific& instance));
-
-  Command CreateLogTee(Command& cmd, const std::string& process_name);
+  INJECT(LogCollectorForwarder()) = default;
 
- private:
-  const CuttlefishConfig::InstanceSpecific& instance_;
+  // Sends the stdout and stderr of |cmd| to the log_collector, which credits
+  // them to |process_name| in the launcher log. The pipe outlives both |cmd|
+  // and the collector, so either can be restarted without losing output.
+  Result<void> ForwardOutput(Command& cmd,
+                             const std::string& process_name);
 };
 
 }  // namespace cuttlefish
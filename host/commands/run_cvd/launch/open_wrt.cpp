@@ -41,8 +41,10 @@ class OpenWrt : public CommandSource {
  public:
   INJECT(OpenWrt(const CuttlefishConfig& config,
                  const CuttlefishConfig::InstanceSpecific& instance,
-                 LogTeeCreator& log_tee))
-      : config_(config), instance_(instance), log_tee_(log_tee) {}
+                 LogCollectorForwarder& log_forwarder))
+      : config_(config),
+        instance_(instance),
+        log_forwarder_(log_forwarder) {}
 
   // CommandSource
   Result<std::vector<MonitorCommand>> Commands() override {
@@ -97,9 +99,11 @@ class OpenWrt : public CommandSource {
     }
 
     std::vector<MonitorCommand> commands;
-    commands.emplace_back(
-        std::move(log_tee_.CreateLogTee(ap_cmd.Cmd(), "openwrt")));
-    commands.emplace_back(std::move(ap_cmd.Cmd()));
+    CF_EXPECT(log_forwarder_.ForwardOutput(ap_cmd.Cmd(), "openwrt"));
+    auto& ap_command = commands.emplace_back(std::move(ap_cmd.Cmd()));
+    if (!config_.vhost_user_mac80211_hwsim().empty()) {
+      ap_command.DependsOn(kWmediumdServerSource);
+    }
     return commands;
   }
 
@@ -116,7 +120,7 @@ class OpenWrt : public CommandSource {
 
   const CuttlefishConfig& config_;
   const CuttlefishConfig::InstanceSpecific& instance_;
-  LogTeeCreator& log_tee_;
+  LogCollectorForwarder& log_forwarder_;
 
   static constexpr int kOpenwrtVmResetExitCode = 32;
 };
@@ -125,7 +129,8 @@ class OpenWrt : public CommandSource {
 
 fruit::Component<
     fruit::Required<const CuttlefishConfig,
-                    const CuttlefishConfig::InstanceSpecific, LogTeeCreator>>
+                    const CuttlefishConfig::InstanceSpecific,
+                    LogCollectorForwarder>>
 OpenWrtComponent() {
   return fruit::createComponent()
       .addMultibinding<CommandSource, OpenWrt>()
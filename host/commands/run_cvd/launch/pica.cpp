@@ -18,7 +18,7 @@
 #include <unordered_set>
 #include <vector>
 
-#include "host/commands/run_cvd/launch/log_tee_creator.h"
+#include "host/commands/run_cvd/launch/log_collector_forwarder.h"
 #include "host/libs/config/cuttlefish_config.h"
 #include "host/libs/config/known_paths.h"
 
@@ -29,8 +29,10 @@ class Pica : public CommandSource {
  public:
   INJECT(Pica(const CuttlefishConfig& config,
                    const CuttlefishConfig::InstanceSpecific& instance,
-                   LogTeeCreator& log_tee))
-      : config_(config), instance_(instance), log_tee_(log_tee) {}
+                   LogCollectorForwarder& log_forwarder))
+      : config_(config),
+        instance_(instance),
+        log_forwarder_(log_forwarder) {}
 
   // CommandSource
   Result<std::vector<MonitorCommand>> Commands() override {
@@ -44,7 +46,7 @@ class Pica : public CommandSource {
 
 
     std::vector<MonitorCommand> commands;
-    commands.emplace_back(std::move(log_tee_.CreateLogTee(command, "pica")));
+    CF_EXPECT(log_forwarder_.ForwardOutput(command, "pica"));
     commands.emplace_back(std::move(command));
     return commands;
   }
@@ -61,14 +63,15 @@ class Pica : public CommandSource {
 
   const CuttlefishConfig& config_;
   const CuttlefishConfig::InstanceSpecific& instance_;
-  LogTeeCreator& log_tee_;
+  LogCollectorForwarder& log_forwarder_;
 };
 
 }  // namespace
 
 fruit::Component<
     fruit::Required<const CuttlefishConfig,
-                    const CuttlefishConfig::InstanceSpecific, LogTeeCreator>>
+                    const CuttlefishConfig::InstanceSpecific,
+                    LogCollectorForwarder>>
 PicaComponent() {
   return fruit::createComponent()
       .addMultibinding<CommandSource, Pica>()
@@ -23,7 +23,7 @@
 #include <fruit/fruit.h>
 
 #include "common/libs/utils/result.h"
-#include "host/commands/run_cvd/launch/log_tee_creator.h"
+#include "host/commands/run_cvd/launch/log_collector_forwarder.h"
 #include "host/libs/config/command_source.h"
 #include "host/libs/config/cuttlefish_config.h"
 #include "host/libs/config/known_paths.h"
@@ -35,8 +35,10 @@ class RootCanal : public CommandSource {
  public:
   INJECT(RootCanal(const CuttlefishConfig& config,
                    const CuttlefishConfig::InstanceSpecific& instance,
-                   LogTeeCreator& log_tee))
-      : config_(config), instance_(instance), log_tee_(log_tee) {}
+                   LogCollectorForwarder& log_forwarder))
+      : config_(config),
+        instance_(instance),
+        log_forwarder_(log_forwarder) {}
 
   // CommandSource
   Result<std::vector<MonitorCommand>> Commands() override {
@@ -88,8 +90,7 @@ class RootCanal : public CommandSource {
                                   config_.rootcanal_test_port());
 
     std::vector<MonitorCommand> commands;
-    commands.emplace_back(
-        std::move(log_tee_.CreateLogTee(rootcanal, "rootcanal")));
+    CF_EXPECT(log_forwarder_.ForwardOutput(rootcanal, "rootcanal"));
     commands.emplace_back(std::move(rootcanal));
     commands.emplace_back(std::move(hci_vsock_proxy));
     commands.emplace_back(std::move(test_vsock_proxy));
@@ -108,14 +109,15 @@ class RootCanal : public CommandSource {
 
   const CuttlefishConfig& config_;
   const CuttlefishConfig::InstanceSpecific& instance_;
-  LogTeeCreator& log_tee_;
+  LogCollectorForwarder& log_forwarder_;
 };
 
 }  // namespace
 
 fruit::Component<
     fruit::Required<const CuttlefishConfig,
-                    const CuttlefishConfig::InstanceSpecific, LogTeeCreator>>
+                    const CuttlefishConfig::InstanceSpecific,
+                    LogCollectorForwarder>>
 RootCanalComponent() {
   return fruit::createComponent()
       .addMultibinding<CommandSource, RootCanal>()
@@ -25,7 +25,7 @@
 #include "common/libs/utils/files.h"
 #include "common/libs/utils/result.h"
 #include "host/commands/run_cvd/launch/grpc_socket_creator.h"
-#include "host/commands/run_cvd/launch/log_tee_creator.h"
+#include "host/commands/run_cvd/launch/log_collector_forwarder.h"
 #include "host/libs/config/command_source.h"
 #include "host/libs/config/cuttlefish_config.h"
 #include "host/libs/config/known_paths.h"
@@ -37,10 +37,11 @@ class WmediumdServer : public CommandSource {
  public:
   INJECT(WmediumdServer(const CuttlefishConfig& config,
                         const CuttlefishConfig::InstanceSpecific& instance,
-                        LogTeeCreator& log_tee, GrpcSocketCreator& grpc_socket))
+                        LogCollectorForwarder& log_forwarder,
+                        GrpcSocketCreator& grpc_socket))
       : config_(config),
         instance_(instance),
-        log_tee_(log_tee),
+        log_forwarder_(log_forwarder),
         grpc_socket_(grpc_socket) {}
 
   // CommandSource
@@ -53,13 +54,14 @@ class WmediumdServer : public CommandSource {
     cmd.AddParameter("--grpc_uds_path=", grpc_socket_.CreateGrpcSocket(Name()));
 
     std::vector<MonitorCommand> commands;
-    commands.emplace_back(std::move(log_tee_.CreateLogTee(cmd, "wmediumd")));
-    commands.emplace_back(std::move(cmd));
+    CF_EXPECT(log_forwarder_.ForwardOutput(cmd, "wmediumd"));
+    commands.emplace_back(std::move(cmd))
+        .ReadyWhenPathExists(config_.vhost_user_mac80211_hwsim());
     return commands;
   }
 
   // SetupFeature
-  std::string Name() const override { return "WmediumdServer"; }
+  std::string Name() const override { return kWmediumdServerSource; }
   bool Enabled() const override {
     return instance_.start_wmediumd();
   }
@@ -88,7 +90,7 @@ class WmediumdServer : public CommandSource {
 
   const CuttlefishConfig& config_;
   const CuttlefishConfig::InstanceSpecific& instance_;
-  LogTeeCreator& log_tee_;
+  LogCollectorForwarder& log_forwarder_;
   GrpcSocketCreator& grpc_socket_;
   std::string config_path_;
 };
@@ -127,7 +129,7 @@ class ValidateWmediumdService : public SetupFeature {
 
 fruit::Component<fruit::Required<const CuttlefishConfig,
                                  const CuttlefishConfig::InstanceSpecific,
-                                 LogTeeCreator, GrpcSocketCreator>>
+                                 LogCollectorForwarder, GrpcSocketCreator>>
 WmediumdServerComponent() {
   return fruit::createComponent()
       .addMultibinding<CommandSource, WmediumdServer>()
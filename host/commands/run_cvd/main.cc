@@ -76,8 +76,9 @@ class CuttlefishEnvironment : public DiagnosticInformation {
 class InstanceLifecycle : public LateInjected {
  public:
   INJECT(InstanceLifecycle(const CuttlefishConfig& config,
+                           const CuttlefishConfig::InstanceSpecific& instance,
                            ServerLoop& server_loop))
-      : config_(config), server_loop_(server_loop) {}
+      : config_(config), instance_(instance), server_loop_(server_loop) {}
 
   Result<void> LateInject(fruit::Injector<>& injector) override {
     config_fragments_ = injector.getMultibindings<ConfigFragment>();
@@ -94,7 +95,14 @@ class InstanceLifecycle : public LateInjected {
     // One of the setup features can consume most output, so print this early.
     DiagnosticInformation::PrintAll(diagnostics_);
 
-    CF_EXPECT(SetupFeature::RunSetup(setup_features_));
+    SetupTrace setup_trace;
+    CF_EXPECT(SetupFeature::RunSetup(setup_features_, &setup_trace));
+    auto trace_path =
+        instance_.PerInstanceInternalPath("run_cvd_setup_trace.json");
+    auto trace_written = setup_trace.WriteChromeTrace(trace_path);
+    if (!trace_written.ok()) {
+      LOG(WARNING) << trace_written.error().Message();
+    }
 
     CF_EXPECT(server_loop_.Run());
 
@@ -103,6 +111,7 @@ class InstanceLifecycle : public LateInjected {
 
  private:
   const CuttlefishConfig& config_;
+  const CuttlefishConfig::InstanceSpecific& instance_;
   ServerLoop& server_loop_;
   std::vector<ConfigFragment*> config_fragments_;
   std::vector<SetupFeature*> setup_features_;
@@ -133,6 +142,7 @@ fruit::Component<> runCvdComponent(
       .install(ConsoleForwarderComponent)
       .install(EchoServerComponent)
       .install(GnssGrpcProxyServerComponent)
+      .install(LogCollectorComponent)
       .install(LogcatReceiverComponent)
       .install(KernelLogMonitorComponent)
       .install(MetricsServiceComponent)
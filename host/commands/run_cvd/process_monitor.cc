@@ -16,52 +16,74 @@
 
 #include "host/commands/run_cvd/process_monitor.h"
 
+#include <sys/epoll.h>
 #include <sys/prctl.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 
 #include <assert.h>
 #include <errno.h>
+#include <poll.h>
 #include <signal.h>
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 
 #include <algorithm>
-#include <atomic>
+#include <chrono>
+#include <deque>
 #include <future>
 #include <memory>
+#include <optional>
+#include <string>
 #include <thread>
+#include <unordered_map>
+#include <utility>
 
+#include <android-base/file.h>
 #include <android-base/logging.h>
+#include <json/json.h>
 
+#include "common/libs/fs/epoll.h"
 #include "common/libs/fs/shared_buf.h"
 #include "common/libs/fs/shared_select.h"
+#include "common/libs/utils/files.h"
+#include "common/libs/utils/proc_file_utils.h"
 #include "common/libs/utils/result.h"
 #include "common/libs/utils/subprocess.h"
 #include "host/libs/config/cuttlefish_config.h"
 #include "host/libs/config/known_paths.h"
 
+#ifndef __NR_pidfd_open
+#define __NR_pidfd_open 434
+#endif
+
 namespace cuttlefish {
 
 namespace {
 
+using Clock = std::chrono::steady_clock;
+
+constexpr auto kReadinessPollPeriod = std::chrono::milliseconds(10);
+constexpr auto kStopTimeout = std::chrono::seconds(30);
+constexpr auto kStopPollMaxPeriod = std::chrono::milliseconds(50);
+constexpr auto kMinRestartDelay = std::chrono::milliseconds(250);
+constexpr auto kMaxRestartDelay = std::chrono::seconds(30);
+// A process that ran at least this long before exiting is restarted right
+// away and its backoff is reset.
+constexpr auto kStableRuntime = std::chrono::seconds(60);
+// A process is no longer restarted after this many exits within the window.
+constexpr size_t kCrashLoopExits = 5;
+constexpr auto kCrashLoopWindow = std::chrono::seconds(60);
+constexpr auto kUsageSamplePeriod = std::chrono::seconds(5);
+// Used to notice exits when the kernel doesn't support pidfds.
+constexpr auto kFallbackReapPeriod = std::chrono::milliseconds(200);
+
 struct ParentToChildMessage {
   bool stop;
 };
 
-void LogSubprocessExit(const std::string& name, pid_t pid, int wstatus) {
-  LOG(INFO) << "Detected unexpected exit of monitored subprocess " << name;
-  if (WIFEXITED(wstatus)) {
-    LOG(INFO) << "Subprocess " << name << " (" << pid
-              << ") has exited with exit code " << WEXITSTATUS(wstatus);
-  } else if (WIFSIGNALED(wstatus)) {
-    LOG(ERROR) << "Subprocess " << name << " (" << pid
-               << ") was interrupted by a signal: " << WTERMSIG(wstatus);
-  } else {
-    LOG(INFO) << "subprocess " << name << " (" << pid
-              << ") has exited for unknown reasons";
-  }
-}
-
 void LogSubprocessExit(const std::string& name, const siginfo_t& infop) {
   LOG(INFO) << "Detected unexpected exit of monitored subprocess " << name;
   if (infop.si_code == CLD_EXITED) {
@@ -77,103 +99,538 @@ void LogSubprocessExit(const std::string& name, const siginfo_t& infop) {
   }
 }
 
+Result<void> StartSubprocess(MonitorEntry& entry) {
+  LOG(INFO) << entry.cmd->GetShortName();
+  auto options = SubprocessOptions().InGroup(true);
+  entry.proc.reset(new Subprocess(entry.cmd->Start(options)));
+  CF_EXPECT(entry.proc->Started(), "Failed to start subprocess");
+  if (entry.on_start) {
+    // The process is running either way, failing here would get it started
+    // a second time.
+    auto result = entry.on_start();
+    if (!result.ok()) {
+      LOG(ERROR) << "Failed to set up " << entry.cmd->GetShortName()
+                 << " after starting it: " << result.error().Message();
+    }
+  }
+  return {};
+}
+
+bool HasExited(const Subprocess& proc) {
+  siginfo_t infop = {};
+  // WNOWAIT leaves the process to be reaped by the monitor loop.
+  auto ret = waitid(P_PID, proc.pid(), &infop, WEXITED | WNOHANG | WNOWAIT);
+  return ret == 0 && infop.si_pid != 0;
+}
+
+}  // namespace
+
 Result<void> StartSubprocesses(std::vector<MonitorEntry>& entries) {
   LOG(DEBUG) << "Starting monitored subprocesses";
-  for (auto& monitored : entries) {
-    LOG(INFO) << monitored.cmd->GetShortName();
-    auto options = SubprocessOptions().InGroup(true);
-    monitored.proc.reset(new Subprocess(monitored.cmd->Start(options)));
-    CF_EXPECT(monitored.proc->Started(), "Failed to start subprocess");
+  enum class State { kWaiting, kStarting, kReady };
+  std::vector<State> states(entries.size(), State::kWaiting);
+  std::vector<Clock::time_point> deadlines(entries.size());
+  std::unordered_map<std::string, std::vector<size_t>> by_source;
+  for (size_t i = 0; i < entries.size(); i++) {
+    by_source[entries[i].source].push_back(i);
+  }
+  auto dependencies_ready = [&](size_t index) {
+    for (const auto& dependency : entries[index].dependencies) {
+      auto it = by_source.find(dependency);
+      if (it == by_source.end() || dependency == entries[index].source) {
+        continue;
+      }
+      for (auto other : it->second) {
+        if (states[other] != State::kReady) {
+          return false;
+        }
+      }
+    }
+    return true;
+  };
+
+  size_t not_ready = entries.size();
+  while (not_ready > 0) {
+    // Start everything that isn't blocked, then wait for readiness signals
+    // only when there is nothing else left to start.
+    bool started_any = false;
+    for (size_t i = 0; i < entries.size(); i++) {
+      if (states[i] != State::kWaiting || !dependencies_ready(i)) {
+        continue;
+      }
+      CF_EXPECT(StartSubprocess(entries[i]));
+      started_any = true;
+      if (entries[i].readiness.IsSet()) {
+        states[i] = State::kStarting;
+        deadlines[i] = Clock::now() + entries[i].readiness.timeout;
+      } else {
+        states[i] = State::kReady;
+        not_ready--;
+      }
+    }
+    if (started_any) {
+      continue;
+    }
+
+    std::vector<PollSharedFd> poll_fds;
+    std::vector<size_t> polled_entries;
+    std::vector<size_t> starting;
+    auto next_deadline = Clock::time_point::max();
+    for (size_t i = 0; i < entries.size(); i++) {
+      if (states[i] != State::kStarting) {
+        continue;
+      }
+      starting.push_back(i);
+      next_deadline = std::min(next_deadline, deadlines[i]);
+      if (entries[i].readiness.fd->IsOpen()) {
+        poll_fds.push_back(PollSharedFd{
+            .fd = entries[i].readiness.fd, .events = POLLIN, .revents = 0});
+        polled_entries.push_back(i);
+      }
+    }
+    if (starting.empty()) {
+      LOG(ERROR) << "Commands have circular dependencies, starting the rest "
+                    "in any order";
+      for (auto& entry : entries) {
+        entry.dependencies.clear();
+      }
+      continue;
+    }
+
+    // Paths and early exits can't be waited on, so poll with a short period.
+    auto timeout = std::min<Clock::duration>(next_deadline - Clock::now(),
+                                             kReadinessPollPeriod);
+    auto timeout_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(timeout).count();
+    SharedFD::Poll(poll_fds, std::max<int64_t>(timeout_ms, 0));
+
+    std::vector<bool> signaled(entries.size());
+    for (size_t i = 0; i < poll_fds.size(); i++) {
+      signaled[polled_entries[i]] = poll_fds[i].revents != 0;
+    }
+    auto now = Clock::now();
+    for (auto i : starting) {
+      const auto& entry = entries[i];
+      const auto& readiness = entry.readiness;
+      bool ready = signaled[i] ||
+                   (!readiness.path.empty() && FileExists(readiness.path));
+      if (!ready && HasExited(*entry.proc)) {
+        LOG(WARNING) << entry.cmd->GetShortName()
+                     << " exited before becoming ready";
+        ready = true;
+      }
+      if (!ready && now >= deadlines[i]) {
+        LOG(WARNING) << entry.cmd->GetShortName() << " not ready after "
+                     << readiness.timeout.count()
+                     << "ms, starting its dependents anyway";
+        ready = true;
+      }
+      if (ready) {
+        states[i] = State::kReady;
+        not_ready--;
+      }
+    }
   }
   return {};
 }
 
-Result<void> ReadMonitorSocketLoopForStop(std::atomic_bool& running,
-                                          SharedFD& monitor_socket) {
-  LOG(DEBUG) << "Waiting for a `stop` message from the parent";
-  while (running.load()) {
+namespace {
+
+Result<SharedFD> PidFdOpen(pid_t pid) {
+  int fd = syscall(__NR_pidfd_open, pid, 0);
+  CF_EXPECT(fd >= 0, "pidfd_open(" << pid << ") failed: " << strerror(errno));
+  auto pidfd = SharedFD::Dup(fd);
+  close(fd);
+  CF_EXPECT(pidfd->IsOpen(), "Failed to dup pidfd: " << pidfd->StrError());
+  return pidfd;
+}
+
+// Keeps the started subprocesses running until the parent asks to stop. All
+// events are handled on a single thread waiting on an epoll set made of the
+// parent socket and one pidfd per subprocess.
+class Supervisor {
+ public:
+  Supervisor(std::vector<MonitorEntry>& entries, SharedFD parent,
+             bool restart_subprocesses, std::string resource_usage_path)
+      : entries_(entries),
+        parent_(std::move(parent)),
+        restart_subprocesses_(restart_subprocesses),
+        resource_usage_path_(std::move(resource_usage_path)),
+        states_(entries.size()) {}
+
+  Result<void> Run() {
+    epoll_ = CF_EXPECT(Epoll::Create());
+    CF_EXPECT(epoll_.Add(parent_, EPOLLIN));
+    auto now = Clock::now();
+    for (size_t i = 0; i < entries_.size(); i++) {
+      if (entries_[i].proc) {
+        by_pid_[entries_[i].proc->pid()] = i;
+        states_[i].started_at = now;
+        Watch(i);
+      }
+    }
+    last_sample_ = now;
+    auto next_sample = now + kUsageSamplePeriod;
+
+    LOG(DEBUG) << "Waiting for a `stop` message from the parent";
+    while (true) {
+      ReapExited();
+      RestartDue();
+      now = Clock::now();
+      if (now >= next_sample) {
+        auto sampled = SampleResourceUsage();
+        if (!sampled.ok()) {
+          LOG(DEBUG) << "Failed to sample resource usage: "
+                     << sampled.error().Trace();
+        }
+        next_sample = now + kUsageSamplePeriod;
+      }
+
+      auto wakeup = next_sample;
+      for (const auto& state : states_) {
+        if (state.restart_at) {
+          wakeup = std::min(wakeup, *state.restart_at);
+        }
+      }
+      if (!pidfd_supported_) {
+        wakeup = std::min(wakeup, now + kFallbackReapPeriod);
+      }
+      auto timeout = std::chrono::ceil<std::chrono::milliseconds>(wakeup - now);
+      auto events = CF_EXPECT(epoll_.WaitMany(
+          entries_.size() + 1, std::max<int64_t>(timeout.count(), 0)));
+      for (const auto& event : events) {
+        if (event.fd == parent_ && CF_EXPECT(HandleParentMessage())) {
+          return {};
+        }
+      }
+    }
+  }
+
+ private:
+  struct State {
+    SharedFD pidfd;
+    Clock::time_point started_at;
+    std::deque<Clock::time_point> recent_exits;
+    Clock::duration restart_delay = Clock::duration::zero();
+    std::optional<Clock::time_point> restart_at;
+    size_t restarts = 0;
+    // Clock ticks used by the process group at the previous sample.
+    uint64_t sampled_ticks = 0;
+  };
+
+  // Returns true when the parent asked to stop.
+  Result<bool> HandleParentMessage() {
     ParentToChildMessage message;
-    CF_EXPECT(ReadExactBinary(monitor_socket, &message) == sizeof(message),
-              "Could not read message from parent");
-    if (message.stop) {
-      running.store(false);
-      // Wake up the wait() loop by giving it an exited child process
-      if (fork() == 0) {
-        std::exit(0);
+    auto read = ReadExactBinary(parent_, &message);
+    if (read == 0) {
+      LOG(WARNING) << "Lost connection to the parent, stopping";
+      return true;
+    }
+    CF_EXPECT(read == sizeof(message),
+              "Could not read message from parent: " << parent_->StrError());
+    return message.stop;
+  }
+
+  void Watch(size_t index) {
+    if (!pidfd_supported_) {
+      return;
+    }
+    auto pidfd = PidFdOpen(entries_[index].proc->pid());
+    if (!pidfd.ok()) {
+      LOG(WARNING) << pidfd.error().Message() << ", polling for exits instead";
+      pidfd_supported_ = false;
+      return;
+    }
+    auto added = epoll_.Add(*pidfd, EPOLLIN);
+    if (!added.ok()) {
+      LOG(WARNING) << added.error().Message() << ", polling for exits instead";
+      pidfd_supported_ = false;
+      return;
+    }
+    states_[index].pidfd = *pidfd;
+  }
+
+  void Unwatch(size_t index) {
+    auto& pidfd = states_[index].pidfd;
+    if (pidfd->IsOpen()) {
+      epoll_.Delete(pidfd);
+      pidfd->Close();
+    }
+  }
+
+  void ReapExited() {
+    while (true) {
+      siginfo_t infop = {};
+      if (waitid(P_ALL, 0, &infop, WEXITED | WNOHANG) != 0) {
+        if (errno != ECHILD) {
+          PLOG(ERROR) << "waitid failed";
+        }
+        return;
       }
+      if (infop.si_pid == 0) {
+        return;
+      }
+      auto it = by_pid_.find(infop.si_pid);
+      if (it == by_pid_.end()) {
+        // Orphans of the subprocesses are reparented here.
+        LogSubprocessExit("(unknown)", infop);
+        continue;
+      }
+      auto index = it->second;
+      by_pid_.erase(it);
+      HandleExit(index, infop);
     }
   }
-  return {};
-}
 
-Result<void> MonitorLoop(const std::atomic_bool& running,
-                         const bool restart_subprocesses,
-                         std::vector<MonitorEntry>& monitored) {
-  while (running.load()) {
-    int wstatus;
-    pid_t pid = wait(&wstatus);
-    int error_num = errno;
-    CF_EXPECT(pid != -1, "Wait failed: " << strerror(error_num));
-    if (!WIFSIGNALED(wstatus) && !WIFEXITED(wstatus)) {
-      LOG(DEBUG) << "Unexpected status from wait: " << wstatus
-                  << " for pid " << pid;
+  void HandleExit(size_t index, const siginfo_t& infop) {
+    auto& entry = entries_[index];
+    auto& state = states_[index];
+    auto name = entry.cmd->GetShortName();
+    Unwatch(index);
+    // The process is gone, so there's nothing to stop or wait for anymore.
+    entry.proc.reset();
+    LogSubprocessExit(name, infop);
+
+    if (!restart_subprocesses_) {
+      if (entry.is_critical) {
+        StopCvd();
+      }
+      return;
+    }
+
+    auto now = Clock::now();
+    state.recent_exits.push_back(now);
+    while (state.recent_exits.front() < now - kCrashLoopWindow) {
+      state.recent_exits.pop_front();
+    }
+    if (state.recent_exits.size() >= kCrashLoopExits) {
+      LOG(ERROR) << name << " exited " << state.recent_exits.size()
+                 << " times in the last " << kCrashLoopWindow.count()
+                 << "s, not restarting it anymore";
+      if (entry.is_critical) {
+        StopCvd();
+      }
+      return;
+    }
+    if (now - state.started_at >= kStableRuntime) {
+      state.restart_delay = Clock::duration::zero();
+    } else {
+      state.restart_delay = std::clamp<Clock::duration>(
+          state.restart_delay * 2, kMinRestartDelay, kMaxRestartDelay);
+    }
+    state.restart_at = now + state.restart_delay;
+    if (state.restart_delay > Clock::duration::zero()) {
+      LOG(INFO) << "Restarting " << name << " in "
+                << std::chrono::duration_cast<std::chrono::milliseconds>(
+                       state.restart_delay)
+                       .count()
+                << "ms";
+    }
+  }
+
+  void RestartDue() {
+    auto now = Clock::now();
+    for (size_t i = 0; i < entries_.size(); i++) {
+      auto& state = states_[i];
+      if (!state.restart_at || *state.restart_at > now) {
+        continue;
+      }
+      state.restart_at.reset();
+      auto started = StartSubprocess(entries_[i]);
+      if (!started.ok()) {
+        LOG(ERROR) << "Failed to restart " << entries_[i].cmd->GetShortName()
+                   << ": " << started.error().Message();
+        entries_[i].proc.reset();
+        state.restart_delay = std::clamp<Clock::duration>(
+            state.restart_delay * 2, kMinRestartDelay, kMaxRestartDelay);
+        state.restart_at = now + state.restart_delay;
+        continue;
+      }
+      by_pid_[entries_[i].proc->pid()] = i;
+      state.started_at = now;
+      state.restarts++;
+      state.sampled_ticks = 0;
+      Watch(i);
+    }
+  }
+
+  void StopCvd() {
+    LOG(ERROR) << "Stopping all monitored processes due to unexpected exit of "
+                  "critical process";
+    Command stop_cmd(StopCvdBinary());
+    stop_cmd.Start();
+  }
+
+  // Accounts whole process groups rather than single processes, since some
+  // commands are wrappers around the process doing the actual work. Every
+  // monitored command leads its own group.
+  Result<void> SampleResourceUsage() {
+    if (resource_usage_path_.empty()) {
+      return {};
+    }
+    struct Usage {
+      uint64_t ticks = 0;
+      int64_t rss_pages = 0;
+      size_t processes = 0;
+    };
+    std::unordered_map<pid_t, Usage> by_group;
+    for (auto pid : CF_EXPECT(CollectPids())) {
+      // The process may have exited after being listed.
+      auto stat = GetProcStat(pid);
+      if (!stat.ok() || !by_pid_.count(stat->pgrp_)) {
+        continue;
+      }
+      auto& usage = by_group[stat->pgrp_];
+      usage.ticks += stat->utime_ + stat->stime_;
+      usage.rss_pages += stat->rss_;
+      usage.processes++;
+    }
+
+    auto now = Clock::now();
+    auto elapsed_s = std::chrono::duration<double>(now - last_sample_).count();
+    last_sample_ = now;
+    static const auto ticks_per_s = sysconf(_SC_CLK_TCK);
+    static const auto page_kb = sysconf(_SC_PAGESIZE) / 1024;
+
+    Json::Value processes(Json::arrayValue);
+    for (const auto& [pid, index] : by_pid_) {
+      auto& state = states_[index];
+      const auto& usage = by_group[pid];
+      auto ticks = std::max(usage.ticks, state.sampled_ticks);
+      double cpu_percent = 0;
+      if (elapsed_s > 0) {
+        cpu_percent = 100.0 * (ticks - state.sampled_ticks) / ticks_per_s /
+                      elapsed_s;
+      }
+      state.sampled_ticks = ticks;
+
+      Json::Value process;
+      process["name"] = cpp_basename(entries_[index].cmd->GetShortName());
+      process["source"] = entries_[index].source;
+      process["pid"] = pid;
+      process["processes"] = static_cast<Json::UInt64>(usage.processes);
+      process["cpu_ms"] =
+          static_cast<Json::UInt64>(usage.ticks * 1000 / ticks_per_s);
+      process["cpu_percent"] = cpu_percent;
+      process["rss_kb"] = static_cast<Json::Int64>(usage.rss_pages * page_kb);
+      process["restarts"] = static_cast<Json::UInt64>(state.restarts);
+      processes.append(process);
+    }
+    Json::Value report;
+    report["timestamp_ms"] = static_cast<Json::Int64>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch())
+            .count());
+    report["processes"] = processes;
+    // Readers must never see a partially written file.
+    auto tmp_path = resource_usage_path_ + ".tmp";
+    CF_EXPECT(android::base::WriteStringToFile(report.toStyledString(),
+                                               tmp_path),
+              "Failed to write \"" << tmp_path << "\"");
+    CF_EXPECT(RenameFile(tmp_path, resource_usage_path_));
+    return {};
+  }
+
+  std::vector<MonitorEntry>& entries_;
+  SharedFD parent_;
+  bool restart_subprocesses_;
+  std::string resource_usage_path_;
+  std::vector<State> states_;
+  std::unordered_map<pid_t, size_t> by_pid_;
+  Epoll epoll_;
+  bool pidfd_supported_ = true;
+  Clock::time_point last_sample_;
+};
+
+// Asks all the given processes to stop at the same time and reaps them within
+// a single deadline, killing those that don't exit in time. Returns the number
+// of processes that were stopped.
+size_t StopAndReap(const std::vector<MonitorEntry*>& entries) {
+  // Some stoppers block until the process acknowledges the request, e.g. the
+  // VMM one, so all of them are run concurrently.
+  std::vector<std::future<StopperResult>> stops;
+  for (auto entry : entries) {
+    stops.emplace_back(std::async(std::launch::async,
+                                  [entry]() { return entry->proc->Stop(); }));
+  }
+  std::vector<std::pair<MonitorEntry*, StopperResult>> pending;
+  for (size_t i = 0; i < entries.size(); i++) {
+    auto stop_result = stops[i].get();
+    if (stop_result == StopperResult::kStopFailure) {
+      LOG(WARNING) << "Error in stopping \"" << entries[i]->cmd->GetShortName()
+                   << "\"";
       continue;
     }
-    if (!running.load()) {  // Avoid extra restarts near the end
+    pending.emplace_back(entries[i], stop_result);
+  }
+
+  size_t stopped = 0;
+  auto deadline = Clock::now() + kStopTimeout;
+  auto delay = std::chrono::milliseconds(1);
+  while (!pending.empty()) {
+    for (auto it = pending.begin(); it != pending.end();) {
+      auto& [entry, stop_result] = *it;
+      siginfo_t infop;
+      if (entry->proc->Wait(&infop, WEXITED | WNOHANG) < 0) {
+        LOG(WARNING) << "Failed to wait for process "
+                     << entry->cmd->GetShortName();
+        it = pending.erase(it);
+        continue;
+      }
+      if (infop.si_pid == 0) {
+        ++it;
+        continue;
+      }
+      if (stop_result == StopperResult::kStopCrash) {
+        LogSubprocessExit(entry->cmd->GetShortName(), infop);
+      }
+      stopped++;
+      it = pending.erase(it);
+    }
+    if (pending.empty()) {
       break;
     }
-    auto matches = [pid](const auto& it) { return it.proc->pid() == pid; };
-    auto it = std::find_if(monitored.begin(), monitored.end(), matches);
-    if (it == monitored.end()) {
-      LogSubprocessExit("(unknown)", pid, wstatus);
-    } else {
-      LogSubprocessExit(it->cmd->GetShortName(), it->proc->pid(), wstatus);
-      if (restart_subprocesses) {
-        auto options = SubprocessOptions().InGroup(true);
-        it->proc.reset(new Subprocess(it->cmd->Start(options)));
-      } else {
-        bool is_critical = it->is_critical;
-        monitored.erase(it);
-        if (running.load() && is_critical) {
-          LOG(ERROR) << "Stopping all monitored processes due to unexpected "
-                        "exit of critical process";
-          Command stop_cmd(StopCvdBinary());
-          stop_cmd.Start();
+    if (Clock::now() >= deadline) {
+      for (auto& [entry, stop_result] : pending) {
+        LOG(WARNING) << entry->cmd->GetShortName()
+                     << " didn't exit in time, killing it";
+        KillSubprocess(entry->proc.get());
+        siginfo_t infop;
+        if (entry->proc->Wait(&infop, WEXITED) >= 0) {
+          stopped++;
         }
       }
+      break;
     }
+    std::this_thread::sleep_for(delay);
+    delay = std::min(delay * 2, kStopPollMaxPeriod);
   }
-  return {};
+  return stopped;
 }
 
+}  // namespace
+
 Result<void> StopSubprocesses(std::vector<MonitorEntry>& monitored) {
   LOG(DEBUG) << "Stopping monitored subprocesses";
-  auto stop = [](const auto& it) {
-    auto stop_result = it.proc->Stop();
-    if (stop_result == StopperResult::kStopFailure) {
-      LOG(WARNING) << "Error in stopping \"" << it.cmd->GetShortName() << "\"";
-      return false;
-    }
-    siginfo_t infop;
-    auto success = it.proc->Wait(&infop, WEXITED);
-    if (success < 0) {
-      LOG(WARNING) << "Failed to wait for process " << it.cmd->GetShortName();
-      return false;
-    }
-    if (stop_result == StopperResult::kStopCrash) {
-      LogSubprocessExit(it.cmd->GetShortName(), infop);
+  std::vector<MonitorEntry*> first;
+  std::vector<MonitorEntry*> last;
+  size_t not_started = 0;
+  for (auto& entry : monitored) {
+    if (!entry.proc) {
+      not_started++;
+    } else {
+      (entry.stop_last ? last : first).push_back(&entry);
     }
-    return true;
-  };
-  // Processes were started in the order they appear in the vector, stop them in
-  // reverse order for symmetry.
-  size_t stopped = std::count_if(monitored.rbegin(), monitored.rend(), stop);
-  CF_EXPECT(stopped == monitored.size(), "Didn't stop all subprocesses");
+  }
+  size_t stopped = StopAndReap(first);
+  // Processes consuming the output of the others must keep running until
+  // those have exited, or the last of their output would be lost.
+  stopped += StopAndReap(last);
+  CF_EXPECT(stopped + not_started == monitored.size(),
+            "Didn't stop all subprocesses");
   return {};
 }
 
-}  // namespace
-
 ProcessMonitor::Properties& ProcessMonitor::Properties::RestartSubprocesses(
     bool r) & {
   restart_subprocesses_ = r;
@@ -185,9 +642,20 @@ ProcessMonitor::Properties ProcessMonitor::Properties::RestartSubprocesses(
   return std::move(RestartSubprocesses(r));
 }
 
+ProcessMonitor::Properties& ProcessMonitor::Properties::ResourceUsagePath(
+    std::string path) & {
+  resource_usage_path_ = std::move(path);
+  return *this;
+}
+
+ProcessMonitor::Properties ProcessMonitor::Properties::ResourceUsagePath(
+    std::string path) && {
+  return std::move(ResourceUsagePath(std::move(path)));
+}
+
 ProcessMonitor::Properties& ProcessMonitor::Properties::AddCommand(
     MonitorCommand cmd) & {
-  entries_.emplace_back(std::move(cmd.command), cmd.is_critical);
+  entries_.emplace_back(std::move(cmd));
   return *this;
 }
 
@@ -254,15 +722,22 @@ Result<void> ProcessMonitor::MonitorRoutine() {
   prctl(PR_SET_PDEATHSIG, SIGHUP);  // Die when parent dies
 
   LOG(DEBUG) << "Monitoring subprocesses";
-  StartSubprocesses(properties_.entries_);
-
-  std::atomic_bool running(true);
-  auto parent_comms =
-      std::async(std::launch::async, ReadMonitorSocketLoopForStop,
-                 std::ref(running), std::ref(monitor_socket_));
+  auto started = StartSubprocesses(properties_.entries_);
+  if (!started.ok()) {
+    LOG(ERROR) << "Failed to start all subprocesses: "
+               << started.error().Message();
+    LOG(DEBUG) << started.error().Trace();
+  }
 
-  MonitorLoop(running, properties_.restart_subprocesses_, properties_.entries_);
-  CF_EXPECT(parent_comms.get(), "Should have exited if monitoring stopped");
+  Supervisor supervisor(properties_.entries_, monitor_socket_,
+                        properties_.restart_subprocesses_,
+                        properties_.resource_usage_path_);
+  auto supervised = supervisor.Run();
+  if (!supervised.ok()) {
+    LOG(ERROR) << "Supervising subprocesses failed: "
+               << supervised.error().Message();
+    LOG(DEBUG) << supervised.error().Trace();
+  }
 
   StopSubprocesses(properties_.entries_);
   LOG(DEBUG) << "Done monitoring subprocesses";
@@ -15,8 +15,10 @@
  */
 #pragma once
 
+#include <functional>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <thread>
 #include <utility>
 #include <vector>
@@ -31,13 +33,40 @@ struct MonitorEntry {
   std::unique_ptr<Command> cmd;
   std::unique_ptr<Subprocess> proc;
   bool is_critical;
+  std::string source;
+  std::vector<std::string> dependencies;
+  MonitorReadiness readiness;
+  bool stop_last;
+  std::function<Result<void>()> on_start;
 
-  MonitorEntry(Command command, bool is_critical)
-      : cmd(new Command(std::move(command))), is_critical(is_critical) {}
+  MonitorEntry(MonitorCommand command)
+      : cmd(new Command(std::move(command.command))),
+        is_critical(command.is_critical),
+        source(std::move(command.source)),
+        dependencies(std::move(command.dependencies)),
+        readiness(std::move(command.readiness)),
+        stop_last(command.stop_last),
+        on_start(std::move(command.on_start)) {}
 };
 
+// Starts the given commands, each one once the commands it depends on are
+// ready. Returns after all of them have been started.
+Result<void> StartSubprocesses(std::vector<MonitorEntry>& entries);
+// Stops and reaps the started commands, the ones marked stop_last only after
+// all the others have exited.
+Result<void> StopSubprocesses(std::vector<MonitorEntry>& entries);
+
 // Launches and keeps track of subprocesses, decides response if they
-// unexpectedly exit
+// unexpectedly exit.
+//
+// Commands are started as soon as the commands they depend on are ready, so
+// independent commands come up concurrently. On shutdown every command is
+// asked to stop at once and all of them are reaped against a single deadline.
+//
+// While running, exits are noticed through pidfds. When restarts are enabled
+// crashed commands come back with an exponential backoff and are given up on
+// if they keep crashing. The CPU time and memory used by each command is
+// sampled periodically and, if requested, written out as JSON.
 class ProcessMonitor {
  public:
   class Properties {
@@ -45,6 +74,11 @@ class ProcessMonitor {
     Properties& RestartSubprocesses(bool) &;
     Properties RestartSubprocesses(bool) &&;
 
+    // Where to periodically write the resource usage of the subprocesses.
+    // Nothing is written when empty.
+    Properties& ResourceUsagePath(std::string) &;
+    Properties ResourceUsagePath(std::string) &&;
+
     Properties& AddCommand(MonitorCommand) &;
     Properties AddCommand(MonitorCommand) &&;
 
@@ -63,6 +97,7 @@ class ProcessMonitor {
 
    private:
     bool restart_subprocesses_;
+    std::string resource_usage_path_;
     std::vector<MonitorEntry> entries_;
 
     friend class ProcessMonitor;
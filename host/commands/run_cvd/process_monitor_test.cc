@@ -0,0 +1,240 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "host/commands/run_cvd/process_monitor.h"
+
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <errno.h>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+
+#include "common/libs/utils/subprocess.h"
+#include "host/libs/config/command_source.h"
+
+namespace cuttlefish {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+class ProcessMonitorTest : public ::testing::Test {
+ protected:
+  void TearDown() override {
+    auto stopped = StopSubprocesses(entries_);
+    EXPECT_TRUE(stopped.ok()) << stopped.error().Message();
+  }
+
+  std::string Path(const std::string& name) {
+    return std::string(dir_.path) + "/" + name;
+  }
+
+  MonitorCommand Shell(const std::string& source, const std::string& script) {
+    MonitorCommand command(Command("/bin/sh").AddParameter("-c").AddParameter(
+        script));
+    command.source = source;
+    return command;
+  }
+
+  // The MonitorCommand builders return lvalue references, this takes the
+  // result of chaining them on a temporary.
+  MonitorEntry& Add(MonitorCommand& command) {
+    return entries_.emplace_back(std::move(command));
+  }
+  MonitorEntry& Add(MonitorCommand&& command) { return Add(command); }
+
+  // Waits for the entry to exit and returns its exit status, leaving it to be
+  // reaped by StopSubprocesses.
+  int ExitStatus(MonitorEntry& entry) {
+    siginfo_t infop = {};
+    EXPECT_EQ(waitid(P_PID, entry.proc->pid(), &infop, WEXITED | WNOWAIT), 0);
+    EXPECT_EQ(infop.si_code, CLD_EXITED);
+    return infop.si_status;
+  }
+
+  TemporaryDir dir_;
+  std::vector<MonitorEntry> entries_;
+  int on_start_calls_ = 0;
+};
+
+TEST_F(ProcessMonitorTest, StartsDependentAfterDependencyIsReady) {
+  Add(Shell("Server", "sleep 0.2; touch " + Path("ready") + "; exec sleep 10")
+          .ReadyWhenPathExists(Path("ready")));
+  Add(Shell("Client", "test -e " + Path("ready")).DependsOn("Server"));
+
+  auto started = StartSubprocesses(entries_);
+
+  ASSERT_TRUE(started.ok()) << started.error().Message();
+  EXPECT_EQ(ExitStatus(entries_.back()), 0);
+}
+
+TEST_F(ProcessMonitorTest, StartsDependentWhenDependencyIsReadable) {
+  SharedFD read_end, write_end;
+  ASSERT_TRUE(SharedFD::Pipe(&read_end, &write_end));
+  MonitorCommand server(Command("/bin/sh").AddParameter("-c").AddParameter(
+      "sleep 0.2; touch ", Path("ready"), "; echo >&", write_end,
+      "; exec sleep 10"));
+  server.source = "Server";
+  server.ReadyWhenReadable(read_end);
+  Add(server);
+  write_end->Close();
+  Add(Shell("Client", "test -e " + Path("ready")).DependsOn("Server"));
+
+  auto started = StartSubprocesses(entries_);
+
+  ASSERT_TRUE(started.ok()) << started.error().Message();
+  EXPECT_EQ(ExitStatus(entries_.back()), 0);
+}
+
+TEST_F(ProcessMonitorTest, StartsDependentAfterReadinessTimeout) {
+  auto server = Shell("Server", "exec sleep 10");
+  server.ReadyWhenPathExists(Path("never"));
+  server.readiness.timeout = std::chrono::milliseconds(100);
+  Add(std::move(server));
+  Add(Shell("Client", "exit 0").DependsOn("Server"));
+
+  auto start = Clock::now();
+  auto started = StartSubprocesses(entries_);
+  auto elapsed = Clock::now() - start;
+
+  ASSERT_TRUE(started.ok()) << started.error().Message();
+  EXPECT_GE(elapsed, std::chrono::milliseconds(100));
+  EXPECT_LT(elapsed, std::chrono::seconds(10));
+  ASSERT_NE(entries_.back().proc, nullptr);
+  EXPECT_EQ(ExitStatus(entries_.back()), 0);
+}
+
+TEST_F(ProcessMonitorTest, StartsDependentWhenDependencyExitsEarly) {
+  // The default 30s timeout would outlast the test if the exit went unnoticed.
+  Add(Shell("Server", "exit 3").ReadyWhenPathExists(Path("never")));
+  Add(Shell("Client", "exit 0").DependsOn("Server"));
+
+  auto start = Clock::now();
+  auto started = StartSubprocesses(entries_);
+  auto elapsed = Clock::now() - start;
+
+  ASSERT_TRUE(started.ok()) << started.error().Message();
+  EXPECT_LT(elapsed, std::chrono::seconds(10));
+  EXPECT_EQ(ExitStatus(entries_.front()), 3);
+  EXPECT_EQ(ExitStatus(entries_.back()), 0);
+}
+
+TEST_F(ProcessMonitorTest, IgnoresDisabledDependencies) {
+  Add(Shell("Client", "exit 0").DependsOn("Disabled"));
+
+  auto started = StartSubprocesses(entries_);
+
+  ASSERT_TRUE(started.ok()) << started.error().Message();
+  EXPECT_EQ(ExitStatus(entries_.back()), 0);
+}
+
+TEST_F(ProcessMonitorTest, StartsCircularDependencies) {
+  Add(Shell("First", "exec sleep 10").DependsOn("Second"));
+  Add(Shell("Second", "exec sleep 10").DependsOn("First"));
+
+  auto started = StartSubprocesses(entries_);
+
+  ASSERT_TRUE(started.ok()) << started.error().Message();
+  EXPECT_NE(entries_.front().proc, nullptr);
+  EXPECT_NE(entries_.back().proc, nullptr);
+}
+
+TEST_F(ProcessMonitorTest, RunsOnStartOnceStarted) {
+  auto& entry = Add(Shell("Collector", "exec sleep 10").OnStart([this]() {
+    // The process exists by the time the callback runs.
+    EXPECT_NE(entries_.front().proc, nullptr);
+    on_start_calls_++;
+    return Result<void>{};
+  }));
+
+  auto started = StartSubprocesses(entries_);
+
+  ASSERT_TRUE(started.ok()) << started.error().Message();
+  EXPECT_EQ(on_start_calls_, 1);
+  EXPECT_NE(entry.proc, nullptr);
+}
+
+TEST_F(ProcessMonitorTest, KeepsCommandWhenOnStartFails) {
+  Add(Shell("Collector", "exit 0").OnStart([]() -> Result<void> {
+    return CF_ERR("Failed on purpose");
+  }));
+
+  auto started = StartSubprocesses(entries_);
+
+  ASSERT_TRUE(started.ok()) << started.error().Message();
+  EXPECT_EQ(ExitStatus(entries_.back()), 0);
+}
+
+TEST_F(ProcessMonitorTest, StopsStopLastAfterTheOthersExited) {
+  // Shared with the stoppers, which outlive this scope if an assertion fails.
+  struct StopLog {
+    std::mutex mutex;
+    std::vector<std::string> order;
+    std::vector<pid_t> others;
+    bool others_reaped_first = true;
+  };
+  auto log = std::make_shared<StopLog>();
+
+  auto collector = Shell("Collector", "exec sleep 10");
+  collector.StopLast();
+  collector.command.SetStopper([log](Subprocess* proc) {
+    std::lock_guard lock(log->mutex);
+    log->order.push_back("Collector");
+    for (auto pid : log->others) {
+      siginfo_t infop;
+      // Fails with ECHILD only once the process has been reaped.
+      if (waitid(P_PID, pid, &infop, WEXITED | WNOHANG | WNOWAIT) != -1 ||
+          errno != ECHILD) {
+        log->others_reaped_first = false;
+      }
+    }
+    return KillSubprocess(proc);
+  });
+  Add(collector);
+  for (std::string name : {"First", "Second"}) {
+    auto command = Shell(name, "exec sleep 10");
+    command.command.SetStopper([log, name](Subprocess* proc) {
+      std::lock_guard lock(log->mutex);
+      log->order.push_back(name);
+      return KillSubprocess(proc);
+    });
+    Add(command);
+  }
+
+  auto started = StartSubprocesses(entries_);
+  ASSERT_TRUE(started.ok()) << started.error().Message();
+  {
+    std::lock_guard lock(log->mutex);
+    log->others = {entries_[1].proc->pid(), entries_[2].proc->pid()};
+  }
+  auto stopped = StopSubprocesses(entries_);
+  entries_.clear();
+
+  ASSERT_TRUE(stopped.ok()) << stopped.error().Message();
+  ASSERT_EQ(log->order.size(), 3);
+  EXPECT_EQ(log->order.back(), "Collector");
+  EXPECT_TRUE(log->others_reaped_first);
+}
+
+}  // namespace
+}  // namespace cuttlefish
@@ -75,10 +75,15 @@ class ServerLoopImpl : public ServerLoop,
     ProcessMonitor::Properties process_monitor_properties;
     process_monitor_properties.RestartSubprocesses(
         instance_.restart_subprocesses());
+    process_monitor_properties.ResourceUsagePath(
+        instance_.PerInstanceLogPath("process_resource_usage.json"));
 
     for (auto& command_source : command_sources_) {
       if (command_source->Enabled()) {
         auto commands = CF_EXPECT(command_source->Commands());
+        for (auto& command : commands) {
+          command.source = command_source->Name();
+        }
         process_monitor_properties.AddCommands(std::move(commands));
       }
     }
@@ -45,6 +45,7 @@
 #include "host/commands/secure_env/rust/kmr_ta.h"
 #include "host/commands/secure_env/soft_gatekeeper.h"
 #include "host/commands/secure_env/storage/insecure_json_storage.h"
+#include "host/commands/secure_env/storage/log_structured_storage.h"
 #include "host/commands/secure_env/storage/storage.h"
 #include "host/commands/secure_env/tpm_gatekeeper.h"
 #include "host/commands/secure_env/tpm_keymaster_context.h"
@@ -77,7 +78,8 @@ DEFINE_string(gatekeeper_impl, "tpm",
               "The gatekeeper implementation. \"tpm\" or \"software\"");
 
 DEFINE_string(oemlock_impl, "software",
-              "The oemlock implementation. \"tpm\" or \"software\"");
+              "The oemlock implementation. \"tpm\", \"software\" or "
+              "\"software_log\"");
 
 namespace cuttlefish {
 namespace {
@@ -156,6 +158,15 @@ fruit::Component<secure_env::Storage, oemlock::OemLock> ChooseOemlockComponent()
       .registerProvider([]() -> secure_env::Storage* {
         if (FLAGS_oemlock_impl == "software") {
           return new secure_env::InsecureJsonStorage("oemlock_insecure");
+        } else if (FLAGS_oemlock_impl == "software_log") {
+          auto storage =
+              secure_env::LogStructuredStorage::Open("oemlock_insecure.log");
+          if (!storage.ok()) {
+            LOG(FATAL) << "Failed to open oemlock storage: "
+                       << storage.error().Message();
+            abort();
+          }
+          return storage->release();
         } else if (FLAGS_oemlock_impl == "tpm") {
           LOG(FATAL) << "Oemlock doesn't support TPM implementation";
           abort();
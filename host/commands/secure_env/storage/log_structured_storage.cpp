@@ -0,0 +1,381 @@
+//
+// Copyright (C) 2023 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "host/commands/secure_env/storage/log_structured_storage.h"
+
+#include <fcntl.h>
+
+#include <array>
+#include <cstring>
+#include <utility>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+
+#include "common/libs/fs/shared_buf.h"
+#include "common/libs/utils/files.h"
+#include "common/libs/utils/scope_guard.h"
+#include "keymaster/android_keymaster_utils.h"
+
+namespace cuttlefish {
+namespace secure_env {
+namespace {
+
+constexpr uint32_t kLogMagic = 0x534c4643;  // "CFLS"
+constexpr uint32_t kLogVersion = 1;
+constexpr size_t kLogHeaderSize = 2 * sizeof(uint32_t);
+// Compaction writes the new log in chunks of about this size.
+constexpr size_t kCompactionChunkSize = 1024 * 1024;
+
+struct RecordHeader {
+  // CRC-32 of the sizes, the key and the value.
+  uint32_t checksum;
+  uint32_t key_size;
+  uint32_t value_size;
+};
+
+constexpr std::array<uint32_t, 256> Crc32Table() {
+  std::array<uint32_t, 256> table{};
+  for (uint32_t i = 0; i < 256; i++) {
+    uint32_t crc = i;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320u : 0);
+    }
+    table[i] = crc;
+  }
+  return table;
+}
+
+uint32_t Crc32(uint32_t crc, const void* data, size_t size) {
+  static constexpr auto kTable = Crc32Table();
+  auto bytes = static_cast<const uint8_t*>(data);
+  crc = ~crc;
+  for (size_t i = 0; i < size; i++) {
+    crc = kTable[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+uint32_t RecordChecksum(std::string_view key, const void* value,
+                        uint32_t value_size) {
+  uint32_t sizes[2] = {static_cast<uint32_t>(key.size()), value_size};
+  uint32_t crc = Crc32(0, sizes, sizeof(sizes));
+  crc = Crc32(crc, key.data(), key.size());
+  return Crc32(crc, value, value_size);
+}
+
+uint64_t RecordSize(size_t key_size, uint32_t value_size) {
+  return sizeof(RecordHeader) + key_size + value_size;
+}
+
+void AppendRecord(std::string& out, std::string_view key, const void* value,
+                  uint32_t value_size) {
+  RecordHeader header = {
+      .checksum = RecordChecksum(key, value, value_size),
+      .key_size = static_cast<uint32_t>(key.size()),
+      .value_size = value_size,
+  };
+  out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.append(key);
+  out.append(static_cast<const char*>(value), value_size);
+}
+
+std::string LogHeader() {
+  uint32_t header[2] = {kLogMagic, kLogVersion};
+  return std::string(reinterpret_cast<const char*>(header), sizeof(header));
+}
+
+void Wipe(std::string& buffer) {
+  keymaster::Eraser(buffer.data(), buffer.size());
+  buffer.clear();
+}
+
+// Calls `on_record` with the key, value location and size of each complete
+// and intact record in `data`, which starts at `offset` in the log. Returns
+// the offset right after the last such record.
+template <typename F>
+uint64_t ScanRecords(std::string_view data, uint64_t offset, F on_record) {
+  size_t pos = 0;
+  while (data.size() - pos >= sizeof(RecordHeader)) {
+    RecordHeader header;
+    memcpy(&header, data.data() + pos, sizeof(header));
+    auto record_size = RecordSize(header.key_size, header.value_size);
+    if (record_size > data.size() - pos) {
+      break;
+    }
+    auto key = data.substr(pos + sizeof(header), header.key_size);
+    auto value = key.data() + key.size();
+    if (RecordChecksum(key, value, header.value_size) != header.checksum) {
+      break;
+    }
+    on_record(key,
+              offset + pos + sizeof(header) + header.key_size,
+              header.value_size);
+    pos += record_size;
+  }
+  return offset + pos;
+}
+
+}  // namespace
+
+Result<std::unique_ptr<LogStructuredStorage>> LogStructuredStorage::Open(
+    std::string path, LogStorageOptions options) {
+  std::unique_ptr<LogStructuredStorage> storage(
+      new LogStructuredStorage(std::move(path), options));
+  CF_EXPECT(storage->Recover());
+  return storage;
+}
+
+LogStructuredStorage::LogStructuredStorage(std::string path,
+                                           LogStorageOptions options)
+    : path_(std::move(path)), options_(options) {}
+
+LogStructuredStorage::~LogStructuredStorage() { WaitForCompaction(); }
+
+Result<void> LogStructuredStorage::Recover() {
+  // A compaction interrupted before its rename leaves the old log intact.
+  if (FileExists(path_ + ".compact")) {
+    RemoveFile(path_ + ".compact");
+  }
+
+  log_ = SharedFD::Open(path_, O_CREAT | O_RDWR | O_APPEND, 0600);
+  CF_EXPECT(log_->IsOpen(),
+            "Failed to open \"" << path_ << "\": " << log_->StrError());
+  std::string contents;
+  CF_EXPECT(android::base::ReadFileToString(path_, &contents),
+            "Failed to read \"" << path_ << "\"");
+  ScopeGuard wipe_contents([&contents]() { Wipe(contents); });
+
+  if (contents.size() < kLogHeaderSize) {
+    // Either new or torn while writing the header, so nothing was stored.
+    CF_EXPECT(log_->Truncate(0) == 0, log_->StrError());
+    auto header = LogHeader();
+    CF_EXPECT(WriteAll(log_, header) == header.size(),
+              "Failed to write \"" << path_ << "\": " << log_->StrError());
+    CF_EXPECT(log_->Fdatasync() == 0, log_->StrError());
+    log_size_ = header.size();
+    return {};
+  }
+  CF_EXPECT(contents.compare(0, kLogHeaderSize, LogHeader()) == 0,
+            "\"" << path_ << "\" is not a storage log");
+
+  std::string_view records(contents);
+  records.remove_prefix(kLogHeaderSize);
+  log_size_ = ScanRecords(
+      records, kLogHeaderSize,
+      [this](std::string_view key, uint64_t offset, uint32_t size) {
+        auto [it, inserted] =
+            index_.try_emplace(std::string(key), ValueLocation{offset, size});
+        if (!inserted) {
+          garbage_bytes_ += RecordSize(key.size(), it->second.size);
+          it->second = ValueLocation{offset, size};
+        }
+      });
+  if (log_size_ < contents.size()) {
+    LOG(WARNING) << "Dropping " << contents.size() - log_size_
+                 << " bytes of incomplete records at the end of " << path_;
+    CF_EXPECT(log_->Truncate(log_size_) == 0, log_->StrError());
+    CF_EXPECT(log_->Fdatasync() == 0, log_->StrError());
+  }
+  return {};
+}
+
+Result<bool> LogStructuredStorage::HasKey(const std::string& key) const {
+  std::lock_guard lock(mutex_);
+  return index_.count(key) > 0;
+}
+
+Result<ManagedStorageData> LogStructuredStorage::Read(
+    const std::string& key) const {
+  std::lock_guard lock(mutex_);
+  auto it = index_.find(key);
+  CF_EXPECT(it != index_.end(), "Key: " << key << " not found in " << path_);
+  const auto& location = it->second;
+  auto data = CF_EXPECT(CreateStorageData(location.size));
+  auto read = log_->PRead(data->payload, location.size, location.offset);
+  CF_EXPECT(read == location.size, "Failed to read key " << key << " from "
+                                                         << path_ << ": "
+                                                         << log_->StrError());
+  return data;
+}
+
+Result<void> LogStructuredStorage::Write(const std::string& key,
+                                         const StorageData& data) {
+  std::string record;
+  AppendRecord(record, key, data.payload, data.size);
+  ScopeGuard wipe_record([&record]() { Wipe(record); });
+
+  std::lock_guard lock(mutex_);
+  if (WriteAll(log_, record) != record.size() || log_->Fdatasync() != 0) {
+    auto error = log_->StrError();
+    // Leave no partial record behind for the next write to follow.
+    log_->Truncate(log_size_);
+    return CF_ERR("Failed to append to \"" << path_ << "\": " << error);
+  }
+  ValueLocation location = {
+      .offset = log_size_ + sizeof(RecordHeader) + key.size(),
+      .size = data.size,
+  };
+  auto [it, inserted] = index_.try_emplace(key, location);
+  if (!inserted) {
+    garbage_bytes_ += RecordSize(key.size(), it->second.size);
+    it->second = location;
+  }
+  log_size_ += record.size();
+  MaybeStartCompaction();
+  return {};
+}
+
+bool LogStructuredStorage::Exists() const {
+  std::lock_guard lock(mutex_);
+  return !index_.empty();
+}
+
+LogStorageStats LogStructuredStorage::stats() const {
+  std::lock_guard lock(mutex_);
+  return LogStorageStats{
+      .log_size = log_size_,
+      .garbage_bytes = garbage_bytes_,
+      .compactions = compactions_,
+  };
+}
+
+void LogStructuredStorage::WaitForCompaction() {
+  std::thread thread;
+  {
+    std::lock_guard lock(mutex_);
+    thread = std::move(compaction_thread_);
+  }
+  if (thread.joinable()) {
+    thread.join();
+  }
+}
+
+void LogStructuredStorage::MaybeStartCompaction() {
+  if (compacting_ || garbage_bytes_ < options_.compaction_min_garbage ||
+      garbage_bytes_ < log_size_ - garbage_bytes_) {
+    return;
+  }
+  if (compaction_thread_.joinable()) {
+    // Already done, as compacting_ is false.
+    compaction_thread_.join();
+  }
+  compacting_ = true;
+  compaction_thread_ = std::thread([this]() {
+    auto compacted = Compact();
+    if (!compacted.ok()) {
+      LOG(ERROR) << "Failed to compact " << path_ << ": "
+                 << compacted.error().Message();
+      LOG(DEBUG) << compacted.error().Trace();
+    }
+    std::lock_guard lock(mutex_);
+    compacting_ = false;
+  });
+}
+
+Result<void> LogStructuredStorage::Compact() {
+  Index live;
+  uint64_t live_end;
+  {
+    std::lock_guard lock(mutex_);
+    live = index_;
+    live_end = log_size_;
+  }
+  auto reader = SharedFD::Open(path_, O_RDONLY);
+  CF_EXPECT(reader->IsOpen(),
+            "Failed to open \"" << path_ << "\": " << reader->StrError());
+  auto tmp_path = path_ + ".compact";
+  auto out =
+      SharedFD::Open(tmp_path, O_CREAT | O_TRUNC | O_RDWR | O_APPEND, 0600);
+  CF_EXPECT(out->IsOpen(),
+            "Failed to open \"" << tmp_path << "\": " << out->StrError());
+  ScopeGuard remove_tmp([&tmp_path]() { RemoveFile(tmp_path); });
+
+  // Copy the records that were live when compaction started. Writes can go
+  // on in the meantime since the old log is only appended to.
+  Index compacted;
+  uint64_t out_size = 0;
+  std::string buffer = LogHeader();
+  ScopeGuard wipe_buffer([&buffer]() { Wipe(buffer); });
+  std::string value;
+  ScopeGuard wipe_value([&value]() { Wipe(value); });
+  for (const auto& [key, location] : live) {
+    value.resize(location.size);
+    CF_EXPECT(reader->PRead(value.data(), value.size(), location.offset) ==
+                  location.size,
+              "Failed to read \"" << path_ << "\": " << reader->StrError());
+    compacted[key] = ValueLocation{
+        .offset = out_size + buffer.size() + sizeof(RecordHeader) + key.size(),
+        .size = location.size,
+    };
+    AppendRecord(buffer, key, value.data(), value.size());
+    if (buffer.size() >= kCompactionChunkSize) {
+      CF_EXPECT(WriteAll(out, buffer) == buffer.size(),
+                "Failed to write \"" << tmp_path << "\": " << out->StrError());
+      out_size += buffer.size();
+      Wipe(buffer);
+    }
+  }
+  CF_EXPECT(WriteAll(out, buffer) == buffer.size(),
+            "Failed to write \"" << tmp_path << "\": " << out->StrError());
+  out_size += buffer.size();
+  Wipe(buffer);
+
+  std::lock_guard lock(mutex_);
+  // Bring over whatever was written after the copy started.
+  uint64_t garbage = 0;
+  if (log_size_ > live_end) {
+    buffer.resize(log_size_ - live_end);
+    CF_EXPECT(reader->PRead(buffer.data(), buffer.size(), live_end) ==
+                  static_cast<ssize_t>(buffer.size()),
+              "Failed to read \"" << path_ << "\": " << reader->StrError());
+    auto end = ScanRecords(
+        buffer, out_size,
+        [&compacted, &garbage](std::string_view key, uint64_t offset,
+                               uint32_t size) {
+          auto [it, inserted] = compacted.try_emplace(
+              std::string(key), ValueLocation{offset, size});
+          if (!inserted) {
+            garbage += RecordSize(key.size(), it->second.size);
+            it->second = ValueLocation{offset, size};
+          }
+        });
+    CF_EXPECT(end == out_size + buffer.size(),
+              "Found invalid records at the end of \"" << path_ << "\"");
+    CF_EXPECT(WriteAll(out, buffer) == buffer.size(),
+              "Failed to write \"" << tmp_path << "\": " << out->StrError());
+    out_size += buffer.size();
+  }
+  CF_EXPECT(out->Fdatasync() == 0,
+            "Failed to sync \"" << tmp_path << "\": " << out->StrError());
+  CF_EXPECT(RenameFile(tmp_path, path_));
+  remove_tmp.Cancel();
+  // Make the rename itself durable.
+  auto dir = SharedFD::Open(cpp_dirname(path_), O_RDONLY | O_DIRECTORY);
+  if (!dir->IsOpen() || dir->Fdatasync() != 0) {
+    LOG(WARNING) << "Failed to sync the directory of " << path_ << ": "
+                 << dir->StrError();
+  }
+
+  log_ = out;
+  log_size_ = out_size;
+  index_ = std::move(compacted);
+  garbage_bytes_ = garbage;
+  compactions_++;
+  return {};
+}
+
+}  // namespace secure_env
+}  // namespace cuttlefish
@@ -0,0 +1,100 @@
+//
+// Copyright (C) 2023 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+#include "common/libs/fs/shared_fd.h"
+#include "host/commands/secure_env/storage/storage.h"
+
+namespace cuttlefish {
+namespace secure_env {
+
+struct LogStorageOptions {
+  // The log is compacted once overwritten records take at least this many
+  // bytes and at least as many bytes as the live records.
+  uint64_t compaction_min_garbage = 64 * 1024;
+};
+
+struct LogStorageStats {
+  uint64_t log_size;
+  uint64_t garbage_bytes;
+  uint64_t compactions;
+};
+
+/**
+ * Storage keeping every write as a record appended to a log file, with an
+ * in-memory index from keys to the latest value in the log. Reads are a
+ * single pread and writes a single append followed by fdatasync, instead of
+ * rewriting the whole file.
+ *
+ * Each record carries a checksum. When opening the log, records after the
+ * first torn or corrupted one, which can only come from a crash in the middle
+ * of a write, are dropped. Once overwritten records make up most of the file
+ * the live ones are copied to a new log on a background thread, which then
+ * replaces the old one with a rename.
+ *
+ * Like InsecureJsonStorage, values are stored unencrypted.
+ */
+class LogStructuredStorage : public secure_env::Storage {
+ public:
+  static Result<std::unique_ptr<LogStructuredStorage>> Open(
+      std::string path, LogStorageOptions options = {});
+  ~LogStructuredStorage() override;
+
+  Result<bool> HasKey(const std::string& key) const override;
+  Result<ManagedStorageData> Read(const std::string& key) const override;
+  Result<void> Write(const std::string& key, const StorageData& data) override;
+  bool Exists() const override;
+
+  LogStorageStats stats() const;
+  // Blocks until the running compaction, if any, is done.
+  void WaitForCompaction();
+
+ private:
+  struct ValueLocation {
+    uint64_t offset;
+    uint32_t size;
+  };
+  using Index = std::unordered_map<std::string, ValueLocation>;
+
+  LogStructuredStorage(std::string path, LogStorageOptions options);
+
+  Result<void> Recover();
+  void MaybeStartCompaction();
+  Result<void> Compact();
+
+  const std::string path_;
+  const LogStorageOptions options_;
+
+  mutable std::mutex mutex_;
+  SharedFD log_;
+  uint64_t log_size_ = 0;
+  Index index_;
+  uint64_t garbage_bytes_ = 0;
+  uint64_t compactions_ = 0;
+  bool compacting_ = false;
+  std::thread compaction_thread_;
+};
+
+}  // namespace secure_env
+}  // namespace cuttlefish
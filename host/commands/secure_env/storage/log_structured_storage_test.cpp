@@ -0,0 +1,168 @@
+//
+// Copyright (C) 2023 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "host/commands/secure_env/storage/log_structured_storage.h"
+
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+
+namespace cuttlefish {
+namespace secure_env {
+namespace {
+
+class LogStructuredStorageTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    char dir_template[] = "/tmp/log_storage_XXXXXX";
+    ASSERT_NE(mkdtemp(dir_template), nullptr);
+    dir_ = dir_template;
+    path_ = dir_ + "/storage.log";
+  }
+
+  void TearDown() override {
+    unlink(path_.c_str());
+    rmdir(dir_.c_str());
+  }
+
+  std::unique_ptr<LogStructuredStorage> Open(LogStorageOptions options = {}) {
+    auto storage = LogStructuredStorage::Open(path_, options);
+    EXPECT_TRUE(storage.ok()) << storage.error().Trace();
+    return storage.ok() ? std::move(*storage) : nullptr;
+  }
+
+  static void Write(Storage& storage, const std::string& key,
+                    const std::string& value) {
+    auto data = CreateStorageData(value.data(), value.size());
+    ASSERT_TRUE(data.ok()) << data.error().Trace();
+    auto written = storage.Write(key, **data);
+    ASSERT_TRUE(written.ok()) << written.error().Trace();
+  }
+
+  static std::string Read(const Storage& storage, const std::string& key) {
+    auto data = storage.Read(key);
+    if (!data.ok()) {
+      return "<" + data.error().Message() + ">";
+    }
+    return std::string(reinterpret_cast<const char*>((*data)->payload),
+                       (*data)->size);
+  }
+
+  off_t FileSize() {
+    struct stat st;
+    EXPECT_EQ(stat(path_.c_str(), &st), 0);
+    return st.st_size;
+  }
+
+  std::string dir_;
+  std::string path_;
+};
+
+TEST_F(LogStructuredStorageTest, ReadsBackWrites) {
+  auto storage = Open();
+  ASSERT_NE(storage, nullptr);
+  EXPECT_FALSE(storage->Exists());
+  EXPECT_FALSE(*storage->HasKey("a"));
+  EXPECT_FALSE(storage->Read("a").ok());
+
+  Write(*storage, "a", "first");
+  Write(*storage, "b", "");
+  Write(*storage, "a", "second");
+
+  EXPECT_TRUE(storage->Exists());
+  EXPECT_TRUE(*storage->HasKey("a"));
+  EXPECT_TRUE(*storage->HasKey("b"));
+  EXPECT_EQ(Read(*storage, "a"), "second");
+  EXPECT_EQ(Read(*storage, "b"), "");
+  EXPECT_GT(storage->stats().garbage_bytes, 0);
+}
+
+TEST_F(LogStructuredStorageTest, RecoversAfterReopen) {
+  {
+    auto storage = Open();
+    ASSERT_NE(storage, nullptr);
+    Write(*storage, "a", "first");
+    Write(*storage, "b", "other");
+    Write(*storage, "a", "second");
+  }
+  auto storage = Open();
+  ASSERT_NE(storage, nullptr);
+  EXPECT_EQ(Read(*storage, "a"), "second");
+  EXPECT_EQ(Read(*storage, "b"), "other");
+  EXPECT_GT(storage->stats().garbage_bytes, 0);
+}
+
+TEST_F(LogStructuredStorageTest, DropsTornTail) {
+  off_t intact_size;
+  {
+    auto storage = Open();
+    ASSERT_NE(storage, nullptr);
+    Write(*storage, "a", "kept");
+    intact_size = FileSize();
+    Write(*storage, "a", "lost in a crash");
+  }
+  ASSERT_EQ(truncate(path_.c_str(), FileSize() - 3), 0);
+
+  auto storage = Open();
+  ASSERT_NE(storage, nullptr);
+  EXPECT_EQ(Read(*storage, "a"), "kept");
+  EXPECT_EQ(FileSize(), intact_size);
+
+  Write(*storage, "a", "new");
+  storage.reset();
+  storage = Open();
+  ASSERT_NE(storage, nullptr);
+  EXPECT_EQ(Read(*storage, "a"), "new");
+}
+
+TEST_F(LogStructuredStorageTest, RejectsOtherFiles) {
+  ASSERT_TRUE(android::base::WriteStringToFile("{\"key\": \"json\"}", path_));
+
+  EXPECT_FALSE(LogStructuredStorage::Open(path_).ok());
+}
+
+TEST_F(LogStructuredStorageTest, CompactionKeepsLatestValues) {
+  auto storage = Open({.compaction_min_garbage = 1024});
+  ASSERT_NE(storage, nullptr);
+  for (int i = 0; i < 200; i++) {
+    Write(*storage, "key_" + std::to_string(i % 10), std::to_string(i));
+  }
+  storage->WaitForCompaction();
+
+  auto stats = storage->stats();
+  EXPECT_GT(stats.compactions, 0);
+  EXPECT_EQ(stats.log_size, FileSize());
+  for (int i = 0; i < 10; i++) {
+    EXPECT_EQ(Read(*storage, "key_" + std::to_string(i)),
+              std::to_string(190 + i));
+  }
+
+  storage.reset();
+  storage = Open();
+  ASSERT_NE(storage, nullptr);
+  for (int i = 0; i < 10; i++) {
+    EXPECT_EQ(Read(*storage, "key_" + std::to_string(i)),
+              std::to_string(190 + i));
+  }
+}
+
+}  // namespace
+}  // namespace secure_env
+}  // namespace cuttlefish
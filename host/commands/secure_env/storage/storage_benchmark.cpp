@@ -0,0 +1,123 @@
+//
+// Copyright (C) 2023 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+
+#include <android-base/logging.h>
+#include <benchmark/benchmark.h>
+
+#include "host/commands/secure_env/storage/insecure_json_storage.h"
+#include "host/commands/secure_env/storage/log_structured_storage.h"
+
+namespace cuttlefish {
+namespace secure_env {
+namespace {
+
+// Roughly the size of a gatekeeper failure record or an oemlock flag set.
+constexpr size_t kValueSize = 64;
+
+class TempDir {
+ public:
+  TempDir() {
+    char dir_template[] = "/tmp/storage_benchmark_XXXXXX";
+    CHECK(mkdtemp(dir_template) != nullptr) << "Failed to create a temp dir";
+    path_ = dir_template;
+  }
+  ~TempDir() {
+    for (const auto& file : {"json", "log", "log.compact"}) {
+      unlink((path_ + "/" + file).c_str());
+    }
+    rmdir(path_.c_str());
+  }
+
+  const std::string& path() const { return path_; }
+
+ private:
+  std::string path_;
+};
+
+std::unique_ptr<Storage> OpenStorage(const TempDir& dir, bool log) {
+  if (!log) {
+    return std::make_unique<InsecureJsonStorage>(dir.path() + "/json");
+  }
+  auto storage = LogStructuredStorage::Open(dir.path() + "/log");
+  CHECK(storage.ok()) << storage.error().Message();
+  return std::move(*storage);
+}
+
+std::string Key(int64_t index) { return "key_" + std::to_string(index); }
+
+ManagedStorageData Value() {
+  auto data = CreateStorageData(kValueSize);
+  CHECK(data.ok()) << data.error().Message();
+  return std::move(*data);
+}
+
+// Overwrites one of `keys` values per iteration. The second argument selects
+// the backend: 0 for InsecureJsonStorage and 1 for LogStructuredStorage.
+void BM_Write(benchmark::State& state) {
+  const int64_t keys = state.range(0);
+  android::base::SetMinimumLogSeverity(android::base::WARNING);
+  TempDir dir;
+  auto storage = OpenStorage(dir, state.range(1));
+  auto value = Value();
+  for (int64_t i = 0; i < keys; i++) {
+    CHECK(storage->Write(Key(i), *value).ok());
+  }
+
+  int64_t next = 0;
+  for (auto _ : state) {
+    auto written = storage->Write(Key(next++ % keys), *value);
+    benchmark::DoNotOptimize(written);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Reads one of `keys` values per iteration, with the same arguments as
+// BM_Write.
+void BM_Read(benchmark::State& state) {
+  const int64_t keys = state.range(0);
+  android::base::SetMinimumLogSeverity(android::base::WARNING);
+  TempDir dir;
+  auto storage = OpenStorage(dir, state.range(1));
+  auto value = Value();
+  for (int64_t i = 0; i < keys; i++) {
+    CHECK(storage->Write(Key(i), *value).ok());
+  }
+
+  int64_t next = 0;
+  for (auto _ : state) {
+    auto read = storage->Read(Key(next++ % keys));
+    benchmark::DoNotOptimize(read);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_Write)
+    ->ArgNames({"keys", "log"})
+    ->ArgsProduct({{1, 64, 1024}, {0, 1}});
+BENCHMARK(BM_Read)
+    ->ArgNames({"keys", "log"})
+    ->ArgsProduct({{1, 64, 1024}, {0, 1}});
+
+}  // namespace
+}  // namespace secure_env
+}  // namespace cuttlefish
+
+BENCHMARK_MAIN();
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "host/frontend/webrtc/audio_frame_ring.h"
+
+#include <algorithm>
+
+#include <android-base/logging.h>
+
+namespace cuttlefish {
+
+void AudioFrameRing::Frame::SetFormat(int bits_per_sample, int sample_rate,
+                                      int channels) {
+  if (bits_per_sample == bits_per_sample_ && sample_rate == sample_rate_ &&
+      channels == channels_) {
+    return;
+  }
+  bits_per_sample_ = bits_per_sample;
+  sample_rate_ = sample_rate;
+  channels_ = channels;
+  // Shrinking or growing back to a previous size doesn't reallocate.
+  data_.resize((channels * (sample_rate / 100) * bits_per_sample) / 8);
+  filled_ = 0;
+}
+
+size_t AudioFrameRing::Frame::Fill(const volatile uint8_t* data, size_t len) {
+  auto copied = std::min(len, data_.size() - filled_);
+  std::copy(data, data + copied, data_.begin() + filled_);
+  filled_ += copied;
+  return copied;
+}
+
+AudioFrameRing::AudioFrameRing(size_t capacity) {
+  CHECK(capacity > 0) << "Audio frame ring can't be empty";
+  frames_.reserve(capacity);
+  for (size_t i = 0; i < capacity; i++) {
+    frames_.emplace_back(std::make_shared<Frame>());
+  }
+}
+
+AudioFrameRing::Frame* AudioFrameRing::WritableFrame() {
+  auto pushed = pushed_.load(std::memory_order_relaxed);
+  if (pushed - popped_.load(std::memory_order_acquire) == frames_.size()) {
+    return nullptr;
+  }
+  return frames_[pushed % frames_.size()].get();
+}
+
+void AudioFrameRing::Push() {
+  auto pushed = pushed_.load(std::memory_order_relaxed);
+  frames_[pushed % frames_.size()]->filled_ = 0;
+  pushed_.store(pushed + 1, std::memory_order_release);
+}
+
+const std::shared_ptr<AudioFrameRing::Frame>* AudioFrameRing::ReadableFrame()
+    const {
+  auto popped = popped_.load(std::memory_order_relaxed);
+  if (pushed_.load(std::memory_order_acquire) == popped) {
+    return nullptr;
+  }
+  return &frames_[popped % frames_.size()];
+}
+
+void AudioFrameRing::Pop() {
+  popped_.fetch_add(1, std::memory_order_release);
+}
+
+size_t AudioFrameRing::size() const {
+  return pushed_.load(std::memory_order_acquire) -
+         popped_.load(std::memory_order_acquire);
+}
+
+}  // namespace cuttlefish
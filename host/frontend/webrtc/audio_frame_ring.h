@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "host/frontend/webrtc/libdevice/audio_frame_buffer.h"
+
+namespace cuttlefish {
+
+// Lock-free single producer, single consumer queue of 10ms audio frames. All
+// frames are allocated up front and reused, so once every frame has been used
+// with the largest format of the stream no more allocations happen.
+class AudioFrameRing {
+ public:
+  class Frame : public webrtc_streaming::AudioFrameBuffer {
+   public:
+    int bits_per_sample() const override { return bits_per_sample_; }
+    int sample_rate() const override { return sample_rate_; }
+    int channels() const override { return channels_; }
+    int frames() const override { return sample_rate_ / 100; }
+    const uint8_t* data() const override { return data_.data(); }
+
+    // Discards any contents if the format differs from the current one.
+    void SetFormat(int bits_per_sample, int sample_rate, int channels);
+    // Copies as many bytes as fit in the frame, returns how many were copied.
+    size_t Fill(const volatile uint8_t* data, size_t len);
+
+    size_t size() const { return data_.size(); }
+    size_t filled() const { return filled_; }
+    bool full() const { return filled_ == data_.size(); }
+
+   private:
+    friend class AudioFrameRing;
+
+    int bits_per_sample_ = 0;
+    int sample_rate_ = 0;
+    int channels_ = 0;
+    std::vector<uint8_t> data_;
+    size_t filled_ = 0;
+  };
+
+  explicit AudioFrameRing(size_t capacity);
+
+  // Producer side. Returns the frame being filled or nullptr if the ring is
+  // full. The same frame is returned until it's pushed.
+  Frame* WritableFrame();
+  void Push();
+
+  // Consumer side. Returns the oldest pushed frame or nullptr if the ring is
+  // empty. The frame must not be used after it's popped.
+  const std::shared_ptr<Frame>* ReadableFrame() const;
+  void Pop();
+
+  // Number of pushed frames not popped yet.
+  size_t size() const;
+  size_t capacity() const { return frames_.size(); }
+
+ private:
+  std::vector<std::shared_ptr<Frame>> frames_;
+  // Monotonic counters of the frames pushed and popped, each written by one
+  // side only. Kept on separate cache lines to avoid false sharing.
+  alignas(64) std::atomic<uint64_t> pushed_{0};
+  alignas(64) std::atomic<uint64_t> popped_{0};
+};
+
+}  // namespace cuttlefish
@@ -126,34 +126,6 @@ bool IsCapture(uint32_t stream_id) {
          (uint8_t)AudioStreamDirection::VIRTIO_SND_D_INPUT;
 }
 
-class CvdAudioFrameBuffer : public webrtc_streaming::AudioFrameBuffer {
- public:
-  CvdAudioFrameBuffer(const uint8_t* buffer, int bits_per_sample,
-                      int sample_rate, int channels, int frames)
-      : buffer_(buffer),
-        bits_per_sample_(bits_per_sample),
-        sample_rate_(sample_rate),
-        channels_(channels),
-        frames_(frames) {}
-
-  int bits_per_sample() const override { return bits_per_sample_; }
-
-  int sample_rate() const override { return sample_rate_; }
-
-  int channels() const override { return channels_; }
-
-  int frames() const override { return frames_; }
-
-  const uint8_t* data() const override { return buffer_; }
-
- private:
-  const uint8_t* buffer_;
-  int bits_per_sample_;
-  int sample_rate_;
-  int channels_;
-  int frames_;
-};
-
 int BitsPerSample(uint8_t virtio_format) {
   switch (virtio_format) {
     /* analog formats (width / physical width) */
@@ -288,6 +260,7 @@ AudioHandler::AudioHandler(
 
 void AudioHandler::Start() {
   server_thread_ = std::thread([this]() { Loop(); });
+  playback_thread_ = std::thread([this]() { PlaybackLoop(); });
 }
 
 [[noreturn]] void AudioHandler::Loop() {
@@ -408,15 +381,17 @@ void AudioHandler::JacksInfo(JackInfoCommand& cmd) {
 
 void AudioHandler::OnPlaybackBuffer(TxBuffer buffer) {
   auto stream_id = buffer.stream_id();
+  // Invalid or capture streams shouldn't send tx buffers
+  if (stream_id >= NUM_STREAMS || IsCapture(stream_id)) {
+    buffer.SendStatus(AudioStatus::VIRTIO_SND_S_BAD_MSG, 0, 0);
+    return;
+  }
   auto& stream_desc = stream_descs_[stream_id];
+  int bits_per_sample;
+  int sample_rate;
+  int channels;
   {
     std::lock_guard<std::mutex> lock(stream_desc.mtx);
-    auto& holding_buffer = stream_descs_[stream_id].buffer;
-    // Invalid or capture streams shouldn't send tx buffers
-    if (stream_id >= NUM_STREAMS || IsCapture(stream_id)) {
-      buffer.SendStatus(AudioStatus::VIRTIO_SND_S_BAD_MSG, 0, 0);
-      return;
-    }
     // A buffer may be received for an inactive stream if we were slow to
     // process it and the other side stopped the stream. Quitely ignore it in
     // that case
@@ -424,46 +399,112 @@ void AudioHandler::OnPlaybackBuffer(TxBuffer buffer) {
       buffer.SendStatus(AudioStatus::VIRTIO_SND_S_OK, 0, buffer.len());
       return;
     }
-    // Webrtc will silently ignore any buffer with a length different than 10ms,
-    // so we must split any buffer bigger than that and temporarily store any
-    // remaining frames that are less than that size.
-    auto current_time = rtc::TimeMillis();
-    // The timestamp of the first 10ms chunk to be sent so that the last one
-    // will have the current time
-    auto base_time =
-        current_time - ((buffer.len() - 1) / holding_buffer.buffer.size()) * 10;
-    // number of frames in a 10 ms buffer
-    const int frames = stream_desc.sample_rate / 100;
-    size_t pos = 0;
-    while (pos < buffer.len()) {
-      if (holding_buffer.empty() &&
-          buffer.len() - pos >= holding_buffer.buffer.size()) {
-        // Avoid the extra copy into holding buffer
-        // This casts away volatility of the pointer, necessary because the
-        // webrtc api doesn't expect volatile memory. This should be safe though
-        // because webrtc will use the contents of the buffer before returning
-        // and only then we release it.
-        auto audio_frame_buffer = std::make_shared<CvdAudioFrameBuffer>(
-            const_cast<const uint8_t*>(&buffer.get()[pos]),
-            stream_desc.bits_per_sample, stream_desc.sample_rate,
-            stream_desc.channels, frames);
-        audio_sink_->OnFrame(audio_frame_buffer, base_time);
-        pos += holding_buffer.buffer.size();
-      } else {
-        pos += holding_buffer.Add(buffer.get() + pos, buffer.len() - pos);
-        if (holding_buffer.full()) {
-          auto buffer_ptr = const_cast<const uint8_t*>(holding_buffer.data());
-          auto audio_frame_buffer = std::make_shared<CvdAudioFrameBuffer>(
-              buffer_ptr, stream_desc.bits_per_sample,
-              stream_desc.sample_rate, stream_desc.channels, frames);
-          audio_sink_->OnFrame(audio_frame_buffer, base_time);
-          holding_buffer.count = 0;
-        }
+    bits_per_sample = stream_desc.bits_per_sample;
+    sample_rate = stream_desc.sample_rate;
+    channels = stream_desc.channels;
+  }
+  const size_t len10ms = (channels * (sample_rate / 100) * bits_per_sample) / 8;
+  if (bits_per_sample <= 0 || sample_rate <= 0 || len10ms == 0) {
+    LOG(ERROR) << "Received playback buffer before stream " << stream_id
+               << " parameters were set";
+    buffer.SendStatus(AudioStatus::VIRTIO_SND_S_BAD_MSG, 0, 0);
+    return;
+  }
+  // Webrtc will silently ignore any buffer with a length different than 10ms,
+  // so the data is split in 10ms frames. A trailing partial frame stays in the
+  // ring until the next buffer completes it. The frames are sent at real time
+  // pace by the playback thread, which makes this block when the guest gets
+  // too far ahead.
+  auto& ring = stream_desc.playback_ring;
+  size_t pos = 0;
+  while (pos < buffer.len()) {
+    auto frame = ring.WritableFrame();
+    if (!frame) {
+      WaitForPlaybackSpace(ring);
+      continue;
+    }
+    frame->SetFormat(bits_per_sample, sample_rate, channels);
+    pos += frame->Fill(buffer.get() + pos, buffer.len() - pos);
+    if (frame->full()) {
+      ring.Push();
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (playback_idle_.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(playback_mtx_);
+        playback_cv_.notify_all();
       }
-      base_time += 10;
     }
   }
-  buffer.SendStatus(AudioStatus::VIRTIO_SND_S_OK, 0, buffer.len());
+  // Everything accepted but not played yet counts towards the latency.
+  auto pending = ring.WritableFrame();
+  auto latency_bytes =
+      ring.size() * len10ms + (pending ? pending->filled() : 0);
+  buffer.SendStatus(AudioStatus::VIRTIO_SND_S_OK, latency_bytes, buffer.len());
+}
+
+bool AudioHandler::AnyPlaybackFrameQueued() const {
+  for (uint32_t stream_id = 0; stream_id < NUM_STREAMS; stream_id++) {
+    if (!IsCapture(stream_id) &&
+        stream_descs_[stream_id].playback_ring.size() > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void AudioHandler::WaitForPlaybackFrames() {
+  if (AnyPlaybackFrameQueued()) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(playback_mtx_);
+  playback_idle_.store(true, std::memory_order_relaxed);
+  // Pairs with the fence after pushing a frame: either the producer sees the
+  // idle flag or this thread sees the pushed frame.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  playback_cv_.wait(lock, [this]() { return AnyPlaybackFrameQueued(); });
+  playback_idle_.store(false, std::memory_order_relaxed);
+}
+
+void AudioHandler::WaitForPlaybackSpace(const AudioFrameRing& ring) {
+  std::unique_lock<std::mutex> lock(playback_mtx_);
+  playback_producer_waiting_.store(true, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  playback_cv_.wait(lock,
+                    [&ring]() { return ring.size() < ring.capacity(); });
+  playback_producer_waiting_.store(false, std::memory_order_relaxed);
+}
+
+[[noreturn]] void AudioHandler::PlaybackLoop() {
+  constexpr auto kFrameDuration = std::chrono::milliseconds(10);
+  auto next_frame_time = std::chrono::steady_clock::now();
+  for (;;) {
+    WaitForPlaybackFrames();
+    // Keep the 10ms cadence across short gaps, but don't try to catch up
+    // after the streams went idle.
+    next_frame_time =
+        std::max(next_frame_time, std::chrono::steady_clock::now());
+    std::this_thread::sleep_until(next_frame_time);
+    next_frame_time += kFrameDuration;
+
+    for (uint32_t stream_id = 0; stream_id < NUM_STREAMS; stream_id++) {
+      if (IsCapture(stream_id)) {
+        continue;
+      }
+      auto& ring = stream_descs_[stream_id].playback_ring;
+      auto frame = ring.ReadableFrame();
+      if (!frame) {
+        continue;
+      }
+      // The sink copies the samples before returning, so the frame can be
+      // reused right after.
+      audio_sink_->OnFrame(*frame, rtc::TimeMillis());
+      ring.Pop();
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (playback_producer_waiting_.load(std::memory_order_relaxed)) {
+      std::lock_guard<std::mutex> lock(playback_mtx_);
+      playback_cv_.notify_all();
+    }
+  }
 }
 
 void AudioHandler::OnCaptureBuffer(RxBuffer buffer) {
@@ -16,11 +16,14 @@
 
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
 #include <memory>
 #include <mutex>
 #include <thread>
 #include <vector>
 
+#include "host/frontend/webrtc/audio_frame_ring.h"
 #include "host/frontend/webrtc/libdevice/audio_sink.h"
 #include "host/frontend/webrtc/libcommon/audio_source.h"
 #include "host/libs/audio_connector/server.h"
@@ -42,6 +45,9 @@ class AudioHandler : public AudioServerExecutor {
     uint8_t* data();
     uint8_t* end();
   };
+  // Upper bound of the playback latency added by the ring, in 10ms frames.
+  static constexpr size_t kPlaybackRingFrames = 6;
+
   struct StreamDesc {
     std::mutex mtx;
     int bits_per_sample = -1;
@@ -49,6 +55,8 @@ class AudioHandler : public AudioServerExecutor {
     int channels = -1;
     bool active = false;
     HoldingBuffer buffer;
+    // Playback frames waiting to be paced out to the audio sink.
+    AudioFrameRing playback_ring{kPlaybackRingFrames};
   };
 
  public:
@@ -74,10 +82,21 @@ class AudioHandler : public AudioServerExecutor {
 
  private:
   [[noreturn]] void Loop();
+  [[noreturn]] void PlaybackLoop();
+  bool AnyPlaybackFrameQueued() const;
+  void WaitForPlaybackFrames();
+  void WaitForPlaybackSpace(const AudioFrameRing& ring);
 
   std::shared_ptr<webrtc_streaming::AudioSink> audio_sink_;
   std::unique_ptr<AudioServer> audio_server_;
   std::thread server_thread_;
+  std::thread playback_thread_;
+  // Wakes the playback thread when it's idle and the producer when its ring
+  // is full. The flags let each side skip the mutex in the common case.
+  std::mutex playback_mtx_;
+  std::condition_variable playback_cv_;
+  std::atomic<bool> playback_idle_ = false;
+  std::atomic<bool> playback_producer_waiting_ = false;
   std::vector<StreamDesc> stream_descs_ = {};
   std::shared_ptr<webrtc_streaming::AudioSource> audio_source_;
 };
@@ -21,7 +21,9 @@
 #include <linux/input.h>
 
 #include <chrono>
+#include <condition_variable>
 #include <map>
+#include <mutex>
 #include <set>
 #include <thread>
 #include <vector>
@@ -39,6 +41,7 @@
 #include "host/frontend/webrtc/kml_locations_handler.h"
 #include "host/frontend/webrtc/libdevice/camera_controller.h"
 #include "host/frontend/webrtc/location_handler.h"
+#include "host/frontend/webrtc/touch_event_queue.h"
 #include "host/libs/config/cuttlefish_config.h"
 
 DECLARE_bool(write_virtio_input);
@@ -52,13 +55,6 @@ struct virtio_input_event {
   int32_t value;
 };
 
-struct multitouch_slot {
-  int32_t id;
-  int32_t slot;
-  int32_t x;
-  int32_t y;
-};
-
 struct InputEventBuffer {
   virtual ~InputEventBuffer() = default;
   virtual void AddEvent(uint16_t type, uint16_t code, int32_t value) = 0;
@@ -93,6 +89,100 @@ std::unique_ptr<InputEventBuffer> GetEventBuffer() {
   }
 }
 
+// Writes the touch events of a display to its socket from a thread of its
+// own, so that a guest slow to read them doesn't hold up the data channel.
+// Events arriving while a write is in progress wait in a TouchEventQueue,
+// which merges the moves among them.
+class TouchEventWriter {
+ public:
+  // |input_latency| may be null.
+  TouchEventWriter(cuttlefish::InputSockets &input_sockets,
+                   const std::string &display_label,
+                   std::shared_ptr<DisplayInputLatency> input_latency)
+      : input_sockets_(input_sockets),
+        display_label_(display_label),
+        input_latency_(std::move(input_latency)) {
+    thread_ = std::thread([this]() { WriteLoop(); });
+  }
+
+  ~TouchEventWriter() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopped_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+    if (queue_.merged_moves() > 0) {
+      LOG(DEBUG) << "Merged " << queue_.merged_moves() << " touch moves on "
+                 << display_label_;
+    }
+  }
+
+  void Touch(int x, int y, bool down) {
+    if (input_latency_) {
+      input_latency_->InputReceived();
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queue_.Touch(x, y, down);
+    }
+    cv_.notify_one();
+  }
+
+  void MultiTouch(const cuttlefish::webrtc_streaming::MultiTouchPoint *points,
+                  size_t count, bool down) {
+    if (input_latency_) {
+      input_latency_->InputReceived();
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queue_.MultiTouch(points, count, down);
+    }
+    cv_.notify_one();
+  }
+
+ private:
+  void WriteLoop() {
+    std::vector<TouchEventQueue::Event> writing;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      cv_.wait(lock, [this]() { return stopped_ || !queue_.empty(); });
+      // Only stops once the queue is written out, so that no release is
+      // lost and the guest isn't left with contacts that never lift.
+      if (queue_.empty()) {
+        return;
+      }
+      queue_.TakeEvents(writing);
+      auto taken = std::chrono::steady_clock::now();
+      lock.unlock();
+
+      auto buffer = GetEventBuffer();
+      for (const auto &event : writing) {
+        buffer->AddEvent(event.type, event.code, event.value);
+      }
+      cuttlefish::WriteAll(input_sockets_.GetTouchClientByLabel(display_label_),
+                           reinterpret_cast<const char *>(buffer->data()),
+                           buffer->size());
+      if (input_latency_) {
+        input_latency_->InputWritten(taken);
+      }
+
+      lock.lock();
+    }
+  }
+
+  cuttlefish::InputSockets &input_sockets_;
+  const std::string display_label_;
+  std::shared_ptr<DisplayInputLatency> input_latency_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stopped_ = false;
+  TouchEventQueue queue_;
+
+  std::thread thread_;
+};
+
 /**
  * connection observer implementation for regular android mode.
  * i.e. when it is not in the confirmation UI mode (or TEE),
@@ -108,13 +198,15 @@ class ConnectionObserverImpl
           commands_to_custom_action_servers,
       std::weak_ptr<DisplayHandler> display_handler,
       CameraController *camera_controller,
-      cuttlefish::confui::HostVirtualInput &confui_input)
+      cuttlefish::confui::HostVirtualInput &confui_input,
+      std::shared_ptr<InputLatencyTracer> input_latency)
       : input_sockets_(input_sockets),
         kernel_log_events_handler_(kernel_log_events_handler),
         commands_to_custom_action_servers_(commands_to_custom_action_servers),
         weak_display_handler_(display_handler),
         camera_controller_(camera_controller),
-        confui_input_(confui_input) {}
+        confui_input_(confui_input),
+        input_latency_(std::move(input_latency)) {}
   virtual ~ConnectionObserverImpl() {
     auto display_handler = weak_display_handler_.lock();
     if (kernel_log_subscription_id_ != -1) {
@@ -151,70 +243,22 @@ class ConnectionObserverImpl
       }
       return;
     }
-    auto buffer = GetEventBuffer();
-    if (!buffer) {
-      LOG(ERROR) << "Failed to allocate event buffer";
-      return;
-    }
-    buffer->AddEvent(EV_ABS, ABS_X, x);
-    buffer->AddEvent(EV_ABS, ABS_Y, y);
-    buffer->AddEvent(EV_KEY, BTN_TOUCH, down);
-    buffer->AddEvent(EV_SYN, SYN_REPORT, 0);
-    cuttlefish::WriteAll(input_sockets_.GetTouchClientByLabel(display_label),
-                         reinterpret_cast<const char *>(buffer->data()),
-                         buffer->size());
+    GetTouchEventWriter(display_label).Touch(x, y, down);
   }
 
-  void OnMultiTouchEvent(const std::string &display_label, Json::Value id,
-                         Json::Value slot, Json::Value x, Json::Value y,
-                         bool down, int size) {
-    auto buffer = GetEventBuffer();
-    if (!buffer) {
-      LOG(ERROR) << "Failed to allocate event buffer";
-      return;
-    }
-
-    for (int i = 0; i < size; i++) {
-      auto this_slot = slot[i].asInt();
-      auto this_id = id[i].asInt();
-      auto this_x = x[i].asInt();
-      auto this_y = y[i].asInt();
-
-      if (confui_input_.IsConfUiActive()) {
-        if (down) {
-          confui_input_.TouchEvent(this_x, this_y, down);
-        }
-        continue;
-      }
-
-      buffer->AddEvent(EV_ABS, ABS_MT_SLOT, this_slot);
+  void OnMultiTouchEvent(
+      const std::string &display_label,
+      const cuttlefish::webrtc_streaming::MultiTouchPoint *points,
+      size_t count, bool down) override {
+    if (confui_input_.IsConfUiActive()) {
       if (down) {
-        bool is_new = active_touch_slots_.insert(this_slot).second;
-        if (is_new) {
-          buffer->AddEvent(EV_ABS, ABS_MT_TRACKING_ID, this_id);
-          if (active_touch_slots_.size() == 1) {
-            buffer->AddEvent(EV_KEY, BTN_TOUCH, 1);
-          }
-        }
-        buffer->AddEvent(EV_ABS, ABS_MT_POSITION_X, this_x);
-        buffer->AddEvent(EV_ABS, ABS_MT_POSITION_Y, this_y);
-        // send ABS_X and ABS_Y for single-touch compatibility
-        buffer->AddEvent(EV_ABS, ABS_X, this_x);
-        buffer->AddEvent(EV_ABS, ABS_Y, this_y);
-      } else {
-        // released touch
-        buffer->AddEvent(EV_ABS, ABS_MT_TRACKING_ID, this_id);
-        active_touch_slots_.erase(this_slot);
-        if (active_touch_slots_.empty()) {
-          buffer->AddEvent(EV_KEY, BTN_TOUCH, 0);
+        for (size_t i = 0; i < count; i++) {
+          confui_input_.TouchEvent(points[i].x, points[i].y, down);
         }
       }
+      return;
     }
-
-    buffer->AddEvent(EV_SYN, SYN_REPORT, 0);
-    cuttlefish::WriteAll(input_sockets_.GetTouchClientByLabel(display_label),
-                         reinterpret_cast<const char *>(buffer->data()),
-                         buffer->size());
+    GetTouchEventWriter(display_label).MultiTouch(points, count, down);
   }
 
   void OnKeyboardEvent(uint16_t code, bool down) override {
@@ -395,6 +439,21 @@ class ConnectionObserverImpl
   }
 
  private:
+  TouchEventWriter &GetTouchEventWriter(const std::string &display_label) {
+    auto it = touch_event_writers_.find(display_label);
+    if (it == touch_event_writers_.end()) {
+      it = touch_event_writers_
+               .emplace(display_label,
+                        std::make_unique<TouchEventWriter>(
+                            input_sockets_, display_label,
+                            input_latency_
+                                ? input_latency_->ForDisplay(display_label)
+                                : nullptr))
+               .first;
+    }
+    return *it->second;
+  }
+
   cuttlefish::InputSockets& input_sockets_;
   cuttlefish::KernelLogEventsHandler* kernel_log_events_handler_;
   int kernel_log_subscription_id_ = -1;
@@ -409,9 +468,13 @@ class ConnectionObserverImpl
       gpx_locations_handler_;
   std::map<std::string, cuttlefish::SharedFD> commands_to_custom_action_servers_;
   std::weak_ptr<DisplayHandler> weak_display_handler_;
-  std::set<int32_t> active_touch_slots_;
+  // Input events only come from the input data channel's thread, no need to
+  // synchronize.
+  std::map<std::string, std::unique_ptr<TouchEventWriter>>
+      touch_event_writers_;
   cuttlefish::CameraController *camera_controller_;
   cuttlefish::confui::HostVirtualInput &confui_input_;
+  std::shared_ptr<InputLatencyTracer> input_latency_;
 };
 
 CfConnectionObserverFactory::CfConnectionObserverFactory(
@@ -428,7 +491,7 @@ CfConnectionObserverFactory::CreateObserver() {
       new ConnectionObserverImpl(input_sockets_, kernel_log_events_handler_,
                                  commands_to_custom_action_servers_,
                                  weak_display_handler_, camera_controller_,
-                                 confui_input_));
+                                 confui_input_, input_latency_));
 }
 
 void CfConnectionObserverFactory::AddCustomActionServer(
@@ -449,4 +512,9 @@ void CfConnectionObserverFactory::SetCameraHandler(
     CameraController *controller) {
   camera_controller_ = controller;
 }
+
+void CfConnectionObserverFactory::SetInputLatencyTracer(
+    std::shared_ptr<InputLatencyTracer> input_latency) {
+  input_latency_ = std::move(input_latency);
+}
 }  // namespace cuttlefish
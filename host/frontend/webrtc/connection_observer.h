@@ -21,6 +21,7 @@
 
 #include "common/libs/fs/shared_fd.h"
 #include "host/frontend/webrtc/display_handler.h"
+#include "host/frontend/webrtc/input_latency.h"
 #include "host/frontend/webrtc/kernel_log_events_handler.h"
 #include "host/frontend/webrtc/libdevice/camera_controller.h"
 #include "host/frontend/webrtc/libdevice/connection_observer.h"
@@ -62,6 +63,8 @@ class CfConnectionObserverFactory
 
   void SetCameraHandler(CameraController* controller);
 
+  void SetInputLatencyTracer(std::shared_ptr<InputLatencyTracer> input_latency);
+
  private:
   InputSockets& input_sockets_;
   KernelLogEventsHandler* kernel_log_events_handler_;
@@ -70,6 +73,7 @@ class CfConnectionObserverFactory
   std::weak_ptr<DisplayHandler> weak_display_handler_;
   cuttlefish::confui::HostVirtualInput& confui_input_;
   cuttlefish::CameraController* camera_controller_ = nullptr;
+  std::shared_ptr<InputLatencyTracer> input_latency_;
 };
 
 }  // namespace cuttlefish
@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "host/frontend/webrtc/display_frame_processor.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace cuttlefish {
+namespace {
+
+// Frames are hashed in square blocks of this many pixels, the same as the
+// converter tracks damage in, so small damage only costs a few blocks.
+constexpr std::uint32_t kTileSize = 64;
+
+const FrameDamage kFullFrameDamage{};
+
+std::uint64_t RotateLeft(std::uint64_t value, int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+// A fast non-cryptographic hash of a rectangle of pixels, four independent
+// lanes of XXH64 rounds.
+std::uint64_t HashRect(std::uint32_t stride_bytes, const std::uint8_t* pixels,
+                       std::uint32_t x, std::uint32_t y, std::uint32_t width,
+                       std::uint32_t height) {
+  constexpr std::uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+  constexpr std::uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+  auto mix = [](std::uint64_t lane, std::uint64_t input) {
+    return RotateLeft(lane + input * kPrime2, 31) * kPrime1;
+  };
+  std::uint64_t lanes[4] = {kPrime1 + kPrime2, kPrime2, 0, 0 - kPrime1};
+  const std::size_t row_bytes = static_cast<std::size_t>(width) * 4;
+  for (std::uint32_t row_y = y; row_y < y + height; row_y++) {
+    const std::uint8_t* row =
+        pixels + static_cast<std::size_t>(row_y) * stride_bytes + x * 4;
+    std::size_t i = 0;
+    for (; i + 32 <= row_bytes; i += 32) {
+      std::uint64_t words[4];
+      memcpy(words, row + i, sizeof(words));
+      for (int lane = 0; lane < 4; lane++) {
+        lanes[lane] = mix(lanes[lane], words[lane]);
+      }
+    }
+    for (; i < row_bytes; i += 4) {
+      std::uint32_t pixel;
+      memcpy(&pixel, row + i, sizeof(pixel));
+      lanes[0] = mix(lanes[0], pixel);
+    }
+  }
+  std::uint64_t hash = RotateLeft(lanes[0], 1) + RotateLeft(lanes[1], 7) +
+                       RotateLeft(lanes[2], 12) + RotateLeft(lanes[3], 18);
+  return mix(hash, (static_cast<std::uint64_t>(width) << 32) | height);
+}
+
+// Keeps `out` up to date with the guest frame, copying only what changed when
+// it already holds the previous one.
+void CopyFrame(std::uint32_t width, std::uint32_t height,
+               std::uint32_t stride_bytes, const std::uint8_t* pixels,
+               const FrameDamage& damage, bool out_current,
+               std::vector<std::uint8_t>& out) {
+  const std::size_t row_bytes = static_cast<std::size_t>(width) * 4;
+  const bool full_frame =
+      !out_current || damage.empty() || out.size() != row_bytes * height;
+  out.resize(row_bytes * height);
+  auto copy_rect = [&](std::uint32_t x, std::uint32_t y, std::uint32_t w,
+                       std::uint32_t h) {
+    for (std::uint32_t row = y; row < y + h; row++) {
+      memcpy(out.data() + row * row_bytes + x * 4,
+             pixels + static_cast<std::size_t>(row) * stride_bytes + x * 4,
+             static_cast<std::size_t>(w) * 4);
+    }
+  };
+  if (full_frame) {
+    copy_rect(0, 0, width, height);
+    return;
+  }
+  for (const auto& rect : damage) {
+    copy_rect(rect.x, rect.y, rect.w, rect.h);
+  }
+}
+
+}  // namespace
+
+DisplayFrameProcessor::DisplayFrameProcessor(FrameConverter& converter)
+    : converter_(converter), buffer_pool_(VideoFrameBufferPool::Create()) {}
+
+DisplayFrameProcessor::Frame DisplayFrameProcessor::OnFrame(
+    bool watched, std::uint32_t width, std::uint32_t height,
+    std::uint32_t stride_bytes, const std::uint8_t* pixels,
+    const FrameDamage& damage, std::chrono::steady_clock::time_point now) {
+  stats_.received++;
+  if (!watched) {
+    // The guest buffer is released as soon as the callback returns, so keep
+    // a copy in case a client shows up before the next frame.
+    CopyFrame(width, height, stride_bytes, pixels, damage,
+              unwatched_pixels_current_, unwatched_pixels_);
+    unwatched_width_ = width;
+    unwatched_height_ = height;
+    unwatched_pixels_current_ = true;
+    stale_ = true;
+    tile_hashes_.clear();
+    stats_.unwatched++;
+    return {};
+  }
+
+  bool changed =
+      UpdateTileHashes(width, height, stride_bytes, pixels, damage);
+  if (!changed && !stale_ && last_buffer_) {
+    if (now - last_sent_ < kRefreshInterval) {
+      stats_.deduped++;
+      return {};
+    }
+    // Time for a refresh, which doesn't need converting.
+    last_sent_ = now;
+    return Frame{.buffer = last_buffer_, .changed = false};
+  }
+
+  // After unconverted frames the canvas no longer matches the damage.
+  auto buffer = ConvertFrame(width, height, stride_bytes, pixels,
+                             stale_ ? kFullFrameDamage : damage);
+  unwatched_pixels_current_ = false;
+  last_sent_ = now;
+  return Frame{.buffer = std::move(buffer), .changed = true};
+}
+
+std::shared_ptr<CvdVideoFrameBuffer> DisplayFrameProcessor::LastFrame() {
+  if (stale_ && unwatched_pixels_current_) {
+    // Only the copy of the latest frame is left, convert it now that someone
+    // is about to watch.
+    ConvertFrame(unwatched_width_, unwatched_height_, unwatched_width_ * 4,
+                 unwatched_pixels_.data(), kFullFrameDamage);
+  }
+  return last_buffer_;
+}
+
+DisplayFrameProcessor::Stats DisplayFrameProcessor::GetStats() const {
+  Stats stats = stats_;
+  stats.buffer_pool = buffer_pool_->GetStats();
+  return stats;
+}
+
+std::shared_ptr<CvdVideoFrameBuffer> DisplayFrameProcessor::ConvertFrame(
+    std::uint32_t width, std::uint32_t height, std::uint32_t stride_bytes,
+    const std::uint8_t* pixels, const FrameDamage& damage) {
+  auto buffer = buffer_pool_->Get(width, height);
+
+  // The guest buffer is released as soon as the callback returns, so the
+  // conversion is spread over the converter's workers while this thread
+  // waits on it rather than being deferred.
+  converter_.Convert(canvas_, width, height, stride_bytes, pixels, damage,
+                     *buffer);
+  last_buffer_ = buffer;
+  stale_ = false;
+  stats_.converted++;
+  return buffer;
+}
+
+bool DisplayFrameProcessor::UpdateTileHashes(std::uint32_t width,
+                                             std::uint32_t height,
+                                             std::uint32_t stride_bytes,
+                                             const std::uint8_t* pixels,
+                                             const FrameDamage& damage) {
+  const std::uint32_t tiles_w = (width + kTileSize - 1) / kTileSize;
+  const std::uint32_t tiles_h = (height + kTileSize - 1) / kTileSize;
+
+  bool changed = false;
+  bool full_frame = damage.empty();
+  if (tile_hashes_.empty() || width != hashed_width_ ||
+      height != hashed_height_) {
+    tile_hashes_.assign(tiles_w * tiles_h, 0);
+    hashed_width_ = width;
+    hashed_height_ = height;
+    changed = true;
+    full_frame = true;
+  }
+
+  auto hash_tiles = [&](std::uint32_t tx0, std::uint32_t ty0,
+                        std::uint32_t tx1, std::uint32_t ty1) {
+    for (std::uint32_t ty = ty0; ty <= ty1 && ty < tiles_h; ty++) {
+      for (std::uint32_t tx = tx0; tx <= tx1 && tx < tiles_w; tx++) {
+        const std::uint32_t x = tx * kTileSize;
+        const std::uint32_t y = ty * kTileSize;
+        const auto hash =
+            HashRect(stride_bytes, pixels, x, y,
+                     std::min(kTileSize, width - x),
+                     std::min(kTileSize, height - y));
+        auto& tile_hash = tile_hashes_[ty * tiles_w + tx];
+        changed |= tile_hash != hash;
+        tile_hash = hash;
+      }
+    }
+  };
+  if (full_frame) {
+    if (tiles_w > 0 && tiles_h > 0) {
+      hash_tiles(0, 0, tiles_w - 1, tiles_h - 1);
+    }
+    return changed;
+  }
+  for (const auto& rect : damage) {
+    if (rect.w <= 0 || rect.h <= 0) {
+      continue;
+    }
+    // Rectangles were already clipped to the frame by the compositor.
+    hash_tiles(rect.x / kTileSize, rect.y / kTileSize,
+               (rect.x + rect.w - 1) / kTileSize,
+               (rect.y + rect.h - 1) / kTileSize);
+  }
+  return changed;
+}
+
+}  // namespace cuttlefish
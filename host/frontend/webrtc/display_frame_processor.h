@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "host/frontend/webrtc/cvd_video_frame_buffer.h"
+#include "host/frontend/webrtc/frame_converter.h"
+#include "host/frontend/webrtc/video_frame_buffer_pool.h"
+#include "host/libs/wayland/wayland_server_callbacks.h"
+
+namespace cuttlefish {
+
+// Turns the guest frames of a single display into buffers for its video sink.
+// Frames identical to the previous one are dropped, save for a periodic
+// refresh, and frames nobody watches are only copied, to be converted if
+// someone starts watching before the next frame.
+//
+// Not thread safe.
+class DisplayFrameProcessor {
+ public:
+  // Identical frames are still sent this often, so that clients joining or
+  // recovering from losses don't wait for the guest to repaint.
+  static constexpr auto kRefreshInterval = std::chrono::seconds(1);
+
+  // What happened to the frames of the display.
+  struct Stats {
+    // Frames received from the guest.
+    std::uint64_t received = 0;
+    // Frames converted to I420.
+    std::uint64_t converted = 0;
+    // Frames not converted because nothing was watching the display.
+    std::uint64_t unwatched = 0;
+    // Frames dropped for being identical to the previous one.
+    std::uint64_t deduped = 0;
+    // How well the display's frame buffers are recycled.
+    VideoFrameBufferPool::Stats buffer_pool;
+  };
+
+  struct Frame {
+    // The buffer to send, null when there is nothing to send.
+    std::shared_ptr<CvdVideoFrameBuffer> buffer;
+    // Whether the buffer shows a change rather than refreshing the last one.
+    bool changed = false;
+  };
+
+  // |converter| is shared with the other displays and must outlive this.
+  explicit DisplayFrameProcessor(FrameConverter& converter);
+
+  // Handles a frame from the guest. The pixels are only read during the call.
+  Frame OnFrame(bool watched, std::uint32_t width, std::uint32_t height,
+                std::uint32_t stride_bytes, const std::uint8_t* pixels,
+                const FrameDamage& damage,
+                std::chrono::steady_clock::time_point now =
+                    std::chrono::steady_clock::now());
+
+  // The latest frame, converted now if it arrived while nobody was watching.
+  // Null before the first frame.
+  std::shared_ptr<CvdVideoFrameBuffer> LastFrame();
+
+  Stats GetStats() const;
+
+ private:
+  // Converts the latest frame into a new buffer.
+  std::shared_ptr<CvdVideoFrameBuffer> ConvertFrame(
+      std::uint32_t width, std::uint32_t height, std::uint32_t stride_bytes,
+      const std::uint8_t* pixels, const FrameDamage& damage);
+  // Rehashes the damaged tiles of the frame, returns whether any changed.
+  bool UpdateTileHashes(std::uint32_t width, std::uint32_t height,
+                        std::uint32_t stride_bytes, const std::uint8_t* pixels,
+                        const FrameDamage& damage);
+
+  FrameConverter& converter_;
+  FrameConverter::Canvas canvas_;
+  std::shared_ptr<VideoFrameBufferPool> buffer_pool_;
+  // The last converted frame.
+  std::shared_ptr<CvdVideoFrameBuffer> last_buffer_;
+  // When a frame was last handed out to be sent.
+  std::chrono::steady_clock::time_point last_sent_;
+  // The hashes of the tiles of the last frame, to spot identical frames
+  // without hashing more than the damage. Empty when unknown.
+  std::vector<std::uint64_t> tile_hashes_;
+  std::uint32_t hashed_width_ = 0;
+  std::uint32_t hashed_height_ = 0;
+  // Whether frames went unconverted since last_buffer_, so that canvas_ and
+  // last_buffer_ are out of date.
+  bool stale_ = false;
+  // While nothing watches the display its frames are only copied here, as
+  // the guest buffers are released as soon as the callback returns, and
+  // converted on demand.
+  std::vector<std::uint8_t> unwatched_pixels_;
+  std::uint32_t unwatched_width_ = 0;
+  std::uint32_t unwatched_height_ = 0;
+  // Whether unwatched_pixels_ holds the latest frame.
+  bool unwatched_pixels_current_ = false;
+  Stats stats_;
+};
+
+}  // namespace cuttlefish
@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "host/frontend/webrtc/display_frame_processor.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace cuttlefish {
+namespace {
+
+constexpr std::uint32_t kWidth = 256;
+constexpr std::uint32_t kHeight = 128;
+constexpr std::uint32_t kStride = kWidth * 4;
+
+class Image {
+ public:
+  explicit Image(std::uint8_t value) : pixels_(kStride * kHeight, value) {}
+
+  Image& Fill(std::uint32_t x, std::uint32_t y, std::uint32_t w,
+              std::uint32_t h, std::uint8_t value) {
+    for (std::uint32_t row = y; row < y + h; row++) {
+      memset(pixels_.data() + row * kStride + x * 4, value, w * 4);
+    }
+    return *this;
+  }
+
+  const std::uint8_t* data() const { return pixels_.data(); }
+
+ private:
+  std::vector<std::uint8_t> pixels_;
+};
+
+bool SamePixels(const CvdVideoFrameBuffer& a, const CvdVideoFrameBuffer& b) {
+  if (a.width() != b.width() || a.height() != b.height()) {
+    return false;
+  }
+  for (int y = 0; y < a.height(); y++) {
+    if (memcmp(a.DataY() + y * a.StrideY(), b.DataY() + y * b.StrideY(),
+               a.width()) != 0) {
+      return false;
+    }
+  }
+  for (int y = 0; y < (a.height() + 1) / 2; y++) {
+    const int chroma_width = (a.width() + 1) / 2;
+    if (memcmp(a.DataU() + y * a.StrideU(), b.DataU() + y * b.StrideU(),
+               chroma_width) != 0 ||
+        memcmp(a.DataV() + y * a.StrideV(), b.DataV() + y * b.StrideV(),
+               chroma_width) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+class DisplayFrameProcessorTest : public ::testing::Test {
+ protected:
+  DisplayFrameProcessor::Frame Send(const Image& image,
+                                    const FrameDamage& damage = {},
+                                    bool watched = true) {
+    return processor_.OnFrame(watched, kWidth, kHeight, kStride, image.data(),
+                              damage, now_);
+  }
+
+  // What a display watched all along would show for |image|.
+  std::shared_ptr<CvdVideoFrameBuffer> Reference(const Image& image) {
+    DisplayFrameProcessor reference(converter_);
+    return reference
+        .OnFrame(true, kWidth, kHeight, kStride, image.data(), {}, now_)
+        .buffer;
+  }
+
+  FrameConverter converter_{0};
+  DisplayFrameProcessor processor_{converter_};
+  std::chrono::steady_clock::time_point now_;
+};
+
+TEST_F(DisplayFrameProcessorTest, DropsIdenticalFrames) {
+  auto first = Send(Image(1));
+  ASSERT_NE(first.buffer, nullptr);
+  EXPECT_TRUE(first.changed);
+
+  EXPECT_EQ(Send(Image(1)).buffer, nullptr);
+  EXPECT_EQ(Send(Image(1), {{.x = 0, .y = 0, .w = 10, .h = 10}}).buffer,
+            nullptr);
+
+  auto stats = processor_.GetStats();
+  EXPECT_EQ(stats.received, 3);
+  EXPECT_EQ(stats.converted, 1);
+  EXPECT_EQ(stats.deduped, 2);
+}
+
+TEST_F(DisplayFrameProcessorTest, RefreshesIdenticalFramesWithoutConverting) {
+  auto first = Send(Image(1));
+  now_ += DisplayFrameProcessor::kRefreshInterval;
+
+  auto refresh = Send(Image(1));
+
+  EXPECT_EQ(refresh.buffer, first.buffer);
+  EXPECT_FALSE(refresh.changed);
+  EXPECT_EQ(processor_.GetStats().converted, 1);
+  EXPECT_EQ(Send(Image(1)).buffer, nullptr);
+}
+
+TEST_F(DisplayFrameProcessorTest, HashesOnlyTheDamagedTiles) {
+  Send(Image(1));
+  // Changes outside the damage are the compositor's to report, a frame is
+  // only compared with the previous one where it was damaged.
+  auto undamaged_change = Image(1).Fill(200, 100, 8, 8, 2);
+  EXPECT_EQ(Send(undamaged_change, {{.x = 0, .y = 0, .w = 8, .h = 8}}).buffer,
+            nullptr);
+
+  auto damaged_change = Image(1).Fill(100, 10, 8, 8, 3);
+  auto frame = Send(damaged_change, {{.x = 100, .y = 10, .w = 8, .h = 8}});
+
+  ASSERT_NE(frame.buffer, nullptr);
+  EXPECT_TRUE(frame.changed);
+  EXPECT_EQ(processor_.GetStats().converted, 2);
+}
+
+TEST_F(DisplayFrameProcessorTest, NoticesChangesInEveryDamageRect) {
+  Send(Image(1));
+
+  auto change = Image(1).Fill(200, 100, 8, 8, 2);
+  auto frame = Send(change, {{.x = 0, .y = 0, .w = 8, .h = 8},
+                             {.x = 196, .y = 96, .w = 16, .h = 16}});
+
+  EXPECT_NE(frame.buffer, nullptr);
+}
+
+TEST_F(DisplayFrameProcessorTest, OnlyCopiesUnwatchedFrames) {
+  Send(Image(1));
+
+  EXPECT_EQ(Send(Image(2), {}, false).buffer, nullptr);
+  EXPECT_EQ(Send(Image(3), {}, false).buffer, nullptr);
+
+  auto stats = processor_.GetStats();
+  EXPECT_EQ(stats.unwatched, 2);
+  EXPECT_EQ(stats.converted, 1);
+}
+
+TEST_F(DisplayFrameProcessorTest, ConvertsLatestUnwatchedFrameOnDemand) {
+  Send(Image(1));
+  Send(Image(2), {}, false);
+  auto latest = Image(2).Fill(64, 64, 16, 16, 9);
+  Send(latest, {{.x = 64, .y = 64, .w = 16, .h = 16}}, false);
+
+  auto buffer = processor_.LastFrame();
+
+  ASSERT_NE(buffer, nullptr);
+  EXPECT_TRUE(SamePixels(*buffer, *Reference(latest)));
+  EXPECT_EQ(processor_.GetStats().converted, 2);
+  // Converted once only.
+  EXPECT_EQ(processor_.LastFrame(), buffer);
+  EXPECT_EQ(processor_.GetStats().converted, 2);
+}
+
+TEST_F(DisplayFrameProcessorTest, ReconvertsWholeFrameOnceWatchedAgain) {
+  Send(Image(1));
+  Send(Image(2), {}, false);
+  // Damaged relative to the unwatched frame, which the canvas never saw.
+  auto latest = Image(2).Fill(0, 0, 8, 8, 9);
+
+  auto frame = Send(latest, {{.x = 0, .y = 0, .w = 8, .h = 8}});
+
+  ASSERT_NE(frame.buffer, nullptr);
+  EXPECT_TRUE(frame.changed);
+  EXPECT_TRUE(SamePixels(*frame.buffer, *Reference(latest)));
+}
+
+TEST_F(DisplayFrameProcessorTest, DoesNotDedupeAfterUnwatchedFrames) {
+  auto first = Send(Image(1));
+  Send(Image(2), {}, false);
+
+  // Identical to the last converted frame, but not to the last frame.
+  auto frame = Send(Image(1));
+
+  ASSERT_NE(frame.buffer, nullptr);
+  EXPECT_TRUE(SamePixels(*frame.buffer, *first.buffer));
+  EXPECT_EQ(processor_.GetStats().converted, 2);
+}
+
+TEST_F(DisplayFrameProcessorTest, HasNoLastFrameBeforeTheFirst) {
+  EXPECT_EQ(processor_.LastFrame(), nullptr);
+}
+
+}  // namespace
+}  // namespace cuttlefish
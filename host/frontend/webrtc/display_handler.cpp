@@ -19,15 +19,35 @@
 #include <chrono>
 #include <functional>
 #include <memory>
-
-#include <libyuv.h>
+#include <ostream>
+#include <string>
+#include <utility>
 
 #include "host/frontend/webrtc/libdevice/streamer.h"
 
 namespace cuttlefish {
-DisplayHandler::DisplayHandler(webrtc_streaming::Streamer& streamer,
-                               ScreenConnector& screen_connector)
-    : streamer_(streamer), screen_connector_(screen_connector) {
+namespace {
+
+std::ostream& operator<<(std::ostream& out,
+                         const DisplayHandler::DisplayStats& stats) {
+  return out << "received:" << stats.frames.received
+             << " converted:" << stats.frames.converted
+             << " unwatched:" << stats.frames.unwatched
+             << " deduped:" << stats.frames.deduped << " sent:" << stats.sent
+             << " buffer pool hits:" << stats.frames.buffer_pool.hits
+             << " misses:" << stats.frames.buffer_pool.misses
+             << " peak outstanding:"
+             << stats.frames.buffer_pool.peak_outstanding;
+}
+
+}  // namespace
+
+DisplayHandler::DisplayHandler(
+    webrtc_streaming::Streamer& streamer, ScreenConnector& screen_connector,
+    std::shared_ptr<InputLatencyTracer> input_latency)
+    : streamer_(streamer),
+      screen_connector_(screen_connector),
+      input_latency_(std::move(input_latency)) {
   screen_connector_.SetCallback(std::move(GetScreenConnectorCallback()));
   screen_connector_.SetDisplayEventCallback([this](const DisplayEvent& event) {
     std::visit(
@@ -48,7 +68,8 @@ DisplayHandler::DisplayHandler(webrtc_streaming::Streamer& streamer,
               return;
             }
 
-            display_sinks_[display_number] = display;
+            std::lock_guard<std::mutex> lock(displays_mutex_);
+            displays_[display_number].sink = display;
           } else if constexpr (std::is_same_v<DisplayDestroyedEvent, T>) {
             LOG(VERBOSE) << "Display:" << e.display_number << " destroyed.";
 
@@ -56,7 +77,15 @@ DisplayHandler::DisplayHandler(webrtc_streaming::Streamer& streamer,
             const auto display_id =
                 "display_" + std::to_string(e.display_number);
             streamer_.RemoveDisplay(display_id);
-            display_sinks_.erase(display_number);
+
+            std::lock_guard<std::mutex> lock(displays_mutex_);
+            auto display_it = displays_.find(display_number);
+            if (display_it == displays_.end()) {
+              return;
+            }
+            LOG(DEBUG) << "Display:" << display_number << " frames "
+                       << GetStats(display_it->second);
+            displays_.erase(display_it);
           } else {
             static_assert("Unhandled display event.");
           }
@@ -65,21 +94,66 @@ DisplayHandler::DisplayHandler(webrtc_streaming::Streamer& streamer,
   });
 }
 
+DisplayHandler::DisplayStats DisplayHandler::GetStats(const Display& display) {
+  DisplayStats stats;
+  if (display.frames) {
+    stats.frames = display.frames->GetStats();
+  }
+  stats.sent = display.sent;
+  return stats;
+}
+
 DisplayHandler::GenerateProcessedFrameCallback DisplayHandler::GetScreenConnectorCallback() {
     // only to tell the producer how to create a ProcessedFrame to cache into the queue
     DisplayHandler::GenerateProcessedFrameCallback callback =
-        [](std::uint32_t display_number, std::uint32_t frame_width,
-           std::uint32_t frame_height, std::uint32_t frame_stride_bytes,
-           std::uint8_t* frame_pixels,
-           WebRtcScProcessedFrame& processed_frame) {
+        [this](std::uint32_t display_number, std::uint32_t frame_width,
+               std::uint32_t frame_height, std::uint32_t frame_stride_bytes,
+               std::uint8_t* frame_pixels, const FrameDamage& frame_damage,
+               FrameCommitTime commit_time,
+               WebRtcScProcessedFrame& processed_frame) {
+          const auto callback_time = std::chrono::steady_clock::now();
           processed_frame.display_number_ = display_number;
-          processed_frame.buf_ =
-              std::make_unique<CvdVideoFrameBuffer>(frame_width, frame_height);
-          libyuv::ABGRToI420(
-              frame_pixels, frame_stride_bytes, processed_frame.buf_->DataY(),
-              processed_frame.buf_->StrideY(), processed_frame.buf_->DataU(),
-              processed_frame.buf_->StrideU(), processed_frame.buf_->DataV(),
-              processed_frame.buf_->StrideV(), frame_width, frame_height);
+          processed_frame.is_success_ = false;
+
+          std::lock_guard<std::mutex> lock(displays_mutex_);
+          auto& display = displays_[display_number];
+          if (!display.frames) {
+            display.frames =
+                std::make_unique<DisplayFrameProcessor>(frame_converter_);
+          }
+          if (input_latency_ && !display.input_latency) {
+            display.input_latency = input_latency_->ForDisplay(
+                "display_" + std::to_string(display_number));
+          }
+
+          // Neither clients nor the recorder are interested in the frame, so
+          // the conversion would be thrown away.
+          bool watched = display.sink && display.sink->HasConsumers();
+          if (watched != display.watched) {
+            LOG(DEBUG) << "Display:" << display_number
+                       << (watched ? " watched" : " no longer watched")
+                       << ", frames " << GetStats(display);
+            display.watched = watched;
+          }
+
+          auto frame = display.frames->OnFrame(
+              watched, frame_width, frame_height, frame_stride_bytes,
+              frame_pixels, frame_damage);
+          if (!frame.buffer) {
+            return;
+          }
+          // Only frames that change the display can show a touch's effect.
+          if (frame.changed && display.input_latency) {
+            processed_frame.latency_trace_ =
+                display.input_latency->TakeTrace(commit_time);
+          }
+          if (processed_frame.latency_trace_) {
+            processed_frame.latency_trace_->Stamp(
+                InputLatencyStage::kFrameCallback, callback_time);
+            processed_frame.latency_trace_->Stamp(
+                InputLatencyStage::kConverted);
+          }
+          processed_frame.buf_ = std::move(frame.buffer);
           processed_frame.is_success_ = true;
         };
     return callback;
@@ -88,46 +162,76 @@ DisplayHandler::GenerateProcessedFrameCallback DisplayHandler::GetScreenConnecto
 [[noreturn]] void DisplayHandler::Loop() {
   for (;;) {
     auto processed_frame = screen_connector_.OnNextFrame();
-    // processed_frame has display number from the guest
-    {
-      std::lock_guard<std::mutex> lock(last_buffer_mutex_);
-      std::shared_ptr<CvdVideoFrameBuffer> buffer = std::move(processed_frame.buf_);
-      last_buffer_display_ = processed_frame.display_number_;
-      last_buffer_ =
-          std::static_pointer_cast<webrtc_streaming::VideoFrameBuffer>(buffer);
+    if (processed_frame.latency_trace_) {
+      processed_frame.latency_trace_->Stamp(InputLatencyStage::kDequeued);
     }
+    // processed_frame has display number from the guest
     if (processed_frame.is_success_) {
-      SendLastFrame();
+      SendFrame(processed_frame.display_number_,
+                std::move(processed_frame.buf_),
+                std::move(processed_frame.latency_trace_));
     }
   }
 }
 
-void DisplayHandler::SendLastFrame() {
-  std::shared_ptr<webrtc_streaming::VideoFrameBuffer> buffer;
-  std::uint32_t buffer_display;
+void DisplayHandler::SendFrame(std::uint32_t display_number,
+                               std::shared_ptr<CvdVideoFrameBuffer> buffer,
+                               std::optional<InputLatencyTrace> latency_trace) {
+  std::shared_ptr<webrtc_streaming::VideoSink> sink;
+  std::shared_ptr<DisplayInputLatency> input_latency;
   {
-    std::lock_guard<std::mutex> lock(last_buffer_mutex_);
-    buffer = last_buffer_;
-    buffer_display = last_buffer_display_;
+    std::lock_guard<std::mutex> lock(displays_mutex_);
+    auto it = displays_.find(display_number);
+    if (it == displays_.end() || !it->second.sink) {
+      return;
+    }
+    sink = it->second.sink;
+    input_latency = it->second.input_latency;
+    it->second.sent++;
   }
-  if (!buffer) {
-    // If a connection request arrives before the first frame is available don't
-    // send any frame.
-    return;
+  // SendFrame can be called from multiple threads simultaneously, locking
+  // here avoids injecting frames with the timestamps in the wrong order.
+  std::lock_guard<std::mutex> lock(next_frame_mutex_);
+  int64_t time_stamp =
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count();
+  sink->OnFrame(std::static_pointer_cast<webrtc_streaming::VideoFrameBuffer>(
+                    std::move(buffer)),
+                time_stamp);
+  if (latency_trace && input_latency) {
+    latency_trace->Stamp(InputLatencyStage::kSent);
+    input_latency->Record(*latency_trace);
   }
+}
+
+void DisplayHandler::SendLastFrame() {
+  std::vector<std::pair<std::uint32_t, std::shared_ptr<CvdVideoFrameBuffer>>>
+      frames;
   {
-    // SendLastFrame can be called from multiple threads simultaneously, locking
-    // here avoids injecting frames with the timestamps in the wrong order.
-    std::lock_guard<std::mutex> lock(next_frame_mutex_);
-    int64_t time_stamp =
-        std::chrono::duration_cast<std::chrono::microseconds>(
-            std::chrono::system_clock::now().time_since_epoch())
-            .count();
-
-    auto it = display_sinks_.find(buffer_display);
-    if (it != display_sinks_.end()) {
-      it->second->OnFrame(buffer, time_stamp);
+    std::lock_guard<std::mutex> lock(displays_mutex_);
+    for (auto& [display_number, display] : displays_) {
+      // If a connection request arrives before the first frame is available
+      // don't send any frame.
+      auto buffer = display.frames ? display.frames->LastFrame() : nullptr;
+      if (buffer) {
+        frames.emplace_back(display_number, std::move(buffer));
+      }
     }
   }
+  for (auto& [display_number, buffer] : frames) {
+    SendFrame(display_number, std::move(buffer));
+  }
 }
+
+std::map<std::uint32_t, DisplayHandler::DisplayStats>
+DisplayHandler::GetDisplayStats() {
+  std::lock_guard<std::mutex> lock(displays_mutex_);
+  std::map<std::uint32_t, DisplayStats> stats;
+  for (const auto& [display_number, display] : displays_) {
+    stats[display_number] = GetStats(display);
+  }
+  return stats;
+}
+
 }  // namespace cuttlefish
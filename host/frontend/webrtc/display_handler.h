@@ -16,36 +16,22 @@
 
 #pragma once
 
+#include <cstdint>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <vector>
 
 #include "host/frontend/webrtc/cvd_video_frame_buffer.h"
+#include "host/frontend/webrtc/display_frame_processor.h"
+#include "host/frontend/webrtc/frame_converter.h"
+#include "host/frontend/webrtc/input_latency.h"
 #include "host/frontend/webrtc/libdevice/video_sink.h"
+#include "host/frontend/webrtc/webrtc_sc_processed_frame.h"
 #include "host/libs/screen_connector/screen_connector.h"
 
 namespace cuttlefish {
-/**
- * ScreenConnectorImpl will generate this, and enqueue
- *
- * It's basically a (processed) frame, so it:
- *   must be efficiently std::move-able
- * Also, for the sake of algorithm simplicity:
- *   must be default-constructable & assignable
- *
- */
-struct WebRtcScProcessedFrame : public ScreenConnectorFrameInfo {
-  // must support move semantic
-  std::unique_ptr<CvdVideoFrameBuffer> buf_;
-  std::unique_ptr<WebRtcScProcessedFrame> Clone() {
-    // copy internal buffer, not move
-    CvdVideoFrameBuffer* new_buffer = new CvdVideoFrameBuffer(*(buf_.get()));
-    auto cloned_frame = std::make_unique<WebRtcScProcessedFrame>();
-    cloned_frame->buf_ =
-        std::move(std::unique_ptr<CvdVideoFrameBuffer>(new_buffer));
-    return std::move(cloned_frame);
-  }
-};
 
 namespace webrtc_streaming {
 class Streamer;
@@ -57,22 +43,50 @@ class DisplayHandler {
   using GenerateProcessedFrameCallback = ScreenConnector::GenerateProcessedFrameCallback;
   using WebRtcScProcessedFrame = cuttlefish::WebRtcScProcessedFrame;
 
+  // What happened to the frames of a display.
+  struct DisplayStats {
+    DisplayFrameProcessor::Stats frames;
+    // Frames handed to the display's sink, repeated ones included.
+    std::uint64_t sent = 0;
+  };
+
+  // |input_latency| may be null to not trace the latency of touches.
   DisplayHandler(webrtc_streaming::Streamer& streamer,
-                 ScreenConnector& screen_connector);
+                 ScreenConnector& screen_connector,
+                 std::shared_ptr<InputLatencyTracer> input_latency);
   ~DisplayHandler() = default;
 
   [[noreturn]] void Loop();
+  // Sends the last frame of every display again, for the benefit of new
+  // clients.
   void SendLastFrame();
 
+  std::map<std::uint32_t, DisplayStats> GetDisplayStats();
+
  private:
+  struct Display {
+    std::shared_ptr<webrtc_streaming::VideoSink> sink;
+    // Created with the display's first frame.
+    std::unique_ptr<DisplayFrameProcessor> frames;
+    // Whether the sink had consumers at the last frame.
+    bool watched = false;
+    std::uint64_t sent = 0;
+    std::shared_ptr<DisplayInputLatency> input_latency;
+  };
+
+  static DisplayStats GetStats(const Display& display);
   GenerateProcessedFrameCallback GetScreenConnectorCallback();
-  std::map<uint32_t, std::shared_ptr<webrtc_streaming::VideoSink>>
-      display_sinks_;
+  void SendFrame(std::uint32_t display_number,
+                 std::shared_ptr<CvdVideoFrameBuffer> buffer,
+                 std::optional<InputLatencyTrace> latency_trace = {});
+
   webrtc_streaming::Streamer& streamer_;
   ScreenConnector& screen_connector_;
-  std::shared_ptr<webrtc_streaming::VideoFrameBuffer> last_buffer_;
-  std::uint32_t last_buffer_display_ = 0;
-  std::mutex last_buffer_mutex_;
+  std::shared_ptr<InputLatencyTracer> input_latency_;
   std::mutex next_frame_mutex_;
+  FrameConverter frame_converter_;
+  std::map<std::uint32_t, Display> displays_;
+  // Guards frame_converter_ and displays_.
+  std::mutex displays_mutex_;
 };
 }  // namespace cuttlefish
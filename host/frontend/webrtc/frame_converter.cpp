@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "host/frontend/webrtc/frame_converter.h"
+
+#include <algorithm>
+
+#include <libyuv.h>
+
+namespace cuttlefish {
+namespace {
+
+// Damage is tracked in square blocks of this many pixels. It must be even so
+// that blocks line up with the 2x2 subsampled chroma planes.
+constexpr std::uint32_t kTileSize = 64;
+
+// Below this much work per stripe, waking up another thread costs more than
+// it saves. A quarter of a 720p frame.
+constexpr std::uint64_t kMinPixelsPerStripe = 1280 * 720 / 4;
+
+// More workers than this mostly fight over memory bandwidth, and other
+// displays and instances on the host need the cores too.
+constexpr std::size_t kMaxWorkers = 3;
+
+std::size_t DefaultWorkerCount() {
+  const std::size_t cores = std::thread::hardware_concurrency();
+  if (cores <= 1) {
+    return 0;
+  }
+  return std::min(cores - 1, kMaxWorkers);
+}
+
+}  // namespace
+
+FrameConverter::FrameConverter() : FrameConverter(DefaultWorkerCount()) {}
+
+FrameConverter::FrameConverter(std::size_t num_workers) {
+  for (std::size_t i = 0; i < num_workers; i++) {
+    workers_.emplace_back([this]() { WorkerLoop(); });
+  }
+}
+
+FrameConverter::~FrameConverter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  job_cv_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+std::size_t FrameConverter::StripeCount(std::uint64_t pixels,
+                                        std::size_t threads) {
+  const std::uint64_t stripes = pixels / kMinPixelsPerStripe;
+  return std::clamp<std::uint64_t>(stripes, 1,
+                                   std::max<std::size_t>(threads, 1));
+}
+
+void FrameConverter::Convert(Canvas& canvas, std::uint32_t frame_width,
+                             std::uint32_t frame_height,
+                             std::uint32_t frame_stride_bytes,
+                             const std::uint8_t* frame_pixels,
+                             const FrameDamage& frame_damage,
+                             CvdVideoFrameBuffer& out) {
+  const std::uint32_t tiles_w = (frame_width + kTileSize - 1) / kTileSize;
+  const std::uint32_t tiles_h = (frame_height + kTileSize - 1) / kTileSize;
+
+  bool full_frame = frame_damage.empty();
+  if (!canvas.buffer ||
+      canvas.buffer->width() != static_cast<int>(frame_width) ||
+      canvas.buffer->height() != static_cast<int>(frame_height)) {
+    canvas.buffer =
+        std::make_unique<CvdVideoFrameBuffer>(frame_width, frame_height);
+    full_frame = true;
+  }
+
+  canvas.dirty_tiles.assign(tiles_w * tiles_h, full_frame ? 1 : 0);
+  std::uint64_t dirty_tiles = full_frame ? tiles_w * tiles_h : 0;
+  if (!full_frame) {
+    for (const auto& rect : frame_damage) {
+      // Rectangles were already clipped to the frame by the compositor.
+      const std::uint32_t tile_x0 = rect.x / kTileSize;
+      const std::uint32_t tile_y0 = rect.y / kTileSize;
+      const std::uint32_t tile_x1 = (rect.x + rect.w - 1) / kTileSize;
+      const std::uint32_t tile_y1 = (rect.y + rect.h - 1) / kTileSize;
+      for (std::uint32_t ty = tile_y0; ty <= tile_y1 && ty < tiles_h; ty++) {
+        for (std::uint32_t tx = tile_x0; tx <= tile_x1 && tx < tiles_w; tx++) {
+          auto& tile = canvas.dirty_tiles[ty * tiles_w + tx];
+          dirty_tiles += tile ? 0 : 1;
+          tile = 1;
+        }
+      }
+    }
+  }
+
+  auto& buffer = *canvas.buffer;
+  const std::uint8_t* dirty = canvas.dirty_tiles.data();
+  // Each stripe is a range of tile rows, so stripe boundaries are even and
+  // never split a row of chroma samples.
+  auto convert_tile_rows = [&](std::uint32_t ty_begin, std::uint32_t ty_end) {
+    for (std::uint32_t ty = ty_begin; ty < ty_end; ty++) {
+      const std::uint32_t y = ty * kTileSize;
+      const std::uint32_t h = std::min(kTileSize, frame_height - y);
+      std::uint32_t tx = 0;
+      while (tx < tiles_w) {
+        if (!dirty[ty * tiles_w + tx]) {
+          tx++;
+          continue;
+        }
+        // Convert each horizontal run of dirty tiles with a single call.
+        std::uint32_t run_end = tx + 1;
+        while (run_end < tiles_w && dirty[ty * tiles_w + run_end]) {
+          run_end++;
+        }
+        const std::uint32_t x = tx * kTileSize;
+        const std::uint32_t w = std::min(run_end * kTileSize, frame_width) - x;
+        libyuv::ABGRToI420(
+            frame_pixels + y * frame_stride_bytes + x * 4, frame_stride_bytes,
+            buffer.DataY() + y * buffer.StrideY() + x, buffer.StrideY(),
+            buffer.DataU() + (y / 2) * buffer.StrideU() + x / 2,
+            buffer.StrideU(),
+            buffer.DataV() + (y / 2) * buffer.StrideV() + x / 2,
+            buffer.StrideV(), w, h);
+        tx = run_end;
+      }
+    }
+
+    // The canvas keeps changing while WebRTC encodes the frame, so each
+    // frame gets its own copy.
+    const std::uint32_t y = ty_begin * kTileSize;
+    const std::uint32_t h = std::min(ty_end * kTileSize, frame_height) - y;
+    libyuv::I420Copy(
+        buffer.DataY() + y * buffer.StrideY(), buffer.StrideY(),
+        buffer.DataU() + (y / 2) * buffer.StrideU(), buffer.StrideU(),
+        buffer.DataV() + (y / 2) * buffer.StrideV(), buffer.StrideV(),
+        out.DataY() + y * out.StrideY(), out.StrideY(),
+        out.DataU() + (y / 2) * out.StrideU(), out.StrideU(),
+        out.DataV() + (y / 2) * out.StrideV(), out.StrideV(), frame_width, h);
+  };
+
+  const std::size_t stripes =
+      std::min<std::size_t>(StripeCount(dirty_tiles * kTileSize * kTileSize,
+                                        workers_.size() + 1),
+                            tiles_h);
+  RunStripes(stripes, [&](std::size_t stripe) {
+    convert_tile_rows(stripe * tiles_h / stripes,
+                      (stripe + 1) * tiles_h / stripes);
+  });
+}
+
+void FrameConverter::RunStripes(
+    std::size_t stripes, std::function<void(std::size_t /*stripe*/)> work) {
+  if (stripes <= 1 || workers_.empty()) {
+    for (std::size_t i = 0; i < stripes; i++) {
+      work(i);
+    }
+    return;
+  }
+  // Workers may pick up a job late, after it was completed, so it's shared
+  // with them rather than living on this stack frame.
+  auto job = std::make_shared<Job>();
+  job->work = std::move(work);
+  job->stripes = stripes;
+  job->remaining = stripes;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    job_ = job;
+    job_generation_++;
+  }
+  job_cv_.notify_all();
+
+  RunPendingStripes(*job);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_cv_.wait(lock, [&job]() { return job->remaining == 0; });
+  job_.reset();
+}
+
+void FrameConverter::RunPendingStripes(Job& job) {
+  for (;;) {
+    const std::size_t stripe = job.next_stripe++;
+    if (stripe >= job.stripes) {
+      return;
+    }
+    job.work(stripe);
+    if (--job.remaining == 0) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      done_cv_.notify_all();
+    }
+  }
+}
+
+void FrameConverter::WorkerLoop() {
+  std::uint64_t seen_generation = 0;
+  for (;;) {
+    std::shared_ptr<Job> job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      job_cv_.wait(lock, [this, seen_generation]() {
+        return stopping_ || job_generation_ != seen_generation;
+      });
+      if (stopping_) {
+        return;
+      }
+      seen_generation = job_generation_;
+      job = job_;
+    }
+    if (job) {
+      RunPendingStripes(*job);
+    }
+  }
+}
+
+}  // namespace cuttlefish
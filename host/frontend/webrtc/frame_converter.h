@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "host/frontend/webrtc/cvd_video_frame_buffer.h"
+#include "host/libs/wayland/wayland_server_callbacks.h"
+
+namespace cuttlefish {
+
+// Converts ABGR guest frames to I420, splitting each frame into horizontal
+// stripes that are converted in parallel by a small pool of worker threads
+// and the calling thread.
+class FrameConverter {
+ public:
+  // The last known contents of a display, kept in I420 so that only the
+  // damaged parts of each new guest frame need to be converted.
+  struct Canvas {
+    std::unique_ptr<CvdVideoFrameBuffer> buffer;
+    // One entry per square tile of the frame, non-zero when dirty.
+    std::vector<std::uint8_t> dirty_tiles;
+  };
+
+  // Uses a worker count suited to the number of cores of the host.
+  FrameConverter();
+  explicit FrameConverter(std::size_t num_workers);
+  ~FrameConverter();
+
+  FrameConverter(const FrameConverter&) = delete;
+  FrameConverter& operator=(const FrameConverter&) = delete;
+
+  // Converts the damaged parts of the frame into the canvas and copies the
+  // updated canvas into `out`, which must have the frame's dimensions.
+  // Returns once the frame pixels are no longer needed. Not reentrant.
+  void Convert(Canvas& canvas, std::uint32_t frame_width,
+               std::uint32_t frame_height, std::uint32_t frame_stride_bytes,
+               const std::uint8_t* frame_pixels,
+               const FrameDamage& frame_damage, CvdVideoFrameBuffer& out);
+
+  // The number of stripes worth splitting `pixels` of conversion work into,
+  // given `threads` threads to run them on.
+  static std::size_t StripeCount(std::uint64_t pixels, std::size_t threads);
+
+ private:
+  struct Job {
+    std::function<void(std::size_t)> work;
+    std::size_t stripes;
+    std::atomic<std::size_t> next_stripe{0};
+    std::atomic<std::size_t> remaining;
+  };
+
+  void RunStripes(std::size_t stripes,
+                  std::function<void(std::size_t /*stripe*/)> work);
+  void RunPendingStripes(Job& job);
+  void WorkerLoop();
+
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable job_cv_;
+  std::condition_variable done_cv_;
+  std::shared_ptr<Job> job_;
+  std::uint64_t job_generation_ = 0;
+  bool stopping_ = false;
+};
+
+}  // namespace cuttlefish
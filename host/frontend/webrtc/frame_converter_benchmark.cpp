@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "host/frontend/webrtc/cvd_video_frame_buffer.h"
+#include "host/frontend/webrtc/frame_converter.h"
+
+namespace cuttlefish {
+namespace {
+
+// Measures the time to convert one fully damaged frame, which is what the
+// Wayland server thread waits on for every guest frame.
+void BM_ConvertFullFrame(benchmark::State& state) {
+  const std::uint32_t width = state.range(0);
+  const std::uint32_t height = state.range(1);
+  const std::size_t workers = state.range(2);
+  const std::uint32_t stride = width * 4;
+
+  std::vector<std::uint8_t> pixels(stride * height);
+  for (std::size_t i = 0; i < pixels.size(); i++) {
+    pixels[i] = static_cast<std::uint8_t>(i * 31);
+  }
+  FrameConverter converter(workers);
+  FrameConverter::Canvas canvas;
+  CvdVideoFrameBuffer out(width, height);
+
+  for (auto _ : state) {
+    converter.Convert(canvas, width, height, stride, pixels.data(), {}, out);
+    benchmark::DoNotOptimize(out.DataY());
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * pixels.size());
+}
+
+void Resolutions(benchmark::internal::Benchmark* benchmark) {
+  benchmark->ArgNames({"width", "height", "workers"});
+  for (const auto& [width, height] : std::vector<std::pair<int, int>>{
+           {1280, 720}, {1920, 1080}, {2560, 1440}, {3840, 2160}}) {
+    for (int workers : {0, 1, 3}) {
+      benchmark->Args({width, height, workers});
+    }
+  }
+}
+
+BENCHMARK(BM_ConvertFullFrame)
+    ->Apply(Resolutions)
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace cuttlefish
+
+BENCHMARK_MAIN();
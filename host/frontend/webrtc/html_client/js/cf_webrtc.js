@@ -44,6 +44,36 @@ function createDataChannel(pc, label, onMessage) {
   };
 }
 
+// Binary encoding of the input messages, see
+// host/frontend/webrtc/libdevice/input_protocol.h.
+const kInputProtocolVersion = 1;
+const kInputTypeTouch = 1;
+const kInputTypeMultiTouch = 2;
+const kInputTypeKeyboard = 3;
+const kInputHeaderSize = 4;
+const kInputMaxTouchPoints = 16;
+const inputTextEncoder = new TextEncoder();
+
+// Returns the encoded message, or null if it can't be encoded and should be
+// sent as JSON instead. |writeBody| writes |bodySize| bytes at the given
+// offset of the DataView.
+function encodeInputMessage(type, down, text, bodySize, writeBody) {
+  const textBytes = inputTextEncoder.encode(text);
+  if (textBytes.length > 255) {
+    return null;
+  }
+  const buffer =
+      new ArrayBuffer(kInputHeaderSize + bodySize + textBytes.length);
+  const view = new DataView(buffer);
+  view.setUint8(0, kInputProtocolVersion);
+  view.setUint8(1, type);
+  view.setUint8(2, down ? 1 : 0);
+  view.setUint8(3, textBytes.length);
+  writeBody(view, kInputHeaderSize);
+  new Uint8Array(buffer, kInputHeaderSize + bodySize).set(textBytes);
+  return buffer;
+}
+
 function awaitDataChannel(pc, label, onMessage) {
   console.debug('expecting data channel: ' + label);
   // Return an object with a send function like that of the dataChannel, but
@@ -252,7 +282,24 @@ class DeviceConnection {
     this.#inputChannel.send(JSON.stringify(evt));
   }
 
+  // Devices that don't advertise the binary input protocol only take JSON.
+  #supportsBinaryInput() {
+    return this.#description &&
+        this.#description.input_protocol_version >= kInputProtocolVersion;
+  }
+
   sendMousePosition({x, y, down, display_label}) {
+    if (this.#supportsBinaryInput()) {
+      const msg = encodeInputMessage(
+          kInputTypeTouch, down, display_label, 8, (view, offset) => {
+            view.setInt32(offset, x, true);
+            view.setInt32(offset + 4, y, true);
+          });
+      if (msg) {
+        this.#inputChannel.send(msg);
+        return;
+      }
+    }
     this.#sendJsonInput({
       type: 'mouse',
       down: down ? 1 : 0,
@@ -265,6 +312,25 @@ class DeviceConnection {
   // TODO (b/124121375): This should probably be an array of pointer events and
   // have different properties.
   sendMultiTouch({idArr, xArr, yArr, down, slotArr, display_label}) {
+    if (this.#supportsBinaryInput() && idArr.length <= kInputMaxTouchPoints) {
+      const msg = encodeInputMessage(
+          kInputTypeMultiTouch, down, display_label, 1 + idArr.length * 16,
+          (view, offset) => {
+            view.setUint8(offset, idArr.length);
+            offset += 1;
+            for (let i = 0; i < idArr.length; i++) {
+              view.setInt32(offset, idArr[i], true);
+              view.setInt32(offset + 4, slotArr[i], true);
+              view.setInt32(offset + 8, xArr[i], true);
+              view.setInt32(offset + 12, yArr[i], true);
+              offset += 16;
+            }
+          });
+      if (msg) {
+        this.#inputChannel.send(msg);
+        return;
+      }
+    }
     this.#sendJsonInput({
       type: 'multi-touch',
       id: idArr,
@@ -277,6 +343,14 @@ class DeviceConnection {
   }
 
   sendKeyEvent(code, type) {
+    if (this.#supportsBinaryInput()) {
+      const msg = encodeInputMessage(
+          kInputTypeKeyboard, type == 'keydown', code, 0, () => {});
+      if (msg) {
+        this.#inputChannel.send(msg);
+        return;
+      }
+    }
     this.#sendJsonInput({type: 'keyboard', keycode: code, event_type: type});
   }
 
@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "host/frontend/webrtc/input_latency.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace cuttlefish {
+namespace {
+
+// Touches without a visible effect would otherwise be attributed to whatever
+// unrelated frame comes next, however late.
+constexpr auto kMaxAttributableLatency = std::chrono::seconds(2);
+
+std::chrono::microseconds BucketUpperBound(std::size_t bucket) {
+  return std::chrono::microseconds(
+      std::int64_t{1} << (bucket + LatencyHistogram::kFirstBucketLog2));
+}
+
+}  // namespace
+
+const char* InputLatencyStageName(InputLatencyStage stage) {
+  switch (stage) {
+    case InputLatencyStage::kInputReceived:
+      return "input_received";
+    case InputLatencyStage::kInputWritten:
+      return "input_written";
+    case InputLatencyStage::kCommitted:
+      return "committed";
+    case InputLatencyStage::kFrameCallback:
+      return "frame_callback";
+    case InputLatencyStage::kConverted:
+      return "converted";
+    case InputLatencyStage::kDequeued:
+      return "dequeued";
+    case InputLatencyStage::kSent:
+      return "sent";
+  }
+  return "unknown";
+}
+
+void LatencyHistogram::Add(std::chrono::microseconds duration) {
+  std::size_t bucket = 0;
+  while (bucket + 1 < kBucketCount && duration >= BucketUpperBound(bucket)) {
+    bucket++;
+  }
+  buckets_[bucket]++;
+  count_++;
+  max_ = std::max(max_, duration);
+}
+
+std::chrono::microseconds LatencyHistogram::Quantile(double quantile) const {
+  if (count_ == 0) {
+    return std::chrono::microseconds(0);
+  }
+  auto rank = static_cast<std::uint64_t>(std::ceil(quantile * count_));
+  std::uint64_t seen = 0;
+  for (std::size_t bucket = 0; bucket + 1 < kBucketCount; bucket++) {
+    seen += buckets_[bucket];
+    if (seen >= rank) {
+      return std::min(BucketUpperBound(bucket), max_);
+    }
+  }
+  return max_;
+}
+
+Json::Value LatencyHistogram::ToJson() const {
+  Json::Value json;
+  json["count"] = static_cast<Json::UInt64>(count_);
+  json["p50_us"] = static_cast<Json::Int64>(Quantile(0.5).count());
+  json["p90_us"] = static_cast<Json::Int64>(Quantile(0.9).count());
+  json["p99_us"] = static_cast<Json::Int64>(Quantile(0.99).count());
+  json["max_us"] = static_cast<Json::Int64>(max_.count());
+  // Only the buckets in use, as [upper bound in us, count] pairs, the last
+  // bucket having no upper bound.
+  Json::Value buckets(Json::arrayValue);
+  for (std::size_t bucket = 0; bucket < kBucketCount; bucket++) {
+    if (buckets_[bucket] == 0) {
+      continue;
+    }
+    Json::Value entry(Json::arrayValue);
+    if (bucket + 1 < kBucketCount) {
+      entry.append(static_cast<Json::Int64>(BucketUpperBound(bucket).count()));
+    } else {
+      entry.append(Json::Value());
+    }
+    entry.append(static_cast<Json::UInt64>(buckets_[bucket]));
+    buckets.append(entry);
+  }
+  json["buckets"] = buckets;
+  return json;
+}
+
+void DisplayInputLatency::InputReceived() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!received_) {
+    received_ = InputLatencyTrace::Clock::now();
+  }
+}
+
+void DisplayInputLatency::InputWritten(
+    InputLatencyTrace::Clock::time_point taken) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (received_ && *received_ <= taken && !written_) {
+    written_ = InputLatencyTrace::Clock::now();
+  }
+}
+
+std::optional<InputLatencyTrace> DisplayInputLatency::TakeTrace(
+    InputLatencyTrace::Clock::time_point commit_time) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  // A frame committed before the touch reached the guest can't reflect it.
+  if (!written_ || *written_ > commit_time) {
+    return std::nullopt;
+  }
+  InputLatencyTrace trace;
+  trace.Stamp(InputLatencyStage::kInputReceived, *received_);
+  trace.Stamp(InputLatencyStage::kInputWritten, *written_);
+  trace.Stamp(InputLatencyStage::kCommitted, commit_time);
+  bool attributable = commit_time - *received_ <= kMaxAttributableLatency;
+  received_.reset();
+  written_.reset();
+  if (!attributable) {
+    return std::nullopt;
+  }
+  return trace;
+}
+
+void DisplayInputLatency::Record(const InputLatencyTrace& trace) {
+  auto received = trace.Get(InputLatencyStage::kInputReceived);
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (std::size_t i = 1; i < kInputLatencyStageCount; i++) {
+    auto stage = static_cast<InputLatencyStage>(i);
+    histograms_[i].Add(std::chrono::duration_cast<std::chrono::microseconds>(
+        trace.Get(stage) - received));
+  }
+}
+
+std::uint64_t DisplayInputLatency::frames() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return histograms_[kInputLatencyStageCount - 1].count();
+}
+
+Json::Value DisplayInputLatency::ToJson() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Json::Value json;
+  json["frames"] = static_cast<Json::UInt64>(
+      histograms_[kInputLatencyStageCount - 1].count());
+  // Each stage's histogram measures the time since the touch was received.
+  Json::Value stages;
+  for (std::size_t i = 1; i < kInputLatencyStageCount; i++) {
+    stages[InputLatencyStageName(static_cast<InputLatencyStage>(i))] =
+        histograms_[i].ToJson();
+  }
+  json["since_input_received"] = stages;
+  return json;
+}
+
+std::shared_ptr<DisplayInputLatency> InputLatencyTracer::ForDisplay(
+    const std::string& display_label) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& display = displays_[display_label];
+  if (!display) {
+    display = std::make_shared<DisplayInputLatency>();
+  }
+  return display;
+}
+
+std::uint64_t InputLatencyTracer::frames() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::uint64_t frames = 0;
+  for (auto& [label, display] : displays_) {
+    frames += display->frames();
+  }
+  return frames;
+}
+
+Json::Value InputLatencyTracer::Report() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Json::Value report(Json::objectValue);
+  for (auto& [label, display] : displays_) {
+    report[label] = display->ToJson();
+  }
+  return report;
+}
+
+}  // namespace cuttlefish
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+
+#include <json/json.h>
+
+namespace cuttlefish {
+
+// The stages between a touch reaching the streamer and the first frame
+// showing its effect leaving it, in order.
+enum class InputLatencyStage : std::size_t {
+  // The client's input event arrived.
+  kInputReceived,
+  // The event was written to the virtio-input socket.
+  kInputWritten,
+  // The guest committed a frame to the wayland surface.
+  kCommitted,
+  // The screen connector handed the frame to the display handler.
+  kFrameCallback,
+  // The frame was converted for the encoders.
+  kConverted,
+  // The frame was taken out of the screen connector's queue.
+  kDequeued,
+  // The frame was handed to the display's video sink.
+  kSent,
+};
+constexpr std::size_t kInputLatencyStageCount =
+    static_cast<std::size_t>(InputLatencyStage::kSent) + 1;
+
+const char* InputLatencyStageName(InputLatencyStage stage);
+
+// The timestamps of one frame through the stages, travels with the frame.
+class InputLatencyTrace {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  void Stamp(InputLatencyStage stage, Clock::time_point time = Clock::now()) {
+    stamps_[static_cast<std::size_t>(stage)] = time;
+  }
+  Clock::time_point Get(InputLatencyStage stage) const {
+    return stamps_[static_cast<std::size_t>(stage)];
+  }
+
+ private:
+  std::array<Clock::time_point, kInputLatencyStageCount> stamps_;
+};
+
+// Counts durations in power of two buckets of microseconds.
+class LatencyHistogram {
+ public:
+  // Bucket i counts durations below 2^(i + kFirstBucketLog2) us, the last one
+  // everything else. The first is under 64us, the last over 8s.
+  static constexpr int kFirstBucketLog2 = 6;
+  static constexpr std::size_t kBucketCount = 18;
+
+  void Add(std::chrono::microseconds duration);
+
+  std::uint64_t count() const { return count_; }
+  // An upper bound of the given quantile, in (0, 1].
+  std::chrono::microseconds Quantile(double quantile) const;
+
+  Json::Value ToJson() const;
+
+ private:
+  std::array<std::uint64_t, kBucketCount> buckets_{};
+  std::uint64_t count_ = 0;
+  std::chrono::microseconds max_{0};
+};
+
+// Latency of the touches on a display. Every frame the guest commits is
+// attributed the oldest touch written to the guest since the previous frame
+// that changed the display, so each histogram sample goes from a touch to the
+// first visible frame that could reflect it.
+class DisplayInputLatency {
+ public:
+  // Called as touch events for the display arrive, and after writing to the
+  // guest the events queued up to |taken|.
+  void InputReceived();
+  void InputWritten(InputLatencyTrace::Clock::time_point taken);
+
+  // Called for a frame that changed the display. Returns the frame's trace if
+  // it answers a touch.
+  std::optional<InputLatencyTrace> TakeTrace(
+      InputLatencyTrace::Clock::time_point commit_time);
+
+  // Records the stages of a frame once it was sent.
+  void Record(const InputLatencyTrace& trace);
+
+  // Samples recorded so far.
+  std::uint64_t frames();
+  Json::Value ToJson();
+
+ private:
+  std::mutex mutex_;
+  std::optional<InputLatencyTrace::Clock::time_point> received_;
+  std::optional<InputLatencyTrace::Clock::time_point> written_;
+  // Time from kInputReceived to each of the other stages.
+  std::array<LatencyHistogram, kInputLatencyStageCount> histograms_;
+};
+
+// Keeps the input latency of every display of the device.
+class InputLatencyTracer {
+ public:
+  // |display_label| as the displays are named to clients, e.g. "display_0".
+  std::shared_ptr<DisplayInputLatency> ForDisplay(
+      const std::string& display_label);
+
+  // Frames recorded over all displays, to tell whether the report changed.
+  std::uint64_t frames();
+  // Histograms of every display, by label.
+  Json::Value Report();
+
+ private:
+  std::mutex mutex_;
+  std::map<std::string, std::shared_ptr<DisplayInputLatency>> displays_;
+};
+
+}  // namespace cuttlefish
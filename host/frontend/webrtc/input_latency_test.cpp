@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "host/frontend/webrtc/input_latency.h"
+
+#include <chrono>
+#include <cstring>
+
+#include <gtest/gtest.h>
+
+#include "host/frontend/webrtc/webrtc_sc_processed_frame.h"
+
+namespace cuttlefish {
+namespace {
+
+using std::chrono::microseconds;
+using Clock = InputLatencyTrace::Clock;
+
+// The [upper bound, count] pairs of the buckets in use.
+Json::Value Buckets(const LatencyHistogram& histogram) {
+  return histogram.ToJson()["buckets"];
+}
+
+Json::Value Bucket(Json::Int64 upper_bound, Json::UInt64 count) {
+  Json::Value bucket(Json::arrayValue);
+  bucket.append(upper_bound);
+  bucket.append(count);
+  return bucket;
+}
+
+TEST(LatencyHistogramTest, BucketsByPowersOfTwo) {
+  LatencyHistogram histogram;
+  histogram.Add(microseconds(0));
+  histogram.Add(microseconds(63));
+  histogram.Add(microseconds(64));
+  histogram.Add(microseconds(127));
+  histogram.Add(microseconds(128));
+
+  Json::Value expected(Json::arrayValue);
+  expected.append(Bucket(64, 2));
+  expected.append(Bucket(128, 2));
+  expected.append(Bucket(256, 1));
+  EXPECT_EQ(Buckets(histogram), expected);
+  EXPECT_EQ(histogram.count(), 5);
+}
+
+TEST(LatencyHistogramTest, LastBucketHasNoUpperBound) {
+  LatencyHistogram histogram;
+  const auto last_bound = microseconds(
+      std::int64_t{1} << (LatencyHistogram::kBucketCount - 2 +
+                          LatencyHistogram::kFirstBucketLog2));
+  histogram.Add(last_bound - microseconds(1));
+  histogram.Add(last_bound);
+  histogram.Add(std::chrono::hours(1));
+
+  auto buckets = Buckets(histogram);
+
+  ASSERT_EQ(buckets.size(), 2);
+  EXPECT_EQ(buckets[0], Bucket(last_bound.count(), 1));
+  EXPECT_TRUE(buckets[1][0].isNull());
+  EXPECT_EQ(buckets[1][1].asUInt64(), 2);
+}
+
+TEST(LatencyHistogramTest, QuantilesAreBucketBoundsCappedByMax) {
+  LatencyHistogram histogram;
+  for (int i = 0; i < 9; i++) {
+    histogram.Add(microseconds(100));
+  }
+  histogram.Add(microseconds(1000));
+
+  EXPECT_EQ(histogram.Quantile(0.5), microseconds(128));
+  EXPECT_EQ(histogram.Quantile(0.9), microseconds(128));
+  EXPECT_EQ(histogram.Quantile(0.99), microseconds(1000));
+  EXPECT_EQ(histogram.Quantile(1), microseconds(1000));
+  EXPECT_EQ(LatencyHistogram().Quantile(0.5), microseconds(0));
+}
+
+TEST(DisplayInputLatencyTest, TracesOnlyTheFirstFrameAfterATouch) {
+  DisplayInputLatency latency;
+  latency.InputReceived();
+  latency.InputReceived();
+  latency.InputWritten(Clock::now());
+  auto commit_time = Clock::now();
+
+  auto trace = latency.TakeTrace(commit_time);
+
+  ASSERT_TRUE(trace.has_value());
+  EXPECT_LE(trace->Get(InputLatencyStage::kInputReceived),
+            trace->Get(InputLatencyStage::kInputWritten));
+  EXPECT_EQ(trace->Get(InputLatencyStage::kCommitted), commit_time);
+  EXPECT_FALSE(latency.TakeTrace(Clock::now()).has_value());
+}
+
+TEST(DisplayInputLatencyTest, IgnoresFramesCommittedBeforeTheTouchWasWritten) {
+  DisplayInputLatency latency;
+  auto early_commit = Clock::now();
+  EXPECT_FALSE(latency.TakeTrace(early_commit).has_value());
+
+  latency.InputReceived();
+  EXPECT_FALSE(latency.TakeTrace(Clock::now()).has_value());
+  latency.InputWritten(Clock::now());
+  EXPECT_FALSE(latency.TakeTrace(early_commit).has_value());
+
+  EXPECT_TRUE(latency.TakeTrace(Clock::now()).has_value());
+}
+
+TEST(DisplayInputLatencyTest, IgnoresWritesOfEarlierEvents) {
+  DisplayInputLatency latency;
+  auto taken = Clock::now();
+  latency.InputReceived();
+
+  latency.InputWritten(taken);
+
+  EXPECT_FALSE(latency.TakeTrace(Clock::now()).has_value());
+}
+
+TEST(DisplayInputLatencyTest, DropsTouchesWithoutTimelyFrames) {
+  DisplayInputLatency latency;
+  latency.InputReceived();
+  latency.InputWritten(Clock::now());
+
+  EXPECT_FALSE(
+      latency.TakeTrace(Clock::now() + std::chrono::seconds(3)).has_value());
+  EXPECT_FALSE(latency.TakeTrace(Clock::now()).has_value());
+}
+
+TEST(DisplayInputLatencyTest, RecordsTimeSinceInputForEachStage) {
+  DisplayInputLatency latency;
+  InputLatencyTrace trace;
+  auto received = Clock::now();
+  for (std::size_t i = 0; i < kInputLatencyStageCount; i++) {
+    trace.Stamp(static_cast<InputLatencyStage>(i),
+                received + microseconds(100) * i);
+  }
+
+  latency.Record(trace);
+
+  EXPECT_EQ(latency.frames(), 1);
+  auto stages = latency.ToJson()["since_input_received"];
+  EXPECT_FALSE(stages.isMember("input_received"));
+  EXPECT_EQ(stages["input_written"]["max_us"].asInt64(), 100);
+  EXPECT_EQ(stages["sent"]["max_us"].asInt64(),
+            100 * (kInputLatencyStageCount - 1));
+}
+
+TEST(InputLatencyTracerTest, KeepsOneTrackerPerDisplay) {
+  InputLatencyTracer tracer;
+  auto display_0 = tracer.ForDisplay("display_0");
+  auto display_1 = tracer.ForDisplay("display_1");
+  EXPECT_EQ(tracer.ForDisplay("display_0"), display_0);
+  EXPECT_NE(display_0, display_1);
+
+  InputLatencyTrace trace;
+  display_0->Record(trace);
+  display_0->Record(trace);
+  display_1->Record(trace);
+
+  EXPECT_EQ(tracer.frames(), 3);
+  auto report = tracer.Report();
+  EXPECT_EQ(report["display_0"]["frames"].asUInt64(), 2);
+  EXPECT_EQ(report["display_1"]["frames"].asUInt64(), 1);
+}
+
+TEST(WebRtcScProcessedFrameTest, CloneKeepsTheLatencyTrace) {
+  WebRtcScProcessedFrame frame;
+  frame.buf_ = std::make_shared<CvdVideoFrameBuffer>(4, 2);
+  memset(frame.buf_->DataY(), 42, frame.buf_->StrideY() * 2);
+  frame.latency_trace_.emplace();
+  auto converted = Clock::now();
+  frame.latency_trace_->Stamp(InputLatencyStage::kConverted, converted);
+
+  auto clone = frame.Clone();
+
+  ASSERT_TRUE(clone->latency_trace_.has_value());
+  EXPECT_EQ(clone->latency_trace_->Get(InputLatencyStage::kConverted),
+            converted);
+  ASSERT_NE(clone->buf_, frame.buf_);
+  EXPECT_EQ(clone->buf_->DataY()[0], 42);
+  EXPECT_FALSE(WebRtcScProcessedFrame().latency_trace_.has_value());
+}
+
+}  // namespace
+}  // namespace cuttlefish
@@ -46,14 +46,21 @@ Result<rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface>>
 CreatePeerConnectionFactory(
     rtc::Thread* network_thread, rtc::Thread* worker_thread,
     rtc::Thread* signal_thread,
-    rtc::scoped_refptr<webrtc::AudioDeviceModule> audio_device_module) {
+    rtc::scoped_refptr<webrtc::AudioDeviceModule> audio_device_module,
+    std::shared_ptr<SharedVideoEncoders> shared_video_encoders) {
+  std::unique_ptr<webrtc::VideoEncoderFactory> video_encoder_factory;
+  if (shared_video_encoders) {
+    video_encoder_factory = shared_video_encoders->CreateEncoderFactory();
+  } else {
+    // Only VP8 is supported
+    video_encoder_factory = std::make_unique<VP8OnlyEncoderFactory>(
+        webrtc::CreateBuiltinVideoEncoderFactory());
+  }
   auto peer_connection_factory = webrtc::CreatePeerConnectionFactory(
       network_thread, worker_thread, signal_thread, audio_device_module,
       webrtc::CreateBuiltinAudioEncoderFactory(),
       webrtc::CreateBuiltinAudioDecoderFactory(),
-      // Only VP8 is supported
-      std::make_unique<VP8OnlyEncoderFactory>(
-          webrtc::CreateBuiltinVideoEncoderFactory()),
+      std::move(video_encoder_factory),
       webrtc::CreateBuiltinVideoDecoderFactory(), nullptr /* audio_mixer */,
       nullptr /* audio_processing */);
   CF_EXPECT(peer_connection_factory.get(),
@@ -20,6 +20,7 @@
 #include <api/peer_connection_interface.h>
 
 #include "common/libs/utils/result.h"
+#include "host/frontend/webrtc/libcommon/shared_video_encoder.h"
 
 namespace cuttlefish {
 namespace webrtc_streaming {
@@ -27,11 +28,14 @@ namespace webrtc_streaming {
 Result<std::unique_ptr<rtc::Thread>> CreateAndStartThread(
     const std::string& name);
 
+// Peers get a VP8 encoder each, unless |shared_video_encoders| is given, in
+// which case their encoders come from it.
 Result<rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface>>
 CreatePeerConnectionFactory(
     rtc::Thread* network_thread, rtc::Thread* worker_thread,
     rtc::Thread* signal_thread,
-    rtc::scoped_refptr<webrtc::AudioDeviceModule> audio_device_module);
+    rtc::scoped_refptr<webrtc::AudioDeviceModule> audio_device_module,
+    std::shared_ptr<SharedVideoEncoders> shared_video_encoders);
 
 // TODO(b/263528313): Use a packet socket factory instead of a port range.
 Result<rtc::scoped_refptr<webrtc::PeerConnectionInterface>>
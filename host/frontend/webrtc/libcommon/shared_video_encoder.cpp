@@ -0,0 +1,453 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "host/frontend/webrtc/libcommon/shared_video_encoder.h"
+
+#include <algorithm>
+
+#include <android-base/logging.h>
+#include <api/video/video_bitrate_allocation.h>
+#include <modules/video_coding/include/video_error_codes.h>
+
+namespace cuttlefish {
+namespace webrtc_streaming {
+
+namespace {
+
+// How many outputs an encoding keeps for subscribers which fall behind. Those
+// further behind than this start over from a new key frame.
+constexpr size_t kMaxHistory = 16;
+
+constexpr uint32_t kRtpTicksPerMs = 90;
+
+// Stands in for a regular encoder for one peer. Tagged frames are handed to a
+// shared encoding, anything else goes to a private encoder.
+class SharedVideoEncoder : public webrtc::VideoEncoder {
+ public:
+  SharedVideoEncoder(std::shared_ptr<SharedVideoEncoders> encoders,
+                     const webrtc::SdpVideoFormat& format)
+      : encoders_(encoders), format_(format) {}
+  ~SharedVideoEncoder() override { Release(); }
+
+  int InitEncode(const webrtc::VideoCodec* codec,
+                 const webrtc::VideoEncoder::Settings& settings) override {
+    Release();
+    codec_ = *codec;
+    settings_ = settings;
+    return WEBRTC_VIDEO_CODEC_OK;
+  }
+
+  int32_t RegisterEncodeCompleteCallback(
+      webrtc::EncodedImageCallback* callback) override {
+    callback_ = callback;
+    if (private_encoder_) {
+      private_encoder_->RegisterEncodeCompleteCallback(callback);
+    }
+    return WEBRTC_VIDEO_CODEC_OK;
+  }
+
+  int32_t Release() override {
+    encoding_.reset();
+    encoding_group_.reset();
+    subscription_ = {};
+    if (private_encoder_) {
+      private_encoder_->Release();
+      private_encoder_.reset();
+    }
+    return WEBRTC_VIDEO_CODEC_OK;
+  }
+
+  int32_t Encode(
+      const webrtc::VideoFrame& frame,
+      const std::vector<webrtc::VideoFrameType>* frame_types) override {
+    if (!callback_ || !settings_) {
+      return WEBRTC_VIDEO_CODEC_UNINITIALIZED;
+    }
+    bool key_frame =
+        frame_types &&
+        std::find(frame_types->begin(), frame_types->end(),
+                  webrtc::VideoFrameType::kVideoFrameKey) != frame_types->end();
+
+    auto group = encoders_->FindGroup(frame.video_frame_buffer().get());
+    if (!group || frame.width() != codec_.width ||
+        frame.height() != codec_.height) {
+      return EncodePrivately(frame, frame_types);
+    }
+
+    auto bitrate = SharedVideoEncoders::PickEncodingBitrate(
+        target_bps_, encoding_ ? encoding_->bitrate_bps() : 0);
+    if (!encoding_ || encoding_group_ != group ||
+        encoding_->bitrate_bps() != bitrate) {
+      encoding_ = group->GetEncoding(bitrate, format_, codec_, *settings_);
+      encoding_group_ = group;
+      // The new encoding's output needs to start at a key frame, which the
+      // encoding takes care of for new subscriptions.
+      subscription_ = {};
+      if (!encoding_) {
+        return EncodePrivately(frame, frame_types);
+      }
+    }
+    if (private_encoder_) {
+      private_encoder_->Release();
+      private_encoder_.reset();
+    }
+
+    std::vector<SharedVideoEncoders::Encoding::Output> outputs;
+    auto rc = encoding_->Encode(frame, key_frame, subscription_, outputs);
+    for (auto& output : outputs) {
+      // Every peer converts capture times to RTP timestamps with its own
+      // offset, translate them to this peer's.
+      auto behind_ms = static_cast<uint32_t>(frame.timestamp_us() / 1000 -
+                                             output.timestamp_us / 1000);
+      output.image.SetTimestamp(frame.timestamp() - kRtpTicksPerMs * behind_ms);
+      callback_->OnEncodedImage(output.image, &output.info);
+    }
+    return rc;
+  }
+
+  void SetRates(const RateControlParameters& parameters) override {
+    rates_ = parameters;
+    target_bps_ = parameters.bitrate.get_sum_bps();
+    if (private_encoder_) {
+      private_encoder_->SetRates(parameters);
+    }
+  }
+
+  EncoderInfo GetEncoderInfo() const override {
+    EncoderInfo info;
+    if (private_encoder_) {
+      info = private_encoder_->GetEncoderInfo();
+    } else if (encoding_) {
+      info = encoding_->GetEncoderInfo();
+    }
+    info.implementation_name = "SharedVideoEncoder";
+    // Scaling the frames down for a peer makes them private to it, lower
+    // bitrates come from picking a different encoding instead.
+    info.scaling_settings = webrtc::VideoEncoder::ScalingSettings::kOff;
+    return info;
+  }
+
+ private:
+  int32_t EncodePrivately(
+      const webrtc::VideoFrame& frame,
+      const std::vector<webrtc::VideoFrameType>* frame_types) {
+    encoding_.reset();
+    encoding_group_.reset();
+    subscription_ = {};
+    std::vector<webrtc::VideoFrameType> key_frame_types;
+    if (!private_encoder_) {
+      private_encoder_ = encoders_->inner_factory().CreateVideoEncoder(format_);
+      if (!private_encoder_) {
+        LOG(ERROR) << "Failed to create private video encoder";
+        return WEBRTC_VIDEO_CODEC_ERROR;
+      }
+      auto rc = private_encoder_->InitEncode(&codec_, *settings_);
+      if (rc != WEBRTC_VIDEO_CODEC_OK) {
+        LOG(ERROR) << "Failed to initialize private video encoder: " << rc;
+        private_encoder_.reset();
+        return rc;
+      }
+      private_encoder_->RegisterEncodeCompleteCallback(callback_);
+      if (rates_) {
+        private_encoder_->SetRates(*rates_);
+      }
+      // The peer may have been receiving a shared encoding until now.
+      key_frame_types.assign(
+          frame_types ? frame_types->size() : 1,
+          webrtc::VideoFrameType::kVideoFrameKey);
+      frame_types = &key_frame_types;
+    }
+    return private_encoder_->Encode(frame, frame_types);
+  }
+
+  std::shared_ptr<SharedVideoEncoders> encoders_;
+  const webrtc::SdpVideoFormat format_;
+  webrtc::VideoCodec codec_ = {};
+  std::optional<webrtc::VideoEncoder::Settings> settings_;
+  std::optional<RateControlParameters> rates_;
+  uint32_t target_bps_ = 0;
+  webrtc::EncodedImageCallback* callback_ = nullptr;
+
+  std::shared_ptr<SharedVideoEncoders::Group> encoding_group_;
+  std::shared_ptr<SharedVideoEncoders::Encoding> encoding_;
+  SharedVideoEncoders::Encoding::Subscription subscription_;
+  std::unique_ptr<webrtc::VideoEncoder> private_encoder_;
+};
+
+class SharedVideoEncoderFactory : public webrtc::VideoEncoderFactory {
+ public:
+  SharedVideoEncoderFactory(std::shared_ptr<SharedVideoEncoders> encoders)
+      : encoders_(encoders) {}
+
+  std::vector<webrtc::SdpVideoFormat> GetSupportedFormats() const override {
+    return encoders_->inner_factory().GetSupportedFormats();
+  }
+
+  std::unique_ptr<webrtc::VideoEncoder> CreateVideoEncoder(
+      const webrtc::SdpVideoFormat& format) override {
+    return std::make_unique<SharedVideoEncoder>(encoders_, format);
+  }
+
+  std::unique_ptr<EncoderSelectorInterface> GetEncoderSelector()
+      const override {
+    return encoders_->inner_factory().GetEncoderSelector();
+  }
+
+ private:
+  std::shared_ptr<SharedVideoEncoders> encoders_;
+};
+
+}  // namespace
+
+SharedVideoEncoders::FrameTag::FrameTag(std::shared_ptr<Group> group,
+                                        const webrtc::VideoFrameBuffer* buffer)
+    : group_(group), buffer_(buffer) {
+  if (group_) {
+    group_->encoders().Tag(buffer_, group_);
+  }
+}
+
+SharedVideoEncoders::FrameTag::~FrameTag() {
+  if (group_) {
+    group_->encoders().Untag(buffer_);
+  }
+}
+
+const std::vector<uint32_t>& SharedVideoEncoders::EncodingBitrates() {
+  static const std::vector<uint32_t> bitrates = {500'000, 1'500'000,
+                                                 4'000'000};
+  return bitrates;
+}
+
+uint32_t SharedVideoEncoders::PickEncodingBitrate(uint32_t target_bps,
+                                                  uint32_t current) {
+  const auto& bitrates = EncodingBitrates();
+  uint32_t pick = bitrates.front();
+  for (auto bitrate : bitrates) {
+    if (bitrate <= target_bps) {
+      pick = bitrate;
+    }
+  }
+  if (current != 0 && pick < current &&
+      static_cast<uint64_t>(target_bps) * 5 >=
+          static_cast<uint64_t>(current) * 4) {
+    return current;
+  }
+  return pick;
+}
+
+std::shared_ptr<SharedVideoEncoders> SharedVideoEncoders::Create(
+    std::unique_ptr<webrtc::VideoEncoderFactory> inner) {
+  return std::shared_ptr<SharedVideoEncoders>(
+      new SharedVideoEncoders(std::move(inner)));
+}
+
+SharedVideoEncoders::SharedVideoEncoders(
+    std::unique_ptr<webrtc::VideoEncoderFactory> inner)
+    : inner_(std::move(inner)) {}
+
+std::shared_ptr<SharedVideoEncoders::Group> SharedVideoEncoders::CreateGroup() {
+  return std::make_shared<Group>(shared_from_this());
+}
+
+std::unique_ptr<webrtc::VideoEncoderFactory>
+SharedVideoEncoders::CreateEncoderFactory() {
+  return std::make_unique<SharedVideoEncoderFactory>(shared_from_this());
+}
+
+std::shared_ptr<SharedVideoEncoders::Group> SharedVideoEncoders::FindGroup(
+    const webrtc::VideoFrameBuffer* buffer) {
+  std::lock_guard<std::mutex> lock(tags_mutex_);
+  auto it = tags_.find(buffer);
+  return it != tags_.end() ? it->second.lock() : nullptr;
+}
+
+void SharedVideoEncoders::Tag(const webrtc::VideoFrameBuffer* buffer,
+                              std::weak_ptr<Group> group) {
+  std::lock_guard<std::mutex> lock(tags_mutex_);
+  tags_[buffer] = group;
+}
+
+void SharedVideoEncoders::Untag(const webrtc::VideoFrameBuffer* buffer) {
+  std::lock_guard<std::mutex> lock(tags_mutex_);
+  tags_.erase(buffer);
+}
+
+SharedVideoEncoders::Group::Group(std::shared_ptr<SharedVideoEncoders> encoders)
+    : encoders_(encoders) {}
+
+std::shared_ptr<SharedVideoEncoders::Encoding>
+SharedVideoEncoders::Group::GetEncoding(
+    uint32_t bitrate_bps, const webrtc::SdpVideoFormat& format,
+    const webrtc::VideoCodec& codec,
+    const webrtc::VideoEncoder::Settings& settings) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& slot = encodings_[bitrate_bps];
+  auto encoding = slot.lock();
+  if (encoding && encoding->codec().width == codec.width &&
+      encoding->codec().height == codec.height) {
+    return encoding;
+  }
+  // Peers subscribed to an encoding of a different size keep it until they
+  // move on, it just can't be found here anymore.
+
+  auto encoder = encoders_->inner_factory().CreateVideoEncoder(format);
+  if (!encoder) {
+    LOG(ERROR) << "Failed to create shared video encoder";
+    return nullptr;
+  }
+  auto shared_codec = codec;
+  shared_codec.startBitrate = bitrate_bps / 1000;
+  shared_codec.maxBitrate = bitrate_bps / 1000;
+  shared_codec.minBitrate = 0;
+  if (shared_codec.codecType == webrtc::kVideoCodecVP8) {
+    // The bitrate is allocated to a single layer.
+    shared_codec.VP8()->numberOfTemporalLayers = 1;
+    shared_codec.simulcastStream[0].numberOfTemporalLayers = 1;
+  }
+  auto rc = encoder->InitEncode(&shared_codec, settings);
+  if (rc != WEBRTC_VIDEO_CODEC_OK) {
+    LOG(ERROR) << "Failed to initialize shared video encoder: " << rc;
+    return nullptr;
+  }
+  encoding =
+      std::make_shared<Encoding>(std::move(encoder), shared_codec, bitrate_bps);
+  slot = encoding;
+  return encoding;
+}
+
+SharedVideoEncoders::Encoding::Encoding(
+    std::unique_ptr<webrtc::VideoEncoder> encoder,
+    const webrtc::VideoCodec& codec, uint32_t bitrate_bps)
+    : encoder_(std::move(encoder)), codec_(codec), bitrate_bps_(bitrate_bps) {
+  encoder_->RegisterEncodeCompleteCallback(this);
+  webrtc::VideoBitrateAllocation allocation;
+  allocation.SetBitrate(0, 0, bitrate_bps_);
+  encoder_->SetRates(webrtc::VideoEncoder::RateControlParameters(
+      allocation, std::max<uint32_t>(codec_.maxFramerate, 1)));
+}
+
+SharedVideoEncoders::Encoding::~Encoding() { encoder_->Release(); }
+
+int32_t SharedVideoEncoders::Encoding::Encode(const webrtc::VideoFrame& frame,
+                                              bool key_frame,
+                                              Subscription& subscription,
+                                              std::vector<Output>& outputs) {
+  std::lock_guard<std::mutex> lock(encode_mutex_);
+  // A subscriber presenting a frame another one already had encoded as a
+  // key frame receives that key frame, it doesn't need another one.
+  if (key_frame && frame.timestamp_us() > last_key_frame_us_) {
+    key_frame_pending_ = true;
+  }
+  int32_t rc = WEBRTC_VIDEO_CODEC_OK;
+  if (frame.timestamp_us() > last_encoded_us_) {
+    {
+      std::lock_guard<std::mutex> outputs_lock(outputs_mutex_);
+      in_flight_.emplace_back(frame.timestamp(), frame.timestamp_us());
+    }
+    std::vector<webrtc::VideoFrameType> types = {
+        key_frame_pending_ ? webrtc::VideoFrameType::kVideoFrameKey
+                           : webrtc::VideoFrameType::kVideoFrameDelta};
+    rc = encoder_->Encode(frame, &types);
+    if (rc == WEBRTC_VIDEO_CODEC_OK) {
+      last_encoded_us_ = frame.timestamp_us();
+      if (key_frame_pending_) {
+        last_key_frame_us_ = frame.timestamp_us();
+      }
+      key_frame_pending_ = false;
+    } else {
+      LOG(ERROR) << "Shared video encoder failed to encode frame: " << rc;
+    }
+  }
+  CollectOutputs(frame.timestamp_us(), subscription, outputs);
+  return rc;
+}
+
+void SharedVideoEncoders::Encoding::CollectOutputs(
+    int64_t timestamp_us, Subscription& subscription,
+    std::vector<Output>& outputs) {
+  std::lock_guard<std::mutex> lock(outputs_mutex_);
+  auto start = history_.end();
+  if (subscription.next_sequence && !history_.empty() &&
+      history_.front().sequence <= *subscription.next_sequence) {
+    start = history_.begin() +
+            (*subscription.next_sequence - history_.front().sequence);
+  } else if (subscription.next_sequence && history_.empty()) {
+    start = history_.begin();
+  } else {
+    // New or too far behind, start at the last key frame it can use.
+    for (auto it = history_.rbegin(); it != history_.rend(); it++) {
+      if (it->timestamp_us <= timestamp_us &&
+          it->image._frameType == webrtc::VideoFrameType::kVideoFrameKey) {
+        start = std::prev(it.base());
+        break;
+      }
+    }
+    if (start == history_.end()) {
+      // Merged with any other request, the next frame will be a key frame.
+      key_frame_pending_ = true;
+      return;
+    }
+  }
+  for (auto it = start;
+       it != history_.end() && it->timestamp_us <= timestamp_us; it++) {
+    outputs.push_back(*it);
+    subscription.next_sequence = it->sequence + 1;
+  }
+}
+
+webrtc::VideoEncoder::EncoderInfo
+SharedVideoEncoders::Encoding::GetEncoderInfo() const {
+  return encoder_->GetEncoderInfo();
+}
+
+webrtc::EncodedImageCallback::Result
+SharedVideoEncoders::Encoding::OnEncodedImage(
+    const webrtc::EncodedImage& encoded_image,
+    const webrtc::CodecSpecificInfo* codec_specific_info) {
+  std::lock_guard<std::mutex> lock(outputs_mutex_);
+  while (!in_flight_.empty() &&
+         in_flight_.front().first != encoded_image.Timestamp()) {
+    // Dropped by the encoder.
+    in_flight_.pop_front();
+  }
+  if (in_flight_.empty()) {
+    LOG(ERROR) << "Shared video encoder produced an unexpected frame";
+    return webrtc::EncodedImageCallback::Result(
+        webrtc::EncodedImageCallback::Result::Error::ERROR_SEND_FAILED);
+  }
+  Output output;
+  output.sequence = next_sequence_++;
+  output.timestamp_us = in_flight_.front().second;
+  output.image = encoded_image;
+  in_flight_.pop_front();
+  // The encoder may reuse its buffer for the next frame while subscribers
+  // that haven't presented this one yet still need it.
+  output.image.SetEncodedData(webrtc::EncodedImageBuffer::Create(
+      encoded_image.data(), encoded_image.size()));
+  if (codec_specific_info) {
+    output.info = *codec_specific_info;
+  }
+  history_.push_back(std::move(output));
+  while (history_.size() > kMaxHistory) {
+    history_.pop_front();
+  }
+  return webrtc::EncodedImageCallback::Result(
+      webrtc::EncodedImageCallback::Result::Error::OK);
+}
+
+}  // namespace webrtc_streaming
+}  // namespace cuttlefish
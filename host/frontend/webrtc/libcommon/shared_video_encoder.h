@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <api/video/encoded_image.h>
+#include <api/video/video_frame.h>
+#include <api/video/video_frame_buffer.h>
+#include <api/video_codecs/video_encoder.h>
+#include <api/video_codecs/video_encoder_factory.h>
+#include <modules/video_coding/include/video_codec_interface.h>
+
+namespace cuttlefish {
+namespace webrtc_streaming {
+
+// Lets the peer connections watching the same display share its encoders, so
+// that every frame is encoded once per bitrate instead of once per viewer.
+//
+// Each display gets a Group and tags the frames it produces with it. The
+// encoders created by CreateEncoderFactory() recognize tagged frames and,
+// instead of encoding them, subscribe to one of the group's shared encodings
+// (the one matching the bitrate webrtc allocates to the peer) and forward its
+// output. Frames that aren't tagged, like those webrtc scaled down for a
+// peer, are encoded privately as usual.
+class SharedVideoEncoders
+    : public std::enable_shared_from_this<SharedVideoEncoders> {
+ public:
+  class Encoding;
+  class Group;
+
+  // Identifies a frame buffer as a frame of a group's display for as long as
+  // the tag exists. Meant to be a member of the buffer itself.
+  class FrameTag {
+   public:
+    FrameTag(std::shared_ptr<Group> group,
+             const webrtc::VideoFrameBuffer* buffer);
+    ~FrameTag();
+
+    FrameTag(const FrameTag&) = delete;
+    FrameTag& operator=(const FrameTag&) = delete;
+
+   private:
+    std::shared_ptr<Group> group_;
+    const webrtc::VideoFrameBuffer* buffer_;
+  };
+
+  // Bitrates of the shared encodings, in bits per second, in increasing order.
+  // Peers get the highest one their allocated bitrate allows, or the lowest.
+  static const std::vector<uint32_t>& EncodingBitrates();
+  // The encoding to use for a peer with the given allocated bitrate which
+  // currently uses the |current| one (0 for none). Once a peer has an
+  // encoding it only moves down when its bitrate drops well below it, to
+  // avoid bouncing between encodings on small estimate fluctuations.
+  static uint32_t PickEncodingBitrate(uint32_t target_bps, uint32_t current);
+
+  // |inner| creates the encoders that actually do the work.
+  static std::shared_ptr<SharedVideoEncoders> Create(
+      std::unique_ptr<webrtc::VideoEncoderFactory> inner);
+
+  // Creates the group for a new display.
+  std::shared_ptr<Group> CreateGroup();
+
+  // The factory to give to the peer connection factory. It keeps this object
+  // alive.
+  std::unique_ptr<webrtc::VideoEncoderFactory> CreateEncoderFactory();
+
+  // The group |buffer| was tagged with, if any.
+  std::shared_ptr<Group> FindGroup(const webrtc::VideoFrameBuffer* buffer);
+
+  webrtc::VideoEncoderFactory& inner_factory() { return *inner_; }
+
+ private:
+  SharedVideoEncoders(std::unique_ptr<webrtc::VideoEncoderFactory> inner);
+
+  void Tag(const webrtc::VideoFrameBuffer* buffer,
+           std::weak_ptr<Group> group);
+  void Untag(const webrtc::VideoFrameBuffer* buffer);
+
+  std::unique_ptr<webrtc::VideoEncoderFactory> inner_;
+  std::mutex tags_mutex_;
+  std::unordered_map<const webrtc::VideoFrameBuffer*, std::weak_ptr<Group>>
+      tags_;
+};
+
+// The shared encodings of one display, created on demand and released once
+// no peer subscribes to them anymore.
+class SharedVideoEncoders::Group
+    : public std::enable_shared_from_this<SharedVideoEncoders::Group> {
+ public:
+  Group(std::shared_ptr<SharedVideoEncoders> encoders);
+
+  // Returns the encoding with the given bitrate for frames matching |codec|,
+  // or null if its encoder can't be initialized.
+  std::shared_ptr<Encoding> GetEncoding(
+      uint32_t bitrate_bps, const webrtc::SdpVideoFormat& format,
+      const webrtc::VideoCodec& codec,
+      const webrtc::VideoEncoder::Settings& settings);
+
+  SharedVideoEncoders& encoders() { return *encoders_; }
+
+ private:
+  std::shared_ptr<SharedVideoEncoders> encoders_;
+  std::mutex mutex_;
+  std::map<uint32_t, std::weak_ptr<Encoding>> encodings_;
+};
+
+// One encoder at a fixed bitrate whose output goes to all its subscribers.
+//
+// Subscribers present every frame they want encoded. The first to present a
+// frame gets it encoded; the others are handed the already encoded result,
+// along with anything else they missed, so that each one receives an
+// unbroken sequence starting at a key frame.
+class SharedVideoEncoders::Encoding : public webrtc::EncodedImageCallback {
+ public:
+  struct Output {
+    uint64_t sequence;
+    int64_t timestamp_us;
+    webrtc::EncodedImage image;
+    webrtc::CodecSpecificInfo info;
+  };
+
+  // What a subscriber has received so far. Owned by the subscriber.
+  struct Subscription {
+    // The sequence number of the next output to deliver, or nullopt if the
+    // subscriber needs to start at a key frame.
+    std::optional<uint64_t> next_sequence;
+  };
+
+  Encoding(std::unique_ptr<webrtc::VideoEncoder> encoder,
+           const webrtc::VideoCodec& codec, uint32_t bitrate_bps);
+  ~Encoding() override;
+
+  uint32_t bitrate_bps() const { return bitrate_bps_; }
+  const webrtc::VideoCodec& codec() const { return codec_; }
+
+  // Encodes |frame| unless a subscriber already had it encoded and appends
+  // the outputs |subscription| is due up to and including that frame to
+  // |outputs|. Key frame requests of all subscribers are merged into the
+  // next frame encoded.
+  int32_t Encode(const webrtc::VideoFrame& frame, bool key_frame,
+                 Subscription& subscription, std::vector<Output>& outputs);
+
+  webrtc::VideoEncoder::EncoderInfo GetEncoderInfo() const;
+
+  // EncodedImageCallback
+  webrtc::EncodedImageCallback::Result OnEncodedImage(
+      const webrtc::EncodedImage& encoded_image,
+      const webrtc::CodecSpecificInfo* codec_specific_info) override;
+
+ private:
+  void CollectOutputs(int64_t timestamp_us, Subscription& subscription,
+                      std::vector<Output>& outputs);
+
+  std::unique_ptr<webrtc::VideoEncoder> encoder_;
+  const webrtc::VideoCodec codec_;
+  const uint32_t bitrate_bps_;
+
+  // Serializes calls into the encoder.
+  std::mutex encode_mutex_;
+  int64_t last_encoded_us_ = -1;
+  // Capture time of the last frame encoded as a key frame. Requests for
+  // frames up to it are already served by it.
+  int64_t last_key_frame_us_ = -1;
+  bool key_frame_pending_ = true;
+
+  // Guards the outputs, separately as encoders may produce them on other
+  // threads.
+  std::mutex outputs_mutex_;
+  // Capture times of the frames given to the encoder, by RTP timestamp, until
+  // their outputs arrive.
+  std::deque<std::pair<uint32_t, int64_t>> in_flight_;
+  uint64_t next_sequence_ = 0;
+  std::deque<Output> history_;
+};
+
+}  // namespace webrtc_streaming
+}  // namespace cuttlefish
@@ -0,0 +1,424 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "host/frontend/webrtc/libcommon/shared_video_encoder.h"
+
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <api/video/encoded_image.h>
+#include <api/video/i420_buffer.h>
+#include <api/video/video_bitrate_allocation.h>
+#include <api/video/video_frame.h>
+#include <api/video_codecs/video_encoder.h>
+#include <api/video_codecs/video_encoder_factory.h>
+#include <gtest/gtest.h>
+#include <modules/video_coding/include/video_error_codes.h>
+
+namespace cuttlefish {
+namespace webrtc_streaming {
+namespace {
+
+constexpr int kWidth = 64;
+constexpr int kHeight = 48;
+constexpr int kFramerate = 30;
+
+// What the fake encoders of a factory went through.
+struct EncoderCounts {
+  int created = 0;
+  int alive = 0;
+  int encoded = 0;
+  int key_frames = 0;
+};
+
+// Outputs one image per frame, synchronously.
+class FakeEncoder : public webrtc::VideoEncoder {
+ public:
+  FakeEncoder(std::shared_ptr<EncoderCounts> counts)
+      : counts_(std::move(counts)) {
+    counts_->created++;
+    counts_->alive++;
+  }
+  ~FakeEncoder() override { counts_->alive--; }
+
+  int InitEncode(const webrtc::VideoCodec*,
+                 const webrtc::VideoEncoder::Settings&) override {
+    return WEBRTC_VIDEO_CODEC_OK;
+  }
+
+  int32_t RegisterEncodeCompleteCallback(
+      webrtc::EncodedImageCallback* callback) override {
+    callback_ = callback;
+    return WEBRTC_VIDEO_CODEC_OK;
+  }
+
+  int32_t Release() override { return WEBRTC_VIDEO_CODEC_OK; }
+
+  int32_t Encode(
+      const webrtc::VideoFrame& frame,
+      const std::vector<webrtc::VideoFrameType>* frame_types) override {
+    counts_->encoded++;
+    webrtc::EncodedImage image;
+    image.SetEncodedData(webrtc::EncodedImageBuffer::Create(1));
+    image.SetTimestamp(frame.timestamp());
+    image._frameType = frame_types && !frame_types->empty()
+                           ? frame_types->front()
+                           : webrtc::VideoFrameType::kVideoFrameDelta;
+    if (image._frameType == webrtc::VideoFrameType::kVideoFrameKey) {
+      counts_->key_frames++;
+    }
+    webrtc::CodecSpecificInfo info;
+    info.codecType = webrtc::kVideoCodecVP8;
+    callback_->OnEncodedImage(image, &info);
+    return WEBRTC_VIDEO_CODEC_OK;
+  }
+
+  void SetRates(const RateControlParameters&) override {}
+
+ private:
+  std::shared_ptr<EncoderCounts> counts_;
+  webrtc::EncodedImageCallback* callback_ = nullptr;
+};
+
+class FakeEncoderFactory : public webrtc::VideoEncoderFactory {
+ public:
+  FakeEncoderFactory(std::shared_ptr<EncoderCounts> counts)
+      : counts_(std::move(counts)) {}
+
+  std::vector<webrtc::SdpVideoFormat> GetSupportedFormats() const override {
+    return {webrtc::SdpVideoFormat("VP8")};
+  }
+
+  std::unique_ptr<webrtc::VideoEncoder> CreateVideoEncoder(
+      const webrtc::SdpVideoFormat&) override {
+    return std::make_unique<FakeEncoder>(counts_);
+  }
+
+ private:
+  std::shared_ptr<EncoderCounts> counts_;
+};
+
+// Stands in for the network side of a peer connection.
+class CountingSink : public webrtc::EncodedImageCallback {
+ public:
+  webrtc::EncodedImageCallback::Result OnEncodedImage(
+      const webrtc::EncodedImage& image,
+      const webrtc::CodecSpecificInfo*) override {
+    frames++;
+    types.push_back(image._frameType);
+    timestamps.push_back(image.Timestamp());
+    return webrtc::EncodedImageCallback::Result(
+        webrtc::EncodedImageCallback::Result::Error::OK);
+  }
+
+  int frames = 0;
+  std::vector<webrtc::VideoFrameType> types;
+  // RTP timestamps.
+  std::vector<uint32_t> timestamps;
+};
+
+constexpr auto kKey = webrtc::VideoFrameType::kVideoFrameKey;
+constexpr auto kDelta = webrtc::VideoFrameType::kVideoFrameDelta;
+
+webrtc::VideoCodec Codec() {
+  webrtc::VideoCodec codec;
+  memset(&codec, 0, sizeof(codec));
+  codec.codecType = webrtc::kVideoCodecVP8;
+  codec.width = kWidth;
+  codec.height = kHeight;
+  codec.maxFramerate = kFramerate;
+  codec.active = true;
+  *codec.VP8() = webrtc::VideoEncoder::GetDefaultVp8Settings();
+  return codec;
+}
+
+webrtc::VideoEncoder::RateControlParameters Rates(uint32_t bitrate_bps) {
+  webrtc::VideoBitrateAllocation allocation;
+  allocation.SetBitrate(0, 0, bitrate_bps);
+  return webrtc::VideoEncoder::RateControlParameters(allocation, kFramerate);
+}
+
+class SharedVideoEncodersTest : public ::testing::Test {
+ protected:
+  SharedVideoEncodersTest()
+      : counts_(std::make_shared<EncoderCounts>()),
+        encoders_(SharedVideoEncoders::Create(
+            std::make_unique<FakeEncoderFactory>(counts_))),
+        factory_(encoders_->CreateEncoderFactory()),
+        group_(encoders_->CreateGroup()),
+        buffer_(webrtc::I420Buffer::Create(kWidth, kHeight)) {}
+
+  // An encoder for a peer watching the display at |bitrate_bps|.
+  std::unique_ptr<webrtc::VideoEncoder> AddPeer(CountingSink& sink,
+                                                uint32_t bitrate_bps) {
+    webrtc::VideoEncoder::Capabilities capabilities(false);
+    webrtc::VideoEncoder::Settings settings(capabilities, 1, 1 << 20);
+    auto codec = Codec();
+    auto encoder = factory_->CreateVideoEncoder(webrtc::SdpVideoFormat("VP8"));
+    EXPECT_EQ(encoder->InitEncode(&codec, settings), WEBRTC_VIDEO_CODEC_OK);
+    encoder->RegisterEncodeCompleteCallback(&sink);
+    encoder->SetRates(Rates(bitrate_bps));
+    return encoder;
+  }
+
+  // Every peer has its own |rtp_offset|, as webrtc picks a random one per
+  // video track.
+  webrtc::VideoFrame Frame(int64_t index, uint32_t rtp_offset = 0) {
+    int64_t timestamp_us = index * 1000000 / kFramerate;
+    return webrtc::VideoFrame::Builder()
+        .set_video_frame_buffer(buffer_)
+        .set_timestamp_us(timestamp_us)
+        .set_timestamp_rtp(rtp_offset +
+                           static_cast<uint32_t>(timestamp_us / 1000 * 90))
+        .build();
+  }
+
+  int32_t Encode(webrtc::VideoEncoder& encoder, int64_t index, bool key_frame,
+                 uint32_t rtp_offset = 0) {
+    std::vector<webrtc::VideoFrameType> types = {key_frame ? kKey : kDelta};
+    return encoder.Encode(Frame(index, rtp_offset), &types);
+  }
+  // Only the first frame is requested as a key frame, as webrtc does.
+  int32_t Encode(webrtc::VideoEncoder& encoder, int64_t index) {
+    return Encode(encoder, index, index == 0);
+  }
+
+  std::shared_ptr<EncoderCounts> counts_;
+  std::shared_ptr<SharedVideoEncoders> encoders_;
+  std::unique_ptr<webrtc::VideoEncoderFactory> factory_;
+  std::shared_ptr<SharedVideoEncoders::Group> group_;
+  rtc::scoped_refptr<webrtc::I420Buffer> buffer_;
+};
+
+TEST_F(SharedVideoEncodersTest, PeersWatchingADisplayShareAnEncoder) {
+  SharedVideoEncoders::FrameTag tag(group_, buffer_.get());
+  CountingSink sink_a;
+  CountingSink sink_b;
+  auto peer_a = AddPeer(sink_a, 4'000'000);
+  auto peer_b = AddPeer(sink_b, 4'000'000);
+
+  for (int64_t i = 0; i < 3; i++) {
+    EXPECT_EQ(Encode(*peer_a, i), WEBRTC_VIDEO_CODEC_OK);
+    EXPECT_EQ(Encode(*peer_b, i), WEBRTC_VIDEO_CODEC_OK);
+  }
+
+  EXPECT_EQ(counts_->created, 1);
+  EXPECT_EQ(counts_->encoded, 3);
+  EXPECT_EQ(sink_a.frames, 3);
+  EXPECT_EQ(sink_b.frames, 3);
+}
+
+TEST_F(SharedVideoEncodersTest, PeersAtDifferentBitratesUseOwnEncodings) {
+  SharedVideoEncoders::FrameTag tag(group_, buffer_.get());
+  CountingSink sink_a;
+  CountingSink sink_b;
+  auto peer_a = AddPeer(sink_a, 4'000'000);
+  auto peer_b = AddPeer(sink_b, 500'000);
+
+  Encode(*peer_a, 0);
+  Encode(*peer_b, 0);
+
+  EXPECT_EQ(counts_->created, 2);
+  EXPECT_EQ(counts_->encoded, 2);
+  EXPECT_EQ(sink_a.frames, 1);
+  EXPECT_EQ(sink_b.frames, 1);
+}
+
+TEST_F(SharedVideoEncodersTest, ReleasesTheEncoderWithTheLastPeer) {
+  SharedVideoEncoders::FrameTag tag(group_, buffer_.get());
+  CountingSink sink_a;
+  CountingSink sink_b;
+  auto peer_a = AddPeer(sink_a, 4'000'000);
+  auto peer_b = AddPeer(sink_b, 4'000'000);
+  Encode(*peer_a, 0);
+  Encode(*peer_b, 0);
+  ASSERT_EQ(counts_->alive, 1);
+
+  peer_a->Release();
+  peer_a.reset();
+  EXPECT_EQ(counts_->alive, 1);
+  EXPECT_EQ(Encode(*peer_b, 1), WEBRTC_VIDEO_CODEC_OK);
+  EXPECT_EQ(sink_b.frames, 2);
+
+  peer_b.reset();
+  EXPECT_EQ(counts_->alive, 0);
+
+  // A peer joining later gets a new encoder.
+  CountingSink sink_c;
+  auto peer_c = AddPeer(sink_c, 4'000'000);
+  Encode(*peer_c, 2);
+  EXPECT_EQ(counts_->created, 2);
+  EXPECT_EQ(counts_->alive, 1);
+}
+
+TEST_F(SharedVideoEncodersTest, EncodesUntaggedFramesPrivately) {
+  CountingSink sink_a;
+  CountingSink sink_b;
+  auto peer_a = AddPeer(sink_a, 4'000'000);
+  auto peer_b = AddPeer(sink_b, 4'000'000);
+
+  Encode(*peer_a, 0);
+  Encode(*peer_b, 0);
+
+  EXPECT_EQ(counts_->created, 2);
+  EXPECT_EQ(counts_->encoded, 2);
+  EXPECT_EQ(sink_a.frames, 1);
+  EXPECT_EQ(sink_b.frames, 1);
+}
+
+TEST_F(SharedVideoEncodersTest, FramesAreUntaggedWithTheirTag) {
+  {
+    SharedVideoEncoders::FrameTag tag(group_, buffer_.get());
+    EXPECT_EQ(encoders_->FindGroup(buffer_.get()), group_);
+  }
+  EXPECT_EQ(encoders_->FindGroup(buffer_.get()), nullptr);
+}
+
+TEST_F(SharedVideoEncodersTest, PeerJoiningMidStreamWaitsForAKeyFrame) {
+  SharedVideoEncoders::FrameTag tag(group_, buffer_.get());
+  CountingSink sink_a;
+  CountingSink sink_b;
+  auto peer_a = AddPeer(sink_a, 4'000'000);
+  // Long enough for the first key frame to leave the history.
+  for (int64_t i = 0; i < 20; i++) {
+    Encode(*peer_a, i);
+  }
+  auto peer_b = AddPeer(sink_b, 4'000'000);
+
+  EXPECT_EQ(Encode(*peer_b, 19, false), WEBRTC_VIDEO_CODEC_OK);
+  EXPECT_EQ(sink_b.frames, 0);
+
+  for (int64_t i = 20; i < 23; i++) {
+    Encode(*peer_a, i);
+    Encode(*peer_b, i, false);
+  }
+
+  EXPECT_EQ(sink_b.types, (std::vector{kKey, kDelta, kDelta}));
+  EXPECT_EQ(sink_b.timestamps,
+            (std::vector{Frame(20).timestamp(), Frame(21).timestamp(),
+                         Frame(22).timestamp()}));
+  // The other peer got the same key frame, and nothing else was encoded.
+  EXPECT_EQ(sink_a.frames, 23);
+  EXPECT_EQ(sink_a.types[20], kKey);
+  EXPECT_EQ(counts_->encoded, 23);
+  EXPECT_EQ(counts_->key_frames, 2);
+}
+
+TEST_F(SharedVideoEncodersTest, PeerFallingBehindRestartsAtAKeyFrame) {
+  SharedVideoEncoders::FrameTag tag(group_, buffer_.get());
+  CountingSink sink_a;
+  CountingSink sink_b;
+  auto peer_a = AddPeer(sink_a, 4'000'000);
+  auto peer_b = AddPeer(sink_b, 4'000'000);
+  Encode(*peer_a, 0);
+  Encode(*peer_b, 0);
+  // Peer b presents none of these, further behind than the history goes.
+  for (int64_t i = 1; i < 20; i++) {
+    Encode(*peer_a, i);
+  }
+
+  Encode(*peer_b, 19, false);
+  EXPECT_EQ(sink_b.frames, 1);
+  for (int64_t i = 20; i < 22; i++) {
+    Encode(*peer_a, i);
+    Encode(*peer_b, i, false);
+  }
+
+  EXPECT_EQ(sink_b.types, (std::vector{kKey, kKey, kDelta}));
+  EXPECT_EQ(sink_b.timestamps,
+            (std::vector{Frame(0).timestamp(), Frame(20).timestamp(),
+                         Frame(21).timestamp()}));
+}
+
+TEST_F(SharedVideoEncodersTest, MergesKeyFrameRequests) {
+  SharedVideoEncoders::FrameTag tag(group_, buffer_.get());
+  CountingSink sink_a;
+  CountingSink sink_b;
+  CountingSink sink_c;
+  auto peer_a = AddPeer(sink_a, 4'000'000);
+  auto peer_b = AddPeer(sink_b, 4'000'000);
+  auto peer_c = AddPeer(sink_c, 4'000'000);
+  for (int64_t i = 0; i < 3; i++) {
+    Encode(*peer_a, i);
+    Encode(*peer_b, i);
+    Encode(*peer_c, i);
+  }
+  ASSERT_EQ(counts_->key_frames, 1);
+
+  // Every peer asks for a key frame on the same frame.
+  Encode(*peer_a, 3, true);
+  Encode(*peer_b, 3, true);
+  Encode(*peer_c, 3, true);
+  Encode(*peer_a, 4, false);
+  Encode(*peer_b, 4, false);
+  Encode(*peer_c, 4, false);
+
+  EXPECT_EQ(counts_->key_frames, 2);
+  for (auto sink : {&sink_a, &sink_b, &sink_c}) {
+    EXPECT_EQ(sink->types,
+              (std::vector{kKey, kDelta, kDelta, kKey, kDelta}));
+  }
+}
+
+TEST_F(SharedVideoEncodersTest, RebasesRtpTimestampsOntoEachPeer) {
+  SharedVideoEncoders::FrameTag tag(group_, buffer_.get());
+  constexpr uint32_t kOffsetA = 1000;
+  constexpr uint32_t kOffsetB = 123456;
+  CountingSink sink_a;
+  CountingSink sink_b;
+  auto peer_a = AddPeer(sink_a, 4'000'000);
+  auto peer_b = AddPeer(sink_b, 4'000'000);
+  for (int64_t i = 0; i < 3; i++) {
+    Encode(*peer_a, i, i == 0, kOffsetA);
+  }
+
+  // Catching up on the frames encoded for peer a, on peer b's clock.
+  Encode(*peer_b, 2, true, kOffsetB);
+
+  EXPECT_EQ(sink_a.timestamps,
+            (std::vector{Frame(0, kOffsetA).timestamp(),
+                         Frame(1, kOffsetA).timestamp(),
+                         Frame(2, kOffsetA).timestamp()}));
+  EXPECT_EQ(sink_b.timestamps,
+            (std::vector{Frame(0, kOffsetB).timestamp(),
+                         Frame(1, kOffsetB).timestamp(),
+                         Frame(2, kOffsetB).timestamp()}));
+}
+
+TEST(SharedVideoEncodersBitrateTest, PicksHighestAffordableEncoding) {
+  EXPECT_EQ(SharedVideoEncoders::PickEncodingBitrate(100'000, 0), 500'000);
+  EXPECT_EQ(SharedVideoEncoders::PickEncodingBitrate(2'000'000, 0),
+            1'500'000);
+  EXPECT_EQ(SharedVideoEncoders::PickEncodingBitrate(10'000'000, 0),
+            4'000'000);
+}
+
+TEST(SharedVideoEncodersBitrateTest, OnlyMovesDownWhenWellBelow) {
+  EXPECT_EQ(SharedVideoEncoders::PickEncodingBitrate(3'500'000, 4'000'000),
+            4'000'000);
+  EXPECT_EQ(SharedVideoEncoders::PickEncodingBitrate(3'000'000, 4'000'000),
+            1'500'000);
+  EXPECT_EQ(SharedVideoEncoders::PickEncodingBitrate(4'000'000, 1'500'000),
+            4'000'000);
+}
+
+}  // namespace
+}  // namespace webrtc_streaming
+}  // namespace cuttlefish
@@ -105,21 +105,20 @@ CameraStreamer::Resolution CameraStreamer::GetResolutionFromSettings(
 
 bool CameraStreamer::VsockSendYUVFrame(
     const webrtc::I420BufferInterface* frame) {
-  int32_t size = frame->width() * frame->height() +
-                 2 * frame->ChromaWidth() * frame->ChromaHeight();
-  const char* y = reinterpret_cast<const char*>(frame->DataY());
-  const char* u = reinterpret_cast<const char*>(frame->DataU());
-  const char* v = reinterpret_cast<const char*>(frame->DataV());
-  auto chroma_width = frame->ChromaWidth();
-  auto chroma_height = frame->ChromaHeight();
+  unsigned int width = frame->width();
+  unsigned int height = frame->height();
+  unsigned int chroma_width = frame->ChromaWidth();
+  unsigned int chroma_height = frame->ChromaHeight();
+  std::vector<VsockConnection::FramePlane> planes = {
+      {reinterpret_cast<const char*>(frame->DataY()), width, height,
+       frame->StrideY()},
+      {reinterpret_cast<const char*>(frame->DataU()), chroma_width,
+       chroma_height, frame->StrideU()},
+      {reinterpret_cast<const char*>(frame->DataV()), chroma_width,
+       chroma_height, frame->StrideV()},
+  };
   std::lock_guard<std::mutex> lock(frame_mutex_);
-  return cvd_connection_.Write(size) &&
-         cvd_connection_.WriteStrides(y, frame->width(), frame->height(),
-                                      frame->StrideY()) &&
-         cvd_connection_.WriteStrides(u, chroma_width, chroma_height,
-                                      frame->StrideU()) &&
-         cvd_connection_.WriteStrides(v, chroma_width, chroma_height,
-                                      frame->StrideV());
+  return cvd_connection_.WriteFrame(planes);
 }
 
 bool CameraStreamer::IsConnectionReady() {
@@ -16,7 +16,10 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <string>
 
 #include <json/json.h>
 
@@ -35,6 +38,14 @@ namespace webrtc_streaming {
 // devices could choose to send those events over ADB for example. A good rule
 // of thumb is: if it was encoded client side in cf_webrtc.js it should be
 // decoded in the library.
+// A contact point of a multi-touch event.
+struct MultiTouchPoint {
+  int32_t id;
+  int32_t slot;
+  int32_t x;
+  int32_t y;
+};
+
 class ConnectionObserver {
  public:
   ConnectionObserver() = default;
@@ -44,9 +55,10 @@ class ConnectionObserver {
 
   virtual void OnTouchEvent(const std::string& display_label, int x, int y,
                             bool down) = 0;
-  virtual void OnMultiTouchEvent(const std::string& label, Json::Value id,
-                                 Json::Value slot, Json::Value x, Json::Value y,
-                                 bool down, int size) = 0;
+  // |points| is only valid for the duration of the call.
+  virtual void OnMultiTouchEvent(const std::string& display_label,
+                                 const MultiTouchPoint* points, size_t count,
+                                 bool down) = 0;
 
   virtual void OnKeyboardEvent(uint16_t keycode, bool down) = 0;
 
@@ -16,9 +16,12 @@
 
 #include "host/frontend/webrtc/libdevice/data_channels.h"
 
+#include <array>
+
 #include <android-base/logging.h>
 
 #include "host/frontend/webrtc/libcommon/utils.h"
+#include "host/frontend/webrtc/libdevice/input_protocol.h"
 #include "host/frontend/webrtc/libdevice/keyboard.h"
 
 namespace cuttlefish {
@@ -75,21 +78,50 @@ static constexpr auto kCameraDataEof = "EOF";
 
 class InputChannelHandler : public DataChannelHandler {
  public:
+  InputChannelHandler() {
+    Json::CharReaderBuilder builder;
+    json_reader_.reset(builder.newCharReader());
+  }
+
   void OnMessageInner(const webrtc::DataBuffer &msg) override {
     if (msg.binary) {
-      // TODO (jemoreira) consider binary protocol to avoid JSON parsing
-      // overhead
-      LOG(ERROR) << "Received invalid (binary) data on input channel";
+      OnBinaryMessage(msg.data.cdata(), msg.size());
+    } else {
+      OnJsonMessage(msg.data.cdata<char>(), msg.size());
+    }
+  }
+
+ private:
+  void OnBinaryMessage(const uint8_t *data, size_t size) {
+    auto message = DecodeInputMessage(data, size);
+    if (!message.ok()) {
+      LOG(ERROR) << "Received invalid binary input message: "
+                 << message.error().Message();
       return;
     }
-    auto size = msg.size();
+    // The labels are short enough for these strings not to allocate.
+    switch (message->type) {
+      case InputMessage::Type::kTouch:
+        observer()->OnTouchEvent(std::string(message->text), message->x,
+                                 message->y, message->down);
+        break;
+      case InputMessage::Type::kMultiTouch:
+        observer()->OnMultiTouchEvent(std::string(message->text),
+                                      message->points.data(),
+                                      message->point_count, message->down);
+        break;
+      case InputMessage::Type::kKeyboard:
+        observer()->OnKeyboardEvent(DomKeyCodeToLinux(message->text),
+                                    message->down);
+        break;
+    }
+  }
 
+  // Clients that don't know the binary protocol send JSON.
+  void OnJsonMessage(const char *str, size_t size) {
     Json::Value evt;
-    Json::CharReaderBuilder builder;
-    std::unique_ptr<Json::CharReader> json_reader(builder.newCharReader());
     std::string errorMessage;
-    auto str = msg.data.cdata<char>();
-    if (!json_reader->parse(str, str + size, &evt, &errorMessage) < 0) {
+    if (!json_reader_->parse(str, str + size, &evt, &errorMessage)) {
       LOG(ERROR) << "Received invalid JSON object over input channel: "
                  << errorMessage;
       return;
@@ -132,15 +164,27 @@ class InputChannelHandler : public DataChannelHandler {
       }
 
       auto label = evt["display_label"].asString();
-      auto idArr = evt["id"];
+      const auto &idArr = evt["id"];
       int32_t down = evt["down"].asInt();
-      auto xArr = evt["x"];
-      auto yArr = evt["y"];
-      auto slotArr = evt["slot"];
-      int size = evt["id"].size();
+      const auto &xArr = evt["x"];
+      const auto &yArr = evt["y"];
+      const auto &slotArr = evt["slot"];
+      auto size = idArr.size();
+      if (size > kMaxTouchPoints) {
+        LOG(ERROR) << "Too many touch points: " << size;
+        return;
+      }
+      std::array<MultiTouchPoint, kMaxTouchPoints> points;
+      for (Json::ArrayIndex i = 0; i < size; i++) {
+        points[i] = MultiTouchPoint{
+            idArr[i].asInt(),
+            slotArr[i].asInt(),
+            xArr[i].asInt(),
+            yArr[i].asInt(),
+        };
+      }
 
-      observer()->OnMultiTouchEvent(label, idArr, slotArr, xArr, yArr, down,
-                                    size);
+      observer()->OnMultiTouchEvent(label, points.data(), size, down);
     } else if (event_type == "keyboard") {
       auto result =
           ValidateJsonObject(evt, "keyboard",
@@ -158,6 +202,8 @@ class InputChannelHandler : public DataChannelHandler {
       return;
     }
   }
+
+  std::unique_ptr<Json::CharReader> json_reader_;
 };
 
 class ControlChannelHandler : public DataChannelHandler {
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "host/frontend/webrtc/libdevice/input_protocol.h"
+
+namespace cuttlefish {
+namespace webrtc_streaming {
+namespace {
+
+constexpr size_t kHeaderSize = 4;
+constexpr size_t kTouchSize = 8;
+constexpr size_t kMultiTouchPointSize = 16;
+
+// Reads the fields of a message in order. Nothing is bounds checked here, the
+// decoder checks remaining() before each read.
+class MessageReader {
+ public:
+  MessageReader(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+  size_t remaining() const { return size_ - offset_; }
+
+  uint8_t ReadU8() { return data_[offset_++]; }
+
+  int32_t ReadI32() {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+      value |= static_cast<uint32_t>(data_[offset_++]) << (8 * i);
+    }
+    return static_cast<int32_t>(value);
+  }
+
+  std::string_view ReadString(size_t length) {
+    std::string_view str(reinterpret_cast<const char*>(data_ + offset_),
+                         length);
+    offset_ += length;
+    return str;
+  }
+
+ private:
+  const uint8_t* data_;
+  size_t size_;
+  size_t offset_ = 0;
+};
+
+}  // namespace
+
+Result<InputMessage> DecodeInputMessage(const uint8_t* data, size_t size) {
+  MessageReader reader(data, size);
+  CF_EXPECT(reader.remaining() >= kHeaderSize,
+            "Input message too short: " << size << " bytes");
+  auto version = reader.ReadU8();
+  CF_EXPECT(version == kInputProtocolVersion,
+            "Unsupported input protocol version: " << (int)version);
+
+  InputMessage message;
+  message.type = static_cast<InputMessage::Type>(reader.ReadU8());
+  message.down = reader.ReadU8() != 0;
+  size_t text_length = reader.ReadU8();
+  message.x = 0;
+  message.y = 0;
+  message.point_count = 0;
+
+  switch (message.type) {
+    case InputMessage::Type::kTouch:
+      CF_EXPECT(reader.remaining() >= kTouchSize, "Truncated touch message");
+      message.x = reader.ReadI32();
+      message.y = reader.ReadI32();
+      break;
+    case InputMessage::Type::kMultiTouch: {
+      CF_EXPECT(reader.remaining() >= 1, "Truncated multi-touch message");
+      message.point_count = reader.ReadU8();
+      CF_EXPECT(message.point_count <= kMaxTouchPoints,
+                "Too many touch points: " << message.point_count);
+      CF_EXPECT(
+          reader.remaining() >= message.point_count * kMultiTouchPointSize,
+          "Truncated multi-touch message");
+      for (size_t i = 0; i < message.point_count; i++) {
+        auto& point = message.points[i];
+        point.id = reader.ReadI32();
+        point.slot = reader.ReadI32();
+        point.x = reader.ReadI32();
+        point.y = reader.ReadI32();
+      }
+      break;
+    }
+    case InputMessage::Type::kKeyboard:
+      break;
+    default:
+      return CF_ERR("Unknown input message type: " << (int)message.type);
+  }
+
+  CF_EXPECT(reader.remaining() == text_length,
+            "Input message has " << reader.remaining()
+                                 << " trailing bytes, expected "
+                                 << text_length);
+  message.text = reader.ReadString(text_length);
+  return message;
+}
+
+}  // namespace webrtc_streaming
+}  // namespace cuttlefish
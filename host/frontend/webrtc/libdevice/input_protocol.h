@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "common/libs/utils/result.h"
+#include "host/frontend/webrtc/libdevice/connection_observer.h"
+
+namespace cuttlefish {
+namespace webrtc_streaming {
+
+// Binary encoding of the input channel messages, used instead of JSON by
+// clients that know the version advertised in the device info. All integers
+// are little endian.
+//
+//   uint8  version (kInputProtocolVersion)
+//   uint8  type (InputMessage::Type)
+//   uint8  down (0 or 1)
+//   uint8  length of the trailing string
+//   touch:       int32 x, int32 y
+//   multi-touch: uint8 count, then count times int32 id, slot, x, y
+//   keyboard:    nothing
+//   the trailing string: the display label, or the DOM key code for keyboard
+//                        events
+constexpr uint8_t kInputProtocolVersion = 1;
+// The device info field clients check before sending binary messages.
+constexpr auto kInputProtocolVersionField = "input_protocol_version";
+
+// Contacts of a single multi-touch message, more than fingers on a hand.
+constexpr size_t kMaxTouchPoints = 16;
+
+// A decoded input message. Decoding doesn't allocate, |text| points into the
+// decoded buffer.
+struct InputMessage {
+  enum class Type : uint8_t {
+    kTouch = 1,
+    kMultiTouch = 2,
+    kKeyboard = 3,
+  };
+
+  Type type;
+  bool down;
+  std::string_view text;
+  // Touch events only.
+  int32_t x;
+  int32_t y;
+  // Multi-touch events only.
+  std::array<MultiTouchPoint, kMaxTouchPoints> points;
+  size_t point_count;
+};
+
+Result<InputMessage> DecodeInputMessage(const uint8_t* data, size_t size);
+
+}  // namespace webrtc_streaming
+}  // namespace cuttlefish
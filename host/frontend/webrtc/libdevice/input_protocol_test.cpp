@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "host/frontend/webrtc/libdevice/input_protocol.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace cuttlefish {
+namespace webrtc_streaming {
+namespace {
+
+class MessageBuilder {
+ public:
+  MessageBuilder(InputMessage::Type type, bool down,
+                 const std::string& text = "display_0") : text_(text) {
+    U8(kInputProtocolVersion);
+    U8(static_cast<uint8_t>(type));
+    U8(down);
+    U8(text.size());
+  }
+
+  MessageBuilder& U8(uint8_t value) {
+    bytes_.push_back(value);
+    return *this;
+  }
+
+  MessageBuilder& I32(int32_t value) {
+    for (int i = 0; i < 4; i++) {
+      U8(static_cast<uint32_t>(value) >> (8 * i));
+    }
+    return *this;
+  }
+
+  MessageBuilder& Point(int32_t id, int32_t slot, int32_t x, int32_t y) {
+    return I32(id).I32(slot).I32(x).I32(y);
+  }
+
+  // The message with its trailing string.
+  std::vector<uint8_t> Build() const {
+    auto bytes = bytes_;
+    bytes.insert(bytes.end(), text_.begin(), text_.end());
+    return bytes;
+  }
+
+ private:
+  std::string text_;
+  std::vector<uint8_t> bytes_;
+};
+
+Result<InputMessage> Decode(const std::vector<uint8_t>& bytes) {
+  return DecodeInputMessage(bytes.data(), bytes.size());
+}
+
+TEST(InputProtocolTest, DecodesTouch) {
+  auto bytes = MessageBuilder(InputMessage::Type::kTouch, true)
+                   .I32(100)
+                   .I32(-2)
+                   .Build();
+
+  auto message = Decode(bytes);
+
+  ASSERT_TRUE(message.ok()) << message.error().Message();
+  EXPECT_EQ(message->type, InputMessage::Type::kTouch);
+  EXPECT_TRUE(message->down);
+  EXPECT_EQ(message->x, 100);
+  EXPECT_EQ(message->y, -2);
+  EXPECT_EQ(message->text, "display_0");
+}
+
+TEST(InputProtocolTest, DecodesMultiTouch) {
+  auto bytes = MessageBuilder(InputMessage::Type::kMultiTouch, false)
+                   .U8(2)
+                   .Point(7, 0, 10, 20)
+                   .Point(8, 1, 30, 40)
+                   .Build();
+
+  auto message = Decode(bytes);
+
+  ASSERT_TRUE(message.ok()) << message.error().Message();
+  EXPECT_FALSE(message->down);
+  ASSERT_EQ(message->point_count, 2);
+  EXPECT_EQ(message->points[0].id, 7);
+  EXPECT_EQ(message->points[0].slot, 0);
+  EXPECT_EQ(message->points[1].x, 30);
+  EXPECT_EQ(message->points[1].y, 40);
+  EXPECT_EQ(message->text, "display_0");
+}
+
+TEST(InputProtocolTest, DecodesKeyboard) {
+  auto bytes =
+      MessageBuilder(InputMessage::Type::kKeyboard, true, "KeyA").Build();
+
+  auto message = Decode(bytes);
+
+  ASSERT_TRUE(message.ok()) << message.error().Message();
+  EXPECT_EQ(message->type, InputMessage::Type::kKeyboard);
+  EXPECT_EQ(message->text, "KeyA");
+}
+
+TEST(InputProtocolTest, RejectsTruncatedHeader) {
+  auto bytes = MessageBuilder(InputMessage::Type::kKeyboard, true, "").Build();
+  for (size_t size = 0; size < bytes.size(); size++) {
+    EXPECT_FALSE(DecodeInputMessage(bytes.data(), size).ok()) << size;
+  }
+}
+
+TEST(InputProtocolTest, RejectsBadVersion) {
+  auto bytes = MessageBuilder(InputMessage::Type::kKeyboard, true).Build();
+  bytes[0] = kInputProtocolVersion + 1;
+
+  EXPECT_FALSE(Decode(bytes).ok());
+}
+
+TEST(InputProtocolTest, RejectsUnknownType) {
+  auto bytes = MessageBuilder(static_cast<InputMessage::Type>(0), true, "")
+                   .Build();
+  EXPECT_FALSE(Decode(bytes).ok());
+
+  bytes[1] = 4;
+  EXPECT_FALSE(Decode(bytes).ok());
+}
+
+TEST(InputProtocolTest, RejectsTruncatedTouch) {
+  auto bytes =
+      MessageBuilder(InputMessage::Type::kTouch, true, "").I32(1).Build();
+
+  EXPECT_FALSE(Decode(bytes).ok());
+}
+
+TEST(InputProtocolTest, RejectsTooManyTouchPoints) {
+  MessageBuilder builder(InputMessage::Type::kMultiTouch, true, "");
+  builder.U8(kMaxTouchPoints + 1);
+  for (size_t i = 0; i <= kMaxTouchPoints; i++) {
+    builder.Point(i, i, 0, 0);
+  }
+
+  EXPECT_FALSE(Decode(builder.Build()).ok());
+}
+
+TEST(InputProtocolTest, RejectsTruncatedTouchPoints) {
+  auto bytes = MessageBuilder(InputMessage::Type::kMultiTouch, true, "")
+                   .U8(2)
+                   .Point(1, 0, 0, 0)
+                   .Build();
+
+  EXPECT_FALSE(Decode(bytes).ok());
+}
+
+TEST(InputProtocolTest, RejectsTextLengthMismatch) {
+  auto bytes = MessageBuilder(InputMessage::Type::kTouch, true)
+                   .I32(1)
+                   .I32(2)
+                   .Build();
+  auto longer = bytes;
+  longer.push_back('x');
+  auto shorter = bytes;
+  shorter.pop_back();
+
+  EXPECT_FALSE(Decode(longer).ok());
+  EXPECT_FALSE(Decode(shorter).ok());
+}
+
+}  // namespace
+}  // namespace webrtc_streaming
+}  // namespace cuttlefish
@@ -18,9 +18,13 @@
 
 #include <linux/input.h>
 
+#include <functional>
 #include <map>
+#include <string>
 
-static const std::map<std::string, uint16_t> kDomToLinuxMapping = {
+// Transparent comparator so lookups don't need to build a std::string.
+static const std::map<std::string, uint16_t, std::less<>>
+    kDomToLinuxMapping = {
     {"Backquote", KEY_GRAVE},
     {"Backslash", KEY_BACKSLASH},
     {"Backspace", KEY_BACKSPACE},
@@ -150,7 +154,7 @@ static const std::map<std::string, uint16_t> kDomToLinuxMapping = {
     {"ScrollLock", KEY_SCROLLLOCK},
     {"Pause", KEY_PAUSE}};
 
-uint16_t DomKeyCodeToLinux(const std::string& dom_KEY_code) {
+uint16_t DomKeyCodeToLinux(std::string_view dom_KEY_code) {
   const auto it = kDomToLinuxMapping.find(dom_KEY_code);
   if (it == kDomToLinuxMapping.end()) {
     return 0;
@@ -17,6 +17,6 @@
 #pragma once
 
 #include <cinttypes>
-#include <string>
+#include <string_view>
 
-uint16_t DomKeyCodeToLinux(const std::string& dom_key_code);
+uint16_t DomKeyCodeToLinux(std::string_view dom_key_code);
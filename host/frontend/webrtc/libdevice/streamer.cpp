@@ -35,11 +35,13 @@
 #include "host/frontend/webrtc/libcommon/audio_device.h"
 #include "host/frontend/webrtc/libcommon/peer_connection_utils.h"
 #include "host/frontend/webrtc/libcommon/port_range_socket_factory.h"
+#include "host/frontend/webrtc/libcommon/shared_video_encoder.h"
 #include "host/frontend/webrtc/libcommon/utils.h"
 #include "host/frontend/webrtc/libcommon/vp8only_encoder_factory.h"
 #include "host/frontend/webrtc/libdevice/audio_track_source_impl.h"
 #include "host/frontend/webrtc/libdevice/camera_streamer.h"
 #include "host/frontend/webrtc/libdevice/client_handler.h"
+#include "host/frontend/webrtc/libdevice/input_protocol.h"
 #include "host/frontend/webrtc/libdevice/video_track_source_impl.h"
 #include "host/frontend/webrtc_operator/constants/signaling_constants.h"
 
@@ -143,6 +145,7 @@ class Streamer::Impl : public ServerConnectionObserver,
 
   void HandleConfigMessage(const Json::Value& msg);
   void HandleClientMessage(const Json::Value& server_message);
+  void SendStats();
 
   // PeerConnectionBuilder
   Result<rtc::scoped_refptr<webrtc::PeerConnectionInterface>> Build(
@@ -173,6 +176,9 @@ class Streamer::Impl : public ServerConnectionObserver,
   int registration_retries_left_ = kRegistrationRetries;
   int retry_interval_ms_ = kRetryFirstIntervalMs;
   LocalRecorder* recorder_ = nullptr;
+  std::shared_ptr<SharedVideoEncoders> shared_video_encoders_;
+  bool registered_ = false;
+  Json::Value stats_;
 };
 
 Streamer::Streamer(std::unique_ptr<Streamer::Impl> impl)
@@ -214,9 +220,17 @@ std::unique_ptr<Streamer> Streamer::Create(
       rtc::scoped_refptr<CfAudioDeviceModule>(
           new rtc::RefCountedObject<CfAudioDeviceModule>()));
 
+  if (cfg.shared_video_encoders) {
+    // Only VP8 is supported
+    impl->shared_video_encoders_ =
+        SharedVideoEncoders::Create(std::make_unique<VP8OnlyEncoderFactory>(
+            webrtc::CreateBuiltinVideoEncoderFactory()));
+  }
+
   auto result = CreatePeerConnectionFactory(
       impl->network_thread_.get(), impl->worker_thread_.get(),
-      impl->signal_thread_.get(), impl->audio_device_module_->device_module());
+      impl->signal_thread_.get(), impl->audio_device_module_->device_module(),
+      impl->shared_video_encoders_);
 
   if (!result.ok()) {
     LOG(ERROR) << result.error().Trace();
@@ -238,8 +252,13 @@ std::shared_ptr<VideoSink> Streamer::AddDisplay(const std::string& label,
           LOG(ERROR) << "Display with same label already exists: " << label;
           return nullptr;
         }
+        std::shared_ptr<SharedVideoEncoders::Group> encoder_group;
+        if (impl_->shared_video_encoders_) {
+          encoder_group = impl_->shared_video_encoders_->CreateGroup();
+        }
         rtc::scoped_refptr<VideoTrackSourceImpl> source(
-            new rtc::RefCountedObject<VideoTrackSourceImpl>(width, height));
+            new rtc::RefCountedObject<VideoTrackSourceImpl>(width, height,
+                                                            encoder_group));
         impl_->displays_[label] = {width, height, dpi, touch_enabled, source};
 
         auto video_track = impl_->peer_connection_factory_->CreateVideoTrack(
@@ -346,8 +365,31 @@ void Streamer::Register(std::weak_ptr<OperatorObserver> observer) {
 
 void Streamer::Unregister() {
   // Usually called from an application thread.
-  impl_->signal_thread_->PostTask(
-      [this]() { impl_->server_connection_.reset(); });
+  impl_->signal_thread_->PostTask([this]() {
+    impl_->registered_ = false;
+    impl_->server_connection_.reset();
+  });
+}
+
+void Streamer::PublishStats(Json::Value stats) {
+  // Usually called from an application thread.
+  impl_->signal_thread_->PostTask([this, stats = std::move(stats)]() {
+    impl_->stats_ = stats;
+    impl_->SendStats();
+  });
+}
+
+void Streamer::Impl::SendStats() {
+  CHECK(signal_thread_->IsCurrent())
+      << __FUNCTION__ << " called from the wrong thread";
+  if (!registered_ || stats_.isNull()) {
+    return;
+  }
+  Json::Value msg;
+  msg[cuttlefish::webrtc_signaling::kTypeField] =
+      cuttlefish::webrtc_signaling::kDeviceStatsType;
+  msg[cuttlefish::webrtc_signaling::kStatsField] = stats_;
+  server_connection_->Send(msg);
 }
 
 void Streamer::Impl::Register(std::weak_ptr<OperatorObserver> observer) {
@@ -404,6 +446,7 @@ void Streamer::Impl::OnOpen() {
       hardware[k] = v;
     }
     device_info[kHardwareField] = hardware;
+    device_info[kInputProtocolVersionField] = kInputProtocolVersion;
     Json::Value custom_control_panel_buttons(Json::arrayValue);
     for (const auto& button : custom_control_panel_buttons_) {
       Json::Value button_entry;
@@ -433,6 +476,8 @@ void Streamer::Impl::OnOpen() {
     device_info[kCustomControlPanelButtonsField] = custom_control_panel_buttons;
     register_obj[cuttlefish::webrtc_signaling::kDeviceInfoField] = device_info;
     server_connection_->Send(register_obj);
+    registered_ = true;
+    SendStats();
     // Do this last as OnRegistered() is user code and may take some time to
     // complete (although it shouldn't...)
     auto observer = operator_observer_.lock();
@@ -448,6 +493,7 @@ void Streamer::Impl::OnClose() {
   // device to decide when to disconnect.
   LOG(WARNING) << "Connection with server closed unexpectedly";
   signal_thread_->PostTask([this]() {
+    registered_ = false;
     auto observer = operator_observer_.lock();
     if (observer) {
       observer->OnClose();
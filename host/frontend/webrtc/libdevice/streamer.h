@@ -24,6 +24,8 @@
 #include <utility>
 #include <vector>
 
+#include <json/json.h>
+
 #include "host/libs/config/custom_actions.h"
 
 #include "host/frontend/webrtc/libcommon/audio_source.h"
@@ -49,6 +51,9 @@ struct StreamerConfig {
   // [0,0] means all ports
   std::pair<uint16_t, uint16_t> udp_port_range = {15550, 15599};
   std::pair<uint16_t, uint16_t> tcp_port_range = {15550, 15599};
+  // Whether the clients watching the same display share its encoders instead
+  // of each getting its own.
+  bool shared_video_encoders = false;
 };
 
 class OperatorObserver {
@@ -109,6 +114,10 @@ class Streamer {
   void Register(std::weak_ptr<OperatorObserver> operator_observer);
   void Unregister();
 
+  // Replaces the device's stats the operator serves to local tools. Sent
+  // again on every registration.
+  void PublishStats(Json::Value stats);
+
  private:
   /*
    * Private Implementation idiom.
@@ -28,6 +28,9 @@ class VideoSink {
   virtual ~VideoSink() = default;
   virtual void OnFrame(std::shared_ptr<VideoFrameBuffer> frame,
                        int64_t timestamp_us) = 0;
+  // Whether anything, a client or the recorder, currently receives the frames.
+  // When not, producing them is wasted effort.
+  virtual bool HasConsumers() const = 0;
 };
 
 }  // namespace webrtc_streaming
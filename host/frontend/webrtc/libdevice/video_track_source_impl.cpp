@@ -27,8 +27,9 @@ class VideoFrameWrapper : public webrtc::I420BufferInterface {
  public:
   VideoFrameWrapper(
       std::shared_ptr<::cuttlefish::webrtc_streaming::VideoFrameBuffer>
-          frame_buffer)
-      : frame_buffer_(frame_buffer) {}
+          frame_buffer,
+      std::shared_ptr<SharedVideoEncoders::Group> encoder_group)
+      : frame_buffer_(frame_buffer), tag_(encoder_group, this) {}
   ~VideoFrameWrapper() override = default;
   // From VideoFrameBuffer
   int width() const override { return frame_buffer_->width(); }
@@ -47,24 +48,35 @@ class VideoFrameWrapper : public webrtc::I420BufferInterface {
  private:
   std::shared_ptr<::cuttlefish::webrtc_streaming::VideoFrameBuffer>
       frame_buffer_;
+  SharedVideoEncoders::FrameTag tag_;
 };
 
 }  // namespace
 
-VideoTrackSourceImpl::VideoTrackSourceImpl(int width, int height)
-    : webrtc::VideoTrackSource(false), width_(width), height_(height) {}
+VideoTrackSourceImpl::VideoTrackSourceImpl(
+    int width, int height,
+    std::shared_ptr<SharedVideoEncoders::Group> encoder_group)
+    : webrtc::VideoTrackSource(false),
+      width_(width),
+      height_(height),
+      encoder_group_(encoder_group) {}
 
 void VideoTrackSourceImpl::OnFrame(std::shared_ptr<VideoFrameBuffer> frame,
                                    int64_t timestamp_us) {
   auto video_frame =
       webrtc::VideoFrame::Builder()
           .set_video_frame_buffer(rtc::scoped_refptr<webrtc::VideoFrameBuffer>(
-              new rtc::RefCountedObject<VideoFrameWrapper>(frame)))
+              new rtc::RefCountedObject<VideoFrameWrapper>(frame,
+                                                           encoder_group_)))
           .set_timestamp_us(timestamp_us)
           .build();
   broadcaster_.OnFrame(video_frame);
 }
 
+bool VideoTrackSourceImpl::HasConsumers() const {
+  return broadcaster_.frame_wanted();
+}
+
 bool VideoTrackSourceImpl::GetStats(Stats *stats) {
   stats->input_height = height_;
   stats->input_width = width_;
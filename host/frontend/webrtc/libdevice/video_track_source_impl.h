@@ -19,6 +19,7 @@
 #include <media/base/video_broadcaster.h>
 #include <pc/video_track_source.h>
 
+#include "host/frontend/webrtc/libcommon/shared_video_encoder.h"
 #include "host/frontend/webrtc/libdevice/video_sink.h"
 
 namespace cuttlefish {
@@ -26,10 +27,17 @@ namespace webrtc_streaming {
 
 class VideoTrackSourceImpl : public webrtc::VideoTrackSource {
  public:
-  VideoTrackSourceImpl(int width, int height);
+  // Frames are tagged with |encoder_group|, if given, so that the peers
+  // watching them can share encoders.
+  VideoTrackSourceImpl(
+      int width, int height,
+      std::shared_ptr<SharedVideoEncoders::Group> encoder_group = nullptr);
 
   void OnFrame(std::shared_ptr<VideoFrameBuffer> frame, int64_t timestamp_us);
 
+  // Whether any sink is attached to the source.
+  bool HasConsumers() const;
+
   // Returns false if no stats are available, e.g, for a remote source, or a
   // source which has not seen its first frame yet.
   //
@@ -48,6 +56,7 @@ class VideoTrackSourceImpl : public webrtc::VideoTrackSource {
  private:
   int width_;
   int height_;
+  std::shared_ptr<SharedVideoEncoders::Group> encoder_group_;
   rtc::VideoBroadcaster broadcaster_;
 };
 
@@ -69,6 +78,10 @@ class VideoTrackSourceImplSinkWrapper : public VideoSink {
     track_source_impl_->OnFrame(frame, timestamp_us);
   }
 
+  bool HasConsumers() const override {
+    return track_source_impl_->HasConsumers();
+  }
+
  private:
   rtc::scoped_refptr<VideoTrackSourceImpl> track_source_impl_;
 };
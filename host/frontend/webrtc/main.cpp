@@ -16,12 +16,16 @@
 
 #include <linux/input.h>
 
+#include <chrono>
+#include <cstdio>
+#include <fstream>
 #include <memory>
 
 #include <android-base/logging.h>
 #include <android-base/strings.h>
 #include <fruit/fruit.h>
 #include <gflags/gflags.h>
+#include <json/json.h>
 #include <libyuv.h>
 
 #include "common/libs/fs/shared_fd.h"
@@ -30,6 +34,7 @@
 #include "host/frontend/webrtc/client_server.h"
 #include "host/frontend/webrtc/connection_observer.h"
 #include "host/frontend/webrtc/display_handler.h"
+#include "host/frontend/webrtc/input_latency.h"
 #include "host/frontend/webrtc/kernel_log_events_handler.h"
 #include "host/frontend/webrtc/libdevice/camera_controller.h"
 #include "host/frontend/webrtc/libdevice/local_recorder.h"
@@ -62,10 +67,19 @@ DEFINE_bool(write_virtio_input, true,
 DEFINE_int32(audio_server_fd, -1, "An fd to listen on for audio frames");
 DEFINE_int32(camera_streamer_fd, -1, "An fd to send client camera frames");
 DEFINE_string(client_dir, "webrtc", "Location of the client files");
+DEFINE_bool(shared_video_encoders, true,
+            "Whether clients watching the same display share its encoders, "
+            "so that each frame is encoded once per bitrate instead of once "
+            "per client.");
+DEFINE_bool(trace_input_latency, true,
+            "Whether to measure the time from touch events to the frames "
+            "showing their effect, reported to the operator and to the "
+            "instance's logs directory.");
 
 using cuttlefish::AudioHandler;
 using cuttlefish::CfConnectionObserverFactory;
 using cuttlefish::DisplayHandler;
+using cuttlefish::InputLatencyTracer;
 using cuttlefish::KernelLogEventsHandler;
 using cuttlefish::webrtc_streaming::LocalRecorder;
 using cuttlefish::webrtc_streaming::Streamer;
@@ -87,6 +101,26 @@ class CfOperatorObserver
     LOG(ERROR) << "Error encountered in connection with Operator";
   }
 };
+
+constexpr auto kInputLatencyReportPeriod = std::chrono::seconds(10);
+
+// Replaces the report at once so that readers never see a partial one.
+void WriteInputLatencyReport(const std::string& path,
+                             const Json::Value& report) {
+  auto temp_path = path + ".tmp";
+  {
+    std::ofstream out(temp_path);
+    out << Json::writeString(Json::StreamWriterBuilder(), report);
+    if (!out) {
+      LOG(ERROR) << "Failed to write " << temp_path;
+      return;
+    }
+  }
+  if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+    PLOG(ERROR) << "Failed to rename " << temp_path << " to " << path;
+  }
+}
+
 std::unique_ptr<cuttlefish::AudioServer> CreateAudioServer() {
   cuttlefish::SharedFD audio_server_fd =
       cuttlefish::SharedFD::Dup(FLAGS_audio_server_fd);
@@ -208,6 +242,7 @@ int main(int argc, char** argv) {
   streamer_config.client_files_port = client_server->port();
   streamer_config.tcp_port_range = instance.webrtc_tcp_port_range();
   streamer_config.udp_port_range = instance.webrtc_udp_port_range();
+  streamer_config.shared_video_encoders = FLAGS_shared_video_encoders;
   streamer_config.operator_server.addr = cvd_config->sig_server_address();
   streamer_config.operator_server.port = cvd_config->sig_server_port();
   streamer_config.operator_server.path = cvd_config->sig_server_path();
@@ -225,6 +260,12 @@ int main(int argc, char** argv) {
   auto observer_factory = std::make_shared<CfConnectionObserverFactory>(
       input_sockets, &kernel_logs_event_handler, confui_virtual_input);
 
+  std::shared_ptr<InputLatencyTracer> input_latency;
+  if (FLAGS_trace_input_latency) {
+    input_latency = std::make_shared<InputLatencyTracer>();
+    observer_factory->SetInputLatencyTracer(input_latency);
+  }
+
   // The recorder is created first, so displays added in callbacks to the
   // Streamer can also be added to the LocalRecorder.
   std::unique_ptr<cuttlefish::webrtc_streaming::LocalRecorder> local_recorder;
@@ -245,8 +286,8 @@ int main(int argc, char** argv) {
       Streamer::Create(streamer_config, local_recorder.get(), observer_factory);
   CHECK(streamer) << "Could not create streamer";
 
-  auto display_handler =
-      std::make_shared<DisplayHandler>(*streamer, screen_connector);
+  auto display_handler = std::make_shared<DisplayHandler>(
+      *streamer, screen_connector, input_latency);
 
   if (instance.camera_server_port()) {
     auto camera_controller = streamer->AddCamera(instance.camera_server_port(),
@@ -380,6 +421,28 @@ int main(int argc, char** argv) {
     LOG(DEBUG) << "control socket closed";
   });
 
+  if (input_latency) {
+    auto report_path = instance.webrtc_input_latency_path();
+    // The streamer outlives the thread, main never returns from the display
+    // handler's loop.
+    std::thread([input_latency, streamer = streamer.get(), report_path]() {
+      uint64_t reported_frames = 0;
+      while (true) {
+        std::this_thread::sleep_for(kInputLatencyReportPeriod);
+        auto frames = input_latency->frames();
+        if (frames == reported_frames) {
+          continue;
+        }
+        reported_frames = frames;
+        auto report = input_latency->Report();
+        WriteInputLatencyReport(report_path, report);
+        Json::Value stats;
+        stats["input_latency"] = report;
+        streamer->PublishStats(stats);
+      }
+    }).detach();
+  }
+
   if (audio_handler) {
     audio_handler->Start();
   }
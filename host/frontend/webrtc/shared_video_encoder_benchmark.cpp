@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <api/video/i420_buffer.h>
+#include <api/video/video_bitrate_allocation.h>
+#include <api/video/video_frame.h>
+#include <api/video_codecs/builtin_video_encoder_factory.h>
+#include <api/video_codecs/video_encoder.h>
+#include <benchmark/benchmark.h>
+#include <modules/video_coding/include/video_error_codes.h>
+
+#include "host/frontend/webrtc/libcommon/shared_video_encoder.h"
+#include "host/frontend/webrtc/libcommon/vp8only_encoder_factory.h"
+
+namespace cuttlefish {
+namespace webrtc_streaming {
+namespace {
+
+constexpr int kWidth = 1280;
+constexpr int kHeight = 720;
+constexpr int kFramerate = 60;
+// Distinct frames cycled through so that there is always something to encode.
+constexpr int kFrames = 8;
+
+// Stands in for the network side of a peer connection.
+class CountingSink : public webrtc::EncodedImageCallback {
+ public:
+  webrtc::EncodedImageCallback::Result OnEncodedImage(
+      const webrtc::EncodedImage& encoded_image,
+      const webrtc::CodecSpecificInfo*) override {
+    frames++;
+    bytes += encoded_image.size();
+    return webrtc::EncodedImageCallback::Result(
+        webrtc::EncodedImageCallback::Result::Error::OK);
+  }
+
+  int64_t frames = 0;
+  int64_t bytes = 0;
+};
+
+webrtc::VideoCodec Codec() {
+  webrtc::VideoCodec codec;
+  memset(&codec, 0, sizeof(codec));
+  codec.codecType = webrtc::kVideoCodecVP8;
+  codec.width = kWidth;
+  codec.height = kHeight;
+  codec.startBitrate = 1000;
+  codec.maxBitrate = 4000;
+  codec.maxFramerate = kFramerate;
+  codec.active = true;
+  codec.qpMax = 56;
+  codec.mode = webrtc::VideoCodecMode::kScreensharing;
+  *codec.VP8() = webrtc::VideoEncoder::GetDefaultVp8Settings();
+  return codec;
+}
+
+std::vector<rtc::scoped_refptr<webrtc::I420Buffer>> Buffers() {
+  std::vector<rtc::scoped_refptr<webrtc::I420Buffer>> buffers;
+  for (int i = 0; i < kFrames; i++) {
+    auto buffer = webrtc::I420Buffer::Create(kWidth, kHeight);
+    // Moving stripes, so every frame differs from the previous one.
+    for (int y = 0; y < kHeight; y++) {
+      for (int x = 0; x < kWidth; x++) {
+        buffer->MutableDataY()[y * buffer->StrideY() + x] =
+            ((x + y + i * 16) / 32) % 2 ? 235 : 16;
+      }
+    }
+    memset(buffer->MutableDataU(), 128,
+           buffer->StrideU() * buffer->ChromaHeight());
+    memset(buffer->MutableDataV(), 128,
+           buffer->StrideV() * buffer->ChromaHeight());
+    buffers.push_back(buffer);
+  }
+  return buffers;
+}
+
+webrtc::VideoFrame Frame(const rtc::scoped_refptr<webrtc::I420Buffer>& buffer,
+                         int64_t index) {
+  int64_t timestamp_us = index * 1000000 / kFramerate;
+  return webrtc::VideoFrame::Builder()
+      .set_video_frame_buffer(buffer)
+      .set_timestamp_us(timestamp_us)
+      .set_timestamp_rtp(static_cast<uint32_t>(timestamp_us / 1000 * 90))
+      .build();
+}
+
+// The bitrate webrtc allocates to each viewer, spread over |encodings| of the
+// shared encodings.
+uint32_t ViewerBitrate(int viewer, int encodings) {
+  const auto& bitrates = SharedVideoEncoders::EncodingBitrates();
+  return bitrates[bitrates.size() - 1 - viewer % encodings];
+}
+
+webrtc::VideoEncoder::RateControlParameters Rates(uint32_t bitrate_bps) {
+  webrtc::VideoBitrateAllocation allocation;
+  allocation.SetBitrate(0, 0, bitrate_bps);
+  return webrtc::VideoEncoder::RateControlParameters(allocation, kFramerate);
+}
+
+// Encodes every frame once for each of the viewers through encoders from
+// |factory| and reports the time per frame.
+void EncodeForViewers(benchmark::State& state,
+                      webrtc::VideoEncoderFactory& factory,
+                      const std::vector<rtc::scoped_refptr<webrtc::I420Buffer>>&
+                          buffers) {
+  const int viewers = state.range(0);
+  const int encodings = state.range(1);
+
+  webrtc::VideoEncoder::Capabilities capabilities(false);
+  webrtc::VideoEncoder::Settings settings(capabilities, 1, 1 << 20);
+  auto codec = Codec();
+  std::vector<std::unique_ptr<webrtc::VideoEncoder>> encoders;
+  std::vector<CountingSink> sinks(viewers);
+  for (int i = 0; i < viewers; i++) {
+    auto encoder = factory.CreateVideoEncoder(webrtc::SdpVideoFormat("VP8"));
+    if (!encoder ||
+        encoder->InitEncode(&codec, settings) != WEBRTC_VIDEO_CODEC_OK) {
+      state.SkipWithError("Failed to initialize encoder");
+      return;
+    }
+    encoder->RegisterEncodeCompleteCallback(&sinks[i]);
+    encoder->SetRates(Rates(ViewerBitrate(i, encodings)));
+    encoders.push_back(std::move(encoder));
+  }
+
+  std::vector<webrtc::VideoFrameType> key = {
+      webrtc::VideoFrameType::kVideoFrameKey};
+  std::vector<webrtc::VideoFrameType> delta = {
+      webrtc::VideoFrameType::kVideoFrameDelta};
+  int64_t index = 0;
+  for (auto _ : state) {
+    auto frame = Frame(buffers[index % buffers.size()], index);
+    for (auto& encoder : encoders) {
+      encoder->Encode(frame, index == 0 ? &key : &delta);
+    }
+    index++;
+  }
+
+  int64_t frames = 0;
+  int64_t bytes = 0;
+  for (const auto& sink : sinks) {
+    frames += sink.frames;
+    bytes += sink.bytes;
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["delivered_frames"] =
+      benchmark::Counter(frames, benchmark::Counter::kIsRate);
+  state.counters["delivered_bytes"] =
+      benchmark::Counter(bytes, benchmark::Counter::kIsRate);
+}
+
+// What every viewer costs today: an encoder each.
+void BM_IndependentEncoders(benchmark::State& state) {
+  auto buffers = Buffers();
+  VP8OnlyEncoderFactory factory(webrtc::CreateBuiltinVideoEncoderFactory());
+  EncodeForViewers(state, factory, buffers);
+}
+
+// Viewers of the same display sharing its encodings, the time per frame should
+// depend on the number of encodings only.
+void BM_SharedEncoders(benchmark::State& state) {
+  auto buffers = Buffers();
+  auto shared = SharedVideoEncoders::Create(
+      std::make_unique<VP8OnlyEncoderFactory>(
+          webrtc::CreateBuiltinVideoEncoderFactory()));
+  auto group = shared->CreateGroup();
+  // As the display's track source does with the frames it produces.
+  std::vector<std::unique_ptr<SharedVideoEncoders::FrameTag>> tags;
+  for (const auto& buffer : buffers) {
+    tags.push_back(
+        std::make_unique<SharedVideoEncoders::FrameTag>(group, buffer.get()));
+  }
+  auto factory = shared->CreateEncoderFactory();
+  EncodeForViewers(state, *factory, buffers);
+}
+
+void Viewers(benchmark::internal::Benchmark* benchmark) {
+  benchmark->ArgNames({"viewers", "encodings"});
+  for (int encodings : {1, 3}) {
+    for (int viewers : {1, 2, 4, 8}) {
+      benchmark->Args({viewers, encodings});
+    }
+  }
+}
+
+BENCHMARK(BM_IndependentEncoders)
+    ->Apply(Viewers)
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
+BENCHMARK(BM_SharedEncoders)
+    ->Apply(Viewers)
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace webrtc_streaming
+}  // namespace cuttlefish
+
+BENCHMARK_MAIN();
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "host/frontend/webrtc/touch_event_queue.h"
+
+#include <linux/input.h>
+
+#include <utility>
+
+namespace cuttlefish {
+
+using webrtc_streaming::MultiTouchPoint;
+
+void TouchEventQueue::Touch(int32_t x, int32_t y, bool down) {
+  CloseMultiTouchMoves();
+  if (down && touch_down_) {
+    if (touch_move_) {
+      merged_moves_++;
+    }
+    touch_move_ = TouchMove{x, y};
+  } else {
+    CloseTouchMove();
+    QueueTouch(x, y, down);
+    touch_down_ = down;
+  }
+}
+
+void TouchEventQueue::MultiTouch(const MultiTouchPoint* points, size_t count,
+                                 bool down) {
+  CloseTouchMove();
+  bool moves_only = down;
+  for (size_t i = 0; i < count && moves_only; i++) {
+    moves_only = active_touch_slots_.count(points[i].slot) > 0;
+  }
+  if (moves_only) {
+    for (size_t i = 0; i < count; i++) {
+      MergeMove(points[i]);
+    }
+  } else {
+    CloseMultiTouchMoves();
+    QueueMultiTouch(points, count, down);
+  }
+}
+
+bool TouchEventQueue::empty() const {
+  return queued_.empty() && multi_touch_moves_.empty() && !touch_move_;
+}
+
+void TouchEventQueue::TakeEvents(std::vector<Event>& events) {
+  CloseMultiTouchMoves();
+  CloseTouchMove();
+  events.clear();
+  // Swapped rather than copied, so both vectors keep their capacity.
+  std::swap(events, queued_);
+}
+
+void TouchEventQueue::Queue(uint16_t type, uint16_t code, int32_t value) {
+  queued_.push_back(Event{type, code, value});
+}
+
+void TouchEventQueue::QueueTouch(int32_t x, int32_t y, bool down) {
+  Queue(EV_ABS, ABS_X, x);
+  Queue(EV_ABS, ABS_Y, y);
+  Queue(EV_KEY, BTN_TOUCH, down);
+  Queue(EV_SYN, SYN_REPORT, 0);
+}
+
+void TouchEventQueue::QueueMultiTouch(const MultiTouchPoint* points,
+                                      size_t count, bool down) {
+  for (size_t i = 0; i < count; i++) {
+    const auto& point = points[i];
+    Queue(EV_ABS, ABS_MT_SLOT, point.slot);
+    if (down) {
+      bool is_new = active_touch_slots_.insert(point.slot).second;
+      if (is_new) {
+        Queue(EV_ABS, ABS_MT_TRACKING_ID, point.id);
+        if (active_touch_slots_.size() == 1) {
+          Queue(EV_KEY, BTN_TOUCH, 1);
+        }
+      }
+      Queue(EV_ABS, ABS_MT_POSITION_X, point.x);
+      Queue(EV_ABS, ABS_MT_POSITION_Y, point.y);
+      // send ABS_X and ABS_Y for single-touch compatibility
+      Queue(EV_ABS, ABS_X, point.x);
+      Queue(EV_ABS, ABS_Y, point.y);
+    } else {
+      // released touch
+      Queue(EV_ABS, ABS_MT_TRACKING_ID, point.id);
+      active_touch_slots_.erase(point.slot);
+      if (active_touch_slots_.empty()) {
+        Queue(EV_KEY, BTN_TOUCH, 0);
+      }
+    }
+  }
+  Queue(EV_SYN, SYN_REPORT, 0);
+}
+
+void TouchEventQueue::MergeMove(const MultiTouchPoint& point) {
+  for (auto& move : multi_touch_moves_) {
+    if (move.slot == point.slot) {
+      move = point;
+      merged_moves_++;
+      return;
+    }
+  }
+  multi_touch_moves_.push_back(point);
+}
+
+void TouchEventQueue::CloseMultiTouchMoves() {
+  if (multi_touch_moves_.empty()) {
+    return;
+  }
+  QueueMultiTouch(multi_touch_moves_.data(), multi_touch_moves_.size(), true);
+  multi_touch_moves_.clear();
+}
+
+void TouchEventQueue::CloseTouchMove() {
+  if (!touch_move_) {
+    return;
+  }
+  QueueTouch(touch_move_->x, touch_move_->y, true);
+  touch_move_.reset();
+}
+
+}  // namespace cuttlefish
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <set>
+#include <vector>
+
+#include "host/frontend/webrtc/libdevice/connection_observer.h"
+
+namespace cuttlefish {
+
+// The input events of a display waiting to be written to its touch socket.
+// Moves that arrive before the previous report is taken are merged into it,
+// keeping the latest position of each slot, so a guest slow to read catches
+// up at once instead of replaying every intermediate position. Contacts
+// starting or ending are never merged, so gestures keep their shape.
+//
+// Not thread safe.
+class TouchEventQueue {
+ public:
+  struct Event {
+    uint16_t type;
+    uint16_t code;
+    int32_t value;
+  };
+
+  void Touch(int32_t x, int32_t y, bool down);
+  void MultiTouch(const webrtc_streaming::MultiTouchPoint* points,
+                  size_t count, bool down);
+
+  bool empty() const;
+  // Replaces the contents of |events| with all the queued events, in order,
+  // including the report still open to merging.
+  void TakeEvents(std::vector<Event>& events);
+
+  // How many moves were folded into a later one.
+  uint64_t merged_moves() const { return merged_moves_; }
+
+ private:
+  struct TouchMove {
+    int32_t x;
+    int32_t y;
+  };
+
+  void Queue(uint16_t type, uint16_t code, int32_t value);
+  void QueueTouch(int32_t x, int32_t y, bool down);
+  void QueueMultiTouch(const webrtc_streaming::MultiTouchPoint* points,
+                       size_t count, bool down);
+  void MergeMove(const webrtc_streaming::MultiTouchPoint& point);
+  // Moves to the queue the reports still open to merging.
+  void CloseMultiTouchMoves();
+  void CloseTouchMove();
+
+  // Complete reports.
+  std::vector<Event> queued_;
+  // The last report, while it only moves contacts and can still be merged
+  // with the next.
+  std::vector<webrtc_streaming::MultiTouchPoint> multi_touch_moves_;
+  std::optional<TouchMove> touch_move_;
+  // Contacts as of the last event queued.
+  bool touch_down_ = false;
+  std::set<int32_t> active_touch_slots_;
+  uint64_t merged_moves_ = 0;
+};
+
+}  // namespace cuttlefish
@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "host/frontend/webrtc/touch_event_queue.h"
+
+#include <linux/input.h>
+
+#include <initializer_list>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace cuttlefish {
+
+bool operator==(const TouchEventQueue::Event& a,
+                const TouchEventQueue::Event& b) {
+  return a.type == b.type && a.code == b.code && a.value == b.value;
+}
+
+namespace {
+
+using webrtc_streaming::MultiTouchPoint;
+using Events = std::vector<TouchEventQueue::Event>;
+
+Events Concat(std::initializer_list<Events> parts) {
+  Events events;
+  for (const auto& part : parts) {
+    events.insert(events.end(), part.begin(), part.end());
+  }
+  return events;
+}
+
+Events TouchReport(int32_t x, int32_t y, bool down) {
+  return {{EV_ABS, ABS_X, x},
+          {EV_ABS, ABS_Y, y},
+          {EV_KEY, BTN_TOUCH, down},
+          {EV_SYN, SYN_REPORT, 0}};
+}
+
+Events Position(const MultiTouchPoint& point) {
+  return {{EV_ABS, ABS_MT_POSITION_X, point.x},
+          {EV_ABS, ABS_MT_POSITION_Y, point.y},
+          {EV_ABS, ABS_X, point.x},
+          {EV_ABS, ABS_Y, point.y}};
+}
+
+// The events of a contact moving, without the report's SYN_REPORT.
+Events SlotMove(const MultiTouchPoint& point) {
+  return Concat({{{EV_ABS, ABS_MT_SLOT, point.slot}}, Position(point)});
+}
+
+const Events kSyn = {{EV_SYN, SYN_REPORT, 0}};
+
+class TouchEventQueueTest : public ::testing::Test {
+ protected:
+  Events Take() {
+    Events events;
+    queue_.TakeEvents(events);
+    EXPECT_TRUE(queue_.empty());
+    return events;
+  }
+
+  TouchEventQueue queue_;
+};
+
+TEST_F(TouchEventQueueTest, MergesConsecutiveTouchMoves) {
+  queue_.Touch(1, 1, true);
+  queue_.Touch(2, 2, true);
+  queue_.Touch(3, 3, true);
+  queue_.Touch(4, 4, true);
+
+  EXPECT_EQ(Take(), Concat({TouchReport(1, 1, true), TouchReport(4, 4, true)}));
+  EXPECT_EQ(queue_.merged_moves(), 2);
+}
+
+TEST_F(TouchEventQueueTest, NeverDropsTouchDownOrUp) {
+  queue_.Touch(1, 1, true);
+  queue_.Touch(2, 2, true);
+  queue_.Touch(3, 3, false);
+  queue_.Touch(4, 4, true);
+  queue_.Touch(5, 5, false);
+
+  EXPECT_EQ(Take(), Concat({TouchReport(1, 1, true), TouchReport(2, 2, true),
+                            TouchReport(3, 3, false), TouchReport(4, 4, true),
+                            TouchReport(5, 5, false)}));
+  EXPECT_EQ(queue_.merged_moves(), 0);
+}
+
+TEST_F(TouchEventQueueTest, DoesNotMergeAcrossTakes) {
+  queue_.Touch(1, 1, true);
+  queue_.Touch(2, 2, true);
+  EXPECT_EQ(Take(), Concat({TouchReport(1, 1, true), TouchReport(2, 2, true)}));
+
+  queue_.Touch(3, 3, true);
+  EXPECT_EQ(Take(), TouchReport(3, 3, true));
+}
+
+TEST_F(TouchEventQueueTest, MergesMultiTouchMovesPerSlot) {
+  MultiTouchPoint first_down[] = {{.id = 1, .slot = 0, .x = 0, .y = 0},
+                                  {.id = 2, .slot = 1, .x = 100, .y = 100}};
+  queue_.MultiTouch(first_down, 2, true);
+  Take();
+
+  MultiTouchPoint slot0_a = {.id = 1, .slot = 0, .x = 1, .y = 1};
+  MultiTouchPoint slot1 = {.id = 2, .slot = 1, .x = 101, .y = 101};
+  MultiTouchPoint slot0_b = {.id = 1, .slot = 0, .x = 2, .y = 2};
+  queue_.MultiTouch(&slot0_a, 1, true);
+  queue_.MultiTouch(&slot1, 1, true);
+  queue_.MultiTouch(&slot0_b, 1, true);
+
+  // One report with the latest position of each slot, in the order the slots
+  // first moved.
+  EXPECT_EQ(Take(), Concat({SlotMove(slot0_b), SlotMove(slot1), kSyn}));
+  EXPECT_EQ(queue_.merged_moves(), 1);
+}
+
+TEST_F(TouchEventQueueTest, KeepsMultiTouchDownAndUpInOrder) {
+  MultiTouchPoint slot0_down = {.id = 1, .slot = 0, .x = 0, .y = 0};
+  MultiTouchPoint slot0_move = {.id = 1, .slot = 0, .x = 5, .y = 5};
+  MultiTouchPoint slot1_down = {.id = 2, .slot = 1, .x = 50, .y = 50};
+  MultiTouchPoint slot0_up = {.id = -1, .slot = 0, .x = 5, .y = 5};
+  MultiTouchPoint slot1_move = {.id = 2, .slot = 1, .x = 60, .y = 60};
+  queue_.MultiTouch(&slot0_down, 1, true);
+  queue_.MultiTouch(&slot0_move, 1, true);
+  // A new contact closes the pending move of the other slot.
+  queue_.MultiTouch(&slot1_down, 1, true);
+  queue_.MultiTouch(&slot0_up, 1, false);
+  queue_.MultiTouch(&slot1_move, 1, true);
+
+  Events expected = Concat({
+      // slot 0 down
+      {{EV_ABS, ABS_MT_SLOT, 0},
+       {EV_ABS, ABS_MT_TRACKING_ID, 1},
+       {EV_KEY, BTN_TOUCH, 1}},
+      Position(slot0_down),
+      kSyn,
+      SlotMove(slot0_move),
+      kSyn,
+      // slot 1 down
+      {{EV_ABS, ABS_MT_SLOT, 1}, {EV_ABS, ABS_MT_TRACKING_ID, 2}},
+      Position(slot1_down),
+      kSyn,
+      // slot 0 up
+      {{EV_ABS, ABS_MT_SLOT, 0}, {EV_ABS, ABS_MT_TRACKING_ID, -1}},
+      kSyn,
+      SlotMove(slot1_move),
+      kSyn,
+  });
+  EXPECT_EQ(Take(), expected);
+  EXPECT_EQ(queue_.merged_moves(), 0);
+}
+
+TEST_F(TouchEventQueueTest, ReleasingLastContactLiftsTouch) {
+  MultiTouchPoint down = {.id = 1, .slot = 0, .x = 0, .y = 0};
+  MultiTouchPoint up = {.id = -1, .slot = 0, .x = 0, .y = 0};
+  queue_.MultiTouch(&down, 1, true);
+  Take();
+
+  queue_.MultiTouch(&up, 1, false);
+
+  EXPECT_EQ(Take(), Concat({{{EV_ABS, ABS_MT_SLOT, 0},
+                             {EV_ABS, ABS_MT_TRACKING_ID, -1},
+                             {EV_KEY, BTN_TOUCH, 0}},
+                            kSyn}));
+}
+
+}  // namespace
+}  // namespace cuttlefish
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "host/frontend/webrtc/video_frame_buffer_pool.h"
+
+#include <algorithm>
+
+namespace cuttlefish {
+
+std::shared_ptr<VideoFrameBufferPool> VideoFrameBufferPool::Create(
+    std::size_t max_free_buffers) {
+  return std::shared_ptr<VideoFrameBufferPool>(
+      new VideoFrameBufferPool(max_free_buffers));
+}
+
+VideoFrameBufferPool::VideoFrameBufferPool(std::size_t max_free_buffers)
+    : max_free_buffers_(max_free_buffers) {}
+
+std::shared_ptr<CvdVideoFrameBuffer> VideoFrameBufferPool::Get(int width,
+                                                               int height) {
+  std::unique_ptr<CvdVideoFrameBuffer> buffer;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (!free_buffers_.empty() && !buffer) {
+      buffer = std::move(free_buffers_.back());
+      free_buffers_.pop_back();
+      if (buffer->width() != width || buffer->height() != height) {
+        // Left over from before a resolution change, it won't be used again.
+        buffer.reset();
+      }
+    }
+    if (buffer) {
+      stats_.hits++;
+    } else {
+      stats_.misses++;
+    }
+    stats_.outstanding++;
+    stats_.peak_outstanding =
+        std::max(stats_.peak_outstanding, stats_.outstanding);
+  }
+  if (!buffer) {
+    buffer = std::make_unique<CvdVideoFrameBuffer>(width, height);
+  }
+  std::weak_ptr<VideoFrameBufferPool> weak_pool = weak_from_this();
+  return std::shared_ptr<CvdVideoFrameBuffer>(
+      buffer.release(), [weak_pool](CvdVideoFrameBuffer* buffer) {
+        if (auto pool = weak_pool.lock()) {
+          pool->Release(buffer);
+        } else {
+          delete buffer;
+        }
+      });
+}
+
+void VideoFrameBufferPool::Release(CvdVideoFrameBuffer* buffer) {
+  std::unique_ptr<CvdVideoFrameBuffer> owned(buffer);
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.outstanding--;
+  if (free_buffers_.size() < max_free_buffers_) {
+    free_buffers_.push_back(std::move(owned));
+  }
+}
+
+VideoFrameBufferPool::Stats VideoFrameBufferPool::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+}  // namespace cuttlefish
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "host/frontend/webrtc/cvd_video_frame_buffer.h"
+
+namespace cuttlefish {
+
+// Recycles the frame buffers of a single display. Buffers handed out by Get()
+// go back to the pool when the last reference to them is dropped, usually when
+// WebRTC is done encoding the frame, so a steady stream of frames of the same
+// size doesn't allocate at all.
+class VideoFrameBufferPool
+    : public std::enable_shared_from_this<VideoFrameBufferPool> {
+ public:
+  struct Stats {
+    // Buffers served from the pool.
+    std::uint64_t hits = 0;
+    // Buffers that had to be allocated.
+    std::uint64_t misses = 0;
+    // Buffers currently referenced outside the pool.
+    std::size_t outstanding = 0;
+    // Maximum value ever reached by outstanding.
+    std::size_t peak_outstanding = 0;
+  };
+
+  // The pool must be owned by a shared_ptr so that outstanding buffers can
+  // safely outlive it.
+  static std::shared_ptr<VideoFrameBufferPool> Create(
+      std::size_t max_free_buffers = kDefaultMaxFreeBuffers);
+
+  VideoFrameBufferPool(const VideoFrameBufferPool&) = delete;
+  VideoFrameBufferPool& operator=(const VideoFrameBufferPool&) = delete;
+
+  // Returns a buffer of the given dimensions. Its contents are unspecified.
+  std::shared_ptr<CvdVideoFrameBuffer> Get(int width, int height);
+
+  Stats GetStats() const;
+
+ private:
+  static constexpr std::size_t kDefaultMaxFreeBuffers = 8;
+
+  VideoFrameBufferPool(std::size_t max_free_buffers);
+
+  void Release(CvdVideoFrameBuffer* buffer);
+
+  const std::size_t max_free_buffers_;
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<CvdVideoFrameBuffer>> free_buffers_;
+  Stats stats_;
+};
+
+}  // namespace cuttlefish
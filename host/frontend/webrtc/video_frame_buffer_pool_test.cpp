@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "host/frontend/webrtc/video_frame_buffer_pool.h"
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace cuttlefish {
+namespace {
+
+TEST(VideoFrameBufferPoolTest, ReusesBufferOnceLastReferenceDrops) {
+  auto pool = VideoFrameBufferPool::Create();
+  auto buffer = pool->Get(64, 32);
+  auto* address = buffer.get();
+  auto reference = buffer;
+
+  buffer.reset();
+  EXPECT_EQ(pool->GetStats().outstanding, 1);
+  auto other = pool->Get(64, 32);
+  EXPECT_NE(other.get(), address);
+
+  reference.reset();
+  EXPECT_EQ(pool->GetStats().outstanding, 1);
+  auto reused = pool->Get(64, 32);
+  EXPECT_EQ(reused.get(), address);
+
+  auto stats = pool->GetStats();
+  EXPECT_EQ(stats.hits, 1);
+  EXPECT_EQ(stats.misses, 2);
+  EXPECT_EQ(stats.outstanding, 2);
+  EXPECT_EQ(stats.peak_outstanding, 2);
+}
+
+TEST(VideoFrameBufferPoolTest, ReallocatesOnSizeChange) {
+  auto pool = VideoFrameBufferPool::Create();
+  pool->Get(64, 32).reset();
+
+  auto buffer = pool->Get(32, 64);
+
+  EXPECT_EQ(buffer->width(), 32);
+  EXPECT_EQ(buffer->height(), 64);
+  EXPECT_EQ(pool->GetStats().hits, 0);
+  EXPECT_EQ(pool->GetStats().misses, 2);
+
+  // The buffer of the old size was dropped rather than kept around.
+  buffer.reset();
+  pool->Get(32, 64).reset();
+  pool->Get(64, 32).reset();
+  EXPECT_EQ(pool->GetStats().hits, 1);
+  EXPECT_EQ(pool->GetStats().misses, 3);
+}
+
+TEST(VideoFrameBufferPoolTest, KeepsAtMostMaxFreeBuffers) {
+  auto pool = VideoFrameBufferPool::Create(2);
+  std::vector<std::shared_ptr<CvdVideoFrameBuffer>> buffers;
+  for (int i = 0; i < 3; i++) {
+    buffers.push_back(pool->Get(16, 16));
+  }
+  EXPECT_EQ(pool->GetStats().peak_outstanding, 3);
+  buffers.clear();
+  EXPECT_EQ(pool->GetStats().outstanding, 0);
+
+  for (int i = 0; i < 3; i++) {
+    buffers.push_back(pool->Get(16, 16));
+  }
+
+  auto stats = pool->GetStats();
+  EXPECT_EQ(stats.hits, 2);
+  EXPECT_EQ(stats.misses, 4);
+}
+
+TEST(VideoFrameBufferPoolTest, BuffersOutliveThePool) {
+  auto pool = VideoFrameBufferPool::Create();
+  auto buffer = pool->Get(16, 16);
+
+  pool.reset();
+
+  EXPECT_EQ(buffer->width(), 16);
+  buffer.reset();
+}
+
+}  // namespace
+}  // namespace cuttlefish
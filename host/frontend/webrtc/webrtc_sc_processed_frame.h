@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <memory>
+#include <optional>
+
+#include "host/frontend/webrtc/cvd_video_frame_buffer.h"
+#include "host/frontend/webrtc/input_latency.h"
+#include "host/libs/screen_connector/screen_connector_common.h"
+
+namespace cuttlefish {
+/**
+ * ScreenConnectorImpl will generate this, and enqueue
+ *
+ * It's basically a (processed) frame, so it:
+ *   must be efficiently std::move-able
+ * Also, for the sake of algorithm simplicity:
+ *   must be default-constructable & assignable
+ *
+ */
+struct WebRtcScProcessedFrame : public ScreenConnectorFrameInfo {
+  // must support move semantic
+  // usually owned by a VideoFrameBufferPool, which gets it back once the last
+  // reference is dropped
+  std::shared_ptr<CvdVideoFrameBuffer> buf_;
+  // Set when the frame is the first to answer a touch.
+  std::optional<InputLatencyTrace> latency_trace_;
+  std::unique_ptr<WebRtcScProcessedFrame> Clone() {
+    // copy internal buffer, not move
+    auto cloned_frame = std::make_unique<WebRtcScProcessedFrame>();
+    cloned_frame->buf_ = std::make_shared<CvdVideoFrameBuffer>(*buf_);
+    cloned_frame->latency_trace_ = latency_trace_;
+    return std::move(cloned_frame);
+  }
+};
+
+}  // namespace cuttlefish
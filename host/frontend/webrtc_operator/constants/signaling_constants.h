@@ -26,6 +26,7 @@ constexpr auto kPayloadField = "payload";
 constexpr auto kServersField = "ice_servers";
 constexpr auto kClientSecretField = "connection_id";
 constexpr auto kDevicePortField = "device_port";
+constexpr auto kStatsField = "stats";
 // These are defined in the IceServer dictionary
 constexpr auto kUrlsField = "urls";
 constexpr auto kUsernameField = "username";
@@ -41,6 +42,7 @@ constexpr auto kClientMessageType = "client_msg";
 constexpr auto kClientDisconnectType = "client_disconnected";
 constexpr auto kDeviceMessageType = "device_msg";
 constexpr auto kPollType = "client_poll";
+constexpr auto kDeviceStatsType = "device_stats";
 
 }  // namespace webrtc_signaling
 }  // namespace cuttlefish
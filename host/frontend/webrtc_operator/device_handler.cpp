@@ -44,6 +44,8 @@ void DeviceHandler::handleMessage(const std::string& type,
     HandleRegistrationRequest(message);
   } else if (type == webrtc_signaling::kForwardType) {
     HandleForward(message);
+  } else if (type == webrtc_signaling::kDeviceStatsType) {
+    HandleStats(message);
   } else {
     LogAndReplyError("Unknown message type: " + type);
   }
@@ -103,6 +105,19 @@ void DeviceHandler::HandleForward(const Json::Value& message) {
   return;
 }
 
+void DeviceHandler::HandleStats(const Json::Value& message) {
+  if (device_id_.empty()) {
+    LogAndReplyError("Stats received before registration");
+    return;
+  }
+  if (!message.isMember(webrtc_signaling::kStatsField) ||
+      !message[webrtc_signaling::kStatsField].isObject()) {
+    LogAndReplyError("Missing or invalid stats");
+    return;
+  }
+  stats_ = message[webrtc_signaling::kStatsField];
+}
+
 void DeviceHandler::SendClientMessage(size_t client_id,
                                       const Json::Value& client_message) {
   Json::Value msg;
@@ -37,6 +37,8 @@ class DeviceHandler : public SignalHandler,
                 const ServerConfig& server_config);
 
   Json::Value device_info() const { return device_info_; }
+  // The latest stats published by the device, null if none.
+  Json::Value stats() const { return stats_; }
 
   size_t RegisterClient(std::shared_ptr<ClientHandler> client_handler);
   void SendClientMessage(size_t client_id, const Json::Value& message);
@@ -51,9 +53,11 @@ class DeviceHandler : public SignalHandler,
  private:
   void HandleRegistrationRequest(const Json::Value& message);
   void HandleForward(const Json::Value& message);
+  void HandleStats(const Json::Value& message);
 
   std::string device_id_;
   Json::Value device_info_;
+  Json::Value stats_;
   std::vector<std::weak_ptr<ClientHandler>> clients_;
 };
 
@@ -36,4 +36,26 @@ HttpStatusCode DeviceListHandler::DoPost() {
   return HttpStatusCode::NotFound;
 }
 
+DeviceStatsHandler::DeviceStatsHandler(struct lws* wsi,
+                                       DeviceRegistry& registry)
+    : DynHandler(wsi), registry_(registry) {}
+
+HttpStatusCode DeviceStatsHandler::DoGet() {
+  Json::Value reply(Json::ValueType::objectValue);
+
+  for (const auto& id : registry_.ListDeviceIds()) {
+    auto device = registry_.GetDevice(id);
+    if (device && !device->stats().isNull()) {
+      reply[id] = device->stats();
+    }
+  }
+  Json::StreamWriterBuilder json_factory;
+  auto replyAsString = Json::writeString(json_factory, reply);
+  AppendDataOut(replyAsString);
+  return HttpStatusCode::Ok;
+}
+HttpStatusCode DeviceStatsHandler::DoPost() {
+  return HttpStatusCode::NotFound;
+}
+
 }  // namespace cuttlefish
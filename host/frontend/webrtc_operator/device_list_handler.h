@@ -36,4 +36,16 @@ class DeviceListHandler : public DynHandler {
   DeviceRegistry& registry_;
 };
 
+// Serves the stats the registered devices published, by device id.
+class DeviceStatsHandler : public DynHandler {
+ public:
+  DeviceStatsHandler(struct lws* wsi, DeviceRegistry& registry);
+
+  HttpStatusCode DoGet() override;
+  HttpStatusCode DoPost() override;
+
+ private:
+  DeviceRegistry& registry_;
+};
+
 }  // namespace cuttlefish
@@ -42,6 +42,7 @@ namespace {
 constexpr auto kRegisterDeviceUriPath = "/register_device";
 constexpr auto kConnectClientUriPath = "/connect_client";
 constexpr auto kListDevicesUriPath = "/devices";
+constexpr auto kDeviceStatsUriPath = "/device_stats";
 const constexpr auto kInfraConfigPath = "/infra_config";
 const constexpr auto kConnectPath = "/connect";
 const constexpr auto kForwardPath = "/forward";
@@ -72,6 +73,13 @@ int main(int argc, char** argv) {
             new cuttlefish::DeviceListHandler(wsi, device_registry));
       });
 
+  // Stats published by the devices, e.g. their input latency
+  wss.RegisterDynHandlerFactory(
+      kDeviceStatsUriPath, [&device_registry](struct lws* wsi) {
+        return std::unique_ptr<cuttlefish::DynHandler>(
+            new cuttlefish::DeviceStatsHandler(wsi, device_registry));
+      });
+
   // Websocket signaling endpoints
   auto device_handler_factory_p =
       std::unique_ptr<cuttlefish::WebSocketHandlerFactory>(
@@ -15,23 +15,80 @@
 
 #pragma once
 
+#include <chrono>
+#include <functional>
+#include <string>
 #include <utility>
 #include <vector>
 
 #include <fruit/fruit.h>
 
+#include "common/libs/fs/shared_fd.h"
 #include "common/libs/utils/result.h"
 #include "common/libs/utils/subprocess.h"
 #include "host/libs/config/feature.h"
 
 namespace cuttlefish {
 
+// Names of the CommandSources that commands built elsewhere depend on, shared
+// so that renaming a source can't silently drop the dependency.
+inline constexpr char kWmediumdServerSource[] = "WmediumdServer";
+
+// Tells the process monitor when a started command is able to serve the
+// commands depending on it. A command with no readiness check is considered
+// ready as soon as it's started.
+struct MonitorReadiness {
+  // Ready once this path exists, e.g. the unix socket the command listens on.
+  std::string path;
+  // Ready once this fd becomes readable, i.e. when the command writes to or
+  // closes the other end.
+  SharedFD fd;
+  // Dependents are started anyway after this long, with a warning.
+  std::chrono::milliseconds timeout = std::chrono::seconds(30);
+
+  bool IsSet() const { return !path.empty() || fd->IsOpen(); }
+};
+
 struct MonitorCommand {
   Command command;
   bool is_critical;
+  // Name of the CommandSource that produced this command, set by the server
+  // loop. Dependencies refer to commands by this name.
+  std::string source;
+  // CommandSources whose commands must all be ready before this one starts.
+  // Sources that are disabled are ignored.
+  std::vector<std::string> dependencies;
+  MonitorReadiness readiness;
+  // Stop only after all the other commands have exited, for commands that
+  // consume the output of others such as log_collector.
+  bool stop_last = false;
+  // Run by the process monitor every time the command is started, restarts
+  // included, to hand the new process state that has to outlive it.
+  std::function<Result<void>()> on_start;
 
   MonitorCommand(Command command, bool is_critical = false)
       : command(std::move(command)), is_critical(is_critical) {}
+
+  MonitorCommand& DependsOn(std::string source_name) {
+    dependencies.emplace_back(std::move(source_name));
+    return *this;
+  }
+  MonitorCommand& ReadyWhenPathExists(std::string path) {
+    readiness.path = std::move(path);
+    return *this;
+  }
+  MonitorCommand& ReadyWhenReadable(SharedFD fd) {
+    readiness.fd = std::move(fd);
+    return *this;
+  }
+  MonitorCommand& StopLast() {
+    stop_last = true;
+    return *this;
+  }
+  MonitorCommand& OnStart(std::function<Result<void>()> callback) {
+    on_start = std::move(callback);
+    return *this;
+  }
 };
 
 class CommandSource : public virtual SetupFeature {
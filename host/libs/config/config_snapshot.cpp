@@ -0,0 +1,552 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "host/libs/config/config_snapshot.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/strings.h>
+
+#include "common/libs/utils/files.h"
+
+namespace cuttlefish {
+namespace {
+
+constexpr uint32_t kSnapshotMagic = 0x53434643;  // "CFCS"
+constexpr uint32_t kSnapshotVersion = 1;
+// Guards against malformed files nesting deep enough to exhaust the stack.
+constexpr int kMaxDepth = 64;
+
+struct SnapshotHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t size;
+  uint32_t root;
+  uint64_t source_size;
+  int64_t source_mtime_ns;
+};
+
+enum NodeType : uint32_t {
+  kNull = 0,
+  kBool,
+  kInt,
+  kUInt,
+  kReal,
+  kString,
+  kArray,
+  kObject,
+};
+
+uint32_t HashKey(std::string_view key) {
+  uint32_t hash = 2166136261u;
+  for (char c : key) {
+    hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+  }
+  return hash;
+}
+
+uint32_t LoadWord(const char* base, uint32_t offset) {
+  uint32_t word;
+  memcpy(&word, base + offset, sizeof(word));
+  return word;
+}
+
+template <typename T>
+T LoadScalar(const char* base, uint32_t offset) {
+  // Scalars are stored after the type and a padding word.
+  T value;
+  memcpy(&value, base + offset + 2 * sizeof(uint32_t), sizeof(value));
+  return value;
+}
+
+int64_t ModificationTimeNs(const struct stat& st) {
+  return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 +
+         st.st_mtim.tv_nsec;
+}
+
+class SnapshotWriter {
+ public:
+  Result<std::string> Build(const Json::Value& root, uint64_t source_size,
+                            int64_t source_mtime_ns) {
+    out_.assign(sizeof(SnapshotHeader), '\0');
+    SnapshotHeader header = {
+        .magic = kSnapshotMagic,
+        .version = kSnapshotVersion,
+        .size = 0,
+        .root = Write(root),
+        .source_size = source_size,
+        .source_mtime_ns = source_mtime_ns,
+    };
+    CF_EXPECT(out_.size() <= UINT32_MAX, "Config too large for a snapshot");
+    header.size = out_.size();
+    memcpy(out_.data(), &header, sizeof(header));
+    return std::move(out_);
+  }
+
+ private:
+  uint32_t Append(const std::vector<uint32_t>& words) {
+    uint32_t offset = out_.size();
+    out_.append(reinterpret_cast<const char*>(words.data()),
+                words.size() * sizeof(uint32_t));
+    return offset;
+  }
+
+  template <typename T>
+  uint32_t AppendScalar(NodeType type, T value) {
+    uint32_t offset = Append({type, 0});
+    out_.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    return offset;
+  }
+
+  uint32_t WriteString(const std::string& value) {
+    auto it = strings_.find(value);
+    if (it != strings_.end()) {
+      return it->second;
+    }
+    uint32_t offset = Append({kString, static_cast<uint32_t>(value.size())});
+    out_.append(value);
+    out_.append(sizeof(uint32_t) - value.size() % sizeof(uint32_t), '\0');
+    strings_[value] = offset;
+    return offset;
+  }
+
+  uint32_t Write(const Json::Value& value) {
+    switch (value.type()) {
+      case Json::nullValue:
+        return Append({kNull});
+      case Json::booleanValue:
+        return Append({kBool, value.asBool()});
+      case Json::intValue:
+        return AppendScalar<int64_t>(kInt, value.asInt64());
+      case Json::uintValue:
+        return AppendScalar<uint64_t>(kUInt, value.asUInt64());
+      case Json::realValue:
+        return AppendScalar<double>(kReal, value.asDouble());
+      case Json::stringValue:
+        return WriteString(value.asString());
+      case Json::arrayValue: {
+        std::vector<uint32_t> words = {kArray, value.size()};
+        for (const auto& element : value) {
+          words.push_back(Write(element));
+        }
+        return Append(words);
+      }
+      case Json::objectValue: {
+        // The table is kept at most half full so probe sequences stay short
+        // and always end at an empty slot.
+        uint32_t table_size = 1;
+        while (table_size < 2 * value.size()) {
+          table_size *= 2;
+        }
+        std::vector<uint32_t> words = {kObject, value.size(), table_size};
+        std::vector<uint32_t> table(table_size, 0);
+        uint32_t index = 0;
+        for (auto it = value.begin(); it != value.end(); it++, index++) {
+          auto name = it.name();
+          words.push_back(WriteString(name));
+          words.push_back(Write(*it));
+          auto slot = HashKey(name) & (table_size - 1);
+          while (table[slot] != 0) {
+            slot = (slot + 1) & (table_size - 1);
+          }
+          table[slot] = index + 1;
+        }
+        words.insert(words.end(), table.begin(), table.end());
+        return Append(words);
+      }
+    }
+    return Append({kNull});
+  }
+
+  std::string out_;
+  std::unordered_map<std::string, uint32_t> strings_;
+};
+
+// Checks that the node at `offset` and everything reachable from it is within
+// the first `limit` bytes, which are all before the referencing node.
+bool ValidNode(const char* base, uint32_t limit, uint32_t offset, int depth) {
+  auto fits = [limit, offset](uint64_t bytes) {
+    return offset < limit && limit - offset >= bytes;
+  };
+  if (depth > kMaxDepth || offset % sizeof(uint32_t) != 0 ||
+      offset < sizeof(SnapshotHeader) || !fits(sizeof(uint32_t))) {
+    return false;
+  }
+  constexpr uint64_t kWord = sizeof(uint32_t);
+  switch (LoadWord(base, offset)) {
+    case kNull:
+      return true;
+    case kBool:
+      return fits(2 * kWord);
+    case kInt:
+    case kUInt:
+    case kReal:
+      return fits(2 * kWord + sizeof(uint64_t));
+    case kString:
+      return fits(2 * kWord) &&
+             fits(2 * kWord + uint64_t{LoadWord(base, offset + kWord)} + 1);
+    case kArray: {
+      if (!fits(2 * kWord)) {
+        return false;
+      }
+      uint64_t count = LoadWord(base, offset + kWord);
+      if (!fits((2 + count) * kWord)) {
+        return false;
+      }
+      for (uint64_t i = 0; i < count; i++) {
+        if (!ValidNode(base, offset, LoadWord(base, offset + (2 + i) * kWord),
+                       depth + 1)) {
+          return false;
+        }
+      }
+      return true;
+    }
+    case kObject: {
+      if (!fits(3 * kWord)) {
+        return false;
+      }
+      uint64_t count = LoadWord(base, offset + kWord);
+      uint64_t table_size = LoadWord(base, offset + 2 * kWord);
+      if ((table_size & (table_size - 1)) != 0 || table_size <= count ||
+          !fits((3 + 2 * count + table_size) * kWord)) {
+        return false;
+      }
+      for (uint64_t i = 0; i < count; i++) {
+        auto key = LoadWord(base, offset + (3 + 2 * i) * kWord);
+        auto value = LoadWord(base, offset + (4 + 2 * i) * kWord);
+        if (!ValidNode(base, offset, key, depth + 1) ||
+            LoadWord(base, key) != kString ||
+            !ValidNode(base, offset, value, depth + 1)) {
+          return false;
+        }
+      }
+      // Every member must be in the table exactly once. As the table is
+      // larger than the member count, that leaves the empty slot lookups
+      // rely on to stop probing.
+      std::vector<bool> in_table(count, false);
+      for (uint64_t i = 0; i < table_size; i++) {
+        auto entry = LoadWord(base, offset + (3 + 2 * count + i) * kWord);
+        if (entry == 0) {
+          continue;
+        }
+        if (entry > count || in_table[entry - 1]) {
+          return false;
+        }
+        in_table[entry - 1] = true;
+      }
+      return std::find(in_table.begin(), in_table.end(), false) ==
+             in_table.end();
+    }
+    default:
+      return false;
+  }
+}
+
+}  // namespace
+
+uint32_t ConfigValue::Type() const {
+  return base_ ? LoadWord(base_, offset_) : static_cast<uint32_t>(kNull);
+}
+
+uint32_t ConfigValue::Word(uint32_t index) const {
+  return LoadWord(base_, offset_ + index * sizeof(uint32_t));
+}
+
+std::string_view ConfigValue::StringAt(uint32_t offset) const {
+  return std::string_view(base_ + offset + 2 * sizeof(uint32_t),
+                          LoadWord(base_, offset + sizeof(uint32_t)));
+}
+
+ConfigValue ConfigValue::MemberAt(uint32_t index) const {
+  return ConfigValue(base_, Word(4 + 2 * index));
+}
+
+ConfigValue ConfigValue::operator[](std::string_view key) const {
+  if (json_) {
+    if (!json_->isObject()) {
+      return {};
+    }
+    auto member = json_->find(key.data(), key.data() + key.size());
+    return member ? ConfigValue(member) : ConfigValue();
+  }
+  if (Type() != kObject) {
+    return {};
+  }
+  auto count = Word(1);
+  auto mask = Word(2) - 1;
+  for (auto slot = HashKey(key) & mask;; slot = (slot + 1) & mask) {
+    auto entry = Word(3 + 2 * count + slot);
+    if (entry == 0) {
+      return {};
+    }
+    if (StringAt(Word(3 + 2 * (entry - 1))) == key) {
+      return MemberAt(entry - 1);
+    }
+  }
+}
+
+ConfigValue ConfigValue::operator[](int index) const {
+  if (index < 0 || static_cast<uint32_t>(index) >= size()) {
+    return {};
+  }
+  if (json_) {
+    return json_->isArray() ? ConfigValue(&(*json_)[index]) : ConfigValue();
+  }
+  return Type() == kArray ? ConfigValue(base_, Word(2 + index))
+                          : ConfigValue();
+}
+
+bool ConfigValue::isMember(std::string_view key) const {
+  return !(*this)[key].isNull();
+}
+
+bool ConfigValue::isNull() const {
+  return json_ ? json_->isNull() : Type() == kNull;
+}
+
+uint32_t ConfigValue::size() const {
+  if (json_) {
+    return json_->size();
+  }
+  auto type = Type();
+  return type == kArray || type == kObject ? Word(1) : 0;
+}
+
+std::string ConfigValue::asString() const {
+  if (json_) {
+    return json_->asString();
+  }
+  switch (Type()) {
+    case kString:
+      return std::string(StringAt(offset_));
+    case kBool:
+      return Word(1) ? "true" : "false";
+    case kInt:
+    case kUInt:
+    case kReal:
+      return ToJson().asString();
+    default:
+      return "";
+  }
+}
+
+int ConfigValue::asInt() const {
+  return json_ ? json_->asInt() : static_cast<int>(asInt64());
+}
+
+unsigned ConfigValue::asUInt() const {
+  return json_ ? json_->asUInt() : static_cast<unsigned>(asInt64());
+}
+
+int64_t ConfigValue::asInt64() const {
+  if (json_) {
+    return json_->asInt64();
+  }
+  switch (Type()) {
+    case kBool:
+      return Word(1);
+    case kInt:
+      return LoadScalar<int64_t>(base_, offset_);
+    case kUInt:
+      return LoadScalar<uint64_t>(base_, offset_);
+    case kReal:
+      return LoadScalar<double>(base_, offset_);
+    default:
+      return 0;
+  }
+}
+
+bool ConfigValue::asBool() const {
+  if (json_) {
+    return json_->asBool();
+  }
+  switch (Type()) {
+    case kBool:
+      return Word(1);
+    case kInt:
+    case kUInt:
+      return asInt64() != 0;
+    case kReal:
+      return LoadScalar<double>(base_, offset_) != 0;
+    default:
+      return false;
+  }
+}
+
+std::vector<std::string> ConfigValue::getMemberNames() const {
+  std::vector<std::string> names;
+  for (auto it = begin(); it != end(); ++it) {
+    names.push_back(it.key());
+  }
+  return names;
+}
+
+ConfigValue::Iterator ConfigValue::begin() const { return Iterator(*this, 0); }
+
+ConfigValue::Iterator ConfigValue::end() const {
+  return Iterator(*this, size());
+}
+
+Json::Value ConfigValue::ToJson() const {
+  if (json_) {
+    return *json_;
+  }
+  switch (Type()) {
+    case kBool:
+      return Json::Value(Word(1) != 0);
+    case kInt:
+      return Json::Value(
+          static_cast<Json::Int64>(LoadScalar<int64_t>(base_, offset_)));
+    case kUInt:
+      return Json::Value(
+          static_cast<Json::UInt64>(LoadScalar<uint64_t>(base_, offset_)));
+    case kReal:
+      return Json::Value(LoadScalar<double>(base_, offset_));
+    case kString:
+      return Json::Value(std::string(StringAt(offset_)));
+    case kArray: {
+      Json::Value array(Json::arrayValue);
+      for (auto element : *this) {
+        array.append(element.ToJson());
+      }
+      return array;
+    }
+    case kObject: {
+      Json::Value object(Json::objectValue);
+      for (auto it = begin(); it != end(); ++it) {
+        object[it.key()] = (*it).ToJson();
+      }
+      return object;
+    }
+    default:
+      return Json::Value();
+  }
+}
+
+ConfigValue::Iterator::Iterator(const ConfigValue& parent, uint32_t index)
+    : parent_(parent), index_(index) {
+  if (parent_.json_ && parent_.json_->isObject()) {
+    json_it_ = parent_.json_->begin();
+  }
+}
+
+ConfigValue ConfigValue::Iterator::operator*() const {
+  if (parent_.json_) {
+    return parent_.json_->isObject() ? ConfigValue(&*json_it_)
+                                     : parent_[index_];
+  }
+  if (parent_.Type() == kObject) {
+    return parent_.MemberAt(index_);
+  }
+  return parent_[index_];
+}
+
+std::string ConfigValue::Iterator::key() const {
+  if (parent_.json_) {
+    return parent_.json_->isObject() ? json_it_.name() : "";
+  }
+  if (parent_.Type() != kObject) {
+    return "";
+  }
+  return std::string(parent_.StringAt(parent_.Word(3 + 2 * index_)));
+}
+
+ConfigValue::Iterator& ConfigValue::Iterator::operator++() {
+  index_++;
+  if (parent_.json_ && parent_.json_->isObject()) {
+    ++json_it_;
+  }
+  return *this;
+}
+
+ConfigSnapshot::ConfigSnapshot(ScopedMMap mmap) : mmap_(std::move(mmap)) {}
+
+Result<std::unique_ptr<ConfigSnapshot>> ConfigSnapshot::Open(
+    const std::string& path, const std::string& source_path) {
+  auto fd = SharedFD::Open(path, O_RDONLY);
+  CF_EXPECT(fd->IsOpen(),
+            "Failed to open \"" << path << "\": " << fd->StrError());
+  auto size = FileSize(path);
+  CF_EXPECT(size >= static_cast<off_t>(sizeof(SnapshotHeader)) &&
+                size <= UINT32_MAX,
+            "\"" << path << "\" has an invalid size");
+  auto mmap = fd->MMap(nullptr, size, PROT_READ, MAP_PRIVATE, 0);
+  CF_EXPECT(static_cast<bool>(mmap),
+            "Failed to map \"" << path << "\": " << fd->StrError());
+
+  const char* base = static_cast<const char*>(mmap.get());
+  SnapshotHeader header;
+  memcpy(&header, base, sizeof(header));
+  CF_EXPECT(header.magic == kSnapshotMagic,
+            "\"" << path << "\" is not a config snapshot");
+  CF_EXPECT(header.version == kSnapshotVersion,
+            "Unsupported config snapshot version " << header.version);
+  CF_EXPECT(header.size == size, "\"" << path << "\" is truncated");
+
+  struct stat source_stat;
+  CF_EXPECT(stat(source_path.c_str(), &source_stat) == 0,
+            "Failed to stat \"" << source_path << "\": " << strerror(errno));
+  CF_EXPECT(header.source_size == static_cast<uint64_t>(source_stat.st_size) &&
+                header.source_mtime_ns ==
+                    ModificationTimeNs(source_stat),
+            "\"" << source_path << "\" changed after \"" << path
+                 << "\" was written");
+
+  CF_EXPECT(ValidNode(base, header.size, header.root, 0),
+            "\"" << path << "\" is corrupted");
+  return std::unique_ptr<ConfigSnapshot>(new ConfigSnapshot(std::move(mmap)));
+}
+
+ConfigValue ConfigSnapshot::Root() const {
+  const char* base = static_cast<const char*>(mmap_.get());
+  SnapshotHeader header;
+  memcpy(&header, base, sizeof(header));
+  return ConfigValue(base, header.root);
+}
+
+Result<void> WriteConfigSnapshot(const Json::Value& root,
+                                 const std::string& source_path,
+                                 const std::string& path) {
+  struct stat source_stat;
+  CF_EXPECT(stat(source_path.c_str(), &source_stat) == 0,
+            "Failed to stat \"" << source_path << "\": " << strerror(errno));
+  auto snapshot = CF_EXPECT(SnapshotWriter().Build(
+      root, source_stat.st_size, ModificationTimeNs(source_stat)));
+  // Processes may be mapping the previous snapshot, so it's replaced rather
+  // than overwritten.
+  auto tmp_path = path + ".tmp";
+  CF_EXPECT(android::base::WriteStringToFile(snapshot, tmp_path),
+            "Failed to write \"" << tmp_path << "\"");
+  CF_EXPECT(RenameFile(tmp_path, path));
+  return {};
+}
+
+std::string ConfigSnapshotPath(const std::string& config_path) {
+  std::string_view base = config_path;
+  android::base::ConsumeSuffix(&base, ".json");
+  return std::string(base) + ".snapshot";
+}
+
+}  // namespace cuttlefish
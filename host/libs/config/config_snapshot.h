@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <json/json.h>
+
+#include "common/libs/fs/shared_fd.h"
+#include "common/libs/utils/result.h"
+
+namespace cuttlefish {
+
+/**
+ * Read only view of a config value, backed either by a Json::Value or by a
+ * node in a ConfigSnapshot. Lookups in a snapshot only touch the mapped file
+ * and never allocate.
+ *
+ * The method names and conversions follow Json::Value so config accessors
+ * read the same regardless of the backing: missing members are null, and null
+ * converts to 0, false or an empty string.
+ */
+class ConfigValue {
+ public:
+  class Iterator;
+
+  ConfigValue() = default;
+  explicit ConfigValue(const Json::Value* json) : json_(json) {}
+
+  ConfigValue operator[](std::string_view key) const;
+  ConfigValue operator[](int index) const;
+  bool isMember(std::string_view key) const;
+  bool isNull() const;
+  // Number of elements of an array or members of an object.
+  uint32_t size() const;
+
+  std::string asString() const;
+  int asInt() const;
+  unsigned asUInt() const;
+  int64_t asInt64() const;
+  bool asBool() const;
+  std::vector<std::string> getMemberNames() const;
+
+  // Iterates over the elements of an array or the members of an object.
+  Iterator begin() const;
+  Iterator end() const;
+
+  // Copies the value into a Json::Value, for code that needs to hold on to
+  // the whole subtree.
+  Json::Value ToJson() const;
+
+ private:
+  friend class ConfigSnapshot;
+  ConfigValue(const char* base, uint32_t offset)
+      : base_(base), offset_(offset) {}
+
+  uint32_t Type() const;
+  uint32_t Word(uint32_t index) const;
+  std::string_view StringAt(uint32_t offset) const;
+  ConfigValue MemberAt(uint32_t index) const;
+
+  const Json::Value* json_ = nullptr;
+  const char* base_ = nullptr;
+  uint32_t offset_ = 0;
+};
+
+class ConfigValue::Iterator {
+ public:
+  ConfigValue operator*() const;
+  // The member name when iterating over an object.
+  std::string key() const;
+  Iterator& operator++();
+  bool operator!=(const Iterator& other) const {
+    return index_ != other.index_;
+  }
+
+ private:
+  friend class ConfigValue;
+  Iterator(const ConfigValue& parent, uint32_t index);
+
+  ConfigValue parent_;
+  uint32_t index_;
+  Json::Value::const_iterator json_it_;
+};
+
+/**
+ * A compiled form of the JSON config file that processes can mmap instead of
+ * parsing. The layout stores every node at a fixed offset:
+ *
+ *  - strings are stored once, length prefixed and NUL terminated
+ *  - arrays hold the offsets of their elements
+ *  - objects hold their members in key order followed by an open addressing
+ *    hash table over the keys, so a member lookup is a hash and a probe
+ *
+ * Children are always written before their parents, which lets Open() check
+ * every offset once instead of on each access. The snapshot records the size
+ * and modification time of the JSON file it was compiled from and is rejected
+ * once they no longer match, so editing the JSON by hand is still honored.
+ */
+class ConfigSnapshot {
+ public:
+  static Result<std::unique_ptr<ConfigSnapshot>> Open(
+      const std::string& path, const std::string& source_path);
+
+  ConfigValue Root() const;
+
+ private:
+  ConfigSnapshot(ScopedMMap mmap);
+
+  ScopedMMap mmap_;
+};
+
+// Compiles `root` into a snapshot at `path`. The JSON file at `source_path`
+// must already hold the same contents.
+Result<void> WriteConfigSnapshot(const Json::Value& root,
+                                 const std::string& source_path,
+                                 const std::string& path);
+
+// Where the snapshot of the JSON config at `config_path` lives.
+std::string ConfigSnapshotPath(const std::string& config_path);
+
+}  // namespace cuttlefish
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "host/libs/config/config_snapshot.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+#include <json/json.h>
+
+namespace cuttlefish {
+namespace {
+
+class ConfigSnapshotTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    char dir_template[] = "/tmp/config_snapshot_XXXXXX";
+    ASSERT_NE(mkdtemp(dir_template), nullptr);
+    dir_ = dir_template;
+    json_path_ = dir_ + "/config.json";
+    snapshot_path_ = ConfigSnapshotPath(json_path_);
+
+    config_["root_dir"] = "/home/vsoc-01/cuttlefish";
+    config_["enable_metrics"] = 2;
+    config_["memory_mb"] = Json::UInt64(1) << 40;
+    config_["ratio"] = 0.5;
+    config_["secure"] = true;
+    config_["nothing"] = Json::Value();
+    config_["empty_object"] = Json::Value(Json::objectValue);
+    config_["hals"].append("keymint");
+    config_["hals"].append("gatekeeper");
+    for (int i = 1; i <= 3; i++) {
+      auto& instance = config_["instances"][std::to_string(i)];
+      instance["cpus"] = i * 2;
+      instance["instance_dir"] = "/home/vsoc-01/cuttlefish/cvd-" +
+                                 std::to_string(i);
+      instance["tcp_port_range"].append(15550 + i);
+      instance["tcp_port_range"].append(15560 + i);
+    }
+  }
+
+  void TearDown() override {
+    unlink(snapshot_path_.c_str());
+    unlink(json_path_.c_str());
+    rmdir(dir_.c_str());
+  }
+
+  void Save() {
+    ASSERT_TRUE(
+        android::base::WriteStringToFile(config_.toStyledString(), json_path_));
+    auto written = WriteConfigSnapshot(config_, json_path_, snapshot_path_);
+    ASSERT_TRUE(written.ok()) << written.error().Trace();
+  }
+
+  std::string dir_;
+  std::string json_path_;
+  std::string snapshot_path_;
+  Json::Value config_;
+};
+
+TEST_F(ConfigSnapshotTest, ReadsBackAllValues) {
+  Save();
+  auto snapshot = ConfigSnapshot::Open(snapshot_path_, json_path_);
+  ASSERT_TRUE(snapshot.ok()) << snapshot.error().Trace();
+  auto root = (*snapshot)->Root();
+
+  EXPECT_EQ(root["root_dir"].asString(), "/home/vsoc-01/cuttlefish");
+  EXPECT_EQ(root["enable_metrics"].asInt(), 2);
+  EXPECT_EQ(root["memory_mb"].asInt64(), int64_t{1} << 40);
+  EXPECT_TRUE(root["secure"].asBool());
+  EXPECT_TRUE(root["nothing"].isNull());
+  EXPECT_EQ(root["empty_object"].size(), 0);
+  EXPECT_EQ(root["hals"].size(), 2);
+  EXPECT_EQ(root["hals"][1].asString(), "gatekeeper");
+  EXPECT_EQ(root["instances"]["2"]["cpus"].asInt(), 4);
+  EXPECT_EQ(root["instances"]["3"]["tcp_port_range"][0].asInt(), 15553);
+  EXPECT_EQ(root["instances"].getMemberNames(),
+            (std::vector<std::string>{"1", "2", "3"}));
+  EXPECT_EQ(root.ToJson(), config_);
+}
+
+TEST_F(ConfigSnapshotTest, MatchesJsonBackedValues) {
+  Save();
+  auto snapshot = ConfigSnapshot::Open(snapshot_path_, json_path_);
+  ASSERT_TRUE(snapshot.ok()) << snapshot.error().Trace();
+  auto mapped = (*snapshot)->Root();
+  ConfigValue parsed(&config_);
+
+  for (const auto& key : config_.getMemberNames()) {
+    EXPECT_EQ(mapped[key].ToJson(), parsed[key].ToJson()) << key;
+    EXPECT_EQ(mapped[key].size(), parsed[key].size()) << key;
+  }
+  for (const auto& key : {"root_dir", "enable_metrics", "memory_mb", "ratio",
+                          "secure", "nothing"}) {
+    EXPECT_EQ(mapped[key].asString(), parsed[key].asString()) << key;
+  }
+  for (const auto& key : {"enable_metrics", "memory_mb", "secure"}) {
+    EXPECT_EQ(mapped[key].asInt64(), parsed[key].asInt64()) << key;
+    EXPECT_EQ(mapped[key].asBool(), parsed[key].asBool()) << key;
+  }
+  std::vector<std::string> mapped_hals;
+  for (const auto& hal : mapped["hals"]) {
+    mapped_hals.push_back(hal.asString());
+  }
+  std::vector<std::string> parsed_hals;
+  for (const auto& hal : parsed["hals"]) {
+    parsed_hals.push_back(hal.asString());
+  }
+  EXPECT_EQ(mapped_hals, parsed_hals);
+  EXPECT_EQ(mapped["ratio"].asString(), parsed["ratio"].asString());
+  EXPECT_EQ(mapped["missing"].asInt(), parsed["missing"].asInt());
+  EXPECT_EQ(mapped["hals"][5].isNull(), parsed["hals"][5].isNull());
+  EXPECT_FALSE(mapped.isMember("missing"));
+  EXPECT_FALSE(parsed.isMember("missing"));
+}
+
+TEST_F(ConfigSnapshotTest, FindsEveryMemberOfLargeObjects) {
+  for (int i = 0; i < 1000; i++) {
+    config_["many"]["key_" + std::to_string(i)] = i;
+  }
+  Save();
+  auto snapshot = ConfigSnapshot::Open(snapshot_path_, json_path_);
+  ASSERT_TRUE(snapshot.ok()) << snapshot.error().Trace();
+  auto many = (*snapshot)->Root()["many"];
+
+  ASSERT_EQ(many.size(), 1000);
+  for (int i = 0; i < 1000; i++) {
+    EXPECT_EQ(many["key_" + std::to_string(i)].asInt(), i);
+  }
+  EXPECT_TRUE(many["key_1000"].isNull());
+}
+
+TEST_F(ConfigSnapshotTest, RejectsStaleSnapshot) {
+  Save();
+  config_["root_dir"] = "/somewhere/else/entirely";
+  ASSERT_TRUE(
+      android::base::WriteStringToFile(config_.toStyledString(), json_path_));
+
+  EXPECT_FALSE(ConfigSnapshot::Open(snapshot_path_, json_path_).ok());
+}
+
+TEST_F(ConfigSnapshotTest, RejectsCorruptSnapshot) {
+  Save();
+  std::string contents;
+  ASSERT_TRUE(android::base::ReadFileToString(snapshot_path_, &contents));
+  // Point the root, which follows the magic, version and size words, past the
+  // end of the file.
+  contents.replace(12, 4, contents.substr(8, 4));
+  ASSERT_TRUE(android::base::WriteStringToFile(contents, snapshot_path_));
+
+  EXPECT_FALSE(ConfigSnapshot::Open(snapshot_path_, json_path_).ok());
+}
+
+TEST_F(ConfigSnapshotTest, RejectsObjectWithoutEmptySlot) {
+  config_ = Json::Value(Json::objectValue);
+  config_["only"] = 1;
+  Save();
+  std::string contents;
+  ASSERT_TRUE(android::base::ReadFileToString(snapshot_path_, &contents));
+  // The root object is made of its type, member count and table size words,
+  // one key and value pair, then a table of two slots. Point both slots at
+  // the only member, which would make lookups of other keys probe forever.
+  uint32_t root;
+  memcpy(&root, contents.data() + 12, sizeof(root));
+  uint32_t entry = 1;
+  for (uint32_t slot = 0; slot < 2; slot++) {
+    memcpy(contents.data() + root + (5 + slot) * sizeof(uint32_t), &entry,
+           sizeof(entry));
+  }
+  ASSERT_TRUE(android::base::WriteStringToFile(contents, snapshot_path_));
+
+  EXPECT_FALSE(ConfigSnapshot::Open(snapshot_path_, json_path_).ok());
+}
+
+TEST(ConfigSnapshotPathTest, ReplacesJsonExtension) {
+  EXPECT_EQ(ConfigSnapshotPath("/a/cuttlefish_config.json"),
+            "/a/cuttlefish_config.snapshot");
+  EXPECT_EQ(ConfigSnapshotPath("/a/config"), "/a/config.snapshot");
+}
+
+}  // namespace
+}  // namespace cuttlefish
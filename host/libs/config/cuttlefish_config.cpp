@@ -28,12 +28,14 @@
 #include <string>
 #include <time.h>
 
+#include <android-base/file.h>
 #include <android-base/strings.h>
 #include <android-base/logging.h>
 #include <json/json.h>
 
 #include "common/libs/utils/environment.h"
 #include "common/libs/utils/files.h"
+#include "host/libs/config/config_snapshot.h"
 #include "host/libs/vm_manager/crosvm_manager.h"
 #include "host/libs/vm_manager/gem5_manager.h"
 #include "host/libs/vm_manager/qemu_manager.h"
@@ -106,16 +108,16 @@ ConfigFragment::~ConfigFragment() = default;
 
 static constexpr char kFragments[] = "fragments";
 bool CuttlefishConfig::LoadFragment(ConfigFragment& fragment) const {
-  if (!dictionary_->isMember(kFragments)) {
+  if (!Dictionary().isMember(kFragments)) {
     LOG(ERROR) << "Fragments member was missing";
     return false;
   }
-  const Json::Value& json_fragments = (*dictionary_)[kFragments];
+  auto json_fragments = Dictionary()[kFragments];
   if (!json_fragments.isMember(fragment.Name())) {
     LOG(ERROR) << "Could not find a fragment called " << fragment.Name();
     return false;
   }
-  return fragment.Deserialize(json_fragments[fragment.Name()]);
+  return fragment.Deserialize(json_fragments[fragment.Name()].ToJson());
 }
 bool CuttlefishConfig::SaveFragment(const ConfigFragment& fragment) {
   Json::Value& json_fragments = (*dictionary_)[kFragments];
@@ -129,7 +131,7 @@ bool CuttlefishConfig::SaveFragment(const ConfigFragment& fragment) {
 
 static constexpr char kRootDir[] = "root_dir";
 std::string CuttlefishConfig::root_dir() const {
-  return (*dictionary_)[kRootDir].asString();
+  return Dictionary()[kRootDir].asString();
 }
 void CuttlefishConfig::set_root_dir(const std::string& root_dir) {
   (*dictionary_)[kRootDir] = root_dir;
@@ -137,7 +139,7 @@ void CuttlefishConfig::set_root_dir(const std::string& root_dir) {
 
 static constexpr char kVmManager[] = "vm_manager";
 std::string CuttlefishConfig::vm_manager() const {
-  return (*dictionary_)[kVmManager].asString();
+  return Dictionary()[kVmManager].asString();
 }
 void CuttlefishConfig::set_vm_manager(const std::string& name) {
   (*dictionary_)[kVmManager] = name;
@@ -159,7 +161,7 @@ static SecureHal StringToSecureHal(std::string mode) {
 static constexpr char kSecureHals[] = "secure_hals";
 std::set<SecureHal> CuttlefishConfig::secure_hals() const {
   std::set<SecureHal> args_set;
-  for (auto& hal : (*dictionary_)[kSecureHals]) {
+  for (const auto& hal : Dictionary()[kSecureHals]) {
     args_set.insert(StringToSecureHal(hal.asString()));
   }
   return args_set;
@@ -174,7 +176,7 @@ void CuttlefishConfig::set_secure_hals(const std::set<std::string>& hals) {
 
 static constexpr char kCrosvmBinary[] = "crosvm_binary";
 std::string CuttlefishConfig::crosvm_binary() const {
-  return (*dictionary_)[kCrosvmBinary].asString();
+  return Dictionary()[kCrosvmBinary].asString();
 }
 void CuttlefishConfig::set_crosvm_binary(const std::string& crosvm_binary) {
   (*dictionary_)[kCrosvmBinary] = crosvm_binary;
@@ -182,7 +184,7 @@ void CuttlefishConfig::set_crosvm_binary(const std::string& crosvm_binary) {
 
 static constexpr char kGem5DebugFlags[] = "gem5_debug_flags";
 std::string CuttlefishConfig::gem5_debug_flags() const {
-  return (*dictionary_)[kGem5DebugFlags].asString();
+  return Dictionary()[kGem5DebugFlags].asString();
 }
 void CuttlefishConfig::set_gem5_debug_flags(const std::string& gem5_debug_flags) {
   (*dictionary_)[kGem5DebugFlags] = gem5_debug_flags;
@@ -193,7 +195,7 @@ void CuttlefishConfig::set_webrtc_certs_dir(const std::string& certs_dir) {
   (*dictionary_)[kWebRTCCertsDir] = certs_dir;
 }
 std::string CuttlefishConfig::webrtc_certs_dir() const {
-  return (*dictionary_)[kWebRTCCertsDir].asString();
+  return Dictionary()[kWebRTCCertsDir].asString();
 }
 
 static constexpr char kSigServerPort[] = "webrtc_sig_server_port";
@@ -201,7 +203,7 @@ void CuttlefishConfig::set_sig_server_port(int port) {
   (*dictionary_)[kSigServerPort] = port;
 }
 int CuttlefishConfig::sig_server_port() const {
-  return (*dictionary_)[kSigServerPort].asInt();
+  return Dictionary()[kSigServerPort].asInt();
 }
 
 static constexpr char kSigServerAddress[] = "webrtc_sig_server_addr";
@@ -209,7 +211,7 @@ void CuttlefishConfig::set_sig_server_address(const std::string& addr) {
   (*dictionary_)[kSigServerAddress] = addr;
 }
 std::string CuttlefishConfig::sig_server_address() const {
-  return (*dictionary_)[kSigServerAddress].asString();
+  return Dictionary()[kSigServerAddress].asString();
 }
 
 static constexpr char kSigServerPath[] = "webrtc_sig_server_path";
@@ -218,7 +220,7 @@ void CuttlefishConfig::set_sig_server_path(const std::string& path) {
   (*dictionary_)[kSigServerPath] = path;
 }
 std::string CuttlefishConfig::sig_server_path() const {
-  return (*dictionary_)[kSigServerPath].asString();
+  return Dictionary()[kSigServerPath].asString();
 }
 
 static constexpr char kSigServerSecure[] = "webrtc_sig_server_secure";
@@ -226,7 +228,7 @@ void CuttlefishConfig::set_sig_server_secure(bool secure) {
   (*dictionary_)[kSigServerSecure] = secure;
 }
 bool CuttlefishConfig::sig_server_secure() const {
-  return (*dictionary_)[kSigServerSecure].asBool();
+  return Dictionary()[kSigServerSecure].asBool();
 }
 
 static constexpr char kSigServerStrict[] = "webrtc_sig_server_strict";
@@ -234,7 +236,7 @@ void CuttlefishConfig::set_sig_server_strict(bool strict) {
   (*dictionary_)[kSigServerStrict] = strict;
 }
 bool CuttlefishConfig::sig_server_strict() const {
-  return (*dictionary_)[kSigServerStrict].asBool();
+  return Dictionary()[kSigServerStrict].asBool();
 }
 
 static constexpr char kHostToolsVersion[] = "host_tools_version";
@@ -247,13 +249,13 @@ void CuttlefishConfig::set_host_tools_version(
   (*dictionary_)[kHostToolsVersion] = json;
 }
 std::map<std::string, uint32_t> CuttlefishConfig::host_tools_version() const {
-  if (!dictionary_->isMember(kHostToolsVersion)) {
+  if (!Dictionary().isMember(kHostToolsVersion)) {
     return {};
   }
   std::map<std::string, uint32_t> versions;
-  const auto& elem = (*dictionary_)[kHostToolsVersion];
-  for (auto it = elem.begin(); it != elem.end(); it++) {
-    versions[it.key().asString()] = it->asUInt();
+  auto elem = Dictionary()[kHostToolsVersion];
+  for (auto it = elem.begin(); it != elem.end(); ++it) {
+    versions[it.key()] = (*it).asUInt();
   }
   return versions;
 }
@@ -263,7 +265,7 @@ void CuttlefishConfig::set_enable_host_uwb(bool enable_host_uwb) {
   (*dictionary_)[kenableHostUwb] = enable_host_uwb;
 }
 bool CuttlefishConfig::enable_host_uwb() const {
-  return (*dictionary_)[kenableHostUwb].asBool();
+  return Dictionary()[kenableHostUwb].asBool();
 }
 
 static constexpr char kenableHostUwbConnector[] = "enable_host_uwb_connector";
@@ -271,12 +273,12 @@ void CuttlefishConfig::set_enable_host_uwb_connector(bool enable_host_uwb) {
   (*dictionary_)[kenableHostUwbConnector] = enable_host_uwb;
 }
 bool CuttlefishConfig::enable_host_uwb_connector() const {
-  return (*dictionary_)[kenableHostUwbConnector].asBool();
+  return Dictionary()[kenableHostUwbConnector].asBool();
 }
 
 static constexpr char kPicaUciPort[] = "pica_uci_port";
 int CuttlefishConfig::pica_uci_port() const {
-  return (*dictionary_)[kPicaUciPort].asInt();
+  return Dictionary()[kPicaUciPort].asInt();
 }
 void CuttlefishConfig::set_pica_uci_port(int pica_uci_port) {
   (*dictionary_)[kPicaUciPort] = pica_uci_port;
@@ -287,7 +289,7 @@ void CuttlefishConfig::set_enable_host_bluetooth(bool enable_host_bluetooth) {
   (*dictionary_)[kenableHostBluetooth] = enable_host_bluetooth;
 }
 bool CuttlefishConfig::enable_host_bluetooth() const {
-  return (*dictionary_)[kenableHostBluetooth].asBool();
+  return Dictionary()[kenableHostBluetooth].asBool();
 }
 
 static constexpr char kenableHostBluetoothConnector[] = "enable_host_bluetooth_connector";
@@ -295,7 +297,7 @@ void CuttlefishConfig::set_enable_host_bluetooth_connector(bool enable_host_blue
   (*dictionary_)[kenableHostBluetoothConnector] = enable_host_bluetooth;
 }
 bool CuttlefishConfig::enable_host_bluetooth_connector() const {
-  return (*dictionary_)[kenableHostBluetoothConnector].asBool();
+  return Dictionary()[kenableHostBluetoothConnector].asBool();
 }
 
 static constexpr char kNetsimRadios[] = "netsim_radios";
@@ -310,7 +312,7 @@ void CuttlefishConfig::netsim_radio_enable(NetsimRadio flag) {
 }
 
 bool CuttlefishConfig::netsim_radio_enabled(NetsimRadio flag) const {
-  return (*dictionary_)[kNetsimRadios].asInt() & flag;
+  return Dictionary()[kNetsimRadios].asInt() & flag;
 }
 
 static constexpr char kEnableMetrics[] = "enable_metrics";
@@ -330,7 +332,7 @@ void CuttlefishConfig::set_enable_metrics(std::string enable_metrics) {
   }
 }
 CuttlefishConfig::Answer CuttlefishConfig::enable_metrics() const {
-  return (CuttlefishConfig::Answer)(*dictionary_)[kEnableMetrics].asInt();
+  return (CuttlefishConfig::Answer)Dictionary()[kEnableMetrics].asInt();
 }
 
 static constexpr char kMetricsBinary[] = "metrics_binary";
@@ -338,7 +340,7 @@ void CuttlefishConfig::set_metrics_binary(const std::string& metrics_binary) {
   (*dictionary_)[kMetricsBinary] = metrics_binary;
 }
 std::string CuttlefishConfig::metrics_binary() const {
-  return (*dictionary_)[kMetricsBinary].asString();
+  return Dictionary()[kMetricsBinary].asString();
 }
 
 static constexpr char kExtraKernelCmdline[] = "extra_kernel_cmdline";
@@ -352,7 +354,7 @@ void CuttlefishConfig::set_extra_kernel_cmdline(
 }
 std::vector<std::string> CuttlefishConfig::extra_kernel_cmdline() const {
   std::vector<std::string> cmdline;
-  for (const Json::Value& arg : (*dictionary_)[kExtraKernelCmdline]) {
+  for (const auto& arg : Dictionary()[kExtraKernelCmdline]) {
     cmdline.push_back(arg.asString());
   }
   return cmdline;
@@ -369,7 +371,7 @@ void CuttlefishConfig::set_extra_bootconfig_args(
 }
 std::vector<std::string> CuttlefishConfig::extra_bootconfig_args() const {
   std::vector<std::string> bootconfig;
-  for (const Json::Value& arg : (*dictionary_)[kExtraBootconfigArgs]) {
+  for (const auto& arg : Dictionary()[kExtraBootconfigArgs]) {
     bootconfig.push_back(arg.asString());
   }
   return bootconfig;
@@ -380,7 +382,7 @@ void CuttlefishConfig::set_virtio_mac80211_hwsim(bool virtio_mac80211_hwsim) {
   (*dictionary_)[kVirtioMac80211Hwsim] = virtio_mac80211_hwsim;
 }
 bool CuttlefishConfig::virtio_mac80211_hwsim() const {
-  return (*dictionary_)[kVirtioMac80211Hwsim].asBool();
+  return Dictionary()[kVirtioMac80211Hwsim].asBool();
 }
 
 static constexpr char kVhostUserMac80211Hwsim[] = "vhost_user_mac80211_hwsim";
@@ -388,7 +390,7 @@ void CuttlefishConfig::set_vhost_user_mac80211_hwsim(const std::string& path) {
   (*dictionary_)[kVhostUserMac80211Hwsim] = path;
 }
 std::string CuttlefishConfig::vhost_user_mac80211_hwsim() const {
-  return (*dictionary_)[kVhostUserMac80211Hwsim].asString();
+  return Dictionary()[kVhostUserMac80211Hwsim].asString();
 }
 
 static constexpr char kWmediumdApiServerSocket[] = "wmediumd_api_server_socket";
@@ -396,12 +398,12 @@ void CuttlefishConfig::set_wmediumd_api_server_socket(const std::string& path) {
   (*dictionary_)[kWmediumdApiServerSocket] = path;
 }
 std::string CuttlefishConfig::wmediumd_api_server_socket() const {
-  return (*dictionary_)[kWmediumdApiServerSocket].asString();
+  return Dictionary()[kWmediumdApiServerSocket].asString();
 }
 
 static constexpr char kApRootfsImage[] = "ap_rootfs_image";
 std::string CuttlefishConfig::ap_rootfs_image() const {
-  return (*dictionary_)[kApRootfsImage].asString();
+  return Dictionary()[kApRootfsImage].asString();
 }
 void CuttlefishConfig::set_ap_rootfs_image(const std::string& ap_rootfs_image) {
   (*dictionary_)[kApRootfsImage] = ap_rootfs_image;
@@ -409,7 +411,7 @@ void CuttlefishConfig::set_ap_rootfs_image(const std::string& ap_rootfs_image) {
 
 static constexpr char kApKernelImage[] = "ap_kernel_image";
 std::string CuttlefishConfig::ap_kernel_image() const {
-  return (*dictionary_)[kApKernelImage].asString();
+  return Dictionary()[kApKernelImage].asString();
 }
 void CuttlefishConfig::set_ap_kernel_image(const std::string& ap_kernel_image) {
   (*dictionary_)[kApKernelImage] = ap_kernel_image;
@@ -420,7 +422,7 @@ void CuttlefishConfig::set_wmediumd_config(const std::string& config) {
   (*dictionary_)[kWmediumdConfig] = config;
 }
 std::string CuttlefishConfig::wmediumd_config() const {
-  return (*dictionary_)[kWmediumdConfig].asString();
+  return Dictionary()[kWmediumdConfig].asString();
 }
 
 static constexpr char kRootcanalArgs[] = "rootcanal_args";
@@ -433,7 +435,7 @@ void CuttlefishConfig::set_rootcanal_args(const std::string& rootcanal_args) {
 }
 std::vector<std::string> CuttlefishConfig::rootcanal_args() const {
   std::vector<std::string> rootcanal_args;
-  for (const Json::Value& arg : (*dictionary_)[kRootcanalArgs]) {
+  for (const auto& arg : Dictionary()[kRootcanalArgs]) {
     rootcanal_args.push_back(arg.asString());
   }
   return rootcanal_args;
@@ -441,7 +443,7 @@ std::vector<std::string> CuttlefishConfig::rootcanal_args() const {
 
 static constexpr char kRootcanalHciPort[] = "rootcanal_hci_port";
 int CuttlefishConfig::rootcanal_hci_port() const {
-  return (*dictionary_)[kRootcanalHciPort].asInt();
+  return Dictionary()[kRootcanalHciPort].asInt();
 }
 void CuttlefishConfig::set_rootcanal_hci_port(int rootcanal_hci_port) {
   (*dictionary_)[kRootcanalHciPort] = rootcanal_hci_port;
@@ -449,7 +451,7 @@ void CuttlefishConfig::set_rootcanal_hci_port(int rootcanal_hci_port) {
 
 static constexpr char kRootcanalLinkPort[] = "rootcanal_link_port";
 int CuttlefishConfig::rootcanal_link_port() const {
-  return (*dictionary_)[kRootcanalLinkPort].asInt();
+  return Dictionary()[kRootcanalLinkPort].asInt();
 }
 void CuttlefishConfig::set_rootcanal_link_port(int rootcanal_link_port) {
   (*dictionary_)[kRootcanalLinkPort] = rootcanal_link_port;
@@ -457,7 +459,7 @@ void CuttlefishConfig::set_rootcanal_link_port(int rootcanal_link_port) {
 
 static constexpr char kRootcanalLinkBlePort[] = "rootcanal_link_ble_port";
 int CuttlefishConfig::rootcanal_link_ble_port() const {
-  return (*dictionary_)[kRootcanalLinkBlePort].asInt();
+  return Dictionary()[kRootcanalLinkBlePort].asInt();
 }
 void CuttlefishConfig::set_rootcanal_link_ble_port(
     int rootcanal_link_ble_port) {
@@ -466,7 +468,7 @@ void CuttlefishConfig::set_rootcanal_link_ble_port(
 
 static constexpr char kRootcanalTestPort[] = "rootcanal_test_port";
 int CuttlefishConfig::rootcanal_test_port() const {
-  return (*dictionary_)[kRootcanalTestPort].asInt();
+  return Dictionary()[kRootcanalTestPort].asInt();
 }
 void CuttlefishConfig::set_rootcanal_test_port(int rootcanal_test_port) {
   (*dictionary_)[kRootcanalTestPort] = rootcanal_test_port;
@@ -474,7 +476,7 @@ void CuttlefishConfig::set_rootcanal_test_port(int rootcanal_test_port) {
 
 static constexpr char kRootcanalConfigFile[] = "rootcanal_config_file";
 std::string CuttlefishConfig::rootcanal_config_file() const {
-  return (*dictionary_)[kRootcanalConfigFile].asString();
+  return Dictionary()[kRootcanalConfigFile].asString();
 }
 void CuttlefishConfig::set_rootcanal_config_file(
     const std::string& rootcanal_config_file) {
@@ -485,7 +487,7 @@ void CuttlefishConfig::set_rootcanal_config_file(
 static constexpr char kRootcanalDefaultCommandsFile[] =
     "rootcanal_default_commands_file";
 std::string CuttlefishConfig::rootcanal_default_commands_file() const {
-  return (*dictionary_)[kRootcanalDefaultCommandsFile].asString();
+  return Dictionary()[kRootcanalDefaultCommandsFile].asString();
 }
 void CuttlefishConfig::set_rootcanal_default_commands_file(
     const std::string& rootcanal_default_commands_file) {
@@ -543,6 +545,19 @@ bool CuttlefishConfig::LoadFromFile(const char* file) {
     LOG(ERROR) << "Could not get real path for file " << file;
     return false;
   }
+  // Processes only reading the config map its snapshot rather than parsing
+  // the JSON, as long as the snapshot is up to date.
+  std::string resolved_path;
+  if (android::base::Realpath(real_file_path, &resolved_path)) {
+    auto snapshot = ConfigSnapshot::Open(ConfigSnapshotPath(resolved_path),
+                                         resolved_path);
+    if (snapshot.ok()) {
+      snapshot_ = std::move(*snapshot);
+      return true;
+    }
+    LOG(DEBUG) << "Not using the config snapshot: "
+               << snapshot.error().Message();
+  }
   Json::CharReaderBuilder builder;
   std::ifstream ifs(real_file_path);
   std::string errorMessage;
@@ -558,9 +573,18 @@ bool CuttlefishConfig::SaveToFile(const std::string& file) const {
     LOG(ERROR) << "Unable to write to file " << file;
     return false;
   }
-  ofs << *dictionary_;
+  ofs << Dictionary().ToJson();
   return !ofs.fail();
 }
+Result<void> CuttlefishConfig::SaveSnapshot(const std::string& file) const {
+  CF_EXPECT(WriteConfigSnapshot(Dictionary().ToJson(), file,
+                                ConfigSnapshotPath(file)));
+  return {};
+}
+
+ConfigValue CuttlefishConfig::Dictionary() const {
+  return snapshot_ ? snapshot_->Root() : ConfigValue(dictionary_.get());
+}
 
 std::string CuttlefishConfig::instances_dir() const {
   return AbsolutePath(root_dir() + "/instances");
@@ -617,7 +641,7 @@ CuttlefishConfig::InstanceSpecific CuttlefishConfig::ForDefaultInstance() const
 }
 
 std::vector<CuttlefishConfig::InstanceSpecific> CuttlefishConfig::Instances() const {
-  const auto& json = (*dictionary_)[kInstances];
+  auto json = Dictionary()[kInstances];
   std::vector<CuttlefishConfig::InstanceSpecific> instances;
   for (const auto& name : json.getMemberNames()) {
     instances.push_back(CuttlefishConfig::InstanceSpecific(this, name));
@@ -653,7 +677,7 @@ std::vector<std::string> CuttlefishConfig::instance_names() const {
   // Any non-stable changes must be accompanied by an uprev to the
   // cvd_server major version.
   std::vector<std::string> names;
-  for (const Json::Value& name : (*dictionary_)[kInstanceNames]) {
+  for (const auto& name : Dictionary()[kInstanceNames]) {
     names.push_back(name.asString());
   }
   return names;
@@ -34,6 +34,10 @@ class Value;
 }
 
 namespace cuttlefish {
+
+class ConfigSnapshot;
+class ConfigValue;
+
 constexpr char kLogcatSerialMode[] = "serial";
 constexpr char kLogcatVsockMode[] = "vsock";
 
@@ -90,6 +94,9 @@ class CuttlefishConfig {
   // Saves the configuration object in a file, it can then be read in other
   // processes by passing the --config_file option.
   bool SaveToFile(const std::string& file) const;
+  // Saves a compiled copy of the configuration next to `file`, which must have
+  // been written by SaveToFile. Readers map it instead of parsing the JSON.
+  Result<void> SaveSnapshot(const std::string& file) const;
 
   bool SaveFragment(const ConfigFragment&);
   bool LoadFragment(ConfigFragment&) const;
@@ -269,7 +276,7 @@ class CuttlefishConfig {
         : config_(config), id_(id) {}
 
     Json::Value* Dictionary();
-    const Json::Value* Dictionary() const;
+    ConfigValue Dictionary() const;
   public:
     std::string serial_number() const;
     // If any of the following port numbers is 0, the relevant service is not
@@ -371,9 +378,18 @@ class CuttlefishConfig {
     std::string logcat_pipe_name() const;
 
     std::string launcher_log_path() const;
+    // Everything in the launcher log that came from subprocess output, in
+    // the log_collector's indexed binary format.
+    std::string launcher_binary_log_path() const;
 
     std::string launcher_monitor_socket_path() const;
 
+    std::string log_collector_socket_path() const;
+
+    // Latency histograms of touches on the displays, kept up to date by the
+    // webrtc streamer.
+    std::string webrtc_input_latency_path() const;
+
     std::string sdcard_path() const;
 
     std::string persistent_composite_disk_path() const;
@@ -760,6 +776,10 @@ class CuttlefishConfig {
 
  private:
   std::unique_ptr<Json::Value> dictionary_;
+  // Set instead of dictionary_ when loaded from an up to date snapshot.
+  std::unique_ptr<ConfigSnapshot> snapshot_;
+
+  ConfigValue Dictionary() const;
 
   bool LoadFromFile(const char* file);
   static CuttlefishConfig* BuildConfigImpl(const std::string& path);
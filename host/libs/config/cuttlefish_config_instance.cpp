@@ -21,6 +21,7 @@
 
 #include "common/libs/utils/files.h"
 #include "common/libs/utils/flags_validator.h"
+#include "host/libs/config/config_snapshot.h"
 #include "host/libs/vm_manager/crosvm_manager.h"
 #include "host/libs/vm_manager/gem5_manager.h"
 
@@ -47,8 +48,8 @@ Json::Value* CuttlefishConfig::MutableInstanceSpecific::Dictionary() {
   return &(*config_->dictionary_)[kInstances][id_];
 }
 
-const Json::Value* CuttlefishConfig::InstanceSpecific::Dictionary() const {
-  return &(*config_->dictionary_)[kInstances][id_];
+ConfigValue CuttlefishConfig::InstanceSpecific::Dictionary() const {
+  return config_->Dictionary()[kInstances][id_];
 }
 
 std::string CuttlefishConfig::InstanceSpecific::instance_dir() const {
@@ -79,7 +80,7 @@ bool CuttlefishConfig::InstanceSpecific::use_bootloader() const {
 // vectorized and moved system image files into instance specific
 static constexpr char kBootImage[] = "boot_image";
 std::string CuttlefishConfig::InstanceSpecific::boot_image() const {
-  return (*Dictionary())[kBootImage].asString();
+  return Dictionary()[kBootImage].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_boot_image(
     const std::string& boot_image) {
@@ -87,7 +88,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_boot_image(
 }
 static constexpr char kNewBootImage[] = "new_boot_image";
 std::string CuttlefishConfig::InstanceSpecific::new_boot_image() const {
-  return (*Dictionary())[kNewBootImage].asString();
+  return Dictionary()[kNewBootImage].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_new_boot_image(
     const std::string& new_boot_image) {
@@ -95,7 +96,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_new_boot_image(
 }
 static constexpr char kInitBootImage[] = "init_boot_image";
 std::string CuttlefishConfig::InstanceSpecific::init_boot_image() const {
-  return (*Dictionary())[kInitBootImage].asString();
+  return Dictionary()[kInitBootImage].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_init_boot_image(
     const std::string& init_boot_image) {
@@ -103,7 +104,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_init_boot_image(
 }
 static constexpr char kDataImage[] = "data_image";
 std::string CuttlefishConfig::InstanceSpecific::data_image() const {
-  return (*Dictionary())[kDataImage].asString();
+  return Dictionary()[kDataImage].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_data_image(
     const std::string& data_image) {
@@ -111,7 +112,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_data_image(
 }
 static constexpr char kSuperImage[] = "super_image";
 std::string CuttlefishConfig::InstanceSpecific::super_image() const {
-  return (*Dictionary())[kSuperImage].asString();
+  return Dictionary()[kSuperImage].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_super_image(
     const std::string& super_image) {
@@ -119,7 +120,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_super_image(
 }
 static constexpr char kNewSuperImage[] = "new_super_image";
 std::string CuttlefishConfig::InstanceSpecific::new_super_image() const {
-  return (*Dictionary())[kNewSuperImage].asString();
+  return Dictionary()[kNewSuperImage].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_new_super_image(
     const std::string& super_image) {
@@ -127,7 +128,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_new_super_image(
 }
 static constexpr char kMiscImage[] = "misc_image";
 std::string CuttlefishConfig::InstanceSpecific::misc_image() const {
-  return (*Dictionary())[kMiscImage].asString();
+  return Dictionary()[kMiscImage].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_misc_image(
     const std::string& misc_image) {
@@ -135,11 +136,11 @@ void CuttlefishConfig::MutableInstanceSpecific::set_misc_image(
 }
 static constexpr char kNewMiscImage[] = "new_misc_image";
 std::string CuttlefishConfig::InstanceSpecific::new_misc_image() const {
-  return (*Dictionary())[kNewMiscImage].asString();
+  return Dictionary()[kNewMiscImage].asString();
 }
 static constexpr char kMiscInfoTxt[] = "misc_info_txt";
 std::string CuttlefishConfig::InstanceSpecific::misc_info_txt() const {
-  return (*Dictionary())[kMiscInfoTxt].asString();
+  return Dictionary()[kMiscInfoTxt].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_misc_info_txt(
     const std::string& misc_info) {
@@ -151,7 +152,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_new_misc_image(
 }
 static constexpr char kMetadataImage[] = "metadata_image";
 std::string CuttlefishConfig::InstanceSpecific::metadata_image() const {
-  return (*Dictionary())[kMetadataImage].asString();
+  return Dictionary()[kMetadataImage].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_metadata_image(
     const std::string& metadata_image) {
@@ -159,7 +160,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_metadata_image(
 }
 static constexpr char kNewMetadataImage[] = "new_metadata_image";
 std::string CuttlefishConfig::InstanceSpecific::new_metadata_image() const {
-  return (*Dictionary())[kNewMetadataImage].asString();
+  return Dictionary()[kNewMetadataImage].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_new_metadata_image(
     const std::string& new_metadata_image) {
@@ -167,7 +168,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_new_metadata_image(
 }
 static constexpr char kVendorBootImage[] = "vendor_boot_image";
 std::string CuttlefishConfig::InstanceSpecific::vendor_boot_image() const {
-  return (*Dictionary())[kVendorBootImage].asString();
+  return Dictionary()[kVendorBootImage].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_vendor_boot_image(
     const std::string& vendor_boot_image) {
@@ -175,7 +176,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_vendor_boot_image(
 }
 static constexpr char kNewVendorBootImage[] = "new_vendor_boot_image";
 std::string CuttlefishConfig::InstanceSpecific::new_vendor_boot_image() const {
-  return (*Dictionary())[kNewVendorBootImage].asString();
+  return Dictionary()[kNewVendorBootImage].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_new_vendor_boot_image(
     const std::string& new_vendor_boot_image) {
@@ -183,7 +184,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_new_vendor_boot_image(
 }
 static constexpr char kVbmetaImage[] = "vbmeta_image";
 std::string CuttlefishConfig::InstanceSpecific::vbmeta_image() const {
-  return (*Dictionary())[kVbmetaImage].asString();
+  return Dictionary()[kVbmetaImage].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_vbmeta_image(
     const std::string& vbmeta_image) {
@@ -191,7 +192,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_vbmeta_image(
 }
 static constexpr char kVbmetaSystemImage[] = "vbmeta_system_image";
 std::string CuttlefishConfig::InstanceSpecific::vbmeta_system_image() const {
-  return (*Dictionary())[kVbmetaSystemImage].asString();
+  return Dictionary()[kVbmetaSystemImage].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_vbmeta_system_image(
     const std::string& vbmeta_system_image) {
@@ -200,7 +201,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_vbmeta_system_image(
 static constexpr char kVbmetaVendorDlkmImage[] = "vbmeta_vendor_dlkm_image";
 std::string CuttlefishConfig::InstanceSpecific::vbmeta_vendor_dlkm_image()
     const {
-  return (*Dictionary())[kVbmetaVendorDlkmImage].asString();
+  return Dictionary()[kVbmetaVendorDlkmImage].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_vbmeta_vendor_dlkm_image(
     const std::string& image) {
@@ -210,7 +211,7 @@ static constexpr char kNewVbmetaVendorDlkmImage[] =
     "new_vbmeta_vendor_dlkm_image";
 std::string CuttlefishConfig::InstanceSpecific::new_vbmeta_vendor_dlkm_image()
     const {
-  return (*Dictionary())[kNewVbmetaVendorDlkmImage].asString();
+  return Dictionary()[kNewVbmetaVendorDlkmImage].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::
     set_new_vbmeta_vendor_dlkm_image(const std::string& image) {
@@ -218,7 +219,7 @@ void CuttlefishConfig::MutableInstanceSpecific::
 }
 static constexpr char kOtherosEspImage[] = "otheros_esp_image";
 std::string CuttlefishConfig::InstanceSpecific::otheros_esp_image() const {
-  return (*Dictionary())[kOtherosEspImage].asString();
+  return Dictionary()[kOtherosEspImage].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_otheros_esp_image(
     const std::string& otheros_esp_image) {
@@ -226,7 +227,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_otheros_esp_image(
 }
 static constexpr char kLinuxKernelPath[] = "linux_kernel_path";
 std::string CuttlefishConfig::InstanceSpecific::linux_kernel_path() const {
-  return (*Dictionary())[kLinuxKernelPath].asString();
+  return Dictionary()[kLinuxKernelPath].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_linux_kernel_path(
     const std::string& linux_kernel_path) {
@@ -234,7 +235,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_linux_kernel_path(
 }
 static constexpr char kLinuxInitramfsPath[] = "linux_initramfs_path";
 std::string CuttlefishConfig::InstanceSpecific::linux_initramfs_path() const {
-  return (*Dictionary())[kLinuxInitramfsPath].asString();
+  return Dictionary()[kLinuxInitramfsPath].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_linux_initramfs_path(
     const std::string& linux_initramfs_path) {
@@ -242,7 +243,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_linux_initramfs_path(
 }
 static constexpr char kLinuxRootImage[] = "linux_root_image";
 std::string CuttlefishConfig::InstanceSpecific::linux_root_image() const {
-  return (*Dictionary())[kLinuxRootImage].asString();
+  return Dictionary()[kLinuxRootImage].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_linux_root_image(
     const std::string& linux_root_image) {
@@ -254,7 +255,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_fuchsia_zedboot_path(
   (*Dictionary())[kFuchsiaZedbootPath] = fuchsia_zedboot_path;
 }
 std::string CuttlefishConfig::InstanceSpecific::fuchsia_zedboot_path() const {
-  return (*Dictionary())[kFuchsiaZedbootPath].asString();
+  return Dictionary()[kFuchsiaZedbootPath].asString();
 }
 static constexpr char kFuchsiaMultibootBinPath[] = "multiboot_bin_path";
 void CuttlefishConfig::MutableInstanceSpecific::set_fuchsia_multiboot_bin_path(
@@ -262,7 +263,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_fuchsia_multiboot_bin_path(
   (*Dictionary())[kFuchsiaMultibootBinPath] = fuchsia_multiboot_bin_path;
 }
 std::string CuttlefishConfig::InstanceSpecific::fuchsia_multiboot_bin_path() const {
-  return (*Dictionary())[kFuchsiaMultibootBinPath].asString();
+  return Dictionary()[kFuchsiaMultibootBinPath].asString();
 }
 static constexpr char kFuchsiaRootImage[] = "fuchsia_root_image";
 void CuttlefishConfig::MutableInstanceSpecific::set_fuchsia_root_image(
@@ -270,7 +271,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_fuchsia_root_image(
   (*Dictionary())[kFuchsiaRootImage] = fuchsia_root_image;
 }
 std::string CuttlefishConfig::InstanceSpecific::fuchsia_root_image() const {
-  return (*Dictionary())[kFuchsiaRootImage].asString();
+  return Dictionary()[kFuchsiaRootImage].asString();
 }
 static constexpr char kCustomPartitionPath[] = "custom_partition_path";
 void CuttlefishConfig::MutableInstanceSpecific::set_custom_partition_path(
@@ -278,11 +279,11 @@ void CuttlefishConfig::MutableInstanceSpecific::set_custom_partition_path(
   (*Dictionary())[kCustomPartitionPath] = custom_partition_path;
 }
 std::string CuttlefishConfig::InstanceSpecific::custom_partition_path() const {
-  return (*Dictionary())[kCustomPartitionPath].asString();
+  return Dictionary()[kCustomPartitionPath].asString();
 }
 static constexpr char kBlankMetadataImageMb[] = "blank_metadata_image_mb";
 int CuttlefishConfig::InstanceSpecific::blank_metadata_image_mb() const {
-  return (*Dictionary())[kBlankMetadataImageMb].asInt();
+  return Dictionary()[kBlankMetadataImageMb].asInt();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_blank_metadata_image_mb(
     int blank_metadata_image_mb) {
@@ -290,7 +291,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_blank_metadata_image_mb(
 }
 static constexpr char kBlankSdcardImageMb[] = "blank_sdcard_image_mb";
 int CuttlefishConfig::InstanceSpecific::blank_sdcard_image_mb() const {
-  return (*Dictionary())[kBlankSdcardImageMb].asInt();
+  return Dictionary()[kBlankSdcardImageMb].asInt();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_blank_sdcard_image_mb(
     int blank_sdcard_image_mb) {
@@ -298,7 +299,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_blank_sdcard_image_mb(
 }
 static constexpr char kBootloader[] = "bootloader";
 std::string CuttlefishConfig::InstanceSpecific::bootloader() const {
-  return (*Dictionary())[kBootloader].asString();
+  return Dictionary()[kBootloader].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_bootloader(
     const std::string& bootloader) {
@@ -306,7 +307,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_bootloader(
 }
 static constexpr char kInitramfsPath[] = "initramfs_path";
 std::string CuttlefishConfig::InstanceSpecific::initramfs_path() const {
-  return (*Dictionary())[kInitramfsPath].asString();
+  return Dictionary()[kInitramfsPath].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_initramfs_path(
     const std::string& initramfs_path) {
@@ -314,7 +315,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_initramfs_path(
 }
 static constexpr char kKernelPath[] = "kernel_path";
 std::string CuttlefishConfig::InstanceSpecific::kernel_path() const {
-  return (*Dictionary())[kKernelPath].asString();
+  return Dictionary()[kKernelPath].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_kernel_path(
     const std::string& kernel_path) {
@@ -324,7 +325,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_kernel_path(
 
 static constexpr char kSerialNumber[] = "serial_number";
 std::string CuttlefishConfig::InstanceSpecific::serial_number() const {
-  return (*Dictionary())[kSerialNumber].asString();
+  return Dictionary()[kSerialNumber].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_serial_number(
     const std::string& serial_number) {
@@ -334,7 +335,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_serial_number(
 static constexpr char kVirtualDiskPaths[] = "virtual_disk_paths";
 std::vector<std::string> CuttlefishConfig::InstanceSpecific::virtual_disk_paths() const {
   std::vector<std::string> virtual_disks;
-  auto virtual_disks_json_obj = (*Dictionary())[kVirtualDiskPaths];
+  auto virtual_disks_json_obj = Dictionary()[kVirtualDiskPaths];
   for (const auto& disk : virtual_disks_json_obj) {
     virtual_disks.push_back(disk.asString());
   }
@@ -351,7 +352,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_virtual_disk_paths(
 
 static constexpr char kGuestAndroidVersion[] = "guest_android_version";
 std::string CuttlefishConfig::InstanceSpecific::guest_android_version() const {
-  return (*Dictionary())[kGuestAndroidVersion].asString();
+  return Dictionary()[kGuestAndroidVersion].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_guest_android_version(
     const std::string& guest_android_version) {
@@ -360,7 +361,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_guest_android_version(
 
 static constexpr char kBootconfigSupported[] = "bootconfig_supported";
 bool CuttlefishConfig::InstanceSpecific::bootconfig_supported() const {
-  return (*Dictionary())[kBootconfigSupported].asBool();
+  return Dictionary()[kBootconfigSupported].asBool();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_bootconfig_supported(
     bool bootconfig_supported) {
@@ -369,7 +370,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_bootconfig_supported(
 
 static constexpr char kFilenameEncryptionMode[] = "filename_encryption_mode";
 std::string CuttlefishConfig::InstanceSpecific::filename_encryption_mode() const {
-  return (*Dictionary())[kFilenameEncryptionMode].asString();
+  return Dictionary()[kFilenameEncryptionMode].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_filename_encryption_mode(
     const std::string& filename_encryption_mode) {
@@ -409,7 +410,7 @@ std::string CuttlefishConfig::InstanceSpecific::gnss_out_pipe_name() const {
 static constexpr char kGnssGrpcProxyServerPort[] =
     "gnss_grpc_proxy_server_port";
 int CuttlefishConfig::InstanceSpecific::gnss_grpc_proxy_server_port() const {
-  return (*Dictionary())[kGnssGrpcProxyServerPort].asInt();
+  return Dictionary()[kGnssGrpcProxyServerPort].asInt();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_gnss_grpc_proxy_server_port(
     int gnss_grpc_proxy_server_port) {
@@ -418,7 +419,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_gnss_grpc_proxy_server_port(
 
 static constexpr char kGnssFilePath[] = "gnss_file_path";
 std::string CuttlefishConfig::InstanceSpecific::gnss_file_path() const {
-  return (*Dictionary())[kGnssFilePath].asString();
+  return Dictionary()[kGnssFilePath].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_gnss_file_path(
   const std::string& gnss_file_path) {
@@ -428,7 +429,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_gnss_file_path(
 static constexpr char kFixedLocationFilePath[] = "fixed_location_file_path";
 std::string CuttlefishConfig::InstanceSpecific::fixed_location_file_path()
     const {
-  return (*Dictionary())[kFixedLocationFilePath].asString();
+  return Dictionary()[kFixedLocationFilePath].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_fixed_location_file_path(
     const std::string& fixed_location_file_path) {
@@ -437,7 +438,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_fixed_location_file_path(
 
 static constexpr char kGem5BinaryDir[] = "gem5_binary_dir";
 std::string CuttlefishConfig::InstanceSpecific::gem5_binary_dir() const {
-  return (*Dictionary())[kGem5BinaryDir].asString();
+  return Dictionary()[kGem5BinaryDir].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_gem5_binary_dir(
     const std::string& gem5_binary_dir) {
@@ -446,7 +447,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_gem5_binary_dir(
 
 static constexpr char kGem5CheckpointDir[] = "gem5_checkpoint_dir";
 std::string CuttlefishConfig::InstanceSpecific::gem5_checkpoint_dir() const {
-  return (*Dictionary())[kGem5CheckpointDir].asString();
+  return Dictionary()[kGem5CheckpointDir].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_gem5_checkpoint_dir(
     const std::string& gem5_checkpoint_dir) {
@@ -458,12 +459,12 @@ void CuttlefishConfig::MutableInstanceSpecific::set_kgdb(bool kgdb) {
   (*Dictionary())[kKgdb] = kgdb;
 }
 bool CuttlefishConfig::InstanceSpecific::kgdb() const {
-  return (*Dictionary())[kKgdb].asBool();
+  return Dictionary()[kKgdb].asBool();
 }
 
 static constexpr char kCpus[] = "cpus";
 void CuttlefishConfig::MutableInstanceSpecific::set_cpus(int cpus) { (*Dictionary())[kCpus] = cpus; }
-int CuttlefishConfig::InstanceSpecific::cpus() const { return (*Dictionary())[kCpus].asInt(); }
+int CuttlefishConfig::InstanceSpecific::cpus() const { return Dictionary()[kCpus].asInt(); }
 
 static constexpr char kDataPolicy[] = "data_policy";
 void CuttlefishConfig::MutableInstanceSpecific::set_data_policy(
@@ -471,7 +472,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_data_policy(
   (*Dictionary())[kDataPolicy] = data_policy;
 }
 std::string CuttlefishConfig::InstanceSpecific::data_policy() const {
-  return (*Dictionary())[kDataPolicy].asString();
+  return Dictionary()[kDataPolicy].asString();
 }
 
 static constexpr char kBlankDataImageMb[] = "blank_data_image_mb";
@@ -480,7 +481,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_blank_data_image_mb(
   (*Dictionary())[kBlankDataImageMb] = blank_data_image_mb;
 }
 int CuttlefishConfig::InstanceSpecific::blank_data_image_mb() const {
-  return (*Dictionary())[kBlankDataImageMb].asInt();
+  return Dictionary()[kBlankDataImageMb].asInt();
 }
 
 static constexpr char kGdbPort[] = "gdb_port";
@@ -488,12 +489,12 @@ void CuttlefishConfig::MutableInstanceSpecific::set_gdb_port(int port) {
   (*Dictionary())[kGdbPort] = port;
 }
 int CuttlefishConfig::InstanceSpecific::gdb_port() const {
-  return (*Dictionary())[kGdbPort].asInt();
+  return Dictionary()[kGdbPort].asInt();
 }
 
 static constexpr char kMemoryMb[] = "memory_mb";
 int CuttlefishConfig::InstanceSpecific::memory_mb() const {
-  return (*Dictionary())[kMemoryMb].asInt();
+  return Dictionary()[kMemoryMb].asInt();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_memory_mb(int memory_mb) {
   (*Dictionary())[kMemoryMb] = memory_mb;
@@ -501,7 +502,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_memory_mb(int memory_mb) {
 
 static constexpr char kDdrMemMb[] = "ddr_mem_mb";
 int CuttlefishConfig::InstanceSpecific::ddr_mem_mb() const {
-  return (*Dictionary())[kDdrMemMb].asInt();
+  return Dictionary()[kDdrMemMb].asInt();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_ddr_mem_mb(int ddr_mem_mb) {
   (*Dictionary())[kDdrMemMb] = ddr_mem_mb;
@@ -509,7 +510,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_ddr_mem_mb(int ddr_mem_mb) {
 
 static constexpr char kSetupWizardMode[] = "setupwizard_mode";
 std::string CuttlefishConfig::InstanceSpecific::setupwizard_mode() const {
-  return (*Dictionary())[kSetupWizardMode].asString();
+  return Dictionary()[kSetupWizardMode].asString();
 }
 Result<void> CuttlefishConfig::MutableInstanceSpecific::set_setupwizard_mode(
     const std::string& mode) {
@@ -521,7 +522,7 @@ Result<void> CuttlefishConfig::MutableInstanceSpecific::set_setupwizard_mode(
 
 static constexpr char kUserdataFormat[] = "userdata_format";
 std::string CuttlefishConfig::InstanceSpecific::userdata_format() const {
-  return (*Dictionary())[kUserdataFormat].asString();
+  return Dictionary()[kUserdataFormat].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_userdata_format(const std::string& userdata_format) {
   auto fmt = userdata_format;
@@ -534,7 +535,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_guest_enforce_security(bool
   (*Dictionary())[kGuestEnforceSecurity] = guest_enforce_security;
 }
 bool CuttlefishConfig::InstanceSpecific::guest_enforce_security() const {
-  return (*Dictionary())[kGuestEnforceSecurity].asBool();
+  return Dictionary()[kGuestEnforceSecurity].asBool();
 }
 
 static constexpr char kUseSdcard[] = "use_sdcard";
@@ -542,7 +543,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_use_sdcard(bool use_sdcard)
   (*Dictionary())[kUseSdcard] = use_sdcard;
 }
 bool CuttlefishConfig::InstanceSpecific::use_sdcard() const {
-  return (*Dictionary())[kUseSdcard].asBool();
+  return Dictionary()[kUseSdcard].asBool();
 }
 
 static constexpr char kPauseInBootloader[] = "pause_in_bootloader";
@@ -550,12 +551,12 @@ void CuttlefishConfig::MutableInstanceSpecific::set_pause_in_bootloader(bool pau
   (*Dictionary())[kPauseInBootloader] = pause_in_bootloader;
 }
 bool CuttlefishConfig::InstanceSpecific::pause_in_bootloader() const {
-  return (*Dictionary())[kPauseInBootloader].asBool();
+  return Dictionary()[kPauseInBootloader].asBool();
 }
 
 static constexpr char kRunAsDaemon[] = "run_as_daemon";
 bool CuttlefishConfig::InstanceSpecific::run_as_daemon() const {
-  return (*Dictionary())[kRunAsDaemon].asBool();
+  return Dictionary()[kRunAsDaemon].asBool();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_run_as_daemon(bool run_as_daemon) {
   (*Dictionary())[kRunAsDaemon] = run_as_daemon;
@@ -563,7 +564,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_run_as_daemon(bool run_as_da
 
 static constexpr char kEnableMinimalMode[] = "enable_minimal_mode";
 bool CuttlefishConfig::InstanceSpecific::enable_minimal_mode() const {
-  return (*Dictionary())[kEnableMinimalMode].asBool();
+  return Dictionary()[kEnableMinimalMode].asBool();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_enable_minimal_mode(
     bool enable_minimal_mode) {
@@ -572,7 +573,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_enable_minimal_mode(
 
 static constexpr char kRunModemSimulator[] = "enable_modem_simulator";
 bool CuttlefishConfig::InstanceSpecific::enable_modem_simulator() const {
-  return (*Dictionary())[kRunModemSimulator].asBool();
+  return Dictionary()[kRunModemSimulator].asBool();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_enable_modem_simulator(
     bool enable_modem_simulator) {
@@ -587,7 +588,7 @@ void CuttlefishConfig::MutableInstanceSpecific::
 }
 int CuttlefishConfig::InstanceSpecific::modem_simulator_instance_number()
     const {
-  return (*Dictionary())[kModemSimulatorInstanceNumber].asInt();
+  return Dictionary()[kModemSimulatorInstanceNumber].asInt();
 }
 
 static constexpr char kModemSimulatorSimType[] = "modem_simulator_sim_type";
@@ -596,12 +597,12 @@ void CuttlefishConfig::MutableInstanceSpecific::set_modem_simulator_sim_type(
   (*Dictionary())[kModemSimulatorSimType] = sim_type;
 }
 int CuttlefishConfig::InstanceSpecific::modem_simulator_sim_type() const {
-  return (*Dictionary())[kModemSimulatorSimType].asInt();
+  return Dictionary()[kModemSimulatorSimType].asInt();
 }
 
 static constexpr char kGpuMode[] = "gpu_mode";
 std::string CuttlefishConfig::InstanceSpecific::gpu_mode() const {
-  return (*Dictionary())[kGpuMode].asString();
+  return Dictionary()[kGpuMode].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_gpu_mode(const std::string& name) {
   (*Dictionary())[kGpuMode] = name;
@@ -612,7 +613,7 @@ static constexpr char kGpuAngleFeatureOverridesEnabled[] =
 std::string
 CuttlefishConfig::InstanceSpecific::gpu_angle_feature_overrides_enabled()
     const {
-  return (*Dictionary())[kGpuAngleFeatureOverridesEnabled].asString();
+  return Dictionary()[kGpuAngleFeatureOverridesEnabled].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::
     set_gpu_angle_feature_overrides_enabled(const std::string& overrides) {
@@ -624,7 +625,7 @@ static constexpr char kGpuAngleFeatureOverridesDisabled[] =
 std::string
 CuttlefishConfig::InstanceSpecific::gpu_angle_feature_overrides_disabled()
     const {
-  return (*Dictionary())[kGpuAngleFeatureOverridesDisabled].asString();
+  return Dictionary()[kGpuAngleFeatureOverridesDisabled].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::
     set_gpu_angle_feature_overrides_disabled(const std::string& overrides) {
@@ -633,7 +634,7 @@ void CuttlefishConfig::MutableInstanceSpecific::
 
 static constexpr char kGpuCaptureBinary[] = "gpu_capture_binary";
 std::string CuttlefishConfig::InstanceSpecific::gpu_capture_binary() const {
-  return (*Dictionary())[kGpuCaptureBinary].asString();
+  return Dictionary()[kGpuCaptureBinary].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_gpu_capture_binary(const std::string& name) {
   (*Dictionary())[kGpuCaptureBinary] = name;
@@ -641,7 +642,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_gpu_capture_binary(const std
 
 static constexpr char kRestartSubprocesses[] = "restart_subprocesses";
 bool CuttlefishConfig::InstanceSpecific::restart_subprocesses() const {
-  return (*Dictionary())[kRestartSubprocesses].asBool();
+  return Dictionary()[kRestartSubprocesses].asBool();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_restart_subprocesses(bool restart_subprocesses) {
   (*Dictionary())[kRestartSubprocesses] = restart_subprocesses;
@@ -649,7 +650,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_restart_subprocesses(bool re
 
 static constexpr char kHWComposer[] = "hwcomposer";
 std::string CuttlefishConfig::InstanceSpecific::hwcomposer() const {
-  return (*Dictionary())[kHWComposer].asString();
+  return Dictionary()[kHWComposer].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_hwcomposer(const std::string& name) {
   (*Dictionary())[kHWComposer] = name;
@@ -660,7 +661,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_enable_gpu_udmabuf(const boo
   (*Dictionary())[kEnableGpuUdmabuf] = enable_gpu_udmabuf;
 }
 bool CuttlefishConfig::InstanceSpecific::enable_gpu_udmabuf() const {
-  return (*Dictionary())[kEnableGpuUdmabuf].asBool();
+  return Dictionary()[kEnableGpuUdmabuf].asBool();
 }
 
 static constexpr char kEnableAudio[] = "enable_audio";
@@ -668,7 +669,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_enable_audio(bool enable) {
   (*Dictionary())[kEnableAudio] = enable;
 }
 bool CuttlefishConfig::InstanceSpecific::enable_audio() const {
-  return (*Dictionary())[kEnableAudio].asBool();
+  return Dictionary()[kEnableAudio].asBool();
 }
 
 static constexpr char kEnableGnssGrpcProxy[] = "enable_gnss_grpc_proxy";
@@ -676,12 +677,12 @@ void CuttlefishConfig::MutableInstanceSpecific::set_enable_gnss_grpc_proxy(const
   (*Dictionary())[kEnableGnssGrpcProxy] = enable_gnss_grpc_proxy;
 }
 bool CuttlefishConfig::InstanceSpecific::enable_gnss_grpc_proxy() const {
-  return (*Dictionary())[kEnableGnssGrpcProxy].asBool();
+  return Dictionary()[kEnableGnssGrpcProxy].asBool();
 }
 
 static constexpr char kEnableBootAnimation[] = "enable_bootanimation";
 bool CuttlefishConfig::InstanceSpecific::enable_bootanimation() const {
-  return (*Dictionary())[kEnableBootAnimation].asBool();
+  return Dictionary()[kEnableBootAnimation].asBool();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_enable_bootanimation(
     bool enable_bootanimation) {
@@ -694,12 +695,12 @@ void CuttlefishConfig::MutableInstanceSpecific::set_record_screen(
   (*Dictionary())[kRecordScreen] = record_screen;
 }
 bool CuttlefishConfig::InstanceSpecific::record_screen() const {
-  return (*Dictionary())[kRecordScreen].asBool();
+  return Dictionary()[kRecordScreen].asBool();
 }
 
 static constexpr char kGem5DebugFile[] = "gem5_debug_file";
 std::string CuttlefishConfig::InstanceSpecific::gem5_debug_file() const {
-  return (*Dictionary())[kGem5DebugFile].asString();
+  return Dictionary()[kGem5DebugFile].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_gem5_debug_file(const std::string& gem5_debug_file) {
   (*Dictionary())[kGem5DebugFile] = gem5_debug_file;
@@ -710,7 +711,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_protected_vm(bool protected_
   (*Dictionary())[kProtectedVm] = protected_vm;
 }
 bool CuttlefishConfig::InstanceSpecific::protected_vm() const {
-  return (*Dictionary())[kProtectedVm].asBool();
+  return Dictionary()[kProtectedVm].asBool();
 }
 
 static constexpr char kMte[] = "mte";
@@ -718,7 +719,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_mte(bool mte) {
   (*Dictionary())[kMte] = mte;
 }
 bool CuttlefishConfig::InstanceSpecific::mte() const {
-  return (*Dictionary())[kMte].asBool();
+  return Dictionary()[kMte].asBool();
 }
 
 static constexpr char kEnableKernelLog[] = "enable_kernel_log";
@@ -726,7 +727,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_enable_kernel_log(bool enabl
   (*Dictionary())[kEnableKernelLog] = enable_kernel_log;
 }
 bool CuttlefishConfig::InstanceSpecific::enable_kernel_log() const {
-  return (*Dictionary())[kEnableKernelLog].asBool();
+  return Dictionary()[kEnableKernelLog].asBool();
 }
 
 static constexpr char kBootSlot[] = "boot_slot";
@@ -734,7 +735,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_boot_slot(const std::string&
   (*Dictionary())[kBootSlot] = boot_slot;
 }
 std::string CuttlefishConfig::InstanceSpecific::boot_slot() const {
-  return (*Dictionary())[kBootSlot].asString();
+  return Dictionary()[kBootSlot].asString();
 }
 
 static constexpr char kEnableWebRTC[] = "enable_webrtc";
@@ -742,7 +743,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_enable_webrtc(bool enable_we
   (*Dictionary())[kEnableWebRTC] = enable_webrtc;
 }
 bool CuttlefishConfig::InstanceSpecific::enable_webrtc() const {
-  return (*Dictionary())[kEnableWebRTC].asBool();
+  return Dictionary()[kEnableWebRTC].asBool();
 }
 
 static constexpr char kWebRTCAssetsDir[] = "webrtc_assets_dir";
@@ -750,7 +751,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_webrtc_assets_dir(const std:
   (*Dictionary())[kWebRTCAssetsDir] = webrtc_assets_dir;
 }
 std::string CuttlefishConfig::InstanceSpecific::webrtc_assets_dir() const {
-  return (*Dictionary())[kWebRTCAssetsDir].asString();
+  return Dictionary()[kWebRTCAssetsDir].asString();
 }
 
 static constexpr char kWebrtcTcpPortRange[] = "webrtc_tcp_port_range";
@@ -763,8 +764,8 @@ void CuttlefishConfig::MutableInstanceSpecific::set_webrtc_tcp_port_range(
 }
 std::pair<uint16_t, uint16_t> CuttlefishConfig::InstanceSpecific::webrtc_tcp_port_range() const {
   std::pair<uint16_t, uint16_t> ret;
-  ret.first = (*Dictionary())[kWebrtcTcpPortRange][0].asInt();
-  ret.second = (*Dictionary())[kWebrtcTcpPortRange][1].asInt();
+  ret.first = Dictionary()[kWebrtcTcpPortRange][0].asInt();
+  ret.second = Dictionary()[kWebrtcTcpPortRange][1].asInt();
   return ret;
 }
 
@@ -778,14 +779,14 @@ void CuttlefishConfig::MutableInstanceSpecific::set_webrtc_udp_port_range(
 }
 std::pair<uint16_t, uint16_t> CuttlefishConfig::InstanceSpecific::webrtc_udp_port_range() const {
   std::pair<uint16_t, uint16_t> ret;
-  ret.first = (*Dictionary())[kWebrtcUdpPortRange][0].asInt();
-  ret.second = (*Dictionary())[kWebrtcUdpPortRange][1].asInt();
+  ret.first = Dictionary()[kWebrtcUdpPortRange][0].asInt();
+  ret.second = Dictionary()[kWebrtcUdpPortRange][1].asInt();
   return ret;
 }
 
 static constexpr char kGrpcConfig[] = "grpc_config";
 std::string CuttlefishConfig::InstanceSpecific::grpc_socket_path() const {
-  return (*Dictionary())[kGrpcConfig].asString();
+  return Dictionary()[kGrpcConfig].asString();
 }
 
 void CuttlefishConfig::MutableInstanceSpecific::set_grpc_socket_path(
@@ -798,12 +799,12 @@ void CuttlefishConfig::MutableInstanceSpecific::set_smt(bool smt) {
   (*Dictionary())[kSmt] = smt;
 }
 bool CuttlefishConfig::InstanceSpecific::smt() const {
-  return (*Dictionary())[kSmt].asBool();
+  return Dictionary()[kSmt].asBool();
 }
 
 static constexpr char kCrosvmBinary[] = "crosvm_binary";
 std::string CuttlefishConfig::InstanceSpecific::crosvm_binary() const {
-  return (*Dictionary())[kCrosvmBinary].asString();
+  return Dictionary()[kCrosvmBinary].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_crosvm_binary(
     const std::string& crosvm_binary) {
@@ -827,12 +828,12 @@ void CuttlefishConfig::MutableInstanceSpecific::set_seccomp_policy_dir(
   SetPath(kSeccompPolicyDir, seccomp_policy_dir);
 }
 std::string CuttlefishConfig::InstanceSpecific::seccomp_policy_dir() const {
-  return (*Dictionary())[kSeccompPolicyDir].asString();
+  return Dictionary()[kSeccompPolicyDir].asString();
 }
 
 static constexpr char kQemuBinaryDir[] = "qemu_binary_dir";
 std::string CuttlefishConfig::InstanceSpecific::qemu_binary_dir() const {
-  return (*Dictionary())[kQemuBinaryDir].asString();
+  return Dictionary()[kQemuBinaryDir].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_qemu_binary_dir(
     const std::string& qemu_binary_dir) {
@@ -844,7 +845,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_vhost_net(bool vhost_net) {
   (*Dictionary())[kVhostNet] = vhost_net;
 }
 bool CuttlefishConfig::InstanceSpecific::vhost_net() const {
-  return (*Dictionary())[kVhostNet].asBool();
+  return Dictionary()[kVhostNet].asBool();
 }
 
 static constexpr char kRilDns[] = "ril_dns";
@@ -852,7 +853,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_ril_dns(const std::string& r
   (*Dictionary())[kRilDns] = ril_dns;
 }
 std::string CuttlefishConfig::InstanceSpecific::ril_dns() const {
-  return (*Dictionary())[kRilDns].asString();
+  return Dictionary()[kRilDns].asString();
 }
 
 static constexpr char kDisplayConfigs[] = "display_configs";
@@ -863,7 +864,7 @@ static constexpr char kRefreshRateHz[] = "refresh_rate_hz";
 std::vector<CuttlefishConfig::DisplayConfig>
 CuttlefishConfig::InstanceSpecific::display_configs() const {
   std::vector<DisplayConfig> display_configs;
-  for (auto& display_config_json : (*Dictionary())[kDisplayConfigs]) {
+  for (const auto& display_config_json : Dictionary()[kDisplayConfigs]) {
     DisplayConfig display_config = {};
     display_config.width = display_config_json[kXRes].asInt();
     display_config.height = display_config_json[kYRes].asInt();
@@ -897,7 +898,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_target_arch(
   (*Dictionary())[kTargetArch] = static_cast<int>(target_arch);
 }
 Arch CuttlefishConfig::InstanceSpecific::target_arch() const {
-  return static_cast<Arch>((*Dictionary())[kTargetArch].asInt());
+  return static_cast<Arch>(Dictionary()[kTargetArch].asInt());
 }
 
 static constexpr char kEnableSandbox[] = "enable_sandbox";
@@ -905,14 +906,14 @@ void CuttlefishConfig::MutableInstanceSpecific::set_enable_sandbox(const bool en
   (*Dictionary())[kEnableSandbox] = enable_sandbox;
 }
 bool CuttlefishConfig::InstanceSpecific::enable_sandbox() const {
-  return (*Dictionary())[kEnableSandbox].asBool();
+  return Dictionary()[kEnableSandbox].asBool();
 }
 static constexpr char kConsole[] = "console";
 void CuttlefishConfig::MutableInstanceSpecific::set_console(bool console) {
   (*Dictionary())[kConsole] = console;
 }
 bool CuttlefishConfig::InstanceSpecific::console() const {
-  return (*Dictionary())[kConsole].asBool();
+  return Dictionary()[kConsole].asBool();
 }
 std::string CuttlefishConfig::InstanceSpecific::console_dev() const {
   auto can_use_virtio_console = !kgdb() && !use_bootloader();
@@ -968,7 +969,7 @@ std::string CuttlefishConfig::InstanceSpecific::launcher_monitor_socket_path()
 
 static constexpr char kModemSimulatorPorts[] = "modem_simulator_ports";
 std::string CuttlefishConfig::InstanceSpecific::modem_simulator_ports() const {
-  return (*Dictionary())[kModemSimulatorPorts].asString();
+  return Dictionary()[kModemSimulatorPorts].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_modem_simulator_ports(
     const std::string& modem_simulator_ports) {
@@ -979,6 +980,21 @@ std::string CuttlefishConfig::InstanceSpecific::launcher_log_path() const {
   return AbsolutePath(PerInstanceLogPath("launcher.log"));
 }
 
+std::string CuttlefishConfig::InstanceSpecific::launcher_binary_log_path()
+    const {
+  return AbsolutePath(PerInstanceLogPath("launcher.binlog"));
+}
+
+std::string CuttlefishConfig::InstanceSpecific::log_collector_socket_path()
+    const {
+  return PerInstanceInternalUdsPath("log_collector.sock");
+}
+
+std::string CuttlefishConfig::InstanceSpecific::webrtc_input_latency_path()
+    const {
+  return AbsolutePath(PerInstanceLogPath("webrtc_input_latency.json"));
+}
+
 std::string CuttlefishConfig::InstanceSpecific::sdcard_path() const {
   return AbsolutePath(PerInstancePath("sdcard.img"));
 }
@@ -1061,7 +1077,7 @@ CuttlefishConfig::InstanceSpecific::BootFlow CuttlefishConfig::InstanceSpecific:
  }
 
 std::string CuttlefishConfig::InstanceSpecific::mobile_bridge_name() const {
-  return (*Dictionary())[kMobileBridgeName].asString();
+  return Dictionary()[kMobileBridgeName].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_mobile_bridge_name(
     const std::string& mobile_bridge_name) {
@@ -1070,7 +1086,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_mobile_bridge_name(
 
 static constexpr char kMobileTapName[] = "mobile_tap_name";
 std::string CuttlefishConfig::InstanceSpecific::mobile_tap_name() const {
-  return (*Dictionary())[kMobileTapName].asString();
+  return Dictionary()[kMobileTapName].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_mobile_tap_name(
     const std::string& mobile_tap_name) {
@@ -1079,7 +1095,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_mobile_tap_name(
 
 static constexpr char kMobileMac[] = "mobile_mac";
 std::string CuttlefishConfig::InstanceSpecific::mobile_mac() const {
-  return (*Dictionary())[kMobileMac].asString();
+  return Dictionary()[kMobileMac].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_mobile_mac(
     const std::string& mac) {
@@ -1090,7 +1106,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_mobile_mac(
 // PRODUCT_ENFORCE_MAC80211_HWSIM is removed
 static constexpr char kWifiTapName[] = "wifi_tap_name";
 std::string CuttlefishConfig::InstanceSpecific::wifi_tap_name() const {
-  return (*Dictionary())[kWifiTapName].asString();
+  return Dictionary()[kWifiTapName].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_wifi_tap_name(
     const std::string& wifi_tap_name) {
@@ -1099,7 +1115,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_wifi_tap_name(
 
 static constexpr char kWifiBridgeName[] = "wifi_bridge_name";
 std::string CuttlefishConfig::InstanceSpecific::wifi_bridge_name() const {
-  return (*Dictionary())[kWifiBridgeName].asString();
+  return Dictionary()[kWifiBridgeName].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_wifi_bridge_name(
     const std::string& wifi_bridge_name) {
@@ -1108,7 +1124,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_wifi_bridge_name(
 
 static constexpr char kWifiMac[] = "wifi_mac";
 std::string CuttlefishConfig::InstanceSpecific::wifi_mac() const {
-  return (*Dictionary())[kWifiMac].asString();
+  return Dictionary()[kWifiMac].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_wifi_mac(
     const std::string& mac) {
@@ -1117,7 +1133,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_wifi_mac(
 
 static constexpr char kUseBridgedWifiTap[] = "use_bridged_wifi_tap";
 bool CuttlefishConfig::InstanceSpecific::use_bridged_wifi_tap() const {
-  return (*Dictionary())[kUseBridgedWifiTap].asBool();
+  return Dictionary()[kUseBridgedWifiTap].asBool();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_use_bridged_wifi_tap(
     bool use_bridged_wifi_tap) {
@@ -1126,7 +1142,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_use_bridged_wifi_tap(
 
 static constexpr char kEthernetTapName[] = "ethernet_tap_name";
 std::string CuttlefishConfig::InstanceSpecific::ethernet_tap_name() const {
-  return (*Dictionary())[kEthernetTapName].asString();
+  return Dictionary()[kEthernetTapName].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_ethernet_tap_name(
     const std::string& ethernet_tap_name) {
@@ -1135,7 +1151,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_ethernet_tap_name(
 
 static constexpr char kEthernetBridgeName[] = "ethernet_bridge_name";
 std::string CuttlefishConfig::InstanceSpecific::ethernet_bridge_name() const {
-  return (*Dictionary())[kEthernetBridgeName].asString();
+  return Dictionary()[kEthernetBridgeName].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_ethernet_bridge_name(
     const std::string& ethernet_bridge_name) {
@@ -1144,7 +1160,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_ethernet_bridge_name(
 
 static constexpr char kEthernetMac[] = "ethernet_mac";
 std::string CuttlefishConfig::InstanceSpecific::ethernet_mac() const {
-  return (*Dictionary())[kEthernetMac].asString();
+  return Dictionary()[kEthernetMac].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_ethernet_mac(
     const std::string& mac) {
@@ -1153,7 +1169,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_ethernet_mac(
 
 static constexpr char kEthernetIPV6[] = "ethernet_ipv6";
 std::string CuttlefishConfig::InstanceSpecific::ethernet_ipv6() const {
-  return (*Dictionary())[kEthernetIPV6].asString();
+  return Dictionary()[kEthernetIPV6].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_ethernet_ipv6(
     const std::string& ip) {
@@ -1162,7 +1178,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_ethernet_ipv6(
 
 static constexpr char kUseAllocd[] = "use_allocd";
 bool CuttlefishConfig::InstanceSpecific::use_allocd() const {
-  return (*Dictionary())[kUseAllocd].asBool();
+  return Dictionary()[kUseAllocd].asBool();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_use_allocd(
     bool use_allocd) {
@@ -1171,7 +1187,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_use_allocd(
 
 static constexpr char kSessionId[] = "session_id";
 uint32_t CuttlefishConfig::InstanceSpecific::session_id() const {
-  return (*Dictionary())[kSessionId].asUInt();
+  return Dictionary()[kSessionId].asUInt();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_session_id(
     uint32_t session_id) {
@@ -1180,7 +1196,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_session_id(
 
 static constexpr char kVsockGuestCid[] = "vsock_guest_cid";
 int CuttlefishConfig::InstanceSpecific::vsock_guest_cid() const {
-  return (*Dictionary())[kVsockGuestCid].asInt();
+  return Dictionary()[kVsockGuestCid].asInt();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_vsock_guest_cid(
     int vsock_guest_cid) {
@@ -1189,7 +1205,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_vsock_guest_cid(
 
 static constexpr char kUuid[] = "uuid";
 std::string CuttlefishConfig::InstanceSpecific::uuid() const {
-  return (*Dictionary())[kUuid].asString();
+  return Dictionary()[kUuid].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_uuid(const std::string& uuid) {
   (*Dictionary())[kUuid] = uuid;
@@ -1197,7 +1213,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_uuid(const std::string& uuid
 
 static constexpr char kHostPort[] = "adb_host_port";
 int CuttlefishConfig::InstanceSpecific::adb_host_port() const {
-  return (*Dictionary())[kHostPort].asInt();
+  return Dictionary()[kHostPort].asInt();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_adb_host_port(int port) {
   (*Dictionary())[kHostPort] = port;
@@ -1205,7 +1221,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_adb_host_port(int port) {
 
 static constexpr char kFastbootHostPort[] = "fastboot_host_port";
 int CuttlefishConfig::InstanceSpecific::fastboot_host_port() const {
-  return (*Dictionary())[kFastbootHostPort].asInt();
+  return Dictionary()[kFastbootHostPort].asInt();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_fastboot_host_port(int port) {
   (*Dictionary())[kFastbootHostPort] = port;
@@ -1213,7 +1229,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_fastboot_host_port(int port)
 
 static constexpr char kModemSimulatorId[] = "modem_simulator_host_id";
 int CuttlefishConfig::InstanceSpecific::modem_simulator_host_id() const {
-  return (*Dictionary())[kModemSimulatorId].asInt();
+  return Dictionary()[kModemSimulatorId].asInt();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_modem_simulator_host_id(
     int id) {
@@ -1222,7 +1238,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_modem_simulator_host_id(
 
 static constexpr char kAdbIPAndPort[] = "adb_ip_and_port";
 std::string CuttlefishConfig::InstanceSpecific::adb_ip_and_port() const {
-  return (*Dictionary())[kAdbIPAndPort].asString();
+  return Dictionary()[kAdbIPAndPort].asString();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_adb_ip_and_port(
     const std::string& ip_port) {
@@ -1239,7 +1255,7 @@ std::string CuttlefishConfig::InstanceSpecific::adb_device_name() const {
 
 static constexpr char kQemuVncServerPort[] = "qemu_vnc_server_port";
 int CuttlefishConfig::InstanceSpecific::qemu_vnc_server_port() const {
-  return (*Dictionary())[kQemuVncServerPort].asInt();
+  return Dictionary()[kQemuVncServerPort].asInt();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_qemu_vnc_server_port(
     int qemu_vnc_server_port) {
@@ -1248,7 +1264,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_qemu_vnc_server_port(
 
 static constexpr char kTouchServerPort[] = "touch_server_port";
 int CuttlefishConfig::InstanceSpecific::touch_server_port() const {
-  return (*Dictionary())[kTouchServerPort].asInt();
+  return Dictionary()[kTouchServerPort].asInt();
 }
 
 void CuttlefishConfig::MutableInstanceSpecific::set_touch_server_port(int touch_server_port) {
@@ -1257,7 +1273,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_touch_server_port(int touch_
 
 static constexpr char kKeyboardServerPort[] = "keyboard_server_port";
 int CuttlefishConfig::InstanceSpecific::keyboard_server_port() const {
-  return (*Dictionary())[kKeyboardServerPort].asInt();
+  return Dictionary()[kKeyboardServerPort].asInt();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_keyboard_server_port(int keyboard_server_port) {
   (*Dictionary())[kKeyboardServerPort] = keyboard_server_port;
@@ -1265,7 +1281,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_keyboard_server_port(int key
 
 static constexpr char kTombstoneReceiverPort[] = "tombstone_receiver_port";
 int CuttlefishConfig::InstanceSpecific::tombstone_receiver_port() const {
-  return (*Dictionary())[kTombstoneReceiverPort].asInt();
+  return Dictionary()[kTombstoneReceiverPort].asInt();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_tombstone_receiver_port(int tombstone_receiver_port) {
   (*Dictionary())[kTombstoneReceiverPort] = tombstone_receiver_port;
@@ -1273,7 +1289,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_tombstone_receiver_port(int
 
 static constexpr char kAudioControlServerPort[] = "audiocontrol_server_port";
 int CuttlefishConfig::InstanceSpecific::audiocontrol_server_port() const {
-  return (*Dictionary())[kAudioControlServerPort].asInt();
+  return Dictionary()[kAudioControlServerPort].asInt();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_audiocontrol_server_port(int audiocontrol_server_port) {
   (*Dictionary())[kAudioControlServerPort] = audiocontrol_server_port;
@@ -1281,7 +1297,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_audiocontrol_server_port(int
 
 static constexpr char kConfigServerPort[] = "config_server_port";
 int CuttlefishConfig::InstanceSpecific::config_server_port() const {
-  return (*Dictionary())[kConfigServerPort].asInt();
+  return Dictionary()[kConfigServerPort].asInt();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_config_server_port(int config_server_port) {
   (*Dictionary())[kConfigServerPort] = config_server_port;
@@ -1289,7 +1305,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_config_server_port(int confi
 
 static constexpr char kCameraServerPort[] = "camera_server_port";
 int CuttlefishConfig::InstanceSpecific::camera_server_port() const {
-  return (*Dictionary())[kCameraServerPort].asInt();
+  return Dictionary()[kCameraServerPort].asInt();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_camera_server_port(
     int camera_server_port) {
@@ -1302,7 +1318,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_webrtc_device_id(
   (*Dictionary())[kWebrtcDeviceId] = id;
 }
 std::string CuttlefishConfig::InstanceSpecific::webrtc_device_id() const {
-  return (*Dictionary())[kWebrtcDeviceId].asString();
+  return Dictionary()[kWebrtcDeviceId].asString();
 }
 
 static constexpr char kStartSigServer[] = "webrtc_start_sig_server";
@@ -1310,7 +1326,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_start_webrtc_signaling_serve
   (*Dictionary())[kStartSigServer] = start;
 }
 bool CuttlefishConfig::InstanceSpecific::start_webrtc_sig_server() const {
-  return (*Dictionary())[kStartSigServer].asBool();
+  return Dictionary()[kStartSigServer].asBool();
 }
 
 static constexpr char kStartSigServerProxy[] = "webrtc_start_sig_server_proxy";
@@ -1319,7 +1335,7 @@ void CuttlefishConfig::MutableInstanceSpecific::
   (*Dictionary())[kStartSigServerProxy] = start;
 }
 bool CuttlefishConfig::InstanceSpecific::start_webrtc_sig_server_proxy() const {
-  return (*Dictionary())[kStartSigServerProxy].asBool();
+  return Dictionary()[kStartSigServerProxy].asBool();
 }
 
 static constexpr char kStartWmediumd[] = "start_wmediumd";
@@ -1327,7 +1343,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_start_wmediumd(bool start) {
   (*Dictionary())[kStartWmediumd] = start;
 }
 bool CuttlefishConfig::InstanceSpecific::start_wmediumd() const {
-  return (*Dictionary())[kStartWmediumd].asBool();
+  return Dictionary()[kStartWmediumd].asBool();
 }
 
 static constexpr char kStartRootcanal[] = "start_rootcanal";
@@ -1336,7 +1352,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_start_rootcanal(
   (*Dictionary())[kStartRootcanal] = start;
 }
 bool CuttlefishConfig::InstanceSpecific::start_rootcanal() const {
-  return (*Dictionary())[kStartRootcanal].asBool();
+  return Dictionary()[kStartRootcanal].asBool();
 }
 
 static constexpr char kStartPica[] = "start_pica";
@@ -1345,7 +1361,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_start_pica(
   (*Dictionary())[kStartPica] = start;
 }
 bool CuttlefishConfig::InstanceSpecific::start_pica() const {
-  return (*Dictionary())[kStartPica].asBool();
+  return Dictionary()[kStartPica].asBool();
 }
 
 static constexpr char kStartNetsim[] = "start_netsim";
@@ -1353,7 +1369,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_start_netsim(bool start) {
   (*Dictionary())[kStartNetsim] = start;
 }
 bool CuttlefishConfig::InstanceSpecific::start_netsim() const {
-  return (*Dictionary())[kStartNetsim].asBool();
+  return Dictionary()[kStartNetsim].asBool();
 }
 
 static constexpr char kApBootFlow[] = "ap_boot_flow";
@@ -1361,7 +1377,7 @@ void CuttlefishConfig::MutableInstanceSpecific::set_ap_boot_flow(APBootFlow flow
   (*Dictionary())[kApBootFlow] = static_cast<int>(flow);
 }
 APBootFlow CuttlefishConfig::InstanceSpecific::ap_boot_flow() const {
-  return static_cast<APBootFlow>((*Dictionary())[kApBootFlow].asInt());
+  return static_cast<APBootFlow>(Dictionary()[kApBootFlow].asInt());
 }
 
 std::string CuttlefishConfig::InstanceSpecific::touch_socket_path(
@@ -1384,7 +1400,7 @@ std::string CuttlefishConfig::InstanceSpecific::frames_socket_path() const {
 
 static constexpr char kWifiMacPrefix[] = "wifi_mac_prefix";
 int CuttlefishConfig::InstanceSpecific::wifi_mac_prefix() const {
-  return (*Dictionary())[kWifiMacPrefix].asInt();
+  return Dictionary()[kWifiMacPrefix].asInt();
 }
 void CuttlefishConfig::MutableInstanceSpecific::set_wifi_mac_prefix(
     int wifi_mac_prefix) {
@@ -16,12 +16,290 @@
 
 #include "host/libs/config/feature.h"
 
+#include <unistd.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <limits>
+#include <thread>
 #include <unordered_set>
 
+#include <android-base/file.h>
+#include <android-base/strings.h>
+#include <json/json.h>
+
 #include "common/libs/utils/result.h"
 
 namespace cuttlefish {
 
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kNoNode = std::numeric_limits<size_t>::max();
+
+struct SetupNode {
+  SetupFeature* feature = nullptr;
+  bool parallel = false;
+  std::vector<size_t> dependents;
+  size_t pending_dependencies = 0;
+  // The dependency that finished last, i.e. the previous step in the critical
+  // path leading to this feature.
+  size_t last_dependency = kNoNode;
+  Clock::time_point start;
+  Clock::time_point end;
+};
+
+/**
+ * Runs the setup DAG. Parallel features are spread over per worker deques:
+ * a worker pushes the features it unblocks to the back of its own deque and
+ * takes work from the back as well, so dependent steps tend to stay on the
+ * same thread, while idle workers steal from the front of the others.
+ *
+ * The workers only live while there is parallel work available. Serial
+ * features run on the calling thread once the pool has drained, so they can
+ * safely fork or mutate process wide state.
+ */
+class SetupExecutor {
+ public:
+  using RunFunction = std::function<Result<void>(SetupFeature*)>;
+
+  SetupExecutor(std::vector<SetupNode> nodes, RunFunction run,
+                SetupTrace* trace)
+      : nodes_(std::move(nodes)), run_(std::move(run)), trace_(trace) {
+    size_t parallel_count = 0;
+    for (const auto& node : nodes_) {
+      parallel_count += node.parallel ? 1 : 0;
+    }
+    // Setup features mostly wait on disk I/O and subprocesses, so keep a few
+    // workers around even on small machines.
+    size_t workers = std::max(std::thread::hardware_concurrency(), 4u);
+    queues_ = std::vector<WorkQueue>(std::min<size_t>(workers, parallel_count));
+  }
+
+  Result<void> Run() {
+    auto start = Clock::now();
+    {
+      std::lock_guard lock(mutex_);
+      for (size_t i = 0; i < nodes_.size(); i++) {
+        if (nodes_[i].pending_dependencies == 0) {
+          MakeReadyLocked(i, i);
+        }
+      }
+    }
+    while (true) {
+      if (queued_ > 0) {
+        RunWorkers();
+      }
+      if (failed_node_ != kNoNode || serial_ready_.empty()) {
+        break;
+      }
+      auto index = serial_ready_.front();
+      serial_ready_.pop_front();
+      Execute(index, /* thread */ 0);
+    }
+    if (failed_node_ != kNoNode) {
+      CF_EXPECT(std::move(failure_),
+                "Setup failed for " << nodes_[failed_node_].feature->Name());
+    }
+    CF_EXPECT(completed_ == nodes_.size(),
+              "Only " << completed_ << " out of " << nodes_.size()
+                      << " setup features ran");
+    LogCriticalPath(Clock::now() - start);
+    return {};
+  }
+
+ private:
+  struct WorkQueue {
+    std::mutex mutex;
+    std::deque<size_t> nodes;
+  };
+
+  void RunWorkers() {
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < queues_.size(); i++) {
+      threads.emplace_back([this, i]() { WorkerLoop(i); });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+
+  void WorkerLoop(size_t worker) {
+    while (true) {
+      auto index = TakeWork(worker);
+      if (index != kNoNode) {
+        {
+          std::lock_guard lock(mutex_);
+          queued_--;
+          if (failed_node_ != kNoNode) {
+            // Don't start anything new after a failure.
+            cv_.notify_all();
+            continue;
+          }
+          running_++;
+        }
+        // Thread 0 is the calling thread.
+        Execute(index, worker + 1);
+        continue;
+      }
+      std::unique_lock lock(mutex_);
+      cv_.wait(lock, [this]() { return queued_ > 0 || running_ == 0; });
+      if (queued_ == 0 && running_ == 0) {
+        return;
+      }
+    }
+  }
+
+  size_t TakeWork(size_t worker) {
+    {
+      auto& own = queues_[worker];
+      std::lock_guard lock(own.mutex);
+      if (!own.nodes.empty()) {
+        auto index = own.nodes.back();
+        own.nodes.pop_back();
+        return index;
+      }
+    }
+    for (size_t i = 1; i < queues_.size(); i++) {
+      auto& victim = queues_[(worker + i) % queues_.size()];
+      std::lock_guard lock(victim.mutex);
+      if (!victim.nodes.empty()) {
+        auto index = victim.nodes.front();
+        victim.nodes.pop_front();
+        return index;
+      }
+    }
+    return kNoNode;
+  }
+
+  void Execute(size_t index, size_t thread) {
+    auto& node = nodes_[index];
+    LOG(DEBUG) << "Running setup for " << node.feature->Name();
+    node.start = Clock::now();
+    auto result = run_(node.feature);
+    node.end = Clock::now();
+    LOG(DEBUG) << "Setup for " << node.feature->Name() << " took "
+               << DurationMs(node.end - node.start) << "ms";
+    if (trace_) {
+      trace_->Record(node.feature->Name(), thread, node.start, node.end);
+    }
+
+    std::lock_guard lock(mutex_);
+    if (thread != 0) {
+      running_--;
+    }
+    if (result.ok()) {
+      completed_++;
+      for (auto dependent : node.dependents) {
+        if (--nodes_[dependent].pending_dependencies == 0) {
+          nodes_[dependent].last_dependency = index;
+          MakeReadyLocked(dependent, thread == 0 ? 0 : thread - 1);
+        }
+      }
+    } else if (failed_node_ == kNoNode) {
+      failed_node_ = index;
+      failure_ = std::move(result);
+    }
+    cv_.notify_all();
+  }
+
+  void MakeReadyLocked(size_t index, size_t queue_hint) {
+    if (!nodes_[index].parallel) {
+      serial_ready_.push_back(index);
+      return;
+    }
+    auto& queue = queues_[queue_hint % queues_.size()];
+    std::lock_guard lock(queue.mutex);
+    queue.nodes.push_back(index);
+    queued_++;
+  }
+
+  void LogCriticalPath(Clock::duration total) const {
+    size_t index = kNoNode;
+    for (size_t i = 0; i < nodes_.size(); i++) {
+      if (index == kNoNode || nodes_[i].end > nodes_[index].end) {
+        index = i;
+      }
+    }
+    std::vector<std::string> path;
+    for (; index != kNoNode; index = nodes_[index].last_dependency) {
+      const auto& node = nodes_[index];
+      path.emplace_back(node.feature->Name() + " (" +
+                        std::to_string(DurationMs(node.end - node.start)) +
+                        "ms)");
+    }
+    std::reverse(path.begin(), path.end());
+    LOG(DEBUG) << "Ran " << nodes_.size() << " setup features in "
+               << DurationMs(total) << "ms using " << queues_.size()
+               << " worker threads, critical path: "
+               << android::base::Join(path, " -> ");
+  }
+
+  static int64_t DurationMs(Clock::duration duration) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(duration)
+        .count();
+  }
+
+  std::vector<SetupNode> nodes_;
+  RunFunction run_;
+  SetupTrace* trace_;
+  std::vector<WorkQueue> queues_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  // Number of nodes sitting in the work queues.
+  size_t queued_ = 0;
+  // Number of nodes being run by the workers.
+  size_t running_ = 0;
+  size_t completed_ = 0;
+  std::deque<size_t> serial_ready_;
+  size_t failed_node_ = kNoNode;
+  Result<void> failure_;
+};
+
+}  // namespace
+
+SetupTrace::SetupTrace() : origin_(Clock::now()) {}
+
+void SetupTrace::Record(const std::string& name, size_t thread,
+                        Clock::time_point start, Clock::time_point end) {
+  std::lock_guard lock(mutex_);
+  events_.push_back(Event{name, thread, start, end});
+}
+
+Result<void> SetupTrace::WriteChromeTrace(const std::string& path) const {
+  auto micros = [this](Clock::time_point time) -> Json::Int64 {
+    return std::chrono::duration_cast<std::chrono::microseconds>(time -
+                                                                 origin_)
+        .count();
+  };
+  Json::Value events(Json::arrayValue);
+  {
+    std::lock_guard lock(mutex_);
+    for (const auto& event : events_) {
+      Json::Value json;
+      json["name"] = event.name;
+      json["cat"] = "setup";
+      json["ph"] = "X";
+      json["ts"] = micros(event.start);
+      json["dur"] = micros(event.end) - micros(event.start);
+      json["pid"] = getpid();
+      json["tid"] = static_cast<Json::UInt64>(event.thread);
+      events.append(json);
+    }
+  }
+  Json::Value trace;
+  trace["traceEvents"] = events;
+  trace["displayTimeUnit"] = "ms";
+  Json::StreamWriterBuilder factory;
+  CF_EXPECT(android::base::WriteStringToFile(Json::writeString(factory, trace),
+                                             path),
+            "Failed to write setup trace to \"" << path << "\"");
+  return {};
+}
+
 SetupFeature::~SetupFeature() {}
 
 Result<void> SetupFeature::ResultSetup() {
@@ -35,7 +313,7 @@ bool SetupFeature::Setup() {
 }
 
 /* static */ Result<void> SetupFeature::RunSetup(
-    const std::vector<SetupFeature*>& features) {
+    const std::vector<SetupFeature*>& features, SetupTrace* trace) {
   std::unordered_set<SetupFeature*> enabled;
   for (const auto& feature : features) {
     CF_EXPECT(feature != nullptr, "Received null feature");
@@ -51,11 +329,24 @@ bool SetupFeature::Setup() {
   };
   CF_EXPECT(Feature<SetupFeature>::TopologicalVisit(enabled, add_feature),
             "Dependency issue detected, not performing any setup.");
-  // TODO(b/189153501): This can potentially be parallelized.
-  for (auto& feature : ordered_features) {
-    LOG(DEBUG) << "Running setup for " << feature->Name();
-    CF_EXPECT(feature->ResultSetup(), "Setup failed for " << feature->Name());
+
+  std::unordered_map<SetupFeature*, size_t> indices;
+  for (size_t i = 0; i < ordered_features.size(); i++) {
+    indices[ordered_features[i]] = i;
+  }
+  std::vector<SetupNode> nodes(ordered_features.size());
+  for (size_t i = 0; i < ordered_features.size(); i++) {
+    auto feature = ordered_features[i];
+    nodes[i].feature = feature;
+    nodes[i].parallel = feature->ParallelSetup();
+    for (const auto& dependency : feature->Dependencies()) {
+      nodes[indices[dependency]].dependents.push_back(i);
+      nodes[i].pending_dependencies++;
+    }
   }
+  auto run = [](SetupFeature* feature) { return feature->ResultSetup(); };
+  SetupExecutor executor(std::move(nodes), run, trace);
+  CF_EXPECT(executor.Run());
   return {};
 }
 
@@ -15,6 +15,11 @@
  */
 #pragma once
 
+#include <stddef.h>
+
+#include <chrono>
+#include <functional>
+#include <mutex>
 #include <ostream>
 #include <string>
 #include <unordered_map>
@@ -38,18 +43,60 @@ class Feature {
       const std::unordered_set<Subclass*>& features,
       const std::function<bool(Subclass*)>& callback);
 
- private:
+ protected:
   virtual std::unordered_set<Subclass*> Dependencies() const = 0;
 };
 
+/**
+ * Collects the time spent in each setup feature, possibly across several
+ * RunSetup calls, and writes it out in the Chrome trace event format. The
+ * output can be loaded in chrome://tracing or https://ui.perfetto.dev to find
+ * the critical path of the setup.
+ */
+class SetupTrace {
+ public:
+  SetupTrace();
+
+  void Record(const std::string& name, size_t thread,
+              std::chrono::steady_clock::time_point start,
+              std::chrono::steady_clock::time_point end);
+
+  Result<void> WriteChromeTrace(const std::string& path) const;
+
+ private:
+  struct Event {
+    std::string name;
+    size_t thread;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point end;
+  };
+
+  std::chrono::steady_clock::time_point origin_;
+  mutable std::mutex mutex_;
+  std::vector<Event> events_;
+};
+
 class SetupFeature : public virtual Feature<SetupFeature> {
  public:
   virtual ~SetupFeature();
 
-  static Result<void> RunSetup(const std::vector<SetupFeature*>& features);
+  /**
+   * Runs the setup of the enabled features, each one as soon as all of its
+   * dependencies are done. Features that allow it run concurrently on a pool
+   * of worker threads, the rest run one at a time on the calling thread while
+   * no other feature is running. On failure no new features are started and
+   * the first error is returned once the running ones finish.
+   */
+  static Result<void> RunSetup(const std::vector<SetupFeature*>& features,
+                               SetupTrace* trace = nullptr);
 
   virtual bool Enabled() const = 0;
 
+  // Whether the setup may run on a worker thread, concurrently with other
+  // features. Features that fork, change process wide state such as flags or
+  // interact with the user must keep the default.
+  virtual bool ParallelSetup() const { return false; }
+
  private:
   virtual Result<void> ResultSetup();
   virtual bool Setup();
@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "host/libs/config/feature.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+#include <json/json.h>
+
+namespace cuttlefish {
+namespace {
+
+class RecordingLog {
+ public:
+  void Add(const std::string& name) {
+    std::lock_guard lock(mutex_);
+    order_.push_back(name);
+  }
+  size_t Position(const std::string& name) {
+    std::lock_guard lock(mutex_);
+    for (size_t i = 0; i < order_.size(); i++) {
+      if (order_[i] == name) {
+        return i;
+      }
+    }
+    return order_.size();
+  }
+  size_t Size() {
+    std::lock_guard lock(mutex_);
+    return order_.size();
+  }
+
+ private:
+  std::mutex mutex_;
+  std::vector<std::string> order_;
+};
+
+class TestFeature : public SetupFeature {
+ public:
+  TestFeature(std::string name, RecordingLog& log, bool parallel,
+              std::unordered_set<SetupFeature*> dependencies = {})
+      : name_(std::move(name)),
+        log_(log),
+        parallel_(parallel),
+        dependencies_(std::move(dependencies)) {}
+
+  std::string Name() const override { return name_; }
+  bool Enabled() const override { return true; }
+  bool ParallelSetup() const override { return parallel_; }
+
+  std::function<Result<void>()> on_setup;
+
+ private:
+  std::unordered_set<SetupFeature*> Dependencies() const override {
+    return dependencies_;
+  }
+  Result<void> ResultSetup() override {
+    if (on_setup) {
+      CF_EXPECT(on_setup());
+    }
+    log_.Add(name_);
+    return {};
+  }
+
+  std::string name_;
+  RecordingLog& log_;
+  bool parallel_;
+  std::unordered_set<SetupFeature*> dependencies_;
+};
+
+}  // namespace
+
+TEST(SetupFeatureTest, RunsDependenciesFirst) {
+  RecordingLog log;
+  TestFeature a("a", log, true);
+  TestFeature b("b", log, false, {&a});
+  TestFeature c("c", log, true, {&a});
+  TestFeature d("d", log, true, {&b, &c});
+
+  ASSERT_TRUE(SetupFeature::RunSetup({&d, &c, &b, &a}).ok());
+
+  ASSERT_EQ(log.Size(), 4);
+  EXPECT_LT(log.Position("a"), log.Position("b"));
+  EXPECT_LT(log.Position("a"), log.Position("c"));
+  EXPECT_LT(log.Position("b"), log.Position("d"));
+  EXPECT_LT(log.Position("c"), log.Position("d"));
+}
+
+TEST(SetupFeatureTest, RunsIndependentFeaturesConcurrently) {
+  RecordingLog log;
+  TestFeature a("a", log, true);
+  TestFeature b("b", log, true);
+  // Each feature waits for the other one to start, which can only succeed if
+  // they run at the same time.
+  std::atomic<int> started = 0;
+  auto rendezvous = [&started]() -> Result<void> {
+    started++;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (started < 2) {
+      CF_EXPECT(std::chrono::steady_clock::now() < deadline,
+                "The other feature didn't start");
+      std::this_thread::yield();
+    }
+    return {};
+  };
+  a.on_setup = rendezvous;
+  b.on_setup = rendezvous;
+
+  auto result = SetupFeature::RunSetup({&a, &b});
+
+  ASSERT_TRUE(result.ok()) << result.error().Trace();
+}
+
+TEST(SetupFeatureTest, SerialFeaturesRunAlone) {
+  RecordingLog log;
+  std::atomic<int> running = 0;
+  std::atomic<bool> serial_running = false;
+  std::atomic<bool> overlapped = false;
+  std::vector<std::unique_ptr<TestFeature>> features;
+  std::vector<SetupFeature*> pointers;
+  for (int i = 0; i < 8; i++) {
+    features.emplace_back(
+        new TestFeature("f" + std::to_string(i), log, i % 2 == 0));
+    auto serial = i % 2 != 0;
+    features.back()->on_setup = [&running, &serial_running, &overlapped,
+                                 serial]() -> Result<void> {
+      if ((running++ > 0 && serial) || serial_running) {
+        overlapped = true;
+      }
+      serial_running = serial;
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      serial_running = false;
+      running--;
+      return {};
+    };
+    pointers.push_back(features.back().get());
+  }
+
+  ASSERT_TRUE(SetupFeature::RunSetup(pointers).ok());
+
+  EXPECT_EQ(log.Size(), 8);
+  EXPECT_FALSE(overlapped);
+}
+
+TEST(SetupFeatureTest, StopsAfterFailure) {
+  RecordingLog log;
+  TestFeature a("a", log, true);
+  TestFeature b("b", log, true, {&a});
+  TestFeature c("c", log, false, {&b});
+  a.on_setup = []() -> Result<void> { return CF_ERR("broken"); };
+
+  auto result = SetupFeature::RunSetup({&a, &b, &c});
+
+  ASSERT_FALSE(result.ok());
+  EXPECT_NE(result.error().Message().find("broken"), std::string::npos);
+  EXPECT_EQ(log.Size(), 0);
+}
+
+TEST(SetupFeatureTest, RejectsMissingDependencies) {
+  RecordingLog log;
+  TestFeature a("a", log, true);
+  TestFeature b("b", log, true, {&a});
+  TestFeature c("c", log, true, {&b});
+
+  EXPECT_FALSE(SetupFeature::RunSetup({&b, &c}).ok());
+  EXPECT_EQ(log.Size(), 0);
+}
+
+TEST(SetupFeatureTest, WritesChromeTrace) {
+  RecordingLog log;
+  TestFeature a("a", log, true);
+  TestFeature b("b", log, false, {&a});
+  SetupTrace trace;
+  ASSERT_TRUE(SetupFeature::RunSetup({&a, &b}, &trace).ok());
+
+  char path_template[] = "/tmp/setup_trace_XXXXXX";
+  int fd = mkstemp(path_template);
+  ASSERT_GE(fd, 0);
+  close(fd);
+  std::string path = path_template;
+  ASSERT_TRUE(trace.WriteChromeTrace(path).ok());
+
+  std::string contents;
+  ASSERT_TRUE(android::base::ReadFileToString(path, &contents));
+  unlink(path.c_str());
+  Json::Value json;
+  Json::CharReaderBuilder builder;
+  std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+  ASSERT_TRUE(reader->parse(contents.data(), contents.data() + contents.size(),
+                            &json, nullptr));
+  const auto& events = json["traceEvents"];
+  ASSERT_EQ(events.size(), 2);
+  std::unordered_set<std::string> names;
+  for (const auto& event : events) {
+    names.insert(event["name"].asString());
+    EXPECT_EQ(event["ph"].asString(), "X");
+    EXPECT_GE(event["dur"].asInt64(), 0);
+  }
+  EXPECT_EQ(names, (std::unordered_set<std::string>{"a", "b"}));
+}
+
+}  // namespace cuttlefish
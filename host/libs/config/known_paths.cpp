@@ -42,6 +42,10 @@ std::string KernelLogMonitorBinary() {
   return HostBinaryPath("kernel_log_monitor");
 }
 
+std::string LogCollectorBinary() {
+  return HostBinaryPath("log_collector");
+}
+
 std::string LogcatReceiverBinary() {
   return HostBinaryPath("logcat_receiver");
 }
@@ -25,6 +25,7 @@ std::string ConsoleForwarderBinary();
 std::string EchoServerBinary();
 std::string GnssGrpcProxyBinary();
 std::string KernelLogMonitorBinary();
+std::string LogCollectorBinary();
 std::string LogcatReceiverBinary();
 std::string MetricsBinary();
 std::string ModemSimulatorBinary();
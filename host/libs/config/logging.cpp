@@ -15,13 +15,35 @@
 
 #include "logging.h"
 
+#include <sys/socket.h>
+
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include <android-base/logging.h>
 
+#include "common/libs/utils/unix_sockets.h"
 #include "host/libs/config/cuttlefish_config.h"
 
 using android::base::SetLogger;
 
 namespace cuttlefish {
+namespace {
+
+// Kept for the lifetime of the process, the fds are never closed.
+struct LogSources {
+  std::mutex mutex;
+  std::vector<std::pair<std::string, SharedFD>> sources;
+};
+
+LogSources& RegisteredLogSources() {
+  static auto registered = new LogSources();
+  return *registered;
+}
+
+}  // namespace
 
 void DefaultSubprocessLogging(char* argv[], MetadataLevel stderr_level) {
   ::android::base::InitLogging(argv, android::base::StderrLogger);
@@ -44,4 +66,33 @@ void DefaultSubprocessLogging(char* argv[], MetadataLevel stderr_level) {
   }
 }
 
+void RegisterLogSource(const std::string& source, SharedFD logs) {
+  auto& registered = RegisteredLogSources();
+  std::lock_guard<std::mutex> lock(registered.mutex);
+  registered.sources.emplace_back(source, std::move(logs));
+}
+
+Result<void> SendLogSourcesToCollector(const std::string& socket_path) {
+  std::vector<std::pair<std::string, SharedFD>> sources;
+  {
+    auto& registered = RegisteredLogSources();
+    std::lock_guard<std::mutex> lock(registered.mutex);
+    sources = registered.sources;
+  }
+  for (const auto& [source, logs] : sources) {
+    auto client =
+        SharedFD::SocketLocalClient(socket_path, false, SOCK_SEQPACKET);
+    CF_EXPECT(client->IsOpen(), "Failed to connect to \""
+                                    << socket_path
+                                    << "\": " << client->StrError());
+    UnixSocketMessage message;
+    message.data.assign(source.begin(), source.end());
+    message.control.emplace_back(
+        CF_EXPECT(ControlMessage::FromFileDescriptors({logs})));
+    CF_EXPECT(UnixMessageSocket(client).WriteMessage(message),
+              "Failed to send the logs of " << source);
+  }
+  return {};
+}
+
 } // namespace cuttlefish
@@ -15,11 +15,30 @@
 
 #pragma once
 
+#include <string>
+
+#include "common/libs/fs/shared_fd.h"
+#include "common/libs/utils/result.h"
 #include "common/libs/utils/tee_logging.h"
+#include "host/libs/config/cuttlefish_config.h"
 
 namespace cuttlefish {
 
 void DefaultSubprocessLogging(char* argv[],
                               MetadataLevel stderr_level = MetadataLevel::ONLY_MESSAGE);
 
+// Registers the read end of a process's output with the instance's
+// log_collector, which credits everything read from it to |source|. The fd is
+// kept open by this process so that it outlives the collector: every source
+// registered so far is handed to each collector that is started, see
+// SendLogSourcesToCollector. Sources must be registered before the process
+// monitor starts, as it only knows of the registrations it was forked with.
+void RegisterLogSource(const std::string& source, SharedFD logs);
+
+// Hands every registered source to the collector listening on |socket_path|,
+// one registration per connection. Called each time the collector starts, so
+// a restarted collector picks up where the crashed one left off: the output
+// written while it was down is waiting in the pipes and fifos.
+Result<void> SendLogSourcesToCollector(const std::string& socket_path);
+
 } // namespace cuttlefish
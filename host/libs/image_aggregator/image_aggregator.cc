@@ -24,9 +24,13 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <android-base/file.h>
@@ -290,6 +294,8 @@ public:
     next_disk_offset_ = next_disk_offset_ + aligned_size;
   }
 
+  const std::vector<PartitionInfo>& Partitions() const { return partitions_; }
+
   std::uint64_t DiskSize() const {
     return AlignToPowerOf2(next_disk_offset_ + sizeof(GptEnd), DISK_SIZE_SHIFT);
   }
@@ -467,36 +473,55 @@ uint64_t AlignToPartitionSize(uint64_t size) {
 
 void AggregateImage(const std::vector<ImagePartition>& partitions,
                     const std::string& output_path) {
-  DeAndroidSparse(partitions);
   CompositeDiskBuilder builder;
   for (auto& partition : partitions) {
     builder.AppendPartition(partition);
   }
-  auto output = SharedFD::Creat(output_path, 0600);
+  android::base::unique_fd output(open(
+      output_path.c_str(), O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, 0600));
+  CHECK(output.get() >= 0) << "Could not open \"" << output_path
+                           << "\": " << strerror(errno);
+  // Everything not written below, like the partition alignment padding, is
+  // left as a hole.
+  CHECK(ftruncate(output.get(), builder.DiskSize()) == 0)
+      << "Could not resize \"" << output_path << "\": " << strerror(errno);
+
   auto beginning = builder.Beginning();
-  if (!WriteBeginning(output, beginning)) {
-    LOG(FATAL) << "Could not write GPT beginning to \"" << output_path
-               << "\": " << output->StrError();
-  }
-  for (auto& disk : partitions) {
-    auto disk_fd = SharedFD::Open(disk.image_file_path, O_RDONLY);
-    auto file_size = FileSize(disk.image_file_path);
-    if (!output->CopyFrom(*disk_fd, file_size)) {
-      LOG(FATAL) << "Could not copy from \"" << disk.image_file_path
-                 << "\" to \"" << output_path << "\": " << output->StrError();
-    }
-    // Handle disk images that are not aligned to PARTITION_SIZE_SHIFT
-    std::uint64_t padding = AlignToPartitionSize(file_size) - file_size;
-    std::string padding_str;
-    padding_str.resize(padding, '\0');
-    if (WriteAll(output, padding_str) != padding_str.size()) {
-      LOG(FATAL) << "Could not write partition padding to \"" << output_path
-                 << "\": " << output->StrError();
+  CHECK(android::base::WriteFullyAtOffset(output, &beginning,
+                                          sizeof(beginning), 0))
+      << "Could not write GPT beginning to \"" << output_path
+      << "\": " << strerror(errno);
+  auto end = builder.End(beginning);
+  CHECK(android::base::WriteFullyAtOffset(output, &end, sizeof(end),
+                                          builder.DiskSize() - sizeof(end)))
+      << "Could not write GPT end to \"" << output_path
+      << "\": " << strerror(errno);
+
+  // The partitions don't overlap, so they are written concurrently with
+  // positional writes on the same file descriptor.
+  const auto& infos = builder.Partitions();
+  std::vector<Result<void>> results(infos.size());
+  std::atomic<size_t> next_partition = 0;
+  auto copy_partitions = [&]() {
+    for (auto i = next_partition++; i < infos.size(); i = next_partition++) {
+      results[i] = WriteExpandedImage(infos[i].source.image_file_paths[0],
+                                      output, infos[i].offset);
     }
+  };
+  size_t num_threads = std::min<size_t>(
+      std::max(std::thread::hardware_concurrency(), 1u), infos.size());
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < num_threads; i++) {
+    threads.emplace_back(copy_partitions);
+  }
+  copy_partitions();
+  for (auto& thread : threads) {
+    thread.join();
   }
-  if (!WriteEnd(output, builder.End(beginning))) {
-    LOG(FATAL) << "Could not write GPT end to \"" << output_path
-               << "\": " << output->StrError();
+  for (size_t i = 0; i < results.size(); i++) {
+    CHECK(results[i].ok()) << "Could not copy partition " << infos[i].source.label
+                           << " to \"" << output_path
+                           << "\": " << results[i].error().Message();
   }
 };
 
@@ -49,6 +49,9 @@ uint64_t AlignToPartitionSize(uint64_t size);
  * Combine the files in `partition` into a single raw disk file and write it to
  * `output_path`. The raw disk file will have a GUID Partition Table and copy in
  * the contents of the files mentioned in `partitions`.
+ *
+ * Android-sparse images are expanded directly into the output, which is left
+ * sparse where the inputs have holes. The input files are not modified.
  */
 void AggregateImage(const std::vector<ImagePartition>& partitions,
                     const std::string& output_path);
@@ -16,17 +16,182 @@
 
 #include "host/libs/image_aggregator/sparse_image_utils.h"
 
+#include <fcntl.h>
+#include <linux/falloc.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include <algorithm>
 #include <fstream>
+#include <memory>
+#include <vector>
 
+#include <android-base/file.h>
 #include <android-base/logging.h>
-
-#include "common/libs/utils/subprocess.h"
-#include "host/libs/config/cuttlefish_config.h"
+#include <sparse/sparse.h>
 
 const char ANDROID_SPARSE_IMAGE_MAGIC[] = "\x3A\xFF\x26\xED";
 namespace cuttlefish {
+namespace {
+
+constexpr size_t kBufferSize = 1 << 20;
+
+Result<void> ReadAt(android::base::borrowed_fd fd, void* data, size_t len,
+                    uint64_t offset) {
+  CF_EXPECT(android::base::ReadFullyAtOffset(fd, data, len, offset),
+            "Failed to read " << len << " bytes at " << offset << ": "
+                              << strerror(errno));
+  return {};
+}
+
+Result<void> WriteAt(android::base::borrowed_fd fd, const void* data,
+                     size_t len, uint64_t offset) {
+  CF_EXPECT(android::base::WriteFullyAtOffset(fd, data, len, offset),
+            "Failed to write " << len << " bytes at " << offset << ": "
+                               << strerror(errno));
+  return {};
+}
+
+// Lets the kernel copy the data, possibly sharing the extents, and falls back
+// to a read/write loop when the file systems don't support it.
+Result<void> CopyRange(android::base::borrowed_fd in, uint64_t in_offset,
+                       android::base::borrowed_fd out, uint64_t out_offset,
+                       uint64_t len) {
+  while (len > 0) {
+    loff_t in_off = in_offset;
+    loff_t out_off = out_offset;
+    auto copied = copy_file_range(in.get(), &in_off, out.get(), &out_off,
+                                  std::min<uint64_t>(len, 1 << 30), 0);
+    if (copied < 0) {
+      if (errno == EXDEV || errno == EINVAL || errno == ENOSYS ||
+          errno == EOPNOTSUPP) {
+        break;
+      }
+      return CF_ERRNO("copy_file_range failed");
+    }
+    CF_EXPECT(copied > 0, "Unexpected end of input file");
+    in_offset += copied;
+    out_offset += copied;
+    len -= copied;
+  }
+  std::vector<char> buffer(std::min<uint64_t>(len, kBufferSize));
+  while (len > 0) {
+    auto chunk = std::min<uint64_t>(len, buffer.size());
+    CF_EXPECT(ReadAt(in, buffer.data(), chunk, in_offset));
+    CF_EXPECT(WriteAt(out, buffer.data(), chunk, out_offset));
+    in_offset += chunk;
+    out_offset += chunk;
+    len -= chunk;
+  }
+  return {};
+}
+
+Result<void> FillRange(android::base::borrowed_fd out, uint64_t offset,
+                       uint64_t len, uint32_t value) {
+  if (len == 0) {
+    return {};
+  }
+  if (value == 0) {
+    if (fallocate(out.get(), FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                  offset, len) == 0) {
+      return {};
+    }
+    CF_EXPECT(errno == EOPNOTSUPP || errno == ENOSYS,
+              "Failed to punch hole: " << strerror(errno));
+  }
+  std::vector<uint32_t> buffer(std::min<uint64_t>(len, kBufferSize) /
+                                   sizeof(uint32_t),
+                               value);
+  while (len > 0) {
+    auto chunk = std::min<uint64_t>(len, buffer.size() * sizeof(uint32_t));
+    CF_EXPECT(WriteAt(out, buffer.data(), chunk, offset));
+    offset += chunk;
+    len -= chunk;
+  }
+  return {};
+}
+
+struct SparseFileDeleter {
+  void operator()(sparse_file* file) { sparse_file_destroy(file); }
+};
+using SparseFilePtr = std::unique_ptr<sparse_file, SparseFileDeleter>;
+
+Result<SparseFilePtr> ImportSparseImage(android::base::borrowed_fd in) {
+  // libsparse reads the file from its current position.
+  CF_EXPECT(lseek(in.get(), 0, SEEK_SET) == 0,
+            "lseek failed: " << strerror(errno));
+  SparseFilePtr sparse(
+      sparse_file_import(in.get(), /* verbose */ false, /* crc */ false));
+  CF_EXPECT(sparse != nullptr, "Not a valid Android-sparse image");
+  return sparse;
+}
+
+// Where libsparse's expanded output goes, it produces it in order.
+struct SparseOutput {
+  android::base::borrowed_fd out;
+  uint64_t offset;
+  Result<void> result;
+};
+
+bool IsZero(const void* data, size_t len) {
+  auto bytes = static_cast<const char*>(data);
+  return len == 0 || (bytes[0] == 0 && memcmp(bytes, bytes + 1, len - 1) == 0);
+}
+
+int WriteSparseOutput(void* priv, const void* data, size_t len) {
+  auto output = static_cast<SparseOutput*>(priv);
+  // "Don't care" regions come without data. Those and zero fills are punched
+  // out rather than written so that the output stays sparse.
+  if (data == nullptr || IsZero(data, len)) {
+    output->result = FillRange(output->out, output->offset, len, 0);
+  } else {
+    output->result = WriteAt(output->out, data, len, output->offset);
+  }
+  output->offset += len;
+  return output->result.ok() ? 0 : -1;
+}
+
+Result<void> WriteSparseImage(android::base::borrowed_fd in,
+                              android::base::borrowed_fd out,
+                              uint64_t offset) {
+  auto sparse = CF_EXPECT(ImportSparseImage(in));
+  SparseOutput output{.out = out, .offset = offset, .result = {}};
+  int ret = sparse_file_callback(sparse.get(), /* sparse */ false,
+                                 /* crc */ false, WriteSparseOutput, &output);
+  CF_EXPECT(std::move(output.result));
+  CF_EXPECT(ret == 0, "Failed to expand the Android-sparse image: " << ret);
+  return {};
+}
+
+Result<void> WriteRawImage(android::base::borrowed_fd in,
+                           android::base::borrowed_fd out, uint64_t offset) {
+  struct stat st;
+  CF_EXPECT(fstat(in.get(), &st) == 0, "fstat failed: " << strerror(errno));
+  const uint64_t size = st.st_size;
+  uint64_t pos = 0;
+  while (pos < size) {
+    auto data = lseek(in.get(), pos, SEEK_DATA);
+    if (data < 0) {
+      if (errno == ENXIO) {
+        // Only a hole is left
+        CF_EXPECT(FillRange(out, offset + pos, size - pos, 0));
+        break;
+      }
+      // SEEK_DATA not supported, treat the rest of the file as data
+      CF_EXPECT(CopyRange(in, pos, out, offset + pos, size - pos));
+      break;
+    }
+    auto hole = lseek(in.get(), data, SEEK_HOLE);
+    CF_EXPECT(hole >= 0, "SEEK_HOLE failed: " << strerror(errno));
+    CF_EXPECT(FillRange(out, offset + pos, data - pos, 0));
+    CF_EXPECT(CopyRange(in, data, out, offset + data, hole - data));
+    pos = hole;
+  }
+  return {};
+}
+
+}  // namespace
 
 bool IsSparseImage(const std::string& image_path) {
   std::ifstream file(image_path, std::ios::binary);
@@ -46,32 +211,58 @@ bool ConvertToRawImage(const std::string& image_path) {
     return false;
   }
 
-  auto simg2img_path = HostBinaryPath("simg2img");
-  Command simg2img_cmd(simg2img_path);
   std::string tmp_raw_image_path = image_path + ".raw";
-  simg2img_cmd.AddParameter(image_path);
-  simg2img_cmd.AddParameter(tmp_raw_image_path);
-
-  // Use simg2img to convert sparse image to raw image.
-  int success = simg2img_cmd.Start().Wait();
-  if (success != 0) {
+  android::base::unique_fd raw(open(tmp_raw_image_path.c_str(),
+                                    O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC,
+                                    0644));
+  if (raw.get() < 0) {
+    PLOG(FATAL) << "Unable to create " << tmp_raw_image_path;
+    return false;
+  }
+  android::base::unique_fd sparse(
+      open(image_path.c_str(), O_RDONLY | O_CLOEXEC));
+  auto sparse_file = ImportSparseImage(sparse);
+  if (!sparse_file.ok()) {
+    LOG(FATAL) << "Unable to read Android sparse image " << image_path << ": "
+               << sparse_file.error().Message();
+    return false;
+  }
+  int64_t raw_size = sparse_file_len(sparse_file->get(), /* sparse */ false,
+                                     /* crc */ false);
+  if (ftruncate(raw.get(), raw_size) != 0) {
+    PLOG(FATAL) << "Unable to resize " << tmp_raw_image_path;
+    return false;
+  }
+  auto written = WriteSparseImage(sparse, raw, 0);
+  if (!written.ok()) {
     LOG(FATAL) << "Unable to convert Android sparse image " << image_path
-               << " to raw image. " << success;
+               << " to raw image: " << written.error().Message();
     return false;
   }
 
   // Replace the original sparse image with the raw image.
-  Command mv_cmd("/bin/mv");
-  mv_cmd.AddParameter("-f");
-  mv_cmd.AddParameter(tmp_raw_image_path);
-  mv_cmd.AddParameter(image_path);
-  success = mv_cmd.Start().Wait();
-  if (success != 0) {
-    LOG(FATAL) << "Unable to replace original sparse image " << success;
+  if (rename(tmp_raw_image_path.c_str(), image_path.c_str()) != 0) {
+    PLOG(FATAL) << "Unable to replace original sparse image " << image_path;
     return false;
   }
 
   return true;
 }
 
+Result<void> WriteExpandedImage(const std::string& image_path,
+                                android::base::borrowed_fd output,
+                                uint64_t offset) {
+  android::base::unique_fd in(open(image_path.c_str(), O_RDONLY | O_CLOEXEC));
+  CF_EXPECT(in.get() >= 0,
+            "Failed to open \"" << image_path << "\": " << strerror(errno));
+  if (IsSparseImage(image_path)) {
+    CF_EXPECT(WriteSparseImage(in, output, offset),
+              "Failed to expand \"" << image_path << "\"");
+  } else {
+    CF_EXPECT(WriteRawImage(in, output, offset),
+              "Failed to copy \"" << image_path << "\"");
+  }
+  return {};
+}
+
 }  // namespace cuttlefish
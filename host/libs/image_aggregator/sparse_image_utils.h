@@ -14,12 +14,34 @@
  * limitations under the License.
  */
 
+#pragma once
+
+#include <stdint.h>
+
 #include <string>
 
+#include <android-base/unique_fd.h>
+
+#include "common/libs/utils/result.h"
+
 namespace cuttlefish {
 
 bool IsSparseImage(const std::string& image_path);
 
 bool ConvertToRawImage(const std::string& image_path);
 
+/**
+ * Writes the expanded contents of `image_path`, either an Android-sparse or a
+ * raw image, to `output` starting at `offset`. Sparse chunks are streamed
+ * straight to their final position without an intermediate raw file.
+ *
+ * Regions known to be zero (holes in raw images, "don't care" and zero fill
+ * chunks in sparse images) are punched out of `output` rather than written,
+ * so the output stays sparse. Concurrent calls writing to disjoint regions of
+ * the same `output` are safe.
+ */
+Result<void> WriteExpandedImage(const std::string& image_path,
+                                android::base::borrowed_fd output,
+                                uint64_t offset);
+
 }  // namespace cuttlefish
@@ -31,9 +31,10 @@ namespace cuttlefish {
 GnssClient::GnssClient(const std::shared_ptr<grpc::Channel>& channel)
     : stub_(GnssGrpcProxy::NewStub(channel)) {}
 
-Result<grpc::Status> GnssClient::SendGpsLocations(
-    int delay, const GpsFixArray& coordinates) {
-  // Data we are sending to the server.
+namespace {
+
+SendGpsCoordinatesRequest CoordinatesRequest(int delay,
+                                             const GpsFixArray& coordinates) {
   SendGpsCoordinatesRequest request;
   request.set_delay(delay);
   for (const auto& loc : coordinates) {
@@ -42,6 +43,38 @@ Result<grpc::Status> GnssClient::SendGpsLocations(
     curr->set_latitude(loc.latitude);
     curr->set_elevation(loc.elevation);
   }
+  return request;
+}
+
+}  // namespace
+
+GpsLocationsStream::GpsLocationsStream(GnssGrpcProxy::Stub& stub, int delay)
+    : delay_(delay),
+      writer_(stub.SendGpsCoordinatesStream(&context_, &reply_)) {}
+
+bool GpsLocationsStream::Write(const GpsFixArray& coordinates) {
+  // Blocks while the server is still busy playing back earlier chunks.
+  return writer_->Write(CoordinatesRequest(delay_, coordinates));
+}
+
+void GpsLocationsStream::Cancel() { context_.TryCancel(); }
+
+Result<grpc::Status> GpsLocationsStream::Finish() {
+  writer_->WritesDone();
+  grpc::Status status = writer_->Finish();
+  CF_EXPECT(status.ok(), "GPS data streaming failed" << status.error_code()
+                                                     << ": "
+                                                     << status.error_message());
+
+  LOG(DEBUG) << reply_.status();
+
+  return status;
+}
+
+Result<grpc::Status> GnssClient::SendGpsLocations(
+    int delay, const GpsFixArray& coordinates) {
+  // Data we are sending to the server.
+  SendGpsCoordinatesRequest request = CoordinatesRequest(delay, coordinates);
 
   // Container for the data we expect from the server.
   SendGpsCoordinatesReply reply;
@@ -60,4 +93,9 @@ Result<grpc::Status> GnssClient::SendGpsLocations(
   return status;
 }
 
+std::unique_ptr<GpsLocationsStream> GnssClient::OpenGpsLocationsStream(
+    int delay) {
+  return std::make_unique<GpsLocationsStream>(*stub_, delay);
+}
+
 }  // namespace cuttlefish
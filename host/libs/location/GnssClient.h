@@ -24,6 +24,28 @@
 #include "host/libs/location/GpsFix.h"
 
 namespace cuttlefish {
+
+// A SendGpsCoordinatesStream call, to send locations as they are parsed.
+class GpsLocationsStream {
+ public:
+  GpsLocationsStream(gnss_grpc_proxy::GnssGrpcProxy::Stub& stub, int delay);
+
+  // Returns false if the stream is broken, in which case Finish() has the
+  // reason.
+  bool Write(const GpsFixArray& coordinates);
+  // Makes the server drop what was sent so far.
+  void Cancel();
+  Result<grpc::Status> Finish();
+
+ private:
+  int delay_;
+  grpc::ClientContext context_;
+  gnss_grpc_proxy::SendGpsCoordinatesReply reply_;
+  std::unique_ptr<
+      grpc::ClientWriter<gnss_grpc_proxy::SendGpsCoordinatesRequest>>
+      writer_;
+};
+
 class GnssClient {
  public:
   GnssClient(const std::shared_ptr<grpc::Channel>& channel);
@@ -31,6 +53,8 @@ class GnssClient {
   Result<grpc::Status> SendGpsLocations(
       int delay, const GpsFixArray& coordinates);
 
+  std::unique_ptr<GpsLocationsStream> OpenGpsLocationsStream(int delay);
+
  private:
   std::unique_ptr<gnss_grpc_proxy::GnssGrpcProxy::Stub> stub_;
 };
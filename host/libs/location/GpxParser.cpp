@@ -16,9 +16,11 @@
 
 #include "GpxParser.h"
 #include <libxml/parser.h>
+#include <libxml/xmlreader.h>
 #include <string.h>
 #include <time.h>
 #include <algorithm>
+#include <vector>
 #include "StringParse.h"
 
 using std::string;
@@ -220,4 +222,77 @@ bool GpxParser::parseString(const char *str, int len, GpsFixArray *fixes,
     return false;
   }
   return parse(doc, fixes, error);
-}
\ No newline at end of file
+}
+
+// Whether the element at the end of |path| holds a fix, which is where
+// parse() would look for one.
+static bool isPoint(const std::vector<string> &path) {
+  switch (path.size()) {
+    case 2:
+      return path[1] == "wpt";
+    case 3:
+      return path[1] == "rte" && path[2] == "rtept";
+    case 4:
+      return path[1] == "trk" && path[2] == "trkseg" && path[3] == "trkpt";
+    default:
+      return false;
+  }
+}
+
+bool GpxParser::parseFileStreaming(
+    const char *filePath, size_t chunkSize,
+    const std::function<bool(GpsFixArray)> &onChunk, string *error) {
+  xmlTextReaderPtr reader = xmlReaderForFile(filePath, nullptr, 0);
+  if (reader == nullptr) {
+    *error = "GPX document not parsed successfully.";
+    return false;
+  }
+
+  // Only one point is expanded into a tree at a time; the reader frees it
+  // once it moves past, so memory use does not grow with the document.
+  std::vector<string> path;
+  GpsFixArray chunk;
+  GpsFix location;
+  bool stopped = false;
+  int ret = xmlTextReaderRead(reader);
+  while (ret == 1 && !stopped) {
+    if (xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT) {
+      ret = xmlTextReaderRead(reader);
+      continue;
+    }
+    path.resize(xmlTextReaderDepth(reader));
+    path.emplace_back(
+        reinterpret_cast<const char *>(xmlTextReaderConstLocalName(reader)));
+    if (!isPoint(path)) {
+      ret = xmlTextReaderRead(reader);
+      continue;
+    }
+
+    xmlNode *point = xmlTextReaderExpand(reader);
+    if (point == nullptr) {
+      ret = -1;
+      break;
+    }
+    if (!parseLocation(point, xmlTextReaderCurrentDoc(reader), &location,
+                       error)) {
+      xmlFreeTextReader(reader);
+      return false;
+    }
+    chunk.push_back(location);
+    if (chunk.size() >= chunkSize) {
+      stopped = !onChunk(std::move(chunk));
+      chunk.clear();
+    }
+    ret = xmlTextReaderNext(reader);
+  }
+  xmlFreeTextReader(reader);
+
+  if (ret < 0) {
+    *error = "GPX document not parsed successfully.";
+    return false;
+  }
+  if (!stopped && !chunk.empty()) {
+    onChunk(std::move(chunk));
+  }
+  return true;
+}
@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <functional>
+
 #include "GpsFix.h"
 
 class GpxParser {
@@ -31,4 +33,18 @@ class GpxParser {
 
   static bool parseString(const char *str, int len, GpsFixArray *fixes,
                           std::string *error);
+
+  /* Parses a given .gpx file at |filePath| without loading all of it into
+   * memory, passing the contained GPS fixes to |onChunk| in document order,
+   * at most |chunkSize| at a time. Unlike parseFile, the fixes are not
+   * sorted by time. Parsing stops early, successfully, if |onChunk| returns
+   * false.
+   *
+   * Returns true on success, false otherwise. If false is returned, |*error|
+   * is set to a string describing the error. Fixes before the error may
+   * already have been passed to |onChunk|.
+   */
+  static bool parseFileStreaming(
+      const char *filePath, size_t chunkSize,
+      const std::function<bool(GpsFixArray)> &onChunk, std::string *error);
 };
\ No newline at end of file
@@ -16,8 +16,11 @@
 
 #include "KmlParser.h"
 #include <libxml/parser.h>
+#include <libxml/xmlreader.h>
 #include <string.h>
 #include <unistd.h>
+#include <algorithm>
+#include <iterator>
 #include <string>
 #include <utility>
 #include "StringParse.h"
@@ -211,3 +214,71 @@ bool KmlParser::parseString(const char* str, int len, GpsFixArray* fixes,
 
   return isWellFormed;
 }
+
+
+bool KmlParser::parseFileStreaming(
+    const char* filePath, size_t chunkSize,
+    const std::function<bool(GpsFixArray)>& onChunk, string* error) {
+  LIBXML_TEST_VERSION
+
+  xmlTextReaderPtr reader = xmlReaderForFile(filePath, nullptr, 0);
+  if (reader == nullptr) {
+    *error = "KML document not parsed successfully.";
+    return false;
+  }
+
+  // Each Placemark is expanded into a tree on its own and freed by the reader
+  // once it moves past, so memory use is bounded by the largest Placemark
+  // rather than the whole document.
+  GpsFixArray chunk;
+  bool hasRoot = false;
+  bool stopped = false;
+  int ret = xmlTextReaderRead(reader);
+  while (ret == 1 && !stopped) {
+    if (xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT) {
+      ret = xmlTextReaderRead(reader);
+      continue;
+    }
+    hasRoot = true;
+    if (strcmp((const char*)xmlTextReaderConstLocalName(reader),
+               "Placemark") != 0) {
+      ret = xmlTextReaderRead(reader);
+      continue;
+    }
+
+    xmlNode* placemark = xmlTextReaderExpand(reader);
+    if (placemark == nullptr) {
+      ret = -1;
+      break;
+    }
+    if (!parsePlacemark(placemark->xmlChildrenNode, &chunk)) {
+      *error = "Location found with missing or malformed coordinates";
+      xmlFreeTextReader(reader);
+      return false;
+    }
+    // A single Placemark, e.g. a long LineString, may hold several chunks.
+    while (!stopped && chunk.size() >= chunkSize && !chunk.empty()) {
+      auto end = chunk.begin() + std::max<size_t>(chunkSize, 1);
+      GpsFixArray head(std::make_move_iterator(chunk.begin()),
+                       std::make_move_iterator(end));
+      chunk.erase(chunk.begin(), end);
+      stopped = !onChunk(std::move(head));
+    }
+    ret = xmlTextReaderNext(reader);
+  }
+  xmlFreeTextReader(reader);
+
+  if (ret < 0) {
+    *error = "KML document not parsed successfully.";
+    return false;
+  }
+  if (!hasRoot) {
+    *error = "Could not get root element of parsed KML file.";
+    return false;
+  }
+  if (!stopped && !chunk.empty()) {
+    onChunk(std::move(chunk));
+  }
+  error->clear();
+  return true;
+}
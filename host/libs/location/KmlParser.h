@@ -18,6 +18,7 @@
 
 #include "GpsFix.h"
 
+#include <functional>
 #include <string>
 
 class KmlParser {
@@ -30,4 +31,15 @@ class KmlParser {
                         std::string* error);
   static bool parseString(const char* str, int len, GpsFixArray* fixes,
                           std::string* error);
+
+  // Parses a given .kml file at |filePath| one Placemark at a time, passing
+  // the contained GPS fixes to |onChunk| in document order, at most
+  // |chunkSize| at a time. Parsing stops early, successfully, if |onChunk|
+  // returns false.
+  // Returns true on success, false otherwise. if false is returned, |*error|
+  // is set to a message describing the error. Fixes before the error may
+  // already have been passed to |onChunk|.
+  static bool parseFileStreaming(
+      const char* filePath, size_t chunkSize,
+      const std::function<bool(GpsFixArray)>& onChunk, std::string* error);
 };
\ No newline at end of file
@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <chrono>
 #include <cstdint>
 #include <functional>
 #include <memory>
@@ -83,11 +84,17 @@ class ScreenConnector : public ScreenConnectorInfo,
    * The callback function is how a raw bytes frame should be processed for
    * WebRTC
    *
+   * frame_damage lists the regions that changed since the previous frame
+   * handed to the callback for the same display; empty means the whole frame.
+   *
+   * commit_time is when the guest committed the frame, for latency tracing.
+   *
    */
   using GenerateProcessedFrameCallback = std::function<void(
       std::uint32_t /*display_number*/, std::uint32_t /*frame_width*/,
       std::uint32_t /*frame_height*/, std::uint32_t /*frame_stride_bytes*/,
-      std::uint8_t* /*frame_bytes*/,
+      std::uint8_t* /*frame_bytes*/, const FrameDamage& /*frame_damage*/,
+      FrameCommitTime /*commit_time*/,
       /* ScImpl enqueues this type into the Q */
       ProcessedFrameType& msg)>;
 
@@ -106,9 +113,12 @@ class ScreenConnector : public ScreenConnectorInfo,
     sc_android_src_.SetFrameCallback(
         [this](std::uint32_t display_number, std::uint32_t frame_w,
                std::uint32_t frame_h, std::uint32_t frame_stride_bytes,
-               std::uint8_t* frame_bytes) {
+               std::uint8_t* frame_bytes, const FrameDamage& frame_damage,
+               FrameCommitTime commit_time) {
           const bool is_confui_mode = host_mode_ctrl_.IsConfirmatioUiMode();
           if (is_confui_mode) {
+            // The damage of this frame is lost, so the next one must be full.
+            MarkDisplayForFullFrame(display_number);
             return;
           }
 
@@ -116,9 +126,12 @@ class ScreenConnector : public ScreenConnectorInfo,
 
           {
             std::lock_guard<std::mutex> lock(streamer_callback_mutex_);
+            const FrameDamage& damage = TakeDisplayFullFrameMark(display_number)
+                                            ? kFullFrameDamage
+                                            : frame_damage;
             callback_from_streamer_(display_number, frame_w, frame_h,
-                                    frame_stride_bytes, frame_bytes,
-                                    processed_frame);
+                                    frame_stride_bytes, frame_bytes, damage,
+                                    commit_time, processed_frame);
           }
 
           sc_frame_multiplexer_.PushToAndroidQueue(std::move(processed_frame));
@@ -167,8 +180,12 @@ class ScreenConnector : public ScreenConnectorInfo,
     ConfUiLog(DEBUG) << this_thread_name
                      << "is sending a #" + std::to_string(render_confui_cnt_)
                      << "Conf UI frame";
+    // Conf UI frames replace the whole display, and the next Android frame
+    // must repaint everything they covered.
+    MarkDisplayForFullFrame(display_number);
     callback_from_streamer_(display_number, frame_width, frame_height,
-                            frame_stride_bytes, frame_bytes, processed_frame);
+                            frame_stride_bytes, frame_bytes, kFullFrameDamage,
+                            std::chrono::steady_clock::now(), processed_frame);
     // now add processed_frame to the queue
     sc_frame_multiplexer_.PushToConfUiQueue(std::move(processed_frame));
     return true;
@@ -178,6 +195,18 @@ class ScreenConnector : public ScreenConnectorInfo,
   ScreenConnector() = delete;
 
  private:
+  void MarkDisplayForFullFrame(std::uint32_t display_number) {
+    std::lock_guard<std::mutex> lock(full_frame_displays_mutex_);
+    full_frame_displays_.insert(display_number);
+  }
+
+  bool TakeDisplayFullFrameMark(std::uint32_t display_number) {
+    std::lock_guard<std::mutex> lock(full_frame_displays_mutex_);
+    return full_frame_displays_.erase(display_number) > 0;
+  }
+
+  static inline const FrameDamage kFullFrameDamage{};
+
   WaylandScreenConnector& sc_android_src_;
   HostModeCtrl& host_mode_ctrl_;
   unsigned long long int on_next_frame_cnt_;
@@ -192,6 +221,9 @@ class ScreenConnector : public ScreenConnectorInfo,
   GenerateProcessedFrameCallback callback_from_streamer_;
   std::mutex streamer_callback_mutex_; // mutex to set & read callback_from_streamer_
   std::condition_variable streamer_callback_set_cv_;
+  // displays whose next Android frame must be processed as fully damaged
+  std::unordered_set<std::uint32_t> full_frame_displays_;
+  std::mutex full_frame_displays_mutex_;
 };
 
 }  // namespace cuttlefish
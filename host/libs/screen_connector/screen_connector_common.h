@@ -23,6 +23,7 @@
 
 #include "common/libs/utils/size_utils.h"
 #include "host/libs/config/cuttlefish_config.h"
+#include "host/libs/wayland/wayland_server_callbacks.h"
 
 namespace cuttlefish {
 
@@ -39,7 +40,9 @@ using GenerateProcessedFrameCallbackImpl =
                        std::uint32_t /*frame_width*/,         //
                        std::uint32_t /*frame_height*/,        //
                        std::uint32_t /*frame_stride_bytes*/,  //
-                       std::uint8_t* /*frame_pixels*/)>;
+                       std::uint8_t* /*frame_pixels*/,        //
+                       const FrameDamage& /*frame_damage*/,   //
+                       FrameCommitTime /*commit_time*/)>;
 
 struct ScreenConnectorInfo {
   // functions are intended to be inlined
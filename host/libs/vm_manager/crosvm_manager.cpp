@@ -35,8 +35,10 @@
 #include "common/libs/utils/network.h"
 #include "common/libs/utils/result.h"
 #include "common/libs/utils/subprocess.h"
+#include "host/libs/config/command_source.h"
 #include "host/libs/config/cuttlefish_config.h"
 #include "host/libs/config/known_paths.h"
+#include "host/libs/config/logging.h"
 #include "host/libs/vm_manager/crosvm_builder.h"
 #include "host/libs/vm_manager/qemu_manager.h"
 
@@ -370,20 +372,7 @@ Result<std::vector<MonitorCommand>> CrosvmManager::StartCommands(
             "Failed to create log fifo for crosvm's stdout/stderr: "
                 << crosvm_logs->StrError());
 
-  Command crosvm_log_tee_cmd(HostBinaryPath("log_tee"));
-  crosvm_log_tee_cmd.AddParameter("--process_name=crosvm");
-  crosvm_log_tee_cmd.AddParameter("--log_fd_in=", crosvm_logs);
-  crosvm_log_tee_cmd.SetStopper([](Subprocess* proc) {
-    // Ask nicely so that log_tee gets a chance to process all the logs.
-    int rval = kill(proc->pid(), SIGINT);
-    if (rval != 0) {
-      LOG(ERROR) << "Failed to stop log_tee nicely, attempting to KILL";
-      return KillSubprocess(proc) == StopperResult::kStopSuccess
-                 ? StopperResult::kStopCrash
-                 : StopperResult::kStopFailure;
-    }
-    return StopperResult::kStopSuccess;
-  });
+  RegisterLogSource("crosvm", crosvm_logs);
 
   // /dev/hvc2 = serial logging
   // Serial port for logcat, redirected to a pipe
@@ -472,10 +461,7 @@ Result<std::vector<MonitorCommand>> CrosvmManager::StartCommands(
   // This needs to be the last parameter
   crosvm_cmd.Cmd().AddParameter("--bios=", instance.bootloader());
 
-  // log_tee must be added before crosvm_cmd to ensure all of crosvm's logs are
-  // captured during shutdown. Processes are stopped in reverse order.
   std::vector<MonitorCommand> commands;
-  commands.emplace_back(std::move(crosvm_log_tee_cmd));
 
   if (gpu_capture_enabled) {
     const std::string gpu_capture_basename =
@@ -488,10 +474,7 @@ Result<std::vector<MonitorCommand>> CrosvmManager::StartCommands(
               "Failed to create log fifo for gpu capture's stdout/stderr: "
                   << gpu_capture_logs->StrError());
 
-    Command gpu_capture_log_tee_cmd(HostBinaryPath("log_tee"));
-    gpu_capture_log_tee_cmd.AddParameter("--process_name=",
-                                         gpu_capture_basename);
-    gpu_capture_log_tee_cmd.AddParameter("--log_fd_in=", gpu_capture_logs);
+    RegisterLogSource(gpu_capture_basename, gpu_capture_logs);
 
     Command gpu_capture_command(instance.gpu_capture_binary());
     if (gpu_capture_basename == "ngfx") {
@@ -523,7 +506,6 @@ Result<std::vector<MonitorCommand>> CrosvmManager::StartCommands(
     gpu_capture_command.RedirectStdIO(Subprocess::StdIOChannel::kStdErr,
                                       gpu_capture_logs);
 
-    commands.emplace_back(std::move(gpu_capture_log_tee_cmd));
     commands.emplace_back(std::move(gpu_capture_command));
   } else {
     crosvm_cmd.Cmd().RedirectStdIO(Subprocess::StdIOChannel::kStdOut,
@@ -532,6 +514,11 @@ Result<std::vector<MonitorCommand>> CrosvmManager::StartCommands(
                                    crosvm_logs);
     commands.emplace_back(std::move(crosvm_cmd.Cmd()), true);
   }
+  if (config.virtio_mac80211_hwsim() &&
+      !config.vhost_user_mac80211_hwsim().empty()) {
+    // The VM can't start until wmediumd listens on the vhost-user socket.
+    commands.back().DependsOn(kWmediumdServerSource);
+  }
 
   return commands;
 }
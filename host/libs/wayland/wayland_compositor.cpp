@@ -107,6 +107,9 @@ void surface_damage(wl_client*,
                << " y=" << y
                << " w=" << w
                << " h=" << h;
+
+  GetUserData<Surface>(surface_resource)
+      ->Damage(DamageRect{.x = x, .y = y, .w = w, .h = h});
 }
 
 void surface_frame(wl_client*, wl_resource* surface, uint32_t) {
@@ -169,6 +172,9 @@ void surface_damage_buffer(wl_client*,
                << " y=" << y
                << " w=" << w
                << " h=" << h;
+
+  GetUserData<Surface>(surface_resource)
+      ->Damage(DamageRect{.x = x, .y = y, .w = w, .h = h});
 }
 
 const struct wl_surface_interface surface_implementation = {
@@ -225,7 +231,8 @@ const struct wl_compositor_interface compositor_implementation = {
     .create_region = compositor_create_region,
 };
 
-constexpr const uint32_t kCompositorVersion = 3;
+// Version 4 adds wl_surface.damage_buffer.
+constexpr const uint32_t kCompositorVersion = 4;
 
 void compositor_destroy_resource_callback(struct wl_resource*) {}
 
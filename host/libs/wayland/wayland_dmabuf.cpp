@@ -16,7 +16,19 @@
 
 #include "host/libs/wayland/wayland_dmabuf.h"
 
+#include <linux/dma-buf.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
 #include <android-base/logging.h>
+#include <android-base/stringprintf.h>
 
 #include <drm_fourcc.h>
 
@@ -24,9 +36,20 @@
 #include <wayland-server-core.h>
 #include <wayland-server-protocol.h>
 
+#include "host/libs/wayland/wayland_utils.h"
+
 namespace wayland {
 namespace {
 
+using android::base::StringPrintf;
+
+// The formats advertised to clients, all of them 4 bytes per pixel.
+constexpr uint32_t kSupportedFormats[] = {
+    DRM_FORMAT_ARGB8888,
+    DRM_FORMAT_XRGB8888,
+};
+constexpr int32_t kBytesPerPixel = 4;
+
 void buffer_destroy(wl_client*, wl_resource* buffer) {
   LOG(VERBOSE) << __FUNCTION__
                << " buffer=" << buffer;
@@ -45,8 +68,6 @@ void linux_buffer_params_destroy(wl_client*, wl_resource* params) {
   wl_resource_destroy(params);
 }
 
-void params_destroy_resource_callback(struct wl_resource*) {}
-
 void linux_buffer_params_add(wl_client*,
                              wl_resource* params,
                              int32_t fd,
@@ -63,6 +84,17 @@ void linux_buffer_params_add(wl_client*,
                << " stride=" << stride
                << " mod_hi=" << modifier_hi
                << " mod_lo=" << modifier_lo;
+
+  // Take ownership of the fd first so that it's closed on every error path.
+  cuttlefish::SharedFD plane_fd = cuttlefish::SharedFD::Dup(fd);
+  close(fd);
+
+  auto error = GetUserData<DmabufParams>(params)->Add(
+      std::move(plane_fd), plane, offset, stride,
+      (static_cast<uint64_t>(modifier_hi) << 32) | modifier_lo);
+  if (error) {
+    wl_resource_post_error(params, error->code, "%s", error->message.c_str());
+  }
 }
 
 void linux_buffer_params_create(wl_client* client,
@@ -78,11 +110,22 @@ void linux_buffer_params_create(wl_client* client,
                << " format=" << format
                << " flags=" << flags;
 
+  std::optional<DmabufParams::Error> error;
+  std::unique_ptr<DmabufBuffer> buffer =
+      GetUserData<DmabufParams>(params)->Import(w, h, format, flags, error);
+  if (error) {
+    wl_resource_post_error(params, error->code, "%s", error->message.c_str());
+    return;
+  }
+  if (!buffer) {
+    zwp_linux_buffer_params_v1_send_failed(params);
+    return;
+  }
   wl_resource* buffer_resource =
-      wl_resource_create(client, &wl_buffer_interface, 1, 0);
-
-  wl_resource_set_implementation(buffer_resource, &buffer_implementation,
-                                 nullptr, params_destroy_resource_callback);
+      CreateDmabufBufferResource(client, 0, std::move(buffer));
+  if (buffer_resource != nullptr) {
+    zwp_linux_buffer_params_v1_send_created(params, buffer_resource);
+  }
 }
 
 void linux_buffer_params_create_immed(wl_client* client,
@@ -100,11 +143,22 @@ void linux_buffer_params_create_immed(wl_client* client,
                << " format=" << format
                << " flags=" << flags;
 
-  wl_resource* buffer_resource =
-      wl_resource_create(client, &wl_buffer_interface, 1, id);
-
-  wl_resource_set_implementation(buffer_resource, &buffer_implementation,
-                                 nullptr, params_destroy_resource_callback);
+  std::optional<DmabufParams::Error> error;
+  std::unique_ptr<DmabufBuffer> buffer =
+      GetUserData<DmabufParams>(params)->Import(w, h, format, flags, error);
+  if (error) {
+    wl_resource_post_error(params, error->code, "%s", error->message.c_str());
+    return;
+  }
+  if (!buffer) {
+    // There is no failed event for create_immed, the client's wl_buffer
+    // would otherwise silently not exist.
+    wl_resource_post_error(params,
+                           ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_INVALID_WL_BUFFER,
+                           "failed to import the buffer");
+    return;
+  }
+  CreateDmabufBufferResource(client, id, std::move(buffer));
 }
 
 const struct zwp_linux_buffer_params_v1_interface
@@ -133,7 +187,8 @@ void linux_dmabuf_create_params(wl_client* client,
 
   wl_resource_set_implementation(buffer_params_resource,
                                  &zwp_linux_buffer_params_implementation,
-                                 nullptr, params_destroy_resource_callback);
+                                 new DmabufParams(),
+                                 DestroyUserData<DmabufParams>);
 }
 
 const struct zwp_linux_dmabuf_v1_interface
@@ -154,11 +209,171 @@ void bind_linux_dmabuf(wl_client* client,
   wl_resource_set_implementation(resource, &zwp_linux_dmabuf_v1_implementation,
                                  data, nullptr);
 
-  zwp_linux_dmabuf_v1_send_format(resource, DRM_FORMAT_ARGB8888);
+  for (uint32_t format : kSupportedFormats) {
+    zwp_linux_dmabuf_v1_send_format(resource, format);
+  }
 }
 
 }  // namespace
 
+DmabufBuffer::DmabufBuffer(cuttlefish::SharedFD fd,
+                           cuttlefish::ScopedMMap mapping,
+                           uint32_t offset,
+                           int32_t width,
+                           int32_t height,
+                           int32_t stride_bytes)
+    : fd_(std::move(fd)),
+      mapping_(std::move(mapping)),
+      offset_(offset),
+      width_(width),
+      height_(height),
+      stride_bytes_(stride_bytes) {}
+
+std::optional<DmabufParams::Error> DmabufParams::Add(cuttlefish::SharedFD fd,
+                                                     uint32_t plane,
+                                                     uint32_t offset,
+                                                     uint32_t stride,
+                                                     uint64_t modifier) {
+  if (used_) {
+    return Error{ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_ALREADY_USED,
+                 "params already used to create a buffer"};
+  }
+  if (plane != 0) {
+    return Error{ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_PLANE_IDX,
+                 StringPrintf("plane %u not supported, only single plane "
+                              "buffers are", plane)};
+  }
+  if (fd_->IsOpen()) {
+    return Error{ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_PLANE_SET,
+                 StringPrintf("plane %u already set", plane)};
+  }
+  if (!fd->IsOpen()) {
+    LOG(ERROR) << "Invalid dmabuf fd: " << fd->StrError();
+    return std::nullopt;
+  }
+  fd_ = std::move(fd);
+  offset_ = offset;
+  stride_ = stride;
+  modifier_ = modifier;
+  return std::nullopt;
+}
+
+std::unique_ptr<DmabufBuffer> DmabufParams::Import(
+    int32_t w, int32_t h, uint32_t format, uint32_t flags,
+    std::optional<Error>& error) {
+  error.reset();
+  if (used_) {
+    error = Error{ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_ALREADY_USED,
+                  "params already used to create a buffer"};
+    return nullptr;
+  }
+  used_ = true;
+
+  if (!fd_->IsOpen()) {
+    error = Error{ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_INCOMPLETE,
+                  "no plane added"};
+    return nullptr;
+  }
+  if (std::find(std::begin(kSupportedFormats), std::end(kSupportedFormats),
+                format) == std::end(kSupportedFormats)) {
+    error = Error{ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_INVALID_FORMAT,
+                  StringPrintf("format 0x%x not supported", format)};
+    return nullptr;
+  }
+  if (w <= 0 || h <= 0 || stride_ > INT32_MAX ||
+      stride_ / kBytesPerPixel < static_cast<uint32_t>(w)) {
+    error = Error{ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_INVALID_DIMENSIONS,
+                  StringPrintf("invalid dimensions %dx%d with stride %u", w, h,
+                               stride_)};
+    return nullptr;
+  }
+  // Computed in 64 bits since all of these come from the client.
+  const uint64_t mapping_size = static_cast<uint64_t>(offset_) +
+                                static_cast<uint64_t>(stride_) * (h - 1) +
+                                static_cast<uint64_t>(w) * kBytesPerPixel;
+  const off_t fd_size = fd_->LSeek(0, SEEK_END);
+  if (fd_size < 0) {
+    LOG(ERROR) << "Failed to get the size of a dmabuf: " << fd_->StrError();
+    return nullptr;
+  }
+  if (mapping_size > static_cast<uint64_t>(fd_size)) {
+    error = Error{
+        ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_OUT_OF_BOUNDS,
+        StringPrintf("plane of %llu bytes exceeds its fd's %lld bytes",
+                     static_cast<unsigned long long>(mapping_size),
+                     static_cast<long long>(fd_size))};
+    return nullptr;
+  }
+
+  // Implicit modifiers are accepted as linear, they are what clients sharing
+  // memfds send, and there's no GPU on this side to agree on a tiling with.
+  if (modifier_ != DRM_FORMAT_MOD_LINEAR &&
+      modifier_ != DRM_FORMAT_MOD_INVALID) {
+    LOG(ERROR) << "Unsupported dmabuf modifier 0x" << std::hex << modifier_;
+    return nullptr;
+  }
+  // Neither flipped nor interlaced buffers are handled by the frame callbacks.
+  if (flags != 0) {
+    LOG(ERROR) << "Unsupported dmabuf flags 0x" << std::hex << flags;
+    return nullptr;
+  }
+
+  cuttlefish::ScopedMMap mapping =
+      fd_->MMap(nullptr, mapping_size, PROT_READ, MAP_SHARED, 0);
+  if (!mapping) {
+    LOG(ERROR) << "Failed to map dmabuf: " << fd_->StrError();
+    return nullptr;
+  }
+  return std::make_unique<DmabufBuffer>(std::move(fd_), std::move(mapping),
+                                        offset_, w, h,
+                                        static_cast<int32_t>(stride_));
+}
+
+wl_resource* CreateDmabufBufferResource(wl_client* client, uint32_t id,
+                                        std::unique_ptr<DmabufBuffer> buffer) {
+  wl_resource* buffer_resource =
+      wl_resource_create(client, &wl_buffer_interface, 1, id);
+  if (buffer_resource == nullptr) {
+    wl_client_post_no_memory(client);
+    return nullptr;
+  }
+  wl_resource_set_implementation(buffer_resource, &buffer_implementation,
+                                 buffer.release(),
+                                 DestroyUserData<DmabufBuffer>);
+  return buffer_resource;
+}
+
+void DmabufBuffer::BeginAccess() {
+  Sync(DMA_BUF_SYNC_START | DMA_BUF_SYNC_READ);
+}
+
+void DmabufBuffer::EndAccess() {
+  Sync(DMA_BUF_SYNC_END | DMA_BUF_SYNC_READ);
+}
+
+void DmabufBuffer::Sync(uint64_t flags) {
+  if (!needs_sync_) {
+    return;
+  }
+  struct dma_buf_sync sync = {.flags = flags};
+  if (fd_->Ioctl(DMA_BUF_IOCTL_SYNC, &sync) != 0) {
+    if (fd_->GetErrno() == ENOTTY) {
+      // Not a dmabuf, plain shared memory is always coherent.
+      needs_sync_ = false;
+    } else {
+      LOG(ERROR) << "Failed to sync dmabuf: " << fd_->StrError();
+    }
+  }
+}
+
+DmabufBuffer* GetDmabufBuffer(wl_resource* buffer) {
+  if (!wl_resource_instance_of(buffer, &wl_buffer_interface,
+                               &buffer_implementation)) {
+    return nullptr;
+  }
+  return GetUserData<DmabufBuffer>(buffer);
+}
+
 void BindDmabufInterface(wl_display* display) {
   wl_global_create(display, &zwp_linux_dmabuf_v1_interface,
                    kLinuxDmabufVersion, nullptr, bind_linux_dmabuf);
@@ -19,10 +19,91 @@
 
 #include <stdint.h>
 
+#include <memory>
+#include <optional>
+#include <string>
+
 #include <wayland-server-core.h>
 
+#include "common/libs/fs/shared_fd.h"
+
 namespace wayland {
 
+// A wl_buffer imported through linux-dmabuf. Only single plane buffers with a
+// linear layout are supported, which covers dmabufs and memfds of the packed
+// 32 bit formats advertised. The buffer is mapped once when imported and the
+// mapping reused by every commit, so frames are read in place.
+class DmabufBuffer {
+ public:
+  DmabufBuffer(cuttlefish::SharedFD fd, cuttlefish::ScopedMMap mapping,
+               uint32_t offset, int32_t width, int32_t height,
+               int32_t stride_bytes);
+
+  DmabufBuffer(const DmabufBuffer& rhs) = delete;
+  DmabufBuffer& operator=(const DmabufBuffer& rhs) = delete;
+
+  int32_t width() const { return width_; }
+  int32_t height() const { return height_; }
+  int32_t stride_bytes() const { return stride_bytes_; }
+  uint8_t* pixels() {
+    return static_cast<uint8_t*>(mapping_.get()) + offset_;
+  }
+
+  // Bracket reads of the pixels, synchronizing the CPU caches for dmabufs.
+  void BeginAccess();
+  void EndAccess();
+
+ private:
+  void Sync(uint64_t flags);
+
+  cuttlefish::SharedFD fd_;
+  cuttlefish::ScopedMMap mapping_;
+  const uint32_t offset_;
+  const int32_t width_;
+  const int32_t height_;
+  const int32_t stride_bytes_;
+  // Cleared once the fd turns out not to be a dmabuf, e.g. a memfd.
+  bool needs_sync_ = true;
+};
+
+// The plane added to a zwp_linux_buffer_params_v1 and the import of the buffer
+// created from it. Invalid requests are reported as the protocol error to
+// post on the params resource.
+class DmabufParams {
+ public:
+  struct Error {
+    // A zwp_linux_buffer_params_v1_error.
+    uint32_t code;
+    std::string message;
+  };
+
+  // Sets the plane, taking ownership of |fd|.
+  std::optional<Error> Add(cuttlefish::SharedFD fd, uint32_t plane,
+                           uint32_t offset, uint32_t stride,
+                           uint64_t modifier);
+
+  // Maps the plane as a buffer. Returns null if the import failed, with
+  // |error| set if that was because the request was invalid.
+  std::unique_ptr<DmabufBuffer> Import(int32_t width, int32_t height,
+                                       uint32_t format, uint32_t flags,
+                                       std::optional<Error>& error);
+
+ private:
+  cuttlefish::SharedFD fd_;
+  uint32_t offset_ = 0;
+  uint32_t stride_ = 0;
+  uint64_t modifier_ = 0;
+  bool used_ = false;
+};
+
+// Creates the wl_buffer resource of an imported buffer, which then owns it.
+wl_resource* CreateDmabufBufferResource(wl_client* client, uint32_t id,
+                                        std::unique_ptr<DmabufBuffer> buffer);
+
+// Returns the dmabuf buffer behind a wl_buffer resource, or null if it wasn't
+// created through linux-dmabuf.
+DmabufBuffer* GetDmabufBuffer(wl_resource* buffer);
+
 // Binds the dmabuf interface to the given wayland server.
 void BindDmabufInterface(wl_display* display);
 
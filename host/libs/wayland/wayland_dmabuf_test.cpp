@@ -0,0 +1,307 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "host/libs/wayland/wayland_dmabuf.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <drm_fourcc.h>
+#include <gtest/gtest.h>
+#include <linux-dmabuf-unstable-v1-server-protocol.h>
+#include <wayland-server-core.h>
+#include <wayland-server-protocol.h>
+
+#include "common/libs/fs/shared_buf.h"
+#include "host/libs/wayland/wayland_surface.h"
+#include "host/libs/wayland/wayland_surfaces.h"
+
+namespace wayland {
+namespace {
+
+using cuttlefish::SharedFD;
+
+constexpr int32_t kWidth = 4;
+constexpr int32_t kHeight = 3;
+// Rows padded past the 4 bytes per pixel, as allocators tend to.
+constexpr uint32_t kStride = kWidth * 4 + 16;
+constexpr uint32_t kOffset = 64;
+
+// Memory shared the way crosvm shares its scanout buffers, with every byte
+// set to |value|.
+SharedFD CreateMemfd(size_t size, char value) {
+  auto memfd =
+      SharedFD::MemfdCreateWithData("dmabuf_test", std::string(size, value));
+  EXPECT_TRUE(memfd->IsOpen()) << memfd->StrError();
+  return memfd;
+}
+
+void Rewrite(SharedFD memfd, size_t size, char value) {
+  ASSERT_EQ(memfd->LSeek(0, SEEK_SET), 0);
+  ASSERT_EQ(cuttlefish::WriteAll(memfd, std::string(size, value)),
+            static_cast<ssize_t>(size));
+}
+
+constexpr size_t kBufferSize = kOffset + kStride * kHeight;
+
+std::unique_ptr<DmabufBuffer> Import(DmabufParams& params,
+                                     std::optional<DmabufParams::Error>& error,
+                                     int32_t width = kWidth,
+                                     int32_t height = kHeight,
+                                     uint32_t format = DRM_FORMAT_ARGB8888) {
+  return params.Import(width, height, format, /* flags */ 0, error);
+}
+
+TEST(DmabufParamsTest, ImportsMemfd) {
+  auto memfd = CreateMemfd(kBufferSize, 0x11);
+  DmabufParams params;
+  ASSERT_FALSE(params.Add(memfd, 0, kOffset, kStride, DRM_FORMAT_MOD_LINEAR));
+
+  std::optional<DmabufParams::Error> error;
+  auto buffer = Import(params, error);
+
+  ASSERT_FALSE(error) << error->message;
+  ASSERT_NE(buffer, nullptr);
+  EXPECT_EQ(buffer->width(), kWidth);
+  EXPECT_EQ(buffer->height(), kHeight);
+  EXPECT_EQ(buffer->stride_bytes(), kStride);
+  buffer->BeginAccess();
+  EXPECT_EQ(buffer->pixels()[0], 0x11);
+  EXPECT_EQ(buffer->pixels()[kStride * (kHeight - 1) + kWidth * 4 - 1], 0x11);
+  buffer->EndAccess();
+}
+
+TEST(DmabufParamsTest, MappingSeesLaterWrites) {
+  auto memfd = CreateMemfd(kBufferSize, 0x11);
+  DmabufParams params;
+  ASSERT_FALSE(params.Add(memfd, 0, 0, kStride, DRM_FORMAT_MOD_INVALID));
+  std::optional<DmabufParams::Error> error;
+  auto buffer = Import(params, error);
+  ASSERT_NE(buffer, nullptr);
+  auto pixels = buffer->pixels();
+
+  Rewrite(memfd, kBufferSize, 0x22);
+
+  EXPECT_EQ(buffer->pixels(), pixels);
+  EXPECT_EQ(pixels[0], 0x22);
+}
+
+TEST(DmabufParamsTest, RejectsSecondPlane) {
+  DmabufParams params;
+  auto error = params.Add(CreateMemfd(kBufferSize, 0), 1, 0, kStride,
+                          DRM_FORMAT_MOD_LINEAR);
+  ASSERT_TRUE(error);
+  EXPECT_EQ(error->code, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_PLANE_IDX);
+}
+
+TEST(DmabufParamsTest, RejectsPlaneSetTwice) {
+  DmabufParams params;
+  ASSERT_FALSE(params.Add(CreateMemfd(kBufferSize, 0), 0, 0, kStride,
+                          DRM_FORMAT_MOD_LINEAR));
+  auto error = params.Add(CreateMemfd(kBufferSize, 0), 0, 0, kStride,
+                          DRM_FORMAT_MOD_LINEAR);
+  ASSERT_TRUE(error);
+  EXPECT_EQ(error->code, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_PLANE_SET);
+}
+
+TEST(DmabufParamsTest, RejectsReuse) {
+  DmabufParams params;
+  ASSERT_FALSE(params.Add(CreateMemfd(kBufferSize, 0), 0, 0, kStride,
+                          DRM_FORMAT_MOD_LINEAR));
+  std::optional<DmabufParams::Error> error;
+  ASSERT_NE(Import(params, error), nullptr);
+
+  EXPECT_EQ(Import(params, error), nullptr);
+  ASSERT_TRUE(error);
+  EXPECT_EQ(error->code, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_ALREADY_USED);
+
+  auto add_error = params.Add(CreateMemfd(kBufferSize, 0), 0, 0, kStride,
+                              DRM_FORMAT_MOD_LINEAR);
+  ASSERT_TRUE(add_error);
+  EXPECT_EQ(add_error->code, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_ALREADY_USED);
+}
+
+TEST(DmabufParamsTest, RejectsMissingPlane) {
+  DmabufParams params;
+  std::optional<DmabufParams::Error> error;
+  EXPECT_EQ(Import(params, error), nullptr);
+  ASSERT_TRUE(error);
+  EXPECT_EQ(error->code, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_INCOMPLETE);
+}
+
+TEST(DmabufParamsTest, RejectsUnadvertisedFormat) {
+  DmabufParams params;
+  ASSERT_FALSE(params.Add(CreateMemfd(kBufferSize, 0), 0, 0, kStride,
+                          DRM_FORMAT_MOD_LINEAR));
+  std::optional<DmabufParams::Error> error;
+  EXPECT_EQ(Import(params, error, kWidth, kHeight, DRM_FORMAT_NV12), nullptr);
+  ASSERT_TRUE(error);
+  EXPECT_EQ(error->code, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_INVALID_FORMAT);
+}
+
+TEST(DmabufParamsTest, RejectsStrideShorterThanRow) {
+  DmabufParams params;
+  ASSERT_FALSE(params.Add(CreateMemfd(kBufferSize, 0), 0, 0, kWidth * 4 - 1,
+                          DRM_FORMAT_MOD_LINEAR));
+  std::optional<DmabufParams::Error> error;
+  EXPECT_EQ(Import(params, error), nullptr);
+  ASSERT_TRUE(error);
+  EXPECT_EQ(error->code, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_INVALID_DIMENSIONS);
+}
+
+TEST(DmabufParamsTest, RejectsEmptyBuffer) {
+  DmabufParams params;
+  ASSERT_FALSE(params.Add(CreateMemfd(kBufferSize, 0), 0, 0, kStride,
+                          DRM_FORMAT_MOD_LINEAR));
+  std::optional<DmabufParams::Error> error;
+  EXPECT_EQ(Import(params, error, 0, kHeight), nullptr);
+  ASSERT_TRUE(error);
+  EXPECT_EQ(error->code, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_INVALID_DIMENSIONS);
+}
+
+TEST(DmabufParamsTest, RejectsPlanePastEndOfFd) {
+  DmabufParams params;
+  // The last row ends one byte past the end of the memfd.
+  ASSERT_FALSE(params.Add(CreateMemfd(kBufferSize - 1, 0), 0, kOffset, kStride,
+                          DRM_FORMAT_MOD_LINEAR));
+  std::optional<DmabufParams::Error> error;
+  EXPECT_EQ(Import(params, error, kStride / 4), nullptr);
+  ASSERT_TRUE(error);
+  EXPECT_EQ(error->code, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_OUT_OF_BOUNDS);
+}
+
+TEST(DmabufParamsTest, RejectsHugeOffset) {
+  DmabufParams params;
+  ASSERT_FALSE(params.Add(CreateMemfd(kBufferSize, 0), 0, UINT32_MAX, kStride,
+                          DRM_FORMAT_MOD_LINEAR));
+  std::optional<DmabufParams::Error> error;
+  EXPECT_EQ(Import(params, error), nullptr);
+  ASSERT_TRUE(error);
+  EXPECT_EQ(error->code, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_OUT_OF_BOUNDS);
+}
+
+TEST(DmabufParamsTest, FailsTiledBufferWithoutProtocolError) {
+  DmabufParams params;
+  ASSERT_FALSE(params.Add(CreateMemfd(kBufferSize, 0), 0, 0, kStride,
+                          I915_FORMAT_MOD_X_TILED));
+  std::optional<DmabufParams::Error> error;
+  EXPECT_EQ(Import(params, error), nullptr);
+  EXPECT_FALSE(error);
+}
+
+// Commits memfd backed buffers to a surface the way crosvm does, through a
+// client connected over a socket pair.
+class DmabufSurfaceTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    display_ = wl_display_create();
+    ASSERT_NE(display_, nullptr);
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds), 0);
+    client_socket_ = SharedFD::Dup(fds[1]);
+    close(fds[1]);
+    client_ = wl_client_create(display_, fds[0]);
+    ASSERT_NE(client_, nullptr);
+
+    surfaces_.SetFrameCallback(
+        [this](std::uint32_t display_number, std::uint32_t width,
+               std::uint32_t height, std::uint32_t stride_bytes,
+               std::uint8_t* pixels, const FrameDamage&, FrameCommitTime) {
+          frames_.push_back(Frame{display_number, width, height, stride_bytes,
+                                  pixels, pixels[0]});
+        });
+  }
+
+  void TearDown() override {
+    surface_.reset();
+    if (client_ != nullptr) {
+      wl_client_destroy(client_);
+    }
+    if (display_ != nullptr) {
+      wl_display_destroy(display_);
+    }
+  }
+
+  wl_resource* CreateBuffer(SharedFD memfd) {
+    DmabufParams params;
+    EXPECT_FALSE(params.Add(memfd, 0, kOffset, kStride, DRM_FORMAT_MOD_LINEAR));
+    std::optional<DmabufParams::Error> error;
+    auto buffer = Import(params, error);
+    EXPECT_NE(buffer, nullptr);
+    return CreateDmabufBufferResource(client_, 0, std::move(buffer));
+  }
+
+  void Commit(wl_resource* buffer) {
+    surface_->Attach(buffer);
+    surface_->Commit();
+  }
+
+  struct Frame {
+    std::uint32_t display_number;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t stride_bytes;
+    std::uint8_t* pixels;
+    std::uint8_t first_byte;
+  };
+
+  wl_display* display_ = nullptr;
+  wl_client* client_ = nullptr;
+  SharedFD client_socket_;
+  Surfaces surfaces_;
+  std::unique_ptr<Surface> surface_ = std::make_unique<Surface>(surfaces_);
+  std::vector<Frame> frames_;
+};
+
+TEST_F(DmabufSurfaceTest, CommitsReadMappingInPlace) {
+  auto memfd = CreateMemfd(kBufferSize, 0x11);
+  wl_resource* buffer = CreateBuffer(memfd);
+  ASSERT_NE(buffer, nullptr);
+  ASSERT_EQ(GetDmabufBuffer(buffer)->pixels()[0], 0x11);
+  surface_->SetRegion(
+      Surface::Region{.x = 0, .y = 0, .w = kWidth, .h = kHeight});
+  surface_->SetVirtioGpuScanoutId(1);
+
+  Commit(buffer);
+  Rewrite(memfd, kBufferSize, 0x22);
+  Commit(buffer);
+
+  ASSERT_EQ(frames_.size(), 2);
+  EXPECT_EQ(frames_[0].display_number, 1);
+  EXPECT_EQ(frames_[0].width, kWidth);
+  EXPECT_EQ(frames_[0].height, kHeight);
+  EXPECT_EQ(frames_[0].stride_bytes, kStride);
+  EXPECT_EQ(frames_[0].first_byte, 0x11);
+  // Both commits read the same mapping, the second one seeing the new pixels.
+  EXPECT_EQ(frames_[0].pixels, GetDmabufBuffer(buffer)->pixels());
+  EXPECT_EQ(frames_[1].pixels, frames_[0].pixels);
+  EXPECT_EQ(frames_[1].first_byte, 0x22);
+}
+
+TEST_F(DmabufSurfaceTest, OtherBuffersAreNotDmabufs) {
+  wl_resource* other =
+      wl_resource_create(client_, &wl_callback_interface, 1, 0);
+  ASSERT_NE(other, nullptr);
+  EXPECT_EQ(GetDmabufBuffer(other), nullptr);
+}
+
+}  // namespace
+}  // namespace wayland
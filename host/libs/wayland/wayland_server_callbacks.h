@@ -16,9 +16,11 @@
 
 #pragma once
 
+#include <chrono>
 #include <cstdint>
 #include <functional>
 #include <variant>
+#include <vector>
 
 struct DisplayCreatedEvent {
   std::uint32_t display_number;
@@ -32,3 +34,19 @@ struct DisplayDestroyedEvent {
 
 using DisplayEvent = std::variant<DisplayCreatedEvent, DisplayDestroyedEvent>;
 using DisplayEventCallback = std::function<void(const DisplayEvent&)>;
+
+// A rectangle of a frame, in buffer pixel coordinates, whose contents changed
+// since the previous frame of the same display.
+struct DamageRect {
+  std::int32_t x;
+  std::int32_t y;
+  std::int32_t w;
+  std::int32_t h;
+};
+
+// The damaged regions of a frame. An empty list means the whole frame must be
+// treated as damaged.
+using FrameDamage = std::vector<DamageRect>;
+
+// When the guest committed a frame, for tracing its latency.
+using FrameCommitTime = std::chrono::steady_clock::time_point;
@@ -16,12 +16,100 @@
 
 #include "host/libs/wayland/wayland_surface.h"
 
+#include <algorithm>
+#include <chrono>
+
 #include <android-base/logging.h>
 #include <wayland-server-protocol.h>
 
+#include "host/libs/wayland/wayland_dmabuf.h"
 #include "host/libs/wayland/wayland_surfaces.h"
 
 namespace wayland {
+namespace {
+
+// Clips the damage to the buffer bounds in place, dropping empty rectangles.
+// Leaves `damage` empty, which means full damage, if it covers the whole
+// buffer or nothing remains.
+void ClipDamage(int32_t buffer_w, int32_t buffer_h, FrameDamage& damage) {
+  size_t kept = 0;
+  for (const auto& rect : damage) {
+    // Computed in 64 bits since clients may send INT32_MAX sized rectangles.
+    const int64_t x0 = std::max<int64_t>(rect.x, 0);
+    const int64_t y0 = std::max<int64_t>(rect.y, 0);
+    const int64_t x1 =
+        std::min<int64_t>(static_cast<int64_t>(rect.x) + rect.w, buffer_w);
+    const int64_t y1 =
+        std::min<int64_t>(static_cast<int64_t>(rect.y) + rect.h, buffer_h);
+    if (x1 <= x0 || y1 <= y0) {
+      continue;
+    }
+    if (x0 == 0 && y0 == 0 && x1 == buffer_w && y1 == buffer_h) {
+      damage.clear();
+      return;
+    }
+    damage[kept++] = DamageRect{
+        .x = static_cast<int32_t>(x0),
+        .y = static_cast<int32_t>(y0),
+        .w = static_cast<int32_t>(x1 - x0),
+        .h = static_cast<int32_t>(y1 - y0),
+    };
+  }
+  damage.resize(kept);
+}
+
+// Gives access to the pixels of a wl_shm or linux-dmabuf buffer while alive.
+class BufferAccess {
+ public:
+  BufferAccess(struct wl_resource* buffer)
+      : shm_buffer_(wl_shm_buffer_get(buffer)),
+        dmabuf_buffer_(shm_buffer_ ? nullptr : GetDmabufBuffer(buffer)) {
+    if (shm_buffer_ != nullptr) {
+      wl_shm_buffer_begin_access(shm_buffer_);
+    } else if (dmabuf_buffer_ != nullptr) {
+      dmabuf_buffer_->BeginAccess();
+    }
+  }
+  ~BufferAccess() {
+    if (shm_buffer_ != nullptr) {
+      wl_shm_buffer_end_access(shm_buffer_);
+    } else if (dmabuf_buffer_ != nullptr) {
+      dmabuf_buffer_->EndAccess();
+    }
+  }
+
+  BufferAccess(const BufferAccess& rhs) = delete;
+  BufferAccess& operator=(const BufferAccess& rhs) = delete;
+
+  // Whether the buffer is of a supported kind.
+  bool valid() const {
+    return shm_buffer_ != nullptr || dmabuf_buffer_ != nullptr;
+  }
+
+  int32_t width() const {
+    return shm_buffer_ ? wl_shm_buffer_get_width(shm_buffer_)
+                       : dmabuf_buffer_->width();
+  }
+  int32_t height() const {
+    return shm_buffer_ ? wl_shm_buffer_get_height(shm_buffer_)
+                       : dmabuf_buffer_->height();
+  }
+  int32_t stride_bytes() const {
+    return shm_buffer_ ? wl_shm_buffer_get_stride(shm_buffer_)
+                       : dmabuf_buffer_->stride_bytes();
+  }
+  uint8_t* pixels() {
+    return shm_buffer_ ? reinterpret_cast<uint8_t*>(
+                             wl_shm_buffer_get_data(shm_buffer_))
+                       : dmabuf_buffer_->pixels();
+  }
+
+ private:
+  struct wl_shm_buffer* shm_buffer_;
+  DmabufBuffer* dmabuf_buffer_;
+};
+
+}  // namespace
 
 Surface::Surface(Surfaces& surfaces) : surfaces_(surfaces) {}
 
@@ -42,11 +130,21 @@ void Surface::Attach(struct wl_resource* buffer) {
   state_.pending_buffer = buffer;
 }
 
+void Surface::Damage(const DamageRect& damage) {
+  std::unique_lock<std::mutex> lock(state_mutex_);
+  state_.pending_damage.push_back(damage);
+}
+
 void Surface::Commit() {
+  const auto commit_time = std::chrono::steady_clock::now();
   std::unique_lock<std::mutex> lock(state_mutex_);
   state_.current_buffer = state_.pending_buffer;
   state_.pending_buffer = nullptr;
 
+  // Swap rather than move so both vectors keep their capacity across frames.
+  std::swap(state_.current_damage, state_.pending_damage);
+  state_.pending_damage.clear();
+
   if (state_.current_buffer == nullptr) {
     return;
   }
@@ -54,29 +152,29 @@ void Surface::Commit() {
   if (state_.virtio_gpu_metadata_.scanout_id.has_value()) {
     const uint32_t display_number = *state_.virtio_gpu_metadata_.scanout_id;
 
-    struct wl_shm_buffer* shm_buffer = wl_shm_buffer_get(state_.current_buffer);
-    CHECK(shm_buffer != nullptr);
-
-    wl_shm_buffer_begin_access(shm_buffer);
+    BufferAccess buffer(state_.current_buffer);
+    CHECK(buffer.valid()) << "Buffers must be wl_shm or linux-dmabuf ones";
 
-    const int32_t buffer_w = wl_shm_buffer_get_width(shm_buffer);
+    const int32_t buffer_w = buffer.width();
     CHECK(buffer_w == state_.region.w);
-    const int32_t buffer_h = wl_shm_buffer_get_height(shm_buffer);
+    const int32_t buffer_h = buffer.height();
     CHECK(buffer_h == state_.region.h);
-    const int32_t buffer_stride_bytes = wl_shm_buffer_get_stride(shm_buffer);
+    const int32_t buffer_stride_bytes = buffer.stride_bytes();
 
     if (!state_.has_notified_surface_create) {
       surfaces_.HandleSurfaceCreated(display_number, buffer_w, buffer_h);
       state_.has_notified_surface_create = true;
+      // The first frame of a display is always sent in full.
+      state_.current_damage.clear();
     }
 
-    uint8_t* buffer_pixels =
-        reinterpret_cast<uint8_t*>(wl_shm_buffer_get_data(shm_buffer));
+    // A client attaching a buffer without posting any damage is treated as
+    // having changed the whole buffer.
+    ClipDamage(buffer_w, buffer_h, state_.current_damage);
 
     surfaces_.HandleSurfaceFrame(display_number, buffer_w, buffer_h,
-                                 buffer_stride_bytes, buffer_pixels);
-
-    wl_shm_buffer_end_access(shm_buffer);
+                                 buffer_stride_bytes, buffer.pixels(),
+                                 state_.current_damage, commit_time);
   }
 
   wl_buffer_send_release(state_.current_buffer);
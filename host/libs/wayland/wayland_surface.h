@@ -20,9 +20,12 @@
 #include <stdint.h>
 #include <mutex>
 #include <optional>
+#include <vector>
 
 #include <wayland-server-core.h>
 
+#include "host/libs/wayland/wayland_server_callbacks.h"
+
 namespace wayland {
 
 class Surfaces;
@@ -51,6 +54,11 @@ class Surface {
   // Sets the buffer of the pending frame.
   void Attach(struct wl_resource* buffer);
 
+  // Marks a region of the pending frame as changed. Buffer scale and transform
+  // are not supported, so surface and buffer coordinates are the same and
+  // this handles both wl_surface.damage and wl_surface.damage_buffer.
+  void Damage(const DamageRect& damage);
+
   // Commits the pending frame state.
   void Commit();
 
@@ -72,6 +80,12 @@ class Surface {
     // The buffer for the next frame.
     struct wl_resource* pending_buffer = nullptr;
 
+    // The damage accumulated for the next frame.
+    FrameDamage pending_damage;
+
+    // The damage of the current committed frame, clipped to the buffer.
+    FrameDamage current_damage;
+
     // The buffers expected dimensions.
     Region region;
 
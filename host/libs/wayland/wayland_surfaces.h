@@ -46,7 +46,9 @@ class Surfaces {
                          std::uint32_t /*frame_width*/,         //
                          std::uint32_t /*frame_height*/,        //
                          std::uint32_t /*frame_stride_bytes*/,  //
-                         std::uint8_t* /*frame_bytes*/)>;
+                         std::uint8_t* /*frame_bytes*/,         //
+                         const FrameDamage& /*frame_damage*/,   //
+                         FrameCommitTime /*commit_time*/)>;
 
   void SetFrameCallback(FrameCallback callback);
 
@@ -58,7 +60,9 @@ class Surfaces {
                           std::uint32_t frame_width,         //
                           std::uint32_t frame_height,        //
                           std::uint32_t frame_stride_bytes,  //
-                          std::uint8_t* frame_bytes);
+                          std::uint8_t* frame_bytes,         //
+                          const FrameDamage& frame_damage,   //
+                          FrameCommitTime commit_time);
 
   void HandleSurfaceCreated(std::uint32_t display_number,
                             std::uint32_t display_width,
@@ -33,6 +33,7 @@
 #include "common/libs/utils/environment.h"
 #include "common/libs/utils/files.h"
 #include "common/libs/utils/result.h"
+#include "common/libs/utils/scope_guard.h"
 #include "host/libs/web/credential_source.h"
 
 namespace cuttlefish {
@@ -48,14 +49,14 @@ bool StatusIsTerminal(const std::string& status) {
   return terminal_statuses.count(status) > 0;
 }
 
-bool ArtifactsContain(const std::vector<Artifact>& artifacts,
-                      const std::string& name) {
+const Artifact* FindArtifact(const std::vector<Artifact>& artifacts,
+                             const std::string& name) {
   for (const auto& artifact : artifacts) {
     if (artifact.Name() == name) {
-      return true;
+      return &artifact;
     }
   }
-  return false;
+  return nullptr;
 }
 
 std::string BuildNameRegexp(
@@ -298,12 +299,13 @@ Result<void> BuildApi::ArtifactToCallback(const DeviceBuild& build,
 }
 
 Result<void> BuildApi::ArtifactToFile(const DeviceBuild& build,
-                                      const std::string& artifact,
-                                      const std::string& path) {
+                                      const Artifact& artifact,
+                                      const std::string& path,
+                                      DownloadProgress* progress) {
   std::string download_url_endpoint =
       BUILD_API + "/builds/" + http_client->UrlEscape(build.id) + "/" +
       http_client->UrlEscape(build.target) + "/attempts/latest/artifacts/" +
-      http_client->UrlEscape(artifact) + "/url";
+      http_client->UrlEscape(artifact.Name()) + "/url";
   if (!api_key_.empty()) {
     download_url_endpoint += "?key=" + http_client->UrlEscape(api_key_);
   }
@@ -311,25 +313,33 @@ Result<void> BuildApi::ArtifactToFile(const DeviceBuild& build,
       http_client->DownloadToJson(download_url_endpoint, CF_EXPECT(Headers())));
   const auto& json = response.data;
   CF_EXPECT(response.HttpSuccess() || response.HttpRedirect(),
-            "Error fetching the url of \"" << artifact << "\" for \"" << build
-                                           << "\". The server response was \""
-                                           << json << "\", and code was "
-                                           << response.http_code);
+            "Error fetching the url of \""
+                << artifact.Name() << "\" for \"" << build
+                << "\". The server response was \"" << json
+                << "\", and code was " << response.http_code);
   CF_EXPECT(!json.isMember("error"),
             "Response had \"error\" but had http success status. "
                 << "Received \"" << json << "\"");
   CF_EXPECT(json.isMember("signedUrl"),
             "URL endpoint did not have json path: " << json);
   std::string url = json["signedUrl"].asString();
-  CF_EXPECT(CF_EXPECT(http_client->DownloadToFile(url, path)).HttpSuccess());
+  LOG(INFO) << "Attempting to save \"" << url << "\" to \"" << path << "\"";
+  // The signed url changes on every call, the md5 tells apart artifacts of
+  // different attempts of the build.
+  std::string source_id = build.id + "/" + build.target + "/" +
+                          artifact.Name() + "@" + artifact.Md5();
+  CF_EXPECT(DownloadRangesToFile(*http_client, url, source_id, artifact.Size(),
+                                 path, {}, ranged_download_options_,
+                                 progress));
   return {};
 }
 
 Result<void> BuildApi::ArtifactToFile(const DirectoryBuild& build,
-                                      const std::string& artifact,
-                                      const std::string& destination) {
+                                      const Artifact& artifact,
+                                      const std::string& destination,
+                                      DownloadProgress* progress) {
   for (const auto& path : build.paths) {
-    auto source = path + "/" + artifact;
+    auto source = path + "/" + artifact.Name();
     if (!FileExists(source)) {
       continue;
     }
@@ -338,10 +348,15 @@ Result<void> BuildApi::ArtifactToFile(const DirectoryBuild& build,
               "Could not create symlink from " << source << " to "
                                                << destination << ": "
                                                << strerror(errno));
+    if (progress) {
+      progress->Advance(FileSize(destination));
+      progress->Finish(true);
+    }
     return {};
   }
-  return CF_ERR("Could not find artifact \"" << artifact << "\" in build \""
-                                             << build << "\"");
+  return CF_ERR("Could not find artifact \"" << artifact.Name()
+                                             << "\" in build \"" << build
+                                             << "\"");
 }
 
 Result<Build> BuildApi::ArgumentToBuild(
@@ -391,12 +406,21 @@ Result<Build> BuildApi::ArgumentToBuild(
 
 Result<std::string> BuildApi::DownloadFile(const Build& build,
                                            const std::string& target_directory,
-                                           const std::string& artifact_name) {
+                                           const std::string& artifact_name,
+                                           DownloadProgress* progress) {
+  // Whoever waits on the progress must learn about failures before the
+  // download starts too.
+  ScopeGuard fail_progress([progress]() {
+    if (progress) {
+      progress->Finish(false);
+    }
+  });
   std::vector<Artifact> artifacts =
       CF_EXPECT(Artifacts(build, {artifact_name}));
-  CF_EXPECT(ArtifactsContain(artifacts, artifact_name),
+  const Artifact* artifact = FindArtifact(artifacts, artifact_name);
+  CF_EXPECT(artifact != nullptr,
             "Target " << build << " did not contain " << artifact_name);
-  return DownloadTargetFile(build, target_directory, artifact_name);
+  return DownloadTargetFile(build, target_directory, *artifact, progress);
 }
 
 Result<std::string> BuildApi::DownloadFileWithBackup(
@@ -404,19 +428,22 @@ Result<std::string> BuildApi::DownloadFileWithBackup(
     const std::string& artifact_name, const std::string& backup_artifact_name) {
   std::vector<Artifact> artifacts =
       CF_EXPECT(Artifacts(build, {artifact_name, backup_artifact_name}));
-  std::string selected_artifact = artifact_name;
-  if (!ArtifactsContain(artifacts, artifact_name)) {
-    selected_artifact = backup_artifact_name;
+  const Artifact* artifact = FindArtifact(artifacts, artifact_name);
+  if (artifact == nullptr) {
+    artifact = FindArtifact(artifacts, backup_artifact_name);
   }
-  return DownloadTargetFile(build, target_directory, selected_artifact);
+  CF_EXPECT(artifact != nullptr, "Target " << build << " did not contain "
+                                           << artifact_name << " or "
+                                           << backup_artifact_name);
+  return DownloadTargetFile(build, target_directory, *artifact);
 }
 
 Result<std::string> BuildApi::DownloadTargetFile(
     const Build& build, const std::string& target_directory,
-    const std::string& artifact_name) {
-  std::string target_filepath = target_directory + "/" + artifact_name;
-  CF_EXPECT(ArtifactToFile(build, artifact_name, target_filepath),
-            "Unable to download " << build << ":" << artifact_name << " to "
+    const Artifact& artifact, DownloadProgress* progress) {
+  std::string target_filepath = target_directory + "/" + artifact.Name();
+  CF_EXPECT(ArtifactToFile(build, artifact, target_filepath, progress),
+            "Unable to download " << build << ":" << artifact.Name() << " to "
                                   << target_filepath);
   return {target_filepath};
 }
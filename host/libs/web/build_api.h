@@ -28,6 +28,7 @@
 #include "common/libs/utils/result.h"
 #include "host/libs/web/credential_source.h"
 #include "host/libs/web/http_client/http_client.h"
+#include "host/libs/web/ranged_download.h"
 
 namespace cuttlefish {
 
@@ -105,15 +106,23 @@ class BuildApi {
   Result<Build> ArgumentToBuild(const std::string& arg,
                                 const std::string& default_build_target);
 
+  // Artifacts of device builds are fetched in parts with concurrent range
+  // requests, and an interrupted download is resumed by the next call. If
+  // given, |progress| is advanced as the start of the file arrives.
   Result<std::string> DownloadFile(const Build& build,
                                    const std::string& target_directory,
-                                   const std::string& artifact_name);
+                                   const std::string& artifact_name,
+                                   DownloadProgress* progress = nullptr);
 
   Result<std::string> DownloadFileWithBackup(
       const Build& build, const std::string& target_directory,
       const std::string& artifact_name,
       const std::string& backup_artifact_name);
 
+  void SetRangedDownloadOptions(const RangedDownloadOptions& options) {
+    ranged_download_options_ = options;
+  }
+
  private:
   Result<std::vector<std::string>> Headers();
 
@@ -140,18 +149,21 @@ class BuildApi {
   }
 
   Result<void> ArtifactToFile(const DeviceBuild& build,
-                              const std::string& artifact,
-                              const std::string& path);
+                              const Artifact& artifact,
+                              const std::string& path,
+                              DownloadProgress* progress);
 
   Result<void> ArtifactToFile(const DirectoryBuild& build,
-                              const std::string& artifact,
-                              const std::string& path);
+                              const Artifact& artifact,
+                              const std::string& path,
+                              DownloadProgress* progress);
 
-  Result<void> ArtifactToFile(const Build& build, const std::string& artifact,
-                              const std::string& path) {
+  Result<void> ArtifactToFile(const Build& build, const Artifact& artifact,
+                              const std::string& path,
+                              DownloadProgress* progress) {
     auto res = std::visit(
-        [this, &artifact, &path](auto&& arg) {
-          return ArtifactToFile(arg, artifact, path);
+        [this, &artifact, &path, progress](auto&& arg) {
+          return ArtifactToFile(arg, artifact, path, progress);
         },
         build);
     CF_EXPECT(std::move(res));
@@ -160,13 +172,15 @@ class BuildApi {
 
   Result<std::string> DownloadTargetFile(const Build& build,
                                          const std::string& target_directory,
-                                         const std::string& artifact_name);
+                                         const Artifact& artifact,
+                                         DownloadProgress* progress = nullptr);
 
   std::unique_ptr<HttpClient> http_client;
   std::unique_ptr<HttpClient> inner_http_client;
   std::unique_ptr<CredentialSource> credential_source;
   std::string api_key_;
   std::chrono::seconds retry_period_;
+  RangedDownloadOptions ranged_download_options_;
 };
 
 std::string GetBuildZipName(const Build& build, const std::string& name);
@@ -22,6 +22,7 @@
 #include <sstream>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include <android-base/logging.h>
 #include <android-base/strings.h>
@@ -81,7 +82,12 @@ class CurlClient : public HttpClient {
       return;
     }
   }
-  ~CurlClient() { curl_easy_cleanup(curl_); }
+  ~CurlClient() {
+    for (CURL* handle : idle_handles_) {
+      curl_easy_cleanup(handle);
+    }
+    curl_easy_cleanup(curl_);
+  }
 
   Result<HttpResponse<std::string>> GetToString(
       const std::string& url,
@@ -216,9 +222,7 @@ class CurlClient : public HttpClient {
       HttpMethod method, DataCallback callback, const std::string& url,
       const std::vector<std::string>& headers,
       const std::string& data_to_write = "") {
-    std::lock_guard<std::mutex> lock(mutex_);
     auto extra_cache_entries = CF_EXPECT(ManuallyResolveUrl(url));
-    curl_easy_setopt(curl_, CURLOPT_RESOLVE, extra_cache_entries.get());
     LOG(INFO) << "Attempting to download \"" << url << "\"";
     CF_EXPECT(data_to_write.empty() || method == HttpMethod::kPost,
               "data must be empty for non POST requests");
@@ -226,37 +230,62 @@ class CurlClient : public HttpClient {
     CF_EXPECT(callback(nullptr, 0) /* Signal start of data */,
               "callback failure");
     auto curl_headers = CF_EXPECT(SlistFromStrings(headers));
-    curl_easy_reset(curl_);
+    // Concurrent requests each get their own handle.
+    std::unique_ptr<CURL, std::function<void(CURL*)>> curl(
+        CF_EXPECT(AcquireHandle()),
+        [this](CURL* handle) { ReleaseHandle(handle); });
+    curl_easy_reset(curl.get());
+    curl_easy_setopt(curl.get(), CURLOPT_RESOLVE, extra_cache_entries.get());
     if (method == HttpMethod::kDelete) {
-      curl_easy_setopt(curl_, CURLOPT_CUSTOMREQUEST, "DELETE");
+      curl_easy_setopt(curl.get(), CURLOPT_CUSTOMREQUEST, "DELETE");
     }
-    curl_easy_setopt(curl_, CURLOPT_CAINFO,
+    curl_easy_setopt(curl.get(), CURLOPT_CAINFO,
                      "/etc/ssl/certs/ca-certificates.crt");
-    curl_easy_setopt(curl_, CURLOPT_HTTPHEADER, curl_headers.get());
-    curl_easy_setopt(curl_, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl.get(), CURLOPT_HTTPHEADER, curl_headers.get());
+    curl_easy_setopt(curl.get(), CURLOPT_URL, url.c_str());
     if (method == HttpMethod::kPost) {
-      curl_easy_setopt(curl_, CURLOPT_POSTFIELDSIZE, data_to_write.size());
-      curl_easy_setopt(curl_, CURLOPT_POSTFIELDS, data_to_write.c_str());
+      curl_easy_setopt(curl.get(), CURLOPT_POSTFIELDSIZE,
+                       data_to_write.size());
+      curl_easy_setopt(curl.get(), CURLOPT_POSTFIELDS, data_to_write.c_str());
     }
-    curl_easy_setopt(curl_, CURLOPT_WRITEFUNCTION, curl_to_function_cb);
-    curl_easy_setopt(curl_, CURLOPT_WRITEDATA, &callback);
+    curl_easy_setopt(curl.get(), CURLOPT_WRITEFUNCTION, curl_to_function_cb);
+    curl_easy_setopt(curl.get(), CURLOPT_WRITEDATA, &callback);
     char error_buf[CURL_ERROR_SIZE];
-    curl_easy_setopt(curl_, CURLOPT_ERRORBUFFER, error_buf);
-    curl_easy_setopt(curl_, CURLOPT_VERBOSE, 1L);
-    CURLcode res = curl_easy_perform(curl_);
+    curl_easy_setopt(curl.get(), CURLOPT_ERRORBUFFER, error_buf);
+    curl_easy_setopt(curl.get(), CURLOPT_VERBOSE, 1L);
+    CURLcode res = curl_easy_perform(curl.get());
     CF_EXPECT(res == CURLE_OK,
               "curl_easy_perform() failed. "
                   << "Code was \"" << res << "\". "
                   << "Strerror was \"" << curl_easy_strerror(res) << "\". "
                   << "Error buffer was \"" << error_buf << "\".");
     long http_code = 0;
-    curl_easy_getinfo(curl_, CURLINFO_RESPONSE_CODE, &http_code);
+    curl_easy_getinfo(curl.get(), CURLINFO_RESPONSE_CODE, &http_code);
     return HttpResponse<void>{{}, http_code};
   }
 
+  // Handles are kept after use so their connections can be reused.
+  Result<CURL*> AcquireHandle() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!idle_handles_.empty()) {
+      CURL* handle = idle_handles_.back();
+      idle_handles_.pop_back();
+      return handle;
+    }
+    CURL* handle = curl_easy_init();
+    CF_EXPECT(handle != nullptr, "failed to initialize curl");
+    return handle;
+  }
+
+  void ReleaseHandle(CURL* handle) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    idle_handles_.push_back(handle);
+  }
+
   CURL* curl_;
   NameResolver resolver_;
   std::mutex mutex_;
+  std::vector<CURL*> idle_handles_;
 };
 
 class ServerErrorRetryClient : public HttpClient {
@@ -0,0 +1,415 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "host/libs/web/ranged_download.h"
+
+#include <fcntl.h>
+
+#include <algorithm>
+#include <atomic>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/parseint.h>
+#include <android-base/strings.h>
+
+#include "common/libs/fs/shared_buf.h"
+#include "common/libs/fs/shared_fd.h"
+#include "common/libs/utils/files.h"
+#include "common/libs/utils/scope_guard.h"
+
+namespace cuttlefish {
+
+void DownloadProgress::Advance(size_t bytes) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (bytes <= available_) {
+      return;
+    }
+    available_ = bytes;
+  }
+  changed_.notify_all();
+}
+
+void DownloadProgress::Finish(bool success) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (finished_) {
+      return;
+    }
+    finished_ = true;
+    success_ = success;
+  }
+  changed_.notify_all();
+}
+
+Result<size_t> DownloadProgress::WaitForBytesAfter(size_t offset) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  changed_.wait(lock, [this, offset]() {
+    return available_ > offset || finished_;
+  });
+  if (available_ <= offset && !success_) {
+    return CF_ERR("Download failed after " << available_ << " bytes");
+  }
+  return available_;
+}
+
+namespace {
+
+constexpr char kJournalSuffix[] = ".parts";
+
+// The journal starts with a line identifying the download, followed by the
+// index of each finished part on its own line. A part is only added once its
+// data is synced, so that a crash can't leave the journal claiming data the
+// file lost.
+std::string JournalHeader(const std::string& source_id, size_t size,
+                          size_t part_size) {
+  return "source=" + source_id + " size=" + std::to_string(size) +
+         " part_size=" + std::to_string(part_size) + "\n";
+}
+
+// Returns the parts an earlier call finished, or nothing if there was no
+// earlier call for the same file and options.
+std::optional<std::vector<bool>> ReadJournal(const std::string& journal_path,
+                                             const std::string& path,
+                                             const std::string& source_id,
+                                             size_t size, size_t part_size,
+                                             size_t parts) {
+  std::string contents;
+  if (!FileExists(journal_path) || !FileExists(path) ||
+      FileSize(path) != static_cast<off_t>(size) ||
+      !android::base::ReadFileToString(journal_path, &contents)) {
+    return {};
+  }
+  std::string header = JournalHeader(source_id, size, part_size);
+  if (!android::base::StartsWith(contents, header)) {
+    return {};
+  }
+  std::vector<bool> done(parts, false);
+  auto lines = android::base::Split(contents.substr(header.size()), "\n");
+  // The last line is either empty or was cut short by an interruption.
+  lines.pop_back();
+  for (const auto& line : lines) {
+    size_t part;
+    if (android::base::ParseUint(line, &part) && part < parts) {
+      done[part] = true;
+    }
+  }
+  return done;
+}
+
+class RangedDownload {
+ public:
+  RangedDownload(HttpClient& http_client, const std::string& url,
+                 const std::string& source_id, size_t size,
+                 const std::vector<std::string>& headers,
+                 const RangedDownloadOptions& options,
+                 DownloadProgress* progress)
+      : http_client_(http_client),
+        url_(url),
+        source_id_(source_id),
+        size_(size),
+        headers_(headers),
+        options_(options),
+        parts_(size == 0 ? 0 : (size - 1) / options.part_size + 1),
+        progress_(progress) {}
+
+  Result<void> Run(const std::string& path) {
+    std::string journal_path = path + kJournalSuffix;
+    auto journal = ReadJournal(journal_path, path, source_id_, size_,
+                               options_.part_size, parts_);
+    done_ = journal.value_or(std::vector<bool>(parts_, false));
+
+    fd_ = SharedFD::Open(path, O_RDWR | O_CREAT, 0644);
+    CF_EXPECT(fd_->IsOpen(),
+              "Could not open \"" << path << "\": " << fd_->StrError());
+    CF_EXPECT(fd_->Truncate(size_) == 0,
+              "Could not resize \"" << path << "\": " << fd_->StrError());
+    int journal_flags = O_WRONLY | O_CREAT | O_APPEND;
+    if (!journal) {
+      journal_flags |= O_TRUNC;
+    }
+    journal_ = SharedFD::Open(journal_path, journal_flags, 0644);
+    CF_EXPECT(journal_->IsOpen(), "Could not open \"" << journal_path << "\": "
+                                                      << journal_->StrError());
+    if (!journal) {
+      std::string header =
+          JournalHeader(source_id_, size_, options_.part_size);
+      CF_EXPECT(WriteAll(journal_, header) == header.size(),
+                "Could not write \"" << journal_path
+                                     << "\": " << journal_->StrError());
+    } else {
+      LOG(INFO) << "Resuming download of \"" << path << "\" with "
+                << std::count(done_.begin(), done_.end(), true) << " of "
+                << parts_ << " parts already present";
+    }
+    AdvanceFirstMissing();
+
+    std::vector<size_t> missing;
+    for (size_t part = 0; part < parts_; part++) {
+      if (!done_[part]) {
+        missing.push_back(part);
+      }
+    }
+    // A fresh download starts with the first part alone, to find out whether
+    // the server honors ranges at all.
+    if (!missing.empty() && missing.front() == 0) {
+      long http_code = CF_EXPECT(FetchPart(0, true));
+      if (http_code != 206) {
+        LOG(INFO) << "Server sent all of \"" << url_ << "\" for a range";
+        std::fill(done_.begin(), done_.end(), true);
+        AdvanceFirstMissing();
+        missing.clear();
+      } else {
+        CF_EXPECT(Completed(0));
+        missing.erase(missing.begin());
+      }
+    }
+    CF_EXPECT(FetchParts(missing));
+    if (range_ignored_) {
+      LOG(INFO) << "Server sent all of \"" << url_ << "\" for a range, "
+                << "downloading it in a single request";
+      CF_EXPECT(FetchWholeFile());
+    }
+
+    journal_->Close();
+    RemoveFile(journal_path);
+    return {};
+  }
+
+ private:
+  Result<void> FetchParts(const std::vector<size_t>& parts) {
+    std::mutex mutex;
+    size_t next = 0;
+    Result<void> result;
+    auto worker = [&]() {
+      while (true) {
+        size_t part;
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          if (next == parts.size() || !result.ok() || range_ignored_) {
+            return;
+          }
+          part = parts[next++];
+        }
+        auto completed = FetchAndComplete(part);
+        if (!completed.ok()) {
+          std::lock_guard<std::mutex> lock(mutex);
+          if (result.ok()) {
+            result = std::move(completed);
+          }
+          return;
+        }
+      }
+    };
+    std::vector<std::thread> workers;
+    size_t thread_count = std::min(options_.parallelism, parts.size());
+    for (size_t i = 0; i < thread_count; i++) {
+      workers.emplace_back(worker);
+    }
+    for (auto& thread : workers) {
+      thread.join();
+    }
+    return result;
+  }
+
+  Result<void> FetchAndComplete(size_t part) {
+    long http_code = CF_EXPECT(FetchPart(part, false));
+    if (http_code != 206) {
+      // Even servers that honored the first range may not honor them all,
+      // e.g. when resuming against a different server behind the same url.
+      range_ignored_ = true;
+      return {};
+    }
+    CF_EXPECT(Completed(part));
+    return {};
+  }
+
+  Result<long> FetchPart(size_t part, bool accept_whole_file) {
+    for (int attempt = 1;; attempt++) {
+      auto result = FetchPartOnce(part, accept_whole_file);
+      if (result.ok() || attempt >= options_.part_attempts) {
+        return CF_EXPECT(std::move(result),
+                         "Failed to download part " << part << " of \""
+                                                    << url_ << "\"");
+      }
+      LOG(WARNING) << "Retrying part " << part << " of \"" << url_
+                   << "\": " << result.error().Message();
+    }
+  }
+
+  Result<long> FetchPartOnce(size_t part, bool accept_whole_file) {
+    const size_t begin = part * options_.part_size;
+    const size_t end = std::min(size_, begin + options_.part_size);
+    const size_t limit = accept_whole_file ? size_ : end;
+    size_t offset = begin;
+    bool overflow = false;
+    std::vector<std::string> headers = headers_;
+    headers.push_back("Range: bytes=" + std::to_string(begin) + "-" +
+                      std::to_string(end - 1));
+    auto response = http_client_.DownloadToCallback(
+        WriteCallback(begin, limit, offset, overflow), url_, headers);
+    if (overflow && !accept_whole_file) {
+      // More than the range arrived, so the server ignored it and started
+      // sending the whole file. The caller falls back to downloading that.
+      return 200;
+    }
+    auto http_response = CF_EXPECT(std::move(response));
+    CF_EXPECT(http_response.HttpSuccess(),
+              "Server responded with code " << http_response.http_code);
+    if (http_response.http_code != 206 && !accept_whole_file) {
+      return http_response.http_code;
+    }
+    // A plain 200 means the range was ignored and the whole file was sent.
+    size_t expected_end = http_response.http_code == 206 ? end : size_;
+    CF_EXPECT(offset == expected_end, "Received " << offset - begin
+                                                  << " bytes instead of "
+                                                  << expected_end - begin);
+    return http_response.http_code;
+  }
+
+  // Writes a response body to the file from |begin| on, keeping the end of
+  // what was written in |offset|. Fails once the body would go past |limit|,
+  // which is recorded in |overflow|.
+  HttpClient::DataCallback WriteCallback(size_t begin, size_t limit,
+                                         size_t& offset, bool& overflow) {
+    // The body of an error response is written here too, so the data can't
+    // be trusted until the response turns out to be successful.
+    return [this, begin, limit, &offset, &overflow](char* data,
+                                                    size_t size) -> bool {
+      if (data == nullptr) {
+        offset = begin;
+        return true;
+      }
+      if (offset + size > limit) {
+        LOG(ERROR) << "Received more than the " << limit - begin
+                   << " bytes asked for";
+        overflow = true;
+        return false;
+      }
+      while (size > 0) {
+        ssize_t written = fd_->PWrite(data, size, offset);
+        if (written <= 0) {
+          LOG(ERROR) << "Failed to write: " << fd_->StrError();
+          return false;
+        }
+        data += written;
+        size -= written;
+        offset += written;
+      }
+      return true;
+    };
+  }
+
+  Result<void> FetchWholeFile() {
+    for (int attempt = 1;; attempt++) {
+      auto result = FetchWholeFileOnce();
+      if (result.ok() || attempt >= options_.part_attempts) {
+        CF_EXPECT(std::move(result), "Failed to download \"" << url_ << "\"");
+        break;
+      }
+      LOG(WARNING) << "Retrying \"" << url_
+                   << "\": " << result.error().Message();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::fill(done_.begin(), done_.end(), true);
+    AdvanceFirstMissing();
+    return {};
+  }
+
+  Result<void> FetchWholeFileOnce() {
+    size_t offset = 0;
+    bool overflow = false;
+    auto response = CF_EXPECT(http_client_.DownloadToCallback(
+        WriteCallback(0, size_, offset, overflow), url_, headers_));
+    CF_EXPECT(response.HttpSuccess(),
+              "Server responded with code " << response.http_code);
+    CF_EXPECT(offset == size_,
+              "Received " << offset << " bytes instead of " << size_);
+    return {};
+  }
+
+  Result<void> Completed(size_t part) {
+    // Syncs the parts finished by the other workers too, which is harmless.
+    CF_EXPECT(fd_->Fdatasync() == 0,
+              "Could not sync part " << part << ": " << fd_->StrError());
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string line = std::to_string(part) + "\n";
+    CF_EXPECT(WriteAll(journal_, line) == line.size(),
+              "Could not write to the journal: " << journal_->StrError());
+    done_[part] = true;
+    AdvanceFirstMissing();
+    return {};
+  }
+
+  void AdvanceFirstMissing() {
+    while (first_missing_ < parts_ && done_[first_missing_]) {
+      first_missing_++;
+    }
+    if (progress_) {
+      progress_->Advance(std::min(size_, first_missing_ * options_.part_size));
+    }
+  }
+
+  HttpClient& http_client_;
+  const std::string& url_;
+  const std::string& source_id_;
+  const size_t size_;
+  const std::vector<std::string>& headers_;
+  const RangedDownloadOptions& options_;
+  const size_t parts_;
+  DownloadProgress* progress_;
+
+  SharedFD fd_;
+  SharedFD journal_;
+  std::mutex mutex_;
+  std::vector<bool> done_;
+  std::atomic<bool> range_ignored_ = false;
+  // The first part that is not finished, which the start of the file
+  // extends into.
+  size_t first_missing_ = 0;
+};
+
+}  // namespace
+
+Result<void> DownloadRangesToFile(HttpClient& http_client,
+                                  const std::string& url,
+                                  const std::string& source_id, size_t size,
+                                  const std::string& path,
+                                  const std::vector<std::string>& headers,
+                                  const RangedDownloadOptions& options,
+                                  DownloadProgress* progress) {
+  CF_EXPECT(options.part_size > 0 && options.parallelism > 0);
+  CF_EXPECT(source_id.find('\n') == std::string::npos,
+            "Invalid source id \"" << source_id << "\"");
+  bool success = false;
+  ScopeGuard finish_progress([progress, &success]() {
+    if (progress) {
+      progress->Finish(success);
+    }
+  });
+  RangedDownload download(http_client, url, source_id, size, headers, options,
+                          progress);
+  CF_EXPECT(download.Run(path));
+  success = true;
+  return {};
+}
+
+}  // namespace cuttlefish
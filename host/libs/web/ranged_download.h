@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "common/libs/utils/result.h"
+#include "host/libs/web/http_client/http_client.h"
+
+namespace cuttlefish {
+
+// How much of a file being downloaded can already be read from the start of
+// it, so it can be consumed while the rest is still arriving.
+class DownloadProgress {
+ public:
+  // Records that the first |bytes| of the file are on disk.
+  void Advance(size_t bytes);
+  // Records the end of the download, unless it was already recorded. Readers
+  // waiting for more data than was downloaded get an error.
+  void Finish(bool success);
+
+  // Blocks until more than |offset| bytes are on disk, and returns how many
+  // are. Returns |offset| if the download finished without adding more.
+  Result<size_t> WaitForBytesAfter(size_t offset);
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  size_t available_ = 0;
+  bool finished_ = false;
+  bool success_ = false;
+};
+
+struct RangedDownloadOptions {
+  // Files are fetched as parts of this size, one HTTP range request each.
+  size_t part_size = 64 << 20;
+  // How many parts are fetched at the same time.
+  size_t parallelism = 4;
+  // How many times a failed part is started over.
+  int part_attempts = 3;
+};
+
+// Downloads the |size| bytes at |url| to |path| with concurrent range
+// requests. Parts finished by an earlier, interrupted call for the same
+// |source_id| with the same options are not fetched again; they are recorded
+// in a journal next to |path| that is removed once the download completes.
+// |source_id| identifies the contents across calls, e.g. a build id and
+// artifact name, as |url| may be signed and differ on every call. It can't
+// contain newlines. When the server
+// ignores a range and sends the whole file, for the first part or any later
+// one, the file is downloaded with a single request instead.
+//
+// If given, |progress| is advanced as parts at the start of the file are
+// finished, and is itself finished when this returns.
+Result<void> DownloadRangesToFile(HttpClient& http_client,
+                                  const std::string& url,
+                                  const std::string& source_id, size_t size,
+                                  const std::string& path,
+                                  const std::vector<std::string>& headers,
+                                  const RangedDownloadOptions& options,
+                                  DownloadProgress* progress = nullptr);
+
+}  // namespace cuttlefish
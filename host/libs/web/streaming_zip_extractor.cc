@@ -0,0 +1,370 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "host/libs/web/streaming_zip_extractor.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/strings.h>
+
+#include "common/libs/fs/shared_fd.h"
+#include "common/libs/utils/files.h"
+
+namespace cuttlefish {
+namespace {
+
+constexpr uint32_t kLocalFileHeaderSignature = 0x04034b50;
+constexpr uint32_t kCentralDirectorySignature = 0x02014b50;
+constexpr uint32_t kEndOfCentralDirectorySignature = 0x06054b50;
+constexpr uint32_t kDataDescriptorSignature = 0x08074b50;
+constexpr uint16_t kZip64ExtraFieldId = 0x0001;
+constexpr uint32_t kZip64SizeMarker = 0xffffffff;
+constexpr uint16_t kFlagEncrypted = 1 << 0;
+constexpr uint16_t kFlagDataDescriptor = 1 << 3;
+constexpr uint16_t kMethodStored = 0;
+constexpr uint16_t kMethodDeflated = 8;
+// The local file header after its signature, up to the file name.
+constexpr size_t kLocalFileHeaderSize = 26;
+
+constexpr size_t kReadSize = 1 << 20;
+constexpr size_t kInflateSize = 1 << 18;
+constexpr size_t kBlockSize = 4096;
+
+uint16_t Le16(const char* data) {
+  auto bytes = reinterpret_cast<const uint8_t*>(data);
+  return bytes[0] | bytes[1] << 8;
+}
+
+uint32_t Le32(const char* data) {
+  return Le16(data) | static_cast<uint32_t>(Le16(data + 2)) << 16;
+}
+
+uint64_t Le64(const char* data) {
+  return Le32(data) | static_cast<uint64_t>(Le32(data + 4)) << 32;
+}
+
+// Reads the archive front to back, waiting for bytes that are still being
+// downloaded.
+class ArchiveReader {
+ public:
+  ArchiveReader(SharedFD fd, DownloadProgress& progress)
+      : fd_(fd), progress_(progress) {}
+
+  const char* data() const { return buffer_.data() + start_; }
+  size_t size() const { return buffer_.size() - start_; }
+  void Consume(size_t count) { start_ += count; }
+
+  // Makes more bytes available after the current ones.
+  Result<void> Fill() {
+    size_t available = CF_EXPECT(progress_.WaitForBytesAfter(end_));
+    CF_EXPECT(available > end_, "Archive ended after " << end_ << " bytes");
+    buffer_.erase(buffer_.begin(), buffer_.begin() + start_);
+    start_ = 0;
+    size_t count = std::min(available - end_, kReadSize);
+    size_t old_size = buffer_.size();
+    buffer_.resize(old_size + count);
+    ssize_t read = fd_->PRead(buffer_.data() + old_size, count, end_);
+    CF_EXPECT(read > 0, "Failed to read the archive: " << fd_->StrError());
+    buffer_.resize(old_size + read);
+    end_ += read;
+    return {};
+  }
+
+  Result<std::string> Read(size_t count) {
+    while (size() < count) {
+      CF_EXPECT(Fill());
+    }
+    std::string bytes(data(), count);
+    Consume(count);
+    return bytes;
+  }
+
+ private:
+  SharedFD fd_;
+  DownloadProgress& progress_;
+  std::vector<char> buffer_;
+  size_t start_ = 0;
+  // The offset in the archive of the end of the buffer.
+  size_t end_ = 0;
+};
+
+// Writes a member, skipping over zeros so that they become holes, like
+// `bsdtar -S` does.
+class SparseWriter {
+ public:
+  SparseWriter(SharedFD fd) : fd_(fd) {}
+
+  Result<void> Write(const char* data, size_t size) {
+    static const char kZeros[kBlockSize] = {};
+    while (size > 0) {
+      size_t count = std::min(size, kBlockSize - offset_ % kBlockSize);
+      if (memcmp(data, kZeros, count) != 0) {
+        for (size_t written = 0; written < count;) {
+          ssize_t ret =
+              fd_->PWrite(data + written, count - written, offset_ + written);
+          CF_EXPECT(ret > 0, "Failed to write: " << fd_->StrError());
+          written += ret;
+        }
+      }
+      data += count;
+      size -= count;
+      offset_ += count;
+    }
+    return {};
+  }
+
+  Result<void> Finish() {
+    // Sets the size in case the member ends with zeros.
+    CF_EXPECT(fd_->Truncate(offset_) == 0,
+              "Failed to set the size: " << fd_->StrError());
+    return {};
+  }
+
+ private:
+  SharedFD fd_;
+  size_t offset_ = 0;
+};
+
+struct Member {
+  std::string name;
+  uint16_t flags;
+  uint16_t method;
+  uint32_t crc32;
+  uint64_t compressed_size;
+  uint64_t uncompressed_size;
+  bool zip64;
+};
+
+Result<Member> ReadLocalFileHeader(ArchiveReader& reader) {
+  std::string header = CF_EXPECT(reader.Read(kLocalFileHeaderSize));
+  Member member;
+  member.flags = Le16(&header[2]);
+  member.method = Le16(&header[4]);
+  member.crc32 = Le32(&header[10]);
+  member.compressed_size = Le32(&header[14]);
+  member.uncompressed_size = Le32(&header[18]);
+  member.name = CF_EXPECT(reader.Read(Le16(&header[22])));
+  std::string extra = CF_EXPECT(reader.Read(Le16(&header[24])));
+
+  member.zip64 = false;
+  for (size_t pos = 0; pos + 4 <= extra.size();) {
+    uint16_t id = Le16(&extra[pos]);
+    uint16_t size = Le16(&extra[pos + 2]);
+    pos += 4;
+    CF_EXPECT(pos + size <= extra.size(),
+              "Malformed extra field for \"" << member.name << "\"");
+    if (id == kZip64ExtraFieldId) {
+      // Only the sizes that did not fit in the header are present, in this
+      // order.
+      member.zip64 = true;
+      size_t field = pos;
+      for (uint64_t* value :
+           {&member.uncompressed_size, &member.compressed_size}) {
+        if (*value == kZip64SizeMarker) {
+          CF_EXPECT(field + 8 <= pos + size,
+                    "Malformed zip64 field for \"" << member.name << "\"");
+          *value = Le64(&extra[field]);
+          field += 8;
+        }
+      }
+    }
+    pos += size;
+  }
+  return member;
+}
+
+Result<void> ReadDataDescriptor(ArchiveReader& reader, Member& member) {
+  size_t sizes_length = member.zip64 ? 16 : 8;
+  std::string descriptor = CF_EXPECT(reader.Read(4));
+  // The signature is optional.
+  if (Le32(descriptor.data()) == kDataDescriptorSignature) {
+    descriptor = CF_EXPECT(reader.Read(4));
+  }
+  member.crc32 = Le32(descriptor.data());
+  std::string sizes = CF_EXPECT(reader.Read(sizes_length));
+  if (member.zip64) {
+    member.compressed_size = Le64(&sizes[0]);
+    member.uncompressed_size = Le64(&sizes[8]);
+  } else {
+    member.compressed_size = Le32(&sizes[0]);
+    member.uncompressed_size = Le32(&sizes[4]);
+  }
+  return {};
+}
+
+// Passes the uncompressed contents of |member| to |output| and returns their
+// checksum and size.
+Result<std::pair<uint32_t, uint64_t>> ReadContents(
+    ArchiveReader& reader, const Member& member,
+    const std::function<Result<void>(const char*, size_t)>& output) {
+  uint32_t crc = crc32(0, nullptr, 0);
+  uint64_t compressed = 0;
+  uint64_t uncompressed = 0;
+
+  if (member.method == kMethodStored) {
+    while (compressed < member.compressed_size) {
+      if (reader.size() == 0) {
+        CF_EXPECT(reader.Fill());
+      }
+      size_t count = std::min<uint64_t>(reader.size(),
+                                         member.compressed_size - compressed);
+      crc = crc32(crc, reinterpret_cast<const Bytef*>(reader.data()), count);
+      CF_EXPECT(output(reader.data(), count));
+      reader.Consume(count);
+      compressed += count;
+    }
+    return std::make_pair(crc, member.compressed_size);
+  }
+
+  z_stream stream = {};
+  CF_EXPECT(inflateInit2(&stream, -MAX_WBITS) == Z_OK,
+            "Failed to initialize zlib");
+  std::unique_ptr<z_stream, decltype(&inflateEnd)> stream_guard(&stream,
+                                                                inflateEnd);
+  std::vector<char> out(kInflateSize);
+  while (true) {
+    if (reader.size() == 0) {
+      CF_EXPECT(reader.Fill());
+    }
+    stream.next_in =
+        reinterpret_cast<Bytef*>(const_cast<char*>(reader.data()));
+    stream.avail_in = std::min<size_t>(reader.size(), UINT32_MAX);
+    stream.next_out = reinterpret_cast<Bytef*>(out.data());
+    stream.avail_out = out.size();
+    int ret = inflate(&stream, Z_NO_FLUSH);
+    size_t consumed = reinterpret_cast<const char*>(stream.next_in) -
+                      reader.data();
+    size_t produced = out.size() - stream.avail_out;
+    reader.Consume(consumed);
+    compressed += consumed;
+    crc = crc32(crc, reinterpret_cast<const Bytef*>(out.data()), produced);
+    CF_EXPECT(output(out.data(), produced));
+    uncompressed += produced;
+    if (ret == Z_STREAM_END) {
+      break;
+    }
+    CF_EXPECT(ret == Z_OK || ret == Z_BUF_ERROR,
+              "Failed to inflate \"" << member.name << "\": " << ret);
+  }
+  bool sizes_known = !(member.flags & kFlagDataDescriptor);
+  CF_EXPECT(!sizes_known || compressed == member.compressed_size,
+            "Compressed size of \"" << member.name << "\" is " << compressed
+                                    << " instead of "
+                                    << member.compressed_size);
+  return std::make_pair(crc, uncompressed);
+}
+
+Result<void> CheckMemberName(const std::string& name) {
+  CF_EXPECT(!name.empty() && name[0] != '/',
+            "Unsafe path in archive: \"" << name << "\"");
+  for (const auto& component : android::base::Split(name, "/")) {
+    CF_EXPECT(component != "..", "Unsafe path in archive: \"" << name << "\"");
+  }
+  return {};
+}
+
+}  // namespace
+
+Result<std::vector<std::string>> ExtractZipWhileDownloading(
+    const std::string& archive_path, DownloadProgress& progress,
+    const std::string& target_directory,
+    const std::vector<std::string>& members) {
+  // The download may replace a file left at |archive_path| before it starts
+  // writing, so opening it any earlier could read the stale file.
+  CF_EXPECT(progress.WaitForBytesAfter(0));
+  auto archive = SharedFD::Open(archive_path, O_RDONLY);
+  CF_EXPECT(archive->IsOpen(), "Could not open \"" << archive_path << "\": "
+                                                   << archive->StrError());
+  ArchiveReader reader(archive, progress);
+  std::vector<std::string> files;
+
+  while (true) {
+    uint32_t signature = Le32(CF_EXPECT(reader.Read(4)).data());
+    if (signature == kCentralDirectorySignature ||
+        signature == kEndOfCentralDirectorySignature) {
+      break;
+    }
+    CF_EXPECT(signature == kLocalFileHeaderSignature,
+              "Unexpected signature " << signature << " in \"" << archive_path
+                                      << "\"");
+    Member member = CF_EXPECT(ReadLocalFileHeader(reader));
+    CF_EXPECT(CheckMemberName(member.name));
+    CF_EXPECT(!(member.flags & kFlagEncrypted),
+              "\"" << member.name << "\" is encrypted");
+    CF_EXPECT(
+        member.method == kMethodStored || member.method == kMethodDeflated,
+        "\"" << member.name << "\" uses compression method " << member.method);
+    // Without its size the end of a stored member can't be found.
+    CF_EXPECT(member.method != kMethodStored ||
+                  !(member.flags & kFlagDataDescriptor),
+              "\"" << member.name << "\" is stored without a size");
+
+    const std::string path = target_directory + "/" + member.name;
+    const bool wanted =
+        members.empty() ||
+        std::find(members.begin(), members.end(), member.name) !=
+            members.end();
+    if (android::base::EndsWith(member.name, "/")) {
+      if (wanted) {
+        CF_EXPECT(EnsureDirectoryExists(path));
+      }
+      continue;
+    }
+
+    SharedFD out;
+    if (wanted) {
+      CF_EXPECT(EnsureDirectoryExists(android::base::Dirname(path)));
+      out = SharedFD::Open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      CF_EXPECT(out->IsOpen(),
+                "Could not open \"" << path << "\": " << out->StrError());
+    }
+    SparseWriter writer(out);
+    auto output = [wanted, &writer](const char* data,
+                                    size_t size) -> Result<void> {
+      if (wanted) {
+        CF_EXPECT(writer.Write(data, size));
+      }
+      return {};
+    };
+    auto [crc, size] = CF_EXPECT(ReadContents(reader, member, output));
+    if (member.flags & kFlagDataDescriptor) {
+      CF_EXPECT(ReadDataDescriptor(reader, member));
+    }
+    CF_EXPECT(size == member.uncompressed_size,
+              "\"" << member.name << "\" has " << size << " bytes instead of "
+                   << member.uncompressed_size);
+    CF_EXPECT(crc == member.crc32,
+              "\"" << member.name << "\" failed the checksum");
+    if (wanted) {
+      CF_EXPECT(writer.Finish());
+      LOG(DEBUG) << "Extracted \"" << path << "\"";
+      files.push_back(path);
+    }
+  }
+  return files;
+}
+
+}  // namespace cuttlefish
@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "common/libs/utils/result.h"
+#include "host/libs/web/ranged_download.h"
+
+namespace cuttlefish {
+
+// Extracts the members of the zip file at |archive_path| into
+// |target_directory| while the file is still being downloaded, reading only
+// the bytes |progress| reports as present. Only the members named in
+// |members| are written, or all of them if it is empty. Runs of zeros are
+// left as holes in the extracted files. Permissions are only stored in the
+// central directory at the end of the archive, so files are created with
+// the default mode; this suits image zips but not archives of executables.
+//
+// Returns the paths of the extracted files. Fails on zip features that need
+// the central directory at the end of the file, in which case the archive
+// can still be extracted once it is complete.
+Result<std::vector<std::string>> ExtractZipWhileDownloading(
+    const std::string& archive_path, DownloadProgress& progress,
+    const std::string& target_directory,
+    const std::vector<std::string>& members = {});
+
+}  // namespace cuttlefish
@@ -0,0 +1,364 @@
+//
+// Copyright (C) 2023 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "host/libs/web/ranged_download.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/strings.h>
+#include <gtest/gtest.h>
+
+#include "common/libs/utils/files.h"
+
+namespace cuttlefish {
+namespace {
+
+// A minimal HTTP/1.1 server for one file, standing in for the build server.
+class TestFileServer {
+ public:
+  TestFileServer(std::string contents) : contents_(std::move(contents)) {
+    listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    socklen_t addr_len = sizeof(addr);
+    getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &addr_len);
+    port_ = ntohs(addr.sin_port);
+    listen(listen_fd_, 64);
+    accept_thread_ = std::thread([this]() { AcceptLoop(); });
+  }
+
+  ~TestFileServer() {
+    shutdown(listen_fd_, SHUT_RDWR);
+    accept_thread_.join();
+    close(listen_fd_);
+    for (auto& thread : connection_threads_) {
+      thread.join();
+    }
+  }
+
+  std::string Url() const {
+    return "http://127.0.0.1:" + std::to_string(port_) + "/file";
+  }
+
+  void SetHonorRanges(bool honor) { honor_ranges_ = honor; }
+  // Each response is sent at this rate; 0 is unlimited.
+  void SetBytesPerSecond(size_t rate) { bytes_per_second_ = rate; }
+  // The next |count| responses are cut off halfway.
+  void FailNextResponses(int count) { failures_left_ = count; }
+  // Requests for ranges starting at or after |offset| get a server error.
+  void RejectRangesFrom(size_t offset) { reject_from_ = offset; }
+
+  int Requests() const { return requests_; }
+  // The ranges asked for so far, in order, as [begin, end) pairs.
+  std::vector<std::pair<size_t, size_t>> Ranges() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto ranges = ranges_;
+    std::sort(ranges.begin(), ranges.end());
+    return ranges;
+  }
+  int MaxConcurrentRequests() const { return max_concurrent_; }
+
+ private:
+  void AcceptLoop() {
+    while (true) {
+      int fd = accept(listen_fd_, nullptr, nullptr);
+      if (fd < 0) {
+        return;
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      connection_threads_.emplace_back([this, fd]() {
+        Serve(fd);
+        close(fd);
+      });
+    }
+  }
+
+  void Serve(int fd) {
+    std::string request;
+    char buf[1024];
+    while (request.find("\r\n\r\n") == std::string::npos) {
+      ssize_t got = read(fd, buf, sizeof(buf));
+      if (got <= 0) {
+        return;
+      }
+      request.append(buf, got);
+    }
+    requests_++;
+    int concurrent = ++concurrent_;
+    int max = max_concurrent_;
+    while (concurrent > max &&
+           !max_concurrent_.compare_exchange_weak(max, concurrent)) {
+    }
+
+    size_t begin = 0;
+    size_t end = contents_.size();
+    bool ranged = false;
+    for (const auto& line : android::base::Split(request, "\r\n")) {
+      std::string_view value = line;
+      if (honor_ranges_ &&
+          android::base::ConsumePrefix(&value, "Range: bytes=")) {
+        auto bounds = android::base::Split(std::string(value), "-");
+        begin = std::stoul(bounds[0]);
+        end = std::min(end, std::stoul(bounds[1]) + 1);
+        ranged = true;
+      }
+    }
+    if (ranged) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ranges_.emplace_back(begin, end);
+    }
+    if (ranged && begin >= reject_from_) {
+      Send(fd, "HTTP/1.1 503 Service Unavailable\r\n"
+               "Content-Length: 5\r\nConnection: close\r\n\r\nerror");
+    } else {
+      size_t length = end - begin;
+      std::string header =
+          ranged ? "HTTP/1.1 206 Partial Content\r\n" : "HTTP/1.1 200 OK\r\n";
+      header += "Content-Length: " + std::to_string(length) + "\r\n";
+      header += "Connection: close\r\n\r\n";
+      if (failures_left_.fetch_sub(1) > 0) {
+        length /= 2;
+      }
+      Send(fd, header) && Send(fd, contents_.substr(begin, length));
+    }
+    concurrent_--;
+  }
+
+  bool Send(int fd, const std::string& data) {
+    const size_t chunk = 16 * 1024;
+    for (size_t sent = 0; sent < data.size(); sent += chunk) {
+      size_t size = std::min(chunk, data.size() - sent);
+      if (!android::base::WriteFully(fd, data.data() + sent, size)) {
+        return false;
+      }
+      if (bytes_per_second_ > 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(
+            size * 1000000 / bytes_per_second_));
+      }
+    }
+    return true;
+  }
+
+  const std::string contents_;
+  int listen_fd_;
+  int port_;
+  std::thread accept_thread_;
+  std::mutex mutex_;
+  std::vector<std::thread> connection_threads_;
+  std::vector<std::pair<size_t, size_t>> ranges_;
+
+  std::atomic<bool> honor_ranges_ = true;
+  std::atomic<size_t> bytes_per_second_ = 0;
+  std::atomic<int> failures_left_ = 0;
+  std::atomic<size_t> reject_from_ = SIZE_MAX;
+  std::atomic<int> requests_ = 0;
+  std::atomic<int> concurrent_ = 0;
+  std::atomic<int> max_concurrent_ = 0;
+};
+
+std::string TestContents(size_t size) {
+  std::string contents(size, '\0');
+  uint32_t state = 12345;
+  for (auto& c : contents) {
+    state = state * 1103515245 + 12345;
+    c = static_cast<char>(state >> 24);
+  }
+  return contents;
+}
+
+std::string ReadContents(const std::string& path) {
+  std::string contents;
+  android::base::ReadFileToString(path, &contents);
+  return contents;
+}
+
+class RangedDownloadTest : public ::testing::Test {
+ protected:
+  RangedDownloadTest()
+      : contents_(TestContents(1000 * 1000)),
+        server_(contents_),
+        http_client_(HttpClient::CurlClient()),
+        path_(std::string(dir_.path) + "/file") {
+    options_.part_size = 64 * 1024;
+    options_.parallelism = 4;
+  }
+
+  Result<void> Download(DownloadProgress* progress = nullptr) {
+    return DownloadRangesToFile(*http_client_, server_.Url(), source_id_,
+                                contents_.size(), path_, {}, options_,
+                                progress);
+  }
+
+  TemporaryDir dir_;
+  std::string contents_;
+  TestFileServer server_;
+  std::unique_ptr<HttpClient> http_client_;
+  std::string path_;
+  std::string source_id_ = "1234/cf_x86_64_phone-userdebug/super.img";
+  RangedDownloadOptions options_;
+};
+
+TEST_F(RangedDownloadTest, DownloadsAllParts) {
+  // Slow enough for the parts to overlap.
+  server_.SetBytesPerSecond(10 * 1000 * 1000);
+  DownloadProgress progress;
+
+  auto result = Download(&progress);
+
+  ASSERT_TRUE(result.ok()) << result.error().Trace();
+  EXPECT_EQ(ReadContents(path_), contents_);
+  EXPECT_EQ(server_.Requests(), 16);
+  EXPECT_GT(server_.MaxConcurrentRequests(), 1);
+  EXPECT_FALSE(FileExists(path_ + ".parts"));
+  auto available = progress.WaitForBytesAfter(contents_.size());
+  ASSERT_TRUE(available.ok());
+  EXPECT_EQ(*available, contents_.size());
+}
+
+TEST_F(RangedDownloadTest, ResumesInterruptedDownload) {
+  options_.part_attempts = 1;
+  server_.RejectRangesFrom(10 * options_.part_size);
+  ASSERT_FALSE(Download().ok());
+  ASSERT_TRUE(FileExists(path_ + ".parts"));
+  int first_requests = server_.Requests();
+
+  server_.RejectRangesFrom(SIZE_MAX);
+  auto result = Download();
+
+  ASSERT_TRUE(result.ok()) << result.error().Trace();
+  EXPECT_EQ(ReadContents(path_), contents_);
+  // Parts are started in order, so all of those before the failed one were
+  // finished and only the rest is fetched again.
+  EXPECT_EQ(server_.Requests() - first_requests, 16 - 10);
+  EXPECT_FALSE(FileExists(path_ + ".parts"));
+}
+
+TEST_F(RangedDownloadTest, RestartsWithDifferentPartSize) {
+  options_.part_attempts = 1;
+  server_.RejectRangesFrom(10 * options_.part_size);
+  ASSERT_FALSE(Download().ok());
+
+  server_.RejectRangesFrom(SIZE_MAX);
+  options_.part_size = 100 * 1000;
+  auto result = Download();
+
+  ASSERT_TRUE(result.ok()) << result.error().Trace();
+  EXPECT_EQ(ReadContents(path_), contents_);
+}
+
+TEST_F(RangedDownloadTest, RestartsForDifferentSource) {
+  options_.part_attempts = 1;
+  server_.RejectRangesFrom(10 * options_.part_size);
+  ASSERT_FALSE(Download().ok());
+  int first_requests = server_.Requests();
+
+  server_.RejectRangesFrom(SIZE_MAX);
+  source_id_ = "5678/cf_x86_64_phone-userdebug/super.img";
+  auto result = Download();
+
+  ASSERT_TRUE(result.ok()) << result.error().Trace();
+  EXPECT_EQ(ReadContents(path_), contents_);
+  // None of the parts of the other build are kept.
+  EXPECT_EQ(server_.Requests() - first_requests, 16);
+}
+
+TEST_F(RangedDownloadTest, RetriesFailedParts) {
+  // The first part is fetched alone, so both failures are retries of it.
+  server_.FailNextResponses(options_.part_attempts - 1);
+
+  auto result = Download();
+
+  ASSERT_TRUE(result.ok()) << result.error().Trace();
+  EXPECT_EQ(ReadContents(path_), contents_);
+}
+
+TEST_F(RangedDownloadTest, FailsAfterLastAttempt) {
+  options_.part_attempts = 2;
+  server_.RejectRangesFrom(0);
+  DownloadProgress progress;
+
+  EXPECT_FALSE(Download(&progress).ok());
+  EXPECT_FALSE(progress.WaitForBytesAfter(0).ok());
+}
+
+TEST_F(RangedDownloadTest, AcceptsServerIgnoringRanges) {
+  server_.SetHonorRanges(false);
+  DownloadProgress progress;
+
+  auto result = Download(&progress);
+
+  ASSERT_TRUE(result.ok()) << result.error().Trace();
+  EXPECT_EQ(ReadContents(path_), contents_);
+  EXPECT_EQ(server_.Requests(), 1);
+  auto available = progress.WaitForBytesAfter(0);
+  ASSERT_TRUE(available.ok());
+  EXPECT_EQ(*available, contents_.size());
+}
+
+TEST_F(RangedDownloadTest, ResumesAgainstServerIgnoringRanges) {
+  options_.part_attempts = 1;
+  server_.RejectRangesFrom(10 * options_.part_size);
+  ASSERT_FALSE(Download().ok());
+  ASSERT_TRUE(FileExists(path_ + ".parts"));
+
+  server_.RejectRangesFrom(SIZE_MAX);
+  server_.SetHonorRanges(false);
+  DownloadProgress progress;
+  auto result = Download(&progress);
+
+  ASSERT_TRUE(result.ok()) << result.error().Trace();
+  EXPECT_EQ(ReadContents(path_), contents_);
+  EXPECT_FALSE(FileExists(path_ + ".parts"));
+  auto available = progress.WaitForBytesAfter(0);
+  ASSERT_TRUE(available.ok());
+  EXPECT_EQ(*available, contents_.size());
+}
+
+TEST_F(RangedDownloadTest, RequestsEachPartOnceConcurrently) {
+  // Slow enough for the parts to overlap.
+  server_.SetBytesPerSecond(1000 * 1000);
+  options_.parallelism = 8;
+
+  auto result = Download();
+
+  ASSERT_TRUE(result.ok()) << result.error().Trace();
+  EXPECT_EQ(ReadContents(path_), contents_);
+  std::vector<std::pair<size_t, size_t>> expected;
+  for (size_t begin = 0; begin < contents_.size();
+       begin += options_.part_size) {
+    expected.emplace_back(
+        begin, std::min(contents_.size(), begin + options_.part_size));
+  }
+  EXPECT_EQ(server_.Ranges(), expected);
+  EXPECT_GT(server_.MaxConcurrentRequests(), 1);
+}
+
+}  // namespace
+}  // namespace cuttlefish
@@ -0,0 +1,274 @@
+//
+// Copyright (C) 2023 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "host/libs/web/streaming_zip_extractor.h"
+
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+
+#include "common/libs/fs/shared_buf.h"
+#include "common/libs/fs/shared_fd.h"
+#include "common/libs/utils/files.h"
+
+namespace cuttlefish {
+namespace {
+
+void PutLe16(std::string& out, uint16_t value) {
+  out.push_back(value & 0xff);
+  out.push_back(value >> 8);
+}
+
+void PutLe32(std::string& out, uint32_t value) {
+  PutLe16(out, value & 0xffff);
+  PutLe16(out, value >> 16);
+}
+
+std::string Deflate(const std::string& data) {
+  z_stream stream = {};
+  deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8,
+               Z_DEFAULT_STRATEGY);
+  std::string out(deflateBound(&stream, data.size()), '\0');
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  stream.avail_in = data.size();
+  stream.next_out = reinterpret_cast<Bytef*>(out.data());
+  stream.avail_out = out.size();
+  deflate(&stream, Z_FINISH);
+  out.resize(stream.total_out);
+  deflateEnd(&stream);
+  return out;
+}
+
+// Builds zip files the way the build server's img zips are laid out, plus
+// the variations the extractor has to deal with.
+class ZipBuilder {
+ public:
+  enum class Method { kStored, kDeflated, kDeflatedWithDescriptor };
+
+  void Add(const std::string& name, const std::string& contents,
+           Method method) {
+    uint32_t crc = crc32(0, reinterpret_cast<const Bytef*>(contents.data()),
+                         contents.size());
+    std::string data = method == Method::kStored ? contents : Deflate(contents);
+    bool descriptor = method == Method::kDeflatedWithDescriptor;
+    uint16_t zip_method = method == Method::kStored ? 0 : 8;
+    uint32_t offset = zip_.size();
+
+    PutLe32(zip_, 0x04034b50);
+    PutLe16(zip_, 20);
+    PutLe16(zip_, descriptor ? 0x8 : 0);
+    PutLe16(zip_, zip_method);
+    PutLe32(zip_, 0);
+    PutLe32(zip_, descriptor ? 0 : crc);
+    PutLe32(zip_, descriptor ? 0 : data.size());
+    PutLe32(zip_, descriptor ? 0 : contents.size());
+    PutLe16(zip_, name.size());
+    PutLe16(zip_, 0);
+    zip_ += name;
+    zip_ += data;
+    if (descriptor) {
+      PutLe32(zip_, 0x08074b50);
+      PutLe32(zip_, crc);
+      PutLe32(zip_, data.size());
+      PutLe32(zip_, contents.size());
+    }
+
+    PutLe32(central_, 0x02014b50);
+    PutLe16(central_, 20);
+    PutLe16(central_, 20);
+    PutLe16(central_, descriptor ? 0x8 : 0);
+    PutLe16(central_, zip_method);
+    PutLe32(central_, 0);
+    PutLe32(central_, crc);
+    PutLe32(central_, data.size());
+    PutLe32(central_, contents.size());
+    PutLe16(central_, name.size());
+    PutLe16(central_, 0);
+    PutLe16(central_, 0);
+    PutLe16(central_, 0);
+    PutLe16(central_, 0);
+    PutLe32(central_, 0);
+    PutLe32(central_, offset);
+    central_ += name;
+    entries_++;
+  }
+
+  std::string Finish() const {
+    std::string zip = zip_ + central_;
+    PutLe32(zip, 0x06054b50);
+    PutLe16(zip, 0);
+    PutLe16(zip, 0);
+    PutLe16(zip, entries_);
+    PutLe16(zip, entries_);
+    PutLe32(zip, central_.size());
+    PutLe32(zip, zip_.size());
+    PutLe16(zip, 0);
+    return zip;
+  }
+
+ private:
+  std::string zip_;
+  std::string central_;
+  uint16_t entries_ = 0;
+};
+
+std::string ReadContents(const std::string& path) {
+  std::string contents;
+  android::base::ReadFileToString(path, &contents);
+  return contents;
+}
+
+class StreamingZipExtractorTest : public ::testing::Test {
+ protected:
+  StreamingZipExtractorTest()
+      : archive_path_(std::string(dir_.path) + "/archive.zip"),
+        target_dir_(std::string(dir_.path) + "/out") {
+    EnsureDirectoryExists(target_dir_);
+    for (size_t i = 0; i < 300000; i++) {
+      image_ += static_cast<char>(i * 7 % 251);
+    }
+    // A large run of zeros, as in the unused parts of images.
+    image_ += std::string(1 << 20, '\0');
+    image_ += "end of image";
+  }
+
+  // Writes |zip| to the archive path in small pieces, reporting each as it
+  // lands the way a download does.
+  std::thread WriteSlowly(std::string zip, bool success = true,
+                          size_t stop_at = SIZE_MAX) {
+    return std::thread([this, zip = std::move(zip), success, stop_at]() {
+      auto fd = SharedFD::Creat(archive_path_, 0644);
+      size_t end = std::min(zip.size(), stop_at);
+      for (size_t offset = 0; offset < end; offset += 4096) {
+        std::string piece =
+            zip.substr(offset, std::min<size_t>(4096, end - offset));
+        WriteAll(fd, piece);
+        progress_.Advance(offset + piece.size());
+      }
+      progress_.Finish(success);
+    });
+  }
+
+  TemporaryDir dir_;
+  std::string archive_path_;
+  std::string target_dir_;
+  std::string image_;
+  DownloadProgress progress_;
+};
+
+TEST_F(StreamingZipExtractorTest, ExtractsWhileWriting) {
+  ZipBuilder zip;
+  zip.Add("system.img", image_, ZipBuilder::Method::kDeflated);
+  zip.Add("android-info.txt", "board=cutf\n", ZipBuilder::Method::kStored);
+  zip.Add("images/", "", ZipBuilder::Method::kStored);
+  zip.Add("images/vendor.img", image_,
+          ZipBuilder::Method::kDeflatedWithDescriptor);
+  auto writer = WriteSlowly(zip.Finish());
+
+  auto files =
+      ExtractZipWhileDownloading(archive_path_, progress_, target_dir_);
+  writer.join();
+
+  ASSERT_TRUE(files.ok()) << files.error().Trace();
+  std::vector<std::string> expected{target_dir_ + "/system.img",
+                                    target_dir_ + "/android-info.txt",
+                                    target_dir_ + "/images/vendor.img"};
+  EXPECT_EQ(*files, expected);
+  EXPECT_EQ(ReadContents(target_dir_ + "/system.img"), image_);
+  EXPECT_EQ(ReadContents(target_dir_ + "/android-info.txt"), "board=cutf\n");
+  EXPECT_EQ(ReadContents(target_dir_ + "/images/vendor.img"), image_);
+}
+
+TEST_F(StreamingZipExtractorTest, LeavesHolesForZeros) {
+  ZipBuilder zip;
+  zip.Add("system.img", image_, ZipBuilder::Method::kDeflated);
+  auto writer = WriteSlowly(zip.Finish());
+
+  auto files =
+      ExtractZipWhileDownloading(archive_path_, progress_, target_dir_);
+  writer.join();
+
+  ASSERT_TRUE(files.ok()) << files.error().Trace();
+  struct stat st;
+  ASSERT_EQ(stat((target_dir_ + "/system.img").c_str(), &st), 0);
+  EXPECT_EQ(st.st_size, image_.size());
+  EXPECT_LT(st.st_blocks * 512, image_.size());
+}
+
+TEST_F(StreamingZipExtractorTest, ExtractsOnlyRequestedMembers) {
+  ZipBuilder zip;
+  zip.Add("system.img", image_, ZipBuilder::Method::kDeflated);
+  zip.Add("boot.img", "boot", ZipBuilder::Method::kStored);
+  auto writer = WriteSlowly(zip.Finish());
+
+  auto files = ExtractZipWhileDownloading(archive_path_, progress_, target_dir_,
+                                          {"boot.img"});
+  writer.join();
+
+  ASSERT_TRUE(files.ok()) << files.error().Trace();
+  std::vector<std::string> expected{target_dir_ + "/boot.img"};
+  EXPECT_EQ(*files, expected);
+  EXPECT_FALSE(FileExists(target_dir_ + "/system.img"));
+}
+
+TEST_F(StreamingZipExtractorTest, FailsWhenDownloadFails) {
+  ZipBuilder zip;
+  zip.Add("system.img", image_, ZipBuilder::Method::kDeflated);
+  std::string contents = zip.Finish();
+  auto writer = WriteSlowly(contents, false, contents.size() / 2);
+
+  auto files =
+      ExtractZipWhileDownloading(archive_path_, progress_, target_dir_);
+  writer.join();
+
+  EXPECT_FALSE(files.ok());
+}
+
+TEST_F(StreamingZipExtractorTest, RejectsCorruptMembers) {
+  ZipBuilder zip;
+  zip.Add("system.img", image_, ZipBuilder::Method::kStored);
+  std::string contents = zip.Finish();
+  contents[1000] ^= 1;
+  auto writer = WriteSlowly(contents);
+
+  auto files =
+      ExtractZipWhileDownloading(archive_path_, progress_, target_dir_);
+  writer.join();
+
+  EXPECT_FALSE(files.ok());
+}
+
+TEST_F(StreamingZipExtractorTest, RejectsPathsOutsideTarget) {
+  ZipBuilder zip;
+  zip.Add("../escaped.img", "data", ZipBuilder::Method::kStored);
+  auto writer = WriteSlowly(zip.Finish());
+
+  auto files =
+      ExtractZipWhileDownloading(archive_path_, progress_, target_dir_);
+  writer.join();
+
+  EXPECT_FALSE(files.ok());
+  EXPECT_FALSE(FileExists(std::string(dir_.path) + "/escaped.img"));
+}
+
+}  // namespace
+}  // namespace cuttlefish